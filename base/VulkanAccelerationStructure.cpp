@@ -0,0 +1,401 @@
+/*
+* Vulkan acceleration structure manager
+*
+* Batches bottom level acceleration structure builds into a single submission using a shared scratch arena,
+* compacts them and keeps an updatable top level acceleration structure for per-frame refits
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#include "VulkanAccelerationStructure.h"
+
+namespace vks
+{
+	/**
+	* Get the function pointers and device limits required for building acceleration structures
+	*
+	* @param device Pointer to the Vulkan device the acceleration structures are created on
+	* @param queue Queue used for the build and compaction submissions
+	*
+	* @note Requires VK_KHR_acceleration_structure and the buffer device address feature to be enabled on the device
+	*/
+	void AccelerationStructureManager::prepare(vks::VulkanDevice *device, VkQueue queue)
+	{
+		this->device = device;
+		this->queue = queue;
+
+		vkGetBufferDeviceAddressKHR = reinterpret_cast<PFN_vkGetBufferDeviceAddressKHR>(vkGetDeviceProcAddr(device->logicalDevice, "vkGetBufferDeviceAddressKHR"));
+		vkCreateAccelerationStructureKHR = reinterpret_cast<PFN_vkCreateAccelerationStructureKHR>(vkGetDeviceProcAddr(device->logicalDevice, "vkCreateAccelerationStructureKHR"));
+		vkDestroyAccelerationStructureKHR = reinterpret_cast<PFN_vkDestroyAccelerationStructureKHR>(vkGetDeviceProcAddr(device->logicalDevice, "vkDestroyAccelerationStructureKHR"));
+		vkGetAccelerationStructureBuildSizesKHR = reinterpret_cast<PFN_vkGetAccelerationStructureBuildSizesKHR>(vkGetDeviceProcAddr(device->logicalDevice, "vkGetAccelerationStructureBuildSizesKHR"));
+		vkGetAccelerationStructureDeviceAddressKHR = reinterpret_cast<PFN_vkGetAccelerationStructureDeviceAddressKHR>(vkGetDeviceProcAddr(device->logicalDevice, "vkGetAccelerationStructureDeviceAddressKHR"));
+		vkCmdBuildAccelerationStructuresKHR = reinterpret_cast<PFN_vkCmdBuildAccelerationStructuresKHR>(vkGetDeviceProcAddr(device->logicalDevice, "vkCmdBuildAccelerationStructuresKHR"));
+		vkCmdWriteAccelerationStructuresPropertiesKHR = reinterpret_cast<PFN_vkCmdWriteAccelerationStructuresPropertiesKHR>(vkGetDeviceProcAddr(device->logicalDevice, "vkCmdWriteAccelerationStructuresPropertiesKHR"));
+		vkCmdCopyAccelerationStructureKHR = reinterpret_cast<PFN_vkCmdCopyAccelerationStructureKHR>(vkGetDeviceProcAddr(device->logicalDevice, "vkCmdCopyAccelerationStructureKHR"));
+
+		// Scratch offsets inside the shared arena need to respect the device's minimum alignment
+		VkPhysicalDeviceAccelerationStructurePropertiesKHR accelerationStructureProperties{};
+		accelerationStructureProperties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_ACCELERATION_STRUCTURE_PROPERTIES_KHR;
+		VkPhysicalDeviceProperties2 deviceProperties2{};
+		deviceProperties2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2;
+		deviceProperties2.pNext = &accelerationStructureProperties;
+		vkGetPhysicalDeviceProperties2(device->physicalDevice, &deviceProperties2);
+		scratchAlignment = std::max<VkDeviceSize>(accelerationStructureProperties.minAccelerationStructureScratchOffsetAlignment, 1);
+	}
+
+	/**
+	* Release all acceleration structures and buffers owned by the manager
+	*/
+	void AccelerationStructureManager::destroy()
+	{
+		for (auto &accelerationStructure : bottomLevel) {
+			deleteAccelerationStructure(accelerationStructure);
+		}
+		bottomLevel.clear();
+		pendingBottomLevelInputs.clear();
+		if (topLevel.handle != VK_NULL_HANDLE) {
+			deleteAccelerationStructure(topLevel);
+		}
+		instancesBuffer.destroy();
+		topLevelScratchBuffer.destroy();
+	}
+
+	uint64_t AccelerationStructureManager::getBufferDeviceAddress(VkBuffer buffer)
+	{
+		VkBufferDeviceAddressInfoKHR bufferDeviceAI{};
+		bufferDeviceAI.sType = VK_STRUCTURE_TYPE_BUFFER_DEVICE_ADDRESS_INFO;
+		bufferDeviceAI.buffer = buffer;
+		return vkGetBufferDeviceAddressKHR(device->logicalDevice, &bufferDeviceAI);
+	}
+
+	void AccelerationStructureManager::createAccelerationStructure(AccelerationStructure &accelerationStructure, VkAccelerationStructureTypeKHR type, VkDeviceSize size)
+	{
+		VK_CHECK_RESULT(device->createBuffer(
+			VK_BUFFER_USAGE_ACCELERATION_STRUCTURE_STORAGE_BIT_KHR | VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT,
+			VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+			&accelerationStructure.buffer,
+			size));
+		VkAccelerationStructureCreateInfoKHR accelerationStructureCI{};
+		accelerationStructureCI.sType = VK_STRUCTURE_TYPE_ACCELERATION_STRUCTURE_CREATE_INFO_KHR;
+		accelerationStructureCI.buffer = accelerationStructure.buffer.buffer;
+		accelerationStructureCI.size = size;
+		accelerationStructureCI.type = type;
+		VK_CHECK_RESULT(vkCreateAccelerationStructureKHR(device->logicalDevice, &accelerationStructureCI, nullptr, &accelerationStructure.handle));
+		VkAccelerationStructureDeviceAddressInfoKHR accelerationDeviceAddressInfo{};
+		accelerationDeviceAddressInfo.sType = VK_STRUCTURE_TYPE_ACCELERATION_STRUCTURE_DEVICE_ADDRESS_INFO_KHR;
+		accelerationDeviceAddressInfo.accelerationStructure = accelerationStructure.handle;
+		accelerationStructure.deviceAddress = vkGetAccelerationStructureDeviceAddressKHR(device->logicalDevice, &accelerationDeviceAddressInfo);
+	}
+
+	void AccelerationStructureManager::deleteAccelerationStructure(AccelerationStructure &accelerationStructure)
+	{
+		vkDestroyAccelerationStructureKHR(device->logicalDevice, accelerationStructure.handle, nullptr);
+		accelerationStructure.buffer.destroy();
+		accelerationStructure.handle = VK_NULL_HANDLE;
+		accelerationStructure.deviceAddress = 0;
+	}
+
+	/**
+	* Make acceleration structure writes visible to later builds, copies, property queries and ray traversal
+	* Also required between consecutive build batches, as these reuse the same scratch arena
+	*/
+	void AccelerationStructureManager::insertBuildBarrier(VkCommandBuffer commandBuffer, VkPipelineStageFlags dstStageMask)
+	{
+		VkMemoryBarrier memoryBarrier = vks::initializers::memoryBarrier();
+		memoryBarrier.srcAccessMask = VK_ACCESS_ACCELERATION_STRUCTURE_WRITE_BIT_KHR;
+		memoryBarrier.dstAccessMask = VK_ACCESS_ACCELERATION_STRUCTURE_READ_BIT_KHR | VK_ACCESS_ACCELERATION_STRUCTURE_WRITE_BIT_KHR;
+		vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_ACCELERATION_STRUCTURE_BUILD_BIT_KHR, dstStageMask, 0, 1, &memoryBarrier, 0, nullptr, 0, nullptr);
+	}
+
+	/**
+	* Queue a bottom level acceleration structure for the next call to buildBottomLevel
+	*
+	* @param geometries Geometries making up the acceleration structure, buffers referenced by them must stay alive until the build has finished
+	* @param buildRanges Build range for each of the geometries
+	* @param flags (Optional) Build flags, compaction is requested automatically if enabled for the manager
+	*
+	* @return Index of the acceleration structure in the bottomLevel list once built
+	*/
+	uint32_t AccelerationStructureManager::addBottomLevel(const std::vector<VkAccelerationStructureGeometryKHR> &geometries, const std::vector<VkAccelerationStructureBuildRangeInfoKHR> &buildRanges, VkBuildAccelerationStructureFlagsKHR flags)
+	{
+		assert(geometries.size() == buildRanges.size());
+		BottomLevelInput input{};
+		input.geometries = geometries;
+		input.buildRanges = buildRanges;
+		input.flags = flags;
+		pendingBottomLevelInputs.push_back(input);
+		return static_cast<uint32_t>(bottomLevel.size() + pendingBottomLevelInputs.size() - 1);
+	}
+
+	/**
+	* Build all queued bottom level acceleration structures
+	*
+	* All builds are recorded into a single command buffer. Scratch memory is sub-allocated from one shared arena,
+	* builds that don't fit into the scratch budget are split into batches that reuse the arena after a barrier.
+	* If compaction is enabled, the compacted sizes are queried in the same submission and the acceleration structures
+	* are then copied into right-sized buffers with a second submission.
+	*/
+	void AccelerationStructureManager::buildBottomLevel()
+	{
+		if (pendingBottomLevelInputs.empty()) {
+			return;
+		}
+
+		auto tStart = std::chrono::high_resolution_clock::now();
+
+		const uint32_t firstIndex = static_cast<uint32_t>(bottomLevel.size());
+		const uint32_t count = static_cast<uint32_t>(pendingBottomLevelInputs.size());
+		bottomLevel.resize(firstIndex + count);
+
+		std::vector<VkAccelerationStructureBuildGeometryInfoKHR> buildInfos(count);
+		std::vector<const VkAccelerationStructureBuildRangeInfoKHR*> buildRangePointers(count);
+		std::vector<VkDeviceSize> scratchSizes(count);
+		std::vector<VkAccelerationStructureKHR> handles(count);
+
+		for (uint32_t i = 0; i < count; i++) {
+			BottomLevelInput &input = pendingBottomLevelInputs[i];
+			VkAccelerationStructureBuildGeometryInfoKHR &buildInfo = buildInfos[i];
+			buildInfo = vks::initializers::accelerationStructureBuildGeometryInfoKHR();
+			buildInfo.type = VK_ACCELERATION_STRUCTURE_TYPE_BOTTOM_LEVEL_KHR;
+			buildInfo.flags = input.flags;
+			if (compaction) {
+				buildInfo.flags |= VK_BUILD_ACCELERATION_STRUCTURE_ALLOW_COMPACTION_BIT_KHR;
+			}
+			buildInfo.mode = VK_BUILD_ACCELERATION_STRUCTURE_MODE_BUILD_KHR;
+			buildInfo.geometryCount = static_cast<uint32_t>(input.geometries.size());
+			buildInfo.pGeometries = input.geometries.data();
+
+			std::vector<uint32_t> maxPrimitiveCounts(input.buildRanges.size());
+			for (size_t j = 0; j < input.buildRanges.size(); j++) {
+				maxPrimitiveCounts[j] = input.buildRanges[j].primitiveCount;
+			}
+			VkAccelerationStructureBuildSizesInfoKHR buildSizesInfo = vks::initializers::accelerationStructureBuildSizesInfoKHR();
+			vkGetAccelerationStructureBuildSizesKHR(device->logicalDevice, VK_ACCELERATION_STRUCTURE_BUILD_TYPE_DEVICE_KHR, &buildInfo, maxPrimitiveCounts.data(), &buildSizesInfo);
+
+			createAccelerationStructure(bottomLevel[firstIndex + i], VK_ACCELERATION_STRUCTURE_TYPE_BOTTOM_LEVEL_KHR, buildSizesInfo.accelerationStructureSize);
+			buildInfo.dstAccelerationStructure = bottomLevel[firstIndex + i].handle;
+			handles[i] = bottomLevel[firstIndex + i].handle;
+			buildRangePointers[i] = input.buildRanges.data();
+			scratchSizes[i] = vks::tools::alignedVkSize(buildSizesInfo.buildScratchSize, scratchAlignment);
+			statistics.memoryBeforeCompaction += buildSizesInfo.accelerationStructureSize;
+		}
+
+		// Split the builds into batches whose combined scratch requirements fit into the budget
+		// A single build larger than the budget gets a batch of its own
+		std::vector<uint32_t> batchStarts;
+		VkDeviceSize batchScratchSize = 0;
+		VkDeviceSize arenaSize = 0;
+		for (uint32_t i = 0; i < count; i++) {
+			if (batchStarts.empty() || (batchScratchSize + scratchSizes[i] > scratchBudget)) {
+				batchStarts.push_back(i);
+				batchScratchSize = 0;
+			}
+			batchScratchSize += scratchSizes[i];
+			arenaSize = std::max(arenaSize, batchScratchSize);
+		}
+		batchStarts.push_back(count);
+
+		// Shared scratch arena, over-allocated so the base address can be aligned
+		vks::Buffer scratchArena;
+		VK_CHECK_RESULT(device->createBuffer(
+			VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT,
+			VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+			&scratchArena,
+			arenaSize + scratchAlignment));
+		const uint64_t scratchBaseAddress = vks::tools::alignedVkSize(getBufferDeviceAddress(scratchArena.buffer), scratchAlignment);
+
+		VkQueryPool queryPool = VK_NULL_HANDLE;
+		if (compaction) {
+			VkQueryPoolCreateInfo queryPoolCI{};
+			queryPoolCI.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+			queryPoolCI.queryType = VK_QUERY_TYPE_ACCELERATION_STRUCTURE_COMPACTED_SIZE_KHR;
+			queryPoolCI.queryCount = count;
+			VK_CHECK_RESULT(vkCreateQueryPool(device->logicalDevice, &queryPoolCI, nullptr, &queryPool));
+		}
+
+		VkCommandBuffer commandBuffer = device->createCommandBuffer(VK_COMMAND_BUFFER_LEVEL_PRIMARY, true);
+		if (compaction) {
+			vkCmdResetQueryPool(commandBuffer, queryPool, 0, count);
+		}
+		for (size_t batch = 0; batch + 1 < batchStarts.size(); batch++) {
+			const uint32_t start = batchStarts[batch];
+			const uint32_t end = batchStarts[batch + 1];
+			VkDeviceSize scratchOffset = 0;
+			for (uint32_t i = start; i < end; i++) {
+				buildInfos[i].scratchData.deviceAddress = scratchBaseAddress + scratchOffset;
+				scratchOffset += scratchSizes[i];
+			}
+			vkCmdBuildAccelerationStructuresKHR(commandBuffer, end - start, &buildInfos[start], &buildRangePointers[start]);
+			// The next batch reuses the scratch arena and the compaction query reads the finished acceleration structures
+			insertBuildBarrier(commandBuffer, VK_PIPELINE_STAGE_ACCELERATION_STRUCTURE_BUILD_BIT_KHR);
+		}
+		if (compaction) {
+			vkCmdWriteAccelerationStructuresPropertiesKHR(commandBuffer, count, handles.data(), VK_QUERY_TYPE_ACCELERATION_STRUCTURE_COMPACTED_SIZE_KHR, queryPool, 0);
+		}
+		device->flushCommandBuffer(commandBuffer, queue);
+
+		scratchArena.destroy();
+
+		statistics.bottomLevelCount += count;
+		statistics.batchCount += static_cast<uint32_t>(batchStarts.size() - 1);
+		statistics.scratchSize = std::max(statistics.scratchSize, arenaSize);
+		statistics.buildTime += std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - tStart).count();
+
+		if (compaction) {
+			compactBottomLevel(queryPool, firstIndex, count);
+			vkDestroyQueryPool(device->logicalDevice, queryPool, nullptr);
+		} else {
+			statistics.memoryAfterCompaction = statistics.memoryBeforeCompaction;
+		}
+
+		pendingBottomLevelInputs.clear();
+	}
+
+	/**
+	* Copy freshly built bottom level acceleration structures into buffers sized to their compacted size
+	*/
+	void AccelerationStructureManager::compactBottomLevel(VkQueryPool queryPool, uint32_t firstIndex, uint32_t count)
+	{
+		auto tStart = std::chrono::high_resolution_clock::now();
+
+		std::vector<VkDeviceSize> compactedSizes(count);
+		VK_CHECK_RESULT(vkGetQueryPoolResults(device->logicalDevice, queryPool, 0, count, count * sizeof(VkDeviceSize), compactedSizes.data(), sizeof(VkDeviceSize), VK_QUERY_RESULT_64_BIT | VK_QUERY_RESULT_WAIT_BIT));
+
+		std::vector<AccelerationStructure> compacted(count);
+		VkCommandBuffer commandBuffer = device->createCommandBuffer(VK_COMMAND_BUFFER_LEVEL_PRIMARY, true);
+		for (uint32_t i = 0; i < count; i++) {
+			createAccelerationStructure(compacted[i], VK_ACCELERATION_STRUCTURE_TYPE_BOTTOM_LEVEL_KHR, compactedSizes[i]);
+			VkCopyAccelerationStructureInfoKHR copyInfo{};
+			copyInfo.sType = VK_STRUCTURE_TYPE_COPY_ACCELERATION_STRUCTURE_INFO_KHR;
+			copyInfo.src = bottomLevel[firstIndex + i].handle;
+			copyInfo.dst = compacted[i].handle;
+			copyInfo.mode = VK_COPY_ACCELERATION_STRUCTURE_MODE_COMPACT_KHR;
+			vkCmdCopyAccelerationStructureKHR(commandBuffer, &copyInfo);
+			statistics.memoryAfterCompaction += compactedSizes[i];
+		}
+		device->flushCommandBuffer(commandBuffer, queue);
+
+		for (uint32_t i = 0; i < count; i++) {
+			deleteAccelerationStructure(bottomLevel[firstIndex + i]);
+			bottomLevel[firstIndex + i] = compacted[i];
+		}
+
+		statistics.compactionTime += std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - tStart).count();
+	}
+
+	/**
+	* (Re)build the top level acceleration structure from a list of instances
+	*
+	* @param instances Instances referencing bottom level acceleration structures by device address
+	* @param allowUpdate (Optional) If true, the acceleration structure can be refit with updateTopLevel as long as the instance count doesn't change
+	*/
+	void AccelerationStructureManager::buildTopLevel(const std::vector<VkAccelerationStructureInstanceKHR> &instances, bool allowUpdate)
+	{
+		auto tStart = std::chrono::high_resolution_clock::now();
+
+		if (topLevel.handle != VK_NULL_HANDLE) {
+			deleteAccelerationStructure(topLevel);
+		}
+		instancesBuffer.destroy();
+		topLevelScratchBuffer.destroy();
+
+		topLevelInstanceCount = static_cast<uint32_t>(instances.size());
+		topLevelFlags = VK_BUILD_ACCELERATION_STRUCTURE_PREFER_FAST_TRACE_BIT_KHR;
+		if (allowUpdate) {
+			topLevelFlags |= VK_BUILD_ACCELERATION_STRUCTURE_ALLOW_UPDATE_BIT_KHR;
+		}
+
+		// The instance buffer stays persistently mapped so refits only need to copy the new transforms
+		VK_CHECK_RESULT(device->createBuffer(
+			VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT | VK_BUFFER_USAGE_ACCELERATION_STRUCTURE_BUILD_INPUT_READ_ONLY_BIT_KHR,
+			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+			&instancesBuffer,
+			std::max<VkDeviceSize>(instances.size(), 1) * sizeof(VkAccelerationStructureInstanceKHR)));
+		VK_CHECK_RESULT(instancesBuffer.map());
+		if (!instances.empty()) {
+			memcpy(instancesBuffer.mapped, instances.data(), instances.size() * sizeof(VkAccelerationStructureInstanceKHR));
+		}
+
+		VkAccelerationStructureGeometryKHR geometry = vks::initializers::accelerationStructureGeometryKHR();
+		geometry.geometryType = VK_GEOMETRY_TYPE_INSTANCES_KHR;
+		geometry.flags = VK_GEOMETRY_OPAQUE_BIT_KHR;
+		geometry.geometry.instances.sType = VK_STRUCTURE_TYPE_ACCELERATION_STRUCTURE_GEOMETRY_INSTANCES_DATA_KHR;
+		geometry.geometry.instances.arrayOfPointers = VK_FALSE;
+		geometry.geometry.instances.data.deviceAddress = getBufferDeviceAddress(instancesBuffer.buffer);
+
+		VkAccelerationStructureBuildGeometryInfoKHR buildInfo = vks::initializers::accelerationStructureBuildGeometryInfoKHR();
+		buildInfo.type = VK_ACCELERATION_STRUCTURE_TYPE_TOP_LEVEL_KHR;
+		buildInfo.flags = topLevelFlags;
+		buildInfo.mode = VK_BUILD_ACCELERATION_STRUCTURE_MODE_BUILD_KHR;
+		buildInfo.geometryCount = 1;
+		buildInfo.pGeometries = &geometry;
+
+		VkAccelerationStructureBuildSizesInfoKHR buildSizesInfo = vks::initializers::accelerationStructureBuildSizesInfoKHR();
+		vkGetAccelerationStructureBuildSizesKHR(device->logicalDevice, VK_ACCELERATION_STRUCTURE_BUILD_TYPE_DEVICE_KHR, &buildInfo, &topLevelInstanceCount, &buildSizesInfo);
+
+		createAccelerationStructure(topLevel, VK_ACCELERATION_STRUCTURE_TYPE_TOP_LEVEL_KHR, buildSizesInfo.accelerationStructureSize);
+
+		// Scratch memory is kept for refits, so size it for both build and update
+		VK_CHECK_RESULT(device->createBuffer(
+			VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT,
+			VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+			&topLevelScratchBuffer,
+			std::max(buildSizesInfo.buildScratchSize, buildSizesInfo.updateScratchSize) + scratchAlignment));
+
+		buildInfo.dstAccelerationStructure = topLevel.handle;
+		buildInfo.scratchData.deviceAddress = vks::tools::alignedVkSize(getBufferDeviceAddress(topLevelScratchBuffer.buffer), scratchAlignment);
+
+		VkAccelerationStructureBuildRangeInfoKHR buildRange{};
+		buildRange.primitiveCount = topLevelInstanceCount;
+		const VkAccelerationStructureBuildRangeInfoKHR *buildRangePointer = &buildRange;
+
+		VkCommandBuffer commandBuffer = device->createCommandBuffer(VK_COMMAND_BUFFER_LEVEL_PRIMARY, true);
+		vkCmdBuildAccelerationStructuresKHR(commandBuffer, 1, &buildInfo, &buildRangePointer);
+		device->flushCommandBuffer(commandBuffer, queue);
+
+		statistics.topLevelBuildTime = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - tStart).count();
+	}
+
+	/**
+	* Record a refit of the top level acceleration structure with updated instance transforms
+	*
+	* @param commandBuffer Command buffer to record the update into, must be recorded before any ray traversal of the current frame
+	* @param instances Updated instances, count must match the one passed to buildTopLevel
+	*
+	* @note The instance buffer is written from the host immediately, so the previous frame must not be in flight anymore
+	*/
+	void AccelerationStructureManager::updateTopLevel(VkCommandBuffer commandBuffer, const std::vector<VkAccelerationStructureInstanceKHR> &instances)
+	{
+		assert(topLevel.handle != VK_NULL_HANDLE);
+		assert(topLevelFlags & VK_BUILD_ACCELERATION_STRUCTURE_ALLOW_UPDATE_BIT_KHR);
+		assert(instances.size() == topLevelInstanceCount);
+
+		memcpy(instancesBuffer.mapped, instances.data(), instances.size() * sizeof(VkAccelerationStructureInstanceKHR));
+
+		VkAccelerationStructureGeometryKHR geometry = vks::initializers::accelerationStructureGeometryKHR();
+		geometry.geometryType = VK_GEOMETRY_TYPE_INSTANCES_KHR;
+		geometry.flags = VK_GEOMETRY_OPAQUE_BIT_KHR;
+		geometry.geometry.instances.sType = VK_STRUCTURE_TYPE_ACCELERATION_STRUCTURE_GEOMETRY_INSTANCES_DATA_KHR;
+		geometry.geometry.instances.arrayOfPointers = VK_FALSE;
+		geometry.geometry.instances.data.deviceAddress = getBufferDeviceAddress(instancesBuffer.buffer);
+
+		VkAccelerationStructureBuildGeometryInfoKHR buildInfo = vks::initializers::accelerationStructureBuildGeometryInfoKHR();
+		buildInfo.type = VK_ACCELERATION_STRUCTURE_TYPE_TOP_LEVEL_KHR;
+		buildInfo.flags = topLevelFlags;
+		buildInfo.mode = VK_BUILD_ACCELERATION_STRUCTURE_MODE_UPDATE_KHR;
+		buildInfo.srcAccelerationStructure = topLevel.handle;
+		buildInfo.dstAccelerationStructure = topLevel.handle;
+		buildInfo.geometryCount = 1;
+		buildInfo.pGeometries = &geometry;
+		buildInfo.scratchData.deviceAddress = vks::tools::alignedVkSize(getBufferDeviceAddress(topLevelScratchBuffer.buffer), scratchAlignment);
+
+		VkAccelerationStructureBuildRangeInfoKHR buildRange{};
+		buildRange.primitiveCount = topLevelInstanceCount;
+		const VkAccelerationStructureBuildRangeInfoKHR *buildRangePointer = &buildRange;
+
+		vkCmdBuildAccelerationStructuresKHR(commandBuffer, 1, &buildInfo, &buildRangePointer);
+		insertBuildBarrier(commandBuffer, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT);
+
+		statistics.topLevelUpdates++;
+	}
+}
@@ -0,0 +1,98 @@
+/*
+* Vulkan acceleration structure manager
+*
+* Batches bottom level acceleration structure builds into a single submission using a shared scratch arena,
+* compacts them and keeps an updatable top level acceleration structure for per-frame refits
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#pragma once
+
+#include <vector>
+#include <chrono>
+
+#include "vulkan/vulkan.h"
+#include "VulkanDevice.h"
+#include "VulkanBuffer.h"
+#include "VulkanTools.h"
+
+namespace vks
+{
+	/** @brief Acceleration structure handle along with the buffer backing it */
+	struct AccelerationStructure
+	{
+		VkAccelerationStructureKHR handle = VK_NULL_HANDLE;
+		uint64_t deviceAddress = 0;
+		vks::Buffer buffer;
+	};
+
+	class AccelerationStructureManager
+	{
+	private:
+		struct BottomLevelInput
+		{
+			std::vector<VkAccelerationStructureGeometryKHR> geometries;
+			std::vector<VkAccelerationStructureBuildRangeInfoKHR> buildRanges;
+			VkBuildAccelerationStructureFlagsKHR flags;
+		};
+
+		vks::VulkanDevice *device = nullptr;
+		VkQueue queue = VK_NULL_HANDLE;
+		VkDeviceSize scratchAlignment = 256;
+
+		std::vector<BottomLevelInput> pendingBottomLevelInputs;
+
+		// Top level state kept alive for refits
+		vks::Buffer instancesBuffer;
+		vks::Buffer topLevelScratchBuffer;
+		uint32_t topLevelInstanceCount = 0;
+		VkBuildAccelerationStructureFlagsKHR topLevelFlags = 0;
+
+		PFN_vkGetBufferDeviceAddressKHR vkGetBufferDeviceAddressKHR;
+		PFN_vkCreateAccelerationStructureKHR vkCreateAccelerationStructureKHR;
+		PFN_vkDestroyAccelerationStructureKHR vkDestroyAccelerationStructureKHR;
+		PFN_vkGetAccelerationStructureBuildSizesKHR vkGetAccelerationStructureBuildSizesKHR;
+		PFN_vkGetAccelerationStructureDeviceAddressKHR vkGetAccelerationStructureDeviceAddressKHR;
+		PFN_vkCmdBuildAccelerationStructuresKHR vkCmdBuildAccelerationStructuresKHR;
+		PFN_vkCmdWriteAccelerationStructuresPropertiesKHR vkCmdWriteAccelerationStructuresPropertiesKHR;
+		PFN_vkCmdCopyAccelerationStructureKHR vkCmdCopyAccelerationStructureKHR;
+
+		uint64_t getBufferDeviceAddress(VkBuffer buffer);
+		void createAccelerationStructure(AccelerationStructure &accelerationStructure, VkAccelerationStructureTypeKHR type, VkDeviceSize size);
+		void deleteAccelerationStructure(AccelerationStructure &accelerationStructure);
+		void insertBuildBarrier(VkCommandBuffer commandBuffer, VkPipelineStageFlags dstStageMask);
+		void compactBottomLevel(VkQueryPool queryPool, uint32_t firstIndex, uint32_t count);
+	public:
+		/** @brief Build and compaction figures of the last bottom level build and top level updates */
+		struct Statistics
+		{
+			uint32_t bottomLevelCount = 0;
+			uint32_t batchCount = 0;
+			VkDeviceSize scratchSize = 0;
+			VkDeviceSize memoryBeforeCompaction = 0;
+			VkDeviceSize memoryAfterCompaction = 0;
+			double buildTime = 0.0;
+			double compactionTime = 0.0;
+			double topLevelBuildTime = 0.0;
+			uint32_t topLevelUpdates = 0;
+		} statistics;
+
+		/** @brief Upper limit for the shared scratch arena, builds that don't fit into it are split into consecutive batches */
+		VkDeviceSize scratchBudget = 64 * 1024 * 1024;
+		/** @brief Compact bottom level acceleration structures after they have been built */
+		bool compaction = true;
+
+		std::vector<AccelerationStructure> bottomLevel;
+		AccelerationStructure topLevel;
+
+		void prepare(vks::VulkanDevice *device, VkQueue queue);
+		void destroy();
+
+		uint32_t addBottomLevel(const std::vector<VkAccelerationStructureGeometryKHR> &geometries, const std::vector<VkAccelerationStructureBuildRangeInfoKHR> &buildRanges, VkBuildAccelerationStructureFlagsKHR flags = VK_BUILD_ACCELERATION_STRUCTURE_PREFER_FAST_TRACE_BIT_KHR);
+		void buildBottomLevel();
+
+		void buildTopLevel(const std::vector<VkAccelerationStructureInstanceKHR> &instances, bool allowUpdate = true);
+		void updateTopLevel(VkCommandBuffer commandBuffer, const std::vector<VkAccelerationStructureInstanceKHR> &instances);
+	};
+}
@@ -0,0 +1,484 @@
+/*
+* Vulkan async compute scheduling
+*
+* Runs compute command buffers on a dedicated compute queue (or a second queue of the graphics family) concurrently
+* with graphics. Buffers written by compute and read by graphics are double buffered, compute fills one copy
+* while graphics renders the results of the previous frame from the other one, with queue family ownership
+* transfers between both queues. Submissions are ordered with timeline semaphores if supported and binary
+* semaphores otherwise. Timestamps of both queues are used to measure how much of the compute work overlaps graphics
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#include "VulkanAsyncCompute.h"
+
+#include <algorithm>
+
+namespace vks
+{
+	namespace
+	{
+		VkBufferMemoryBarrier bufferBarrier(VkBuffer buffer, VkAccessFlags srcAccessMask, VkAccessFlags dstAccessMask, uint32_t srcQueueFamilyIndex, uint32_t dstQueueFamilyIndex)
+		{
+			VkBufferMemoryBarrier barrier = vks::initializers::bufferMemoryBarrier();
+			barrier.srcAccessMask = srcAccessMask;
+			barrier.dstAccessMask = dstAccessMask;
+			barrier.srcQueueFamilyIndex = srcQueueFamilyIndex;
+			barrier.dstQueueFamilyIndex = dstQueueFamilyIndex;
+			barrier.buffer = buffer;
+			barrier.size = VK_WHOLE_SIZE;
+			return barrier;
+		}
+	}
+
+	/**
+	* Enable timeline semaphores for device creation if the device supports them, has to be called before the logical device is created
+	* The feature structure is prepended to the pNext chain, which therefore must not already contain a VkPhysicalDeviceVulkan12Features structure
+	*
+	* @param device Device whose physical device is checked for support
+	* @param apiVersion Vulkan version requested for the instance
+	* @param enabledExtensions Device extensions of the example, the timeline semaphore extension is added if it's not part of the core version
+	* @param pNextChain pNext chain passed to device creation
+	*/
+	void AsyncCompute::requestFeatures(vks::VulkanDevice *device, uint32_t apiVersion, std::vector<const char*> &enabledExtensions, void *&pNextChain)
+	{
+		timelineEnabled = false;
+		// Device level functionality is limited by the version requested for the instance, querying the feature requires Vulkan 1.1
+		const uint32_t version = std::min(apiVersion, device->properties.apiVersion);
+		if (version < VK_API_VERSION_1_1) {
+			return;
+		}
+		const bool core = version >= VK_API_VERSION_1_2;
+		if (!core && !device->extensionSupported(VK_KHR_TIMELINE_SEMAPHORE_EXTENSION_NAME)) {
+			return;
+		}
+
+		timelineFeatures = {};
+		timelineFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_TIMELINE_SEMAPHORE_FEATURES_KHR;
+		VkPhysicalDeviceFeatures2 features2{};
+		features2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+		features2.pNext = &timelineFeatures;
+		vkGetPhysicalDeviceFeatures2(device->physicalDevice, &features2);
+		if (!timelineFeatures.timelineSemaphore) {
+			return;
+		}
+
+		if (!core) {
+			enabledExtensions.push_back(VK_KHR_TIMELINE_SEMAPHORE_EXTENSION_NAME);
+		}
+		timelineFeatures.pNext = pNextChain;
+		pNextChain = &timelineFeatures;
+		timelineEnabled = true;
+	}
+
+	/**
+	* Get the compute queue and create the synchronization primitives
+	*
+	* @param device Logical device created with compute queues requested
+	* @param graphicsQueue Queue the graphics work of the example is submitted to
+	*/
+	void AsyncCompute::prepare(vks::VulkanDevice *device, VkQueue graphicsQueue)
+	{
+		this->device = device;
+		this->graphicsQueue = graphicsQueue;
+		graphicsQueueFamilyIndex = device->queueFamilyIndices.graphics;
+		// VulkanDevice prefers a compute family without graphics support, and requests a second queue if compute has to share the graphics family
+		queueFamilyIndex = device->queueFamilyIndices.compute;
+		vkGetDeviceQueue(device->logicalDevice, queueFamilyIndex, device->computeQueueIndex, &queue);
+		commandPool = device->createCommandPool(queueFamilyIndex);
+
+		VkSemaphoreCreateInfo semaphoreCreateInfo = vks::initializers::semaphoreCreateInfo();
+		if (timelineEnabled) {
+			VkSemaphoreTypeCreateInfoKHR semaphoreTypeCreateInfo{};
+			semaphoreTypeCreateInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_TYPE_CREATE_INFO_KHR;
+			semaphoreTypeCreateInfo.semaphoreType = VK_SEMAPHORE_TYPE_TIMELINE_KHR;
+			semaphoreTypeCreateInfo.initialValue = 0;
+			semaphoreCreateInfo.pNext = &semaphoreTypeCreateInfo;
+			VK_CHECK_RESULT(vkCreateSemaphore(device->logicalDevice, &semaphoreCreateInfo, nullptr, &computeTimeline));
+			VK_CHECK_RESULT(vkCreateSemaphore(device->logicalDevice, &semaphoreCreateInfo, nullptr, &graphicsTimeline));
+		}
+		else {
+			for (uint32_t i = 0; i < slotCount; i++) {
+				VK_CHECK_RESULT(vkCreateSemaphore(device->logicalDevice, &semaphoreCreateInfo, nullptr, &computeComplete[i]));
+				VK_CHECK_RESULT(vkCreateSemaphore(device->logicalDevice, &semaphoreCreateInfo, nullptr, &graphicsComplete[i]));
+			}
+		}
+		VkFenceCreateInfo fenceCreateInfo = vks::initializers::fenceCreateInfo(VK_FENCE_CREATE_SIGNALED_BIT);
+		VK_CHECK_RESULT(vkCreateFence(device->logicalDevice, &fenceCreateInfo, nullptr, &computeFence));
+
+		// Overlap can only be measured if both queue families write timestamps
+		timestampsSupported = device->properties.limits.timestampComputeAndGraphics &&
+			(device->queueFamilyProperties[queueFamilyIndex].timestampValidBits > 0) &&
+			(device->queueFamilyProperties[graphicsQueueFamilyIndex].timestampValidBits > 0);
+		if (timestampsSupported) {
+			VkQueryPoolCreateInfo queryPoolInfo{};
+			queryPoolInfo.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+			queryPoolInfo.queryType = VK_QUERY_TYPE_TIMESTAMP;
+			queryPoolInfo.queryCount = 4 * slotCount;
+			VK_CHECK_RESULT(vkCreateQueryPool(device->logicalDevice, &queryPoolInfo, nullptr, &queryPool));
+		}
+
+		frameIndex = 0;
+		statistics = {};
+	}
+
+	void AsyncCompute::destroy()
+	{
+		if (!device) {
+			return;
+		}
+		for (auto &sharedBuffer : sharedBuffers) {
+			for (auto &slot : sharedBuffer.slots) {
+				slot.destroy();
+			}
+		}
+		sharedBuffers.clear();
+		vkDestroySemaphore(device->logicalDevice, computeTimeline, nullptr);
+		vkDestroySemaphore(device->logicalDevice, graphicsTimeline, nullptr);
+		for (uint32_t i = 0; i < slotCount; i++) {
+			vkDestroySemaphore(device->logicalDevice, computeComplete[i], nullptr);
+			vkDestroySemaphore(device->logicalDevice, graphicsComplete[i], nullptr);
+		}
+		vkDestroyFence(device->logicalDevice, computeFence, nullptr);
+		if (queryPool != VK_NULL_HANDLE) {
+			vkDestroyQueryPool(device->logicalDevice, queryPool, nullptr);
+		}
+		vkDestroyCommandPool(device->logicalDevice, commandPool, nullptr);
+		computeTimeline = graphicsTimeline = VK_NULL_HANDLE;
+		computeComplete = {};
+		graphicsComplete = {};
+		computeFence = VK_NULL_HANDLE;
+		queryPool = VK_NULL_HANDLE;
+		commandPool = VK_NULL_HANDLE;
+		device = nullptr;
+	}
+
+	bool AsyncCompute::timelineSemaphores() const
+	{
+		return timelineEnabled;
+	}
+
+	/** @brief True if compute work is submitted to a different queue than graphics and can run concurrently */
+	bool AsyncCompute::separateQueue() const
+	{
+		return queue != graphicsQueue;
+	}
+
+	/** @brief True if compute and graphics queues belong to different families, shared buffers then need ownership transfers */
+	bool AsyncCompute::ownershipTransfers() const
+	{
+		return queueFamilyIndex != graphicsQueueFamilyIndex;
+	}
+
+	/**
+	* Add a buffer that's written on the compute queue and read by graphics
+	* The service creates one copy per slot, at the end of every compute frame the source is copied to the slot of that frame
+	* Must be called before the first frame, the source has to be owned by the compute queue family
+	*
+	* @param source Compute owned buffer holding the simulation results, its current contents are what graphics shows in the first frame
+	* @param usage Usage of the copies on the graphics queue
+	* @param stageMask Graphics pipeline stages reading the copies
+	* @param accessMask Graphics accesses to the copies
+	*
+	* @return Index of the shared buffer
+	*/
+	uint32_t AsyncCompute::addSharedBuffer(const vks::Buffer &source, VkBufferUsageFlags usage, VkPipelineStageFlags stageMask, VkAccessFlags accessMask)
+	{
+		assert(frameIndex == 0);
+		SharedBuffer sharedBuffer;
+		sharedBuffer.source = source.buffer;
+		sharedBuffer.size = source.size;
+		for (auto &slot : sharedBuffer.slots) {
+			VK_CHECK_RESULT(device->createBuffer(usage | VK_BUFFER_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, &slot, source.size));
+		}
+		graphicsStageMask |= stageMask;
+		graphicsAccessMask |= accessMask;
+
+		// Graphics reads the other slot in the first frame, initialize it with the source and hand it over to graphics
+		const uint32_t readSlot = graphicsSlot();
+		VkCommandBuffer copyCmd = device->createCommandBuffer(VK_COMMAND_BUFFER_LEVEL_PRIMARY, commandPool, true);
+		VkBufferCopy copyRegion = {};
+		copyRegion.size = source.size;
+		vkCmdCopyBuffer(copyCmd, source.buffer, sharedBuffer.slots[readSlot].buffer, 1, &copyRegion);
+		if (ownershipTransfers()) {
+			VkBufferMemoryBarrier barrier = bufferBarrier(sharedBuffer.slots[readSlot].buffer, VK_ACCESS_TRANSFER_WRITE_BIT, 0, queueFamilyIndex, graphicsQueueFamilyIndex);
+			vkCmdPipelineBarrier(copyCmd, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, VK_FLAGS_NONE, 0, nullptr, 1, &barrier, 0, nullptr);
+		}
+		device->flushCommandBuffer(copyCmd, queue, commandPool);
+
+		// The remaining slots are released by graphics, so the acquire at the end of their first compute frame has a matching release
+		if (ownershipTransfers()) {
+			VkCommandBuffer releaseCmd = device->createCommandBuffer(VK_COMMAND_BUFFER_LEVEL_PRIMARY, true);
+			std::vector<VkBufferMemoryBarrier> barriers;
+			for (uint32_t i = 0; i < slotCount; i++) {
+				if (i != readSlot) {
+					barriers.push_back(bufferBarrier(sharedBuffer.slots[i].buffer, 0, 0, graphicsQueueFamilyIndex, queueFamilyIndex));
+				}
+			}
+			vkCmdPipelineBarrier(releaseCmd, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, VK_FLAGS_NONE, 0, nullptr, static_cast<uint32_t>(barriers.size()), barriers.data(), 0, nullptr);
+			device->flushCommandBuffer(releaseCmd, graphicsQueue);
+		}
+
+		sharedBuffers.push_back(sharedBuffer);
+		return static_cast<uint32_t>(sharedBuffers.size() - 1);
+	}
+
+	const vks::Buffer &AsyncCompute::sharedBuffer(uint32_t index, uint32_t slot) const
+	{
+		return sharedBuffers[index].slots[slot];
+	}
+
+	/** @brief Slot written by the compute work of the current frame */
+	uint32_t AsyncCompute::computeSlot() const
+	{
+		return static_cast<uint32_t>(frameIndex % slotCount);
+	}
+
+	/** @brief Slot read by the graphics work of the current frame, holds the results of the previous compute frame */
+	uint32_t AsyncCompute::graphicsSlot() const
+	{
+		return static_cast<uint32_t>((frameIndex + 1) % slotCount);
+	}
+
+	void AsyncCompute::ownershipBarriers(VkCommandBuffer commandBuffer, uint32_t slot, bool toGraphics, VkPipelineStageFlags srcStageMask, VkAccessFlags srcAccessMask, VkPipelineStageFlags dstStageMask, VkAccessFlags dstAccessMask)
+	{
+		if (!ownershipTransfers() || sharedBuffers.empty()) {
+			return;
+		}
+		const uint32_t srcQueueFamilyIndex = toGraphics ? queueFamilyIndex : graphicsQueueFamilyIndex;
+		const uint32_t dstQueueFamilyIndex = toGraphics ? graphicsQueueFamilyIndex : queueFamilyIndex;
+		std::vector<VkBufferMemoryBarrier> barriers;
+		for (auto &sharedBuffer : sharedBuffers) {
+			barriers.push_back(bufferBarrier(sharedBuffer.slots[slot].buffer, srcAccessMask, dstAccessMask, srcQueueFamilyIndex, dstQueueFamilyIndex));
+		}
+		vkCmdPipelineBarrier(commandBuffer, srcStageMask, dstStageMask, VK_FLAGS_NONE, 0, nullptr, static_cast<uint32_t>(barriers.size()), barriers.data(), 0, nullptr);
+	}
+
+	/**
+	* Record the start of a compute command buffer, has to be recorded before any work that writes the shared buffer sources
+	*
+	* @param commandBuffer Command buffer allocated from the service's command pool
+	* @param slot Slot the command buffer is submitted for, compute command buffers can be built once per slot
+	*/
+	void AsyncCompute::beginCompute(VkCommandBuffer commandBuffer, uint32_t slot)
+	{
+		// The sources must have been copied by the previous compute frame before the simulation overwrites them
+		vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_FLAGS_NONE, 0, nullptr, 0, nullptr, 0, nullptr);
+		if (timestampsSupported) {
+			vkCmdResetQueryPool(commandBuffer, queryPool, slot * 4, 2);
+			vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, queryPool, slot * 4);
+		}
+	}
+
+	/**
+	* Record the end of a compute command buffer
+	* Copies the sources written by compute shaders to the slot and releases it to graphics, the acquire from graphics is deferred
+	* up to here so the simulation itself doesn't have to wait for graphics to finish reading the slot
+	*/
+	void AsyncCompute::endCompute(VkCommandBuffer commandBuffer, uint32_t slot)
+	{
+		std::vector<VkBufferMemoryBarrier> barriers;
+		for (auto &sharedBuffer : sharedBuffers) {
+			barriers.push_back(bufferBarrier(sharedBuffer.source, VK_ACCESS_SHADER_WRITE_BIT, VK_ACCESS_TRANSFER_READ_BIT, VK_QUEUE_FAMILY_IGNORED, VK_QUEUE_FAMILY_IGNORED));
+			if (ownershipTransfers()) {
+				barriers.push_back(bufferBarrier(sharedBuffer.slots[slot].buffer, 0, VK_ACCESS_TRANSFER_WRITE_BIT, graphicsQueueFamilyIndex, queueFamilyIndex));
+			}
+		}
+		if (!barriers.empty()) {
+			// The transfer stage is part of the source scope to chain with the semaphore wait for graphics
+			vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_FLAGS_NONE, 0, nullptr, static_cast<uint32_t>(barriers.size()), barriers.data(), 0, nullptr);
+		}
+		for (auto &sharedBuffer : sharedBuffers) {
+			VkBufferCopy copyRegion = {};
+			copyRegion.size = sharedBuffer.size;
+			vkCmdCopyBuffer(commandBuffer, sharedBuffer.source, sharedBuffer.slots[slot].buffer, 1, &copyRegion);
+		}
+		ownershipBarriers(commandBuffer, slot, true, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_WRITE_BIT, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0);
+		if (timestampsSupported) {
+			vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, queryPool, slot * 4 + 1);
+		}
+	}
+
+	/**
+	* Record the start of the graphics command buffer of the current frame (outside of a render pass)
+	* Graphics command buffers bind the shared buffers of graphicsSlot() and therefore need to be recorded every frame
+	*/
+	void AsyncCompute::beginGraphics(VkCommandBuffer commandBuffer)
+	{
+		const uint32_t query = computeSlot() * 4 + 2;
+		if (timestampsSupported) {
+			vkCmdResetQueryPool(commandBuffer, queryPool, query, 2);
+			vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, queryPool, query);
+		}
+		ownershipBarriers(commandBuffer, graphicsSlot(), true, graphicsStageMask, 0, graphicsStageMask, graphicsAccessMask);
+	}
+
+	/** @brief Record the end of the graphics command buffer of the current frame, releases the slot back to compute */
+	void AsyncCompute::endGraphics(VkCommandBuffer commandBuffer)
+	{
+		ownershipBarriers(commandBuffer, graphicsSlot(), false, graphicsStageMask, 0, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0);
+		if (timestampsSupported) {
+			vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, queryPool, computeSlot() * 4 + 3);
+		}
+	}
+
+	/**
+	* Wait for the compute work of the previous frame, after this the example can update the uniforms read by compute
+	* Also collects the timestamps of the previous frame
+	*/
+	void AsyncCompute::beginFrame()
+	{
+		VK_CHECK_RESULT(vkWaitForFences(device->logicalDevice, 1, &computeFence, VK_TRUE, UINT64_MAX));
+		if (timestampsSupported && (frameIndex > 0)) {
+			readTimestamps(static_cast<uint32_t>((frameIndex - 1) % slotCount));
+		}
+	}
+
+	void AsyncCompute::readTimestamps(uint32_t slot)
+	{
+		uint64_t timestamps[4] = {};
+		// Graphics may not have finished yet if the example doesn't wait for its queue, in that case the last results are kept
+		if (vkGetQueryPoolResults(device->logicalDevice, queryPool, slot * 4, 4, sizeof(timestamps), timestamps, sizeof(uint64_t), VK_QUERY_RESULT_64_BIT) != VK_SUCCESS) {
+			return;
+		}
+		// Timestamps of both queues are taken from the same device clock
+		const double period = device->properties.limits.timestampPeriod / 1000000.0;
+		const uint64_t overlapStart = std::max(timestamps[0], timestamps[2]);
+		const uint64_t overlapEnd = std::min(timestamps[1], timestamps[3]);
+		statistics.computeTime = double(timestamps[1] - timestamps[0]) * period;
+		statistics.graphicsTime = double(timestamps[3] - timestamps[2]) * period;
+		statistics.overlapTime = (overlapEnd > overlapStart) ? double(overlapEnd - overlapStart) * period : 0.0;
+		statistics.overlap = (statistics.computeTime > 0.0) ? static_cast<float>(100.0 * statistics.overlapTime / statistics.computeTime) : 0.0f;
+		statistics.available = true;
+	}
+
+	/**
+	* Submit the compute work of the current frame
+	* The simulation starts right away, only the copy to the shared buffers waits for graphics to release the slot
+	*/
+	void AsyncCompute::submitCompute(VkCommandBuffer commandBuffer)
+	{
+		VK_CHECK_RESULT(vkResetFences(device->logicalDevice, 1, &computeFence));
+
+		VkSubmitInfo submitInfo = vks::initializers::submitInfo();
+		submitInfo.commandBufferCount = 1;
+		submitInfo.pCommandBuffers = &commandBuffer;
+		VkPipelineStageFlags waitStageMask = VK_PIPELINE_STAGE_TRANSFER_BIT;
+		// The slot written in this frame was read by the graphics work of the previous frame
+		const uint64_t waitValue = frameIndex;
+		const uint64_t signalValue = frameIndex + 1;
+		VkTimelineSemaphoreSubmitInfoKHR timelineSubmitInfo{};
+		timelineSubmitInfo.sType = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO_KHR;
+		if (timelineEnabled) {
+			if (frameIndex > 0) {
+				submitInfo.waitSemaphoreCount = 1;
+				submitInfo.pWaitSemaphores = &graphicsTimeline;
+				submitInfo.pWaitDstStageMask = &waitStageMask;
+				timelineSubmitInfo.waitSemaphoreValueCount = 1;
+				timelineSubmitInfo.pWaitSemaphoreValues = &waitValue;
+			}
+			submitInfo.signalSemaphoreCount = 1;
+			submitInfo.pSignalSemaphores = &computeTimeline;
+			timelineSubmitInfo.signalSemaphoreValueCount = 1;
+			timelineSubmitInfo.pSignalSemaphoreValues = &signalValue;
+			submitInfo.pNext = &timelineSubmitInfo;
+		}
+		else {
+			const uint32_t slot = computeSlot();
+			if (frameIndex > 0) {
+				submitInfo.waitSemaphoreCount = 1;
+				submitInfo.pWaitSemaphores = &graphicsComplete[slot];
+				submitInfo.pWaitDstStageMask = &waitStageMask;
+			}
+			submitInfo.signalSemaphoreCount = 1;
+			submitInfo.pSignalSemaphores = &computeComplete[slot];
+		}
+		VK_CHECK_RESULT(vkQueueSubmit(queue, 1, &submitInfo, computeFence));
+	}
+
+	/**
+	* Submit the graphics work of the current frame and advance to the next frame
+	*
+	* @param commandBuffer Command buffer recorded with beginGraphics and endGraphics for this frame
+	* @param waitSemaphore Additional semaphore to wait on (e.g. swap chain image acquisition), can be VK_NULL_HANDLE
+	* @param waitStageMask Pipeline stages that wait for waitSemaphore
+	* @param signalSemaphore Additional semaphore to signal (e.g. render complete for presentation), can be VK_NULL_HANDLE
+	*/
+	void AsyncCompute::submitGraphics(VkCommandBuffer commandBuffer, VkSemaphore waitSemaphore, VkPipelineStageFlags waitStageMask, VkSemaphore signalSemaphore)
+	{
+		std::vector<VkSemaphore> waitSemaphores;
+		std::vector<VkPipelineStageFlags> waitStageMasks;
+		std::vector<uint64_t> waitValues;
+		std::vector<VkSemaphore> signalSemaphores;
+		std::vector<uint64_t> signalValues;
+		if (waitSemaphore != VK_NULL_HANDLE) {
+			waitSemaphores.push_back(waitSemaphore);
+			waitStageMasks.push_back(waitStageMask);
+			waitValues.push_back(0);
+		}
+		if (signalSemaphore != VK_NULL_HANDLE) {
+			signalSemaphores.push_back(signalSemaphore);
+			signalValues.push_back(0);
+		}
+
+		const VkPipelineStageFlags computeStageMask = graphicsStageMask ? graphicsStageMask : static_cast<VkPipelineStageFlags>(VK_PIPELINE_STAGE_ALL_COMMANDS_BIT);
+		if (timelineEnabled) {
+			// Graphics only reads the results of the previous compute frame, waiting for the current one serializes both queues for comparison
+			const uint64_t computeValue = concurrent ? frameIndex : frameIndex + 1;
+			if (computeValue > 0) {
+				waitSemaphores.push_back(computeTimeline);
+				waitStageMasks.push_back(computeStageMask);
+				waitValues.push_back(computeValue);
+			}
+			signalSemaphores.push_back(graphicsTimeline);
+			signalValues.push_back(frameIndex + 1);
+		}
+		else {
+			if (frameIndex > 0) {
+				waitSemaphores.push_back(computeComplete[graphicsSlot()]);
+				waitStageMasks.push_back(computeStageMask);
+			}
+			signalSemaphores.push_back(graphicsComplete[graphicsSlot()]);
+		}
+
+		VkSubmitInfo submitInfo = vks::initializers::submitInfo();
+		submitInfo.commandBufferCount = 1;
+		submitInfo.pCommandBuffers = &commandBuffer;
+		submitInfo.waitSemaphoreCount = static_cast<uint32_t>(waitSemaphores.size());
+		submitInfo.pWaitSemaphores = waitSemaphores.data();
+		submitInfo.pWaitDstStageMask = waitStageMasks.data();
+		submitInfo.signalSemaphoreCount = static_cast<uint32_t>(signalSemaphores.size());
+		submitInfo.pSignalSemaphores = signalSemaphores.data();
+		VkTimelineSemaphoreSubmitInfoKHR timelineSubmitInfo{};
+		if (timelineEnabled) {
+			timelineSubmitInfo.sType = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO_KHR;
+			timelineSubmitInfo.waitSemaphoreValueCount = static_cast<uint32_t>(waitValues.size());
+			timelineSubmitInfo.pWaitSemaphoreValues = waitValues.data();
+			timelineSubmitInfo.signalSemaphoreValueCount = static_cast<uint32_t>(signalValues.size());
+			timelineSubmitInfo.pSignalSemaphoreValues = signalValues.data();
+			submitInfo.pNext = &timelineSubmitInfo;
+		}
+		VK_CHECK_RESULT(vkQueueSubmit(graphicsQueue, 1, &submitInfo, VK_NULL_HANDLE));
+
+		frameIndex++;
+	}
+
+	void AsyncCompute::updateUIOverlay(vks::UIOverlay *overlay)
+	{
+		if (overlay->header("Async compute")) {
+			overlay->text("Queue: %s", !separateQueue() ? "shared with graphics" : (ownershipTransfers() ? "dedicated family" : "second graphics family queue"));
+			overlay->text("Sync: %s semaphores", timelineEnabled ? "timeline" : "binary");
+			if (timelineEnabled) {
+				overlay->checkBox("Overlap with graphics", &concurrent);
+			}
+			if (statistics.available) {
+				overlay->text("Compute: %.2f ms", statistics.computeTime);
+				overlay->text("Graphics: %.2f ms", statistics.graphicsTime);
+				overlay->text("Overlap: %.2f ms (%.0f%%)", statistics.overlapTime, statistics.overlap);
+			}
+			else {
+				overlay->text("GPU timestamps not available");
+			}
+		}
+	}
+}
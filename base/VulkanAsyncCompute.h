@@ -0,0 +1,111 @@
+/*
+* Vulkan async compute scheduling
+*
+* Runs compute command buffers on a dedicated compute queue (or a second queue of the graphics family) concurrently
+* with graphics. Buffers written by compute and read by graphics are double buffered, compute fills one copy
+* while graphics renders the results of the previous frame from the other one, with queue family ownership
+* transfers between both queues. Submissions are ordered with timeline semaphores if supported and binary
+* semaphores otherwise. Timestamps of both queues are used to measure how much of the compute work overlaps graphics
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#pragma once
+
+#include <array>
+#include <vector>
+
+#include "vulkan/vulkan.h"
+#include "VulkanDevice.h"
+#include "VulkanBuffer.h"
+#include "VulkanTools.h"
+#include "VulkanUIOverlay.h"
+
+namespace vks
+{
+	class AsyncCompute
+	{
+	public:
+		/** @brief Number of copies of every shared buffer, compute writes one slot while graphics reads the other */
+		static const uint32_t slotCount = 2;
+
+		/** @brief GPU timings of the last completed frame in milliseconds */
+		struct Statistics
+		{
+			double computeTime = 0.0;
+			double graphicsTime = 0.0;
+			double overlapTime = 0.0;
+			/** @brief Percentage of the compute time that ran while the graphics queue was busy */
+			float overlap = 0.0f;
+			bool available = false;
+		} statistics;
+
+		/** @brief Graphics renders the previous compute results while compute works on the next ones, if disabled graphics waits for the compute work of the same frame (timeline semaphores only) */
+		bool concurrent = true;
+
+		VkQueue queue = VK_NULL_HANDLE;
+		uint32_t queueFamilyIndex = 0;
+		/** @brief Command pool for the compute queue family, reset flag is set */
+		VkCommandPool commandPool = VK_NULL_HANDLE;
+
+	private:
+		// Buffer written on the compute queue and read by graphics, copied from a compute owned source at the end of each compute frame
+		struct SharedBuffer
+		{
+			VkBuffer source;
+			VkDeviceSize size;
+			std::array<vks::Buffer, slotCount> slots;
+		};
+
+		vks::VulkanDevice *device = nullptr;
+		VkQueue graphicsQueue = VK_NULL_HANDLE;
+		uint32_t graphicsQueueFamilyIndex = 0;
+		std::vector<SharedBuffer> sharedBuffers;
+		// Stages and accesses of all shared buffers on the graphics queue
+		VkPipelineStageFlags graphicsStageMask = 0;
+		VkAccessFlags graphicsAccessMask = 0;
+
+		VkPhysicalDeviceTimelineSemaphoreFeaturesKHR timelineFeatures{};
+		bool timelineEnabled = false;
+		// Timeline semaphores, the compute and graphics work of frame n signal the value n + 1
+		VkSemaphore computeTimeline = VK_NULL_HANDLE;
+		VkSemaphore graphicsTimeline = VK_NULL_HANDLE;
+		// Binary fallback, signaled once per frame and waited on once by the next frame of the other queue
+		std::array<VkSemaphore, slotCount> computeComplete{};
+		std::array<VkSemaphore, slotCount> graphicsComplete{};
+		VkFence computeFence = VK_NULL_HANDLE;
+		uint64_t frameIndex = 0;
+
+		// Compute begin/end and graphics begin/end for every slot
+		VkQueryPool queryPool = VK_NULL_HANDLE;
+		bool timestampsSupported = false;
+
+		void ownershipBarriers(VkCommandBuffer commandBuffer, uint32_t slot, bool toGraphics, VkPipelineStageFlags srcStageMask, VkAccessFlags srcAccessMask, VkPipelineStageFlags dstStageMask, VkAccessFlags dstAccessMask);
+		void readTimestamps(uint32_t slot);
+	public:
+		void requestFeatures(vks::VulkanDevice *device, uint32_t apiVersion, std::vector<const char*> &enabledExtensions, void *&pNextChain);
+		void prepare(vks::VulkanDevice *device, VkQueue graphicsQueue);
+		void destroy();
+
+		bool timelineSemaphores() const;
+		bool separateQueue() const;
+		bool ownershipTransfers() const;
+
+		uint32_t addSharedBuffer(const vks::Buffer &source, VkBufferUsageFlags usage = VK_BUFFER_USAGE_VERTEX_BUFFER_BIT, VkPipelineStageFlags stageMask = VK_PIPELINE_STAGE_VERTEX_INPUT_BIT, VkAccessFlags accessMask = VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT);
+		const vks::Buffer &sharedBuffer(uint32_t index, uint32_t slot) const;
+
+		uint32_t computeSlot() const;
+		uint32_t graphicsSlot() const;
+
+		void beginCompute(VkCommandBuffer commandBuffer, uint32_t slot);
+		void endCompute(VkCommandBuffer commandBuffer, uint32_t slot);
+		void beginGraphics(VkCommandBuffer commandBuffer);
+		void endGraphics(VkCommandBuffer commandBuffer);
+
+		void beginFrame();
+		void submitCompute(VkCommandBuffer commandBuffer);
+		void submitGraphics(VkCommandBuffer commandBuffer, VkSemaphore waitSemaphore, VkPipelineStageFlags waitStageMask, VkSemaphore signalSemaphore);
+
+		void updateUIOverlay(vks::UIOverlay *overlay);
+	};
+}
@@ -186,6 +186,7 @@ namespace vks
 		// Note that the indices may overlap depending on the implementation
 
 		const float defaultQueuePriority(0.0f);
+		const float sharedQueuePriorities[2] = { 0.0f, 0.0f };
 
 		// Graphics queue
 		if (requestedQueueTypes & VK_QUEUE_GRAPHICS_BIT)
@@ -217,6 +218,13 @@ namespace vks
 				queueInfo.pQueuePriorities = &defaultQueuePriority;
 				queueCreateInfos.push_back(queueInfo);
 			}
+			else if ((requestedQueueTypes & VK_QUEUE_GRAPHICS_BIT) && (queueFamilyProperties[queueFamilyIndices.compute].queueCount > 1))
+			{
+				// If compute shares the graphics family, request a second queue of that family so compute work can be submitted independently of graphics
+				queueCreateInfos[0].queueCount = 2;
+				queueCreateInfos[0].pQueuePriorities = sharedQueuePriorities;
+				computeQueueIndex = 1;
+			}
 		}
 		else
 		{
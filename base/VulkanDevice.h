@@ -48,6 +48,8 @@ struct VulkanDevice
 		uint32_t compute;
 		uint32_t transfer;
 	} queueFamilyIndices;
+	/** @brief Index of the compute queue within its family, 1 if compute shares the graphics family and that family offers more than one queue */
+	uint32_t computeQueueIndex = 0;
 	operator VkDevice() const
 	{
 		return logicalDevice;
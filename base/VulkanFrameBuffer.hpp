@@ -28,6 +28,8 @@ namespace vks
 		VkFormat format;
 		VkImageSubresourceRange subresourceRange;
 		VkAttachmentDescription description;
+		VkDeviceSize memorySize;
+		bool lazilyAllocated;
 
 		/**
 		* @brief Returns true if the attachment has a depth component
@@ -182,7 +184,18 @@ namespace vks
 			VK_CHECK_RESULT(vkCreateImage(vulkanDevice->logicalDevice, &image, nullptr, &attachment.image));
 			vkGetImageMemoryRequirements(vulkanDevice->logicalDevice, attachment.image, &memReqs);
 			memAlloc.allocationSize = memReqs.size;
-			memAlloc.memoryTypeIndex = vulkanDevice->getMemoryType(memReqs.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+			// Transient attachments never leave the render pass, on tiling GPUs lazily allocated memory may never be backed at all
+			VkBool32 lazyMemoryFound = VK_FALSE;
+			if (createinfo.usage & VK_IMAGE_USAGE_TRANSIENT_ATTACHMENT_BIT)
+			{
+				memAlloc.memoryTypeIndex = vulkanDevice->getMemoryType(memReqs.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT | VK_MEMORY_PROPERTY_LAZILY_ALLOCATED_BIT, &lazyMemoryFound);
+			}
+			if (!lazyMemoryFound)
+			{
+				memAlloc.memoryTypeIndex = vulkanDevice->getMemoryType(memReqs.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+			}
+			attachment.lazilyAllocated = (lazyMemoryFound == VK_TRUE);
+			attachment.memorySize = memReqs.size;
 			VK_CHECK_RESULT(vkAllocateMemory(vulkanDevice->logicalDevice, &memAlloc, nullptr, &attachment.memory));
 			VK_CHECK_RESULT(vkBindImageMemory(vulkanDevice->logicalDevice, attachment.image, attachment.memory, 0));
 
@@ -0,0 +1,298 @@
+/*
+* Vulkan frame timing and pacing
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#include "VulkanFrameTiming.h"
+
+#include <algorithm>
+#include <thread>
+
+namespace vks
+{
+	namespace
+	{
+		template <typename T>
+		double milliseconds(T start, T end)
+		{
+			return std::chrono::duration<double, std::milli>(end - start).count();
+		}
+
+		FrameTiming::Stage stageStatistics(std::vector<double> &values)
+		{
+			FrameTiming::Stage stage;
+			if (values.empty()) {
+				return stage;
+			}
+			std::sort(values.begin(), values.end());
+			double total = 0.0;
+			for (double value : values) {
+				total += value;
+			}
+			stage.avg = total / static_cast<double>(values.size());
+			stage.p50 = values[values.size() / 2];
+			stage.p99 = values[std::min(values.size() - 1, static_cast<size_t>(static_cast<double>(values.size()) * 0.99))];
+			stage.max = values.back();
+			return stage;
+		}
+	}
+
+	/**
+	* Enable VK_KHR_present_id and VK_KHR_present_wait if the present latency has been requested and the device supports them
+	*
+	* @param device Physical device wrapper the logical device will be created from
+	* @param apiVersion Vulkan version the instance has been created with
+	* @param enabledExtensions Device extensions, the present extensions are appended if used
+	* @param pNextChain Device creation pNext chain, the feature structures are prepended if used
+	*/
+	void FrameTiming::requestFeatures(vks::VulkanDevice *device, uint32_t apiVersion, std::vector<const char*> &enabledExtensions, void *&pNextChain)
+	{
+		presentWaitEnabled = false;
+		if (!presentWaitRequested) {
+			return;
+		}
+		// Querying the features requires Vulkan 1.1, without them only the host timestamps are taken
+		const uint32_t version = std::min(apiVersion, device->properties.apiVersion);
+		if ((version < VK_API_VERSION_1_1) || !device->extensionSupported(VK_KHR_PRESENT_ID_EXTENSION_NAME) || !device->extensionSupported(VK_KHR_PRESENT_WAIT_EXTENSION_NAME)) {
+			std::cout << "VK_KHR_present_wait is not supported, the present latency will not be measured\n";
+			return;
+		}
+
+		presentIdFeatures = {};
+		presentIdFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PRESENT_ID_FEATURES_KHR;
+		presentWaitFeatures = {};
+		presentWaitFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PRESENT_WAIT_FEATURES_KHR;
+		presentIdFeatures.pNext = &presentWaitFeatures;
+		VkPhysicalDeviceFeatures2 features2{};
+		features2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+		features2.pNext = &presentIdFeatures;
+		vkGetPhysicalDeviceFeatures2(device->physicalDevice, &features2);
+		if (!presentIdFeatures.presentId || !presentWaitFeatures.presentWait) {
+			std::cout << "VK_KHR_present_wait is not supported, the present latency will not be measured\n";
+			return;
+		}
+
+		enabledExtensions.push_back(VK_KHR_PRESENT_ID_EXTENSION_NAME);
+		enabledExtensions.push_back(VK_KHR_PRESENT_WAIT_EXTENSION_NAME);
+		presentWaitFeatures.pNext = pNextChain;
+		pNextChain = &presentIdFeatures;
+		presentWaitEnabled = true;
+	}
+
+	bool FrameTiming::presentWait() const
+	{
+		return presentWaitEnabled;
+	}
+
+	void FrameTiming::reset()
+	{
+		history.clear();
+		historyNext = 0;
+		pendingPresentId = 0;
+		deadline = Clock::time_point();
+	}
+
+	void FrameTiming::waitUntil(Clock::time_point time)
+	{
+		// Sleeping frees the core but wakes up late by the scheduler granularity (up to a few milliseconds, more on Windows)
+		if (pacingMode == PacingSleep) {
+			std::this_thread::sleep_until(time);
+			return;
+		}
+		if (pacingMode == PacingHybrid) {
+			const Clock::time_point spinStart = time - std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double, std::milli>(spinThreshold));
+			if (Clock::now() < spinStart) {
+				std::this_thread::sleep_until(spinStart);
+			}
+		}
+		// Spinning hits the deadline precisely at the cost of keeping a core busy
+		while (Clock::now() < time) {
+		}
+	}
+
+	void FrameTiming::collectPresent(VulkanSwapChain &swapChain)
+	{
+		if (pendingPresentId == 0) {
+			return;
+		}
+		const uint64_t id = pendingPresentId;
+		pendingPresentId = 0;
+		// Presents to a swapchain that has been recreated since can't be waited on anymore
+		if (pendingSwapchain != swapChain.swapChain) {
+			return;
+		}
+		// Waits for the id or a later one to be displayed, so a skipped present (e.g. replaced in mailbox mode) doesn't block
+		VkResult result = swapChain.waitForPresent(id, presentWaitTimeout);
+		if ((result == VK_SUCCESS) && (pendingFrame < history.size())) {
+			history[pendingFrame].presentLatency = milliseconds(pendingSubmitted, Clock::now());
+		}
+	}
+
+	/**
+	* Start a new frame
+	*
+	* @param swapChain Swapchain the frames are presented to, used to wait for the display of the previous frame
+	*/
+	void FrameTiming::beginFrame(VulkanSwapChain &swapChain)
+	{
+		const Clock::time_point waitStart = Clock::now();
+		collectPresent(swapChain);
+		Clock::time_point now = Clock::now();
+		if (targetFrameRate > 0.0f) {
+			const Clock::duration interval = std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(1.0 / targetFrameRate));
+			if (now < deadline) {
+				waitUntil(deadline);
+				now = Clock::now();
+			}
+			// A frame that missed its deadline by more than an interval starts a new schedule instead of rushing the following frames to catch up
+			deadline = (now - deadline > interval) ? now + interval : deadline + interval;
+		}
+		current = Frame();
+		current.pacing = milliseconds(waitStart, now);
+		frameStart = now;
+		acquired = now;
+		submitted = now;
+		presented = now;
+		submittedPresentId = 0;
+		frameActive = true;
+	}
+
+	void FrameTiming::imageAcquired()
+	{
+		acquired = Clock::now();
+	}
+
+	/**
+	* Mark the frame as submitted
+	*
+	* @param swapChain Swapchain the frame will be presented to
+	*
+	* @return Id to pass to the present of the frame, 0 if the present latency isn't measured
+	*/
+	uint64_t FrameTiming::frameSubmitted(VkSwapchainKHR swapChain)
+	{
+		submitted = Clock::now();
+		if (!frameActive || !presentWaitEnabled) {
+			return 0;
+		}
+		submittedPresentId = ++presentId;
+		submittedSwapchain = swapChain;
+		return submittedPresentId;
+	}
+
+	void FrameTiming::framePresented()
+	{
+		presented = Clock::now();
+	}
+
+	void FrameTiming::endFrame()
+	{
+		if (!frameActive) {
+			return;
+		}
+		frameActive = false;
+		const Clock::time_point now = Clock::now();
+		current.acquire = milliseconds(frameStart, acquired);
+		current.submit = milliseconds(acquired, submitted);
+		current.present = milliseconds(submitted, presented);
+		current.gpuWait = milliseconds(presented, now);
+		current.frame = milliseconds(frameStart, now);
+
+		size_t index;
+		if ((historySize == 0) || (history.size() < historySize)) {
+			index = history.size();
+			history.push_back(current);
+		}
+		else {
+			index = historyNext;
+			history[index] = current;
+			historyNext = (historyNext + 1) % history.size();
+		}
+
+		if (submittedPresentId > 0) {
+			pendingPresentId = submittedPresentId;
+			pendingSwapchain = submittedSwapchain;
+			pendingSubmitted = submitted;
+			pendingFrame = index;
+		}
+	}
+
+	FrameTiming::Statistics FrameTiming::statistics() const
+	{
+		Statistics result;
+		result.frames = static_cast<uint32_t>(history.size());
+		std::vector<double> values(history.size());
+		auto stage = [&](double Frame::*member) {
+			for (size_t i = 0; i < history.size(); i++) {
+				values[i] = history[i].*member;
+			}
+			return stageStatistics(values);
+		};
+		result.pacing = stage(&Frame::pacing);
+		result.acquire = stage(&Frame::acquire);
+		result.submit = stage(&Frame::submit);
+		result.present = stage(&Frame::present);
+		result.gpuWait = stage(&Frame::gpuWait);
+		result.frame = stage(&Frame::frame);
+
+		values.clear();
+		for (const Frame &frame : history) {
+			if (frame.presentLatency >= 0.0) {
+				values.push_back(frame.presentLatency);
+			}
+		}
+		result.latencyFrames = static_cast<uint32_t>(values.size());
+		result.presentLatency = stageStatistics(values);
+		return result;
+	}
+
+	std::vector<FrameTiming::Frame> FrameTiming::frames() const
+	{
+		std::vector<Frame> result(history.begin() + historyNext, history.end());
+		result.insert(result.end(), history.begin(), history.begin() + historyNext);
+		return result;
+	}
+
+	void FrameTiming::updateUIOverlay(vks::UIOverlay *overlay)
+	{
+		if (overlay->header("Frame timing")) {
+			overlay->sliderFloat("Frame limit", &targetFrameRate, 0.0f, 240.0f);
+			int32_t mode = static_cast<int32_t>(pacingMode);
+			if (overlay->comboBox("Pacing", &mode, { "sleep", "spin", "hybrid" })) {
+				pacingMode = static_cast<PacingMode>(mode);
+			}
+			// Sorting the history every frame would show up in the timings it measures
+			const Clock::time_point now = Clock::now();
+			if (milliseconds(overlayStatisticsTime, now) > 500.0) {
+				overlayStatistics = statistics();
+				overlayStatisticsTime = now;
+			}
+			overlay->text("Pacing: %.2f ms", overlayStatistics.pacing.avg);
+			overlay->text("Acquire: %.2f ms", overlayStatistics.acquire.avg);
+			overlay->text("Submit: %.2f ms", overlayStatistics.submit.avg);
+			overlay->text("Present: %.2f ms", overlayStatistics.present.avg);
+			overlay->text("GPU wait: %.2f ms", overlayStatistics.gpuWait.avg);
+			if (!presentWaitEnabled) {
+				overlay->text("Present latency: not available");
+			}
+			else if (overlayStatistics.latencyFrames > 0) {
+				overlay->text("Present latency: %.2f ms (p99 %.2f ms)", overlayStatistics.presentLatency.avg, overlayStatistics.presentLatency.p99);
+			}
+			else {
+				overlay->text("Present latency: no frames measured");
+			}
+		}
+	}
+
+	std::string FrameTiming::pacingModeString(PacingMode mode)
+	{
+		switch (mode)
+		{
+		case PacingSleep: return "sleep";
+		case PacingSpin: return "spin";
+		case PacingHybrid: return "hybrid";
+		default: return "unknown";
+		}
+	}
+}
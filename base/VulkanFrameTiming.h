@@ -0,0 +1,143 @@
+/*
+* Vulkan frame timing and pacing
+*
+* Takes host timestamps of the acquire, submit and present steps of every frame, limits the frame rate to a target by
+* sleeping and/or spinning before the next image is acquired, and measures the time from submitting a frame until it
+* is actually displayed with VK_KHR_present_id and VK_KHR_present_wait if the device supports them. The host timestamps
+* don't depend on the window system, so they are also available with the headless swapchain
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#pragma once
+
+#include <chrono>
+#include <string>
+#include <vector>
+
+#include "vulkan/vulkan.h"
+#include "VulkanDevice.h"
+#include "VulkanSwapChain.h"
+#include "VulkanTools.h"
+#include "VulkanUIOverlay.h"
+
+namespace vks
+{
+	class FrameTiming
+	{
+	public:
+		enum PacingMode { PacingSleep = 0, PacingSpin = 1, PacingHybrid = 2 };
+
+		/** @brief Host timings of a single frame in milliseconds */
+		struct Frame
+		{
+			/** @brief Time the limiter waited before the frame was started */
+			double pacing = 0.0;
+			/** @brief Waiting for the next swapchain image */
+			double acquire = 0.0;
+			/** @brief From the acquired image until the example's submission returned (updates, recording and vkQueueSubmit) */
+			double submit = 0.0;
+			/** @brief vkQueuePresentKHR call */
+			double present = 0.0;
+			/** @brief From the present call until the queue is idle */
+			double gpuWait = 0.0;
+			/** @brief From the submission until the image was displayed, negative if it couldn't be measured */
+			double presentLatency = -1.0;
+			/** @brief Whole frame excluding the pacing */
+			double frame = 0.0;
+		};
+
+		struct Stage
+		{
+			double avg = 0.0;
+			double p50 = 0.0;
+			double p99 = 0.0;
+			double max = 0.0;
+		};
+
+		/** @brief Distribution of the stages over the frames in the history */
+		struct Statistics
+		{
+			uint32_t frames = 0;
+			/** @brief Number of frames with a measured present latency */
+			uint32_t latencyFrames = 0;
+			Stage pacing;
+			Stage acquire;
+			Stage submit;
+			Stage present;
+			Stage gpuWait;
+			Stage presentLatency;
+			Stage frame;
+		};
+
+		/** @brief Target frame rate of the limiter, 0 = unlimited */
+		float targetFrameRate = 0.0f;
+		PacingMode pacingMode = PacingHybrid;
+		/** @brief Hybrid pacing sleeps until this many milliseconds before the deadline and spins for the rest */
+		double spinThreshold = 2.0;
+		/** @brief Measure the present latency with VK_KHR_present_wait, has to be set before the device is created */
+		bool presentWaitRequested = false;
+		/** @brief Timeout for waiting on a present in nanoseconds, frames that take longer count as not measured */
+		uint64_t presentWaitTimeout = 100000000;
+		/** @brief Number of frames kept in the history, 0 keeps all frames (e.g. for a benchmark run) */
+		uint32_t historySize = 1024;
+		/** @brief Show the frame timing section in the UI overlay */
+		bool overlay = false;
+
+	private:
+		typedef std::chrono::steady_clock Clock;
+
+		VkPhysicalDevicePresentIdFeaturesKHR presentIdFeatures{};
+		VkPhysicalDevicePresentWaitFeaturesKHR presentWaitFeatures{};
+		bool presentWaitEnabled = false;
+
+		Clock::time_point deadline;
+		Clock::time_point frameStart;
+		Clock::time_point acquired;
+		Clock::time_point submitted;
+		Clock::time_point presented;
+		Frame current;
+		bool frameActive = false;
+
+		// The latency of a frame is measured when the next frame begins, so the CPU can work on it while the previous one is queued for display
+		uint64_t presentId = 0;
+		uint64_t submittedPresentId = 0;
+		VkSwapchainKHR submittedSwapchain = VK_NULL_HANDLE;
+		uint64_t pendingPresentId = 0;
+		VkSwapchainKHR pendingSwapchain = VK_NULL_HANDLE;
+		Clock::time_point pendingSubmitted;
+		size_t pendingFrame = 0;
+
+		std::vector<Frame> history;
+		size_t historyNext = 0;
+
+		Statistics overlayStatistics;
+		Clock::time_point overlayStatisticsTime;
+
+		void waitUntil(Clock::time_point time);
+		void collectPresent(VulkanSwapChain &swapChain);
+	public:
+		void requestFeatures(vks::VulkanDevice *device, uint32_t apiVersion, std::vector<const char*> &enabledExtensions, void *&pNextChain);
+		bool presentWait() const;
+
+		/** @brief Clears the history and the limiter, e.g. after a warm up phase */
+		void reset();
+
+		/** @brief Waits for the limiter and collects the present latency of the previous frame, call before acquiring the next image */
+		void beginFrame(VulkanSwapChain &swapChain);
+		void imageAcquired();
+		/** @brief Call once the frame's command buffers have been submitted, returns the present id to tag its present with (0 = none) */
+		uint64_t frameSubmitted(VkSwapchainKHR swapChain);
+		void framePresented();
+		/** @brief Adds the frame to the history, frames that were not presented (e.g. on swapchain recreation) are dropped by the next beginFrame */
+		void endFrame();
+
+		Statistics statistics() const;
+		/** @brief Frames of the history in the order they were rendered */
+		std::vector<Frame> frames() const;
+
+		void updateUIOverlay(vks::UIOverlay *overlay);
+
+		static std::string pacingModeString(PacingMode mode);
+	};
+}
@@ -0,0 +1,527 @@
+/*
+* Vulkan instance grid
+*
+* Buckets large numbers of instances into a uniform grid of cells on the xz plane. Only cells within a streaming radius
+* around the camera are resident on the GPU, they are uploaded into fixed size slots of an instance pool a few cells
+* per frame and evicted once the camera moves away. Whole cells are culled against the view frustum on the CPU or in
+* a compute pass, the instances of visible cells are then culled individually, assigned a level of detail by distance
+* and compacted per mesh and LOD into an indirect draw buffer
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#include "VulkanInstanceGrid.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cfloat>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <random>
+
+#if defined(__ANDROID__)
+#include "VulkanAndroid.h"
+#endif
+
+namespace vks
+{
+	// Workgroup size of the prefix pass, limits the number of draws (mesh types * LODs)
+	static const uint32_t maxDraws = 256;
+
+	static VkShaderModule loadShaderModule(VkDevice device, const std::string &fileName)
+	{
+#if defined(__ANDROID__)
+		VkShaderModule shaderModule = vks::tools::loadShader(androidApp->activity->assetManager, fileName.c_str(), device);
+#else
+		VkShaderModule shaderModule = vks::tools::loadShader(fileName.c_str(), device);
+#endif
+		assert(shaderModule != VK_NULL_HANDLE);
+		return shaderModule;
+	}
+
+	glm::ivec2 InstanceGrid::cellCoord(const glm::vec3 &pos) const
+	{
+		glm::ivec2 coord = glm::ivec2(glm::floor((glm::vec2(pos.x, pos.z) - gridOrigin) / settings.cellSize));
+		return glm::clamp(coord, glm::ivec2(0), gridSize - glm::ivec2(1));
+	}
+
+	// Distance on the xz plane from the camera to the closest point of the cell
+	float InstanceGrid::cellDistance(const Cell &cell, const glm::vec3 &cameraPos) const
+	{
+		const glm::vec2 p(cameraPos.x, cameraPos.z);
+		const glm::vec2 closest = glm::clamp(p, glm::vec2(cell.boundsMin.x, cell.boundsMin.z), glm::vec2(cell.boundsMax.x, cell.boundsMax.z));
+		return glm::length(p - closest);
+	}
+
+	bool InstanceGrid::cellInFrustum(const Cell &cell) const
+	{
+		for (uint32_t i = 0; i < 6; i++) {
+			const glm::vec4 &plane = uniformData.frustumPlanes[i];
+			// Corner of the box furthest along the plane normal
+			const glm::vec3 p(plane.x > 0.0f ? cell.boundsMax.x : cell.boundsMin.x, plane.y > 0.0f ? cell.boundsMax.y : cell.boundsMin.y, plane.z > 0.0f ? cell.boundsMax.z : cell.boundsMin.z);
+			if (glm::dot(glm::vec3(plane), p) + plane.w < 0.0f) {
+				return false;
+			}
+		}
+		return true;
+	}
+
+	/**
+	* Create the culling pipelines, the buffers depend on the instances and are created by build
+	*
+	* @param device Vulkan device to create the resources on
+	* @param pipelineCache Optional pipeline cache
+	* @param shaderPath Folder containing the compiled instancegrid_cells, _instances, _prefix and _scatter compute shaders
+	* @param settings Cell size, streaming radius and pool size
+	*/
+	void InstanceGrid::prepare(vks::VulkanDevice *device, VkPipelineCache pipelineCache, const std::string &shaderPath, const Settings &settings)
+	{
+		this->device = device;
+		this->settings = settings;
+
+		// Uniforms, slots, cell list, instance pool, candidates, counters, draw infos, draw commands and compacted instances
+		std::vector<VkDescriptorSetLayoutBinding> setLayoutBindings = {
+			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT, 0),
+		};
+		for (uint32_t i = 1; i <= 8; i++) {
+			setLayoutBindings.push_back(vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT, i));
+		}
+		VkDescriptorSetLayoutCreateInfo descriptorLayout = vks::initializers::descriptorSetLayoutCreateInfo(setLayoutBindings);
+		VK_CHECK_RESULT(vkCreateDescriptorSetLayout(device->logicalDevice, &descriptorLayout, nullptr, &descriptorSetLayout));
+		VkPipelineLayoutCreateInfo pipelineLayoutCreateInfo = vks::initializers::pipelineLayoutCreateInfo(&descriptorSetLayout, 1);
+		VK_CHECK_RESULT(vkCreatePipelineLayout(device->logicalDevice, &pipelineLayoutCreateInfo, nullptr, &pipelineLayout));
+
+		const std::vector<std::pair<std::string, VkPipeline*>> computePipelines = {
+			{ "instancegrid_cells.comp.spv", &pipelines.cells },
+			{ "instancegrid_instances.comp.spv", &pipelines.instances },
+			{ "instancegrid_prefix.comp.spv", &pipelines.prefix },
+			{ "instancegrid_scatter.comp.spv", &pipelines.scatter },
+		};
+		for (auto &computePipeline : computePipelines) {
+			VkComputePipelineCreateInfo computePipelineCreateInfo = vks::initializers::computePipelineCreateInfo(pipelineLayout, 0);
+			computePipelineCreateInfo.stage.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+			computePipelineCreateInfo.stage.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+			computePipelineCreateInfo.stage.module = loadShaderModule(device->logicalDevice, shaderPath + computePipeline.first);
+			computePipelineCreateInfo.stage.pName = "main";
+			VK_CHECK_RESULT(vkCreateComputePipelines(device->logicalDevice, pipelineCache, 1, &computePipelineCreateInfo, nullptr, computePipeline.second));
+			vkDestroyShaderModule(device->logicalDevice, computePipelineCreateInfo.stage.module, nullptr);
+		}
+	}
+
+	void InstanceGrid::destroy()
+	{
+		if (!device) {
+			return;
+		}
+		instancePool.destroy();
+		slotBuffer.destroy();
+		stagingBuffer.destroy();
+		hostCellList.destroy();
+		cellList.destroy();
+		candidates.destroy();
+		counters.destroy();
+		drawInfos.destroy();
+		drawCommands.destroy();
+		visibleInstances.destroy();
+		readback.destroy();
+		uniformBuffer.destroy();
+		vkDestroyPipeline(device->logicalDevice, pipelines.cells, nullptr);
+		vkDestroyPipeline(device->logicalDevice, pipelines.instances, nullptr);
+		vkDestroyPipeline(device->logicalDevice, pipelines.prefix, nullptr);
+		vkDestroyPipeline(device->logicalDevice, pipelines.scatter, nullptr);
+		vkDestroyPipelineLayout(device->logicalDevice, pipelineLayout, nullptr);
+		vkDestroyDescriptorSetLayout(device->logicalDevice, descriptorSetLayout, nullptr);
+		if (descriptorPool != VK_NULL_HANDLE) {
+			vkDestroyDescriptorPool(device->logicalDevice, descriptorPool, nullptr);
+		}
+		device = nullptr;
+	}
+
+	void InstanceGrid::setMeshes(const std::vector<Mesh> &meshes, const std::vector<LOD> &lods)
+	{
+		assert(!lods.empty() && (lods.size() <= maxLODs));
+		assert(!meshes.empty() && (meshes.size() % lods.size() == 0) && (meshes.size() <= maxDraws));
+		this->meshes = meshes;
+		this->lods = lods;
+		typeCount = static_cast<uint32_t>(meshes.size() / lods.size());
+	}
+
+	/**
+	* Sort the instances into their cells with a counting sort, shuffle every cell so that any prefix of it is a random
+	* subset (used to thin out distant cells) and size the slots of the GPU pool for the fullest cell
+	*/
+	void InstanceGrid::build(std::vector<Instance> &instances)
+	{
+		assert(!meshes.empty());
+		auto tStart = std::chrono::high_resolution_clock::now();
+
+		glm::vec2 boundsMin(FLT_MAX);
+		glm::vec2 boundsMax(-FLT_MAX);
+		for (const Instance &instance : instances) {
+			boundsMin = glm::min(boundsMin, glm::vec2(instance.pos.x, instance.pos.z));
+			boundsMax = glm::max(boundsMax, glm::vec2(instance.pos.x, instance.pos.z));
+		}
+		if (instances.empty()) {
+			boundsMin = boundsMax = glm::vec2(0.0f);
+		}
+		gridOrigin = boundsMin;
+		gridSize = glm::ivec2(glm::floor((boundsMax - boundsMin) / settings.cellSize)) + glm::ivec2(1);
+		cells.assign(static_cast<size_t>(gridSize.x) * gridSize.y, Cell());
+
+		// Largest mesh radius of every type over all of its LODs
+		std::vector<float> typeRadius(typeCount, 0.0f);
+		for (uint32_t i = 0; i < meshes.size(); i++) {
+			typeRadius[i / lods.size()] = std::max(typeRadius[i / lods.size()], meshes[i].radius);
+		}
+
+		std::vector<uint32_t> instanceCells(instances.size());
+		for (size_t i = 0; i < instances.size(); i++) {
+			const glm::ivec2 coord = cellCoord(instances[i].pos);
+			instanceCells[i] = coord.y * gridSize.x + coord.x;
+			cells[instanceCells[i]].instanceCount++;
+		}
+		uint32_t offset = 0;
+		for (Cell &cell : cells) {
+			cell.firstInstance = offset;
+			offset += cell.instanceCount;
+			cell.instanceCount = 0;
+			cell.boundsMin = glm::vec3(FLT_MAX);
+			cell.boundsMax = glm::vec3(-FLT_MAX);
+		}
+		this->instances.resize(instances.size());
+		for (size_t i = 0; i < instances.size(); i++) {
+			Cell &cell = cells[instanceCells[i]];
+			const Instance &instance = instances[i];
+			assert(instance.type < typeCount);
+			const float radius = typeRadius[instance.type] * instance.scale;
+			cell.boundsMin = glm::min(cell.boundsMin, instance.pos - glm::vec3(radius));
+			cell.boundsMax = glm::max(cell.boundsMax, instance.pos + glm::vec3(radius));
+			this->instances[cell.firstInstance + cell.instanceCount++] = instance;
+		}
+		// The input is no longer needed, release it before the GPU buffers are created
+		std::vector<Instance>().swap(instances);
+		std::vector<uint32_t>().swap(instanceCells);
+
+		slotCapacity = 1;
+		for (size_t i = 0; i < cells.size(); i++) {
+			Cell &cell = cells[i];
+			std::default_random_engine rndEngine(static_cast<uint32_t>(i));
+			std::shuffle(this->instances.begin() + cell.firstInstance, this->instances.begin() + cell.firstInstance + cell.instanceCount, rndEngine);
+			slotCapacity = std::max(slotCapacity, cell.instanceCount);
+		}
+		slotCount = std::max(settings.maxResidentInstances / slotCapacity, 1u);
+		freeSlots.resize(slotCount);
+		for (uint32_t i = 0; i < slotCount; i++) {
+			// Popped from the back, so the first slots are used first
+			freeSlots[i] = slotCount - 1 - i;
+		}
+		slotCells.assign(slotCount, ~0u);
+
+		createBuffers();
+
+		statistics.instances = static_cast<uint32_t>(this->instances.size());
+		statistics.cells = static_cast<uint32_t>(cells.size());
+		statistics.slots = slotCount;
+		statistics.buildTime = std::chrono::duration<float, std::milli>(std::chrono::high_resolution_clock::now() - tStart).count();
+	}
+
+	void InstanceGrid::createBuffers()
+	{
+		const VkDeviceSize poolSize = static_cast<VkDeviceSize>(slotCount) * slotCapacity;
+		const uint32_t drawCount = this->drawCount();
+		const VkMemoryPropertyFlags hostVisible = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+
+		VK_CHECK_RESULT(device->createBuffer(VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, &instancePool, poolSize * sizeof(Instance)));
+		VK_CHECK_RESULT(device->createBuffer(VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, &visibleInstances, poolSize * sizeof(Instance)));
+		// Index of the instance in the pool and the draw it belongs to
+		VK_CHECK_RESULT(device->createBuffer(VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, &candidates, poolSize * sizeof(glm::uvec2)));
+		VK_CHECK_RESULT(device->createBuffer(VK_BUFFER_USAGE_TRANSFER_SRC_BIT, hostVisible, &stagingBuffer, static_cast<VkDeviceSize>(settings.maxUploadsPerFrame) * slotCapacity * sizeof(Instance)));
+		VK_CHECK_RESULT(stagingBuffer.map());
+
+		// Slots are only changed by the host between frames, so they are read by the GPU directly from host memory
+		VK_CHECK_RESULT(device->createBuffer(VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, hostVisible, &slotBuffer, slotCount * sizeof(Slot)));
+		VK_CHECK_RESULT(slotBuffer.map());
+		memset(slotBuffer.mapped, 0, slotCount * sizeof(Slot));
+
+		// Visible cell list with the dispatch size of the instance pass in front
+		const VkDeviceSize cellListSize = 4 * sizeof(uint32_t) + slotCount * sizeof(uint32_t);
+		VK_CHECK_RESULT(device->createBuffer(VK_BUFFER_USAGE_TRANSFER_SRC_BIT, hostVisible, &hostCellList, cellListSize));
+		VK_CHECK_RESULT(hostCellList.map());
+		VK_CHECK_RESULT(device->createBuffer(VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, &cellList, cellListSize));
+
+		// Dispatch size of the scatter pass and the candidate count, followed by the instance count and write cursor of every draw
+		const VkDeviceSize countersSize = 4 * sizeof(uint32_t) + 2 * drawCount * sizeof(uint32_t);
+		VK_CHECK_RESULT(device->createBuffer(VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, &counters, countersSize));
+		VK_CHECK_RESULT(device->createBuffer(VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, &drawCommands, drawCount * sizeof(VkDrawIndexedIndirectCommand)));
+
+		std::vector<DrawInfo> infos(drawCount);
+		for (uint32_t i = 0; i < drawCount; i++) {
+			infos[i] = { meshes[i].firstIndex, meshes[i].indexCount, meshes[i].radius, 0.0f };
+		}
+		VK_CHECK_RESULT(device->createBuffer(VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, hostVisible, &drawInfos, drawCount * sizeof(DrawInfo), infos.data()));
+
+		// Visible cell count and the counters, copied after the culling for the statistics
+		VK_CHECK_RESULT(device->createBuffer(VK_BUFFER_USAGE_TRANSFER_DST_BIT, hostVisible, &readback, 4 * sizeof(uint32_t) + 4 * sizeof(uint32_t) + drawCount * sizeof(uint32_t)));
+		VK_CHECK_RESULT(readback.map());
+		VK_CHECK_RESULT(device->createBuffer(VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT, hostVisible, &uniformBuffer, sizeof(UniformData)));
+		VK_CHECK_RESULT(uniformBuffer.map());
+
+		std::vector<VkDescriptorPoolSize> poolSizes = {
+			vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 1),
+			vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 8),
+		};
+		VkDescriptorPoolCreateInfo descriptorPoolInfo = vks::initializers::descriptorPoolCreateInfo(poolSizes, 1);
+		VK_CHECK_RESULT(vkCreateDescriptorPool(device->logicalDevice, &descriptorPoolInfo, nullptr, &descriptorPool));
+		VkDescriptorSetAllocateInfo allocInfo = vks::initializers::descriptorSetAllocateInfo(descriptorPool, &descriptorSetLayout, 1);
+		VK_CHECK_RESULT(vkAllocateDescriptorSets(device->logicalDevice, &allocInfo, &descriptorSet));
+		const std::vector<vks::Buffer*> storageBuffers = { &slotBuffer, &cellList, &instancePool, &candidates, &counters, &drawInfos, &drawCommands, &visibleInstances };
+		std::vector<VkWriteDescriptorSet> writeDescriptorSets = {
+			vks::initializers::writeDescriptorSet(descriptorSet, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 0, &uniformBuffer.descriptor),
+		};
+		for (uint32_t i = 0; i < storageBuffers.size(); i++) {
+			writeDescriptorSets.push_back(vks::initializers::writeDescriptorSet(descriptorSet, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, i + 1, &storageBuffers[i]->descriptor));
+		}
+		vkUpdateDescriptorSets(device->logicalDevice, static_cast<uint32_t>(writeDescriptorSets.size()), writeDescriptorSets.data(), 0, nullptr);
+	}
+
+	// Results of the last recorded culling, the frame they belong to has finished once the next update is called
+	void InstanceGrid::readResults()
+	{
+		if (!resultsPending) {
+			return;
+		}
+		const uint32_t *results = static_cast<const uint32_t*>(readback.mapped);
+		if (cellCulling == CellCullingGPU) {
+			statistics.visibleCells = results[0];
+		}
+		statistics.lodInstances.fill(0);
+		statistics.visibleInstances = 0;
+		const uint32_t lodCount = static_cast<uint32_t>(lods.size());
+		for (uint32_t i = 0; i < drawCount(); i++) {
+			statistics.lodInstances[i % lodCount] += results[8 + i];
+			statistics.visibleInstances += results[8 + i];
+		}
+		resultsPending = false;
+	}
+
+	/*
+	* Evicts cells that left the streaming radius and uploads the closest missing cells into free slots
+	* A small margin between the two radii keeps cells on the border from being streamed in and out every frame
+	*/
+	void InstanceGrid::stream(const glm::vec3 &cameraPos)
+	{
+		const float evictRadius = settings.streamingRadius + settings.cellSize * 0.5f;
+		Slot *slots = static_cast<Slot*>(slotBuffer.mapped);
+		statistics.evictions = 0;
+		for (uint32_t slot = 0; slot < slotCount; slot++) {
+			if (slotCells[slot] == ~0u) {
+				continue;
+			}
+			Cell &cell = cells[slotCells[slot]];
+			if (cellDistance(cell, cameraPos) > evictRadius) {
+				cell.slot = -1;
+				slotCells[slot] = ~0u;
+				slots[slot].instanceCount = 0;
+				freeSlots.push_back(slot);
+				statistics.evictions++;
+			}
+		}
+
+		// Only the cells in a window around the camera have to be checked
+		std::vector<std::pair<float, uint32_t>> missing;
+		const glm::ivec2 windowMin = cellCoord(cameraPos - glm::vec3(settings.streamingRadius));
+		const glm::ivec2 windowMax = cellCoord(cameraPos + glm::vec3(settings.streamingRadius));
+		for (int32_t y = windowMin.y; y <= windowMax.y; y++) {
+			for (int32_t x = windowMin.x; x <= windowMax.x; x++) {
+				const uint32_t index = y * gridSize.x + x;
+				const Cell &cell = cells[index];
+				if ((cell.slot >= 0) || (cell.instanceCount == 0)) {
+					continue;
+				}
+				const float distance = cellDistance(cell, cameraPos);
+				if (distance <= settings.streamingRadius) {
+					missing.push_back(std::make_pair(distance, index));
+				}
+			}
+		}
+		std::sort(missing.begin(), missing.end());
+
+		uploads.clear();
+		const size_t freeSlotCount = freeSlots.size();
+		const size_t uploadCount = std::min(missing.size(), std::min(freeSlots.size(), static_cast<size_t>(settings.maxUploadsPerFrame)));
+		for (size_t i = 0; i < uploadCount; i++) {
+			const uint32_t index = missing[i].second;
+			Cell &cell = cells[index];
+			const uint32_t slot = freeSlots.back();
+			freeSlots.pop_back();
+			cell.slot = static_cast<int32_t>(slot);
+			slotCells[slot] = index;
+			Instance *staging = static_cast<Instance*>(stagingBuffer.mapped) + uploads.size() * slotCapacity;
+			memcpy(staging, &instances[cell.firstInstance], cell.instanceCount * sizeof(Instance));
+			slots[slot].boundsMin = glm::vec4(cell.boundsMin, 0.0f);
+			slots[slot].boundsMax = glm::vec4(cell.boundsMax, 0.0f);
+			slots[slot].instanceCount = cell.instanceCount;
+			uploads.push_back({ index, slot });
+		}
+		statistics.uploads = static_cast<uint32_t>(uploads.size());
+		statistics.missingCells = static_cast<uint32_t>((missing.size() > freeSlotCount) ? missing.size() - freeSlotCount : 0);
+	}
+
+	/**
+	* Stream cells and prepare the culling of this frame
+	* The slot metadata and the staging memory are written by the host, so the previous frame has to be finished
+	*
+	* @param cameraPos World space position of the camera, used for streaming and the level of detail
+	* @param viewProjection Combined view and projection matrix the frustum planes are extracted from
+	*/
+	void InstanceGrid::update(const glm::vec3 &cameraPos, const glm::mat4 &viewProjection)
+	{
+		auto tStart = std::chrono::high_resolution_clock::now();
+		readResults();
+
+		// Gribb/Hartmann plane extraction, same as vks::Frustum
+		for (uint32_t i = 0; i < 3; i++) {
+			for (uint32_t j = 0; j < 2; j++) {
+				glm::vec4 &plane = uniformData.frustumPlanes[i * 2 + j];
+				const float sign = (j == 0) ? 1.0f : -1.0f;
+				for (uint32_t k = 0; k < 4; k++) {
+					plane[k] = viewProjection[k].w + sign * viewProjection[k][i];
+				}
+				plane /= glm::length(glm::vec3(plane));
+			}
+		}
+		uniformData.cameraPos = glm::vec4(cameraPos, 1.0f);
+		for (uint32_t i = 0; i < lods.size(); i++) {
+			uniformData.lods[i] = glm::vec4(lods[i].distance, lods[i].density, 0.0f, 0.0f);
+		}
+		uniformData.slotCount = slotCount;
+		uniformData.slotCapacity = slotCapacity;
+		uniformData.drawCount = drawCount();
+		uniformData.lodCount = static_cast<uint32_t>(lods.size());
+		memcpy(uniformBuffer.mapped, &uniformData, sizeof(UniformData));
+
+		stream(cameraPos);
+
+		statistics.residentCells = 0;
+		statistics.residentInstances = 0;
+		visibleSlots.clear();
+		const float maxDistance = lods.back().distance;
+		for (uint32_t slot = 0; slot < slotCount; slot++) {
+			if (slotCells[slot] == ~0u) {
+				continue;
+			}
+			const Cell &cell = cells[slotCells[slot]];
+			statistics.residentCells++;
+			statistics.residentInstances += cell.instanceCount;
+			if ((cellCulling == CellCullingCPU) && (cellDistance(cell, cameraPos) < maxDistance) && cellInFrustum(cell)) {
+				visibleSlots.push_back(slot);
+			}
+		}
+		if (cellCulling == CellCullingCPU) {
+			uint32_t *cellListData = static_cast<uint32_t*>(hostCellList.mapped);
+			cellListData[0] = static_cast<uint32_t>(visibleSlots.size());
+			cellListData[1] = 1;
+			cellListData[2] = 1;
+			cellListData[3] = 0;
+			if (!visibleSlots.empty()) {
+				memcpy(cellListData + 4, visibleSlots.data(), visibleSlots.size() * sizeof(uint32_t));
+			}
+			statistics.visibleCells = static_cast<uint32_t>(visibleSlots.size());
+		}
+		statistics.updateTime = std::chrono::duration<float, std::milli>(std::chrono::high_resolution_clock::now() - tStart).count();
+	}
+
+	static void computeBarrier(VkCommandBuffer commandBuffer, VkPipelineStageFlags srcStageMask, VkAccessFlags srcAccessMask, VkPipelineStageFlags dstStageMask, VkAccessFlags dstAccessMask)
+	{
+		VkMemoryBarrier memoryBarrier = vks::initializers::memoryBarrier();
+		memoryBarrier.srcAccessMask = srcAccessMask;
+		memoryBarrier.dstAccessMask = dstAccessMask;
+		vkCmdPipelineBarrier(commandBuffer, srcStageMask, dstStageMask, 0, 1, &memoryBarrier, 0, nullptr, 0, nullptr);
+	}
+
+	void InstanceGrid::recordCulling(VkCommandBuffer commandBuffer)
+	{
+		const uint32_t drawCount = this->drawCount();
+
+		// Uploads of newly resident cells
+		if (!uploads.empty()) {
+			std::vector<VkBufferCopy> copyRegions;
+			for (size_t i = 0; i < uploads.size(); i++) {
+				VkBufferCopy copyRegion{};
+				copyRegion.srcOffset = i * slotCapacity * sizeof(Instance);
+				copyRegion.dstOffset = static_cast<VkDeviceSize>(uploads[i].slot) * slotCapacity * sizeof(Instance);
+				copyRegion.size = cells[uploads[i].cell].instanceCount * sizeof(Instance);
+				copyRegions.push_back(copyRegion);
+			}
+			vkCmdCopyBuffer(commandBuffer, stagingBuffer.buffer, instancePool.buffer, static_cast<uint32_t>(copyRegions.size()), copyRegions.data());
+		}
+		if (cellCulling == CellCullingCPU) {
+			VkBufferCopy copyRegion{};
+			copyRegion.size = (4 + visibleSlots.size()) * sizeof(uint32_t);
+			vkCmdCopyBuffer(commandBuffer, hostCellList.buffer, cellList.buffer, 1, &copyRegion);
+		} else {
+			const uint32_t dispatch[4] = { 0, 1, 1, 0 };
+			vkCmdUpdateBuffer(commandBuffer, cellList.buffer, 0, sizeof(dispatch), dispatch);
+		}
+		vkCmdFillBuffer(commandBuffer, counters.buffer, 0, VK_WHOLE_SIZE, 0);
+		// Also orders the writes of this frame after the draws of the last one that read the compacted instances
+		computeBarrier(commandBuffer,
+			VK_PIPELINE_STAGE_TRANSFER_BIT | VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT | VK_PIPELINE_STAGE_VERTEX_INPUT_BIT, VK_ACCESS_TRANSFER_WRITE_BIT,
+			VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT, VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT | VK_ACCESS_INDIRECT_COMMAND_READ_BIT);
+
+		vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipelineLayout, 0, 1, &descriptorSet, 0, nullptr);
+		if (cellCulling == CellCullingGPU) {
+			vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipelines.cells);
+			vkCmdDispatch(commandBuffer, (slotCount + 63) / 64, 1, 1);
+			computeBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_WRITE_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT, VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_INDIRECT_COMMAND_READ_BIT);
+		}
+
+		// One workgroup per visible cell
+		vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipelines.instances);
+		vkCmdDispatchIndirect(commandBuffer, cellList.buffer, 0);
+		computeBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_WRITE_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT);
+
+		vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipelines.prefix);
+		vkCmdDispatch(commandBuffer, 1, 1, 1);
+		computeBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_WRITE_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT, VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT | VK_ACCESS_INDIRECT_COMMAND_READ_BIT);
+
+		vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipelines.scatter);
+		vkCmdDispatchIndirect(commandBuffer, counters.buffer, 0);
+		computeBarrier(commandBuffer,
+			VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_WRITE_BIT,
+			VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT | VK_PIPELINE_STAGE_VERTEX_INPUT_BIT | VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_INDIRECT_COMMAND_READ_BIT | VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT | VK_ACCESS_TRANSFER_READ_BIT);
+
+		std::array<VkBufferCopy, 2> copyRegions{};
+		copyRegions[0].size = 4 * sizeof(uint32_t);
+		vkCmdCopyBuffer(commandBuffer, cellList.buffer, readback.buffer, 1, &copyRegions[0]);
+		copyRegions[1].dstOffset = 4 * sizeof(uint32_t);
+		copyRegions[1].size = 4 * sizeof(uint32_t) + drawCount * sizeof(uint32_t);
+		vkCmdCopyBuffer(commandBuffer, counters.buffer, readback.buffer, 1, &copyRegions[1]);
+		computeBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_WRITE_BIT, VK_PIPELINE_STAGE_HOST_BIT, VK_ACCESS_HOST_READ_BIT);
+		resultsPending = true;
+	}
+
+	void InstanceGrid::draw(VkCommandBuffer commandBuffer, uint32_t instanceBinding)
+	{
+		const VkDeviceSize offsets[1] = { 0 };
+		vkCmdBindVertexBuffers(commandBuffer, instanceBinding, 1, &visibleInstances.buffer, offsets);
+		if (device->enabledFeatures.multiDrawIndirect) {
+			vkCmdDrawIndexedIndirect(commandBuffer, drawCommands.buffer, 0, drawCount(), sizeof(VkDrawIndexedIndirectCommand));
+		} else {
+			for (uint32_t i = 0; i < drawCount(); i++) {
+				vkCmdDrawIndexedIndirect(commandBuffer, drawCommands.buffer, i * sizeof(VkDrawIndexedIndirectCommand), 1, sizeof(VkDrawIndexedIndirectCommand));
+			}
+		}
+	}
+
+	uint32_t InstanceGrid::drawCount() const
+	{
+		return static_cast<uint32_t>(meshes.size());
+	}
+
+	glm::vec4 InstanceGrid::extent() const
+	{
+		return glm::vec4(gridOrigin, gridOrigin + glm::vec2(gridSize) * settings.cellSize);
+	}
+}
@@ -0,0 +1,214 @@
+/*
+* Vulkan instance grid
+*
+* Buckets large numbers of instances into a uniform grid of cells on the xz plane. Only cells within a streaming radius
+* around the camera are resident on the GPU, they are uploaded into fixed size slots of an instance pool a few cells
+* per frame and evicted once the camera moves away. Whole cells are culled against the view frustum on the CPU or in
+* a compute pass, the instances of visible cells are then culled individually, assigned a level of detail by distance
+* and compacted per mesh and LOD into an indirect draw buffer
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#pragma once
+
+#include <array>
+#include <string>
+#include <vector>
+
+#include "vulkan/vulkan.h"
+#include "VulkanDevice.h"
+#include "VulkanBuffer.h"
+#include "VulkanTools.h"
+
+#define GLM_FORCE_RADIANS
+#define GLM_FORCE_DEPTH_ZERO_TO_ONE
+#include <glm/glm.hpp>
+
+namespace vks
+{
+	class InstanceGrid
+	{
+	public:
+		/** @brief Per instance data, also the vertex input layout of the compacted instances the draws read */
+		struct Instance
+		{
+			glm::vec3 pos;
+			glm::vec3 rotation;
+			float scale;
+			uint32_t type;
+		};
+
+		/** @brief Index range of one mesh type at one level of detail, the radius bounds the mesh around its origin */
+		struct Mesh
+		{
+			uint32_t firstIndex;
+			uint32_t indexCount;
+			float radius;
+		};
+
+		/** @brief Instances closer than the distance use this level, density is the fraction of a cell's instances that is kept */
+		struct LOD
+		{
+			float distance;
+			float density;
+		};
+
+		enum CellCulling { CellCullingCPU = 0, CellCullingGPU = 1 };
+
+		struct Settings
+		{
+			float cellSize = 16.0f;
+			/** @brief Cells closer than this on the xz plane are made resident */
+			float streamingRadius = 128.0f;
+			/** @brief Size of the GPU instance pool, split into one slot per resident cell */
+			uint32_t maxResidentInstances = 1 << 20;
+			/** @brief Bounds the staging memory and the upload cost of a single frame */
+			uint32_t maxUploadsPerFrame = 16;
+		};
+
+		static const uint32_t maxLODs = 8;
+
+		/** @brief Counters of the last update, GPU results lag one frame behind */
+		struct Statistics
+		{
+			uint32_t instances = 0;
+			uint32_t cells = 0;
+			uint32_t slots = 0;
+			uint32_t residentCells = 0;
+			uint32_t residentInstances = 0;
+			uint32_t visibleCells = 0;
+			uint32_t uploads = 0;
+			uint32_t evictions = 0;
+			/** @brief Cells in streaming range that did not fit into the pool */
+			uint32_t missingCells = 0;
+			uint32_t visibleInstances = 0;
+			std::array<uint32_t, maxLODs> lodInstances = {};
+			/** @brief Host times in milliseconds */
+			float buildTime = 0.0f;
+			float updateTime = 0.0f;
+		} statistics;
+
+		CellCulling cellCulling = CellCullingGPU;
+
+	private:
+		struct Cell
+		{
+			uint32_t firstInstance = 0;
+			uint32_t instanceCount = 0;
+			glm::vec3 boundsMin;
+			glm::vec3 boundsMax;
+			int32_t slot = -1;
+		};
+
+		// Matches the std430 layouts of the shaders
+		struct Slot
+		{
+			glm::vec4 boundsMin;
+			glm::vec4 boundsMax;
+			uint32_t instanceCount;
+			uint32_t pad[3];
+		};
+
+		struct DrawInfo
+		{
+			uint32_t firstIndex;
+			uint32_t indexCount;
+			float radius;
+			float pad;
+		};
+
+		struct UniformData
+		{
+			glm::vec4 frustumPlanes[6];
+			glm::vec4 cameraPos;
+			// x = distance, y = density
+			glm::vec4 lods[maxLODs];
+			uint32_t slotCount;
+			uint32_t slotCapacity;
+			uint32_t drawCount;
+			uint32_t lodCount;
+		} uniformData;
+
+		struct Upload
+		{
+			uint32_t cell;
+			uint32_t slot;
+		};
+
+		vks::VulkanDevice *device = nullptr;
+		Settings settings;
+		std::vector<Mesh> meshes;
+		std::vector<LOD> lods;
+		uint32_t typeCount = 0;
+
+		// Host copy of all instances ordered by cell
+		std::vector<Instance> instances;
+		std::vector<Cell> cells;
+		glm::vec2 gridOrigin;
+		glm::ivec2 gridSize;
+		std::vector<uint32_t> freeSlots;
+		std::vector<uint32_t> slotCells;
+		std::vector<Upload> uploads;
+		std::vector<uint32_t> visibleSlots;
+		uint32_t slotCapacity = 0;
+		uint32_t slotCount = 0;
+		bool resultsPending = false;
+
+		vks::Buffer instancePool;
+		vks::Buffer slotBuffer;
+		vks::Buffer stagingBuffer;
+		vks::Buffer hostCellList;
+		vks::Buffer cellList;
+		vks::Buffer candidates;
+		vks::Buffer counters;
+		vks::Buffer drawInfos;
+		vks::Buffer drawCommands;
+		vks::Buffer visibleInstances;
+		vks::Buffer readback;
+		vks::Buffer uniformBuffer;
+
+		VkDescriptorPool descriptorPool = VK_NULL_HANDLE;
+		VkDescriptorSetLayout descriptorSetLayout = VK_NULL_HANDLE;
+		VkDescriptorSet descriptorSet = VK_NULL_HANDLE;
+		VkPipelineLayout pipelineLayout = VK_NULL_HANDLE;
+		struct {
+			VkPipeline cells = VK_NULL_HANDLE;
+			VkPipeline instances = VK_NULL_HANDLE;
+			VkPipeline prefix = VK_NULL_HANDLE;
+			VkPipeline scatter = VK_NULL_HANDLE;
+		} pipelines;
+
+		glm::ivec2 cellCoord(const glm::vec3 &pos) const;
+		float cellDistance(const Cell &cell, const glm::vec3 &cameraPos) const;
+		bool cellInFrustum(const Cell &cell) const;
+		void createBuffers();
+		void readResults();
+		void stream(const glm::vec3 &cameraPos);
+	public:
+		/** @brief Creates the compute pipelines, shaderPath is the folder with the compiled instancegrid shaders */
+		void prepare(vks::VulkanDevice *device, VkPipelineCache pipelineCache, const std::string &shaderPath, const Settings &settings);
+		void destroy();
+
+		/**
+		* Sets the meshes instances are drawn with
+		*
+		* @param meshes One mesh per type and LOD, indexed with type * lods.size() + lod
+		* @param lods Levels of detail with ascending distances, instances beyond the last one are not drawn
+		*/
+		void setMeshes(const std::vector<Mesh> &meshes, const std::vector<LOD> &lods);
+		/** @brief Buckets the instances into cells and creates the GPU resources, the vector is consumed */
+		void build(std::vector<Instance> &instances);
+
+		/** @brief Streams cells in and out and culls the resident cells if culling on the CPU, call once per frame before recording */
+		void update(const glm::vec3 &cameraPos, const glm::mat4 &viewProjection);
+		/** @brief Records the uploads of this frame and the culling passes, must be recorded outside of a render pass */
+		void recordCulling(VkCommandBuffer commandBuffer);
+		/** @brief Binds the compacted instances to the given vertex input binding and draws all meshes and LODs */
+		void draw(VkCommandBuffer commandBuffer, uint32_t instanceBinding);
+
+		uint32_t drawCount() const;
+		/** @brief World space extent of the grid on the xz plane */
+		glm::vec4 extent() const;
+	};
+}
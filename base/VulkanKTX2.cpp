@@ -0,0 +1,121 @@
+/*
+* KTX2 container reader
+*
+* Reads the header and level index of KTX 2.0 files and decodes single mip levels on demand,
+* so textures can be streamed level by level instead of loading the whole payload at once
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#include "VulkanKTX2.h"
+
+#if defined(VKS_KTX2_ZSTD)
+#include <zstd.h>
+#endif
+
+namespace vks
+{
+	namespace ktx2
+	{
+		static const uint8_t ktx2Identifier[12] = { 0xAB, 0x4B, 0x54, 0x58, 0x20, 0x32, 0x30, 0xBB, 0x0D, 0x0A, 0x1A, 0x0A };
+
+		bool isKTX2File(const std::string &filename)
+		{
+			std::ifstream file(filename, std::ios::binary);
+			uint8_t identifier[12] = {};
+			file.read(reinterpret_cast<char*>(identifier), sizeof(identifier));
+			return file.good() && (memcmp(identifier, ktx2Identifier, sizeof(ktx2Identifier)) == 0);
+		}
+
+		/**
+		* Open a KTX2 file and read its header and level index, level data is read on demand
+		*
+		* @param filename Path of the .ktx2 file
+		*
+		* @return False if the file could not be opened or is not a valid KTX 2.0 file
+		*/
+		bool File::open(const std::string &filename)
+		{
+			stream.open(filename, std::ios::binary | std::ios::ate);
+			if (!stream.is_open()) {
+				return false;
+			}
+			fileSize = static_cast<uint64_t>(stream.tellg());
+			stream.seekg(0, std::ios::beg);
+
+			stream.read(reinterpret_cast<char*>(&header), sizeof(Header));
+			if (!stream.good() || (memcmp(header.identifier, ktx2Identifier, sizeof(ktx2Identifier)) != 0)) {
+				return false;
+			}
+			// Files with a level count of zero request runtime mip generation, only the base level is stored
+			levels.resize(std::max(header.levelCount, 1u));
+			stream.read(reinterpret_cast<char*>(levels.data()), levels.size() * sizeof(LevelIndex));
+			return stream.good();
+		}
+
+		bool File::supercompressionSupported() const
+		{
+			switch (header.supercompressionScheme) {
+			case SupercompressionNone:
+				return true;
+#if defined(VKS_KTX2_ZSTD)
+			case SupercompressionZstd:
+				return true;
+#endif
+			default:
+				return false;
+			}
+		}
+
+		uint32_t File::imageLayerCount() const
+		{
+			return std::max(header.layerCount, 1u) * std::max(header.faceCount, 1u);
+		}
+
+		void File::readLevel(uint32_t level, std::vector<uint8_t> &data)
+		{
+			assert(level < levels.size());
+			data.resize(static_cast<size_t>(levels[level].byteLength));
+			stream.seekg(static_cast<std::streamoff>(levels[level].byteOffset), std::ios::beg);
+			stream.read(reinterpret_cast<char*>(data.data()), data.size());
+		}
+
+		bool File::readLevelRange(uint32_t level, uint64_t offset, uint64_t size, void *target)
+		{
+			assert(level < levels.size());
+			assert(offset + size <= levels[level].byteLength);
+			stream.seekg(static_cast<std::streamoff>(levels[level].byteOffset + offset), std::ios::beg);
+			stream.read(static_cast<char*>(target), static_cast<std::streamsize>(size));
+			return stream.good();
+		}
+
+		/**
+		* Expand a Zstd supercompressed level payload into the layout expected by vkCmdCopyBufferToImage
+		* Images of a level are stored layer by layer and face by face, which matches the array layer order of the Vulkan image
+		* Uncompressed levels don't need decoding and are read straight into the staging memory with readLevelRange
+		*
+		* @param level Mip level of the payload
+		* @param source Payload as read by readLevel, released after decoding
+		* @param target Receives the uncompressed level data
+		*
+		* @return False if the payload uses an unsupported supercompression scheme or is corrupt
+		*/
+		bool File::decodeLevel(uint32_t level, std::vector<uint8_t> &source, std::vector<uint8_t> &target) const
+		{
+#if defined(VKS_KTX2_ZSTD)
+			if (header.supercompressionScheme == SupercompressionZstd) {
+				const size_t uncompressedSize = static_cast<size_t>(levels[level].uncompressedByteLength);
+				target.resize(uncompressedSize);
+				size_t result = ZSTD_decompress(target.data(), uncompressedSize, source.data(), source.size());
+				std::vector<uint8_t>().swap(source);
+				return !ZSTD_isError(result) && (result == uncompressedSize);
+			}
+#else
+			(void)level;
+			(void)target;
+#endif
+			std::vector<uint8_t>().swap(source);
+			return false;
+		}
+	}
+}
@@ -0,0 +1,83 @@
+/*
+* KTX2 container reader
+*
+* Reads the header and level index of KTX 2.0 files and decodes single mip levels on demand,
+* so textures can be streamed level by level instead of loading the whole payload at once
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#pragma once
+
+#include <string>
+#include <vector>
+#include <fstream>
+#include <cassert>
+#include <cstring>
+#include <algorithm>
+
+#include "vulkan/vulkan.h"
+
+namespace vks
+{
+	namespace ktx2
+	{
+		enum SupercompressionScheme {
+			SupercompressionNone = 0,
+			SupercompressionBasisLZ = 1,
+			SupercompressionZstd = 2,
+			SupercompressionZLIB = 3
+		};
+
+		struct Header {
+			uint8_t identifier[12];
+			uint32_t vkFormat;
+			uint32_t typeSize;
+			uint32_t pixelWidth;
+			uint32_t pixelHeight;
+			uint32_t pixelDepth;
+			uint32_t layerCount;
+			uint32_t faceCount;
+			uint32_t levelCount;
+			uint32_t supercompressionScheme;
+			uint32_t dfdByteOffset;
+			uint32_t dfdByteLength;
+			uint32_t kvdByteOffset;
+			uint32_t kvdByteLength;
+			uint64_t sgdByteOffset;
+			uint64_t sgdByteLength;
+		};
+
+		struct LevelIndex {
+			uint64_t byteOffset;
+			uint64_t byteLength;
+			uint64_t uncompressedByteLength;
+		};
+
+		/** @brief Returns true if the file starts with the KTX 2.0 identifier */
+		bool isKTX2File(const std::string &filename);
+
+		class File
+		{
+		private:
+			std::ifstream stream;
+		public:
+			Header header{};
+			std::vector<LevelIndex> levels;
+			/** @brief Size of the file on disk in bytes */
+			uint64_t fileSize = 0;
+
+			bool open(const std::string &filename);
+			/** @brief Returns true if the level payload can be decoded by this build (uncompressed, or Zstd with VKS_KTX2_ZSTD), Basis Universal payloads are not supported */
+			bool supercompressionSupported() const;
+			/** @brief Number of array layers the Vulkan image needs (layers times cube faces) */
+			uint32_t imageLayerCount() const;
+			/** @brief Reads the compressed level payload from disk, not thread-safe */
+			void readLevel(uint32_t level, std::vector<uint8_t> &data);
+			/** @brief Reads part of a level payload straight into the given memory (e.g. a mapped staging buffer), not thread-safe */
+			bool readLevelRange(uint32_t level, uint64_t offset, uint64_t size, void *target);
+			/** @brief Expands (and consumes) a Zstd level payload read with readLevel, can be called from worker threads */
+			bool decodeLevel(uint32_t level, std::vector<uint8_t> &source, std::vector<uint8_t> &target) const;
+		};
+	}
+}
@@ -0,0 +1,336 @@
+/*
+* Vulkan meshlet builder
+*
+* Partitions indexed triangle lists into meshlets small enough to be expanded by a single mesh shader workgroup.
+* Triangles are added greedily, preferring neighbours of the last triangle that add few new vertices, so meshlets
+* stay spatially compact. Each meshlet gets a bounding sphere and a normal cone for frustum and backface culling
+* of whole meshlets. The builder only works on host data and can be used without a Vulkan device
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#include "VulkanMeshlets.h"
+
+#include <algorithm>
+#include <array>
+#include <cfloat>
+#include <chrono>
+#include <cmath>
+#include <fstream>
+
+namespace vks
+{
+	static const uint32_t cacheMagic = 0x4c48534d; // "MSHL"
+	static const uint32_t cacheVersion = 1;
+	static const uint32_t invalidTriangle = ~0u;
+	static const uint8_t unassigned = 0xff;
+
+	struct CacheHeader
+	{
+		uint32_t magic;
+		uint32_t version;
+		uint32_t maxVertices;
+		uint32_t maxTriangles;
+		uint64_t sourceHash;
+		uint32_t meshletCount;
+		uint32_t vertexCount;
+		uint32_t triangleCount;
+		uint32_t rangeCount;
+	};
+
+	static inline glm::vec3 readVec3(const void *data, size_t stride, uint32_t index)
+	{
+		const float *v = reinterpret_cast<const float*>(static_cast<const uint8_t*>(data) + stride * index);
+		return glm::vec3(v[0], v[1], v[2]);
+	}
+
+	MeshletBuilder::Range MeshletBuilder::build(const Input &input)
+	{
+		auto tStart = std::chrono::high_resolution_clock::now();
+
+		Range range{ static_cast<uint32_t>(meshlets.size()), 0 };
+		const uint32_t triangleCount = input.indexCount / 3;
+		const uint32_t *sourceIndices = input.indices;
+		const uint32_t baseVertex = input.baseVertex;
+
+		// Triangles adjacent to each vertex, used to grow meshlets along the surface
+		std::vector<uint32_t> adjacencyOffsets(input.vertexCount + 1, 0);
+		for (uint32_t i = 0; i < triangleCount * 3; i++) {
+			adjacencyOffsets[sourceIndices[i] - baseVertex + 1]++;
+		}
+		for (uint32_t i = 0; i < input.vertexCount; i++) {
+			adjacencyOffsets[i + 1] += adjacencyOffsets[i];
+		}
+		std::vector<uint32_t> adjacency(triangleCount * 3);
+		std::vector<uint32_t> adjacencyFill(adjacencyOffsets.begin(), adjacencyOffsets.end() - 1);
+		for (uint32_t i = 0; i < triangleCount * 3; i++) {
+			adjacency[adjacencyFill[sourceIndices[i] - baseVertex]++] = i / 3;
+		}
+
+		std::vector<bool> emitted(triangleCount, false);
+		// Local index of each vertex in the meshlet that is currently built
+		std::vector<uint8_t> localIndex(input.vertexCount, unassigned);
+		std::vector<uint32_t> meshletVertices;
+		std::vector<uint32_t> meshletTriangles;
+		glm::vec3 meshletPositionSum(0.0f);
+		meshletVertices.reserve(maxVertices);
+		meshletTriangles.reserve(maxTriangles);
+
+		// Number of vertices the triangle would add to the current meshlet
+		auto newVertexCount = [&](uint32_t triangle) {
+			const uint32_t a = sourceIndices[triangle * 3 + 0] - baseVertex;
+			const uint32_t b = sourceIndices[triangle * 3 + 1] - baseVertex;
+			const uint32_t c = sourceIndices[triangle * 3 + 2] - baseVertex;
+			uint32_t count = (localIndex[a] == unassigned) ? 1 : 0;
+			if ((b != a) && (localIndex[b] == unassigned)) {
+				count++;
+			}
+			if ((c != a) && (c != b) && (localIndex[c] == unassigned)) {
+				count++;
+			}
+			return count;
+		};
+
+		auto addTriangle = [&](uint32_t triangle) {
+			uint32_t packed = 0;
+			for (uint32_t corner = 0; corner < 3; corner++) {
+				const uint32_t v = sourceIndices[triangle * 3 + corner] - baseVertex;
+				if (localIndex[v] == unassigned) {
+					localIndex[v] = static_cast<uint8_t>(meshletVertices.size());
+					meshletVertices.push_back(v);
+					meshletPositionSum += readVec3(input.positions, input.positionStride, v);
+				}
+				packed |= static_cast<uint32_t>(localIndex[v]) << (corner * 8);
+			}
+			meshletTriangles.push_back(packed);
+		};
+
+		auto finishMeshlet = [&]() {
+			if (meshletTriangles.empty()) {
+				return;
+			}
+			Meshlet meshlet{};
+			meshlet.vertexOffset = static_cast<uint32_t>(vertices.size());
+			meshlet.triangleOffset = static_cast<uint32_t>(triangles.size());
+			meshlet.vertexCount = static_cast<uint32_t>(meshletVertices.size());
+			meshlet.triangleCount = static_cast<uint32_t>(meshletTriangles.size());
+
+			// Bounding sphere around the center of the bounding box
+			glm::vec3 min(FLT_MAX);
+			glm::vec3 max(-FLT_MAX);
+			for (uint32_t v : meshletVertices) {
+				const glm::vec3 pos = readVec3(input.positions, input.positionStride, v);
+				min = glm::min(min, pos);
+				max = glm::max(max, pos);
+			}
+			const glm::vec3 center = (min + max) * 0.5f;
+			float radius = 0.0f;
+			for (uint32_t v : meshletVertices) {
+				radius = std::max(radius, glm::length(readVec3(input.positions, input.positionStride, v) - center));
+			}
+			meshlet.boundingSphere = glm::vec4(center, radius);
+
+			// Normal cone, the axis is the average of the triangle normals and the cone has to contain all of them
+			std::array<glm::vec3, maxTriangles> normals;
+			uint32_t normalCount = 0;
+			glm::vec3 axis(0.0f);
+			for (uint32_t packed : meshletTriangles) {
+				uint32_t v[3];
+				for (uint32_t corner = 0; corner < 3; corner++) {
+					v[corner] = meshletVertices[(packed >> (corner * 8)) & 0xff];
+				}
+				const glm::vec3 p0 = readVec3(input.positions, input.positionStride, v[0]);
+				glm::vec3 normal = glm::cross(readVec3(input.positions, input.positionStride, v[1]) - p0, readVec3(input.positions, input.positionStride, v[2]) - p0);
+				const float area = glm::length(normal);
+				// Degenerate triangles are never visible
+				if (area == 0.0f) {
+					continue;
+				}
+				normal /= area;
+				if (input.normals) {
+					const glm::vec3 vertexNormal = readVec3(input.normals, input.normalStride, v[0]) + readVec3(input.normals, input.normalStride, v[1]) + readVec3(input.normals, input.normalStride, v[2]);
+					if (glm::dot(normal, vertexNormal) < 0.0f) {
+						normal = -normal;
+					}
+				}
+				normals[normalCount++] = normal;
+				axis += normal;
+			}
+			float cutoff = 1.0f;
+			const float axisLength = glm::length(axis);
+			if (axisLength > 0.0f) {
+				axis /= axisLength;
+				float minDot = 1.0f;
+				for (uint32_t i = 0; i < normalCount; i++) {
+					minDot = std::min(minDot, glm::dot(axis, normals[i]));
+				}
+				// Cones wider than ~84 degrees are hardly ever culled, skip the test for them
+				if (minDot > 0.1f) {
+					cutoff = sqrtf(1.0f - minDot * minDot);
+				}
+			}
+			meshlet.cone = glm::vec4(axis, cutoff);
+			meshlets.push_back(meshlet);
+			range.meshletCount++;
+
+			for (uint32_t v : meshletVertices) {
+				vertices.push_back(baseVertex + v);
+				localIndex[v] = unassigned;
+			}
+			triangles.insert(triangles.end(), meshletTriangles.begin(), meshletTriangles.end());
+			meshletVertices.clear();
+			meshletTriangles.clear();
+			meshletPositionSum = glm::vec3(0.0f);
+		};
+
+		// Squared distance of the triangle to the center of the current meshlet, keeps meshlets round instead of growing strips
+		auto centerDistance = [&](uint32_t triangle) {
+			const glm::vec3 center = meshletPositionSum / static_cast<float>(meshletVertices.size());
+			const glm::vec3 pos = readVec3(input.positions, input.positionStride, sourceIndices[triangle * 3] - baseVertex);
+			return glm::dot(pos - center, pos - center);
+		};
+
+		uint32_t scan = 0;
+		uint32_t last = invalidTriangle;
+		for (uint32_t i = 0; i < triangleCount; i++) {
+			// Prefer the unused neighbour of the last triangle that adds the fewest vertices
+			uint32_t next = invalidTriangle;
+			uint32_t nextVertexCount = 4;
+			float nextDistance = FLT_MAX;
+			if ((last != invalidTriangle) && !meshletVertices.empty()) {
+				for (uint32_t corner = 0; corner < 3; corner++) {
+					const uint32_t v = sourceIndices[last * 3 + corner] - baseVertex;
+					for (uint32_t j = adjacencyOffsets[v]; j < adjacencyOffsets[v + 1]; j++) {
+						const uint32_t triangle = adjacency[j];
+						if (emitted[triangle]) {
+							continue;
+						}
+						const uint32_t count = newVertexCount(triangle);
+						if (count > nextVertexCount) {
+							continue;
+						}
+						const float distance = centerDistance(triangle);
+						if ((count < nextVertexCount) || (distance < nextDistance)) {
+							next = triangle;
+							nextVertexCount = count;
+							nextDistance = distance;
+						}
+					}
+				}
+			}
+			// Continue with the next unused triangle in index order if the surface around the last one is used up
+			if (next == invalidTriangle) {
+				while (emitted[scan]) {
+					scan++;
+				}
+				next = scan;
+				nextVertexCount = newVertexCount(next);
+			}
+			if ((meshletVertices.size() + nextVertexCount > maxVertices) || (meshletTriangles.size() == maxTriangles)) {
+				finishMeshlet();
+			}
+			addTriangle(next);
+			emitted[next] = true;
+			last = next;
+		}
+		finishMeshlet();
+
+		ranges.push_back(range);
+		statistics.meshlets = static_cast<uint32_t>(meshlets.size());
+		statistics.triangles = static_cast<uint32_t>(triangles.size());
+		statistics.vertices = static_cast<uint32_t>(vertices.size());
+		statistics.buildTime += std::chrono::duration<float, std::milli>(std::chrono::high_resolution_clock::now() - tStart).count();
+		statistics.cached = false;
+		return range;
+	}
+
+	void MeshletBuilder::clear()
+	{
+		meshlets.clear();
+		vertices.clear();
+		triangles.clear();
+		ranges.clear();
+		statistics = Statistics();
+	}
+
+	std::vector<uint32_t> MeshletBuilder::indices() const
+	{
+		std::vector<uint32_t> result;
+		result.reserve(triangles.size() * 3);
+		for (const Meshlet &meshlet : meshlets) {
+			for (uint32_t i = 0; i < meshlet.triangleCount; i++) {
+				const uint32_t packed = triangles[meshlet.triangleOffset + i];
+				for (uint32_t corner = 0; corner < 3; corner++) {
+					result.push_back(vertices[meshlet.vertexOffset + ((packed >> (corner * 8)) & 0xff)]);
+				}
+			}
+		}
+		return result;
+	}
+
+	uint64_t MeshletBuilder::hash(const void *data, size_t size, uint64_t seed)
+	{
+		const uint8_t *bytes = static_cast<const uint8_t*>(data);
+		uint64_t result = seed;
+		for (size_t i = 0; i < size; i++) {
+			result ^= bytes[i];
+			result *= 1099511628211ull;
+		}
+		return result;
+	}
+
+	bool MeshletBuilder::saveCache(const std::string &filename, uint64_t sourceHash) const
+	{
+		std::ofstream file(filename, std::ios::binary);
+		if (!file.is_open()) {
+			return false;
+		}
+		CacheHeader header{};
+		header.magic = cacheMagic;
+		header.version = cacheVersion;
+		header.maxVertices = maxVertices;
+		header.maxTriangles = maxTriangles;
+		header.sourceHash = sourceHash;
+		header.meshletCount = static_cast<uint32_t>(meshlets.size());
+		header.vertexCount = static_cast<uint32_t>(vertices.size());
+		header.triangleCount = static_cast<uint32_t>(triangles.size());
+		header.rangeCount = static_cast<uint32_t>(ranges.size());
+		file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+		file.write(reinterpret_cast<const char*>(meshlets.data()), meshlets.size() * sizeof(Meshlet));
+		file.write(reinterpret_cast<const char*>(vertices.data()), vertices.size() * sizeof(uint32_t));
+		file.write(reinterpret_cast<const char*>(triangles.data()), triangles.size() * sizeof(uint32_t));
+		file.write(reinterpret_cast<const char*>(ranges.data()), ranges.size() * sizeof(Range));
+		return file.good();
+	}
+
+	bool MeshletBuilder::loadCache(const std::string &filename, uint64_t sourceHash)
+	{
+		std::ifstream file(filename, std::ios::binary);
+		if (!file.is_open()) {
+			return false;
+		}
+		CacheHeader header{};
+		file.read(reinterpret_cast<char*>(&header), sizeof(header));
+		if (!file.good() || (header.magic != cacheMagic) || (header.version != cacheVersion) || (header.maxVertices != maxVertices) || (header.maxTriangles != maxTriangles) || (header.sourceHash != sourceHash)) {
+			return false;
+		}
+		clear();
+		meshlets.resize(header.meshletCount);
+		vertices.resize(header.vertexCount);
+		triangles.resize(header.triangleCount);
+		ranges.resize(header.rangeCount);
+		file.read(reinterpret_cast<char*>(meshlets.data()), meshlets.size() * sizeof(Meshlet));
+		file.read(reinterpret_cast<char*>(vertices.data()), vertices.size() * sizeof(uint32_t));
+		file.read(reinterpret_cast<char*>(triangles.data()), triangles.size() * sizeof(uint32_t));
+		file.read(reinterpret_cast<char*>(ranges.data()), ranges.size() * sizeof(Range));
+		if (!file.good()) {
+			clear();
+			return false;
+		}
+		statistics.meshlets = header.meshletCount;
+		statistics.triangles = header.triangleCount;
+		statistics.vertices = header.vertexCount;
+		statistics.cached = true;
+		return true;
+	}
+}
@@ -0,0 +1,96 @@
+/*
+* Vulkan meshlet builder
+*
+* Partitions indexed triangle lists into meshlets small enough to be expanded by a single mesh shader workgroup.
+* Triangles are added greedily, preferring neighbours of the last triangle that add few new vertices, so meshlets
+* stay spatially compact. Each meshlet gets a bounding sphere and a normal cone for frustum and backface culling
+* of whole meshlets. The builder only works on host data and can be used without a Vulkan device
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+namespace vks
+{
+	/** @brief Matches the std430 layout of the meshlet buffer in the shaders */
+	struct Meshlet
+	{
+		// xyz = center, w = radius
+		glm::vec4 boundingSphere;
+		// xyz = axis the triangle normals are spread around, w = sine of the spread angle, 1.0 if the normals are spread too far for cone culling
+		glm::vec4 cone;
+		// First entry in the vertex and triangle lists
+		uint32_t vertexOffset;
+		uint32_t triangleOffset;
+		uint32_t vertexCount;
+		uint32_t triangleCount;
+	};
+
+	class MeshletBuilder
+	{
+	public:
+		// Limits that fit the output limits all implementations of VK_EXT_mesh_shader support
+		static const uint32_t maxVertices = 64;
+		static const uint32_t maxTriangles = 124;
+
+		/** @brief Source geometry, indices refer to the vertex buffer the positions were taken from */
+		struct Input
+		{
+			const void *positions = nullptr;
+			size_t positionStride = 0;
+			// Optional, triangle normals are oriented to agree with the vertex normals if set (e.g. for mirrored geometry)
+			const void *normals = nullptr;
+			size_t normalStride = 0;
+			// Positions and normals point at the vertex with this index, all indices must be in [baseVertex, baseVertex + vertexCount)
+			uint32_t baseVertex = 0;
+			uint32_t vertexCount = 0;
+			const uint32_t *indices = nullptr;
+			uint32_t indexCount = 0;
+		};
+
+		/** @brief Meshlets built from one input */
+		struct Range
+		{
+			uint32_t firstMeshlet;
+			uint32_t meshletCount;
+		};
+
+		struct Statistics
+		{
+			uint32_t meshlets = 0;
+			uint32_t triangles = 0;
+			// Sum of the vertices of all meshlets, vertices shared by several meshlets are counted once per meshlet
+			uint32_t vertices = 0;
+			/** @brief Host time in milliseconds, 0 if the meshlets were loaded from a cache */
+			float buildTime = 0.0f;
+			bool cached = false;
+		} statistics;
+
+		std::vector<Meshlet> meshlets;
+		/** @brief Source vertex index of every meshlet vertex */
+		std::vector<uint32_t> vertices;
+		/** @brief Three 8 bit meshlet local vertex indices per triangle */
+		std::vector<uint32_t> triangles;
+		std::vector<Range> ranges;
+
+		/** @brief Appends the meshlets of the input and returns their range */
+		Range build(const Input &input);
+		void clear();
+
+		/** @brief Expands the triangles of all meshlets into an index list, meshlet m covers triangleCount * 3 indices starting at triangleOffset * 3 */
+		std::vector<uint32_t> indices() const;
+
+		/** @brief FNV-1a hash, pass the previous result as seed to hash several blocks */
+		static uint64_t hash(const void *data, size_t size, uint64_t seed = 14695981039346656037ull);
+		/** @brief Writes all meshlets and ranges to a binary file, the source hash identifies the geometry they were built from */
+		bool saveCache(const std::string &filename, uint64_t sourceHash) const;
+		/** @brief Replaces the meshlets with the contents of the file, fails if it doesn't exist or was built from other geometry or with other limits */
+		bool loadCache(const std::string &filename, uint64_t sourceHash);
+	};
+}
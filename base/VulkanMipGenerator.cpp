@@ -0,0 +1,329 @@
+/*
+* Vulkan compute mip chain generator
+*
+* Generates all mip levels of a texture with a single compute dispatch and batches the generation
+* of multiple textures into one submission
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#include "VulkanMipGenerator.h"
+
+#include <algorithm>
+#include <chrono>
+
+#if defined(__ANDROID__)
+#include "VulkanAndroid.h"
+#endif
+
+namespace vks
+{
+	MipGenerator *MipGenerator::shared = nullptr;
+
+	struct MipGeneratorPushConstants
+	{
+		int32_t width, height;
+		uint32_t mipLevels;
+		uint32_t filter;
+		uint32_t counterIndex;
+		uint32_t workGroupCount;
+	};
+
+	/**
+	* Enable the extended image usage needed to write sRGB images through UNORM storage views
+	* This is core with Vulkan 1.1 and provided by VK_KHR_maintenance2 on Vulkan 1.0 devices
+	*
+	* @param device Physical device wrapper the logical device will be created from
+	* @param apiVersion Vulkan version the instance has been created with
+	* @param enabledExtensions Device extensions, VK_KHR_maintenance2 is appended if required and supported
+	*/
+	void MipGenerator::requestFeatures(vks::VulkanDevice *device, uint32_t apiVersion, std::vector<const char*> &enabledExtensions)
+	{
+		extendedUsage = std::min(apiVersion, device->properties.apiVersion) >= VK_API_VERSION_1_1;
+		if (!extendedUsage && device->extensionSupported(VK_KHR_MAINTENANCE_2_EXTENSION_NAME)) {
+			auto enabled = [](const char *name) { return strcmp(name, VK_KHR_MAINTENANCE_2_EXTENSION_NAME) == 0; };
+			if (std::find_if(enabledExtensions.begin(), enabledExtensions.end(), enabled) == enabledExtensions.end()) {
+				enabledExtensions.push_back(VK_KHR_MAINTENANCE_2_EXTENSION_NAME);
+			}
+			extendedUsage = true;
+		}
+	}
+
+	/**
+	* Create the compute pipeline used for mip generation
+	*
+	* @param device Vulkan device the textures are created on
+	* @param queue Queue (supporting compute) used to submit the generation commands
+	* @param shaderPath Folder containing the compiled mipgen.comp.spv shader
+	*
+	* @return False if the shader is not available, in which case callers fall back to blitting
+	*/
+	bool MipGenerator::prepare(vks::VulkanDevice *device, VkQueue queue, const std::string &shaderPath)
+	{
+		this->device = device;
+		this->queue = queue;
+
+		const std::string shaderFile = shaderPath + "mipgen.comp.spv";
+#if defined(__ANDROID__)
+		VkShaderModule shaderModule = vks::tools::loadShader(androidApp->activity->assetManager, shaderFile.c_str(), device->logicalDevice);
+#else
+		if (!vks::tools::fileExists(shaderFile)) {
+			return false;
+		}
+		VkShaderModule shaderModule = vks::tools::loadShader(shaderFile.c_str(), device->logicalDevice);
+#endif
+		if (shaderModule == VK_NULL_HANDLE) {
+			return false;
+		}
+
+		std::vector<VkDescriptorSetLayoutBinding> setLayoutBindings = {
+			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, VK_SHADER_STAGE_COMPUTE_BIT, 0, maxMipLevels),
+			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT, 1),
+		};
+		VkDescriptorSetLayoutCreateInfo descriptorLayout = vks::initializers::descriptorSetLayoutCreateInfo(setLayoutBindings);
+		VK_CHECK_RESULT(vkCreateDescriptorSetLayout(device->logicalDevice, &descriptorLayout, nullptr, &descriptorSetLayout));
+
+		VkPushConstantRange pushConstantRange = vks::initializers::pushConstantRange(VK_SHADER_STAGE_COMPUTE_BIT, sizeof(MipGeneratorPushConstants), 0);
+		VkPipelineLayoutCreateInfo pipelineLayoutCreateInfo = vks::initializers::pipelineLayoutCreateInfo(&descriptorSetLayout, 1);
+		pipelineLayoutCreateInfo.pushConstantRangeCount = 1;
+		pipelineLayoutCreateInfo.pPushConstantRanges = &pushConstantRange;
+		VK_CHECK_RESULT(vkCreatePipelineLayout(device->logicalDevice, &pipelineLayoutCreateInfo, nullptr, &pipelineLayout));
+
+		VkComputePipelineCreateInfo computePipelineCreateInfo = vks::initializers::computePipelineCreateInfo(pipelineLayout, 0);
+		computePipelineCreateInfo.stage.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+		computePipelineCreateInfo.stage.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+		computePipelineCreateInfo.stage.module = shaderModule;
+		computePipelineCreateInfo.stage.pName = "main";
+		VK_CHECK_RESULT(vkCreateComputePipelines(device->logicalDevice, VK_NULL_HANDLE, 1, &computePipelineCreateInfo, nullptr, &pipeline));
+		vkDestroyShaderModule(device->logicalDevice, shaderModule, nullptr);
+		return true;
+	}
+
+	void MipGenerator::destroy()
+	{
+		if (!device) {
+			return;
+		}
+		release();
+		vkDestroyPipeline(device->logicalDevice, pipeline, nullptr);
+		vkDestroyPipelineLayout(device->logicalDevice, pipelineLayout, nullptr);
+		vkDestroyDescriptorSetLayout(device->logicalDevice, descriptorSetLayout, nullptr);
+		pipeline = VK_NULL_HANDLE;
+		pipelineLayout = VK_NULL_HANDLE;
+		descriptorSetLayout = VK_NULL_HANDLE;
+		device = nullptr;
+	}
+
+	bool MipGenerator::ready() const
+	{
+		return pipeline != VK_NULL_HANDLE;
+	}
+
+	/**
+	* Check if the mip chain of an image can be generated in a single dispatch
+	* sRGB images are written through UNORM views, so they need to be created with imageCreateFlags(format), which
+	* requires the extended usage enabled by requestFeatures
+	*/
+	bool MipGenerator::supported(VkFormat format, uint32_t width, uint32_t height, uint32_t mipLevels) const
+	{
+		if (!ready() || ((format != VK_FORMAT_R8G8B8A8_UNORM) && (format != VK_FORMAT_R8G8B8A8_SRGB))) {
+			return false;
+		}
+		if ((format == VK_FORMAT_R8G8B8A8_SRGB) && !extendedUsage) {
+			return false;
+		}
+		VkFormatProperties formatProperties;
+		vkGetPhysicalDeviceFormatProperties(device->physicalDevice, VK_FORMAT_R8G8B8A8_UNORM, &formatProperties);
+		return (formatProperties.optimalTilingFeatures & VK_FORMAT_FEATURE_STORAGE_IMAGE_BIT) && (std::max(width, height) <= maxSize) && (mipLevels <= maxMipLevels);
+	}
+
+	VkImageCreateFlags MipGenerator::imageCreateFlags(VkFormat format)
+	{
+		// The storage usage is only valid for the UNORM view, sRGB formats usually don't support storage images
+		return (format == VK_FORMAT_R8G8B8A8_SRGB) ? (VK_IMAGE_CREATE_MUTABLE_FORMAT_BIT | VK_IMAGE_CREATE_EXTENDED_USAGE_BIT) : 0;
+	}
+
+	/**
+	* Queue the mip chain generation of an image, it is recorded by the next call to record or flush
+	* The image must have been created with VK_IMAGE_USAGE_STORAGE_BIT
+	*
+	* @param image Image to generate the mip chain for
+	* @param format Format of the image
+	* @param width Width of the base level
+	* @param height Height of the base level
+	* @param mipLevels Number of mip levels of the image
+	* @param filter How texels are averaged (sRGB formats always use FilterSRGB)
+	* @param baseLevelLayout Current layout of the base level, remaining levels are assumed to be undefined
+	* @param finalLayout Layout all levels are transitioned to after generation
+	*/
+	void MipGenerator::add(VkImage image, VkFormat format, uint32_t width, uint32_t height, uint32_t mipLevels, Filter filter, VkImageLayout baseLevelLayout, VkImageLayout finalLayout)
+	{
+		assert(supported(format, width, height, mipLevels));
+		if (format == VK_FORMAT_R8G8B8A8_SRGB) {
+			filter = FilterSRGB;
+		}
+		pending.push_back({ image, format, width, height, mipLevels, filter, baseLevelLayout, finalLayout });
+	}
+
+	/** @brief Generate the mip chain of an image (see add), outside of a batch the generation is submitted right away */
+	void MipGenerator::generate(VkImage image, VkFormat format, uint32_t width, uint32_t height, uint32_t mipLevels, Filter filter, VkImageLayout baseLevelLayout, VkImageLayout finalLayout)
+	{
+		add(image, format, width, height, mipLevels, filter, baseLevelLayout, finalLayout);
+		if (batchDepth == 0) {
+			flush();
+		}
+	}
+
+	/** @brief Collect all following generate calls until the matching endBatch into a single submission */
+	void MipGenerator::beginBatch()
+	{
+		batchDepth++;
+	}
+
+	void MipGenerator::endBatch()
+	{
+		assert(batchDepth > 0);
+		batchDepth--;
+		if ((batchDepth == 0) && !pending.empty()) {
+			flush();
+		}
+	}
+
+	/**
+	* Record the generation of all pending images into a command buffer
+	* Layout transitions of all images are issued as one barrier before and one barrier after the dispatches
+	* The resources used by the commands have to be freed with release after the command buffer has finished executing
+	*/
+	void MipGenerator::record(VkCommandBuffer commandBuffer)
+	{
+		release();
+		const uint32_t count = static_cast<uint32_t>(pending.size());
+		if (count == 0) {
+			return;
+		}
+
+		// One completion counter per image, used to elect the workgroup that reduces the last levels
+		VK_CHECK_RESULT(device->createBuffer(VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, &counterBuffer, count * sizeof(uint32_t)));
+		vkCmdFillBuffer(commandBuffer, counterBuffer.buffer, 0, VK_WHOLE_SIZE, 0);
+
+		std::vector<VkDescriptorPoolSize> poolSizes = {
+			vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, count * maxMipLevels),
+			vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, count),
+		};
+		VkDescriptorPoolCreateInfo descriptorPoolInfo = vks::initializers::descriptorPoolCreateInfo(poolSizes, count);
+		VK_CHECK_RESULT(vkCreateDescriptorPool(device->logicalDevice, &descriptorPoolInfo, nullptr, &descriptorPool));
+
+		std::vector<VkDescriptorSet> descriptorSets(count);
+		std::vector<VkDescriptorSetLayout> setLayouts(count, descriptorSetLayout);
+		VkDescriptorSetAllocateInfo allocInfo = vks::initializers::descriptorSetAllocateInfo(descriptorPool, setLayouts.data(), count);
+		VK_CHECK_RESULT(vkAllocateDescriptorSets(device->logicalDevice, &allocInfo, descriptorSets.data()));
+
+		std::vector<VkImageMemoryBarrier> preBarriers;
+		std::vector<VkImageMemoryBarrier> postBarriers;
+		for (uint32_t i = 0; i < count; i++) {
+			const Request &request = pending[i];
+
+			// Storage images can't use sRGB formats, so every level is accessed through a UNORM view
+			std::vector<VkDescriptorImageInfo> imageInfos(maxMipLevels);
+			for (uint32_t level = 0; level < request.mipLevels; level++) {
+				VkImageViewCreateInfo viewCreateInfo = vks::initializers::imageViewCreateInfo();
+				viewCreateInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
+				viewCreateInfo.format = VK_FORMAT_R8G8B8A8_UNORM;
+				viewCreateInfo.subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, level, 1, 0, 1 };
+				viewCreateInfo.image = request.image;
+				VkImageView view;
+				VK_CHECK_RESULT(vkCreateImageView(device->logicalDevice, &viewCreateInfo, nullptr, &view));
+				views.push_back(view);
+				imageInfos[level] = { VK_NULL_HANDLE, view, VK_IMAGE_LAYOUT_GENERAL };
+			}
+			// All array elements are statically used by the shader, unused ones point at the last level but are never accessed
+			for (uint32_t level = request.mipLevels; level < maxMipLevels; level++) {
+				imageInfos[level] = imageInfos[request.mipLevels - 1];
+			}
+			VkDescriptorBufferInfo counterDescriptor = { counterBuffer.buffer, 0, VK_WHOLE_SIZE };
+			std::vector<VkWriteDescriptorSet> writeDescriptorSets = {
+				vks::initializers::writeDescriptorSet(descriptorSets[i], VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, 0, imageInfos.data(), maxMipLevels),
+				vks::initializers::writeDescriptorSet(descriptorSets[i], VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1, &counterDescriptor),
+			};
+			vkUpdateDescriptorSets(device->logicalDevice, static_cast<uint32_t>(writeDescriptorSets.size()), writeDescriptorSets.data(), 0, nullptr);
+
+			VkImageMemoryBarrier barrier = vks::initializers::imageMemoryBarrier();
+			barrier.image = request.image;
+			barrier.srcAccessMask = VK_ACCESS_MEMORY_WRITE_BIT;
+			barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+			barrier.oldLayout = request.baseLevelLayout;
+			barrier.newLayout = VK_IMAGE_LAYOUT_GENERAL;
+			barrier.subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1 };
+			preBarriers.push_back(barrier);
+			barrier.srcAccessMask = 0;
+			barrier.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+			barrier.subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, 1, request.mipLevels - 1, 0, 1 };
+			if (request.mipLevels > 1) {
+				preBarriers.push_back(barrier);
+			}
+
+			barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+			barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+			barrier.oldLayout = VK_IMAGE_LAYOUT_GENERAL;
+			barrier.newLayout = request.finalLayout;
+			barrier.subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, 0, request.mipLevels, 0, 1 };
+			postBarriers.push_back(barrier);
+		}
+
+		VkBufferMemoryBarrier counterBarrier = vks::initializers::bufferMemoryBarrier();
+		counterBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+		counterBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+		counterBarrier.buffer = counterBuffer.buffer;
+		counterBarrier.size = VK_WHOLE_SIZE;
+		vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 0, nullptr, 1, &counterBarrier, static_cast<uint32_t>(preBarriers.size()), preBarriers.data());
+
+		vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipeline);
+		for (uint32_t i = 0; i < count; i++) {
+			const Request &request = pending[i];
+			MipGeneratorPushConstants pushConstants{};
+			pushConstants.width = static_cast<int32_t>(request.width);
+			pushConstants.height = static_cast<int32_t>(request.height);
+			pushConstants.mipLevels = request.mipLevels;
+			pushConstants.filter = static_cast<uint32_t>(request.filter);
+			pushConstants.counterIndex = i;
+			const uint32_t groupCountX = (request.width + 63) / 64;
+			const uint32_t groupCountY = (request.height + 63) / 64;
+			pushConstants.workGroupCount = groupCountX * groupCountY;
+			vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipelineLayout, 0, 1, &descriptorSets[i], 0, nullptr);
+			vkCmdPushConstants(commandBuffer, pipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(MipGeneratorPushConstants), &pushConstants);
+			vkCmdDispatch(commandBuffer, groupCountX, groupCountY, 1);
+		}
+
+		vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, 0, 0, nullptr, 0, nullptr, static_cast<uint32_t>(postBarriers.size()), postBarriers.data());
+
+		statistics.textureCount += count;
+		pending.clear();
+	}
+
+	/** @brief Free the resources of the last recorded batch */
+	void MipGenerator::release()
+	{
+		for (auto view : views) {
+			vkDestroyImageView(device->logicalDevice, view, nullptr);
+		}
+		views.clear();
+		if (descriptorPool != VK_NULL_HANDLE) {
+			vkDestroyDescriptorPool(device->logicalDevice, descriptorPool, nullptr);
+			descriptorPool = VK_NULL_HANDLE;
+		}
+		counterBuffer.destroy();
+		counterBuffer = {};
+	}
+
+	/** @brief Record and submit all pending generations and wait for them to finish */
+	void MipGenerator::flush()
+	{
+		auto tStart = std::chrono::high_resolution_clock::now();
+		VkCommandBuffer commandBuffer = device->createCommandBuffer(VK_COMMAND_BUFFER_LEVEL_PRIMARY, true);
+		record(commandBuffer);
+		device->flushCommandBuffer(commandBuffer, queue, true);
+		release();
+		statistics.submissionCount++;
+		statistics.time += std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - tStart).count();
+	}
+}
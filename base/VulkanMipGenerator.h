@@ -0,0 +1,83 @@
+/*
+* Vulkan compute mip chain generator
+*
+* Generates all mip levels of a texture with a single compute dispatch and batches the generation
+* of multiple textures into one submission
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include "vulkan/vulkan.h"
+#include "VulkanDevice.h"
+#include "VulkanBuffer.h"
+#include "VulkanTools.h"
+
+namespace vks
+{
+	class MipGenerator
+	{
+	public:
+		/** @brief How texels are averaged, sRGB textures are filtered in linear space and normal maps are renormalized */
+		enum Filter { FilterLinear = 0, FilterSRGB = 1, FilterNormal = 2 };
+
+		/** @brief Largest base level a single dispatch can reduce (64x64 texels per workgroup, 64x64 texels in the last workgroup) */
+		static const uint32_t maxSize = 4096;
+		static const uint32_t maxMipLevels = 13;
+
+		/** @brief Generator prepared by the example base for loaders that aren't passed one (e.g. non-KTX glTF images), nullptr if unavailable */
+		static MipGenerator *shared;
+
+		struct Statistics
+		{
+			uint32_t textureCount = 0;
+			uint32_t submissionCount = 0;
+			double time = 0.0;
+		} statistics;
+
+	private:
+		struct Request
+		{
+			VkImage image;
+			VkFormat format;
+			uint32_t width, height;
+			uint32_t mipLevels;
+			Filter filter;
+			VkImageLayout baseLevelLayout;
+			VkImageLayout finalLayout;
+		};
+
+		vks::VulkanDevice *device = nullptr;
+		VkQueue queue = VK_NULL_HANDLE;
+		VkDescriptorSetLayout descriptorSetLayout = VK_NULL_HANDLE;
+		VkPipelineLayout pipelineLayout = VK_NULL_HANDLE;
+		VkPipeline pipeline = VK_NULL_HANDLE;
+		uint32_t batchDepth = 0;
+		bool extendedUsage = false;
+
+		std::vector<Request> pending;
+		// Resources of the last recorded batch, released once it has finished executing
+		VkDescriptorPool descriptorPool = VK_NULL_HANDLE;
+		std::vector<VkImageView> views;
+		vks::Buffer counterBuffer;
+	public:
+		void requestFeatures(vks::VulkanDevice *device, uint32_t apiVersion, std::vector<const char*> &enabledExtensions);
+		bool prepare(vks::VulkanDevice *device, VkQueue queue, const std::string &shaderPath);
+		void destroy();
+		bool ready() const;
+		bool supported(VkFormat format, uint32_t width, uint32_t height, uint32_t mipLevels) const;
+		static VkImageCreateFlags imageCreateFlags(VkFormat format);
+
+		void add(VkImage image, VkFormat format, uint32_t width, uint32_t height, uint32_t mipLevels, Filter filter, VkImageLayout baseLevelLayout, VkImageLayout finalLayout);
+		void generate(VkImage image, VkFormat format, uint32_t width, uint32_t height, uint32_t mipLevels, Filter filter, VkImageLayout baseLevelLayout, VkImageLayout finalLayout);
+		void beginBatch();
+		void endBatch();
+		void record(VkCommandBuffer commandBuffer);
+		void release();
+		void flush();
+	};
+}
@@ -0,0 +1,674 @@
+/*
+* Vulkan occlusion culler
+*
+* Culls the primitives of glTF models against the view frustum and a hierarchical depth pyramid (Hi-Z) built from
+* the previous frame's depth buffer, surviving draws are written to an indirect buffer without any CPU readback
+* Occlusion queries with a ring of per-frame query slots that are read back frames later serve as a fallback
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#include "VulkanOcclusionCuller.h"
+
+#include <array>
+#include <cfloat>
+#include <cmath>
+
+#if defined(__ANDROID__)
+#include "VulkanAndroid.h"
+#endif
+
+namespace vks
+{
+	struct DepthPyramidPushConstants
+	{
+		int32_t inputWidth, inputHeight;
+		int32_t outputWidth, outputHeight;
+		uint32_t reduce;
+	};
+
+	static VkShaderModule loadShaderModule(VkDevice device, const std::string &fileName)
+	{
+#if defined(__ANDROID__)
+		VkShaderModule shaderModule = vks::tools::loadShader(androidApp->activity->assetManager, fileName.c_str(), device);
+#else
+		VkShaderModule shaderModule = vks::tools::loadShader(fileName.c_str(), device);
+#endif
+		assert(shaderModule != VK_NULL_HANDLE);
+		return shaderModule;
+	}
+
+	/**
+	* Create the pipelines and descriptors shared by all culling modes
+	*
+	* @param device Vulkan device to create the resources on
+	* @param queue Queue used to upload the draw data
+	* @param renderPass Render pass the occlusion query proxies are drawn in
+	* @param pipelineCache Optional pipeline cache
+	* @param shaderPath Folder containing the compiled hizpyramid, occlusioncull and occlusionproxy shaders
+	* @param frameCount Number of frames in flight (command buffers), query results are read back once a frame's slot comes around again
+	*/
+	void OcclusionCuller::prepare(vks::VulkanDevice *device, VkQueue queue, VkRenderPass renderPass, VkPipelineCache pipelineCache, const std::string &shaderPath, uint32_t frameCount)
+	{
+		this->device = device;
+		this->queue = queue;
+		frames.resize(frameCount);
+
+		// Draws, indirect commands, statistics, uniforms and the depth pyramid, the query proxies only use the draws and uniforms
+		std::vector<VkDescriptorSetLayoutBinding> setLayoutBindings = {
+			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT | VK_SHADER_STAGE_VERTEX_BIT, 0),
+			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT, 1),
+			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT, 2),
+			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT | VK_SHADER_STAGE_VERTEX_BIT, 3),
+			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_COMPUTE_BIT, 4),
+		};
+		VkDescriptorSetLayoutCreateInfo descriptorLayout = vks::initializers::descriptorSetLayoutCreateInfo(setLayoutBindings);
+		VK_CHECK_RESULT(vkCreateDescriptorSetLayout(device->logicalDevice, &descriptorLayout, nullptr, &descriptorSetLayout));
+
+		// Every pyramid level reads the level above it (or the depth buffer) and writes its own storage image view
+		setLayoutBindings = {
+			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_COMPUTE_BIT, 0),
+			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, VK_SHADER_STAGE_COMPUTE_BIT, 1),
+		};
+		descriptorLayout = vks::initializers::descriptorSetLayoutCreateInfo(setLayoutBindings);
+		VK_CHECK_RESULT(vkCreateDescriptorSetLayout(device->logicalDevice, &descriptorLayout, nullptr, &pyramidDescriptorSetLayout));
+
+		VkPushConstantRange pushConstantRange = vks::initializers::pushConstantRange(VK_SHADER_STAGE_VERTEX_BIT, sizeof(uint32_t), 0);
+		VkPipelineLayoutCreateInfo pipelineLayoutCreateInfo = vks::initializers::pipelineLayoutCreateInfo(&descriptorSetLayout, 1);
+		pipelineLayoutCreateInfo.pushConstantRangeCount = 1;
+		pipelineLayoutCreateInfo.pPushConstantRanges = &pushConstantRange;
+		VK_CHECK_RESULT(vkCreatePipelineLayout(device->logicalDevice, &pipelineLayoutCreateInfo, nullptr, &pipelineLayout));
+
+		pushConstantRange = vks::initializers::pushConstantRange(VK_SHADER_STAGE_COMPUTE_BIT, sizeof(DepthPyramidPushConstants), 0);
+		pipelineLayoutCreateInfo = vks::initializers::pipelineLayoutCreateInfo(&pyramidDescriptorSetLayout, 1);
+		pipelineLayoutCreateInfo.pushConstantRangeCount = 1;
+		pipelineLayoutCreateInfo.pPushConstantRanges = &pushConstantRange;
+		VK_CHECK_RESULT(vkCreatePipelineLayout(device->logicalDevice, &pipelineLayoutCreateInfo, nullptr, &pyramidPipelineLayout));
+
+		std::vector<VkDescriptorPoolSize> poolSizes = {
+			vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 3),
+			vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 1),
+			vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 1 + maxPyramidLevels),
+			vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, maxPyramidLevels),
+		};
+		VkDescriptorPoolCreateInfo descriptorPoolInfo = vks::initializers::descriptorPoolCreateInfo(poolSizes, 1 + maxPyramidLevels);
+		VK_CHECK_RESULT(vkCreateDescriptorPool(device->logicalDevice, &descriptorPoolInfo, nullptr, &descriptorPool));
+
+		VkDescriptorSetAllocateInfo allocInfo = vks::initializers::descriptorSetAllocateInfo(descriptorPool, &descriptorSetLayout, 1);
+		VK_CHECK_RESULT(vkAllocateDescriptorSets(device->logicalDevice, &allocInfo, &descriptorSet));
+		pyramid.descriptorSets.resize(maxPyramidLevels);
+		std::vector<VkDescriptorSetLayout> setLayouts(maxPyramidLevels, pyramidDescriptorSetLayout);
+		allocInfo = vks::initializers::descriptorSetAllocateInfo(descriptorPool, setLayouts.data(), maxPyramidLevels);
+		VK_CHECK_RESULT(vkAllocateDescriptorSets(device->logicalDevice, &allocInfo, pyramid.descriptorSets.data()));
+
+		// Compute pipelines
+		VkComputePipelineCreateInfo computePipelineCreateInfo = vks::initializers::computePipelineCreateInfo(pipelineLayout, 0);
+		computePipelineCreateInfo.stage.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+		computePipelineCreateInfo.stage.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+		computePipelineCreateInfo.stage.module = loadShaderModule(device->logicalDevice, shaderPath + "occlusioncull.comp.spv");
+		computePipelineCreateInfo.stage.pName = "main";
+		VK_CHECK_RESULT(vkCreateComputePipelines(device->logicalDevice, pipelineCache, 1, &computePipelineCreateInfo, nullptr, &pipelines.cull));
+		vkDestroyShaderModule(device->logicalDevice, computePipelineCreateInfo.stage.module, nullptr);
+
+		computePipelineCreateInfo.layout = pyramidPipelineLayout;
+		computePipelineCreateInfo.stage.module = loadShaderModule(device->logicalDevice, shaderPath + "hizpyramid.comp.spv");
+		VK_CHECK_RESULT(vkCreateComputePipelines(device->logicalDevice, pipelineCache, 1, &computePipelineCreateInfo, nullptr, &pipelines.pyramid));
+		vkDestroyShaderModule(device->logicalDevice, computePipelineCreateInfo.stage.module, nullptr);
+
+		// Occlusion query proxies are the bounding boxes of the draws, tested against the depth buffer without writing to any attachment
+		VkPipelineInputAssemblyStateCreateInfo inputAssemblyState = vks::initializers::pipelineInputAssemblyStateCreateInfo(VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST, 0, VK_FALSE);
+		VkPipelineRasterizationStateCreateInfo rasterizationState = vks::initializers::pipelineRasterizationStateCreateInfo(VK_POLYGON_MODE_FILL, VK_CULL_MODE_NONE, VK_FRONT_FACE_COUNTER_CLOCKWISE, 0);
+		VkPipelineColorBlendAttachmentState blendAttachmentState = vks::initializers::pipelineColorBlendAttachmentState(0, VK_FALSE);
+		VkPipelineColorBlendStateCreateInfo colorBlendState = vks::initializers::pipelineColorBlendStateCreateInfo(1, &blendAttachmentState);
+		VkPipelineDepthStencilStateCreateInfo depthStencilState = vks::initializers::pipelineDepthStencilStateCreateInfo(VK_TRUE, VK_FALSE, VK_COMPARE_OP_LESS_OR_EQUAL);
+		VkPipelineViewportStateCreateInfo viewportState = vks::initializers::pipelineViewportStateCreateInfo(1, 1, 0);
+		VkPipelineMultisampleStateCreateInfo multisampleState = vks::initializers::pipelineMultisampleStateCreateInfo(VK_SAMPLE_COUNT_1_BIT, 0);
+		std::vector<VkDynamicState> dynamicStateEnables = { VK_DYNAMIC_STATE_VIEWPORT, VK_DYNAMIC_STATE_SCISSOR };
+		VkPipelineDynamicStateCreateInfo dynamicState = vks::initializers::pipelineDynamicStateCreateInfo(dynamicStateEnables);
+		VkPipelineVertexInputStateCreateInfo vertexInputState = vks::initializers::pipelineVertexInputStateCreateInfo();
+		std::array<VkPipelineShaderStageCreateInfo, 2> shaderStages{};
+		shaderStages[0].sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+		shaderStages[0].stage = VK_SHADER_STAGE_VERTEX_BIT;
+		shaderStages[0].module = loadShaderModule(device->logicalDevice, shaderPath + "occlusionproxy.vert.spv");
+		shaderStages[0].pName = "main";
+		shaderStages[1].sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+		shaderStages[1].stage = VK_SHADER_STAGE_FRAGMENT_BIT;
+		shaderStages[1].module = loadShaderModule(device->logicalDevice, shaderPath + "occlusionproxy.frag.spv");
+		shaderStages[1].pName = "main";
+
+		VkGraphicsPipelineCreateInfo pipelineCI = vks::initializers::pipelineCreateInfo(pipelineLayout, renderPass, 0);
+		pipelineCI.pVertexInputState = &vertexInputState;
+		pipelineCI.pInputAssemblyState = &inputAssemblyState;
+		pipelineCI.pRasterizationState = &rasterizationState;
+		pipelineCI.pColorBlendState = &colorBlendState;
+		pipelineCI.pMultisampleState = &multisampleState;
+		pipelineCI.pViewportState = &viewportState;
+		pipelineCI.pDepthStencilState = &depthStencilState;
+		pipelineCI.pDynamicState = &dynamicState;
+		pipelineCI.stageCount = static_cast<uint32_t>(shaderStages.size());
+		pipelineCI.pStages = shaderStages.data();
+		VK_CHECK_RESULT(vkCreateGraphicsPipelines(device->logicalDevice, pipelineCache, 1, &pipelineCI, nullptr, &pipelines.proxy));
+		for (auto &shaderStage : shaderStages) {
+			vkDestroyShaderModule(device->logicalDevice, shaderStage.module, nullptr);
+		}
+
+		VK_CHECK_RESULT(device->createBuffer(VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, &uniformBuffer, sizeof(UniformData)));
+		VK_CHECK_RESULT(uniformBuffer.map());
+
+		VkSamplerCreateInfo samplerCreateInfo = vks::initializers::samplerCreateInfo();
+		samplerCreateInfo.magFilter = VK_FILTER_NEAREST;
+		samplerCreateInfo.minFilter = VK_FILTER_NEAREST;
+		samplerCreateInfo.mipmapMode = VK_SAMPLER_MIPMAP_MODE_NEAREST;
+		samplerCreateInfo.addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+		samplerCreateInfo.addressModeV = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+		samplerCreateInfo.addressModeW = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+		samplerCreateInfo.maxLod = static_cast<float>(maxPyramidLevels);
+		VK_CHECK_RESULT(vkCreateSampler(device->logicalDevice, &samplerCreateInfo, nullptr, &pyramid.sampler));
+	}
+
+	void OcclusionCuller::destroy()
+	{
+		if (!device) {
+			return;
+		}
+		destroyPyramid();
+		vkDestroySampler(device->logicalDevice, pyramid.sampler, nullptr);
+		vkDestroyPipeline(device->logicalDevice, pipelines.cull, nullptr);
+		vkDestroyPipeline(device->logicalDevice, pipelines.pyramid, nullptr);
+		vkDestroyPipeline(device->logicalDevice, pipelines.proxy, nullptr);
+		vkDestroyPipelineLayout(device->logicalDevice, pipelineLayout, nullptr);
+		vkDestroyPipelineLayout(device->logicalDevice, pyramidPipelineLayout, nullptr);
+		vkDestroyDescriptorSetLayout(device->logicalDevice, descriptorSetLayout, nullptr);
+		vkDestroyDescriptorSetLayout(device->logicalDevice, pyramidDescriptorSetLayout, nullptr);
+		vkDestroyDescriptorPool(device->logicalDevice, descriptorPool, nullptr);
+		if (queryPool != VK_NULL_HANDLE) {
+			vkDestroyQueryPool(device->logicalDevice, queryPool, nullptr);
+		}
+		for (auto &frame : frames) {
+			frame.readback.destroy();
+			frame.indirectCommands.destroy();
+		}
+		drawBuffer.destroy();
+		indirectBuffer.destroy();
+		statisticsBuffer.destroy();
+		uniformBuffer.destroy();
+		device = nullptr;
+	}
+
+	/**
+	* Add a draw for every primitive of a glTF model instance
+	* Bounds are taken from the primitive's accessor bounds and transformed by the node hierarchy and the instance transform,
+	* so they match models loaded with and without PreTransformVertices
+	*
+	* @param model Model to add, its vertex and index buffers must be bound when drawing the returned range
+	* @param transform World transform of this instance
+	* @param instanceIndex Passed as firstInstance of the draws to select per instance data
+	* @param flipY Set if the model has been loaded with FileLoadingFlags::FlipY
+	*
+	* @return Index of the first draw added, draws of a model are consecutive
+	*/
+	uint32_t OcclusionCuller::addModel(const vkglTF::Model &model, const glm::mat4 &transform, uint32_t instanceIndex, bool flipY)
+	{
+		const uint32_t firstDraw = static_cast<uint32_t>(draws.size());
+		const glm::mat4 flip = glm::scale(glm::mat4(1.0f), glm::vec3(1.0f, flipY ? -1.0f : 1.0f, 1.0f));
+		for (auto node : model.linearNodes) {
+			if (!node->mesh) {
+				continue;
+			}
+			const glm::mat4 matrix = transform * flip * node->getMatrix();
+			for (auto primitive : node->mesh->primitives) {
+				if (primitive->indexCount == 0) {
+					continue;
+				}
+				glm::vec3 boundsMin(FLT_MAX);
+				glm::vec3 boundsMax(-FLT_MAX);
+				for (uint32_t i = 0; i < 8; i++) {
+					glm::vec3 corner((i & 1) ? primitive->dimensions.max.x : primitive->dimensions.min.x, (i & 2) ? primitive->dimensions.max.y : primitive->dimensions.min.y, (i & 4) ? primitive->dimensions.max.z : primitive->dimensions.min.z);
+					corner = glm::vec3(matrix * glm::vec4(corner, 1.0f));
+					boundsMin = glm::min(boundsMin, corner);
+					boundsMax = glm::max(boundsMax, corner);
+				}
+				Draw draw{};
+				draw.boundsMin = glm::vec4(boundsMin, 1.0f);
+				draw.boundsMax = glm::vec4(boundsMax, 1.0f);
+				draw.indexCount = primitive->indexCount;
+				draw.firstIndex = primitive->firstIndex;
+				draw.vertexOffset = 0;
+				draw.firstInstance = instanceIndex;
+				draws.push_back(draw);
+			}
+		}
+		return firstDraw;
+	}
+
+	/** @brief Upload the draws and create the per draw resources, call once after all models have been added */
+	void OcclusionCuller::finalize()
+	{
+		assert(!draws.empty());
+		const uint32_t count = drawCount();
+		const VkDeviceSize commandsSize = count * sizeof(VkDrawIndexedIndirectCommand);
+
+		vks::Buffer stagingBuffer;
+		VK_CHECK_RESULT(device->createBuffer(VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, &stagingBuffer, count * sizeof(Draw), draws.data()));
+		VK_CHECK_RESULT(device->createBuffer(VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, &drawBuffer, count * sizeof(Draw)));
+		device->copyBuffer(&stagingBuffer, &drawBuffer, queue);
+		stagingBuffer.destroy();
+
+		VK_CHECK_RESULT(device->createBuffer(VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, &indirectBuffer, commandsSize));
+		VK_CHECK_RESULT(device->createBuffer(VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, &statisticsBuffer, 4 * sizeof(uint32_t)));
+		for (auto &frame : frames) {
+			VK_CHECK_RESULT(device->createBuffer(VK_BUFFER_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, &frame.readback, 4 * sizeof(uint32_t)));
+			VK_CHECK_RESULT(frame.readback.map());
+			memset(frame.readback.mapped, 0, 4 * sizeof(uint32_t));
+			VK_CHECK_RESULT(device->createBuffer(VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, &frame.indirectCommands, commandsSize));
+			VK_CHECK_RESULT(frame.indirectCommands.map());
+			frame.inFrustum.assign(count, false);
+		}
+		visibility.assign(count, true);
+		queryResults.resize(count * 2);
+
+		// Each frame owns a slot of drawCount queries, so results are never overwritten before they have been read
+		VkQueryPoolCreateInfo queryPoolInfo{};
+		queryPoolInfo.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+		queryPoolInfo.queryType = VK_QUERY_TYPE_OCCLUSION;
+		queryPoolInfo.queryCount = count * static_cast<uint32_t>(frames.size());
+		VK_CHECK_RESULT(vkCreateQueryPool(device->logicalDevice, &queryPoolInfo, nullptr, &queryPool));
+
+		std::vector<VkWriteDescriptorSet> writeDescriptorSets = {
+			vks::initializers::writeDescriptorSet(descriptorSet, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 0, &drawBuffer.descriptor),
+			vks::initializers::writeDescriptorSet(descriptorSet, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1, &indirectBuffer.descriptor),
+			vks::initializers::writeDescriptorSet(descriptorSet, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 2, &statisticsBuffer.descriptor),
+			vks::initializers::writeDescriptorSet(descriptorSet, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 3, &uniformBuffer.descriptor),
+		};
+		vkUpdateDescriptorSets(device->logicalDevice, static_cast<uint32_t>(writeDescriptorSets.size()), writeDescriptorSets.data(), 0, nullptr);
+
+		uniformData.drawCount = count;
+		statistics.drawCount = count;
+	}
+
+	uint32_t OcclusionCuller::drawCount() const
+	{
+		return static_cast<uint32_t>(draws.size());
+	}
+
+	bool OcclusionCuller::supported(Mode mode) const
+	{
+		return (mode != ModeHiZ) || pyramidSupported;
+	}
+
+	void OcclusionCuller::destroyPyramid()
+	{
+		for (auto view : pyramid.levelViews) {
+			vkDestroyImageView(device->logicalDevice, view, nullptr);
+		}
+		pyramid.levelViews.clear();
+		if (pyramid.image != VK_NULL_HANDLE) {
+			vkDestroyImageView(device->logicalDevice, pyramid.view, nullptr);
+			vkDestroyImage(device->logicalDevice, pyramid.image, nullptr);
+			vkFreeMemory(device->logicalDevice, pyramid.memory, nullptr);
+			pyramid.view = VK_NULL_HANDLE;
+			pyramid.image = VK_NULL_HANDLE;
+			pyramid.memory = VK_NULL_HANDLE;
+		}
+		if (pyramid.depthView != VK_NULL_HANDLE) {
+			vkDestroyImageView(device->logicalDevice, pyramid.depthView, nullptr);
+			pyramid.depthView = VK_NULL_HANDLE;
+		}
+	}
+
+	/**
+	* (Re)create the depth pyramid for a depth buffer, needs to be called whenever the depth buffer is recreated and before recording any commands
+	* The depth image must have been created with VK_IMAGE_USAGE_SAMPLED_BIT, its contents have to be stored at the end of the render pass
+	*
+	* @param depthImage Depth buffer the pyramid is built from, expected to be in VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL after the render pass
+	* @param depthFormat Format of the depth buffer
+	* @param width Width of the depth buffer
+	* @param height Height of the depth buffer
+	*/
+	void OcclusionCuller::resize(VkImage depthImage, VkFormat depthFormat, uint32_t width, uint32_t height)
+	{
+		destroyPyramid();
+		pyramidFrameCount = 0;
+
+		VkFormatProperties formatProperties;
+		vkGetPhysicalDeviceFormatProperties(device->physicalDevice, depthFormat, &formatProperties);
+		pyramidSupported = (formatProperties.optimalTilingFeatures & VK_FORMAT_FEATURE_SAMPLED_IMAGE_BIT) != 0;
+		if (!pyramidSupported) {
+			if (mode == ModeHiZ) {
+				mode = ModeQueries;
+			}
+			return;
+		}
+
+		// Level 0 has the size of the depth buffer, odd sizes are rounded down and the remaining row or column is folded into the last texel
+		pyramid.width = width;
+		pyramid.height = height;
+		pyramid.levels = static_cast<uint32_t>(floor(log2(std::max(width, height)))) + 1;
+		assert(pyramid.levels <= maxPyramidLevels);
+		pyramid.depthImage = depthImage;
+		pyramid.depthAspectMask = VK_IMAGE_ASPECT_DEPTH_BIT;
+		if (depthFormat >= VK_FORMAT_D16_UNORM_S8_UINT) {
+			pyramid.depthAspectMask |= VK_IMAGE_ASPECT_STENCIL_BIT;
+		}
+
+		VkImageCreateInfo imageCreateInfo = vks::initializers::imageCreateInfo();
+		imageCreateInfo.imageType = VK_IMAGE_TYPE_2D;
+		imageCreateInfo.format = VK_FORMAT_R32_SFLOAT;
+		imageCreateInfo.extent = { width, height, 1 };
+		imageCreateInfo.mipLevels = pyramid.levels;
+		imageCreateInfo.arrayLayers = 1;
+		imageCreateInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+		imageCreateInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+		imageCreateInfo.usage = VK_IMAGE_USAGE_STORAGE_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
+		imageCreateInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+		VK_CHECK_RESULT(vkCreateImage(device->logicalDevice, &imageCreateInfo, nullptr, &pyramid.image));
+		VkMemoryRequirements memReqs;
+		vkGetImageMemoryRequirements(device->logicalDevice, pyramid.image, &memReqs);
+		VkMemoryAllocateInfo memAllocInfo = vks::initializers::memoryAllocateInfo();
+		memAllocInfo.allocationSize = memReqs.size;
+		memAllocInfo.memoryTypeIndex = device->getMemoryType(memReqs.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+		VK_CHECK_RESULT(vkAllocateMemory(device->logicalDevice, &memAllocInfo, nullptr, &pyramid.memory));
+		VK_CHECK_RESULT(vkBindImageMemory(device->logicalDevice, pyramid.image, pyramid.memory, 0));
+
+		VkImageViewCreateInfo viewCreateInfo = vks::initializers::imageViewCreateInfo();
+		viewCreateInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
+		viewCreateInfo.format = VK_FORMAT_R32_SFLOAT;
+		viewCreateInfo.image = pyramid.image;
+		viewCreateInfo.subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, 0, pyramid.levels, 0, 1 };
+		VK_CHECK_RESULT(vkCreateImageView(device->logicalDevice, &viewCreateInfo, nullptr, &pyramid.view));
+		pyramid.levelViews.resize(pyramid.levels);
+		for (uint32_t level = 0; level < pyramid.levels; level++) {
+			viewCreateInfo.subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, level, 1, 0, 1 };
+			VK_CHECK_RESULT(vkCreateImageView(device->logicalDevice, &viewCreateInfo, nullptr, &pyramid.levelViews[level]));
+		}
+
+		// Sampled views must only contain the depth aspect
+		viewCreateInfo.format = depthFormat;
+		viewCreateInfo.image = depthImage;
+		viewCreateInfo.subresourceRange = { VK_IMAGE_ASPECT_DEPTH_BIT, 0, 1, 0, 1 };
+		VK_CHECK_RESULT(vkCreateImageView(device->logicalDevice, &viewCreateInfo, nullptr, &pyramid.depthView));
+
+		VkCommandBuffer commandBuffer = device->createCommandBuffer(VK_COMMAND_BUFFER_LEVEL_PRIMARY, true);
+		vks::tools::setImageLayout(commandBuffer, pyramid.image, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_GENERAL, { VK_IMAGE_ASPECT_COLOR_BIT, 0, pyramid.levels, 0, 1 });
+		device->flushCommandBuffer(commandBuffer, queue, true);
+
+		std::vector<VkDescriptorImageInfo> inputDescriptors(pyramid.levels);
+		std::vector<VkDescriptorImageInfo> outputDescriptors(pyramid.levels);
+		std::vector<VkWriteDescriptorSet> writeDescriptorSets;
+		for (uint32_t level = 0; level < pyramid.levels; level++) {
+			if (level == 0) {
+				inputDescriptors[level] = vks::initializers::descriptorImageInfo(pyramid.sampler, pyramid.depthView, VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL);
+			} else {
+				inputDescriptors[level] = vks::initializers::descriptorImageInfo(pyramid.sampler, pyramid.levelViews[level - 1], VK_IMAGE_LAYOUT_GENERAL);
+			}
+			outputDescriptors[level] = vks::initializers::descriptorImageInfo(VK_NULL_HANDLE, pyramid.levelViews[level], VK_IMAGE_LAYOUT_GENERAL);
+			writeDescriptorSets.push_back(vks::initializers::writeDescriptorSet(pyramid.descriptorSets[level], VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 0, &inputDescriptors[level]));
+			writeDescriptorSets.push_back(vks::initializers::writeDescriptorSet(pyramid.descriptorSets[level], VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, 1, &outputDescriptors[level]));
+		}
+		VkDescriptorImageInfo pyramidDescriptor = vks::initializers::descriptorImageInfo(pyramid.sampler, pyramid.view, VK_IMAGE_LAYOUT_GENERAL);
+		writeDescriptorSets.push_back(vks::initializers::writeDescriptorSet(descriptorSet, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 4, &pyramidDescriptor));
+		vkUpdateDescriptorSets(device->logicalDevice, static_cast<uint32_t>(writeDescriptorSets.size()), writeDescriptorSets.data(), 0, nullptr);
+	}
+
+	bool OcclusionCuller::boundsInFrustum(const Draw &draw)
+	{
+		for (auto &plane : frustum.planes) {
+			// Test the corner that lies furthest along the plane normal
+			glm::vec3 corner(plane.x > 0.0f ? draw.boundsMax.x : draw.boundsMin.x, plane.y > 0.0f ? draw.boundsMax.y : draw.boundsMin.y, plane.z > 0.0f ? draw.boundsMax.z : draw.boundsMin.z);
+			if (glm::dot(glm::vec3(plane), corner) + plane.w < 0.0f) {
+				return false;
+			}
+		}
+		return true;
+	}
+
+	/** @brief Bounds reaching in front of the near plane are clipped, so their proxies may pass no samples although the draw is visible */
+	bool OcclusionCuller::boundsCrossNearPlane(const Draw &draw, const glm::mat4 &viewProjection) const
+	{
+		for (uint32_t i = 0; i < 8; i++) {
+			glm::vec4 corner((i & 1) ? draw.boundsMax.x : draw.boundsMin.x, (i & 2) ? draw.boundsMax.y : draw.boundsMin.y, (i & 4) ? draw.boundsMax.z : draw.boundsMin.z, 1.0f);
+			if ((viewProjection * corner).z < 0.0f) {
+				return true;
+			}
+		}
+		return false;
+	}
+
+	/** @brief Fetch the results of a frame slot that has finished executing, never waits for the GPU */
+	void OcclusionCuller::readResults(uint32_t frameIndex)
+	{
+		Frame &frame = frames[frameIndex];
+		if (frame.mode == ModeHiZ) {
+			const uint32_t *counters = static_cast<const uint32_t*>(frame.readback.mapped);
+			statistics.visibleCount = counters[0];
+			statistics.frustumCulled = counters[1];
+			statistics.occlusionCulled = counters[2];
+		}
+		if (frame.mode == ModeQueries) {
+			// Results are fetched without VK_QUERY_RESULT_WAIT_BIT, queries that are not available yet keep their last known state
+			const uint32_t count = drawCount();
+			VkResult result = vkGetQueryPoolResults(device->logicalDevice, queryPool, frameIndex * count, count, queryResults.size() * sizeof(uint64_t), queryResults.data(), 2 * sizeof(uint64_t), VK_QUERY_RESULT_64_BIT | VK_QUERY_RESULT_WITH_AVAILABILITY_BIT);
+			if ((result != VK_SUCCESS) && (result != VK_NOT_READY)) {
+				VK_CHECK_RESULT(result);
+			}
+			for (uint32_t i = 0; i < count; i++) {
+				if (queryResults[i * 2 + 1] != 0) {
+					visibility[i] = !frame.inFrustum[i] || (queryResults[i * 2] > 0);
+				}
+			}
+		}
+	}
+
+	/** @brief Write the draw commands of a frame slot for the CPU driven modes */
+	void OcclusionCuller::writeCommands(uint32_t frameIndex)
+	{
+		Frame &frame = frames[frameIndex];
+		VkDrawIndexedIndirectCommand *commands = static_cast<VkDrawIndexedIndirectCommand*>(frame.indirectCommands.mapped);
+		statistics.visibleCount = 0;
+		statistics.frustumCulled = 0;
+		statistics.occlusionCulled = 0;
+		for (uint32_t i = 0; i < drawCount(); i++) {
+			const Draw &draw = draws[i];
+			bool visible = true;
+			if (mode == ModeQueries) {
+				const bool inFrustum = boundsInFrustum(draw);
+				const bool crossesNearPlane = inFrustum && boundsCrossNearPlane(draw, uniformData.viewProjection);
+				frame.inFrustum[i] = inFrustum && !crossesNearPlane;
+				if (!inFrustum) {
+					visible = false;
+					statistics.frustumCulled++;
+				} else if (!visibility[i] && !crossesNearPlane) {
+					visible = false;
+					statistics.occlusionCulled++;
+				}
+			}
+			commands[i].indexCount = draw.indexCount;
+			commands[i].instanceCount = visible ? 1 : 0;
+			commands[i].firstIndex = draw.firstIndex;
+			commands[i].vertexOffset = draw.vertexOffset;
+			commands[i].firstInstance = draw.firstInstance;
+			if (visible) {
+				statistics.visibleCount++;
+			}
+		}
+	}
+
+	/**
+	* Update the culling state for the next frame, call before submitting the command buffer of that frame
+	* Results of the frame that last used the same slot are read back here, that frame is guaranteed to have finished
+	*
+	* @param frameIndex Index of the command buffer the frame is rendered with
+	* @param viewProjection Combined view and projection matrix of the frame
+	*/
+	void OcclusionCuller::update(uint32_t frameIndex, const glm::mat4 &viewProjection)
+	{
+		Frame &frame = frames[frameIndex];
+		if (frame.submitted) {
+			readResults(frameIndex);
+		}
+
+		// Draws are tested against the previous frame's depth, so their bounds are projected with the previous frame's matrices
+		uniformData.previousViewProjection = hasPreviousViewProjection ? uniformData.viewProjection : viewProjection;
+		uniformData.viewProjection = viewProjection;
+		hasPreviousViewProjection = true;
+		frustum.update(viewProjection);
+		memcpy(uniformData.frustumPlanes, frustum.planes.data(), sizeof(glm::vec4) * 6);
+		// The pyramid only contains valid depth once a frame has been rendered with it
+		uniformData.occlusionEnabled = (pyramidFrameCount > 0) ? 1 : 0;
+		uniformData.pyramidLevels = pyramid.levels;
+		memcpy(uniformBuffer.mapped, &uniformData, sizeof(UniformData));
+
+		if (mode != ModeHiZ) {
+			writeCommands(frameIndex);
+		}
+		pyramidFrameCount = (mode == ModeHiZ) ? pyramidFrameCount + 1 : 0;
+		frame.mode = mode;
+		frame.submitted = true;
+	}
+
+	/** @brief Record the commands that have to run before the render pass: the culling dispatch or the reset of the frame's query slot */
+	void OcclusionCuller::recordCulling(VkCommandBuffer commandBuffer, uint32_t frameIndex)
+	{
+		const uint32_t count = drawCount();
+		if (mode == ModeQueries) {
+			vkCmdResetQueryPool(commandBuffer, queryPool, frameIndex * count, count);
+			return;
+		}
+		if (mode != ModeHiZ) {
+			return;
+		}
+
+		vkCmdFillBuffer(commandBuffer, statisticsBuffer.buffer, 0, VK_WHOLE_SIZE, 0);
+
+		// The pyramid was written at the end of the previous frame, the indirect buffer was read by its draws
+		VkMemoryBarrier memoryBarrier = vks::initializers::memoryBarrier();
+		memoryBarrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+		memoryBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+		VkBufferMemoryBarrier bufferBarrier = vks::initializers::bufferMemoryBarrier();
+		bufferBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+		bufferBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+		bufferBarrier.buffer = statisticsBuffer.buffer;
+		bufferBarrier.size = VK_WHOLE_SIZE;
+		vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1, &memoryBarrier, 1, &bufferBarrier, 0, nullptr);
+
+		vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipelines.cull);
+		vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipelineLayout, 0, 1, &descriptorSet, 0, nullptr);
+		vkCmdDispatch(commandBuffer, (count + 63) / 64, 1, 1);
+
+		std::array<VkBufferMemoryBarrier, 2> bufferBarriers;
+		bufferBarriers[0] = vks::initializers::bufferMemoryBarrier();
+		bufferBarriers[0].srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+		bufferBarriers[0].dstAccessMask = VK_ACCESS_INDIRECT_COMMAND_READ_BIT;
+		bufferBarriers[0].buffer = indirectBuffer.buffer;
+		bufferBarriers[0].size = VK_WHOLE_SIZE;
+		bufferBarriers[1] = bufferBarriers[0];
+		bufferBarriers[1].dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+		bufferBarriers[1].buffer = statisticsBuffer.buffer;
+		vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT | VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, static_cast<uint32_t>(bufferBarriers.size()), bufferBarriers.data(), 0, nullptr);
+
+		// Statistics are copied to the frame's slot and read once the slot is used again
+		VkBufferCopy copyRegion = { 0, 0, 4 * sizeof(uint32_t) };
+		vkCmdCopyBuffer(commandBuffer, statisticsBuffer.buffer, frames[frameIndex].readback.buffer, 1, &copyRegion);
+		bufferBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+		bufferBarrier.dstAccessMask = VK_ACCESS_HOST_READ_BIT;
+		bufferBarrier.buffer = frames[frameIndex].readback.buffer;
+		vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_HOST_BIT, 0, 0, nullptr, 1, &bufferBarrier, 0, nullptr);
+	}
+
+	/** @brief Record the occlusion queries of the frame's slot, call inside the render pass after the occluders have been drawn */
+	void OcclusionCuller::recordOcclusionQueries(VkCommandBuffer commandBuffer, uint32_t frameIndex)
+	{
+		if (mode != ModeQueries) {
+			return;
+		}
+		const uint32_t count = drawCount();
+		vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelines.proxy);
+		vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 0, 1, &descriptorSet, 0, nullptr);
+		for (uint32_t i = 0; i < count; i++) {
+			vkCmdBeginQuery(commandBuffer, queryPool, frameIndex * count + i, 0);
+			vkCmdPushConstants(commandBuffer, pipelineLayout, VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(uint32_t), &i);
+			vkCmdDraw(commandBuffer, 36, 1, 0, 0);
+			vkCmdEndQuery(commandBuffer, queryPool, frameIndex * count + i);
+		}
+	}
+
+	/**
+	* Draw a range of draws with the visibility of the current mode
+	* Uses a single multi draw if multiDrawIndirect has been enabled on the device, which callers should do if it's supported
+	*/
+	void OcclusionCuller::drawIndirect(VkCommandBuffer commandBuffer, uint32_t frameIndex, uint32_t firstDraw, uint32_t count)
+	{
+		const VkBuffer buffer = (mode == ModeHiZ) ? indirectBuffer.buffer : frames[frameIndex].indirectCommands.buffer;
+		const uint32_t stride = sizeof(VkDrawIndexedIndirectCommand);
+		if (device->features.multiDrawIndirect) {
+			const uint32_t maxDrawCount = device->properties.limits.maxDrawIndirectCount;
+			for (uint32_t i = 0; i < count; i += maxDrawCount) {
+				vkCmdDrawIndexedIndirect(commandBuffer, buffer, (firstDraw + i) * stride, std::min(count - i, maxDrawCount), stride);
+			}
+		} else {
+			for (uint32_t i = 0; i < count; i++) {
+				vkCmdDrawIndexedIndirect(commandBuffer, buffer, (firstDraw + i) * stride, 1, stride);
+			}
+		}
+	}
+
+	/** @brief Build the depth pyramid from the depth buffer, call after the render pass that wrote the depth buffer */
+	void OcclusionCuller::recordDepthPyramid(VkCommandBuffer commandBuffer)
+	{
+		if (mode != ModeHiZ) {
+			return;
+		}
+
+		VkImageMemoryBarrier depthBarrier = vks::initializers::imageMemoryBarrier();
+		depthBarrier.image = pyramid.depthImage;
+		depthBarrier.srcAccessMask = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+		depthBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+		depthBarrier.oldLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+		depthBarrier.newLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL;
+		depthBarrier.subresourceRange = { pyramid.depthAspectMask, 0, 1, 0, 1 };
+		// The culling dispatch of this frame read the pyramid that's about to be overwritten
+		vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 0, nullptr, 0, nullptr, 1, &depthBarrier);
+
+		VkImageMemoryBarrier pyramidBarrier = vks::initializers::imageMemoryBarrier();
+		pyramidBarrier.image = pyramid.image;
+		pyramidBarrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+		pyramidBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+		pyramidBarrier.oldLayout = VK_IMAGE_LAYOUT_GENERAL;
+		pyramidBarrier.newLayout = VK_IMAGE_LAYOUT_GENERAL;
+		pyramidBarrier.subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, 0, pyramid.levels, 0, 1 };
+
+		vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipelines.pyramid);
+		uint32_t inputWidth = pyramid.width;
+		uint32_t inputHeight = pyramid.height;
+		for (uint32_t level = 0; level < pyramid.levels; level++) {
+			DepthPyramidPushConstants pushConstants{};
+			pushConstants.inputWidth = static_cast<int32_t>(inputWidth);
+			pushConstants.inputHeight = static_cast<int32_t>(inputHeight);
+			pushConstants.outputWidth = static_cast<int32_t>(std::max(pyramid.width >> level, 1u));
+			pushConstants.outputHeight = static_cast<int32_t>(std::max(pyramid.height >> level, 1u));
+			pushConstants.reduce = (level > 0) ? 1 : 0;
+			vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, pyramidPipelineLayout, 0, 1, &pyramid.descriptorSets[level], 0, nullptr);
+			vkCmdPushConstants(commandBuffer, pyramidPipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(DepthPyramidPushConstants), &pushConstants);
+			vkCmdDispatch(commandBuffer, (pushConstants.outputWidth + 7) / 8, (pushConstants.outputHeight + 7) / 8, 1);
+			if (level < pyramid.levels - 1) {
+				vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 0, nullptr, 0, nullptr, 1, &pyramidBarrier);
+			}
+			inputWidth = pushConstants.outputWidth;
+			inputHeight = pushConstants.outputHeight;
+		}
+
+		depthBarrier.srcAccessMask = VK_ACCESS_SHADER_READ_BIT;
+		depthBarrier.dstAccessMask = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+		depthBarrier.oldLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL;
+		depthBarrier.newLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+		vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT, 0, 0, nullptr, 0, nullptr, 1, &depthBarrier);
+	}
+
+	float OcclusionCuller::culledPercentage() const
+	{
+		if (statistics.drawCount == 0) {
+			return 0.0f;
+		}
+		return 100.0f * static_cast<float>(statistics.frustumCulled + statistics.occlusionCulled) / static_cast<float>(statistics.drawCount);
+	}
+}
@@ -0,0 +1,149 @@
+/*
+* Vulkan occlusion culler
+*
+* Culls the primitives of glTF models against the view frustum and a hierarchical depth pyramid (Hi-Z) built from
+* the previous frame's depth buffer, surviving draws are written to an indirect buffer without any CPU readback
+* Occlusion queries with a ring of per-frame query slots that are read back frames later serve as a fallback
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include "vulkan/vulkan.h"
+#include "VulkanDevice.h"
+#include "VulkanBuffer.h"
+#include "VulkanTools.h"
+#include "VulkanglTFModel.h"
+#include "frustum.hpp"
+
+namespace vks
+{
+	class OcclusionCuller
+	{
+	public:
+		enum Mode { ModeHiZ = 0, ModeQueries = 1, ModeDisabled = 2 };
+
+		/** @brief World space bounds and draw parameters of a single primitive, matches the std430 layout used by the shaders */
+		struct Draw
+		{
+			glm::vec4 boundsMin;
+			glm::vec4 boundsMax;
+			uint32_t indexCount;
+			uint32_t firstIndex;
+			int32_t vertexOffset;
+			uint32_t firstInstance;
+		};
+
+		/** @brief Results of the last frame that has been read back */
+		struct Statistics
+		{
+			uint32_t drawCount = 0;
+			uint32_t visibleCount = 0;
+			uint32_t frustumCulled = 0;
+			uint32_t occlusionCulled = 0;
+		} statistics;
+
+		Mode mode = ModeHiZ;
+
+		static const uint32_t maxPyramidLevels = 16;
+
+	private:
+		struct UniformData
+		{
+			glm::mat4 viewProjection;
+			glm::mat4 previousViewProjection;
+			glm::vec4 frustumPlanes[6];
+			uint32_t drawCount;
+			uint32_t occlusionEnabled;
+			uint32_t pyramidLevels;
+			uint32_t pad;
+		} uniformData;
+
+		// Culling results of one frame in flight, frames are indexed by the command buffer they are recorded to
+		struct Frame
+		{
+			bool submitted = false;
+			Mode mode = ModeHiZ;
+			// Copy of the GPU culling statistics
+			vks::Buffer readback;
+			// Draw commands written by the CPU for the query and disabled modes
+			vks::Buffer indirectCommands;
+			// Draws that were inside the frustum when the frame was submitted, only their query results are meaningful
+			std::vector<bool> inFrustum;
+		};
+
+		vks::VulkanDevice *device = nullptr;
+		VkQueue queue = VK_NULL_HANDLE;
+		std::vector<Draw> draws;
+		std::vector<Frame> frames;
+		// Last known query result for every draw
+		std::vector<bool> visibility;
+		std::vector<uint64_t> queryResults;
+		vks::Frustum frustum;
+		bool hasPreviousViewProjection = false;
+		bool pyramidSupported = false;
+		uint32_t pyramidFrameCount = 0;
+
+		vks::Buffer drawBuffer;
+		vks::Buffer indirectBuffer;
+		vks::Buffer statisticsBuffer;
+		vks::Buffer uniformBuffer;
+		VkQueryPool queryPool = VK_NULL_HANDLE;
+
+		struct DepthPyramid
+		{
+			VkImage image = VK_NULL_HANDLE;
+			VkDeviceMemory memory = VK_NULL_HANDLE;
+			VkImageView view = VK_NULL_HANDLE;
+			std::vector<VkImageView> levelViews;
+			VkImage depthImage = VK_NULL_HANDLE;
+			VkImageView depthView = VK_NULL_HANDLE;
+			VkImageAspectFlags depthAspectMask = 0;
+			VkSampler sampler = VK_NULL_HANDLE;
+			uint32_t width = 0;
+			uint32_t height = 0;
+			uint32_t levels = 0;
+			std::vector<VkDescriptorSet> descriptorSets;
+		} pyramid;
+
+		VkDescriptorPool descriptorPool = VK_NULL_HANDLE;
+		VkDescriptorSetLayout descriptorSetLayout = VK_NULL_HANDLE;
+		VkDescriptorSetLayout pyramidDescriptorSetLayout = VK_NULL_HANDLE;
+		VkDescriptorSet descriptorSet = VK_NULL_HANDLE;
+		VkPipelineLayout pipelineLayout = VK_NULL_HANDLE;
+		VkPipelineLayout pyramidPipelineLayout = VK_NULL_HANDLE;
+		struct {
+			VkPipeline cull = VK_NULL_HANDLE;
+			VkPipeline pyramid = VK_NULL_HANDLE;
+			VkPipeline proxy = VK_NULL_HANDLE;
+		} pipelines;
+
+		void destroyPyramid();
+		bool boundsCrossNearPlane(const Draw &draw, const glm::mat4 &viewProjection) const;
+		bool boundsInFrustum(const Draw &draw);
+		void readResults(uint32_t frameIndex);
+		void writeCommands(uint32_t frameIndex);
+	public:
+		void prepare(vks::VulkanDevice *device, VkQueue queue, VkRenderPass renderPass, VkPipelineCache pipelineCache, const std::string &shaderPath, uint32_t frameCount);
+		void destroy();
+
+		uint32_t addModel(const vkglTF::Model &model, const glm::mat4 &transform, uint32_t instanceIndex, bool flipY = false);
+		void finalize();
+		uint32_t drawCount() const;
+		bool supported(Mode mode) const;
+
+		void resize(VkImage depthImage, VkFormat depthFormat, uint32_t width, uint32_t height);
+		void update(uint32_t frameIndex, const glm::mat4 &viewProjection);
+
+		void recordCulling(VkCommandBuffer commandBuffer, uint32_t frameIndex);
+		void recordOcclusionQueries(VkCommandBuffer commandBuffer, uint32_t frameIndex);
+		void drawIndirect(VkCommandBuffer commandBuffer, uint32_t frameIndex, uint32_t firstDraw, uint32_t count);
+		void recordDepthPyramid(VkCommandBuffer commandBuffer);
+
+		float culledPercentage() const;
+	};
+}
@@ -0,0 +1,1167 @@
+/*
+* Vulkan render graph
+*
+* Passes declare the images and buffers they read and write, the graph derives everything else from that:
+* passes that don't contribute to an output are culled, consecutive graphics passes that only read each other's
+* results at the same pixel are merged into subpasses of one render pass, layout transitions and barriers are derived
+* from the declared accesses (as subpass dependencies inside and around render passes and as pipeline barriers for
+* everything else) and images that are only alive for a part of the frame share memory with other images whose
+* lifetimes don't overlap. Passes execute in the order they are declared
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#include "VulkanRenderGraph.h"
+
+#include <algorithm>
+
+namespace vks
+{
+	namespace
+	{
+		const VkAccessFlags writeAccessFlags = VK_ACCESS_SHADER_WRITE_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT | VK_ACCESS_TRANSFER_WRITE_BIT | VK_ACCESS_HOST_WRITE_BIT | VK_ACCESS_MEMORY_WRITE_BIT;
+
+		bool isDepthFormat(VkFormat format)
+		{
+			switch (format) {
+			case VK_FORMAT_D16_UNORM:
+			case VK_FORMAT_X8_D24_UNORM_PACK32:
+			case VK_FORMAT_D32_SFLOAT:
+			case VK_FORMAT_S8_UINT:
+			case VK_FORMAT_D16_UNORM_S8_UINT:
+			case VK_FORMAT_D24_UNORM_S8_UINT:
+			case VK_FORMAT_D32_SFLOAT_S8_UINT:
+				return true;
+			default:
+				return false;
+			}
+		}
+
+		VkDeviceSize alignUp(VkDeviceSize value, VkDeviceSize alignment)
+		{
+			return (value + alignment - 1) / alignment * alignment;
+		}
+
+		bool extentsEqual(const VkExtent2D &a, const VkExtent2D &b)
+		{
+			return (a.width == b.width) && (a.height == b.height);
+		}
+
+		// Accumulates the dependencies between two subpasses (or a subpass and VK_SUBPASS_EXTERNAL) into a single entry
+		void addSubpassDependency(std::vector<VkSubpassDependency> &dependencies, uint32_t srcSubpass, uint32_t dstSubpass, VkPipelineStageFlags srcStageMask, VkAccessFlags srcAccessMask, VkPipelineStageFlags dstStageMask, VkAccessFlags dstAccessMask)
+		{
+			for (auto &dependency : dependencies) {
+				if ((dependency.srcSubpass == srcSubpass) && (dependency.dstSubpass == dstSubpass)) {
+					dependency.srcStageMask |= srcStageMask;
+					dependency.srcAccessMask |= srcAccessMask;
+					dependency.dstStageMask |= dstStageMask;
+					dependency.dstAccessMask |= dstAccessMask;
+					return;
+				}
+			}
+			VkSubpassDependency dependency{};
+			dependency.srcSubpass = srcSubpass;
+			dependency.dstSubpass = dstSubpass;
+			dependency.srcStageMask = srcStageMask;
+			dependency.srcAccessMask = srcAccessMask;
+			dependency.dstStageMask = dstStageMask;
+			dependency.dstAccessMask = dstAccessMask;
+			// Merged passes only read each other's results at the same pixel
+			dependency.dependencyFlags = (srcSubpass != VK_SUBPASS_EXTERNAL) ? VK_DEPENDENCY_BY_REGION_BIT : 0;
+			dependencies.push_back(dependency);
+		}
+	}
+
+	RenderGraph::Pass &RenderGraph::Pass::addAccess(const std::string &name, AccessType type, VkPipelineStageFlags stageMask, VkAccessFlags accessMask, VkImageLayout layout)
+	{
+		Access access;
+		access.name = name;
+		access.type = type;
+		access.stageMask = stageMask;
+		access.accessMask = accessMask;
+		access.layout = layout;
+		access.resource = ~0u;
+		accesses.push_back(access);
+		return *this;
+	}
+
+	RenderGraph::Pass &RenderGraph::Pass::addColorOutput(const std::string &name)
+	{
+		return addAccess(name, AccessColorOutput, VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, VK_ACCESS_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL);
+	}
+
+	RenderGraph::Pass &RenderGraph::Pass::setDepthStencilOutput(const std::string &name)
+	{
+		return addAccess(name, AccessDepthOutput, VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT, VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT, VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL);
+	}
+
+	RenderGraph::Pass &RenderGraph::Pass::setDepthStencilInput(const std::string &name)
+	{
+		return addAccess(name, AccessDepthInput, VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT, VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT, VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL);
+	}
+
+	RenderGraph::Pass &RenderGraph::Pass::addAttachmentInput(const std::string &name)
+	{
+		return addAccess(name, AccessAttachmentInput, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, VK_ACCESS_INPUT_ATTACHMENT_READ_BIT, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+	}
+
+	RenderGraph::Pass &RenderGraph::Pass::addTextureInput(const std::string &name, VkPipelineStageFlags stageMask)
+	{
+		return addAccess(name, AccessTexture, stageMask, VK_ACCESS_SHADER_READ_BIT, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+	}
+
+	RenderGraph::Pass &RenderGraph::Pass::addStorageInput(const std::string &name, VkPipelineStageFlags stageMask)
+	{
+		return addAccess(name, AccessStorageInput, stageMask, VK_ACCESS_SHADER_READ_BIT, VK_IMAGE_LAYOUT_GENERAL);
+	}
+
+	RenderGraph::Pass &RenderGraph::Pass::addStorageOutput(const std::string &name, VkPipelineStageFlags stageMask)
+	{
+		return addAccess(name, AccessStorageOutput, stageMask, VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT, VK_IMAGE_LAYOUT_GENERAL);
+	}
+
+	RenderGraph::Pass &RenderGraph::Pass::addBufferInput(const std::string &name, VkPipelineStageFlags stageMask, VkAccessFlags accessMask)
+	{
+		return addAccess(name, AccessBufferInput, stageMask, accessMask, VK_IMAGE_LAYOUT_UNDEFINED);
+	}
+
+	RenderGraph::Pass &RenderGraph::Pass::setRecordFunction(RecordFunction function)
+	{
+		record = function;
+		return *this;
+	}
+
+	bool RenderGraph::isWrite(const Pass::Access &access)
+	{
+		return (access.accessMask & writeAccessFlags) != 0;
+	}
+
+	bool RenderGraph::isAttachment(const Pass::Access &access)
+	{
+		return (access.type == Pass::AccessColorOutput) || (access.type == Pass::AccessDepthOutput) || (access.type == Pass::AccessDepthInput) || (access.type == Pass::AccessAttachmentInput);
+	}
+
+	void RenderGraph::prepare(vks::VulkanDevice *device)
+	{
+		this->device = device;
+		timestampsSupported = device->queueFamilyProperties[device->queueFamilyIndices.graphics].timestampValidBits > 0;
+	}
+
+	void RenderGraph::reset()
+	{
+		destroyCompiled();
+		resources.clear();
+		passes.clear();
+		outputs.clear();
+	}
+
+	void RenderGraph::destroy()
+	{
+		reset();
+	}
+
+	void RenderGraph::destroyCompiled()
+	{
+		if (device) {
+			for (auto &physicalPass : physicalPasses) {
+				for (auto framebuffer : physicalPass.framebuffers) {
+					vkDestroyFramebuffer(device->logicalDevice, framebuffer, nullptr);
+				}
+				if (physicalPass.renderPass != VK_NULL_HANDLE) {
+					vkDestroyRenderPass(device->logicalDevice, physicalPass.renderPass, nullptr);
+				}
+			}
+			for (auto &resource : resources) {
+				if (resource.view != VK_NULL_HANDLE) {
+					vkDestroyImageView(device->logicalDevice, resource.view, nullptr);
+				}
+				if (resource.image != VK_NULL_HANDLE) {
+					vkDestroyImage(device->logicalDevice, resource.image, nullptr);
+				}
+				if (resource.dedicatedMemory != VK_NULL_HANDLE) {
+					vkFreeMemory(device->logicalDevice, resource.dedicatedMemory, nullptr);
+				}
+				resource.view = VK_NULL_HANDLE;
+				resource.image = VK_NULL_HANDLE;
+				resource.dedicatedMemory = VK_NULL_HANDLE;
+			}
+			for (auto &block : memoryBlocks) {
+				vkFreeMemory(device->logicalDevice, block.memory, nullptr);
+			}
+			if (queryPool != VK_NULL_HANDLE) {
+				vkDestroyQueryPool(device->logicalDevice, queryPool, nullptr);
+				queryPool = VK_NULL_HANDLE;
+			}
+		}
+		physicalPasses.clear();
+		memoryBlocks.clear();
+		finalBarriers = BarrierBatch();
+		statistics = Statistics();
+		compiled = false;
+	}
+
+	uint32_t RenderGraph::findResource(const std::string &name) const
+	{
+		for (uint32_t i = 0; i < static_cast<uint32_t>(resources.size()); i++) {
+			if (resources[i].name == name) {
+				return i;
+			}
+		}
+		return ~0u;
+	}
+
+	const RenderGraph::Pass &RenderGraph::findPass(const std::string &name) const
+	{
+		for (auto &pass : passes) {
+			if (pass.name == name) {
+				return pass;
+			}
+		}
+		vks::tools::exitFatal("Render graph has no pass named \"" + name + "\"", -1);
+		return passes.front();
+	}
+
+	uint32_t RenderGraph::addResource(const std::string &name)
+	{
+		if (findResource(name) != ~0u) {
+			vks::tools::exitFatal("Render graph resource \"" + name + "\" has been declared twice", -1);
+		}
+		Resource resource;
+		resource.name = name;
+		resources.push_back(resource);
+		return static_cast<uint32_t>(resources.size() - 1);
+	}
+
+	void RenderGraph::addImage(const std::string &name, const ImageInfo &info)
+	{
+		resources[addResource(name)].info = info;
+	}
+
+	void RenderGraph::importImage(const std::string &name, VkFormat format, VkExtent2D extent, const std::vector<VkImage> &images, const std::vector<VkImageView> &views, VkImageLayout finalLayout, VkClearValue clearValue, VkPipelineStageFlags importStageMask)
+	{
+		assert(!images.empty() && (images.size() == views.size()));
+		Resource &resource = resources[addResource(name)];
+		resource.imported = true;
+		resource.info.format = format;
+		resource.info.sizeMode = SizeAbsolute;
+		resource.info.width = static_cast<float>(extent.width);
+		resource.info.height = static_cast<float>(extent.height);
+		resource.info.clearValue = clearValue;
+		resource.importedImages = images;
+		resource.importedViews = views;
+		resource.finalLayout = finalLayout;
+		resource.importStageMask = importStageMask;
+	}
+
+	void RenderGraph::importBuffer(const std::string &name, VkBuffer buffer)
+	{
+		Resource &resource = resources[addResource(name)];
+		resource.buffer = true;
+		resource.imported = true;
+		resource.importedBuffer = buffer;
+	}
+
+	void RenderGraph::addOutput(const std::string &name)
+	{
+		outputs.push_back(name);
+	}
+
+	RenderGraph::Pass &RenderGraph::addGraphicsPass(const std::string &name)
+	{
+		passes.push_back(Pass());
+		passes.back().name = name;
+		return passes.back();
+	}
+
+	RenderGraph::Pass &RenderGraph::addComputePass(const std::string &name)
+	{
+		passes.push_back(Pass());
+		passes.back().name = name;
+		passes.back().compute = true;
+		return passes.back();
+	}
+
+	void RenderGraph::resolveAccesses(VkExtent2D referenceExtent)
+	{
+		for (auto &resource : resources) {
+			resource.usage = 0;
+			resource.firstUse = ~0u;
+			resource.lastUse = 0;
+			resource.transient = false;
+			resource.block = -1;
+			resource.offset = 0;
+			resource.aliases.clear();
+			if (resource.buffer) {
+				continue;
+			}
+			if (resource.info.sizeMode == SizeSwapchainRelative) {
+				resource.extent.width = std::max(static_cast<uint32_t>(resource.info.width * static_cast<float>(referenceExtent.width)), 1u);
+				resource.extent.height = std::max(static_cast<uint32_t>(resource.info.height * static_cast<float>(referenceExtent.height)), 1u);
+			}
+			else {
+				resource.extent.width = static_cast<uint32_t>(resource.info.width);
+				resource.extent.height = static_cast<uint32_t>(resource.info.height);
+			}
+			resource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+			if (isDepthFormat(resource.info.format)) {
+				resource.aspectMask = (resource.info.format == VK_FORMAT_S8_UINT) ? 0 : VK_IMAGE_ASPECT_DEPTH_BIT;
+				if (vks::tools::formatHasStencil(resource.info.format)) {
+					resource.aspectMask |= VK_IMAGE_ASPECT_STENCIL_BIT;
+				}
+			}
+		}
+
+		for (auto &pass : passes) {
+			pass.culled = false;
+			for (size_t i = 0; i < pass.accesses.size(); i++) {
+				Pass::Access &access = pass.accesses[i];
+				access.resource = findResource(access.name);
+				if (access.resource == ~0u) {
+					vks::tools::exitFatal("Render graph pass \"" + pass.name + "\" accesses the undeclared resource \"" + access.name + "\"", -1);
+				}
+				for (size_t j = 0; j < i; j++) {
+					if (pass.accesses[j].resource == access.resource) {
+						vks::tools::exitFatal("Render graph pass \"" + pass.name + "\" accesses \"" + access.name + "\" more than once", -1);
+					}
+				}
+				const Resource &resource = resources[access.resource];
+				const bool bufferAccess = (access.type == Pass::AccessStorageInput) || (access.type == Pass::AccessStorageOutput) || (access.type == Pass::AccessBufferInput);
+				if ((resource.buffer && !bufferAccess) || (!resource.buffer && (access.type == Pass::AccessBufferInput))) {
+					vks::tools::exitFatal("Render graph pass \"" + pass.name + "\" accesses \"" + access.name + "\" in a way its resource type doesn't support", -1);
+				}
+				if (pass.compute && isAttachment(access)) {
+					vks::tools::exitFatal("Render graph compute pass \"" + pass.name + "\" can't use \"" + access.name + "\" as an attachment", -1);
+				}
+			}
+		}
+
+		for (auto &output : outputs) {
+			if (findResource(output) == ~0u) {
+				vks::tools::exitFatal("Render graph output \"" + output + "\" has not been declared", -1);
+			}
+		}
+	}
+
+	void RenderGraph::cullPasses()
+	{
+		// Walk backwards from the outputs, a pass is needed if it writes something a later needed pass accesses
+		// Writes load earlier contents, so a needed pass also keeps the earlier writers of its outputs alive
+		std::vector<bool> needed(resources.size(), false);
+		for (auto &output : outputs) {
+			needed[findResource(output)] = true;
+		}
+		for (auto pass = passes.rbegin(); pass != passes.rend(); ++pass) {
+			bool live = false;
+			for (auto &access : pass->accesses) {
+				live |= isWrite(access) && needed[access.resource];
+			}
+			pass->culled = !live;
+			if (live) {
+				for (auto &access : pass->accesses) {
+					needed[access.resource] = true;
+				}
+			}
+			else {
+				statistics.culledPasses++;
+			}
+		}
+		statistics.passes = static_cast<uint32_t>(passes.size());
+	}
+
+	VkExtent2D RenderGraph::passExtent(const Pass &pass) const
+	{
+		VkExtent2D extent = {};
+		for (auto &access : pass.accesses) {
+			if (!isAttachment(access)) {
+				continue;
+			}
+			const VkExtent2D &attachmentExtent = resources[access.resource].extent;
+			if ((extent.width != 0) && !extentsEqual(extent, attachmentExtent)) {
+				vks::tools::exitFatal("Render graph pass \"" + pass.name + "\" has attachments of different sizes", -1);
+			}
+			extent = attachmentExtent;
+		}
+		if (extent.width == 0) {
+			vks::tools::exitFatal("Render graph graphics pass \"" + pass.name + "\" has no attachments", -1);
+		}
+		return extent;
+	}
+
+	bool RenderGraph::canMerge(const PhysicalPass &physicalPass, const Pass &pass) const
+	{
+		if (physicalPass.compute || !extentsEqual(physicalPass.extent, passExtent(pass))) {
+			return false;
+		}
+		// Inside a render pass every image is either only used as an attachment or not at all, so results of
+		// earlier subpasses can only be read at the same pixel and sampled images can't be written
+		for (auto &access : pass.accesses) {
+			for (auto index : physicalPass.passes) {
+				for (auto &other : passes[index].accesses) {
+					if ((other.resource == access.resource) && (!isAttachment(other) || !isAttachment(access))) {
+						return false;
+					}
+				}
+			}
+		}
+		return true;
+	}
+
+	void RenderGraph::buildPhysicalPasses()
+	{
+		for (uint32_t i = 0; i < static_cast<uint32_t>(passes.size()); i++) {
+			Pass &pass = passes[i];
+			if (pass.culled) {
+				continue;
+			}
+			if (pass.compute || physicalPasses.empty() || !canMerge(physicalPasses.back(), pass)) {
+				PhysicalPass physicalPass;
+				physicalPass.compute = pass.compute;
+				if (!pass.compute) {
+					physicalPass.extent = passExtent(pass);
+				}
+				physicalPasses.push_back(physicalPass);
+				if (pass.compute) {
+					statistics.computePasses++;
+				}
+				else {
+					statistics.renderPasses++;
+				}
+			}
+			else {
+				statistics.mergedPasses++;
+			}
+			PhysicalPass &physicalPass = physicalPasses.back();
+			pass.physicalPass = static_cast<uint32_t>(physicalPasses.size() - 1);
+			pass.subpass = static_cast<uint32_t>(physicalPass.passes.size());
+			physicalPass.passes.push_back(i);
+			for (auto &access : pass.accesses) {
+				Resource &resource = resources[access.resource];
+				resource.firstUse = std::min(resource.firstUse, pass.physicalPass);
+				resource.lastUse = std::max(resource.lastUse, pass.physicalPass);
+				if (isAttachment(access) && (std::find(physicalPass.attachments.begin(), physicalPass.attachments.end(), access.resource) == physicalPass.attachments.end())) {
+					physicalPass.attachments.push_back(access.resource);
+					physicalPass.clearValues.push_back(resource.info.clearValue);
+				}
+			}
+		}
+	}
+
+	void RenderGraph::createImages()
+	{
+		for (uint32_t i = 0; i < static_cast<uint32_t>(resources.size()); i++) {
+			Resource &resource = resources[i];
+			if (resource.buffer || resource.imported || (resource.firstUse == ~0u)) {
+				continue;
+			}
+			bool attachmentsOnly = true;
+			for (auto &pass : passes) {
+				if (pass.culled) {
+					continue;
+				}
+				for (auto &access : pass.accesses) {
+					if (access.resource != i) {
+						continue;
+					}
+					attachmentsOnly &= isAttachment(access);
+					switch (access.type) {
+					case Pass::AccessColorOutput:
+						resource.usage |= VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT;
+						break;
+					case Pass::AccessDepthOutput:
+					case Pass::AccessDepthInput:
+						resource.usage |= VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT;
+						break;
+					case Pass::AccessAttachmentInput:
+						resource.usage |= VK_IMAGE_USAGE_INPUT_ATTACHMENT_BIT;
+						break;
+					case Pass::AccessTexture:
+						resource.usage |= VK_IMAGE_USAGE_SAMPLED_BIT;
+						break;
+					case Pass::AccessStorageInput:
+					case Pass::AccessStorageOutput:
+						resource.usage |= VK_IMAGE_USAGE_STORAGE_BIT;
+						break;
+					default:
+						break;
+					}
+				}
+			}
+			// Contents that never leave a render pass don't have to be stored and may live in tile memory only
+			resource.transient = attachmentsOnly && (resource.firstUse == resource.lastUse);
+			if (resource.transient) {
+				resource.usage |= VK_IMAGE_USAGE_TRANSIENT_ATTACHMENT_BIT;
+				statistics.transientImages++;
+			}
+
+			VkImageCreateInfo imageCI = vks::initializers::imageCreateInfo();
+			imageCI.imageType = VK_IMAGE_TYPE_2D;
+			imageCI.format = resource.info.format;
+			imageCI.extent = { resource.extent.width, resource.extent.height, 1 };
+			imageCI.mipLevels = 1;
+			imageCI.arrayLayers = 1;
+			imageCI.samples = VK_SAMPLE_COUNT_1_BIT;
+			imageCI.tiling = VK_IMAGE_TILING_OPTIMAL;
+			imageCI.usage = resource.usage;
+			imageCI.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+			VK_CHECK_RESULT(vkCreateImage(device->logicalDevice, &imageCI, nullptr, &resource.image));
+			vkGetImageMemoryRequirements(device->logicalDevice, resource.image, &resource.memoryRequirements);
+			statistics.images++;
+			statistics.requiredMemory += resource.memoryRequirements.size;
+		}
+	}
+
+	void RenderGraph::allocateMemory()
+	{
+		std::vector<uint32_t> candidates;
+		for (uint32_t i = 0; i < static_cast<uint32_t>(resources.size()); i++) {
+			Resource &resource = resources[i];
+			if (resource.image == VK_NULL_HANDLE) {
+				continue;
+			}
+			if (resource.transient) {
+				// Lazily allocated memory is only backed if the implementation needs it, sharing it gains nothing
+				VkBool32 lazyMemoryFound = VK_FALSE;
+				uint32_t memoryTypeIndex = device->getMemoryType(resource.memoryRequirements.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT | VK_MEMORY_PROPERTY_LAZILY_ALLOCATED_BIT, &lazyMemoryFound);
+				if (lazyMemoryFound) {
+					VkMemoryAllocateInfo memAlloc = vks::initializers::memoryAllocateInfo();
+					memAlloc.allocationSize = resource.memoryRequirements.size;
+					memAlloc.memoryTypeIndex = memoryTypeIndex;
+					VK_CHECK_RESULT(vkAllocateMemory(device->logicalDevice, &memAlloc, nullptr, &resource.dedicatedMemory));
+					VK_CHECK_RESULT(vkBindImageMemory(device->logicalDevice, resource.image, resource.dedicatedMemory, 0));
+					statistics.allocatedMemory += memAlloc.allocationSize;
+					statistics.lazilyAllocatedMemory += memAlloc.allocationSize;
+					continue;
+				}
+			}
+			candidates.push_back(i);
+		}
+
+		// Largest images first, each one goes to the lowest offset of the first block where it doesn't overlap
+		// the memory of an image that is alive at the same time
+		std::stable_sort(candidates.begin(), candidates.end(), [this](uint32_t a, uint32_t b) { return resources[a].memoryRequirements.size > resources[b].memoryRequirements.size; });
+		for (auto index : candidates) {
+			Resource &resource = resources[index];
+			const VkMemoryRequirements &requirements = resource.memoryRequirements;
+			for (uint32_t b = 0; aliasing && (b < static_cast<uint32_t>(memoryBlocks.size())) && (resource.block < 0); b++) {
+				MemoryBlock &block = memoryBlocks[b];
+				if ((requirements.memoryTypeBits & (1u << block.memoryTypeIndex)) == 0) {
+					continue;
+				}
+				VkDeviceSize offset = 0;
+				bool moved = true;
+				while (moved && (offset + requirements.size <= block.size)) {
+					moved = false;
+					for (auto other : block.resources) {
+						const Resource &placed = resources[other];
+						const bool lifetimesOverlap = (placed.firstUse <= resource.lastUse) && (resource.firstUse <= placed.lastUse);
+						const bool rangesOverlap = (placed.offset < offset + requirements.size) && (offset < placed.offset + placed.memoryRequirements.size);
+						if (lifetimesOverlap && rangesOverlap) {
+							offset = alignUp(placed.offset + placed.memoryRequirements.size, requirements.alignment);
+							moved = true;
+						}
+					}
+				}
+				if (offset + requirements.size <= block.size) {
+					resource.block = static_cast<int32_t>(b);
+					resource.offset = offset;
+					block.resources.push_back(index);
+				}
+			}
+			if (resource.block < 0) {
+				MemoryBlock block;
+				block.size = requirements.size;
+				block.memoryTypeIndex = device->getMemoryType(requirements.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+				block.resources.push_back(index);
+				resource.block = static_cast<int32_t>(memoryBlocks.size());
+				resource.offset = 0;
+				memoryBlocks.push_back(block);
+			}
+		}
+
+		for (auto &block : memoryBlocks) {
+			VkMemoryAllocateInfo memAlloc = vks::initializers::memoryAllocateInfo();
+			memAlloc.allocationSize = block.size;
+			memAlloc.memoryTypeIndex = block.memoryTypeIndex;
+			VK_CHECK_RESULT(vkAllocateMemory(device->logicalDevice, &memAlloc, nullptr, &block.memory));
+			statistics.allocatedMemory += block.size;
+			for (auto index : block.resources) {
+				Resource &resource = resources[index];
+				VK_CHECK_RESULT(vkBindImageMemory(device->logicalDevice, resource.image, block.memory, resource.offset));
+				for (auto other : block.resources) {
+					const Resource &placed = resources[other];
+					if ((other != index) && (placed.offset < resource.offset + resource.memoryRequirements.size) && (resource.offset < placed.offset + placed.memoryRequirements.size)) {
+						resource.aliases.push_back(other);
+					}
+				}
+				if (!resource.aliases.empty()) {
+					statistics.aliasedImages++;
+				}
+			}
+		}
+
+		for (auto &resource : resources) {
+			if (resource.image == VK_NULL_HANDLE) {
+				continue;
+			}
+			VkImageViewCreateInfo viewCI = vks::initializers::imageViewCreateInfo();
+			viewCI.viewType = VK_IMAGE_VIEW_TYPE_2D;
+			viewCI.format = resource.info.format;
+			viewCI.subresourceRange = { resource.aspectMask, 0, 1, 0, 1 };
+			viewCI.image = resource.image;
+			VK_CHECK_RESULT(vkCreateImageView(device->logicalDevice, &viewCI, nullptr, &resource.view));
+		}
+	}
+
+	bool RenderGraph::dependency(const ResourceState &state, const Pass::Access &access, bool image, VkPipelineStageFlags &srcStageMask, VkAccessFlags &srcAccessMask)
+	{
+		const bool transition = image && (state.layout != access.layout);
+		if (isWrite(access) || transition) {
+			// Writes and layout transitions have to wait for all earlier accesses
+			srcStageMask = state.writeStageMask | state.readStageMask;
+			srcAccessMask = state.writeAccessMask;
+			return transition || (srcStageMask != 0);
+		}
+		// Reads only wait for the last write, unless it has already been made visible to them
+		const bool visible = ((state.visibleStageMask & access.stageMask) == access.stageMask) && ((state.visibleAccessMask & access.accessMask) == access.accessMask);
+		if ((state.writeAccessMask != 0) && !visible) {
+			srcStageMask = state.writeStageMask;
+			srcAccessMask = state.writeAccessMask;
+			return true;
+		}
+		return false;
+	}
+
+	void RenderGraph::updateState(ResourceState &state, const Pass::Access &access, bool synchronized)
+	{
+		if (isWrite(access)) {
+			state.writeStageMask = access.stageMask;
+			state.writeAccessMask = access.accessMask & writeAccessFlags;
+			state.readStageMask = 0;
+			state.visibleStageMask = 0;
+			state.visibleAccessMask = 0;
+		}
+		else {
+			if (synchronized) {
+				if (state.layout != access.layout) {
+					// Later readers have to wait for the transition, which finished before this stage
+					state.writeStageMask = access.stageMask;
+					state.visibleStageMask = 0;
+					state.visibleAccessMask = 0;
+				}
+				state.visibleStageMask |= access.stageMask;
+				state.visibleAccessMask |= access.accessMask;
+			}
+			state.readStageMask |= access.stageMask;
+		}
+		if (access.layout != VK_IMAGE_LAYOUT_UNDEFINED) {
+			state.layout = access.layout;
+		}
+	}
+
+	void RenderGraph::addBarrier(BarrierBatch &batch, ResourceState &state, const Pass::Access &access)
+	{
+		const Resource &resource = resources[access.resource];
+		VkPipelineStageFlags srcStageMask = 0;
+		VkAccessFlags srcAccessMask = 0;
+		const bool needed = dependency(state, access, !resource.buffer, srcStageMask, srcAccessMask);
+		if (needed) {
+			Barrier barrier;
+			barrier.resource = access.resource;
+			barrier.oldLayout = state.layout;
+			barrier.newLayout = resource.buffer ? VK_IMAGE_LAYOUT_UNDEFINED : access.layout;
+			barrier.srcAccessMask = srcAccessMask;
+			barrier.dstAccessMask = access.accessMask;
+			batch.barriers.push_back(barrier);
+			batch.srcStageMask |= (srcStageMask != 0) ? srcStageMask : static_cast<VkPipelineStageFlags>(VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT);
+			batch.dstStageMask |= access.stageMask;
+		}
+		updateState(state, access, needed);
+	}
+
+	void RenderGraph::deriveBarriers()
+	{
+		// The first access of a frame has to wait for the last accesses of the previous frame to the same memory
+		struct LastAccess
+		{
+			VkPipelineStageFlags stageMask = 0;
+			VkAccessFlags writeAccessMask = 0;
+		};
+		std::vector<LastAccess> lastAccesses(resources.size());
+		for (auto &physicalPass : physicalPasses) {
+			for (auto index : physicalPass.passes) {
+				for (auto &access : passes[index].accesses) {
+					lastAccesses[access.resource].stageMask = access.stageMask;
+					lastAccesses[access.resource].writeAccessMask = access.accessMask & writeAccessFlags;
+				}
+			}
+		}
+		std::vector<ResourceState> states(resources.size());
+		std::vector<bool> hasContents(resources.size(), false);
+		for (uint32_t i = 0; i < static_cast<uint32_t>(resources.size()); i++) {
+			ResourceState &state = states[i];
+			state.writeStageMask = lastAccesses[i].stageMask | resources[i].importStageMask;
+			state.writeAccessMask = lastAccesses[i].writeAccessMask;
+			for (auto alias : resources[i].aliases) {
+				state.writeStageMask |= lastAccesses[alias].stageMask;
+				state.writeAccessMask |= lastAccesses[alias].writeAccessMask;
+			}
+			// Buffers keep their contents between frames, a buffer that is never written by the graph is only read
+			if (resources[i].buffer && (state.writeAccessMask == 0)) {
+				state.writeStageMask = 0;
+			}
+			// Imported images are handed back in their final layout, which they are expected to be in at the start of the next frame
+			// Keeping that layout instead of discarding it preserves their contents for passes reading them (e.g. history images)
+			if (resources[i].imported && !resources[i].buffer) {
+				state.layout = resources[i].finalLayout;
+			}
+		}
+
+		for (uint32_t p = 0; p < static_cast<uint32_t>(physicalPasses.size()); p++) {
+			PhysicalPass &physicalPass = physicalPasses[p];
+
+			// Everything that isn't an attachment is synchronized with pipeline barriers in front of the pass
+			for (auto index : physicalPass.passes) {
+				for (auto &access : passes[index].accesses) {
+					if (!isAttachment(access)) {
+						addBarrier(physicalPass.barriers, states[access.resource], access);
+						hasContents[access.resource] = hasContents[access.resource] || isWrite(access);
+					}
+				}
+			}
+			if (physicalPass.compute) {
+				continue;
+			}
+
+			// Attachments are synchronized by the render pass, with external dependencies for earlier accesses and
+			// subpass dependencies between the merged passes
+			for (uint32_t a = 0; a < static_cast<uint32_t>(physicalPass.attachments.size()); a++) {
+				const uint32_t resourceIndex = physicalPass.attachments[a];
+				const Resource &resource = resources[resourceIndex];
+				ResourceState &state = states[resourceIndex];
+
+				std::vector<std::pair<uint32_t, const Pass::Access*>> uses;
+				for (uint32_t s = 0; s < static_cast<uint32_t>(physicalPass.passes.size()); s++) {
+					for (auto &access : passes[physicalPass.passes[s]].accesses) {
+						if (access.resource == resourceIndex) {
+							uses.push_back(std::make_pair(s, &access));
+						}
+					}
+				}
+
+				const bool load = hasContents[resourceIndex];
+				VkAttachmentDescription description{};
+				description.format = resource.info.format;
+				description.samples = VK_SAMPLE_COUNT_1_BIT;
+				description.loadOp = load ? VK_ATTACHMENT_LOAD_OP_LOAD : (isWrite(*uses[0].second) ? VK_ATTACHMENT_LOAD_OP_CLEAR : VK_ATTACHMENT_LOAD_OP_DONT_CARE);
+				description.storeOp = (resource.imported || (resource.lastUse > p)) ? VK_ATTACHMENT_STORE_OP_STORE : VK_ATTACHMENT_STORE_OP_DONT_CARE;
+				const bool stencil = vks::tools::formatHasStencil(resource.info.format) != VK_FALSE;
+				description.stencilLoadOp = stencil ? description.loadOp : VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+				description.stencilStoreOp = stencil ? description.storeOp : VK_ATTACHMENT_STORE_OP_DONT_CARE;
+				// Discarded contents don't need to be transitioned from their previous layout
+				if (!load) {
+					state.layout = VK_IMAGE_LAYOUT_UNDEFINED;
+				}
+				description.initialLayout = state.layout;
+
+				VkPipelineStageFlags srcStageMask = 0;
+				VkAccessFlags srcAccessMask = 0;
+				if (dependency(state, *uses[0].second, true, srcStageMask, srcAccessMask) && (srcStageMask != 0)) {
+					addSubpassDependency(physicalPass.dependencies, VK_SUBPASS_EXTERNAL, uses[0].first, srcStageMask, srcAccessMask, uses[0].second->stageMask, uses[0].second->accessMask);
+				}
+				for (size_t k = 1; k < uses.size(); k++) {
+					const Pass::Access &access = *uses[k].second;
+					for (size_t j = k; j-- > 0;) {
+						const Pass::Access &earlier = *uses[j].second;
+						if (isWrite(earlier) || isWrite(access) || (earlier.layout != access.layout)) {
+							addSubpassDependency(physicalPass.dependencies, uses[j].first, uses[k].first, earlier.stageMask, earlier.accessMask & writeAccessFlags, access.stageMask, access.accessMask);
+						}
+						if (isWrite(earlier)) {
+							break;
+						}
+					}
+				}
+				for (auto &use : uses) {
+					updateState(state, *use.second, true);
+					hasContents[resourceIndex] = hasContents[resourceIndex] || isWrite(*use.second);
+				}
+
+				description.finalLayout = state.layout;
+				if (resource.imported && (resource.lastUse == p) && (resource.finalLayout != VK_IMAGE_LAYOUT_UNDEFINED)) {
+					description.finalLayout = resource.finalLayout;
+					state.layout = resource.finalLayout;
+				}
+				physicalPass.attachmentDescriptions.push_back(description);
+			}
+			statistics.subpassDependencies += static_cast<uint32_t>(physicalPass.dependencies.size());
+		}
+
+		// Imported images are handed back in the layout the application expects
+		for (uint32_t i = 0; i < static_cast<uint32_t>(resources.size()); i++) {
+			const Resource &resource = resources[i];
+			ResourceState &state = states[i];
+			if (!resource.imported || resource.buffer || (resource.firstUse == ~0u) || (resource.finalLayout == VK_IMAGE_LAYOUT_UNDEFINED) || (state.layout == resource.finalLayout)) {
+				continue;
+			}
+			Barrier barrier;
+			barrier.resource = i;
+			barrier.oldLayout = state.layout;
+			barrier.newLayout = resource.finalLayout;
+			barrier.srcAccessMask = state.writeAccessMask;
+			barrier.dstAccessMask = 0;
+			finalBarriers.barriers.push_back(barrier);
+			finalBarriers.srcStageMask |= state.writeStageMask | state.readStageMask;
+			finalBarriers.dstStageMask |= VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT;
+		}
+
+		std::vector<const BarrierBatch*> batches;
+		for (auto &physicalPass : physicalPasses) {
+			batches.push_back(&physicalPass.barriers);
+		}
+		batches.push_back(&finalBarriers);
+		for (auto batch : batches) {
+			for (auto &barrier : batch->barriers) {
+				if (resources[barrier.resource].buffer) {
+					statistics.bufferBarriers++;
+				}
+				else {
+					statistics.imageBarriers++;
+				}
+			}
+			if (!batch->barriers.empty()) {
+				statistics.pipelineBarriers++;
+			}
+		}
+	}
+
+	void RenderGraph::createRenderPasses()
+	{
+		for (auto &physicalPass : physicalPasses) {
+			if (physicalPass.compute) {
+				continue;
+			}
+			const uint32_t subpassCount = static_cast<uint32_t>(physicalPass.passes.size());
+			std::vector<std::vector<VkAttachmentReference>> colorReferences(subpassCount);
+			std::vector<std::vector<VkAttachmentReference>> inputReferences(subpassCount);
+			std::vector<VkAttachmentReference> depthReferences(subpassCount);
+			std::vector<std::vector<uint32_t>> preserveAttachments(subpassCount);
+			std::vector<VkSubpassDescription> subpassDescriptions(subpassCount);
+
+			for (uint32_t s = 0; s < subpassCount; s++) {
+				VkSubpassDescription &description = subpassDescriptions[s];
+				description.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
+				bool hasDepth = false;
+				for (auto &access : passes[physicalPass.passes[s]].accesses) {
+					if (!isAttachment(access)) {
+						continue;
+					}
+					const uint32_t attachment = static_cast<uint32_t>(std::find(physicalPass.attachments.begin(), physicalPass.attachments.end(), access.resource) - physicalPass.attachments.begin());
+					const VkAttachmentReference reference = { attachment, access.layout };
+					switch (access.type) {
+					case Pass::AccessColorOutput:
+						colorReferences[s].push_back(reference);
+						break;
+					case Pass::AccessAttachmentInput:
+						inputReferences[s].push_back(reference);
+						break;
+					default:
+						depthReferences[s] = reference;
+						hasDepth = true;
+						break;
+					}
+				}
+				description.colorAttachmentCount = static_cast<uint32_t>(colorReferences[s].size());
+				description.pColorAttachments = colorReferences[s].data();
+				description.inputAttachmentCount = static_cast<uint32_t>(inputReferences[s].size());
+				description.pInputAttachments = inputReferences[s].data();
+				description.pDepthStencilAttachment = hasDepth ? &depthReferences[s] : nullptr;
+			}
+
+			// Attachments used before and after a subpass that doesn't use them have to be preserved by it
+			for (uint32_t a = 0; a < static_cast<uint32_t>(physicalPass.attachments.size()); a++) {
+				uint32_t firstSubpass = ~0u;
+				uint32_t lastSubpass = 0;
+				std::vector<bool> used(subpassCount, false);
+				for (uint32_t s = 0; s < subpassCount; s++) {
+					for (auto &access : passes[physicalPass.passes[s]].accesses) {
+						if (access.resource == physicalPass.attachments[a]) {
+							used[s] = true;
+							firstSubpass = std::min(firstSubpass, s);
+							lastSubpass = std::max(lastSubpass, s);
+						}
+					}
+				}
+				for (uint32_t s = firstSubpass + 1; s < lastSubpass; s++) {
+					if (!used[s]) {
+						preserveAttachments[s].push_back(a);
+					}
+				}
+			}
+			for (uint32_t s = 0; s < subpassCount; s++) {
+				subpassDescriptions[s].preserveAttachmentCount = static_cast<uint32_t>(preserveAttachments[s].size());
+				subpassDescriptions[s].pPreserveAttachments = preserveAttachments[s].data();
+			}
+
+			VkRenderPassCreateInfo renderPassCI{};
+			renderPassCI.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
+			renderPassCI.attachmentCount = static_cast<uint32_t>(physicalPass.attachmentDescriptions.size());
+			renderPassCI.pAttachments = physicalPass.attachmentDescriptions.data();
+			renderPassCI.subpassCount = subpassCount;
+			renderPassCI.pSubpasses = subpassDescriptions.data();
+			renderPassCI.dependencyCount = static_cast<uint32_t>(physicalPass.dependencies.size());
+			renderPassCI.pDependencies = physicalPass.dependencies.data();
+			VK_CHECK_RESULT(vkCreateRenderPass(device->logicalDevice, &renderPassCI, nullptr, &physicalPass.renderPass));
+
+			// Passes writing to a multi image import get one framebuffer per image
+			size_t framebufferCount = 1;
+			for (auto index : physicalPass.attachments) {
+				framebufferCount = std::max(framebufferCount, resources[index].importedViews.size());
+			}
+			physicalPass.framebuffers.resize(framebufferCount);
+			for (size_t f = 0; f < framebufferCount; f++) {
+				std::vector<VkImageView> views;
+				for (auto index : physicalPass.attachments) {
+					const Resource &resource = resources[index];
+					views.push_back(resource.imported ? resource.importedViews[std::min(f, resource.importedViews.size() - 1)] : resource.view);
+				}
+				VkFramebufferCreateInfo framebufferCI = vks::initializers::framebufferCreateInfo();
+				framebufferCI.renderPass = physicalPass.renderPass;
+				framebufferCI.attachmentCount = static_cast<uint32_t>(views.size());
+				framebufferCI.pAttachments = views.data();
+				framebufferCI.width = physicalPass.extent.width;
+				framebufferCI.height = physicalPass.extent.height;
+				framebufferCI.layers = 1;
+				VK_CHECK_RESULT(vkCreateFramebuffer(device->logicalDevice, &framebufferCI, nullptr, &physicalPass.framebuffers[f]));
+			}
+		}
+	}
+
+	void RenderGraph::compile(VkExtent2D referenceExtent)
+	{
+		assert(device);
+		destroyCompiled();
+		resolveAccesses(referenceExtent);
+		cullPasses();
+		buildPhysicalPasses();
+		createImages();
+		allocateMemory();
+		deriveBarriers();
+		createRenderPasses();
+		createQueryPool();
+		compiled = true;
+	}
+
+	void RenderGraph::createQueryPool()
+	{
+		if (!timestampsSupported) {
+			return;
+		}
+		// Command buffers are recorded once per frame index, each of them needs its own queries
+		timestampFrames = 1;
+		for (auto &resource : resources) {
+			timestampFrames = std::max(timestampFrames, static_cast<uint32_t>(resource.importedImages.size()));
+		}
+		timestampsPerFrame = 1;
+		for (auto &physicalPass : physicalPasses) {
+			for (auto index : physicalPass.passes) {
+				passes[index].timestamp = timestampsPerFrame++;
+			}
+		}
+		VkQueryPoolCreateInfo queryPoolInfo{};
+		queryPoolInfo.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+		queryPoolInfo.queryType = VK_QUERY_TYPE_TIMESTAMP;
+		queryPoolInfo.queryCount = timestampFrames * timestampsPerFrame;
+		VK_CHECK_RESULT(vkCreateQueryPool(device->logicalDevice, &queryPoolInfo, nullptr, &queryPool));
+	}
+
+	VkImage RenderGraph::resourceImage(uint32_t resource, uint32_t imageIndex) const
+	{
+		const Resource &r = resources[resource];
+		return r.imported ? r.importedImages[std::min(static_cast<size_t>(imageIndex), r.importedImages.size() - 1)] : r.image;
+	}
+
+	void RenderGraph::recordBarriers(VkCommandBuffer commandBuffer, const BarrierBatch &batch, uint32_t imageIndex) const
+	{
+		if (batch.barriers.empty()) {
+			return;
+		}
+		std::vector<VkImageMemoryBarrier> imageBarriers;
+		std::vector<VkBufferMemoryBarrier> bufferBarriers;
+		for (auto &barrier : batch.barriers) {
+			const Resource &resource = resources[barrier.resource];
+			if (resource.buffer) {
+				VkBufferMemoryBarrier bufferBarrier = vks::initializers::bufferMemoryBarrier();
+				bufferBarrier.srcAccessMask = barrier.srcAccessMask;
+				bufferBarrier.dstAccessMask = barrier.dstAccessMask;
+				bufferBarrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+				bufferBarrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+				bufferBarrier.buffer = resource.importedBuffer;
+				bufferBarrier.size = VK_WHOLE_SIZE;
+				bufferBarriers.push_back(bufferBarrier);
+			}
+			else {
+				VkImageMemoryBarrier imageBarrier = vks::initializers::imageMemoryBarrier();
+				imageBarrier.srcAccessMask = barrier.srcAccessMask;
+				imageBarrier.dstAccessMask = barrier.dstAccessMask;
+				imageBarrier.oldLayout = barrier.oldLayout;
+				imageBarrier.newLayout = barrier.newLayout;
+				imageBarrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+				imageBarrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+				imageBarrier.image = resourceImage(barrier.resource, imageIndex);
+				imageBarrier.subresourceRange = { resource.aspectMask, 0, 1, 0, 1 };
+				imageBarriers.push_back(imageBarrier);
+			}
+		}
+		const VkPipelineStageFlags srcStageMask = (batch.srcStageMask != 0) ? batch.srcStageMask : static_cast<VkPipelineStageFlags>(VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT);
+		vkCmdPipelineBarrier(commandBuffer, srcStageMask, batch.dstStageMask, 0, 0, nullptr, static_cast<uint32_t>(bufferBarriers.size()), bufferBarriers.data(), static_cast<uint32_t>(imageBarriers.size()), imageBarriers.data());
+	}
+
+	void RenderGraph::execute(VkCommandBuffer commandBuffer, uint32_t imageIndex) const
+	{
+		assert(compiled);
+		const uint32_t firstQuery = (imageIndex % std::max(timestampFrames, 1u)) * timestampsPerFrame;
+		if (queryPool != VK_NULL_HANDLE) {
+			vkCmdResetQueryPool(commandBuffer, queryPool, firstQuery, timestampsPerFrame);
+			vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, queryPool, firstQuery);
+		}
+		for (auto &physicalPass : physicalPasses) {
+			recordBarriers(commandBuffer, physicalPass.barriers, imageIndex);
+			if (physicalPass.compute) {
+				const Pass &pass = passes[physicalPass.passes[0]];
+				if (pass.record) {
+					pass.record(commandBuffer);
+				}
+				if (queryPool != VK_NULL_HANDLE) {
+					vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, queryPool, firstQuery + pass.timestamp);
+				}
+				continue;
+			}
+			VkRenderPassBeginInfo renderPassBeginInfo = vks::initializers::renderPassBeginInfo();
+			renderPassBeginInfo.renderPass = physicalPass.renderPass;
+			renderPassBeginInfo.framebuffer = physicalPass.framebuffers[std::min(static_cast<size_t>(imageIndex), physicalPass.framebuffers.size() - 1)];
+			renderPassBeginInfo.renderArea.extent = physicalPass.extent;
+			renderPassBeginInfo.clearValueCount = static_cast<uint32_t>(physicalPass.clearValues.size());
+			renderPassBeginInfo.pClearValues = physicalPass.clearValues.data();
+			vkCmdBeginRenderPass(commandBuffer, &renderPassBeginInfo, VK_SUBPASS_CONTENTS_INLINE);
+			for (size_t s = 0; s < physicalPass.passes.size(); s++) {
+				if (s > 0) {
+					vkCmdNextSubpass(commandBuffer, VK_SUBPASS_CONTENTS_INLINE);
+				}
+				VkViewport viewport = vks::initializers::viewport((float)physicalPass.extent.width, (float)physicalPass.extent.height, 0.0f, 1.0f);
+				vkCmdSetViewport(commandBuffer, 0, 1, &viewport);
+				VkRect2D scissor = vks::initializers::rect2D(physicalPass.extent.width, physicalPass.extent.height, 0, 0);
+				vkCmdSetScissor(commandBuffer, 0, 1, &scissor);
+				const Pass &pass = passes[physicalPass.passes[s]];
+				if (pass.record) {
+					pass.record(commandBuffer);
+				}
+				// Merged passes overlap on the GPU, their times are only a rough split of the render pass
+				if (queryPool != VK_NULL_HANDLE) {
+					vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, queryPool, firstQuery + pass.timestamp);
+				}
+			}
+			vkCmdEndRenderPass(commandBuffer);
+		}
+		recordBarriers(commandBuffer, finalBarriers, imageIndex);
+	}
+
+	bool RenderGraph::isCompiled() const
+	{
+		return compiled;
+	}
+
+	bool RenderGraph::isCulled(const std::string &pass) const
+	{
+		return findPass(pass).culled;
+	}
+
+	VkImage RenderGraph::image(const std::string &name) const
+	{
+		const uint32_t index = findResource(name);
+		assert(index != ~0u);
+		return resourceImage(index, 0);
+	}
+
+	VkImageView RenderGraph::imageView(const std::string &name) const
+	{
+		const uint32_t index = findResource(name);
+		assert(index != ~0u);
+		const Resource &resource = resources[index];
+		return resource.imported ? resource.importedViews[0] : resource.view;
+	}
+
+	VkExtent2D RenderGraph::extent(const std::string &name) const
+	{
+		const uint32_t index = findResource(name);
+		assert(index != ~0u);
+		return resources[index].extent;
+	}
+
+	VkRenderPass RenderGraph::renderPass(const std::string &pass) const
+	{
+		const Pass &p = findPass(pass);
+		assert(compiled && !p.compute);
+		return p.culled ? VK_NULL_HANDLE : physicalPasses[p.physicalPass].renderPass;
+	}
+
+	uint32_t RenderGraph::subpass(const std::string &pass) const
+	{
+		return findPass(pass).subpass;
+	}
+
+	void RenderGraph::updateTimings(uint32_t imageIndex)
+	{
+		if (queryPool == VK_NULL_HANDLE) {
+			return;
+		}
+		std::vector<uint64_t> results(timestampsPerFrame);
+		const uint32_t firstQuery = (imageIndex % timestampFrames) * timestampsPerFrame;
+		// Not ready if the command buffer has not been submitted since it was recorded
+		if (vkGetQueryPoolResults(device->logicalDevice, queryPool, firstQuery, timestampsPerFrame, results.size() * sizeof(uint64_t), results.data(), sizeof(uint64_t), VK_QUERY_RESULT_64_BIT) != VK_SUCCESS) {
+			return;
+		}
+		const float period = device->properties.limits.timestampPeriod / 1.0e6f;
+		statistics.gpuTime = 0.0f;
+		for (auto &pass : passes) {
+			if (pass.culled) {
+				continue;
+			}
+			const float time = static_cast<float>(results[pass.timestamp] - results[pass.timestamp - 1]) * period;
+			pass.gpuTime = (pass.gpuTime == 0.0f) ? time : pass.gpuTime * 0.9f + time * 0.1f;
+			statistics.gpuTime += pass.gpuTime;
+		}
+	}
+
+	float RenderGraph::passTime(const std::string &pass) const
+	{
+		return findPass(pass).gpuTime;
+	}
+
+	bool RenderGraph::updateUIOverlay(vks::UIOverlay *overlay)
+	{
+		bool changed = false;
+		if (overlay->header("Render graph")) {
+			const float megabyte = 1024.0f * 1024.0f;
+			changed |= overlay->checkBox("Alias image memory", &aliasing);
+			overlay->text("Passes: %d (%d culled, %d merged)", statistics.passes, statistics.culledPasses, statistics.mergedPasses);
+			overlay->text("Render passes: %d, compute: %d", statistics.renderPasses, statistics.computePasses);
+			overlay->text("Barriers: %d image, %d buffer", statistics.imageBarriers, statistics.bufferBarriers);
+			overlay->text("Pipeline barriers: %d", statistics.pipelineBarriers);
+			overlay->text("Subpass dependencies: %d", statistics.subpassDependencies);
+			overlay->text("Images: %d (%d aliased, %d transient)", statistics.images, statistics.aliasedImages, statistics.transientImages);
+			overlay->text("Memory: %.1f of %.1f MB", (float)statistics.allocatedMemory / megabyte, (float)statistics.requiredMemory / megabyte);
+			overlay->text("Saved: %.1f MB", (float)(statistics.requiredMemory - statistics.allocatedMemory) / megabyte);
+			if (statistics.lazilyAllocatedMemory > 0) {
+				overlay->text("Lazily allocated: %.1f MB", (float)statistics.lazilyAllocatedMemory / megabyte);
+			}
+			if (queryPool != VK_NULL_HANDLE) {
+				overlay->text("GPU time: %.3f ms", statistics.gpuTime);
+				for (auto &pass : passes) {
+					if (!pass.culled) {
+						overlay->text("  %s: %.3f ms", pass.name.c_str(), pass.gpuTime);
+					}
+				}
+			}
+		}
+		return changed;
+	}
+}
@@ -0,0 +1,283 @@
+/*
+* Vulkan render graph
+*
+* Passes declare the images and buffers they read and write, the graph derives everything else from that:
+* passes that don't contribute to an output are culled, consecutive graphics passes that only read each other's
+* results at the same pixel are merged into subpasses of one render pass, layout transitions and barriers are derived
+* from the declared accesses (as subpass dependencies inside and around render passes and as pipeline barriers for
+* everything else) and images that are only alive for a part of the frame share memory with other images whose
+* lifetimes don't overlap. Passes execute in the order they are declared
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#pragma once
+
+#include <deque>
+#include <functional>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "vulkan/vulkan.h"
+#include "VulkanDevice.h"
+#include "VulkanTools.h"
+#include "VulkanUIOverlay.h"
+
+namespace vks
+{
+	class RenderGraph
+	{
+	public:
+		enum SizeMode { SizeSwapchainRelative = 0, SizeAbsolute = 1 };
+
+		/** @brief Description of an image owned by the graph */
+		struct ImageInfo
+		{
+			VkFormat format = VK_FORMAT_UNDEFINED;
+			/** @brief Relative sizes are scaled by the reference extent passed to compile */
+			SizeMode sizeMode = SizeSwapchainRelative;
+			float width = 1.0f;
+			float height = 1.0f;
+			/** @brief Used if a pass writes the image as an attachment before anything else in the frame */
+			VkClearValue clearValue = {};
+		};
+
+		typedef std::function<void(VkCommandBuffer commandBuffer)> RecordFunction;
+
+		class Pass
+		{
+		public:
+			Pass &addColorOutput(const std::string &name);
+			Pass &setDepthStencilOutput(const std::string &name);
+			/** @brief Depth test without depth writes */
+			Pass &setDepthStencilInput(const std::string &name);
+			/** @brief Read at the current pixel with subpassLoad, allows merging with the pass that wrote the image */
+			Pass &addAttachmentInput(const std::string &name);
+			Pass &addTextureInput(const std::string &name, VkPipelineStageFlags stageMask = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT);
+			/** @brief Storage image or storage buffer access */
+			Pass &addStorageInput(const std::string &name, VkPipelineStageFlags stageMask = VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT);
+			Pass &addStorageOutput(const std::string &name, VkPipelineStageFlags stageMask = VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT);
+			/** @brief Any other read of an imported buffer, e.g. vertex, index, indirect or uniform reads */
+			Pass &addBufferInput(const std::string &name, VkPipelineStageFlags stageMask, VkAccessFlags accessMask);
+			/** @brief Called while recording the frame, graphics passes are called inside their subpass with viewport and scissor set */
+			Pass &setRecordFunction(RecordFunction function);
+
+		private:
+			friend class RenderGraph;
+
+			enum AccessType { AccessColorOutput, AccessDepthOutput, AccessDepthInput, AccessAttachmentInput, AccessTexture, AccessStorageInput, AccessStorageOutput, AccessBufferInput };
+
+			struct Access
+			{
+				std::string name;
+				AccessType type;
+				VkPipelineStageFlags stageMask;
+				VkAccessFlags accessMask;
+				VkImageLayout layout;
+				uint32_t resource;
+			};
+
+			std::string name;
+			bool compute = false;
+			std::vector<Access> accesses;
+			RecordFunction record;
+
+			bool culled = false;
+			uint32_t physicalPass = 0;
+			uint32_t subpass = 0;
+			// Query written after the pass, the query before it marks its start
+			uint32_t timestamp = 0;
+			// Smoothed GPU time in milliseconds
+			float gpuTime = 0.0f;
+
+			Pass &addAccess(const std::string &name, AccessType type, VkPipelineStageFlags stageMask, VkAccessFlags accessMask, VkImageLayout layout);
+		};
+
+		struct Statistics
+		{
+			uint32_t passes = 0;
+			uint32_t culledPasses = 0;
+			/** @brief Passes that became subpasses of a render pass started by an earlier pass */
+			uint32_t mergedPasses = 0;
+			uint32_t renderPasses = 0;
+			uint32_t computePasses = 0;
+			/** @brief Barriers recorded per frame */
+			uint32_t imageBarriers = 0;
+			uint32_t bufferBarriers = 0;
+			uint32_t pipelineBarriers = 0;
+			uint32_t subpassDependencies = 0;
+			uint32_t images = 0;
+			uint32_t aliasedImages = 0;
+			uint32_t transientImages = 0;
+			/** @brief Memory all graph owned images would need with dedicated allocations */
+			VkDeviceSize requiredMemory = 0;
+			VkDeviceSize allocatedMemory = 0;
+			/** @brief Part of the allocated memory that is lazily allocated and may never be backed on tiling GPUs */
+			VkDeviceSize lazilyAllocatedMemory = 0;
+			/** @brief Sum of the measured pass times in milliseconds */
+			float gpuTime = 0.0f;
+		} statistics;
+
+		/** @brief Images that don't overlap in lifetime share memory, disabling this gives every image its own allocation */
+		bool aliasing = true;
+
+	private:
+		struct Resource
+		{
+			std::string name;
+			bool buffer = false;
+			bool imported = false;
+			ImageInfo info;
+			VkExtent2D extent = {};
+			VkImageUsageFlags usage = 0;
+			VkImageAspectFlags aspectMask = 0;
+			// Imported images may have one image per swapchain image
+			std::vector<VkImage> importedImages;
+			std::vector<VkImageView> importedViews;
+			VkImageLayout finalLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+			VkPipelineStageFlags importStageMask = 0;
+			VkBuffer importedBuffer = VK_NULL_HANDLE;
+			VkImage image = VK_NULL_HANDLE;
+			VkImageView view = VK_NULL_HANDLE;
+			VkDeviceMemory dedicatedMemory = VK_NULL_HANDLE;
+			VkMemoryRequirements memoryRequirements = {};
+			// Physical passes of the first and the last access
+			uint32_t firstUse = ~0u;
+			uint32_t lastUse = 0;
+			// Only accessed as an attachment inside a single render pass
+			bool transient = false;
+			int32_t block = -1;
+			VkDeviceSize offset = 0;
+			// Graph owned images bound to overlapping memory
+			std::vector<uint32_t> aliases;
+		};
+
+		struct MemoryBlock
+		{
+			VkDeviceMemory memory = VK_NULL_HANDLE;
+			VkDeviceSize size = 0;
+			uint32_t memoryTypeIndex = 0;
+			std::vector<uint32_t> resources;
+		};
+
+		// Synchronization state of a resource while walking the frame
+		struct ResourceState
+		{
+			VkImageLayout layout = VK_IMAGE_LAYOUT_UNDEFINED;
+			VkPipelineStageFlags writeStageMask = 0;
+			VkAccessFlags writeAccessMask = 0;
+			// Reads since the last write, a write has to wait for them
+			VkPipelineStageFlags readStageMask = 0;
+			// Stages and accesses the last write has already been made visible to
+			VkPipelineStageFlags visibleStageMask = 0;
+			VkAccessFlags visibleAccessMask = 0;
+		};
+
+		struct Barrier
+		{
+			uint32_t resource;
+			VkImageLayout oldLayout;
+			VkImageLayout newLayout;
+			VkAccessFlags srcAccessMask;
+			VkAccessFlags dstAccessMask;
+		};
+
+		struct BarrierBatch
+		{
+			VkPipelineStageFlags srcStageMask = 0;
+			VkPipelineStageFlags dstStageMask = 0;
+			std::vector<Barrier> barriers;
+		};
+
+		// A render pass with one subpass per merged pass, or a single compute pass
+		struct PhysicalPass
+		{
+			bool compute = false;
+			std::vector<uint32_t> passes;
+			VkExtent2D extent = {};
+			std::vector<uint32_t> attachments;
+			std::vector<VkClearValue> clearValues;
+			std::vector<VkAttachmentDescription> attachmentDescriptions;
+			std::vector<VkSubpassDependency> dependencies;
+			VkRenderPass renderPass = VK_NULL_HANDLE;
+			std::vector<VkFramebuffer> framebuffers;
+			BarrierBatch barriers;
+		};
+
+		vks::VulkanDevice *device = nullptr;
+		std::vector<Resource> resources;
+		std::deque<Pass> passes;
+		std::vector<std::string> outputs;
+		std::vector<PhysicalPass> physicalPasses;
+		std::vector<MemoryBlock> memoryBlocks;
+		// Transitions of imported images whose last access isn't an attachment
+		BarrierBatch finalBarriers;
+		bool compiled = false;
+		// One range of timestamps per frame index passed to execute
+		bool timestampsSupported = false;
+		VkQueryPool queryPool = VK_NULL_HANDLE;
+		uint32_t timestampFrames = 0;
+		uint32_t timestampsPerFrame = 0;
+
+		static bool isWrite(const Pass::Access &access);
+		static bool isAttachment(const Pass::Access &access);
+		// Returns true if the access has to wait for earlier accesses of the resource and fills in what it waits for
+		static bool dependency(const ResourceState &state, const Pass::Access &access, bool image, VkPipelineStageFlags &srcStageMask, VkAccessFlags &srcAccessMask);
+		static void updateState(ResourceState &state, const Pass::Access &access, bool synchronized);
+
+		uint32_t findResource(const std::string &name) const;
+		const Pass &findPass(const std::string &name) const;
+		uint32_t addResource(const std::string &name);
+		void resolveAccesses(VkExtent2D referenceExtent);
+		void cullPasses();
+		VkExtent2D passExtent(const Pass &pass) const;
+		bool canMerge(const PhysicalPass &physicalPass, const Pass &pass) const;
+		void buildPhysicalPasses();
+		void createImages();
+		void allocateMemory();
+		void deriveBarriers();
+		void createRenderPasses();
+		void createQueryPool();
+		void addBarrier(BarrierBatch &batch, ResourceState &state, const Pass::Access &access);
+		VkImage resourceImage(uint32_t resource, uint32_t imageIndex) const;
+		void recordBarriers(VkCommandBuffer commandBuffer, const BarrierBatch &batch, uint32_t imageIndex) const;
+		void destroyCompiled();
+
+	public:
+		void prepare(vks::VulkanDevice *device);
+		/** @brief Removes all passes and resources, compiled objects are destroyed */
+		void reset();
+		void destroy();
+
+		void addImage(const std::string &name, const ImageInfo &info);
+		/** @brief Image owned by the application (e.g. the swapchain), with either one image or one per frame index passed to execute
+		* Images with a final layout other than undefined have to be in that layout at the start of every frame, their contents are kept for passes that read them first */
+		void importImage(const std::string &name, VkFormat format, VkExtent2D extent, const std::vector<VkImage> &images, const std::vector<VkImageView> &views, VkImageLayout finalLayout, VkClearValue clearValue, VkPipelineStageFlags importStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT);
+		void importBuffer(const std::string &name, VkBuffer buffer);
+		/** @brief Passes writing an output are never culled, nor are the passes they depend on */
+		void addOutput(const std::string &name);
+		Pass &addGraphicsPass(const std::string &name);
+		Pass &addComputePass(const std::string &name);
+
+		void compile(VkExtent2D referenceExtent);
+		/** @brief Records all passes with their barriers, imageIndex selects the image of multi image imports */
+		void execute(VkCommandBuffer commandBuffer, uint32_t imageIndex) const;
+
+		bool isCompiled() const;
+		bool isCulled(const std::string &pass) const;
+		VkImage image(const std::string &name) const;
+		VkImageView imageView(const std::string &name) const;
+		VkExtent2D extent(const std::string &name) const;
+		/** @brief Render pass and subpass index pipelines of a graphics pass have to be created with */
+		VkRenderPass renderPass(const std::string &pass) const;
+		uint32_t subpass(const std::string &pass) const;
+		/** @brief Reads the timestamps of a finished frame, results of frames still in flight are skipped */
+		void updateTimings(uint32_t imageIndex);
+		/** @brief GPU time of a pass in milliseconds, zero if timestamps are not supported */
+		float passTime(const std::string &pass) const;
+
+		/** @brief Returns true if a setting changed that requires compiling the graph again */
+		bool updateUIOverlay(vks::UIOverlay *overlay);
+	};
+}
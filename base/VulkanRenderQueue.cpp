@@ -0,0 +1,290 @@
+/*
+* Vulkan render queue
+*
+* Flattens the primitives of glTF models into draw packets with 64 bit sort keys, radix sorts them and records
+* the sorted list with redundant pipeline, descriptor set and buffer binds removed
+* Opaque and alpha masked packets are ordered by pipeline, material and then front to back, alpha blended packets
+* are ordered back to front first so they blend correctly
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#include "VulkanRenderQueue.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cfloat>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+
+namespace vks
+{
+	// Maximum number of descriptor sets tracked while recording
+	static const uint32_t maxTrackedSets = 8;
+
+	/*
+	* Key layout, most significant bits first
+	* Opaque and alpha masked: layer (2) | pipeline (12) | material (16) | depth (24) | unused (10)
+	* Alpha blended: layer (2) | inverted depth (24) | pipeline (12) | material (16) | unused (10)
+	* Depth is the upper 24 bits of the view space distance, positive floats keep their order when compared as integers
+	*/
+	uint64_t RenderQueue::makeKey(Layer layer, uint32_t pipeline, uint32_t material, float depth)
+	{
+		uint32_t depthBits;
+		depth = std::max(depth, 0.0f);
+		memcpy(&depthBits, &depth, sizeof(depthBits));
+		const uint64_t quantizedDepth = depthBits >> 8;
+		uint64_t key = static_cast<uint64_t>(layer) << 62;
+		if (layer == LayerAlphaBlended) {
+			key |= (~quantizedDepth & 0xFFFFFF) << 38;
+			key |= static_cast<uint64_t>(pipeline) << 26;
+			key |= static_cast<uint64_t>(material) << 10;
+		} else {
+			key |= static_cast<uint64_t>(pipeline) << 50;
+			key |= static_cast<uint64_t>(material) << 34;
+			key |= quantizedDepth << 10;
+		}
+		return key;
+	}
+
+	// Descriptor sets get consecutive ids in the order they are first seen, without a set the material index is used
+	uint32_t RenderQueue::materialId(VkDescriptorSet descriptorSet, uint32_t materialIndex)
+	{
+		if (descriptorSet == VK_NULL_HANDLE) {
+			return materialIndex % maxMaterials;
+		}
+		auto it = materialIds.find(descriptorSet);
+		if (it != materialIds.end()) {
+			return it->second;
+		}
+		const uint32_t id = static_cast<uint32_t>(materialIds.size()) % maxMaterials;
+		materialIds[descriptorSet] = id;
+		return id;
+	}
+
+	bool RenderQueue::sphereInFrustum(const glm::vec3 &center, float radius) const
+	{
+		for (const glm::vec4 &plane : frustumPlanes) {
+			if (glm::dot(glm::vec3(plane), center) + plane.w <= -radius) {
+				return false;
+			}
+		}
+		return true;
+	}
+
+	uint32_t RenderQueue::addPipeline(VkPipeline pipeline, VkPipelineLayout layout)
+	{
+		for (uint32_t i = 0; i < pipelines.size(); i++) {
+			if ((pipelines[i].pipeline == pipeline) && (pipelines[i].layout == layout)) {
+				return i;
+			}
+		}
+		assert(pipelines.size() < maxPipelines);
+		pipelines.push_back({ pipeline, layout });
+		return static_cast<uint32_t>(pipelines.size() - 1);
+	}
+
+	void RenderQueue::reset()
+	{
+		pipelines.clear();
+		materialIds.clear();
+		packets.clear();
+		keys.clear();
+		order.clear();
+	}
+
+	void RenderQueue::begin(const glm::mat4 &view, const glm::mat4 &projection, bool frustumCulling)
+	{
+		this->view = view;
+		this->frustumCulling = frustumCulling;
+		packets.clear();
+		keys.clear();
+		order.clear();
+		statistics.primitives = 0;
+		statistics.culled = 0;
+		statistics.buildTime = 0.0f;
+		statistics.sortTime = 0.0f;
+
+		// Gribb/Hartmann plane extraction, same as vks::Frustum
+		const glm::mat4 matrix = projection * view;
+		for (uint32_t i = 0; i < 3; i++) {
+			for (uint32_t j = 0; j < 2; j++) {
+				glm::vec4 &plane = frustumPlanes[i * 2 + j];
+				const float sign = (j == 0) ? 1.0f : -1.0f;
+				for (uint32_t k = 0; k < 4; k++) {
+					plane[k] = matrix[k].w + sign * matrix[k][i];
+				}
+				plane /= glm::length(glm::vec3(plane));
+			}
+		}
+	}
+
+	void RenderQueue::addModel(const vkglTF::Model &model, const std::array<uint32_t, LayerCount> &layerPipelines, uint32_t renderFlags, uint32_t materialSetIndex, const glm::mat4 &transform, bool flipY)
+	{
+		auto tStart = std::chrono::high_resolution_clock::now();
+		const glm::mat4 flip = glm::scale(glm::mat4(1.0f), glm::vec3(1.0f, flipY ? -1.0f : 1.0f, 1.0f));
+		const bool bindless = (renderFlags & vkglTF::RenderFlags::BindBindlessSet) != 0;
+		for (auto node : model.linearNodes) {
+			if (!node->mesh) {
+				continue;
+			}
+			const glm::mat4 matrix = transform * flip * node->getMatrix();
+			for (auto primitive : node->mesh->primitives) {
+				if (primitive->indexCount == 0) {
+					continue;
+				}
+				const vkglTF::Material &material = primitive->material;
+				Layer layer = LayerOpaque;
+				if (material.alphaMode == vkglTF::Material::ALPHAMODE_MASK) {
+					layer = LayerAlphaMasked;
+				}
+				if (material.alphaMode == vkglTF::Material::ALPHAMODE_BLEND) {
+					layer = LayerAlphaBlended;
+				}
+				const uint32_t pipeline = layerPipelines[layer];
+				if (pipeline == invalidPipeline) {
+					continue;
+				}
+				statistics.primitives++;
+
+				// Bounding sphere of the transformed primitive bounds
+				glm::vec3 boundsMin(FLT_MAX);
+				glm::vec3 boundsMax(-FLT_MAX);
+				for (uint32_t i = 0; i < 8; i++) {
+					glm::vec3 corner((i & 1) ? primitive->dimensions.max.x : primitive->dimensions.min.x, (i & 2) ? primitive->dimensions.max.y : primitive->dimensions.min.y, (i & 4) ? primitive->dimensions.max.z : primitive->dimensions.min.z);
+					corner = glm::vec3(matrix * glm::vec4(corner, 1.0f));
+					boundsMin = glm::min(boundsMin, corner);
+					boundsMax = glm::max(boundsMax, corner);
+				}
+				const glm::vec3 center = (boundsMin + boundsMax) * 0.5f;
+				if (frustumCulling && !sphereInFrustum(center, glm::length(boundsMax - center))) {
+					statistics.culled++;
+					continue;
+				}
+
+				Packet packet{};
+				packet.pipeline = pipeline;
+				packet.materialSetIndex = materialSetIndex;
+				packet.vertexBuffer = model.vertices.buffer;
+				packet.indexBuffer = model.indices.buffer;
+				packet.indexCount = primitive->indexCount;
+				packet.firstIndex = primitive->firstIndex;
+				uint32_t materialKey;
+				if (bindless) {
+					// Packets of one model share the bindless set, sorting by material index still groups texture accesses
+					packet.materialSet = model.bindlessDescriptorSet;
+					packet.firstInstance = material.index;
+					materialKey = materialId(VK_NULL_HANDLE, material.index);
+				} else {
+					packet.materialSet = (renderFlags & vkglTF::RenderFlags::BindImages) ? material.descriptorSet : VK_NULL_HANDLE;
+					materialKey = materialId(packet.materialSet, material.index);
+				}
+				// Camera looks down the negative z axis in view space
+				const float depth = -(view * glm::vec4(center, 1.0f)).z;
+				keys.push_back(makeKey(layer, pipeline, materialKey, depth));
+				order.push_back(static_cast<uint32_t>(packets.size()));
+				packets.push_back(packet);
+			}
+		}
+		statistics.buildTime += std::chrono::duration<float, std::milli>(std::chrono::high_resolution_clock::now() - tStart).count();
+	}
+
+	/*
+	* Least significant digit radix sort with 8 bit digits over the keys and the packet order
+	* Digits that are the same for all keys (e.g. the unused low bits or the layer of a single layer list) are skipped
+	*/
+	void RenderQueue::sort()
+	{
+		auto tStart = std::chrono::high_resolution_clock::now();
+		const size_t count = keys.size();
+		sortKeys.resize(count);
+		sortOrder.resize(count);
+		std::array<uint32_t, 256> histogram;
+		for (uint32_t shift = 0; shift < 64; shift += 8) {
+			histogram.fill(0);
+			for (size_t i = 0; i < count; i++) {
+				histogram[(keys[i] >> shift) & 0xFF]++;
+			}
+			if ((count == 0) || (histogram[(keys[0] >> shift) & 0xFF] == count)) {
+				continue;
+			}
+			uint32_t offset = 0;
+			for (uint32_t &bucket : histogram) {
+				const uint32_t bucketCount = bucket;
+				bucket = offset;
+				offset += bucketCount;
+			}
+			for (size_t i = 0; i < count; i++) {
+				const uint32_t target = histogram[(keys[i] >> shift) & 0xFF]++;
+				sortKeys[target] = keys[i];
+				sortOrder[target] = order[i];
+			}
+			keys.swap(sortKeys);
+			order.swap(sortOrder);
+		}
+		statistics.sortTime = std::chrono::duration<float, std::milli>(std::chrono::high_resolution_clock::now() - tStart).count();
+	}
+
+	void RenderQueue::record(VkCommandBuffer commandBuffer)
+	{
+		auto tStart = std::chrono::high_resolution_clock::now();
+		statistics.draws = 0;
+		statistics.pipelineBinds = 0;
+		statistics.descriptorSetBinds = 0;
+		statistics.bufferBinds = 0;
+		statistics.redundantBinds = 0;
+
+		uint32_t boundPipeline = invalidPipeline;
+		VkPipelineLayout boundLayout = VK_NULL_HANDLE;
+		std::array<VkDescriptorSet, maxTrackedSets> boundSets;
+		boundSets.fill(VK_NULL_HANDLE);
+		VkBuffer boundVertexBuffer = VK_NULL_HANDLE;
+		VkBuffer boundIndexBuffer = VK_NULL_HANDLE;
+		const VkDeviceSize offsets[1] = { 0 };
+
+		// Unsorted lists are recorded in the order the packets were added
+		for (uint32_t index : order) {
+			const Packet &packet = packets[index];
+			const Pipeline &pipeline = pipelines[packet.pipeline];
+			if (packet.pipeline != boundPipeline) {
+				vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline.pipeline);
+				boundPipeline = packet.pipeline;
+				statistics.pipelineBinds++;
+				// Sets bound with a different layout are not guaranteed to stay valid
+				if (pipeline.layout != boundLayout) {
+					boundLayout = pipeline.layout;
+					boundSets.fill(VK_NULL_HANDLE);
+				}
+			}
+			if (packet.materialSet != VK_NULL_HANDLE) {
+				assert(packet.materialSetIndex < maxTrackedSets);
+				if (boundSets[packet.materialSetIndex] != packet.materialSet) {
+					vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline.layout, packet.materialSetIndex, 1, &packet.materialSet, 0, nullptr);
+					boundSets[packet.materialSetIndex] = packet.materialSet;
+					statistics.descriptorSetBinds++;
+				} else {
+					statistics.redundantBinds++;
+				}
+			}
+			if (packet.vertexBuffer != boundVertexBuffer) {
+				vkCmdBindVertexBuffers(commandBuffer, 0, 1, &packet.vertexBuffer, offsets);
+				boundVertexBuffer = packet.vertexBuffer;
+				statistics.bufferBinds++;
+			}
+			if (packet.indexBuffer != boundIndexBuffer) {
+				vkCmdBindIndexBuffer(commandBuffer, packet.indexBuffer, 0, VK_INDEX_TYPE_UINT32);
+				boundIndexBuffer = packet.indexBuffer;
+				statistics.bufferBinds++;
+			}
+			vkCmdDrawIndexed(commandBuffer, packet.indexCount, 1, packet.firstIndex, 0, packet.firstInstance);
+			statistics.draws++;
+		}
+		statistics.recordTime = std::chrono::duration<float, std::milli>(std::chrono::high_resolution_clock::now() - tStart).count();
+	}
+
+	uint32_t RenderQueue::packetCount() const
+	{
+		return static_cast<uint32_t>(packets.size());
+	}
+}
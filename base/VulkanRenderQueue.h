@@ -0,0 +1,110 @@
+/*
+* Vulkan render queue
+*
+* Flattens the primitives of glTF models into draw packets with 64 bit sort keys, radix sorts them and records
+* the sorted list with redundant pipeline, descriptor set and buffer binds removed
+* Opaque and alpha masked packets are ordered by pipeline, material and then front to back, alpha blended packets
+* are ordered back to front first so they blend correctly
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#pragma once
+
+#include <array>
+#include <unordered_map>
+#include <vector>
+
+#include "vulkan/vulkan.h"
+#include "VulkanglTFModel.h"
+
+namespace vks
+{
+	class RenderQueue
+	{
+	public:
+		/** @brief Layers are drawn in this order, the layer of a primitive follows from its material's alpha mode */
+		enum Layer { LayerOpaque = 0, LayerAlphaMasked = 1, LayerAlphaBlended = 2, LayerCount = 3 };
+
+		static const uint32_t invalidPipeline = ~0u;
+		static const uint32_t maxPipelines = 1 << 12;
+		static const uint32_t maxMaterials = 1 << 16;
+
+		struct Packet
+		{
+			uint32_t pipeline;
+			VkDescriptorSet materialSet;
+			uint32_t materialSetIndex;
+			VkBuffer vertexBuffer;
+			VkBuffer indexBuffer;
+			uint32_t indexCount;
+			uint32_t firstIndex;
+			uint32_t firstInstance;
+		};
+
+		/** @brief Counters of the last build and record, times are in milliseconds */
+		struct Statistics
+		{
+			uint32_t primitives = 0;
+			uint32_t culled = 0;
+			uint32_t draws = 0;
+			uint32_t pipelineBinds = 0;
+			uint32_t descriptorSetBinds = 0;
+			uint32_t bufferBinds = 0;
+			/** @brief Material set binds skipped because the previous packet used the same set, per primitive binds in tree order would issue all of them */
+			uint32_t redundantBinds = 0;
+			float buildTime = 0.0f;
+			float sortTime = 0.0f;
+			float recordTime = 0.0f;
+		} statistics;
+
+	private:
+		struct Pipeline
+		{
+			VkPipeline pipeline;
+			VkPipelineLayout layout;
+		};
+
+		std::vector<Pipeline> pipelines;
+		std::unordered_map<VkDescriptorSet, uint32_t> materialIds;
+		std::vector<Packet> packets;
+		std::vector<uint64_t> keys;
+		std::vector<uint32_t> order;
+		// Scratch space of the radix sort
+		std::vector<uint64_t> sortKeys;
+		std::vector<uint32_t> sortOrder;
+
+		glm::mat4 view = glm::mat4(1.0f);
+		std::array<glm::vec4, 6> frustumPlanes;
+		bool frustumCulling = false;
+
+		static uint64_t makeKey(Layer layer, uint32_t pipeline, uint32_t material, float depth);
+		uint32_t materialId(VkDescriptorSet descriptorSet, uint32_t materialIndex);
+		bool sphereInFrustum(const glm::vec3 &center, float radius) const;
+	public:
+		/** @brief Returns the id packets refer to the pipeline with, adding the same pipeline again returns the same id */
+		uint32_t addPipeline(VkPipeline pipeline, VkPipelineLayout layout);
+		/** @brief Removes all pipelines and packets, required if pipelines are recreated */
+		void reset();
+
+		/** @brief Starts a new list of packets, with frustum culling primitives outside of the view are not added */
+		void begin(const glm::mat4 &view, const glm::mat4 &projection, bool frustumCulling = false);
+		/**
+		* Adds the primitives of a model
+		*
+		* @param model Model to add
+		* @param layerPipelines Pipeline id per layer, primitives of layers with an invalid pipeline are skipped
+		* @param renderFlags vkglTF::RenderFlags::BindImages binds the material descriptor set of each primitive, BindBindlessSet binds the model's bindless set and passes the material index as first instance
+		* @param materialSetIndex Set index the material descriptor sets are bound to
+		* @param transform World transform of the model, used for culling and depth sorting only
+		* @param flipY Set if the model has been loaded with FileLoadingFlags::FlipY
+		*/
+		void addModel(const vkglTF::Model &model, const std::array<uint32_t, LayerCount> &layerPipelines, uint32_t renderFlags, uint32_t materialSetIndex = 1, const glm::mat4 &transform = glm::mat4(1.0f), bool flipY = false);
+		/** @brief Radix sorts the packets by their keys */
+		void sort();
+		/** @brief Records the sorted packets, state bound by the caller before is not tracked and may be rebound */
+		void record(VkCommandBuffer commandBuffer);
+
+		uint32_t packetCount() const;
+	};
+}
@@ -220,6 +220,7 @@ void VulkanSwapChain::connect(VkInstance instance, VkPhysicalDevice physicalDevi
 	fpGetSwapchainImagesKHR = reinterpret_cast<PFN_vkGetSwapchainImagesKHR>(vkGetDeviceProcAddr(device, "vkGetSwapchainImagesKHR"));
 	fpAcquireNextImageKHR = reinterpret_cast<PFN_vkAcquireNextImageKHR>(vkGetDeviceProcAddr(device, "vkAcquireNextImageKHR"));
 	fpQueuePresentKHR = reinterpret_cast<PFN_vkQueuePresentKHR>(vkGetDeviceProcAddr(device, "vkQueuePresentKHR"));
+	fpWaitForPresentKHR = reinterpret_cast<PFN_vkWaitForPresentKHR>(vkGetDeviceProcAddr(device, "vkWaitForPresentKHR"));
 }
 
 /** 
@@ -288,6 +289,20 @@ void VulkanSwapChain::create(uint32_t *width, uint32_t *height, bool vsync, bool
 		}
 	}
 
+	// An explicitly requested present mode overrides the v-sync setting if the surface supports it
+	if (preferredPresentMode != VK_PRESENT_MODE_MAX_ENUM_KHR)
+	{
+		if (std::find(presentModes.begin(), presentModes.end(), preferredPresentMode) != presentModes.end())
+		{
+			swapchainPresentMode = preferredPresentMode;
+		}
+		else
+		{
+			std::cerr << "Requested present mode " << vks::tools::presentModeString(preferredPresentMode) << " is not supported by the surface, using " << vks::tools::presentModeString(swapchainPresentMode) << "\n";
+		}
+	}
+	presentMode = swapchainPresentMode;
+
 	// Determine the number of images
 	uint32_t desiredNumberOfSwapchainImages = surfCaps.minImageCount + 1;
 #if (defined(VK_USE_PLATFORM_MACOS_MVK) && defined(VK_EXAMPLE_XCODE_GENERATED))
@@ -437,7 +452,7 @@ VkResult VulkanSwapChain::acquireNextImage(VkSemaphore presentCompleteSemaphore,
 *
 * @return VkResult of the queue presentation
 */
-VkResult VulkanSwapChain::queuePresent(VkQueue queue, uint32_t imageIndex, VkSemaphore waitSemaphore)
+VkResult VulkanSwapChain::queuePresent(VkQueue queue, uint32_t imageIndex, VkSemaphore waitSemaphore, uint64_t presentId)
 {
 	VkPresentInfoKHR presentInfo = {};
 	presentInfo.sType = VK_STRUCTURE_TYPE_PRESENT_INFO_KHR;
@@ -451,9 +466,37 @@ VkResult VulkanSwapChain::queuePresent(VkQueue queue, uint32_t imageIndex, VkSem
 		presentInfo.pWaitSemaphores = &waitSemaphore;
 		presentInfo.waitSemaphoreCount = 1;
 	}
+	// Tag the present with an id that can be waited on with waitForPresent (requires VK_KHR_present_id)
+	VkPresentIdKHR presentIdInfo = {};
+	if (presentId > 0)
+	{
+		presentIdInfo.sType = VK_STRUCTURE_TYPE_PRESENT_ID_KHR;
+		presentIdInfo.swapchainCount = 1;
+		presentIdInfo.pPresentIds = &presentId;
+		presentInfo.pNext = &presentIdInfo;
+	}
 	return fpQueuePresentKHR(queue, &presentInfo);
 }
 
+/**
+* Wait until a present tagged with the given id (or a later one) has been displayed
+*
+* @param presentId Id passed to queuePresent
+* @param timeout Timeout in nanoseconds
+*
+* @note Requires VK_KHR_present_wait, returns VK_ERROR_EXTENSION_NOT_PRESENT if it hasn't been enabled
+*
+* @return VkResult of the wait, VK_TIMEOUT if the image wasn't displayed within the timeout
+*/
+VkResult VulkanSwapChain::waitForPresent(uint64_t presentId, uint64_t timeout)
+{
+	if (!fpWaitForPresentKHR)
+	{
+		return VK_ERROR_EXTENSION_NOT_PRESENT;
+	}
+	return fpWaitForPresentKHR(device, swapChain, presentId, timeout);
+}
+
 
 /**
 * Destroy and free Vulkan resources used for the swapchain
@@ -15,6 +15,7 @@
 #include <assert.h>
 #include <stdio.h>
 #include <vector>
+#include <algorithm>
 
 #include <vulkan/vulkan.h>
 #include "VulkanTools.h"
@@ -49,6 +50,8 @@ private:
 	PFN_vkGetSwapchainImagesKHR fpGetSwapchainImagesKHR;
 	PFN_vkAcquireNextImageKHR fpAcquireNextImageKHR;
 	PFN_vkQueuePresentKHR fpQueuePresentKHR;
+	// Only available if VK_KHR_present_wait has been enabled on the device
+	PFN_vkWaitForPresentKHR fpWaitForPresentKHR = nullptr;
 public:
 	VkFormat colorFormat;
 	VkColorSpaceKHR colorSpace;
@@ -57,6 +60,10 @@ public:
 	std::vector<VkImage> images;
 	std::vector<SwapChainBuffer> buffers;
 	uint32_t queueNodeIndex = UINT32_MAX;
+	/** @brief Present mode used instead of the v-sync based selection if supported by the surface (VK_PRESENT_MODE_MAX_ENUM_KHR = none) */
+	VkPresentModeKHR preferredPresentMode = VK_PRESENT_MODE_MAX_ENUM_KHR;
+	/** @brief Present mode the swapchain has been created with */
+	VkPresentModeKHR presentMode = VK_PRESENT_MODE_FIFO_KHR;
 
 #if defined(VK_USE_PLATFORM_WIN32_KHR)
 	void initSurface(void* platformHandle, void* platformWindow);
@@ -79,6 +86,7 @@ public:
 	void connect(VkInstance instance, VkPhysicalDevice physicalDevice, VkDevice device);
 	void create(uint32_t* width, uint32_t* height, bool vsync = false, bool fullscreen = false);
 	VkResult acquireNextImage(VkSemaphore presentCompleteSemaphore, uint32_t* imageIndex);
-	VkResult queuePresent(VkQueue queue, uint32_t imageIndex, VkSemaphore waitSemaphore = VK_NULL_HANDLE);
+	VkResult queuePresent(VkQueue queue, uint32_t imageIndex, VkSemaphore waitSemaphore = VK_NULL_HANDLE, uint64_t presentId = 0);
+	VkResult waitForPresent(uint64_t presentId, uint64_t timeout);
 	void cleanup();
 };
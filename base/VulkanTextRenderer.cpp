@@ -0,0 +1,590 @@
+/*
+* Vulkan text renderer
+*
+* Draws text as one instance per glyph from bitmap or signed distance field font atlases. Glyph instances are written
+* straight into a persistently mapped buffer with one ring slot per frame, and the glyph counts are read by the GPU from
+* an indirect draw buffer, so command buffers are recorded once and stay valid while the text changes every frame.
+* Font metrics are read from AngelCode BMFont files in text or binary format with a single file read
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#include "VulkanTextRenderer.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+
+#if defined(__ANDROID__)
+#include "VulkanAndroid.h"
+#endif
+
+namespace vks
+{
+	static VkShaderModule loadShaderModule(VkDevice device, const std::string &fileName)
+	{
+#if defined(__ANDROID__)
+		VkShaderModule shaderModule = vks::tools::loadShader(androidApp->activity->assetManager, fileName.c_str(), device);
+#else
+		VkShaderModule shaderModule = vks::tools::loadShader(fileName.c_str(), device);
+#endif
+		assert(shaderModule != VK_NULL_HANDLE);
+		return shaderModule;
+	}
+
+	// Decodes the next code point and advances the position, invalid sequences are returned byte by byte
+	static uint32_t nextCodepoint(const char *&p, const char *end)
+	{
+		const uint8_t c = static_cast<uint8_t>(*p++);
+		if (c < 0x80) {
+			return c;
+		}
+		uint32_t length = (c >= 0xF0) ? 3 : (c >= 0xE0) ? 2 : (c >= 0xC0) ? 1 : 0;
+		if ((length == 0) || (end - p < static_cast<ptrdiff_t>(length))) {
+			return c;
+		}
+		uint32_t codepoint = c & (0x3F >> length);
+		for (uint32_t i = 0; i < length; i++) {
+			codepoint = (codepoint << 6) | (static_cast<uint8_t>(*p++) & 0x3F);
+		}
+		return codepoint;
+	}
+
+	void FontMetrics::setGlyph(uint32_t codepoint, const Glyph &glyph)
+	{
+		if (codepoint < latin1.size()) {
+			latin1[codepoint] = glyph;
+			latin1Valid[codepoint] = true;
+		} else {
+			extended[codepoint] = glyph;
+		}
+	}
+
+	const Glyph *FontMetrics::glyph(uint32_t codepoint) const
+	{
+		if (codepoint < latin1.size()) {
+			return latin1Valid[codepoint] ? &latin1[codepoint] : nullptr;
+		}
+		auto it = extended.find(codepoint);
+		return (it != extended.end()) ? &it->second : nullptr;
+	}
+
+	bool FontMetrics::loadFromFile(const std::string &filename)
+	{
+		// The whole file is read at once and parsed in place, instead of line by line through streams
+		std::vector<char> data;
+#if defined(__ANDROID__)
+		AAsset *asset = AAssetManager_open(androidApp->activity->assetManager, filename.c_str(), AASSET_MODE_BUFFER);
+		if (!asset) {
+			return false;
+		}
+		data.resize(AAsset_getLength(asset));
+		AAsset_read(asset, data.data(), data.size());
+		AAsset_close(asset);
+#else
+		std::ifstream file(filename, std::ios::binary | std::ios::ate);
+		if (!file.is_open()) {
+			return false;
+		}
+		data.resize(static_cast<size_t>(file.tellg()));
+		file.seekg(0);
+		file.read(data.data(), data.size());
+		if (!file.good()) {
+			return false;
+		}
+#endif
+		return parse(data.data(), data.size());
+	}
+
+	bool FontMetrics::parse(const char *data, size_t size)
+	{
+		if ((size >= 4) && (memcmp(data, "BMF", 3) == 0)) {
+			return parseBinary(data, size);
+		}
+		return parseText(data, size);
+	}
+
+	// Tags are followed by key=value pairs, values are integers, comma separated integer lists or quoted strings
+	bool FontMetrics::parseText(const char *data, size_t size)
+	{
+		struct Char
+		{
+			uint32_t id;
+			int32_t x, y, width, height, xoffset, yoffset, xadvance;
+		};
+		std::vector<Char> chars;
+		const char *p = data;
+		const char *end = data + size;
+		while (p < end) {
+			const char *lineEnd = static_cast<const char*>(memchr(p, '\n', end - p));
+			if (!lineEnd) {
+				lineEnd = end;
+			}
+			const char *tag = p;
+			while ((p < lineEnd) && (*p != ' ')) {
+				p++;
+			}
+			const size_t tagLength = p - tag;
+			enum { TagOther, TagInfo, TagCommon, TagChar } tagType = TagOther;
+			if ((tagLength == 4) && (memcmp(tag, "info", 4) == 0)) {
+				tagType = TagInfo;
+			} else if ((tagLength == 6) && (memcmp(tag, "common", 6) == 0)) {
+				tagType = TagCommon;
+			} else if ((tagLength == 4) && (memcmp(tag, "char", 4) == 0)) {
+				tagType = TagChar;
+			}
+			Char c{};
+			while (tagType != TagOther) {
+				while ((p < lineEnd) && ((*p == ' ') || (*p == '\r') || (*p == '\t'))) {
+					p++;
+				}
+				const char *key = p;
+				while ((p < lineEnd) && (*p != '=')) {
+					p++;
+				}
+				if (p >= lineEnd) {
+					break;
+				}
+				const std::string name(key, p - key);
+				p++;
+				if (*p == '"') {
+					const char *quoteEnd = static_cast<const char*>(memchr(p + 1, '"', lineEnd - p - 1));
+					p = quoteEnd ? quoteEnd + 1 : lineEnd;
+					continue;
+				}
+				char *valueEnd = nullptr;
+				const int32_t value = static_cast<int32_t>(strtol(p, &valueEnd, 10));
+				p = valueEnd;
+				// Skip the remaining entries of lists (e.g. padding and spacing)
+				while ((p < lineEnd) && (*p != ' ')) {
+					p++;
+				}
+				switch (tagType) {
+				case TagInfo:
+					if (name == "size") {
+						this->size = static_cast<float>(std::abs(value));
+					}
+					break;
+				case TagCommon:
+					if (name == "lineHeight") {
+						lineHeight = static_cast<float>(value);
+					} else if (name == "base") {
+						base = static_cast<float>(value);
+					} else if (name == "scaleW") {
+						atlasWidth = value;
+					} else if (name == "scaleH") {
+						atlasHeight = value;
+					}
+					break;
+				case TagChar:
+					if (name == "id") {
+						c.id = value;
+					} else if (name == "x") {
+						c.x = value;
+					} else if (name == "y") {
+						c.y = value;
+					} else if (name == "width") {
+						c.width = value;
+					} else if (name == "height") {
+						c.height = value;
+					} else if (name == "xoffset") {
+						c.xoffset = value;
+					} else if (name == "yoffset") {
+						c.yoffset = value;
+					} else if (name == "xadvance") {
+						c.xadvance = value;
+					}
+					break;
+				default:
+					break;
+				}
+			}
+			if (tagType == TagChar) {
+				chars.push_back(c);
+			}
+			p = lineEnd + 1;
+		}
+		if ((atlasWidth == 0) || (atlasHeight == 0)) {
+			return false;
+		}
+		// Atlas coordinates can only be normalized once the common block has been read
+		for (auto &c : chars) {
+			Glyph glyph;
+			glyph.uv = glm::vec4(c.x, c.y, c.x + c.width, c.y + c.height) / glm::vec4(atlasWidth, atlasHeight, atlasWidth, atlasHeight);
+			glyph.offset = glm::vec2(c.xoffset, c.yoffset);
+			glyph.size = glm::vec2(c.width, c.height);
+			glyph.advance = static_cast<float>(c.xadvance);
+			setGlyph(c.id, glyph);
+		}
+		if (this->size == 0.0f) {
+			this->size = lineHeight;
+		}
+		return true;
+	}
+
+	// See http://www.angelcode.com/products/bmfont/doc/file_format.html for the layout of the blocks
+	bool FontMetrics::parseBinary(const char *data, size_t size)
+	{
+		if (data[3] != 3) {
+			return false;
+		}
+		// All values are little endian and unaligned
+		auto read = [](const char *p, size_t bytes) -> int32_t {
+			uint32_t value = 0;
+			memcpy(&value, p, bytes);
+			if (bytes == 2) {
+				return static_cast<int16_t>(value);
+			}
+			return static_cast<int32_t>(value);
+		};
+		const char *p = data + 4;
+		const char *end = data + size;
+		bool hasCommon = false;
+		while (end - p >= 5) {
+			const uint8_t blockType = static_cast<uint8_t>(p[0]);
+			const uint32_t blockSize = static_cast<uint32_t>(read(p + 1, 4));
+			const char *block = p + 5;
+			if (static_cast<size_t>(end - block) < blockSize) {
+				return false;
+			}
+			switch (blockType) {
+			case 1:
+				if (blockSize >= 2) {
+					this->size = static_cast<float>(std::abs(read(block, 2)));
+				}
+				break;
+			case 2:
+				if (blockSize >= 8) {
+					lineHeight = static_cast<float>(read(block, 2) & 0xFFFF);
+					base = static_cast<float>(read(block + 2, 2) & 0xFFFF);
+					atlasWidth = read(block + 4, 2) & 0xFFFF;
+					atlasHeight = read(block + 6, 2) & 0xFFFF;
+					hasCommon = true;
+				}
+				break;
+			case 4:
+				if (!hasCommon || (atlasWidth == 0) || (atlasHeight == 0)) {
+					return false;
+				}
+				// 20 bytes per char: id, x, y, width, height, xoffset, yoffset, xadvance, page, channel
+				for (const char *c = block; c + 20 <= block + blockSize; c += 20) {
+					const float x = static_cast<float>(read(c + 4, 2) & 0xFFFF);
+					const float y = static_cast<float>(read(c + 6, 2) & 0xFFFF);
+					const float width = static_cast<float>(read(c + 8, 2) & 0xFFFF);
+					const float height = static_cast<float>(read(c + 10, 2) & 0xFFFF);
+					Glyph glyph;
+					glyph.uv = glm::vec4(x, y, x + width, y + height) / glm::vec4(atlasWidth, atlasHeight, atlasWidth, atlasHeight);
+					glyph.offset = glm::vec2(read(c + 12, 2), read(c + 14, 2));
+					glyph.size = glm::vec2(width, height);
+					glyph.advance = static_cast<float>(read(c + 16, 2));
+					setGlyph(static_cast<uint32_t>(read(c, 4)), glyph);
+				}
+				break;
+			default:
+				break;
+			}
+			p = block + blockSize;
+		}
+		if (this->size == 0.0f) {
+			this->size = lineHeight;
+		}
+		return hasCommon;
+	}
+
+	void TextRenderer::prepare(vks::VulkanDevice *device, VkQueue queue, VkRenderPass renderPass, uint32_t subpass, VkPipelineCache pipelineCache, const std::string &shaderPath, uint32_t frameCount)
+	{
+		this->device = device;
+		this->queue = queue;
+		this->frameCount = frameCount;
+
+		// One set with the atlas per font
+		std::vector<VkDescriptorPoolSize> poolSizes = {
+			vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, maxFonts),
+		};
+		VkDescriptorPoolCreateInfo descriptorPoolInfo = vks::initializers::descriptorPoolCreateInfo(poolSizes, maxFonts);
+		VK_CHECK_RESULT(vkCreateDescriptorPool(device->logicalDevice, &descriptorPoolInfo, nullptr, &descriptorPool));
+		std::vector<VkDescriptorSetLayoutBinding> setLayoutBindings = {
+			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_FRAGMENT_BIT, 0),
+		};
+		VkDescriptorSetLayoutCreateInfo descriptorLayout = vks::initializers::descriptorSetLayoutCreateInfo(setLayoutBindings);
+		VK_CHECK_RESULT(vkCreateDescriptorSetLayout(device->logicalDevice, &descriptorLayout, nullptr, &descriptorSetLayout));
+		VkPushConstantRange pushConstantRange = vks::initializers::pushConstantRange(VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT, sizeof(PushConstants), 0);
+		VkPipelineLayoutCreateInfo pipelineLayoutCreateInfo = vks::initializers::pipelineLayoutCreateInfo(&descriptorSetLayout, 1);
+		pipelineLayoutCreateInfo.pushConstantRangeCount = 1;
+		pipelineLayoutCreateInfo.pPushConstantRanges = &pushConstantRange;
+		VK_CHECK_RESULT(vkCreatePipelineLayout(device->logicalDevice, &pipelineLayoutCreateInfo, nullptr, &pipelineLayout));
+
+		// Glyphs are blended on top of the scene without depth testing
+		VkPipelineColorBlendAttachmentState blendAttachmentState = vks::initializers::pipelineColorBlendAttachmentState(0xf, VK_TRUE);
+		blendAttachmentState.srcColorBlendFactor = VK_BLEND_FACTOR_SRC_ALPHA;
+		blendAttachmentState.dstColorBlendFactor = VK_BLEND_FACTOR_ONE_MINUS_SRC_ALPHA;
+		blendAttachmentState.colorBlendOp = VK_BLEND_OP_ADD;
+		blendAttachmentState.srcAlphaBlendFactor = VK_BLEND_FACTOR_ONE;
+		blendAttachmentState.dstAlphaBlendFactor = VK_BLEND_FACTOR_ONE_MINUS_SRC_ALPHA;
+		blendAttachmentState.alphaBlendOp = VK_BLEND_OP_ADD;
+		VkPipelineInputAssemblyStateCreateInfo inputAssemblyState = vks::initializers::pipelineInputAssemblyStateCreateInfo(VK_PRIMITIVE_TOPOLOGY_TRIANGLE_STRIP, 0, VK_FALSE);
+		VkPipelineRasterizationStateCreateInfo rasterizationState = vks::initializers::pipelineRasterizationStateCreateInfo(VK_POLYGON_MODE_FILL, VK_CULL_MODE_NONE, VK_FRONT_FACE_COUNTER_CLOCKWISE, 0);
+		VkPipelineColorBlendStateCreateInfo colorBlendState = vks::initializers::pipelineColorBlendStateCreateInfo(1, &blendAttachmentState);
+		VkPipelineDepthStencilStateCreateInfo depthStencilState = vks::initializers::pipelineDepthStencilStateCreateInfo(VK_FALSE, VK_FALSE, VK_COMPARE_OP_ALWAYS);
+		VkPipelineViewportStateCreateInfo viewportState = vks::initializers::pipelineViewportStateCreateInfo(1, 1, 0);
+		VkPipelineMultisampleStateCreateInfo multisampleState = vks::initializers::pipelineMultisampleStateCreateInfo(VK_SAMPLE_COUNT_1_BIT, 0);
+		std::vector<VkDynamicState> dynamicStateEnables = { VK_DYNAMIC_STATE_VIEWPORT, VK_DYNAMIC_STATE_SCISSOR };
+		VkPipelineDynamicStateCreateInfo dynamicState = vks::initializers::pipelineDynamicStateCreateInfo(dynamicStateEnables);
+
+		// The quad of a glyph is generated from the vertex index, all vertex inputs are per instance
+		std::vector<VkVertexInputBindingDescription> vertexInputBindings = {
+			vks::initializers::vertexInputBindingDescription(0, sizeof(GlyphInstance), VK_VERTEX_INPUT_RATE_INSTANCE),
+		};
+		std::vector<VkVertexInputAttributeDescription> vertexInputAttributes = {
+			vks::initializers::vertexInputAttributeDescription(0, 0, VK_FORMAT_R32G32B32A32_SFLOAT, offsetof(GlyphInstance, rect)),
+			vks::initializers::vertexInputAttributeDescription(0, 1, VK_FORMAT_R32G32B32A32_SFLOAT, offsetof(GlyphInstance, uv)),
+			vks::initializers::vertexInputAttributeDescription(0, 2, VK_FORMAT_R8G8B8A8_UNORM, offsetof(GlyphInstance, color)),
+			vks::initializers::vertexInputAttributeDescription(0, 3, VK_FORMAT_R8G8B8A8_UNORM, offsetof(GlyphInstance, outlineColor)),
+		};
+		VkPipelineVertexInputStateCreateInfo vertexInputState = vks::initializers::pipelineVertexInputStateCreateInfo(vertexInputBindings, vertexInputAttributes);
+
+		std::array<VkPipelineShaderStageCreateInfo, 2> shaderStages{};
+		shaderStages[0].sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+		shaderStages[0].stage = VK_SHADER_STAGE_VERTEX_BIT;
+		shaderStages[0].module = loadShaderModule(device->logicalDevice, shaderPath + "text.vert.spv");
+		shaderStages[0].pName = "main";
+		shaderStages[1].sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+		shaderStages[1].stage = VK_SHADER_STAGE_FRAGMENT_BIT;
+		shaderStages[1].pName = "main";
+
+		VkGraphicsPipelineCreateInfo pipelineCreateInfo = vks::initializers::pipelineCreateInfo(pipelineLayout, renderPass, 0);
+		pipelineCreateInfo.subpass = subpass;
+		pipelineCreateInfo.pVertexInputState = &vertexInputState;
+		pipelineCreateInfo.pInputAssemblyState = &inputAssemblyState;
+		pipelineCreateInfo.pRasterizationState = &rasterizationState;
+		pipelineCreateInfo.pColorBlendState = &colorBlendState;
+		pipelineCreateInfo.pMultisampleState = &multisampleState;
+		pipelineCreateInfo.pViewportState = &viewportState;
+		pipelineCreateInfo.pDepthStencilState = &depthStencilState;
+		pipelineCreateInfo.pDynamicState = &dynamicState;
+		pipelineCreateInfo.stageCount = static_cast<uint32_t>(shaderStages.size());
+		pipelineCreateInfo.pStages = shaderStages.data();
+
+		const std::array<std::string, 2> fragmentShaders = { "text_bitmap.frag.spv", "text_sdf.frag.spv" };
+		for (size_t i = 0; i < fragmentShaders.size(); i++) {
+			shaderStages[1].module = loadShaderModule(device->logicalDevice, shaderPath + fragmentShaders[i]);
+			VK_CHECK_RESULT(vkCreateGraphicsPipelines(device->logicalDevice, pipelineCache, 1, &pipelineCreateInfo, nullptr, &pipelines[i]));
+			vkDestroyShaderModule(device->logicalDevice, shaderStages[1].module, nullptr);
+		}
+		vkDestroyShaderModule(device->logicalDevice, shaderStages[0].module, nullptr);
+	}
+
+	void TextRenderer::destroy()
+	{
+		if (!device) {
+			return;
+		}
+		for (auto &font : fonts) {
+			font.atlas.destroy();
+		}
+		fonts.clear();
+		fontFiles.clear();
+		instanceBuffer.destroy();
+		indirectBuffer.destroy();
+		for (auto pipeline : pipelines) {
+			vkDestroyPipeline(device->logicalDevice, pipeline, nullptr);
+		}
+		vkDestroyPipelineLayout(device->logicalDevice, pipelineLayout, nullptr);
+		vkDestroyDescriptorSetLayout(device->logicalDevice, descriptorSetLayout, nullptr);
+		vkDestroyDescriptorPool(device->logicalDevice, descriptorPool, nullptr);
+		device = nullptr;
+	}
+
+	uint32_t TextRenderer::addFont(const FontMetrics &metrics, const vks::Texture2D &atlas, AtlasType type, uint32_t capacity)
+	{
+		if (fonts.size() >= maxFonts) {
+			vks::tools::exitFatal("Text renderer supports at most " + std::to_string(maxFonts) + " fonts", -1);
+		}
+		Font font;
+		font.metrics = metrics;
+		font.atlas = atlas;
+		font.type = type;
+		font.capacity = capacity;
+		font.firstInstance = ringSize;
+		ringSize += capacity;
+
+		VkDescriptorSetAllocateInfo allocInfo = vks::initializers::descriptorSetAllocateInfo(descriptorPool, &descriptorSetLayout, 1);
+		VK_CHECK_RESULT(vkAllocateDescriptorSets(device->logicalDevice, &allocInfo, &font.descriptorSet));
+		VkWriteDescriptorSet writeDescriptorSet = vks::initializers::writeDescriptorSet(font.descriptorSet, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 0, &font.atlas.descriptor);
+		vkUpdateDescriptorSets(device->logicalDevice, 1, &writeDescriptorSet, 0, nullptr);
+
+		fonts.push_back(font);
+		buffersDirty = true;
+		return static_cast<uint32_t>(fonts.size() - 1);
+	}
+
+	uint32_t TextRenderer::addFont(const std::string &fontFile, const std::string &atlasFile, AtlasType type, uint32_t capacity)
+	{
+		const std::string key = fontFile + "|" + atlasFile;
+		auto it = fontFiles.find(key);
+		if (it != fontFiles.end()) {
+			return it->second;
+		}
+		FontMetrics metrics;
+		if (!metrics.loadFromFile(fontFile)) {
+			vks::tools::exitFatal("Could not load font \"" + fontFile + "\"", -1);
+		}
+		vks::Texture2D atlas;
+		atlas.loadFromFile(atlasFile, VK_FORMAT_R8G8B8A8_UNORM, device, queue);
+		const uint32_t index = addFont(metrics, atlas, type, capacity);
+		fontFiles[key] = index;
+		return index;
+	}
+
+	uint32_t TextRenderer::addFont(const FontMetrics &metrics, const uint8_t *pixels, AtlasType type, uint32_t capacity)
+	{
+		// Expanded to white with the coverage or distance in alpha, so all atlases are read the same way
+		std::vector<uint32_t> rgba(metrics.atlasWidth * metrics.atlasHeight);
+		for (size_t i = 0; i < rgba.size(); i++) {
+			rgba[i] = 0x00FFFFFF | (static_cast<uint32_t>(pixels[i]) << 24);
+		}
+		vks::Texture2D atlas;
+		atlas.fromBuffer(rgba.data(), rgba.size() * sizeof(uint32_t), VK_FORMAT_R8G8B8A8_UNORM, metrics.atlasWidth, metrics.atlasHeight, device, queue);
+		return addFont(metrics, atlas, type, capacity);
+	}
+
+	void TextRenderer::setOutlineWidth(uint32_t font, float width)
+	{
+		fonts[font].outlineWidth = width;
+	}
+
+	const FontMetrics &TextRenderer::metrics(uint32_t font) const
+	{
+		return fonts[font].metrics;
+	}
+
+	void TextRenderer::createBuffers()
+	{
+		instanceBuffer.destroy();
+		indirectBuffer.destroy();
+		// Written by the host every frame and read once by the GPU, so they stay in host visible memory and are mapped once
+		const VkMemoryPropertyFlags memoryFlags = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+		VK_CHECK_RESULT(device->createBuffer(VK_BUFFER_USAGE_VERTEX_BUFFER_BIT, memoryFlags, &instanceBuffer, std::max(ringSize, 1u) * frameCount * sizeof(GlyphInstance)));
+		VK_CHECK_RESULT(device->createBuffer(VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT, memoryFlags, &indirectBuffer, maxFonts * frameCount * sizeof(VkDrawIndirectCommand)));
+		VK_CHECK_RESULT(instanceBuffer.map());
+		VK_CHECK_RESULT(indirectBuffer.map());
+		instances = static_cast<GlyphInstance*>(instanceBuffer.mapped);
+		drawCommands = static_cast<VkDrawIndirectCommand*>(indirectBuffer.mapped);
+		// Nothing is drawn until a frame has been written
+		for (uint32_t i = 0; i < maxFonts * frameCount; i++) {
+			drawCommands[i] = { 4, 0, 0, 0 };
+		}
+		buffersDirty = false;
+	}
+
+	void TextRenderer::beginFrame(uint32_t frameIndex)
+	{
+		if (buffersDirty) {
+			createBuffers();
+		}
+		frameStart = std::chrono::high_resolution_clock::now();
+		currentFrame = frameIndex % frameCount;
+		for (auto &font : fonts) {
+			font.glyphCount = 0;
+		}
+		statistics.glyphs = 0;
+		statistics.droppedGlyphs = 0;
+	}
+
+	float TextRenderer::textWidth(uint32_t font, const std::string &text, float height) const
+	{
+		const FontMetrics &metrics = fonts[font].metrics;
+		float width = 0.0f;
+		const char *p = text.data();
+		const char *end = p + text.size();
+		while (p < end) {
+			const Glyph *glyph = metrics.glyph(nextCodepoint(p, end));
+			if (glyph) {
+				width += glyph->advance;
+			}
+		}
+		return width * height / metrics.size;
+	}
+
+	float TextRenderer::addText(uint32_t font, const std::string &text, float x, float y, float height, uint32_t color, Align align, uint32_t outlineColor)
+	{
+		Font &target = fonts[font];
+		const FontMetrics &metrics = target.metrics;
+		const float scale = height / metrics.size;
+		if (align != AlignLeft) {
+			const float width = textWidth(font, text, height);
+			x -= (align == AlignCenter) ? width * 0.5f : width;
+		}
+		const float start = x;
+		GlyphInstance *instance = instances + currentFrame * ringSize + target.firstInstance + target.glyphCount;
+		const uint32_t available = target.capacity - target.glyphCount;
+		uint32_t count = 0;
+		const char *p = text.data();
+		const char *end = p + text.size();
+		while (p < end) {
+			const Glyph *glyph = metrics.glyph(nextCodepoint(p, end));
+			if (!glyph) {
+				continue;
+			}
+			// Whitespace only advances the pen
+			if ((glyph->size.x > 0.0f) && (glyph->size.y > 0.0f)) {
+				if (count < available) {
+					// Written as a whole, the mapped memory may be write combined
+					GlyphInstance glyphInstance;
+					glyphInstance.rect = glm::vec4(x + glyph->offset.x * scale, y + glyph->offset.y * scale, glyph->size.x * scale, glyph->size.y * scale);
+					glyphInstance.uv = glyph->uv;
+					glyphInstance.color = color;
+					glyphInstance.outlineColor = outlineColor;
+					*instance++ = glyphInstance;
+					count++;
+				} else {
+					statistics.droppedGlyphs++;
+				}
+			}
+			x += glyph->advance * scale;
+		}
+		target.glyphCount += count;
+		statistics.glyphs += count;
+		return x - start;
+	}
+
+	void TextRenderer::endFrame()
+	{
+		for (uint32_t i = 0; i < static_cast<uint32_t>(fonts.size()); i++) {
+			VkDrawIndirectCommand &drawCommand = drawCommands[currentFrame * maxFonts + i];
+			drawCommand.vertexCount = 4;
+			drawCommand.instanceCount = fonts[i].glyphCount;
+			drawCommand.firstVertex = 0;
+			drawCommand.firstInstance = currentFrame * ringSize + fonts[i].firstInstance;
+		}
+		statistics.updateTime = std::chrono::duration<float, std::milli>(std::chrono::high_resolution_clock::now() - frameStart).count();
+	}
+
+	void TextRenderer::draw(VkCommandBuffer commandBuffer, uint32_t frameIndex, VkExtent2D viewport)
+	{
+		if (buffersDirty) {
+			createBuffers();
+		}
+		frameIndex %= frameCount;
+		PushConstants pushConstants{};
+		pushConstants.scale = glm::vec2(2.0f / viewport.width, 2.0f / viewport.height);
+		VkDeviceSize offset = 0;
+		vkCmdBindVertexBuffers(commandBuffer, 0, 1, &instanceBuffer.buffer, &offset);
+		for (uint32_t i = 0; i < static_cast<uint32_t>(fonts.size()); i++) {
+			const Font &font = fonts[i];
+			pushConstants.outlineWidth = font.outlineWidth;
+			vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelines[font.type]);
+			vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 0, 1, &font.descriptorSet, 0, nullptr);
+			vkCmdPushConstants(commandBuffer, pipelineLayout, VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT, 0, sizeof(PushConstants), &pushConstants);
+			vkCmdDrawIndirect(commandBuffer, indirectBuffer.buffer, (frameIndex * maxFonts + i) * sizeof(VkDrawIndirectCommand), 1, sizeof(VkDrawIndirectCommand));
+		}
+	}
+
+	uint32_t TextRenderer::packColor(const glm::vec4 &color)
+	{
+		const glm::uvec4 c = glm::uvec4(glm::clamp(color, glm::vec4(0.0f), glm::vec4(1.0f)) * 255.0f + 0.5f);
+		return c.r | (c.g << 8) | (c.b << 16) | (c.a << 24);
+	}
+}
@@ -0,0 +1,195 @@
+/*
+* Vulkan text renderer
+*
+* Draws text as one instance per glyph from bitmap or signed distance field font atlases. Glyph instances are written
+* straight into a persistently mapped buffer with one ring slot per frame, and the glyph counts are read by the GPU from
+* an indirect draw buffer, so command buffers are recorded once and stay valid while the text changes every frame.
+* Font metrics are read from AngelCode BMFont files in text or binary format with a single file read
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#pragma once
+
+#include <array>
+#include <chrono>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "vulkan/vulkan.h"
+#include "VulkanDevice.h"
+#include "VulkanBuffer.h"
+#include "VulkanTexture.h"
+#include "VulkanTools.h"
+
+#define GLM_FORCE_RADIANS
+#define GLM_FORCE_DEPTH_ZERO_TO_ONE
+#include <glm/glm.hpp>
+
+namespace vks
+{
+	/** @brief Atlas rectangle and placement of a glyph, offsets and sizes are in font pixels relative to the pen position at the top of the line */
+	struct Glyph
+	{
+		// s0, t0, s1, t1
+		glm::vec4 uv = glm::vec4(0.0f);
+		glm::vec2 offset = glm::vec2(0.0f);
+		glm::vec2 size = glm::vec2(0.0f);
+		float advance = 0.0f;
+	};
+
+	/** @brief Glyph metrics of a font, either parsed from a BMFont file or filled by the application */
+	class FontMetrics
+	{
+	private:
+		// Latin-1 glyphs are looked up directly, others through the map
+		std::array<Glyph, 256> latin1;
+		std::array<bool, 256> latin1Valid = {};
+		std::unordered_map<uint32_t, Glyph> extended;
+		bool parseText(const char *data, size_t size);
+		bool parseBinary(const char *data, size_t size);
+	public:
+		/** @brief Size the font was rendered at, the height text is drawn with is relative to it */
+		float size = 0.0f;
+		float lineHeight = 0.0f;
+		/** @brief Distance from the top of the line to the baseline */
+		float base = 0.0f;
+		uint32_t atlasWidth = 0;
+		uint32_t atlasHeight = 0;
+
+		void setGlyph(uint32_t codepoint, const Glyph &glyph);
+		/** @brief Returns nullptr for code points the font has no glyph for */
+		const Glyph *glyph(uint32_t codepoint) const;
+		/** @brief Loads an AngelCode BMFont file, the text and the binary (version 3) formats are detected from the header */
+		bool loadFromFile(const std::string &filename);
+		bool parse(const char *data, size_t size);
+	};
+
+	class TextRenderer
+	{
+	public:
+		enum AtlasType { AtlasBitmap = 0, AtlasSDF = 1 };
+		enum Align { AlignLeft = 0, AlignCenter = 1, AlignRight = 2 };
+
+		/** @brief Per glyph instance data, matches the vertex input of the text shaders */
+		struct GlyphInstance
+		{
+			// x, y, width, height in pixels
+			glm::vec4 rect;
+			glm::vec4 uv;
+			// RGBA8, an outline is only drawn for distance field fonts and if the alpha of its color is not zero
+			uint32_t color;
+			uint32_t outlineColor;
+		};
+
+		static const uint32_t maxFonts = 8;
+
+		struct Statistics
+		{
+			uint32_t glyphs = 0;
+			/** @brief Glyphs of the last frame that didn't fit into the capacity of their font */
+			uint32_t droppedGlyphs = 0;
+			/** @brief Host time in milliseconds from beginFrame to endFrame */
+			float updateTime = 0.0f;
+		} statistics;
+
+	private:
+		struct Font
+		{
+			FontMetrics metrics;
+			AtlasType type;
+			vks::Texture2D atlas;
+			VkDescriptorSet descriptorSet = VK_NULL_HANDLE;
+			// Instances of frame f start at f * ringSize + firstInstance
+			uint32_t firstInstance = 0;
+			uint32_t capacity = 0;
+			uint32_t glyphCount = 0;
+			float outlineWidth = 0.0f;
+		};
+
+		struct PushConstants
+		{
+			glm::vec2 scale;
+			float outlineWidth;
+			float pad;
+		};
+
+		vks::VulkanDevice *device = nullptr;
+		VkQueue queue = VK_NULL_HANDLE;
+		std::vector<Font> fonts;
+		// Fonts loaded from files are shared by everything that asks for the same file
+		std::unordered_map<std::string, uint32_t> fontFiles;
+		uint32_t frameCount = 0;
+		uint32_t ringSize = 0;
+		uint32_t currentFrame = 0;
+		bool buffersDirty = true;
+		std::chrono::high_resolution_clock::time_point frameStart;
+
+		vks::Buffer instanceBuffer;
+		vks::Buffer indirectBuffer;
+		GlyphInstance *instances = nullptr;
+		VkDrawIndirectCommand *drawCommands = nullptr;
+
+		VkDescriptorPool descriptorPool = VK_NULL_HANDLE;
+		VkDescriptorSetLayout descriptorSetLayout = VK_NULL_HANDLE;
+		VkPipelineLayout pipelineLayout = VK_NULL_HANDLE;
+		std::array<VkPipeline, 2> pipelines = {};
+
+		uint32_t addFont(const FontMetrics &metrics, const vks::Texture2D &atlas, AtlasType type, uint32_t capacity);
+		void createBuffers();
+	public:
+		/**
+		* Creates the pipelines for drawing text in a render pass, fonts are added afterwards
+		*
+		* @param device Vulkan device to create the resources on
+		* @param queue Queue atlases are uploaded with
+		* @param renderPass Render pass the text is drawn in, depth testing is disabled
+		* @param subpass Subpass of the render pass the text is drawn in
+		* @param pipelineCache Optional pipeline cache
+		* @param shaderPath Folder containing the compiled text.vert, text_bitmap.frag and text_sdf.frag shaders
+		* @param frameCount Number of frames in flight, one ring slot of glyphs is kept per frame
+		*/
+		void prepare(vks::VulkanDevice *device, VkQueue queue, VkRenderPass renderPass, uint32_t subpass, VkPipelineCache pipelineCache, const std::string &shaderPath, uint32_t frameCount);
+		void destroy();
+
+		/**
+		* Adds a font from a BMFont file and its atlas, adding the same files again returns the existing font
+		* Adding fonts recreates the glyph buffers, so command buffers with text draws have to be recorded again
+		*
+		* @param fontFile BMFont file in text or binary format
+		* @param atlasFile KTX file with the atlas in RGBA8, distance field atlases store the distance in alpha, bitmap atlases the coverage
+		* @param type Selects the shader the glyphs are drawn with
+		* @param capacity Maximum number of glyphs drawn with this font per frame
+		* @return Index of the font
+		*/
+		uint32_t addFont(const std::string &fontFile, const std::string &atlasFile, AtlasType type, uint32_t capacity);
+		/** @brief Adds a font with a single channel coverage or distance atlas of metrics.atlasWidth * metrics.atlasHeight bytes (e.g. rasterized by the application) */
+		uint32_t addFont(const FontMetrics &metrics, const uint8_t *pixels, AtlasType type, uint32_t capacity);
+		/** @brief Sets the outline width of a distance field font as a fraction of the distance range */
+		void setOutlineWidth(uint32_t font, float width);
+		const FontMetrics &metrics(uint32_t font) const;
+
+		/** @brief Starts writing the glyphs of a frame into its ring slot, the GPU must have finished the previous use of the slot */
+		void beginFrame(uint32_t frameIndex);
+		/**
+		* Appends the glyphs of a line of text to the current frame
+		*
+		* @param text UTF-8 encoded text, code points the font has no glyph for are skipped
+		* @param x Horizontal pen position in pixels, the left, center or right of the text depending on the alignment
+		* @param y Top of the line in pixels
+		* @param height Line height in pixels, the font is scaled relative to the size it was rendered at
+		* @return Width of the text in pixels
+		*/
+		float addText(uint32_t font, const std::string &text, float x, float y, float height, uint32_t color, Align align = AlignLeft, uint32_t outlineColor = 0);
+		/** @brief Width of the text in pixels if drawn with the given line height */
+		float textWidth(uint32_t font, const std::string &text, float height) const;
+		/** @brief Publishes the glyph counts of the current frame to the indirect draws */
+		void endFrame();
+
+		/** @brief Records the draws of a frame, only needs to be recorded again if fonts are added or the viewport changes */
+		void draw(VkCommandBuffer commandBuffer, uint32_t frameIndex, VkExtent2D viewport);
+
+		static uint32_t packColor(const glm::vec4 &color);
+	};
+}
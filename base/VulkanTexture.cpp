@@ -7,6 +7,14 @@
 */
 
 #include <VulkanTexture.h>
+#include "VulkanKTX2.h"
+
+#include <memory>
+#include <mutex>
+#include <condition_variable>
+#include <array>
+#include <chrono>
+#include "threadpool.hpp"
 
 namespace vks
 {
@@ -52,11 +60,329 @@ namespace vks
 		return result;
 	}
 
+	VkDeviceSize Texture::streamingStagingSize = 16 * 1024 * 1024;
+	VkDeviceSize Texture::streamingDecodeBudget = 64 * 1024 * 1024;
+
+	// Texel block dimensions of the block compressed formats (uncompressed formats use 1x1 blocks)
+	static void getFormatBlockExtent(VkFormat format, uint32_t &blockWidth, uint32_t &blockHeight)
+	{
+		blockWidth = blockHeight = 1;
+		if (((format >= VK_FORMAT_BC1_RGB_UNORM_BLOCK) && (format <= VK_FORMAT_BC7_SRGB_BLOCK)) || ((format >= VK_FORMAT_ETC2_R8G8B8_UNORM_BLOCK) && (format <= VK_FORMAT_EAC_R11G11_SNORM_BLOCK))) {
+			blockWidth = blockHeight = 4;
+		}
+		if ((format >= VK_FORMAT_ASTC_4x4_UNORM_BLOCK) && (format <= VK_FORMAT_ASTC_12x12_SRGB_BLOCK)) {
+			// ASTC formats come in UNORM/SRGB pairs ordered by block size
+			static const uint32_t astcBlockExtents[14][2] = {
+				{ 4, 4 }, { 5, 4 }, { 5, 5 }, { 6, 5 }, { 6, 6 }, { 8, 5 }, { 8, 6 }, { 8, 8 }, { 10, 5 }, { 10, 6 }, { 10, 8 }, { 10, 10 }, { 12, 10 }, { 12, 12 }
+			};
+			const uint32_t index = (format - VK_FORMAT_ASTC_4x4_UNORM_BLOCK) / 2;
+			blockWidth = astcBlockExtents[index][0];
+			blockHeight = astcBlockExtents[index][1];
+		}
+	}
+
+	/**
+	* Load a KTX2 texture including all mip levels, array layers and cube faces
+	*
+	* Levels are uploaded in rows of texel blocks through two alternating halves of a fixed size staging buffer, which keeps
+	* the host visible memory needed at streamingStagingSize regardless of the texture's size. Uncompressed levels are read
+	* from the file straight into the staging buffer. Zstd supercompressed levels are read and decoded on worker threads
+	* ahead of the upload, as long as the payloads and decoded data in flight fit into streamingDecodeBudget (a single level
+	* larger than the budget is still decoded on its own, as Zstd payloads can only be expanded as a whole)
+	* Basis Universal payloads are not supported, they have to be transcoded to a block compressed format offline
+	*
+	* @param filename File to load
+	* @param device Vulkan device to create the texture on
+	* @param copyQueue Queue used for the texture staging copy commands (must support transfer)
+	* @param imageUsageFlags Usage flags for the texture's image
+	* @param imageLayout Usage layout for the texture
+	* @param viewType Type of the image view to create (2D, 2D array or cube)
+	*/
+	void Texture::loadKTX2File(std::string filename, vks::VulkanDevice *device, VkQueue copyQueue, VkImageUsageFlags imageUsageFlags, VkImageLayout imageLayout, VkImageViewType viewType)
+	{
+		ktx2::File file;
+		if (!file.open(filename)) {
+			vks::tools::exitFatal("Could not load texture from " + filename + "\n\nThe file may be part of the additional asset pack.\n\nRun \"download_assets.py\" in the repository root to download the latest version.", -1);
+		}
+		if ((file.header.supercompressionScheme == ktx2::SupercompressionBasisLZ) || (file.header.vkFormat == VK_FORMAT_UNDEFINED)) {
+			vks::tools::exitFatal(filename + " contains a Basis Universal payload, which is not supported (transcode it offline, e.g. with \"ktx transcode\")", -1);
+		}
+		if (!file.supercompressionSupported()) {
+			vks::tools::exitFatal(filename + " uses KTX2 supercompression scheme " + std::to_string(file.header.supercompressionScheme) + ", which is not supported by this build (Zstd requires USE_KTX2_ZSTD)", -1);
+		}
+		if (file.header.pixelDepth > 1) {
+			vks::tools::exitFatal("3D textures are not supported (" + filename + ")", -1);
+		}
+		if ((viewType == VK_IMAGE_VIEW_TYPE_CUBE) && (file.header.faceCount != 6)) {
+			vks::tools::exitFatal(filename + " does not contain a cube map", -1);
+		}
+
+		const VkFormat format = static_cast<VkFormat>(file.header.vkFormat);
+		VkFormatProperties formatProperties;
+		vkGetPhysicalDeviceFormatProperties(device->physicalDevice, format, &formatProperties);
+		if (!(formatProperties.optimalTilingFeatures & VK_FORMAT_FEATURE_SAMPLED_IMAGE_BIT)) {
+			vks::tools::exitFatal("The device does not support sampling from VkFormat " + std::to_string(format) + " used by " + filename, -1);
+		}
+
+		this->device = device;
+		width = file.header.pixelWidth;
+		height = std::max(file.header.pixelHeight, 1u);
+		mipLevels = static_cast<uint32_t>(file.levels.size());
+		layerCount = file.imageLayerCount();
+		loadStatistics = {};
+		loadStatistics.diskBytes = file.fileSize;
+
+		// Create optimal tiled target image
+		VkImageCreateInfo imageCreateInfo = vks::initializers::imageCreateInfo();
+		imageCreateInfo.imageType = VK_IMAGE_TYPE_2D;
+		imageCreateInfo.format = format;
+		imageCreateInfo.mipLevels = mipLevels;
+		imageCreateInfo.arrayLayers = layerCount;
+		imageCreateInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+		imageCreateInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+		imageCreateInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+		imageCreateInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+		imageCreateInfo.extent = { width, height, 1 };
+		imageCreateInfo.usage = imageUsageFlags | VK_IMAGE_USAGE_TRANSFER_DST_BIT;
+		if (file.header.faceCount == 6) {
+			imageCreateInfo.flags = VK_IMAGE_CREATE_CUBE_COMPATIBLE_BIT;
+		}
+		VK_CHECK_RESULT(vkCreateImage(device->logicalDevice, &imageCreateInfo, nullptr, &image));
+
+		VkMemoryRequirements memReqs;
+		vkGetImageMemoryRequirements(device->logicalDevice, image, &memReqs);
+		VkMemoryAllocateInfo memAllocInfo = vks::initializers::memoryAllocateInfo();
+		memAllocInfo.allocationSize = memReqs.size;
+		memAllocInfo.memoryTypeIndex = device->getMemoryType(memReqs.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+		VK_CHECK_RESULT(vkAllocateMemory(device->logicalDevice, &memAllocInfo, nullptr, &deviceMemory));
+		VK_CHECK_RESULT(vkBindImageMemory(device->logicalDevice, image, deviceMemory, 0));
+		loadStatistics.vramBytes = memReqs.size;
+
+		// Supercompressed levels are decoded on worker threads, reads are issued ahead of the upload within the decode budget
+		const bool supercompressed = (file.header.supercompressionScheme != ktx2::SupercompressionNone);
+		enum LevelState : uint8_t { LevelPending, LevelReady, LevelFailed };
+		std::vector<std::vector<uint8_t>> payloads(mipLevels);
+		std::vector<std::vector<uint8_t>> levelData(mipLevels);
+		std::vector<LevelState> levelStates(mipLevels, LevelPending);
+		std::mutex levelMutex;
+		std::condition_variable levelCondition;
+		double transcodeTime = 0.0;
+		uint32_t nextRead = 0;
+		VkDeviceSize bytesInFlight = 0;
+
+		vks::ThreadPool threadPool;
+		const uint32_t threadCount = supercompressed ? std::max(1u, std::min(std::thread::hardware_concurrency(), mipLevels)) : 0;
+		threadPool.setThreadCount(threadCount);
+
+		auto levelHostBytes = [&](uint32_t level) {
+			return file.levels[level].byteLength + file.levels[level].uncompressedByteLength;
+		};
+
+		// Reads and dispatches the levels following the one about to be uploaded, that one is always read even if it exceeds the budget
+		auto readAhead = [&](uint32_t uploadLevel) {
+			while ((nextRead < mipLevels) && ((nextRead <= uploadLevel) || (bytesInFlight + levelHostBytes(nextRead) <= streamingDecodeBudget))) {
+				const uint32_t level = nextRead++;
+				bytesInFlight += levelHostBytes(level);
+				// The file stream is not thread-safe, so payloads are read here and only decoded in parallel
+				file.readLevel(level, payloads[level]);
+				threadPool.threads[level % threadCount]->addJob([&, level] {
+					auto tStart = std::chrono::high_resolution_clock::now();
+					std::vector<uint8_t> decoded;
+					const bool success = file.decodeLevel(level, payloads[level], decoded);
+					const double tDecode = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - tStart).count();
+					std::lock_guard<std::mutex> lock(levelMutex);
+					levelData[level].swap(decoded);
+					levelStates[level] = success ? LevelReady : LevelFailed;
+					transcodeTime += tDecode;
+					levelCondition.notify_all();
+				});
+			}
+		};
+
+		// Each staging half must at least fit a single row of texel blocks of the largest level
+		uint32_t blockWidth, blockHeight;
+		getFormatBlockExtent(format, blockWidth, blockHeight);
+		VkDeviceSize maxRowSize = 0;
+		for (uint32_t level = 0; level < mipLevels; level++) {
+			const uint32_t blockRows = (std::max(1u, height >> level) + blockHeight - 1) / blockHeight;
+			maxRowSize = std::max(maxRowSize, file.levels[level].uncompressedByteLength / layerCount / blockRows);
+		}
+		const VkDeviceSize slotSize = vks::tools::alignedVkSize(std::max(streamingStagingSize / 2, maxRowSize), 16);
+
+		vks::Buffer stagingBuffer;
+		VK_CHECK_RESULT(device->createBuffer(VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, &stagingBuffer, slotSize * 2));
+		VK_CHECK_RESULT(stagingBuffer.map());
+
+		struct StagingSlot {
+			VkCommandBuffer commandBuffer;
+			VkFence fence;
+			VkDeviceSize offset;
+			VkDeviceSize used = 0;
+			std::vector<VkBufferImageCopy> copyRegions;
+			bool submitted = false;
+		};
+		std::array<StagingSlot, 2> slots;
+		for (uint32_t i = 0; i < 2; i++) {
+			slots[i].commandBuffer = device->createCommandBuffer(VK_COMMAND_BUFFER_LEVEL_PRIMARY, false);
+			VkFenceCreateInfo fenceInfo = vks::initializers::fenceCreateInfo();
+			VK_CHECK_RESULT(vkCreateFence(device->logicalDevice, &fenceInfo, nullptr, &slots[i].fence));
+			slots[i].offset = slotSize * i;
+		}
+
+		VkImageSubresourceRange subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, 0, mipLevels, 0, layerCount };
+		uint32_t currentSlot = 0;
+
+		auto beginSlot = [&](StagingSlot &slot) {
+			if (slot.submitted) {
+				// Wait until the copies reading from this half have finished before refilling it
+				VK_CHECK_RESULT(vkWaitForFences(device->logicalDevice, 1, &slot.fence, VK_TRUE, DEFAULT_FENCE_TIMEOUT));
+				VK_CHECK_RESULT(vkResetFences(device->logicalDevice, 1, &slot.fence));
+				slot.submitted = false;
+			}
+			VkCommandBufferBeginInfo cmdBufInfo = vks::initializers::commandBufferBeginInfo();
+			VK_CHECK_RESULT(vkBeginCommandBuffer(slot.commandBuffer, &cmdBufInfo));
+			slot.used = 0;
+			slot.copyRegions.clear();
+		};
+
+		auto submitSlot = [&](StagingSlot &slot, bool last) {
+			if (!slot.copyRegions.empty()) {
+				vkCmdCopyBufferToImage(slot.commandBuffer, stagingBuffer.buffer, image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, static_cast<uint32_t>(slot.copyRegions.size()), slot.copyRegions.data());
+			}
+			if (last) {
+				// Submissions to the same queue execute in order, so this also covers copies recorded into the other half
+				vks::tools::setImageLayout(slot.commandBuffer, image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, imageLayout, subresourceRange);
+			}
+			VK_CHECK_RESULT(vkEndCommandBuffer(slot.commandBuffer));
+			VkSubmitInfo submitInfo = vks::initializers::submitInfo();
+			submitInfo.commandBufferCount = 1;
+			submitInfo.pCommandBuffers = &slot.commandBuffer;
+			VK_CHECK_RESULT(vkQueueSubmit(copyQueue, 1, &submitInfo, slot.fence));
+			slot.submitted = true;
+		};
+
+		beginSlot(slots[currentSlot]);
+		vks::tools::setImageLayout(slots[currentSlot].commandBuffer, image, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, subresourceRange);
+
+		for (uint32_t level = 0; level < mipLevels; level++) {
+			const uint8_t *data = nullptr;
+			if (supercompressed) {
+				readAhead(level);
+				std::unique_lock<std::mutex> lock(levelMutex);
+				levelCondition.wait(lock, [&] { return levelStates[level] != LevelPending; });
+				if (levelStates[level] == LevelFailed) {
+					vks::tools::exitFatal("Could not decode mip level " + std::to_string(level) + " of " + filename, -1);
+				}
+				data = levelData[level].data();
+			}
+			else if (file.levels[level].byteLength != file.levels[level].uncompressedByteLength) {
+				vks::tools::exitFatal("Mip level " + std::to_string(level) + " of " + filename + " has an invalid size", -1);
+			}
+			const uint32_t levelWidth = std::max(1u, width >> level);
+			const uint32_t levelHeight = std::max(1u, height >> level);
+			const uint32_t blocksPerRow = (levelWidth + blockWidth - 1) / blockWidth;
+			const uint32_t blockRows = (levelHeight + blockHeight - 1) / blockHeight;
+			const VkDeviceSize layerSize = file.levels[level].uncompressedByteLength / layerCount;
+			const VkDeviceSize rowSize = layerSize / blockRows;
+			// Buffer offsets must be a multiple of both four and the texel block size
+			const VkDeviceSize blockSize = rowSize / blocksPerRow;
+			VkDeviceSize offsetAlignment = blockSize;
+			while (offsetAlignment % 4 != 0) {
+				offsetAlignment += blockSize;
+			}
+
+			for (uint32_t layer = 0; layer < layerCount; layer++) {
+				uint32_t row = 0;
+				while (row < blockRows) {
+					StagingSlot &slot = slots[currentSlot];
+					const VkDeviceSize offset = ((slot.used + offsetAlignment - 1) / offsetAlignment) * offsetAlignment;
+					const uint32_t rowCount = static_cast<uint32_t>(std::min<VkDeviceSize>(blockRows - row, offset < slotSize ? (slotSize - offset) / rowSize : 0));
+					if (rowCount == 0) {
+						// This half is full, hand it to the GPU and continue with the other one
+						submitSlot(slot, false);
+						currentSlot = (currentSlot + 1) % 2;
+						beginSlot(slots[currentSlot]);
+						continue;
+					}
+					uint8_t *target = static_cast<uint8_t*>(stagingBuffer.mapped) + slot.offset + offset;
+					const VkDeviceSize sourceOffset = layer * layerSize + row * rowSize;
+					if (data) {
+						memcpy(target, data + sourceOffset, rowCount * rowSize);
+					}
+					else if (!file.readLevelRange(level, sourceOffset, rowCount * rowSize, target)) {
+						vks::tools::exitFatal("Could not read mip level " + std::to_string(level) + " of " + filename, -1);
+					}
+
+					VkBufferImageCopy bufferCopyRegion = {};
+					bufferCopyRegion.bufferOffset = slot.offset + offset;
+					bufferCopyRegion.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+					bufferCopyRegion.imageSubresource.mipLevel = level;
+					bufferCopyRegion.imageSubresource.baseArrayLayer = layer;
+					bufferCopyRegion.imageSubresource.layerCount = 1;
+					bufferCopyRegion.imageOffset = { 0, static_cast<int32_t>(row * blockHeight), 0 };
+					bufferCopyRegion.imageExtent.width = levelWidth;
+					bufferCopyRegion.imageExtent.height = std::min((row + rowCount) * blockHeight, levelHeight) - row * blockHeight;
+					bufferCopyRegion.imageExtent.depth = 1;
+					slot.copyRegions.push_back(bufferCopyRegion);
+
+					slot.used = offset + rowCount * rowSize;
+					row += rowCount;
+				}
+			}
+			// Level data is no longer needed once it has been copied to the staging buffer
+			if (supercompressed) {
+				std::lock_guard<std::mutex> lock(levelMutex);
+				std::vector<uint8_t>().swap(levelData[level]);
+				bytesInFlight -= levelHostBytes(level);
+			}
+		}
+
+		this->imageLayout = imageLayout;
+		submitSlot(slots[currentSlot], true);
+		for (auto &slot : slots) {
+			if (slot.submitted) {
+				VK_CHECK_RESULT(vkWaitForFences(device->logicalDevice, 1, &slot.fence, VK_TRUE, DEFAULT_FENCE_TIMEOUT));
+			}
+			vkDestroyFence(device->logicalDevice, slot.fence, nullptr);
+			vkFreeCommandBuffers(device->logicalDevice, device->commandPool, 1, &slot.commandBuffer);
+		}
+		stagingBuffer.destroy();
+		loadStatistics.transcodeTime = transcodeTime;
+
+		// Create a default sampler
+		VkSamplerCreateInfo samplerCreateInfo = vks::initializers::samplerCreateInfo();
+		samplerCreateInfo.magFilter = VK_FILTER_LINEAR;
+		samplerCreateInfo.minFilter = VK_FILTER_LINEAR;
+		samplerCreateInfo.mipmapMode = VK_SAMPLER_MIPMAP_MODE_LINEAR;
+		samplerCreateInfo.addressModeU = (viewType == VK_IMAGE_VIEW_TYPE_CUBE) ? VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE : VK_SAMPLER_ADDRESS_MODE_REPEAT;
+		samplerCreateInfo.addressModeV = samplerCreateInfo.addressModeU;
+		samplerCreateInfo.addressModeW = samplerCreateInfo.addressModeU;
+		samplerCreateInfo.mipLodBias = 0.0f;
+		samplerCreateInfo.compareOp = VK_COMPARE_OP_NEVER;
+		samplerCreateInfo.minLod = 0.0f;
+		samplerCreateInfo.maxLod = (float)mipLevels;
+		samplerCreateInfo.maxAnisotropy = device->enabledFeatures.samplerAnisotropy ? device->properties.limits.maxSamplerAnisotropy : 1.0f;
+		samplerCreateInfo.anisotropyEnable = device->enabledFeatures.samplerAnisotropy;
+		samplerCreateInfo.borderColor = VK_BORDER_COLOR_FLOAT_OPAQUE_WHITE;
+		VK_CHECK_RESULT(vkCreateSampler(device->logicalDevice, &samplerCreateInfo, nullptr, &sampler));
+
+		// Create image view
+		VkImageViewCreateInfo viewCreateInfo = vks::initializers::imageViewCreateInfo();
+		viewCreateInfo.viewType = viewType;
+		viewCreateInfo.format = format;
+		viewCreateInfo.subresourceRange = subresourceRange;
+		viewCreateInfo.image = image;
+		VK_CHECK_RESULT(vkCreateImageView(device->logicalDevice, &viewCreateInfo, nullptr, &view));
+
+		// Update descriptor image info member that can be used for setting up descriptor sets
+		updateDescriptor();
+	}
+
 	/**
 	* Load a 2D texture including all mip levels
 	*
-	* @param filename File to load (supports .ktx)
-	* @param format Vulkan format of the image data stored in the file
+	* @param filename File to load (supports .ktx and .ktx2)
+	* @param format Vulkan format of the image data stored in the file (ignored for .ktx2, which stores its format)
 	* @param device Vulkan device to create the texture on
 	* @param copyQueue Queue used for the texture staging copy commands (must support transfer)
 	* @param (Optional) imageUsageFlags Usage flags for the texture's image (defaults to VK_IMAGE_USAGE_SAMPLED_BIT)
@@ -66,6 +392,13 @@ namespace vks
 	*/
 	void Texture2D::loadFromFile(std::string filename, VkFormat format, vks::VulkanDevice *device, VkQueue copyQueue, VkImageUsageFlags imageUsageFlags, VkImageLayout imageLayout, bool forceLinear)
 	{
+#if !defined(__ANDROID__)
+		if (ktx2::isKTX2File(filename)) {
+			loadKTX2File(filename, device, copyQueue, imageUsageFlags, imageLayout, VK_IMAGE_VIEW_TYPE_2D);
+			return;
+		}
+#endif
+
 		ktxTexture* ktxTexture;
 		ktxResult result = loadKTXFile(filename, &ktxTexture);
 		assert(result == KTX_SUCCESS);
@@ -77,6 +410,8 @@ namespace vks
 
 		ktx_uint8_t *ktxTextureData = ktxTexture_GetData(ktxTexture);
 		ktx_size_t ktxTextureSize = ktxTexture_GetSize(ktxTexture);
+		loadStatistics = {};
+		loadStatistics.diskBytes = ktxTextureSize;
 
 		// Get device properties for the requested texture format
 		VkFormatProperties formatProperties;
@@ -169,6 +504,7 @@ namespace vks
 			vkGetImageMemoryRequirements(device->logicalDevice, image, &memReqs);
 
 			memAllocInfo.allocationSize = memReqs.size;
+			loadStatistics.vramBytes = memReqs.size;
 
 			memAllocInfo.memoryTypeIndex = device->getMemoryType(memReqs.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
 			VK_CHECK_RESULT(vkAllocateMemory(device->logicalDevice, &memAllocInfo, nullptr, &deviceMemory));
@@ -246,6 +582,7 @@ namespace vks
 			vkGetImageMemoryRequirements(device->logicalDevice, mappableImage, &memReqs);
 			// Set memory allocation size to required memory size
 			memAllocInfo.allocationSize = memReqs.size;
+			loadStatistics.vramBytes = memReqs.size;
 
 			// Get memory type that can be mapped to host memory
 			memAllocInfo.memoryTypeIndex = device->getMemoryType(memReqs.memoryTypeBits, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
@@ -343,8 +680,10 @@ namespace vks
 	* @param (Optional) filter Texture filtering for the sampler (defaults to VK_FILTER_LINEAR)
 	* @param (Optional) imageUsageFlags Usage flags for the texture's image (defaults to VK_IMAGE_USAGE_SAMPLED_BIT)
 	* @param (Optional) imageLayout Usage layout for the texture (defaults VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL)
+	* @param (Optional) mipGenerator Generates a full mip chain from the buffer's data if set and the format is supported (defaults to nullptr)
+	* @param (Optional) mipFilter Filter used for mip generation (defaults to vks::MipGenerator::FilterLinear)
 	*/
-	void Texture2D::fromBuffer(void* buffer, VkDeviceSize bufferSize, VkFormat format, uint32_t texWidth, uint32_t texHeight, vks::VulkanDevice *device, VkQueue copyQueue, VkFilter filter, VkImageUsageFlags imageUsageFlags, VkImageLayout imageLayout)
+	void Texture2D::fromBuffer(void* buffer, VkDeviceSize bufferSize, VkFormat format, uint32_t texWidth, uint32_t texHeight, vks::VulkanDevice *device, VkQueue copyQueue, VkFilter filter, VkImageUsageFlags imageUsageFlags, VkImageLayout imageLayout, vks::MipGenerator *mipGenerator, vks::MipGenerator::Filter mipFilter)
 	{
 		assert(buffer);
 
@@ -353,6 +692,12 @@ namespace vks
 		height = texHeight;
 		mipLevels = 1;
 
+		const uint32_t fullMipLevels = static_cast<uint32_t>(floor(log2(std::max(width, height))) + 1.0);
+		const bool generateMips = mipGenerator && mipGenerator->supported(format, width, height, fullMipLevels);
+		if (generateMips) {
+			mipLevels = fullMipLevels;
+		}
+
 		VkMemoryAllocateInfo memAllocInfo = vks::initializers::memoryAllocateInfo();
 		VkMemoryRequirements memReqs;
 
@@ -414,11 +759,18 @@ namespace vks
 		{
 			imageCreateInfo.usage |= VK_IMAGE_USAGE_TRANSFER_DST_BIT;
 		}
+		// Mip levels are written by a compute shader
+		if (generateMips)
+		{
+			imageCreateInfo.usage |= VK_IMAGE_USAGE_STORAGE_BIT;
+			imageCreateInfo.flags |= vks::MipGenerator::imageCreateFlags(format);
+		}
 		VK_CHECK_RESULT(vkCreateImage(device->logicalDevice, &imageCreateInfo, nullptr, &image));
 
 		vkGetImageMemoryRequirements(device->logicalDevice, image, &memReqs);
 
 		memAllocInfo.allocationSize = memReqs.size;
+		loadStatistics.vramBytes = memReqs.size;
 
 		memAllocInfo.memoryTypeIndex = device->getMemoryType(memReqs.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
 		VK_CHECK_RESULT(vkAllocateMemory(device->logicalDevice, &memAllocInfo, nullptr, &deviceMemory));
@@ -427,7 +779,7 @@ namespace vks
 		VkImageSubresourceRange subresourceRange = {};
 		subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
 		subresourceRange.baseMipLevel = 0;
-		subresourceRange.levelCount = mipLevels;
+		subresourceRange.levelCount = 1;
 		subresourceRange.layerCount = 1;
 
 		// Image barrier for optimal image (target)
@@ -450,13 +802,17 @@ namespace vks
 		);
 
 		// Change texture image layout to shader read after all mip levels have been copied
+		// With mip generation, the generator transitions all levels once they have been written
 		this->imageLayout = imageLayout;
-		vks::tools::setImageLayout(
-			copyCmd,
-			image,
-			VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
-			imageLayout,
-			subresourceRange);
+		if (!generateMips)
+		{
+			vks::tools::setImageLayout(
+				copyCmd,
+				image,
+				VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+				imageLayout,
+				subresourceRange);
+		}
 
 		device->flushCommandBuffer(copyCmd, copyQueue);
 
@@ -464,6 +820,11 @@ namespace vks
 		vkFreeMemory(device->logicalDevice, stagingMemory, nullptr);
 		vkDestroyBuffer(device->logicalDevice, stagingBuffer, nullptr);
 
+		if (generateMips)
+		{
+			mipGenerator->generate(image, format, width, height, mipLevels, mipFilter, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, imageLayout);
+		}
+
 		// Create sampler
 		VkSamplerCreateInfo samplerCreateInfo = {};
 		samplerCreateInfo.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
@@ -476,7 +837,7 @@ namespace vks
 		samplerCreateInfo.mipLodBias = 0.0f;
 		samplerCreateInfo.compareOp = VK_COMPARE_OP_NEVER;
 		samplerCreateInfo.minLod = 0.0f;
-		samplerCreateInfo.maxLod = 0.0f;
+		samplerCreateInfo.maxLod = (float)(mipLevels - 1);
 		samplerCreateInfo.maxAnisotropy = 1.0f;
 		VK_CHECK_RESULT(vkCreateSampler(device->logicalDevice, &samplerCreateInfo, nullptr, &sampler));
 
@@ -487,7 +848,7 @@ namespace vks
 		viewCreateInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
 		viewCreateInfo.format = format;
 		viewCreateInfo.subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1 };
-		viewCreateInfo.subresourceRange.levelCount = 1;
+		viewCreateInfo.subresourceRange.levelCount = mipLevels;
 		viewCreateInfo.image = image;
 		VK_CHECK_RESULT(vkCreateImageView(device->logicalDevice, &viewCreateInfo, nullptr, &view));
 
@@ -498,8 +859,8 @@ namespace vks
 	/**
 	* Load a 2D texture array including all mip levels
 	*
-	* @param filename File to load (supports .ktx)
-	* @param format Vulkan format of the image data stored in the file
+	* @param filename File to load (supports .ktx and .ktx2)
+	* @param format Vulkan format of the image data stored in the file (ignored for .ktx2, which stores its format)
 	* @param device Vulkan device to create the texture on
 	* @param copyQueue Queue used for the texture staging copy commands (must support transfer)
 	* @param (Optional) imageUsageFlags Usage flags for the texture's image (defaults to VK_IMAGE_USAGE_SAMPLED_BIT)
@@ -508,6 +869,13 @@ namespace vks
 	*/
 	void Texture2DArray::loadFromFile(std::string filename, VkFormat format, vks::VulkanDevice *device, VkQueue copyQueue, VkImageUsageFlags imageUsageFlags, VkImageLayout imageLayout)
 	{
+#if !defined(__ANDROID__)
+		if (ktx2::isKTX2File(filename)) {
+			loadKTX2File(filename, device, copyQueue, imageUsageFlags, imageLayout, VK_IMAGE_VIEW_TYPE_2D_ARRAY);
+			return;
+		}
+#endif
+
 		ktxTexture* ktxTexture;
 		ktxResult result = loadKTXFile(filename, &ktxTexture);
 		assert(result == KTX_SUCCESS);
@@ -520,6 +888,8 @@ namespace vks
 
 		ktx_uint8_t *ktxTextureData = ktxTexture_GetData(ktxTexture);
 		ktx_size_t ktxTextureSize = ktxTexture_GetSize(ktxTexture);
+		loadStatistics = {};
+		loadStatistics.diskBytes = ktxTextureSize;
 
 		VkMemoryAllocateInfo memAllocInfo = vks::initializers::memoryAllocateInfo();
 		VkMemoryRequirements memReqs;
@@ -600,6 +970,7 @@ namespace vks
 		vkGetImageMemoryRequirements(device->logicalDevice, image, &memReqs);
 
 		memAllocInfo.allocationSize = memReqs.size;
+		loadStatistics.vramBytes = memReqs.size;
 		memAllocInfo.memoryTypeIndex = device->getMemoryType(memReqs.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
 
 		VK_CHECK_RESULT(vkAllocateMemory(device->logicalDevice, &memAllocInfo, nullptr, &deviceMemory));
@@ -682,8 +1053,8 @@ namespace vks
 	/**
 	* Load a cubemap texture including all mip levels from a single file
 	*
-	* @param filename File to load (supports .ktx)
-	* @param format Vulkan format of the image data stored in the file
+	* @param filename File to load (supports .ktx and .ktx2)
+	* @param format Vulkan format of the image data stored in the file (ignored for .ktx2, which stores its format)
 	* @param device Vulkan device to create the texture on
 	* @param copyQueue Queue used for the texture staging copy commands (must support transfer)
 	* @param (Optional) imageUsageFlags Usage flags for the texture's image (defaults to VK_IMAGE_USAGE_SAMPLED_BIT)
@@ -692,6 +1063,13 @@ namespace vks
 	*/
 	void TextureCubeMap::loadFromFile(std::string filename, VkFormat format, vks::VulkanDevice *device, VkQueue copyQueue, VkImageUsageFlags imageUsageFlags, VkImageLayout imageLayout)
 	{
+#if !defined(__ANDROID__)
+		if (ktx2::isKTX2File(filename)) {
+			loadKTX2File(filename, device, copyQueue, imageUsageFlags, imageLayout, VK_IMAGE_VIEW_TYPE_CUBE);
+			return;
+		}
+#endif
+
 		ktxTexture* ktxTexture;
 		ktxResult result = loadKTXFile(filename, &ktxTexture);
 		assert(result == KTX_SUCCESS);
@@ -703,6 +1081,8 @@ namespace vks
 
 		ktx_uint8_t *ktxTextureData = ktxTexture_GetData(ktxTexture);
 		ktx_size_t ktxTextureSize = ktxTexture_GetSize(ktxTexture);
+		loadStatistics = {};
+		loadStatistics.diskBytes = ktxTextureSize;
 
 		VkMemoryAllocateInfo memAllocInfo = vks::initializers::memoryAllocateInfo();
 		VkMemoryRequirements memReqs;
@@ -787,6 +1167,7 @@ namespace vks
 		vkGetImageMemoryRequirements(device->logicalDevice, image, &memReqs);
 
 		memAllocInfo.allocationSize = memReqs.size;
+		loadStatistics.vramBytes = memReqs.size;
 		memAllocInfo.memoryTypeIndex = device->getMemoryType(memReqs.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
 
 		VK_CHECK_RESULT(vkAllocateMemory(device->logicalDevice, &memAllocInfo, nullptr, &deviceMemory));
@@ -20,6 +20,7 @@
 
 #include "VulkanBuffer.h"
 #include "VulkanDevice.h"
+#include "VulkanMipGenerator.h"
 #include "VulkanTools.h"
 
 #if defined(__ANDROID__)
@@ -42,9 +43,36 @@ class Texture
 	VkDescriptorImageInfo descriptor;
 	VkSampler             sampler;
 
+	/** @brief Figures gathered while loading the texture from a file */
+	struct LoadStatistics
+	{
+		VkDeviceSize diskBytes     = 0;
+		VkDeviceSize vramBytes     = 0;
+		double       transcodeTime = 0.0;
+	} loadStatistics;
+
+	/** @brief Host visible memory used to stream KTX2 mip levels to the device, split into two alternating halves */
+	static VkDeviceSize streamingStagingSize;
+	/** @brief Host memory for supercompressed KTX2 levels that are read and decoded ahead of their upload */
+	static VkDeviceSize streamingDecodeBudget;
+
 	void      updateDescriptor();
 	void      destroy();
 	ktxResult loadKTXFile(std::string filename, ktxTexture **target);
+
+  protected:
+	/**
+	* Stream a KTX2 file level by level into a new image
+	* Only payloads in a Vulkan format are loaded (uncompressed, or Zstd with USE_KTX2_ZSTD), there is no Basis Universal transcoder,
+	* so ETC1S/UASTC files have to be transcoded offline to a format the device samples from (e.g. with "ktx transcode")
+	*/
+	void loadKTX2File(
+	    std::string        filename,
+	    vks::VulkanDevice *device,
+	    VkQueue            copyQueue,
+	    VkImageUsageFlags  imageUsageFlags,
+	    VkImageLayout      imageLayout,
+	    VkImageViewType    viewType);
 };
 
 class Texture2D : public Texture
@@ -68,7 +96,9 @@ class Texture2D : public Texture
 	    VkQueue            copyQueue,
 	    VkFilter           filter          = VK_FILTER_LINEAR,
 	    VkImageUsageFlags  imageUsageFlags = VK_IMAGE_USAGE_SAMPLED_BIT,
-	    VkImageLayout      imageLayout     = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+	    VkImageLayout      imageLayout     = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+	    vks::MipGenerator *mipGenerator    = nullptr,
+	    vks::MipGenerator::Filter mipFilter = vks::MipGenerator::FilterLinear);
 };
 
 class Texture2DArray : public Texture
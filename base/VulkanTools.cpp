@@ -77,6 +77,22 @@ namespace vks
 			}
 		}
 
+		std::string presentModeString(VkPresentModeKHR mode)
+		{
+			switch (mode)
+			{
+#define STR(r) case VK_PRESENT_MODE_ ##r ##_KHR: return #r
+				STR(IMMEDIATE);
+				STR(MAILBOX);
+				STR(FIFO);
+				STR(FIFO_RELAXED);
+				STR(SHARED_DEMAND_REFRESH);
+				STR(SHARED_CONTINUOUS_REFRESH);
+#undef STR
+			default: return "UNKNOWN_PRESENT_MODE";
+			}
+		}
+
 		VkBool32 getSupportedDepthFormat(VkPhysicalDevice physicalDevice, VkFormat *depthFormat)
 		{
 			// Since all depth formats may be optional, we need to find a suitable depth format to use
@@ -104,6 +120,34 @@ namespace vks
 			return false;
 		}
 
+		VkBool32 getSupportedDepthOnlyFormat(VkPhysicalDevice physicalDevice, bool checkSamplingSupport, VkFormat *depthFormat)
+		{
+			// Formats without a stencil part can be read through a single aspect view (e.g. as an input attachment or texture)
+			std::vector<VkFormat> depthFormats = {
+				VK_FORMAT_D32_SFLOAT,
+				VK_FORMAT_X8_D24_UNORM_PACK32,
+				VK_FORMAT_D16_UNORM
+			};
+
+			for (auto& format : depthFormats)
+			{
+				VkFormatProperties formatProps;
+				vkGetPhysicalDeviceFormatProperties(physicalDevice, format, &formatProps);
+				VkFormatFeatureFlags requiredFeatures = VK_FORMAT_FEATURE_DEPTH_STENCIL_ATTACHMENT_BIT;
+				if (checkSamplingSupport)
+				{
+					requiredFeatures |= VK_FORMAT_FEATURE_SAMPLED_IMAGE_BIT;
+				}
+				if ((formatProps.optimalTilingFeatures & requiredFeatures) == requiredFeatures)
+				{
+					*depthFormat = format;
+					return true;
+				}
+			}
+
+			return false;
+		}
+
 		VkBool32 formatHasStencil(VkFormat format)
 		{
 			std::vector<VkFormat> stencilFormats = {
@@ -130,6 +174,47 @@ namespace vks
 			return false;
 		}
 
+		uint32_t formatSize(VkFormat format)
+		{
+			switch (format)
+			{
+			case VK_FORMAT_R8_UNORM:
+			case VK_FORMAT_S8_UINT:
+				return 1;
+			case VK_FORMAT_R8G8_UNORM:
+			case VK_FORMAT_R16_SFLOAT:
+			case VK_FORMAT_D16_UNORM:
+				return 2;
+			case VK_FORMAT_D16_UNORM_S8_UINT:
+				return 3;
+			case VK_FORMAT_R8G8B8A8_UNORM:
+			case VK_FORMAT_R8G8B8A8_SRGB:
+			case VK_FORMAT_B8G8R8A8_UNORM:
+			case VK_FORMAT_B8G8R8A8_SRGB:
+			case VK_FORMAT_A2B10G10R10_UNORM_PACK32:
+			case VK_FORMAT_A2R10G10B10_UNORM_PACK32:
+			case VK_FORMAT_B10G11R11_UFLOAT_PACK32:
+			case VK_FORMAT_R16G16_SFLOAT:
+			case VK_FORMAT_R16G16_UNORM:
+			case VK_FORMAT_R16G16_SNORM:
+			case VK_FORMAT_R32_SFLOAT:
+			case VK_FORMAT_R32_UINT:
+			case VK_FORMAT_D32_SFLOAT:
+			case VK_FORMAT_X8_D24_UNORM_PACK32:
+			case VK_FORMAT_D24_UNORM_S8_UINT:
+				return 4;
+			case VK_FORMAT_D32_SFLOAT_S8_UINT:
+				return 5;
+			case VK_FORMAT_R16G16B16A16_SFLOAT:
+			case VK_FORMAT_R32G32_SFLOAT:
+				return 8;
+			case VK_FORMAT_R32G32B32A32_SFLOAT:
+				return 16;
+			default:
+				return 0;
+			}
+		}
+
 		// Create an image memory barrier for changing the layout of
 		// an image and put it into an active command buffer
 		// See chapter 11.4 "Image Layout" for details
@@ -399,5 +484,10 @@ namespace vks
 	        return (value + alignment - 1) & ~(alignment - 1);
         }
 
+		VkDeviceSize alignedVkSize(VkDeviceSize value, VkDeviceSize alignment)
+		{
+			return (value + alignment - 1) & ~(alignment - 1);
+		}
+
 	}
 }
@@ -75,14 +75,23 @@ namespace vks
 		/** @brief Returns the device type as a string */
 		std::string physicalDeviceTypeString(VkPhysicalDeviceType type);
 
+		/** @brief Returns the present mode as a string */
+		std::string presentModeString(VkPresentModeKHR mode);
+
 		// Selected a suitable supported depth format starting with 32 bit down to 16 bit
 		// Returns false if none of the depth formats in the list is supported by the device
 		VkBool32 getSupportedDepthFormat(VkPhysicalDevice physicalDevice, VkFormat *depthFormat);
 
+		// Selects a supported depth format without a stencil part starting with 32 bit down to 16 bit, optionally one that can also be sampled
+		// Returns false if none of the depth formats in the list is supported by the device
+		VkBool32 getSupportedDepthOnlyFormat(VkPhysicalDevice physicalDevice, bool checkSamplingSupport, VkFormat *depthFormat);
+
 		// Returns tru a given format support LINEAR filtering
 		VkBool32 formatIsFilterable(VkPhysicalDevice physicalDevice, VkFormat format, VkImageTiling tiling);
 		// Returns true if a given format has a stencil part
 		VkBool32 formatHasStencil(VkFormat format);
+		// Returns the size of a texel in bytes for the uncompressed formats used as render targets, 0 for all other formats
+		uint32_t formatSize(VkFormat format);
 
 		// Put an image memory barrier for setting an image layout on the sub resource into the given command buffer
 		void setImageLayout(
@@ -130,5 +139,6 @@ namespace vks
 		bool fileExists(const std::string &filename);
 
 		uint32_t alignedSize(uint32_t value, uint32_t alignment);
+		VkDeviceSize alignedVkSize(VkDeviceSize value, VkDeviceSize alignment);
 	}
 }
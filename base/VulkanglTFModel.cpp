@@ -15,9 +15,53 @@
 
 VkDescriptorSetLayout vkglTF::descriptorSetLayoutImage = VK_NULL_HANDLE;
 VkDescriptorSetLayout vkglTF::descriptorSetLayoutUbo = VK_NULL_HANDLE;
+VkDescriptorSetLayout vkglTF::descriptorSetLayoutBindless = VK_NULL_HANDLE;
+uint32_t vkglTF::maxBindlessTextures = 1024;
 VkMemoryPropertyFlags vkglTF::memoryPropertyFlags = 0;
 uint32_t vkglTF::descriptorBindingFlags = vkglTF::DescriptorBindingFlags::ImageBaseColor;
 
+// Has to stay alive until the logical device has been created
+static VkPhysicalDeviceDescriptorIndexingFeaturesEXT bindlessFeatures{};
+
+bool vkglTF::requestBindlessFeatures(vks::VulkanDevice* device, uint32_t apiVersion, std::vector<const char*>& enabledExtensions, void*& pNextChain)
+{
+	// Querying the features requires Vulkan 1.1, descriptor indexing is core with Vulkan 1.2
+	const uint32_t version = std::min(apiVersion, device->properties.apiVersion);
+	if (version < VK_API_VERSION_1_1) {
+		return false;
+	}
+	const bool core = version >= VK_API_VERSION_1_2;
+	if (!core && !(device->extensionSupported(VK_EXT_DESCRIPTOR_INDEXING_EXTENSION_NAME) && device->extensionSupported(VK_KHR_MAINTENANCE3_EXTENSION_NAME))) {
+		return false;
+	}
+
+	VkPhysicalDeviceDescriptorIndexingFeaturesEXT supportedFeatures{};
+	supportedFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_INDEXING_FEATURES_EXT;
+	VkPhysicalDeviceFeatures2 features2{};
+	features2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+	features2.pNext = &supportedFeatures;
+	vkGetPhysicalDeviceFeatures2(device->physicalDevice, &features2);
+	if (!supportedFeatures.shaderSampledImageArrayNonUniformIndexing || !supportedFeatures.runtimeDescriptorArray || !supportedFeatures.descriptorBindingVariableDescriptorCount) {
+		return false;
+	}
+
+	if (!core) {
+		enabledExtensions.push_back(VK_KHR_MAINTENANCE3_EXTENSION_NAME);
+		enabledExtensions.push_back(VK_EXT_DESCRIPTOR_INDEXING_EXTENSION_NAME);
+	}
+	bindlessFeatures = {};
+	bindlessFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_INDEXING_FEATURES_EXT;
+	bindlessFeatures.shaderSampledImageArrayNonUniformIndexing = VK_TRUE;
+	bindlessFeatures.runtimeDescriptorArray = VK_TRUE;
+	bindlessFeatures.descriptorBindingVariableDescriptorCount = VK_TRUE;
+	bindlessFeatures.pNext = pNextChain;
+	pNextChain = &bindlessFeatures;
+
+	// The texture array counts against the regular per stage sampler limits, as the set is not updated after binding
+	maxBindlessTextures = std::min(maxBindlessTextures, std::min(device->properties.limits.maxPerStageDescriptorSamplers, device->properties.limits.maxPerStageDescriptorSampledImages));
+	return true;
+}
+
 /*
 	We use a custom image loading function with tinyglTF, so we can do custom stuff loading ktx textures
 */
@@ -62,10 +106,27 @@ void vkglTF::Texture::destroy()
 	}
 }
 
-void vkglTF::Texture::fromglTfImage(tinygltf::Image &gltfimage, std::string path, vks::VulkanDevice *device, VkQueue copyQueue)
+/*
+	Load a glTF image into a sampled image with a full mip chain
+	Without an upload batch the upload is submitted and waited on right away, with a batch the commands are only recorded into the batch's command buffer
+	(the compute mip generation is then left pending in the shared mip generator, see Model::loadImages)
+*/
+void vkglTF::Texture::fromglTfImage(tinygltf::Image &gltfimage, std::string path, vks::VulkanDevice *device, VkQueue copyQueue, vks::MipGenerator::Filter mipFilter, TextureUploadBatch *uploadBatch)
 {
 	this->device = device;
 
+	// Submits the recorded upload and frees its staging buffer, or hands both to the batch
+	auto finishUpload = [&](VkCommandBuffer commandBuffer, VkBuffer stagingBuffer, VkDeviceMemory stagingMemory) {
+		if (uploadBatch) {
+			uploadBatch->stagingBuffers.push_back(stagingBuffer);
+			uploadBatch->stagingMemory.push_back(stagingMemory);
+			return;
+		}
+		device->flushCommandBuffer(commandBuffer, copyQueue, true);
+		vkFreeMemory(device->logicalDevice, stagingMemory, nullptr);
+		vkDestroyBuffer(device->logicalDevice, stagingBuffer, nullptr);
+	};
+
 	bool isKtx = false;
 	// Image points to an external ktx file
 	if (gltfimage.uri.find_last_of(".") != std::string::npos) {
@@ -111,9 +172,14 @@ void vkglTF::Texture::fromglTfImage(tinygltf::Image &gltfimage, std::string path
 		height = gltfimage.height;
 		mipLevels = static_cast<uint32_t>(floor(log2(std::max(width, height))) + 1.0);
 
+		// Prefer generating the mip chain in a single compute dispatch, which can also be batched with other textures
+		const bool computeMips = vks::MipGenerator::shared && vks::MipGenerator::shared->supported(format, width, height, mipLevels);
+
 		vkGetPhysicalDeviceFormatProperties(device->physicalDevice, format, &formatProperties);
-		assert(formatProperties.optimalTilingFeatures & VK_FORMAT_FEATURE_BLIT_SRC_BIT);
-		assert(formatProperties.optimalTilingFeatures & VK_FORMAT_FEATURE_BLIT_DST_BIT);
+		if (!computeMips) {
+			assert(formatProperties.optimalTilingFeatures & VK_FORMAT_FEATURE_BLIT_SRC_BIT);
+			assert(formatProperties.optimalTilingFeatures & VK_FORMAT_FEATURE_BLIT_DST_BIT);
+		}
 
 		VkMemoryAllocateInfo memAllocInfo{};
 		memAllocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
@@ -152,6 +218,10 @@ void vkglTF::Texture::fromglTfImage(tinygltf::Image &gltfimage, std::string path
 		imageCreateInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
 		imageCreateInfo.extent = { width, height, 1 };
 		imageCreateInfo.usage = VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
+		if (computeMips) {
+			imageCreateInfo.usage |= VK_IMAGE_USAGE_STORAGE_BIT;
+			imageCreateInfo.flags |= vks::MipGenerator::imageCreateFlags(format);
+		}
 		VK_CHECK_RESULT(vkCreateImage(device->logicalDevice, &imageCreateInfo, nullptr, &image));
 		vkGetImageMemoryRequirements(device->logicalDevice, image, &memReqs);
 		memAllocInfo.allocationSize = memReqs.size;
@@ -159,7 +229,7 @@ void vkglTF::Texture::fromglTfImage(tinygltf::Image &gltfimage, std::string path
 		VK_CHECK_RESULT(vkAllocateMemory(device->logicalDevice, &memAllocInfo, nullptr, &deviceMemory));
 		VK_CHECK_RESULT(vkBindImageMemory(device->logicalDevice, image, deviceMemory, 0));
 
-		VkCommandBuffer copyCmd = device->createCommandBuffer(VK_COMMAND_BUFFER_LEVEL_PRIMARY, true);
+		VkCommandBuffer copyCmd = uploadBatch ? uploadBatch->commandBuffer : device->createCommandBuffer(VK_COMMAND_BUFFER_LEVEL_PRIMARY, true);
 
 		VkImageSubresourceRange subresourceRange = {};
 		subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
@@ -189,95 +259,107 @@ void vkglTF::Texture::fromglTfImage(tinygltf::Image &gltfimage, std::string path
 
 		vkCmdCopyBufferToImage(copyCmd, stagingBuffer, image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &bufferCopyRegion);
 
-		{
-			VkImageMemoryBarrier imageMemoryBarrier{};
-			imageMemoryBarrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
-			imageMemoryBarrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
-			imageMemoryBarrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
-			imageMemoryBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
-			imageMemoryBarrier.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
-			imageMemoryBarrier.image = image;
-			imageMemoryBarrier.subresourceRange = subresourceRange;
-			vkCmdPipelineBarrier(copyCmd, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, 0, 0, nullptr, 0, nullptr, 1, &imageMemoryBarrier);
+		if (computeMips) {
+			finishUpload(copyCmd, stagingBuffer, stagingMemory);
+			if (deleteBuffer) {
+				delete[] buffer;
+			}
+			imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+			if (uploadBatch) {
+				// Recorded by the owner of the batch once the copies of all its images have been recorded
+				vks::MipGenerator::shared->add(image, format, width, height, mipLevels, mipFilter, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, imageLayout);
+			}
+			else {
+				vks::MipGenerator::shared->generate(image, format, width, height, mipLevels, mipFilter, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, imageLayout);
+			}
 		}
-
-		device->flushCommandBuffer(copyCmd, copyQueue, true);
-
-		vkFreeMemory(device->logicalDevice, stagingMemory, nullptr);
-		vkDestroyBuffer(device->logicalDevice, stagingBuffer, nullptr);
-
-		// Generate the mip chain (glTF uses jpg and png, so we need to create this manually)
-		VkCommandBuffer blitCmd = device->createCommandBuffer(VK_COMMAND_BUFFER_LEVEL_PRIMARY, true);
-		for (uint32_t i = 1; i < mipLevels; i++) {
-			VkImageBlit imageBlit{};
-
-			imageBlit.srcSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-			imageBlit.srcSubresource.layerCount = 1;
-			imageBlit.srcSubresource.mipLevel = i - 1;
-			imageBlit.srcOffsets[1].x = int32_t(width >> (i - 1));
-			imageBlit.srcOffsets[1].y = int32_t(height >> (i - 1));
-			imageBlit.srcOffsets[1].z = 1;
-
-			imageBlit.dstSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-			imageBlit.dstSubresource.layerCount = 1;
-			imageBlit.dstSubresource.mipLevel = i;
-			imageBlit.dstOffsets[1].x = int32_t(width >> i);
-			imageBlit.dstOffsets[1].y = int32_t(height >> i);
-			imageBlit.dstOffsets[1].z = 1;
-
-			VkImageSubresourceRange mipSubRange = {};
-			mipSubRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-			mipSubRange.baseMipLevel = i;
-			mipSubRange.levelCount = 1;
-			mipSubRange.layerCount = 1;
-
+		else {
 			{
 				VkImageMemoryBarrier imageMemoryBarrier{};
 				imageMemoryBarrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
-				imageMemoryBarrier.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-				imageMemoryBarrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
-				imageMemoryBarrier.srcAccessMask = 0;
-				imageMemoryBarrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+				imageMemoryBarrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+				imageMemoryBarrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+				imageMemoryBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+				imageMemoryBarrier.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
 				imageMemoryBarrier.image = image;
-				imageMemoryBarrier.subresourceRange = mipSubRange;
-				vkCmdPipelineBarrier(blitCmd, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 0, nullptr, 1, &imageMemoryBarrier);
+				imageMemoryBarrier.subresourceRange = subresourceRange;
+				vkCmdPipelineBarrier(copyCmd, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, 0, 0, nullptr, 0, nullptr, 1, &imageMemoryBarrier);
+			}
+
+			// Generate the mip chain (glTF uses jpg and png, so we need to create this manually)
+			// The blits follow the copy in the same command buffer, the barrier above makes the base level available to them
+			VkCommandBuffer blitCmd = copyCmd;
+			for (uint32_t i = 1; i < mipLevels; i++) {
+				VkImageBlit imageBlit{};
+
+				imageBlit.srcSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+				imageBlit.srcSubresource.layerCount = 1;
+				imageBlit.srcSubresource.mipLevel = i - 1;
+				imageBlit.srcOffsets[1].x = int32_t(width >> (i - 1));
+				imageBlit.srcOffsets[1].y = int32_t(height >> (i - 1));
+				imageBlit.srcOffsets[1].z = 1;
+
+				imageBlit.dstSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+				imageBlit.dstSubresource.layerCount = 1;
+				imageBlit.dstSubresource.mipLevel = i;
+				imageBlit.dstOffsets[1].x = int32_t(width >> i);
+				imageBlit.dstOffsets[1].y = int32_t(height >> i);
+				imageBlit.dstOffsets[1].z = 1;
+
+				VkImageSubresourceRange mipSubRange = {};
+				mipSubRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+				mipSubRange.baseMipLevel = i;
+				mipSubRange.levelCount = 1;
+				mipSubRange.layerCount = 1;
+
+				{
+					VkImageMemoryBarrier imageMemoryBarrier{};
+					imageMemoryBarrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+					imageMemoryBarrier.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+					imageMemoryBarrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+					imageMemoryBarrier.srcAccessMask = 0;
+					imageMemoryBarrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+					imageMemoryBarrier.image = image;
+					imageMemoryBarrier.subresourceRange = mipSubRange;
+					vkCmdPipelineBarrier(blitCmd, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 0, nullptr, 1, &imageMemoryBarrier);
+				}
+
+				vkCmdBlitImage(blitCmd, image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &imageBlit, VK_FILTER_LINEAR);
+
+				{
+					VkImageMemoryBarrier imageMemoryBarrier{};
+					imageMemoryBarrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+					imageMemoryBarrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+					imageMemoryBarrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+					imageMemoryBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+					imageMemoryBarrier.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+					imageMemoryBarrier.image = image;
+					imageMemoryBarrier.subresourceRange = mipSubRange;
+					vkCmdPipelineBarrier(blitCmd, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 0, nullptr, 1, &imageMemoryBarrier);
+				}
 			}
 
-			vkCmdBlitImage(blitCmd, image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &imageBlit, VK_FILTER_LINEAR);
+			subresourceRange.levelCount = mipLevels;
+			imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
 
 			{
 				VkImageMemoryBarrier imageMemoryBarrier{};
 				imageMemoryBarrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
-				imageMemoryBarrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
-				imageMemoryBarrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+				imageMemoryBarrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+				imageMemoryBarrier.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
 				imageMemoryBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
-				imageMemoryBarrier.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+				imageMemoryBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
 				imageMemoryBarrier.image = image;
-				imageMemoryBarrier.subresourceRange = mipSubRange;
-				vkCmdPipelineBarrier(blitCmd, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 0, nullptr, 1, &imageMemoryBarrier);
+				imageMemoryBarrier.subresourceRange = subresourceRange;
+				vkCmdPipelineBarrier(blitCmd, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, 0, 0, nullptr, 0, nullptr, 1, &imageMemoryBarrier);
 			}
-		}
 
-		subresourceRange.levelCount = mipLevels;
-		imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+			if (deleteBuffer) {
+				delete[] buffer;
+			}
 
-		{
-			VkImageMemoryBarrier imageMemoryBarrier{};
-			imageMemoryBarrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
-			imageMemoryBarrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
-			imageMemoryBarrier.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
-			imageMemoryBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
-			imageMemoryBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
-			imageMemoryBarrier.image = image;
-			imageMemoryBarrier.subresourceRange = subresourceRange;
-			vkCmdPipelineBarrier(blitCmd, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, 0, 0, nullptr, 0, nullptr, 1, &imageMemoryBarrier);
+			finishUpload(blitCmd, stagingBuffer, stagingMemory);
 		}
-
-        if (deleteBuffer) {
-            delete[] buffer;
-        }
-
-		device->flushCommandBuffer(blitCmd, copyQueue, true);
 	}
 	else {
 		// Texture is stored in an external ktx file
@@ -320,7 +402,7 @@ void vkglTF::Texture::fromglTfImage(tinygltf::Image &gltfimage, std::string path
 		VkFormatProperties formatProperties;
 		vkGetPhysicalDeviceFormatProperties(device->physicalDevice, format, &formatProperties);
 
-		VkCommandBuffer copyCmd = device->createCommandBuffer(VK_COMMAND_BUFFER_LEVEL_PRIMARY, true);
+		VkCommandBuffer copyCmd = uploadBatch ? uploadBatch->commandBuffer : device->createCommandBuffer(VK_COMMAND_BUFFER_LEVEL_PRIMARY, true);
 		VkBuffer stagingBuffer;
 		VkDeviceMemory stagingMemory;
 
@@ -391,12 +473,9 @@ void vkglTF::Texture::fromglTfImage(tinygltf::Image &gltfimage, std::string path
 		vks::tools::setImageLayout(copyCmd, image, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, subresourceRange);
 		vkCmdCopyBufferToImage(copyCmd, stagingBuffer, image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, static_cast<uint32_t>(bufferCopyRegions.size()), bufferCopyRegions.data());
 		vks::tools::setImageLayout(copyCmd, image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, subresourceRange);
-		device->flushCommandBuffer(copyCmd, copyQueue);
+		finishUpload(copyCmd, stagingBuffer, stagingMemory);
 		this->imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
 
-		vkFreeMemory(device->logicalDevice, stagingMemory, nullptr);
-		vkDestroyBuffer(device->logicalDevice, stagingBuffer, nullptr);
-
 		ktxTexture_Destroy(ktxTexture);
 	}
 
@@ -752,6 +831,14 @@ vkglTF::Model::~Model()
 		vkDestroyDescriptorSetLayout(device->logicalDevice, descriptorSetLayoutImage, nullptr);
 		descriptorSetLayoutImage = VK_NULL_HANDLE;
 	}
+	if (descriptorSetLayoutBindless != VK_NULL_HANDLE) {
+		vkDestroyDescriptorSetLayout(device->logicalDevice, descriptorSetLayoutBindless, nullptr);
+		descriptorSetLayoutBindless = VK_NULL_HANDLE;
+	}
+	materialBuffer.destroy();
+	meshlets.buffer.destroy();
+	meshlets.vertices.destroy();
+	meshlets.triangles.destroy();
 	vkDestroyDescriptorPool(device->logicalDevice, descriptorPool, nullptr);
 	emptyTexture.destroy();
 }
@@ -991,11 +1078,46 @@ void vkglTF::Model::loadSkins(tinygltf::Model &gltfModel)
 
 void vkglTF::Model::loadImages(tinygltf::Model &gltfModel, vks::VulkanDevice *device, VkQueue transferQueue)
 {
-	for (tinygltf::Image &image : gltfModel.images) {
+	// Color textures are stored sRGB encoded and normal maps need to stay unit length, so pick the mip filter from the material slot an image is used in
+	std::vector<vks::MipGenerator::Filter> mipFilters(gltfModel.images.size(), vks::MipGenerator::FilterLinear);
+	auto setMipFilter = [&](tinygltf::ParameterMap &values, const std::string &name, vks::MipGenerator::Filter filter) {
+		if (values.find(name) != values.end()) {
+			const int source = gltfModel.textures[values[name].TextureIndex()].source;
+			if ((source >= 0) && (source < static_cast<int>(mipFilters.size()))) {
+				mipFilters[source] = filter;
+			}
+		}
+	};
+	for (tinygltf::Material &mat : gltfModel.materials) {
+		setMipFilter(mat.values, "baseColorTexture", vks::MipGenerator::FilterSRGB);
+		setMipFilter(mat.additionalValues, "emissiveTexture", vks::MipGenerator::FilterSRGB);
+		setMipFilter(mat.additionalValues, "normalTexture", vks::MipGenerator::FilterNormal);
+	}
+
+	// Uploads and mip chains of all images are recorded into one command buffer and submitted once
+	// The compute mip generations are collected by the shared generator and recorded after all copies
+	TextureUploadBatch uploadBatch;
+	uploadBatch.commandBuffer = device->createCommandBuffer(VK_COMMAND_BUFFER_LEVEL_PRIMARY, true);
+	if (vks::MipGenerator::shared) {
+		vks::MipGenerator::shared->beginBatch();
+	}
+	for (size_t i = 0; i < gltfModel.images.size(); i++) {
 		vkglTF::Texture texture;
-		texture.fromglTfImage(image, path, device, transferQueue);
+		texture.fromglTfImage(gltfModel.images[i], path, device, transferQueue, mipFilters[i], &uploadBatch);
 		textures.push_back(texture);
 	}
+	if (vks::MipGenerator::shared) {
+		vks::MipGenerator::shared->record(uploadBatch.commandBuffer);
+	}
+	device->flushCommandBuffer(uploadBatch.commandBuffer, transferQueue, true);
+	if (vks::MipGenerator::shared) {
+		vks::MipGenerator::shared->release();
+		vks::MipGenerator::shared->endBatch();
+	}
+	for (size_t i = 0; i < uploadBatch.stagingBuffers.size(); i++) {
+		vkFreeMemory(device->logicalDevice, uploadBatch.stagingMemory[i], nullptr);
+		vkDestroyBuffer(device->logicalDevice, uploadBatch.stagingBuffers[i], nullptr);
+	}
 	// Create an empty texture to be used for empty material images
 	createEmptyTexture(transferQueue);
 }
@@ -1004,6 +1126,7 @@ void vkglTF::Model::loadMaterials(tinygltf::Model &gltfModel)
 {
 	for (tinygltf::Material &mat : gltfModel.materials) {
 		vkglTF::Material material(device);
+		material.index = static_cast<uint32_t>(materials.size());
 		if (mat.values.find("baseColorTexture") != mat.values.end()) {
 			material.baseColorTexture = getTexture(gltfModel.textures[mat.values["baseColorTexture"].TextureIndex()].source);
 		}
@@ -1048,6 +1171,7 @@ void vkglTF::Model::loadMaterials(tinygltf::Model &gltfModel)
 	}
 	// Push a default material at the end of the list for meshes with no material assigned
 	materials.push_back(Material(device));
+	materials.back().index = static_cast<uint32_t>(materials.size() - 1);
 }
 
 void vkglTF::Model::loadAnimations(tinygltf::Model &gltfModel)
@@ -1265,6 +1389,11 @@ void vkglTF::Model::loadFromFile(std::string filename, vks::VulkanDevice *device
 		}
 	}
 
+	if (fileLoadingFlags & FileLoadingFlags::KeepGeometry) {
+		geometry.vertices = vertexBuffer;
+		geometry.indices = indexBuffer;
+	}
+
 	size_t vertexBufferSize = vertexBuffer.size() * sizeof(Vertex);
 	size_t indexBufferSize = indexBuffer.size() * sizeof(uint32_t);
 	indices.count = static_cast<uint32_t>(indexBuffer.size());
@@ -1329,6 +1458,10 @@ void vkglTF::Model::loadFromFile(std::string filename, vks::VulkanDevice *device
 	vkDestroyBuffer(device->logicalDevice, indexStaging.buffer, nullptr);
 	vkFreeMemory(device->logicalDevice, indexStaging.memory, nullptr);
 
+	if (fileLoadingFlags & FileLoadingFlags::BuildMeshlets) {
+		buildMeshlets(filename, vertexBuffer, indexBuffer, transferQueue, fileLoadingFlags & FileLoadingFlags::KeepGeometry);
+	}
+
 	getSceneDimensions();
 
 	// Setup descriptors
@@ -1355,11 +1488,17 @@ void vkglTF::Model::loadFromFile(std::string filename, vks::VulkanDevice *device
 			poolSizes.push_back({ VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, imageCount });
 		}
 	}
+	// The bindless set needs the empty texture, which is only created along with the images
+	const bool bindless = (descriptorBindingFlags & DescriptorBindingFlags::BindlessMaterials) && !(fileLoadingFlags & FileLoadingFlags::DontLoadImages);
+	if (bindless) {
+		poolSizes.push_back({ VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1 });
+		poolSizes.push_back({ VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, static_cast<uint32_t>(textures.size()) + 1 });
+	}
 	VkDescriptorPoolCreateInfo descriptorPoolCI{};
 	descriptorPoolCI.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
 	descriptorPoolCI.poolSizeCount = static_cast<uint32_t>(poolSizes.size());
 	descriptorPoolCI.pPoolSizes = poolSizes.data();
-	descriptorPoolCI.maxSets = uboCount + imageCount;
+	descriptorPoolCI.maxSets = uboCount + imageCount + (bindless ? 1 : 0);
 	VK_CHECK_RESULT(vkCreateDescriptorPool(device->logicalDevice, &descriptorPoolCI, nullptr, &descriptorPool));
 
 	// Descriptors for per-node uniform buffers
@@ -1403,6 +1542,92 @@ void vkglTF::Model::loadFromFile(std::string filename, vks::VulkanDevice *device
 			}
 		}
 	}
+
+	if (bindless) {
+		createBindlessDescriptorSet(transferQueue);
+	}
+}
+
+uint32_t vkglTF::Model::textureIndex(const vkglTF::Texture* texture) const
+{
+	if ((texture == nullptr) || (texture == &emptyTexture)) {
+		return static_cast<uint32_t>(textures.size());
+	}
+	return static_cast<uint32_t>(texture - textures.data());
+}
+
+/*
+	Descriptor set with all materials of the model in a storage buffer and all textures in one array
+	Shaders index both with the material index, so primitives can be drawn without binding anything per draw
+*/
+void vkglTF::Model::createBindlessDescriptorSet(VkQueue transferQueue)
+{
+	// The empty texture is appended to the array for material slots without a texture
+	const uint32_t textureCount = static_cast<uint32_t>(textures.size()) + 1;
+	if (textureCount > maxBindlessTextures) {
+		vks::tools::exitFatal("Model has more textures (" + std::to_string(textureCount) + ") than fit into the bindless texture array (" + std::to_string(maxBindlessTextures) + ")", -1);
+	}
+
+	std::vector<MaterialData> materialData(materials.size());
+	for (size_t i = 0; i < materials.size(); i++) {
+		const Material& material = materials[i];
+		materialData[i] = {};
+		materialData[i].baseColorFactor = material.baseColorFactor;
+		materialData[i].baseColorTexture = textureIndex(material.baseColorTexture);
+		materialData[i].normalTexture = textureIndex(material.normalTexture);
+		materialData[i].metallicRoughnessTexture = textureIndex(material.metallicRoughnessTexture);
+		materialData[i].occlusionTexture = textureIndex(material.occlusionTexture);
+		materialData[i].emissiveTexture = textureIndex(material.emissiveTexture);
+		materialData[i].alphaMode = static_cast<uint32_t>(material.alphaMode);
+		materialData[i].alphaCutoff = material.alphaCutoff;
+		materialData[i].metallicFactor = material.metallicFactor;
+		materialData[i].roughnessFactor = material.roughnessFactor;
+	}
+	const VkDeviceSize bufferSize = materialData.size() * sizeof(MaterialData);
+	vks::Buffer stagingBuffer;
+	VK_CHECK_RESULT(device->createBuffer(VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, &stagingBuffer, bufferSize, materialData.data()));
+	VK_CHECK_RESULT(device->createBuffer(VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, &materialBuffer, bufferSize));
+	device->copyBuffer(&stagingBuffer, &materialBuffer, transferQueue);
+	stagingBuffer.destroy();
+
+	// Layout is global, so only create if it hasn't already been created before
+	if (descriptorSetLayoutBindless == VK_NULL_HANDLE) {
+		std::vector<VkDescriptorSetLayoutBinding> setLayoutBindings = {
+			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT, 0),
+			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_FRAGMENT_BIT, 1, maxBindlessTextures),
+		};
+		// The texture array is the last binding, so its size can be chosen per set
+		std::vector<VkDescriptorBindingFlagsEXT> bindingFlags = { 0, VK_DESCRIPTOR_BINDING_VARIABLE_DESCRIPTOR_COUNT_BIT_EXT };
+		VkDescriptorSetLayoutBindingFlagsCreateInfoEXT setLayoutBindingFlags{};
+		setLayoutBindingFlags.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_BINDING_FLAGS_CREATE_INFO_EXT;
+		setLayoutBindingFlags.bindingCount = static_cast<uint32_t>(bindingFlags.size());
+		setLayoutBindingFlags.pBindingFlags = bindingFlags.data();
+		VkDescriptorSetLayoutCreateInfo descriptorLayoutCI{};
+		descriptorLayoutCI.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+		descriptorLayoutCI.pNext = &setLayoutBindingFlags;
+		descriptorLayoutCI.bindingCount = static_cast<uint32_t>(setLayoutBindings.size());
+		descriptorLayoutCI.pBindings = setLayoutBindings.data();
+		VK_CHECK_RESULT(vkCreateDescriptorSetLayout(device->logicalDevice, &descriptorLayoutCI, nullptr, &descriptorSetLayoutBindless));
+	}
+
+	VkDescriptorSetVariableDescriptorCountAllocateInfoEXT variableDescriptorCountAllocInfo{};
+	variableDescriptorCountAllocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_VARIABLE_DESCRIPTOR_COUNT_ALLOCATE_INFO_EXT;
+	variableDescriptorCountAllocInfo.descriptorSetCount = 1;
+	variableDescriptorCountAllocInfo.pDescriptorCounts = &textureCount;
+	VkDescriptorSetAllocateInfo descriptorSetAllocInfo = vks::initializers::descriptorSetAllocateInfo(descriptorPool, &descriptorSetLayoutBindless, 1);
+	descriptorSetAllocInfo.pNext = &variableDescriptorCountAllocInfo;
+	VK_CHECK_RESULT(vkAllocateDescriptorSets(device->logicalDevice, &descriptorSetAllocInfo, &bindlessDescriptorSet));
+
+	std::vector<VkDescriptorImageInfo> textureDescriptors;
+	for (auto& texture : textures) {
+		textureDescriptors.push_back(texture.descriptor);
+	}
+	textureDescriptors.push_back(emptyTexture.descriptor);
+	std::vector<VkWriteDescriptorSet> writeDescriptorSets = {
+		vks::initializers::writeDescriptorSet(bindlessDescriptorSet, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 0, &materialBuffer.descriptor),
+		vks::initializers::writeDescriptorSet(bindlessDescriptorSet, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 1, textureDescriptors.data(), textureCount),
+	};
+	vkUpdateDescriptorSets(device->logicalDevice, static_cast<uint32_t>(writeDescriptorSets.size()), writeDescriptorSets.data(), 0, nullptr);
 }
 
 void vkglTF::Model::bindBuffers(VkCommandBuffer commandBuffer)
@@ -1413,26 +1638,33 @@ void vkglTF::Model::bindBuffers(VkCommandBuffer commandBuffer)
 	buffersBound = true;
 }
 
+static bool skipPrimitive(const vkglTF::Material& material, uint32_t renderFlags)
+{
+	bool skip = false;
+	if (renderFlags & vkglTF::RenderFlags::RenderOpaqueNodes) {
+		skip = (material.alphaMode != vkglTF::Material::ALPHAMODE_OPAQUE);
+	}
+	if (renderFlags & vkglTF::RenderFlags::RenderAlphaMaskedNodes) {
+		skip = (material.alphaMode != vkglTF::Material::ALPHAMODE_MASK);
+	}
+	if (renderFlags & vkglTF::RenderFlags::RenderAlphaBlendedNodes) {
+		skip = (material.alphaMode != vkglTF::Material::ALPHAMODE_BLEND);
+	}
+	return skip;
+}
+
 void vkglTF::Model::drawNode(Node *node, VkCommandBuffer commandBuffer, uint32_t renderFlags, VkPipelineLayout pipelineLayout, uint32_t bindImageSet)
 {
 	if (node->mesh) {
 		for (Primitive* primitive : node->mesh->primitives) {
-			bool skip = false;
 			const vkglTF::Material& material = primitive->material;
-			if (renderFlags & RenderFlags::RenderOpaqueNodes) {
-				skip = (material.alphaMode != Material::ALPHAMODE_OPAQUE);
-			}
-			if (renderFlags & RenderFlags::RenderAlphaMaskedNodes) {
-				skip = (material.alphaMode != Material::ALPHAMODE_MASK);
-			}
-			if (renderFlags & RenderFlags::RenderAlphaBlendedNodes) {
-				skip = (material.alphaMode != Material::ALPHAMODE_BLEND);
-			}
-			if (!skip) {
+			if (!skipPrimitive(material, renderFlags)) {
 				if (renderFlags & RenderFlags::BindImages) {
 					vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, bindImageSet, 1, &material.descriptorSet, 0, nullptr);
 				}
-				vkCmdDrawIndexed(commandBuffer, primitive->indexCount, 1, primitive->firstIndex, 0, 0);
+				// With bindless materials the shaders fetch the material through the instance index
+				const uint32_t firstInstance = (renderFlags & RenderFlags::BindBindlessSet) ? material.index : 0;
+				vkCmdDrawIndexed(commandBuffer, primitive->indexCount, 1, primitive->firstIndex, 0, firstInstance);
 			}
 		}
 	}
@@ -1448,11 +1680,106 @@ void vkglTF::Model::draw(VkCommandBuffer commandBuffer, uint32_t renderFlags, Vk
 		vkCmdBindVertexBuffers(commandBuffer, 0, 1, &vertices.buffer, offsets);
 		vkCmdBindIndexBuffer(commandBuffer, indices.buffer, 0, VK_INDEX_TYPE_UINT32);
 	}
+	if (renderFlags & RenderFlags::BindBindlessSet) {
+		vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, bindImageSet, 1, &bindlessDescriptorSet, 0, nullptr);
+	}
 	for (auto& node : nodes) {
 		drawNode(node, commandBuffer, renderFlags, pipelineLayout, bindImageSet);
 	}
 }
 
+void vkglTF::Model::buildMeshlets(const std::string& filename, const std::vector<Vertex>& vertexBuffer, const std::vector<uint32_t>& indexBuffer, VkQueue transferQueue, bool keepGeometry)
+{
+	std::vector<Primitive*> primitives;
+	for (auto node : linearNodes) {
+		if (node->mesh) {
+			primitives.insert(primitives.end(), node->mesh->primitives.begin(), node->mesh->primitives.end());
+		}
+	}
+
+	// The cache is only valid for the exact vertices and indices it was built from, so this also covers the loading flags
+	uint64_t sourceHash = vks::MeshletBuilder::hash(vertexBuffer.data(), vertexBuffer.size() * sizeof(Vertex));
+	sourceHash = vks::MeshletBuilder::hash(indexBuffer.data(), indexBuffer.size() * sizeof(uint32_t), sourceHash);
+	const std::string cacheFile = filename + ".meshlets";
+
+	vks::MeshletBuilder builder;
+	bool cached = false;
+#if !defined(__ANDROID__)
+	// Android assets are read-only, meshlets are always built there
+	cached = builder.loadCache(cacheFile, sourceHash) && (builder.ranges.size() == primitives.size());
+#endif
+	if (!cached) {
+		builder.clear();
+		for (Primitive* primitive : primitives) {
+			const uint8_t* firstVertex = reinterpret_cast<const uint8_t*>(vertexBuffer.data() + primitive->firstVertex);
+			vks::MeshletBuilder::Input input;
+			input.positions = firstVertex + offsetof(Vertex, pos);
+			input.positionStride = sizeof(Vertex);
+			input.normals = firstVertex + offsetof(Vertex, normal);
+			input.normalStride = sizeof(Vertex);
+			input.baseVertex = primitive->firstVertex;
+			input.vertexCount = primitive->vertexCount;
+			input.indices = indexBuffer.data() + primitive->firstIndex;
+			input.indexCount = primitive->indexCount;
+			builder.build(input);
+		}
+#if !defined(__ANDROID__)
+		if (!builder.saveCache(cacheFile, sourceHash)) {
+			std::cerr << "Could not write meshlet cache \"" << cacheFile << "\"\n";
+		}
+#endif
+	}
+	for (size_t i = 0; i < primitives.size(); i++) {
+		primitives[i]->firstMeshlet = builder.ranges[i].firstMeshlet;
+		primitives[i]->meshletCount = builder.ranges[i].meshletCount;
+	}
+	meshlets.count = static_cast<uint32_t>(builder.meshlets.size());
+	meshlets.statistics = builder.statistics;
+	if (meshlets.count == 0) {
+		return;
+	}
+
+	auto upload = [&](vks::Buffer& buffer, const void* data, VkDeviceSize size) {
+		vks::Buffer staging;
+		VK_CHECK_RESULT(device->createBuffer(VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, &staging, size, const_cast<void*>(data)));
+		VK_CHECK_RESULT(device->createBuffer(VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, &buffer, size));
+		device->copyBuffer(&staging, &buffer, transferQueue);
+		staging.destroy();
+	};
+	upload(meshlets.buffer, builder.meshlets.data(), builder.meshlets.size() * sizeof(vks::Meshlet));
+	upload(meshlets.vertices, builder.vertices.data(), builder.vertices.size() * sizeof(uint32_t));
+	upload(meshlets.triangles, builder.triangles.data(), builder.triangles.size() * sizeof(uint32_t));
+
+	if (keepGeometry) {
+		geometry.meshlets = std::move(builder.meshlets);
+		geometry.meshletVertices = std::move(builder.vertices);
+		geometry.meshletTriangles = std::move(builder.triangles);
+	}
+}
+
+std::vector<VkDrawIndexedIndirectCommand> vkglTF::Model::indirectCommands(uint32_t renderFlags) const
+{
+	std::vector<VkDrawIndexedIndirectCommand> commands;
+	for (auto node : linearNodes) {
+		if (!node->mesh) {
+			continue;
+		}
+		for (Primitive* primitive : node->mesh->primitives) {
+			if (skipPrimitive(primitive->material, renderFlags)) {
+				continue;
+			}
+			VkDrawIndexedIndirectCommand command{};
+			command.indexCount = primitive->indexCount;
+			command.instanceCount = 1;
+			command.firstIndex = primitive->firstIndex;
+			command.vertexOffset = 0;
+			command.firstInstance = primitive->material.index;
+			commands.push_back(command);
+		}
+	}
+	return commands;
+}
+
 void vkglTF::Model::getNodeDimensions(Node *node, glm::vec3 &min, glm::vec3 &max)
 {
 	if (node->mesh) {
@@ -15,6 +15,8 @@
 
 #include "vulkan/vulkan.h"
 #include "VulkanDevice.h"
+#include "VulkanMipGenerator.h"
+#include "VulkanMeshlets.h"
 
 #include <ktx.h>
 #include <ktxvulkan.h>
@@ -39,16 +41,35 @@ namespace vkglTF
 {
 	enum DescriptorBindingFlags {
 		ImageBaseColor = 0x00000001,
-		ImageNormalMap = 0x00000002
+		ImageNormalMap = 0x00000002,
+		// Additionally puts all materials and textures of a model into a single descriptor set, see RenderFlags::BindBindlessSet
+		BindlessMaterials = 0x00000004
 	};
 
 	extern VkDescriptorSetLayout descriptorSetLayoutImage;
 	extern VkDescriptorSetLayout descriptorSetLayoutUbo;
+	// Binding 0 = material buffer, binding 1 = variable sized texture array, requires descriptor indexing
+	extern VkDescriptorSetLayout descriptorSetLayoutBindless;
+	// Size of the texture array in the bindless layout, sets of a model only allocate the textures it has
+	extern uint32_t maxBindlessTextures;
 	extern VkMemoryPropertyFlags memoryPropertyFlags;
 	extern uint32_t descriptorBindingFlags;
 
+	/** @brief Adds the descriptor indexing extension and features the bindless set needs to the device creation, call before the logical device is created. Returns false if they are not supported */
+	bool requestBindlessFeatures(vks::VulkanDevice* device, uint32_t apiVersion, std::vector<const char*>& enabledExtensions, void*& pNextChain);
+
 	struct Node;
 
+	/*
+		Records the uploads of several textures into one command buffer, so all images of a model are uploaded with a single submission
+		The staging buffers are kept until the command buffer has finished executing
+	*/
+	struct TextureUploadBatch {
+		VkCommandBuffer commandBuffer = VK_NULL_HANDLE;
+		std::vector<VkBuffer> stagingBuffers;
+		std::vector<VkDeviceMemory> stagingMemory;
+	};
+
 	/*
 		glTF texture loading class
 	*/
@@ -65,7 +86,7 @@ namespace vkglTF
 		VkSampler sampler;
 		void updateDescriptor();
 		void destroy();
-		void fromglTfImage(tinygltf::Image& gltfimage, std::string path, vks::VulkanDevice* device, VkQueue copyQueue);
+		void fromglTfImage(tinygltf::Image& gltfimage, std::string path, vks::VulkanDevice* device, VkQueue copyQueue, vks::MipGenerator::Filter mipFilter = vks::MipGenerator::FilterLinear, TextureUploadBatch* uploadBatch = nullptr);
 	};
 
 	/*
@@ -89,11 +110,31 @@ namespace vkglTF
 		vkglTF::Texture* diffuseTexture;
 
 		VkDescriptorSet descriptorSet = VK_NULL_HANDLE;
+		// Position in the material list of the model and the material buffer of the bindless set
+		uint32_t index = 0;
 
 		Material(vks::VulkanDevice* device) : device(device) {};
 		void createDescriptorSet(VkDescriptorPool descriptorPool, VkDescriptorSetLayout descriptorSetLayout, uint32_t descriptorBindingFlags);
 	};
 
+	/*
+		Material as stored in the material buffer of the bindless set (std430 layout)
+		Texture indices refer to the texture array of the same set, missing textures use the empty texture at the end of it
+	*/
+	struct MaterialData {
+		glm::vec4 baseColorFactor;
+		uint32_t baseColorTexture;
+		uint32_t normalTexture;
+		uint32_t metallicRoughnessTexture;
+		uint32_t occlusionTexture;
+		uint32_t emissiveTexture;
+		uint32_t alphaMode;
+		float alphaCutoff;
+		float metallicFactor;
+		float roughnessFactor;
+		uint32_t _pad[3];
+	};
+
 	/*
 		glTF primitive
 	*/
@@ -103,6 +144,9 @@ namespace vkglTF
 		uint32_t firstVertex;
 		uint32_t vertexCount;
 		Material& material;
+		/** @brief Range in the model's meshlet buffer, only set if loaded with FileLoadingFlags::BuildMeshlets */
+		uint32_t firstMeshlet = 0;
+		uint32_t meshletCount = 0;
 
 		struct Dimensions {
 			glm::vec3 min = glm::vec3(FLT_MAX);
@@ -233,14 +277,19 @@ namespace vkglTF
 		PreTransformVertices = 0x00000001,
 		PreMultiplyVertexColors = 0x00000002,
 		FlipY = 0x00000004,
-		DontLoadImages = 0x00000008
+		DontLoadImages = 0x00000008,
+		KeepGeometry = 0x00000010,
+		// Partitions all primitives into meshlets for mesh shading, node transforms are not applied, so this should be combined with PreTransformVertices
+		BuildMeshlets = 0x00000020
 	};
 
 	enum RenderFlags {
 		BindImages = 0x00000001,
 		RenderOpaqueNodes = 0x00000002,
 		RenderAlphaMaskedNodes = 0x00000004,
-		RenderAlphaBlendedNodes = 0x00000008
+		RenderAlphaBlendedNodes = 0x00000008,
+		// Binds the bindless set once and passes the material index of every primitive as its first instance
+		BindBindlessSet = 0x00000010
 	};
 
 	/*
@@ -251,6 +300,9 @@ namespace vkglTF
 		vkglTF::Texture* getTexture(uint32_t index);
 		vkglTF::Texture emptyTexture;
 		void createEmptyTexture(VkQueue transferQueue);
+		uint32_t textureIndex(const vkglTF::Texture* texture) const;
+		void createBindlessDescriptorSet(VkQueue transferQueue);
+		void buildMeshlets(const std::string& filename, const std::vector<Vertex>& vertexBuffer, const std::vector<uint32_t>& indexBuffer, VkQueue transferQueue, bool keepGeometry);
 	public:
 		vks::VulkanDevice* device;
 		VkDescriptorPool descriptorPool;
@@ -266,6 +318,29 @@ namespace vkglTF
 			VkDeviceMemory memory;
 		} indices;
 
+		/** @brief Host copies of the final vertices and indices, only filled if loaded with FileLoadingFlags::KeepGeometry (e.g. for collision detection) */
+		struct Geometry {
+			std::vector<Vertex> vertices;
+			std::vector<uint32_t> indices;
+			/** @brief Only filled if also loaded with FileLoadingFlags::BuildMeshlets */
+			std::vector<vks::Meshlet> meshlets;
+			std::vector<uint32_t> meshletVertices;
+			std::vector<uint32_t> meshletTriangles;
+		} geometry;
+
+		/**
+		* Meshlets of all primitives in storage buffers with the layouts of vks::MeshletBuilder, only created if loaded with
+		* FileLoadingFlags::BuildMeshlets. Meshlet vertices index into the vertex buffer. The meshlets are cached in a
+		* file next to the glTF file and only rebuilt if the geometry changes
+		*/
+		struct Meshlets {
+			vks::Buffer buffer;
+			vks::Buffer vertices;
+			vks::Buffer triangles;
+			uint32_t count = 0;
+			vks::MeshletBuilder::Statistics statistics;
+		} meshlets;
+
 		std::vector<Node*> nodes;
 		std::vector<Node*> linearNodes;
 
@@ -275,6 +350,10 @@ namespace vkglTF
 		std::vector<Material> materials;
 		std::vector<Animation> animations;
 
+		/** @brief Material buffer and descriptor set of all materials, only created if loaded with DescriptorBindingFlags::BindlessMaterials */
+		vks::Buffer materialBuffer;
+		VkDescriptorSet bindlessDescriptorSet = VK_NULL_HANDLE;
+
 		struct Dimensions {
 			glm::vec3 min = glm::vec3(FLT_MAX);
 			glm::vec3 max = glm::vec3(-FLT_MAX);
@@ -298,6 +377,8 @@ namespace vkglTF
 		void bindBuffers(VkCommandBuffer commandBuffer);
 		void drawNode(Node* node, VkCommandBuffer commandBuffer, uint32_t renderFlags = 0, VkPipelineLayout pipelineLayout = VK_NULL_HANDLE, uint32_t bindImageSet = 1);
 		void draw(VkCommandBuffer commandBuffer, uint32_t renderFlags = 0, VkPipelineLayout pipelineLayout = VK_NULL_HANDLE, uint32_t bindImageSet = 1);
+		/** @brief Draw commands for all primitives matching the render flags with the material index as first instance, for use with the bindless set. Node transforms are not applied, so the model should be loaded with FileLoadingFlags::PreTransformVertices */
+		std::vector<VkDrawIndexedIndirectCommand> indirectCommands(uint32_t renderFlags = 0) const;
 		void getNodeDimensions(Node* node, glm::vec3& min, glm::vec3& max);
 		void getSceneDimensions();
 		void updateAnimation(uint32_t index, float time);
@@ -14,6 +14,8 @@
 #include <chrono>
 #include <iomanip>
 
+#include "VulkanFrameTiming.h"
+
 namespace vks
 {
 	class Benchmark {
@@ -32,6 +34,25 @@ namespace vks
 		double runtime = 0.0;
 		uint32_t frameCount = 0;
 
+		/** @brief Number of frames of a camera path to sweep once instead of running for a fixed duration (0 = no path) */
+		uint32_t pathFrames = 0;
+		/** @brief Number of equally long segments along the path frame times are reported for */
+		uint32_t pathSegments = 4;
+		/** @brief Moves the scene to the given frame of the path, called before each rendered frame */
+		std::function<void(uint32_t)> pathFunc = nullptr;
+
+		struct Segment {
+			uint32_t frames = 0;
+			double total = 0.0;
+			double min = std::numeric_limits<double>::max();
+			double max = 0.0;
+		};
+		std::vector<Segment> segments;
+
+		/** @brief Acquire, submit and present timings of the benchmarked frames are added to the results if set */
+		FrameTiming *frameTiming = nullptr;
+		VkPresentModeKHR presentMode = VK_PRESENT_MODE_FIFO_KHR;
+
 		void run(std::function<void()> renderFunc, VkPhysicalDeviceProperties deviceProps) {
 			active = true;
 			this->deviceProps = deviceProps;
@@ -47,6 +68,10 @@ namespace vks
 				double tMeasured = 0.0;
 				while (tMeasured < (warmup * 1000)) {
 					auto tStart = std::chrono::high_resolution_clock::now();
+					// Warm up at the start of the path
+					if (pathFrames > 0) {
+						pathFunc(0);
+					}
 					renderFunc();
 					auto tDiff = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - tStart).count();
 					tMeasured += tDiff;
@@ -55,10 +80,28 @@ namespace vks
 
 			// Benchmark phase
 			{
-				while (runtime < (duration * 1000.0)) {
+				if (pathFrames > 0) {
+					segments.resize(std::max(std::min(pathSegments, pathFrames), 1u));
+				}
+				// Keep the timings of all benchmarked frames, but none of the warm up
+				if (frameTiming) {
+					frameTiming->historySize = 0;
+					frameTiming->reset();
+				}
+				while ((pathFrames > 0) ? (frameCount < pathFrames) : (runtime < (duration * 1000.0))) {
 					auto tStart = std::chrono::high_resolution_clock::now();
+					if (pathFrames > 0) {
+						pathFunc(frameCount);
+					}
 					renderFunc();
 					auto tDiff = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - tStart).count();
+					if (pathFrames > 0) {
+						Segment &segment = segments[static_cast<size_t>(frameCount) * segments.size() / pathFrames];
+						segment.frames++;
+						segment.total += tDiff;
+						segment.min = std::min(segment.min, tDiff);
+						segment.max = std::max(segment.max, tDiff);
+					}
 					runtime += tDiff;
 					frameTimes.push_back(tDiff);
 					frameCount++;
@@ -69,9 +112,43 @@ namespace vks
 				std::cout << "runtime: " << (runtime / 1000.0) << "\n";
 				std::cout << "frames : " << frameCount << "\n";
 				std::cout << "fps    : " << frameCount / (runtime / 1000.0) << "\n";
+				for (size_t i = 0; i < segments.size(); i++) {
+					if (segments[i].frames > 0) {
+						std::cout << "segment " << i << ": " << segments[i].frames << " frames, avg " << (segments[i].total / segments[i].frames) << " ms, min " << segments[i].min << " ms, max " << segments[i].max << " ms" << "\n";
+					}
+				}
+				if (frameTiming) {
+					const FrameTiming::Statistics timings = frameTiming->statistics();
+					std::cout << "present mode: " << vks::tools::presentModeString(presentMode) << ", frame limit: ";
+					if (frameTiming->targetFrameRate > 0.0f) {
+						std::cout << frameTiming->targetFrameRate << " fps (" << FrameTiming::pacingModeString(frameTiming->pacingMode) << ")" << "\n";
+					}
+					else {
+						std::cout << "none" << "\n";
+					}
+					printStage("pacing", timings.pacing);
+					printStage("acquire", timings.acquire);
+					printStage("submit", timings.submit);
+					printStage("present", timings.present);
+					printStage("gpu wait", timings.gpuWait);
+					if (timings.latencyFrames > 0) {
+						printStage("present latency", timings.presentLatency);
+					}
+					else {
+						std::cout << "present latency: not measured" << "\n";
+					}
+				}
 			}
 		}
 
+		void printStage(const char *name, const FrameTiming::Stage &stage) {
+			std::cout << name << ": avg " << stage.avg << " ms, p50 " << stage.p50 << " ms, p99 " << stage.p99 << " ms, max " << stage.max << " ms" << "\n";
+		}
+
+		void saveStage(std::ofstream &result, const char *name, const FrameTiming::Stage &stage) {
+			result << name << "," << stage.avg << "," << stage.p50 << "," << stage.p99 << "," << stage.max << "\n";
+		}
+
 		void saveResults() {
 			std::ofstream result(filename, std::ios::out);
 			if (result.is_open()) {
@@ -80,6 +157,30 @@ namespace vks
 				result << "device,driverversion,duration (ms),frames,fps" << "\n";
 				result << deviceProps.deviceName << "," << deviceProps.driverVersion << "," << runtime << "," << frameCount << "," << frameCount / (runtime / 1000.0) << "\n";
 
+				if (!segments.empty()) {
+					result << "\n" << "segment,frames,avg (ms),min (ms),max (ms)" << "\n";
+					for (size_t i = 0; i < segments.size(); i++) {
+						if (segments[i].frames > 0) {
+							result << i << "," << segments[i].frames << "," << (segments[i].total / segments[i].frames) << "," << segments[i].min << "," << segments[i].max << "\n";
+						}
+					}
+				}
+
+				if (frameTiming) {
+					const FrameTiming::Statistics timings = frameTiming->statistics();
+					result << "\n" << "presentmode,framelimit (fps),pacing,latency frames" << "\n";
+					result << vks::tools::presentModeString(presentMode) << "," << frameTiming->targetFrameRate << "," << FrameTiming::pacingModeString(frameTiming->pacingMode) << "," << timings.latencyFrames << "\n";
+					result << "\n" << "stage,avg (ms),p50 (ms),p99 (ms),max (ms)" << "\n";
+					saveStage(result, "pacing", timings.pacing);
+					saveStage(result, "acquire", timings.acquire);
+					saveStage(result, "submit", timings.submit);
+					saveStage(result, "present", timings.present);
+					saveStage(result, "gpuwait", timings.gpuWait);
+					if (timings.latencyFrames > 0) {
+						saveStage(result, "presentlatency", timings.presentLatency);
+					}
+				}
+
 				if (outputFrameTimes) {
 					result << "\n" << "frame,ms" << "\n";
 					for (size_t i = 0; i < frameTimes.size(); i++) {
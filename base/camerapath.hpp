@@ -0,0 +1,135 @@
+/*
+* Camera path recording and playback
+*
+* Records the camera position and rotation at a fixed rate and replays them with a fixed timestep, so the same
+* sequence of views can be rendered again independent of the frame rate (e.g. for comparable benchmark runs)
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#pragma once
+
+#include <vector>
+#include <string>
+#include <fstream>
+#include <cmath>
+#include <algorithm>
+
+#define GLM_FORCE_RADIANS
+#define GLM_FORCE_DEPTH_ZERO_TO_ONE
+#include <glm/glm.hpp>
+
+namespace vks
+{
+	class CameraPath {
+	private:
+		// File layout: magic ("VKCP"), version, sample interval, sample count, followed by the samples
+		const uint32_t magic = 0x50434B56;
+		const uint32_t version = 1;
+		float recordTime = 0.0f;
+	public:
+		struct Sample {
+			glm::vec3 position;
+			glm::vec3 rotation;
+		};
+
+		/** @brief Time between two recorded samples in seconds */
+		float interval = 1.0f / 30.0f;
+		/** @brief Fixed time step in seconds a path is played back with, independent of the actual frame time */
+		float timestep = 1.0f / 60.0f;
+		std::vector<Sample> samples;
+
+		bool recording = false;
+		bool playing = false;
+		/** @brief Next frame of the playback, wraps around at the end of the path */
+		uint32_t playbackFrame = 0;
+		std::string filename = "";
+
+		void startRecording(const std::string &filename) {
+			this->filename = filename;
+			samples.clear();
+			recordTime = 0.0f;
+			recording = true;
+			playing = false;
+		}
+
+		/** @brief Adds the current camera state for every sample point passed during the last frame */
+		void record(const glm::vec3 &position, const glm::vec3 &rotation, float deltaTime) {
+			if (!recording) {
+				return;
+			}
+			if (!samples.empty()) {
+				recordTime += deltaTime;
+			}
+			while (static_cast<float>(samples.size()) * interval <= recordTime) {
+				samples.push_back({ position, rotation });
+			}
+		}
+
+		bool save() const {
+			std::ofstream file(filename, std::ios::out | std::ios::binary);
+			if (!file.is_open()) {
+				return false;
+			}
+			const uint32_t sampleCount = static_cast<uint32_t>(samples.size());
+			file.write(reinterpret_cast<const char*>(&magic), sizeof(magic));
+			file.write(reinterpret_cast<const char*>(&version), sizeof(version));
+			file.write(reinterpret_cast<const char*>(&interval), sizeof(interval));
+			file.write(reinterpret_cast<const char*>(&sampleCount), sizeof(sampleCount));
+			file.write(reinterpret_cast<const char*>(samples.data()), samples.size() * sizeof(Sample));
+			return file.good();
+		}
+
+		bool load(const std::string &filename) {
+			std::ifstream file(filename, std::ios::in | std::ios::binary);
+			if (!file.is_open()) {
+				return false;
+			}
+			uint32_t fileMagic = 0;
+			uint32_t fileVersion = 0;
+			uint32_t sampleCount = 0;
+			file.read(reinterpret_cast<char*>(&fileMagic), sizeof(fileMagic));
+			file.read(reinterpret_cast<char*>(&fileVersion), sizeof(fileVersion));
+			file.read(reinterpret_cast<char*>(&interval), sizeof(interval));
+			file.read(reinterpret_cast<char*>(&sampleCount), sizeof(sampleCount));
+			if (!file.good() || (fileMagic != magic) || (fileVersion != version) || (interval <= 0.0f) || (sampleCount == 0)) {
+				return false;
+			}
+			samples.resize(sampleCount);
+			file.read(reinterpret_cast<char*>(samples.data()), samples.size() * sizeof(Sample));
+			if (!file.good()) {
+				samples.clear();
+				return false;
+			}
+			this->filename = filename;
+			recording = false;
+			playing = true;
+			playbackFrame = 0;
+			return true;
+		}
+
+		/** @brief Length of the path in seconds */
+		float duration() const {
+			return samples.empty() ? 0.0f : static_cast<float>(samples.size() - 1) * interval;
+		}
+
+		/** @brief Number of frames it takes to play back the whole path with the fixed time step */
+		uint32_t frameCount() const {
+			return samples.empty() ? 0 : static_cast<uint32_t>(std::floor(duration() / timestep)) + 1;
+		}
+
+		/** @brief Camera state at the given time, linearly interpolated between the recorded samples */
+		Sample sample(float time) const {
+			const float position = std::max(time, 0.0f) / interval;
+			const size_t index = std::min(static_cast<size_t>(position), samples.size() - 1);
+			const size_t next = std::min(index + 1, samples.size() - 1);
+			const float t = std::min(position - static_cast<float>(index), 1.0f);
+			return { glm::mix(samples[index].position, samples[next].position, t), glm::mix(samples[index].rotation, samples[next].rotation, t) };
+		}
+
+		/** @brief Camera state of a playback frame, the time is derived from the frame index to avoid accumulating errors */
+		Sample frame(uint32_t index) const {
+			return sample(static_cast<float>(index) * timestep);
+		}
+	};
+}
@@ -214,6 +214,12 @@ void VulkanExampleBase::prepare()
 	setupRenderPass();
 	createPipelineCache();
 	setupFrameBuffer();
+	if (mipGenerator.prepare(vulkanDevice, queue, getShadersPath() + "base/")) {
+		vks::MipGenerator::shared = &mipGenerator;
+	}
+	if (useAsyncCompute) {
+		asyncCompute.prepare(vulkanDevice, queue);
+	}
 	settings.overlay = settings.overlay && (!benchmark.active);
 	if (settings.overlay) {
 		UIOverlay.device = vulkanDevice;
@@ -263,6 +269,7 @@ void VulkanExampleBase::nextFrame()
 #endif
 	frameTimer = (float)tDiff / 1000.0f;
 	camera.update(frameTimer);
+	updateCameraPath();
 	if (camera.moving())
 	{
 		viewUpdated = true;
@@ -295,6 +302,28 @@ void VulkanExampleBase::nextFrame()
 	updateOverlay();
 }
 
+// Called after the frame time has been measured and before it's used to advance the timer
+void VulkanExampleBase::updateCameraPath()
+{
+	if (cameraPath.recording) {
+		cameraPath.record(camera.position, camera.rotation, frameTimer);
+	}
+	else if (cameraPath.playing) {
+		// Replace the measured frame time with the fixed timestep so animations advance the same way on every run
+		frameTimer = cameraPath.timestep;
+		applyCameraPath(cameraPath.playbackFrame);
+		cameraPath.playbackFrame = (cameraPath.playbackFrame + 1) % cameraPath.frameCount();
+	}
+}
+
+void VulkanExampleBase::applyCameraPath(uint32_t frame)
+{
+	const vks::CameraPath::Sample sample = cameraPath.frame(frame);
+	camera.setPosition(sample.position);
+	camera.setRotation(sample.rotation);
+	viewUpdated = true;
+}
+
 void VulkanExampleBase::renderLoop()
 {
 // SRS - for non-apple plaforms, handle benchmarking here within VulkanExampleBase::renderLoop()
@@ -372,6 +401,7 @@ void VulkanExampleBase::renderLoop()
 			auto tDiff = std::chrono::duration<double, std::milli>(tEnd - tStart).count();
 			frameTimer = tDiff / 1000.0f;
 			camera.update(frameTimer);
+			updateCameraPath();
 			// Convert to clamped timer value
 			if (!paused)
 			{
@@ -456,6 +486,7 @@ void VulkanExampleBase::renderLoop()
 		auto tDiff = std::chrono::duration<double, std::milli>(tEnd - tStart).count();
 		frameTimer = tDiff / 1000.0f;
 		camera.update(frameTimer);
+		updateCameraPath();
 		if (camera.moving())
 		{
 			viewUpdated = true;
@@ -498,6 +529,7 @@ void VulkanExampleBase::renderLoop()
 		auto tDiff = std::chrono::duration<double, std::milli>(tEnd - tStart).count();
 		frameTimer = tDiff / 1000.0f;
 		camera.update(frameTimer);
+		updateCameraPath();
 		if (camera.moving())
 		{
 			viewUpdated = true;
@@ -544,6 +576,7 @@ void VulkanExampleBase::renderLoop()
 		auto tDiff = std::chrono::duration<double, std::milli>(tEnd - tStart).count();
 		frameTimer = tDiff / 1000.0f;
 		camera.update(frameTimer);
+		updateCameraPath();
 		if (camera.moving())
 		{
 			viewUpdated = true;
@@ -593,6 +626,7 @@ void VulkanExampleBase::renderLoop()
 		auto tDiff = std::chrono::duration<double, std::milli>(tEnd - tStart).count();
 		frameTimer = tDiff / 1000.0f;
 		camera.update(frameTimer);
+		updateCameraPath();
 		if (camera.moving())
 		{
 			viewUpdated = true;
@@ -637,6 +671,7 @@ void VulkanExampleBase::renderLoop()
 		auto tDiff = std::chrono::duration<double, std::milli>(tEnd - tStart).count();
 		frameTimer = tDiff / 1000.0f;
 		camera.update(frameTimer);
+		updateCameraPath();
 		if (camera.moving())
 		{
 			viewUpdated = true;
@@ -695,6 +730,9 @@ void VulkanExampleBase::updateOverlay()
 #endif
 	ImGui::PushItemWidth(110.0f * UIOverlay.scale);
 	OnUpdateUIOverlay(&UIOverlay);
+	if (frameTiming.overlay) {
+		frameTiming.updateUIOverlay(&UIOverlay);
+	}
 	ImGui::PopItemWidth();
 #if defined(VK_USE_PLATFORM_ANDROID_KHR)
 	ImGui::PopStyleVar();
@@ -730,8 +768,11 @@ void VulkanExampleBase::drawUI(const VkCommandBuffer commandBuffer)
 
 void VulkanExampleBase::prepareFrame()
 {
+	// Frame rate limiting happens before the acquire, so the frame is rendered with the most recent input
+	frameTiming.beginFrame(swapChain);
 	// Acquire the next image from the swap chain
 	VkResult result = swapChain.acquireNextImage(semaphores.presentComplete, &currentBuffer);
+	frameTiming.imageAcquired();
 	// Recreate the swapchain if it's no longer compatible with the surface (OUT_OF_DATE)
 	// SRS - If no longer optimal (VK_SUBOPTIMAL_KHR), wait until submitFrame() in case number of swapchain images will change on resize
 	if ((result == VK_ERROR_OUT_OF_DATE_KHR) || (result == VK_SUBOPTIMAL_KHR)) {
@@ -747,7 +788,9 @@ void VulkanExampleBase::prepareFrame()
 
 void VulkanExampleBase::submitFrame()
 {
-	VkResult result = swapChain.queuePresent(queue, currentBuffer, semaphores.renderComplete);
+	const uint64_t presentId = frameTiming.frameSubmitted(swapChain.swapChain);
+	VkResult result = swapChain.queuePresent(queue, currentBuffer, semaphores.renderComplete, presentId);
+	frameTiming.framePresented();
 	// Recreate the swapchain if it's no longer compatible with the surface (OUT_OF_DATE) or no longer optimal for presentation (SUBOPTIMAL)
 	if ((result == VK_ERROR_OUT_OF_DATE_KHR) || (result == VK_SUBOPTIMAL_KHR)) {
 		windowResize();
@@ -759,6 +802,7 @@ void VulkanExampleBase::submitFrame()
 		VK_CHECK_RESULT(result);
 	}
 	VK_CHECK_RESULT(vkQueueWaitIdle(queue));
+	frameTiming.endFrame();
 }
 
 VulkanExampleBase::VulkanExampleBase(bool enableValidation)
@@ -796,6 +840,13 @@ VulkanExampleBase::VulkanExampleBase(bool enableValidation)
 	commandLineParser.add("benchmarkresultfile", { "-bf", "--benchfilename" }, 1, "Set file name for benchmark results");
 	commandLineParser.add("benchmarkresultframes", { "-bt", "--benchframetimes" }, 0, "Save frame times to benchmark results file");
 	commandLineParser.add("benchmarkframes", { "-bfs", "--benchmarkframes" }, 1, "Only render the given number of frames");
+	commandLineParser.add("benchmarkpathsegments", { "-bps", "--benchpathsegments" }, 1, "Number of segments frame times along a camera path are reported for");
+	commandLineParser.add("recordpath", { "-rp", "--recordpath" }, 1, "Record the camera path to the given file");
+	commandLineParser.add("playpath", { "-pp", "--playpath" }, 1, "Replay a recorded camera path with a fixed timestep (swept once in benchmark mode)");
+	commandLineParser.add("presentmode", { "-pm", "--presentmode" }, 1, "Select the swapchain present mode (immediate, mailbox, fifo or fiforelaxed), overrides V-Sync");
+	commandLineParser.add("framelimit", { "-fl", "--framelimit" }, 1, "Limit the frame rate to the given number of frames per second");
+	commandLineParser.add("framepacing", { "-fp", "--framepacing" }, 1, "Select how the frame limit waits (sleep, spin or hybrid)");
+	commandLineParser.add("presentlatency", { "-pl", "--presentlatency" }, 0, "Measure the time until frames are displayed (requires VK_KHR_present_wait)");
 
 	commandLineParser.parse(args);
 	if (commandLineParser.isSet("help")) {
@@ -832,6 +883,7 @@ VulkanExampleBase::VulkanExampleBase(bool enableValidation)
 	}
 	if (commandLineParser.isSet("benchmark")) {
 		benchmark.active = true;
+		benchmark.frameTiming = &frameTiming;
 		vks::tools::errorModeSilent = true;
 	}
 	if (commandLineParser.isSet("benchmarkwarmup")) {
@@ -849,6 +901,72 @@ VulkanExampleBase::VulkanExampleBase(bool enableValidation)
 	if (commandLineParser.isSet("benchmarkframes")) {
 		benchmark.outputFrames = commandLineParser.getValueAsInt("benchmarkframes", benchmark.outputFrames);
 	}
+	if (commandLineParser.isSet("benchmarkpathsegments")) {
+		benchmark.pathSegments = commandLineParser.getValueAsInt("benchmarkpathsegments", benchmark.pathSegments);
+	}
+	if (commandLineParser.isSet("recordpath")) {
+		cameraPath.startRecording(commandLineParser.getValueAsString("recordpath", ""));
+	}
+	if (commandLineParser.isSet("playpath")) {
+		std::string fileName = commandLineParser.getValueAsString("playpath", "");
+		if (cameraPath.load(fileName)) {
+			// The benchmark sweeps the path once instead of running for a fixed duration
+			benchmark.pathFrames = cameraPath.frameCount();
+			benchmark.pathFunc = [this](uint32_t frame) {
+				frameTimer = cameraPath.timestep;
+				if (!paused) {
+					timer += timerSpeed * frameTimer;
+					if (timer > 1.0) {
+						timer -= 1.0f;
+					}
+				}
+				applyCameraPath(frame);
+				viewChanged();
+			};
+		}
+		else {
+			std::cerr << "Could not load camera path from \"" << fileName << "\"\n";
+		}
+	}
+	if (commandLineParser.isSet("presentmode")) {
+		std::string value = commandLineParser.getValueAsString("presentmode", "fifo");
+		const std::unordered_map<std::string, VkPresentModeKHR> presentModes = {
+			{ "immediate", VK_PRESENT_MODE_IMMEDIATE_KHR },
+			{ "mailbox", VK_PRESENT_MODE_MAILBOX_KHR },
+			{ "fifo", VK_PRESENT_MODE_FIFO_KHR },
+			{ "fiforelaxed", VK_PRESENT_MODE_FIFO_RELAXED_KHR }
+		};
+		auto presentMode = presentModes.find(value);
+		if (presentMode == presentModes.end()) {
+			std::cerr << "Present mode must be one of 'immediate', 'mailbox', 'fifo' or 'fiforelaxed'\n";
+		}
+		else {
+			swapChain.preferredPresentMode = presentMode->second;
+		}
+	}
+	if (commandLineParser.isSet("framelimit")) {
+		frameTiming.targetFrameRate = static_cast<float>(std::max(commandLineParser.getValueAsInt("framelimit", 0), 0));
+		frameTiming.overlay = true;
+	}
+	if (commandLineParser.isSet("framepacing")) {
+		std::string value = commandLineParser.getValueAsString("framepacing", "hybrid");
+		if (value == "sleep") {
+			frameTiming.pacingMode = vks::FrameTiming::PacingSleep;
+		}
+		else if (value == "spin") {
+			frameTiming.pacingMode = vks::FrameTiming::PacingSpin;
+		}
+		else if (value == "hybrid") {
+			frameTiming.pacingMode = vks::FrameTiming::PacingHybrid;
+		}
+		else {
+			std::cerr << "Frame pacing must be one of 'sleep', 'spin' or 'hybrid'\n";
+		}
+	}
+	if (commandLineParser.isSet("presentlatency")) {
+		frameTiming.presentWaitRequested = true;
+		frameTiming.overlay = true;
+	}
 
 #if defined(VK_USE_PLATFORM_ANDROID_KHR)
 	// Vulkan library is loaded dynamically on Android
@@ -874,6 +992,14 @@ VulkanExampleBase::VulkanExampleBase(bool enableValidation)
 
 VulkanExampleBase::~VulkanExampleBase()
 {
+	if (cameraPath.recording) {
+		if (cameraPath.save()) {
+			std::cout << "Camera path with " << cameraPath.samples.size() << " samples saved to \"" << cameraPath.filename << "\"\n";
+		}
+		else {
+			std::cerr << "Could not save camera path to \"" << cameraPath.filename << "\"\n";
+		}
+	}
 	// Clean up Vulkan resources
 	swapChain.cleanup();
 	if (descriptorPool != VK_NULL_HANDLE)
@@ -912,6 +1038,12 @@ VulkanExampleBase::~VulkanExampleBase()
 		UIOverlay.freeResources();
 	}
 
+	if (vks::MipGenerator::shared == &mipGenerator) {
+		vks::MipGenerator::shared = nullptr;
+	}
+	mipGenerator.destroy();
+	asyncCompute.destroy();
+
 	delete vulkanDevice;
 
 	if (settings.validation)
@@ -1042,6 +1174,17 @@ bool VulkanExampleBase::initVulkan()
 	// Derived examples can enable extensions based on the list of supported extensions read from the physical device
 	getEnabledExtensions();
 
+	// Timeline semaphores are used by the async compute service if the device supports them
+	if (useAsyncCompute) {
+		asyncCompute.requestFeatures(vulkanDevice, apiVersion, enabledDeviceExtensions, deviceCreatepNextChain);
+	}
+
+	// sRGB textures need extended image usage to generate their mip chains with the compute shader
+	mipGenerator.requestFeatures(vulkanDevice, apiVersion, enabledDeviceExtensions);
+
+	// Present ids and present wait are used to measure the present latency if requested and supported
+	frameTiming.requestFeatures(vulkanDevice, apiVersion, enabledDeviceExtensions, deviceCreatepNextChain);
+
 	VkResult res = vulkanDevice->createLogicalDevice(enabledFeatures, enabledDeviceExtensions, deviceCreatepNextChain);
 	if (res != VK_SUCCESS) {
 		vks::tools::exitFatal("Could not create Vulkan device: \n" + vks::tools::errorString(res), res);
@@ -2950,6 +3093,7 @@ void VulkanExampleBase::initSwapchain()
 void VulkanExampleBase::setupSwapChain()
 {
 	swapChain.create(&width, &height, settings.vsync, settings.fullscreen);
+	benchmark.presentMode = swapChain.presentMode;
 }
 
 void VulkanExampleBase::OnUpdateUIOverlay(vks::UIOverlay *overlay) {}
@@ -68,10 +68,14 @@
 #include "VulkanBuffer.h"
 #include "VulkanDevice.h"
 #include "VulkanTexture.h"
+#include "VulkanMipGenerator.h"
+#include "VulkanAsyncCompute.h"
+#include "VulkanFrameTiming.h"
 
 #include "VulkanInitializers.hpp"
 #include "camera.hpp"
 #include "benchmark.hpp"
+#include "camerapath.hpp"
 
 class VulkanExampleBase
 {
@@ -84,6 +88,8 @@ private:
 	void handleMouseMove(int32_t x, int32_t y);
 	void nextFrame();
 	void updateOverlay();
+	void updateCameraPath();
+	void applyCameraPath(uint32_t frame);
 	void createPipelineCache();
 	void createCommandPool();
 	void createSynchronizationPrimitives();
@@ -172,9 +178,22 @@ public:
 
 	vks::Benchmark benchmark;
 
+	/** @brief Records the camera or replays a recorded path with a fixed timestep (set via command line arguments) */
+	vks::CameraPath cameraPath;
+
 	/** @brief Encapsulated physical and logical vulkan device */
 	vks::VulkanDevice *vulkanDevice;
 
+	/** @brief Compute mip chain generator shared by the texture and glTF loaders (falls back to blitting if its shader is missing) */
+	vks::MipGenerator mipGenerator;
+
+	/** @brief Async compute queue scheduling, only prepared for examples that set useAsyncCompute in their constructor */
+	vks::AsyncCompute asyncCompute;
+	bool useAsyncCompute = false;
+
+	/** @brief Host timestamps of acquire, submit and present, frame rate limiter and present latency (set via command line arguments) */
+	vks::FrameTiming frameTiming;
+
 	/** @brief Example settings that can be changed e.g. by command line arguments */
 	struct Settings {
 		/** @brief Activates validation layers (and message output) when set to true */
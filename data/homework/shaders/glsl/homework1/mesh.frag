@@ -38,21 +38,6 @@ vec3 baseColor()
 	return texture(colorTextureMap, inUV).rgb * pbrMaterial.baseColorFactor.rgb * inColor;
 }
 
-vec3 Tonemap_ACES(const vec3 c) {
-	// Narkowicz 2015, "ACES Filmic Tone Mapping Curve"
-	// const float a = 2.51;
-	// const float b = 0.03;
-	// const float c = 2.43;
-	// const float d = 0.59;
-	// const float e = 0.14;
-	// return saturate((x*(a*x+b))/(x*(c*x+d)+e));
-
-	//ACES RRT/ODT curve fit courtesy of Stephen Hill
-	vec3 a = c * (c + 0.0245786) - 0.000090537;
-	vec3 b = c * (0.983729 * c + 0.4329510) + 0.238081;
-	return a / b;
-}
-
 // Calculate final normal by TBN
 vec3 getNormal()
 {
@@ -184,11 +169,6 @@ void main()
 	// Combine with emissive
 	color += texture(emissiveTextureMap, inUV).rgb * pbrMaterial.emissiveFactor;
 
-	// TODO: move Tone mapping to new Render Pass
-	color = Tonemap_ACES(color);
-
-	// Gamma correct
-	color = pow(color, vec3(0.4545));
-
+	// Linear HDR color, tone mapping and gamma correction are applied by the tone mapping pass (tonemap.frag)
 	outFragColor = vec4(color, 1.0);	
 }
\ No newline at end of file
@@ -0,0 +1,53 @@
+#version 450
+
+layout (location = 0) in vec3 inPos;
+layout (location = 1) in vec3 inNormal;
+layout (location = 2) in vec2 inUV;
+layout (location = 3) in vec3 inColor; // 1.0
+layout (location = 4) in vec4 inTangent;
+
+layout (set = 0, binding = 0) uniform UBOScene
+{
+	mat4 projection;
+	mat4 view;
+	vec4 lightPos;
+	vec4 viewPos;
+} uboScene;
+
+// Bindless : the first instance of a draw selects its node and material
+struct Draw {
+	uint nodeIndex;
+	uint materialIndex;
+};
+
+layout (std430, set = 1, binding = 0) readonly buffer Draws {
+	Draw draws[];
+};
+
+layout (std430, set = 1, binding = 1) readonly buffer NodeMatrices {
+	mat4 nodeMatrices[];
+};
+
+layout (location = 0) out vec3 outNormal;
+layout (location = 1) out vec3 outColor;
+layout (location = 2) out vec2 outUV;
+layout (location = 3) out vec3 outViewVec;
+layout (location = 4) out vec3 outLightVec;
+layout (location = 5) out vec4 outTangent;
+layout (location = 6) flat out uint outMaterial;
+
+void main() 
+{
+	Draw draw = draws[gl_InstanceIndex];
+	outColor = inColor; // 1.0
+	outUV = inUV;
+	outMaterial = draw.materialIndex;
+
+	vec4 locPos = nodeMatrices[draw.nodeIndex] * vec4(inPos.xyz, 1.0);
+	gl_Position = uboScene.projection * uboScene.view * locPos;
+	
+	outNormal = mat3(uboScene.view) * inNormal;
+	outLightVec = uboScene.lightPos.xyz - locPos.xyz;
+	outViewVec = uboScene.viewPos.xyz - locPos.xyz;
+	outTangent = inTangent;
+}
@@ -0,0 +1,44 @@
+#version 450
+
+// Tone mapping pass: exposure, ACES tone mapping and gamma correction of the linear HDR scene color in a single pass
+
+layout (binding = 0) uniform sampler2D samplerHDR;
+
+layout (push_constant) uniform PushConsts {
+	float exposure;
+	float gamma;
+	int tonemap;
+} pushConsts;
+
+layout (location = 0) in vec2 inUV;
+
+layout (location = 0) out vec4 outFragColor;
+
+vec3 Tonemap_ACES(const vec3 c) {
+	// Narkowicz 2015, "ACES Filmic Tone Mapping Curve"
+	// const float a = 2.51;
+	// const float b = 0.03;
+	// const float c = 2.43;
+	// const float d = 0.59;
+	// const float e = 0.14;
+	// return saturate((x*(a*x+b))/(x*(c*x+d)+e));
+
+	//ACES RRT/ODT curve fit courtesy of Stephen Hill
+	vec3 a = c * (c + 0.0245786) - 0.000090537;
+	vec3 b = c * (0.983729 * c + 0.4329510) + 0.238081;
+	return a / b;
+}
+
+void main() 
+{
+	vec3 color = texture(samplerHDR, inUV).rgb * pushConsts.exposure;
+
+	if (pushConsts.tonemap == 1) {
+		color = Tonemap_ACES(color);
+	}
+
+	// Gamma correct, the curve fit is slightly negative close to black
+	color = pow(clamp(color, 0.0, 1.0), vec3(1.0 / pushConsts.gamma));
+
+	outFragColor = vec4(color, 1.0);
+}
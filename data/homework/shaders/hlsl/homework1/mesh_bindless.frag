@@ -0,0 +1,131 @@
+// Copyright 2020 Google LLC
+
+struct UBO
+{
+	float4x4 projection;
+	float4x4 view;
+	float4 lightPos;
+	float4 viewPos;
+};
+
+cbuffer ubo : register(b0) { UBO ubo; }
+
+// Bindless : all materials of the scene, their textures index the texture array
+struct Material
+{
+	float4 baseColorFactor;
+	float4 emissiveFactor;
+	float metallicFactor;
+	float roughnessFactor;
+	uint baseColorTexture;
+	uint metallicRoughnessTexture;
+	uint normalTexture;
+	uint occlusionTexture;
+	uint emissiveTexture;
+	uint _pad;
+};
+
+StructuredBuffer<Material> materials : register(t2, space1);
+Texture2D textures[] : register(t3, space1);
+SamplerState samplerTextures : register(s3, space1);
+
+struct VSOutput
+{
+[[vk::location(0)]] float3 Normal : NORMAL0;
+[[vk::location(1)]] float3 Color : COLOR0;
+[[vk::location(2)]] float2 UV : TEXCOORD0;
+[[vk::location(3)]] float3 ViewVec : TEXCOORD1;
+[[vk::location(4)]] float3 LightVec : TEXCOORD2;
+[[vk::location(5)]] float4 Tangent : TEXCOORD3;
+[[vk::location(6)]] nointerpolation uint Material : TEXCOORD4;
+};
+
+#define PI 3.14159265359
+
+float4 sampleTexture(uint index, float2 uv)
+{
+	return textures[NonUniformResourceIndex(index)].Sample(samplerTextures, uv);
+}
+
+// Normal Distribution function --------------------------------------
+float D_GGX(float dotNH, float roughness)
+{
+	float alpha = roughness * roughness;
+	float alpha2 = alpha * alpha;
+	float denom = dotNH * dotNH * (alpha2 - 1.0) + 1.0;
+	return (alpha2)/(PI * denom*denom);
+}
+
+// Geometric Shadowing function --------------------------------------
+float G_SchlicksmithGGX(float dotNL, float dotNV, float roughness)
+{
+	float r = (roughness + 1.0);
+	float k = (r*r) / 8.0;
+	float GL = dotNL / (dotNL * (1.0 - k) + k);
+	float GV = dotNV / (dotNV * (1.0 - k) + k);
+	return GL * GV;
+}
+
+// Fresnel function ----------------------------------------------------
+float3 F_Schlick(float cosTheta, float metallic, float3 baseColor)
+{
+	float3 F0 = lerp(float3(0.04, 0.04, 0.04), baseColor, metallic);
+	return F0 + (1.0 - F0) * pow(1.0 - cosTheta, 5.0);
+}
+
+// Specular BRDF composition --------------------------------------------
+float3 BRDF(float3 L, float3 V, float3 N, float metallic, float roughness, float3 baseColor)
+{
+	float3 H = normalize (V + L);
+	float dotNV = clamp(dot(N, V), 0.0, 1.0);
+	float dotNL = clamp(dot(N, L), 0.0, 1.0);
+	float dotNH = clamp(dot(N, H), 0.0, 1.0);
+
+	float3 color = float3(0.0, 0.0, 0.0);
+	if (dotNL > 0.0)
+	{
+		float D = D_GGX(dotNH, roughness);
+		float G = G_SchlicksmithGGX(dotNL, dotNV, roughness);
+		float3 F = F_Schlick(dotNV, metallic, baseColor);
+		float3 spec = D * F * G / (4.0 * dotNL * dotNV);
+		// Light color fixed
+		color += spec * dotNL;
+	}
+	return color;
+}
+
+float4 main(VSOutput input) : SV_TARGET
+{
+	Material material = materials[input.Material];
+
+	float3 baseColor = sampleTexture(material.baseColorTexture, input.UV).rgb * material.baseColorFactor.rgb * input.Color;
+
+	// Calculate final normal by TBN
+	float3 tangentNormal = sampleTexture(material.normalTexture, input.UV).xyz * 2.0 - 1.0;
+	float3 N = normalize(input.Normal);
+	float3 T = normalize(input.Tangent.xyz);
+	float3 B = normalize(cross(N, T));
+	float3x3 TBN = transpose(float3x3(T, B, N));
+	N = normalize(mul(TBN, tangentNormal));
+
+	float3 L = normalize(input.LightVec);
+	float3 V = normalize(input.ViewVec);
+
+	float2 metallicRoughness = sampleTexture(material.metallicRoughnessTexture, input.UV).rg;
+	float metallic = metallicRoughness.r * material.metallicFactor;
+	float roughness = metallicRoughness.g * material.roughnessFactor;
+
+	// Specular contribution
+	float3 Lo = BRDF(L, V, N, metallic, roughness, baseColor);
+
+	// Combine with ambient
+	const float occlusionStrength = 0.1;
+	float ao = sampleTexture(material.occlusionTexture, input.UV).r;
+	float3 color = Lo + (baseColor * ao * occlusionStrength) + float3(0.02, 0.02, 0.02);
+
+	// Combine with emissive
+	color += sampleTexture(material.emissiveTexture, input.UV).rgb * material.emissiveFactor.rgb;
+
+	// Linear HDR color, tone mapping and gamma correction are applied by the tone mapping pass (tonemap.frag)
+	return float4(color, 1.0);
+}
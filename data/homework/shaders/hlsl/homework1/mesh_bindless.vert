@@ -0,0 +1,61 @@
+// Copyright 2020 Google LLC
+
+struct VSInput
+{
+[[vk::location(0)]] float3 Pos : POSITION0;
+[[vk::location(1)]] float3 Normal : NORMAL0;
+[[vk::location(2)]] float2 UV : TEXCOORD0;
+[[vk::location(3)]] float3 Color : COLOR0;
+[[vk::location(4)]] float4 Tangent : TEXCOORD1;
+uint InstanceIndex : SV_InstanceID;
+};
+
+struct UBO
+{
+	float4x4 projection;
+	float4x4 view;
+	float4 lightPos;
+	float4 viewPos;
+};
+
+cbuffer ubo : register(b0) { UBO ubo; }
+
+// Bindless : the first instance of a draw selects its node and material
+struct Draw
+{
+	uint nodeIndex;
+	uint materialIndex;
+};
+
+StructuredBuffer<Draw> draws : register(t0, space1);
+StructuredBuffer<float4x4> nodeMatrices : register(t1, space1);
+
+struct VSOutput
+{
+	float4 Pos : SV_POSITION;
+[[vk::location(0)]] float3 Normal : NORMAL0;
+[[vk::location(1)]] float3 Color : COLOR0;
+[[vk::location(2)]] float2 UV : TEXCOORD0;
+[[vk::location(3)]] float3 ViewVec : TEXCOORD1;
+[[vk::location(4)]] float3 LightVec : TEXCOORD2;
+[[vk::location(5)]] float4 Tangent : TEXCOORD3;
+[[vk::location(6)]] nointerpolation uint Material : TEXCOORD4;
+};
+
+VSOutput main(VSInput input)
+{
+	VSOutput output = (VSOutput)0;
+	Draw draw = draws[input.InstanceIndex];
+	output.Color = input.Color;
+	output.UV = input.UV;
+	output.Material = draw.materialIndex;
+
+	float4 locPos = mul(nodeMatrices[draw.nodeIndex], float4(input.Pos.xyz, 1.0));
+	output.Pos = mul(ubo.projection, mul(ubo.view, locPos));
+
+	output.Normal = mul((float3x3)ubo.view, input.Normal);
+	output.LightVec = ubo.lightPos.xyz - locPos.xyz;
+	output.ViewVec = ubo.viewPos.xyz - locPos.xyz;
+	output.Tangent = input.Tangent;
+	return output;
+}
@@ -0,0 +1,34 @@
+// Copyright 2020 Google LLC
+
+// Tone mapping pass: exposure, ACES tone mapping and gamma correction of the linear HDR scene color in a single pass
+
+Texture2D textureHDR : register(t0);
+SamplerState samplerHDR : register(s0);
+
+struct PushConsts {
+	float exposure;
+	float gamma;
+	int tonemap;
+};
+[[vk::push_constant]] PushConsts pushConsts;
+
+float3 Tonemap_ACES(const float3 c) {
+	//ACES RRT/ODT curve fit courtesy of Stephen Hill
+	float3 a = c * (c + 0.0245786) - 0.000090537;
+	float3 b = c * (0.983729 * c + 0.4329510) + 0.238081;
+	return a / b;
+}
+
+float4 main([[vk::location(0)]] float2 inUV : TEXCOORD0) : SV_TARGET
+{
+	float3 color = textureHDR.Sample(samplerHDR, inUV).rgb * pushConsts.exposure;
+
+	if (pushConsts.tonemap == 1) {
+		color = Tonemap_ACES(color);
+	}
+
+	// Gamma correct, the curve fit is slightly negative close to black
+	color = pow(saturate(color), 1.0 / pushConsts.gamma);
+
+	return float4(color, 1.0);
+}
@@ -0,0 +1,7 @@
+#version 450
+
+// Occlusion query proxies only count samples, no color is written
+
+void main()
+{
+}
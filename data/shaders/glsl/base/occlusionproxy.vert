@@ -0,0 +1,50 @@
+#version 450
+
+// Bounding box of a draw, rendered for its occlusion query
+
+struct Draw
+{
+	vec4 boundsMin;
+	vec4 boundsMax;
+	uint indexCount;
+	uint firstIndex;
+	int vertexOffset;
+	uint firstInstance;
+};
+
+layout (binding = 0, std430) readonly buffer Draws
+{
+	Draw draws[];
+};
+
+layout (binding = 3) uniform UBO
+{
+	mat4 viewProjection;
+	mat4 previousViewProjection;
+	vec4 frustumPlanes[6];
+	uint drawCount;
+	uint occlusionEnabled;
+	uint pyramidLevels;
+} ubo;
+
+layout (push_constant) uniform PushConsts {
+	uint drawIndex;
+} pushConsts;
+
+// Corners of the twelve box triangles, bit 0 selects x, bit 1 selects y and bit 2 selects z of the maximum
+const uint indices[36] = uint[](
+	0u, 2u, 1u, 1u, 2u, 3u,
+	4u, 5u, 6u, 5u, 7u, 6u,
+	0u, 1u, 4u, 1u, 5u, 4u,
+	2u, 6u, 3u, 3u, 6u, 7u,
+	0u, 4u, 2u, 2u, 4u, 6u,
+	1u, 3u, 5u, 3u, 7u, 5u
+);
+
+void main()
+{
+	uint corner = indices[gl_VertexIndex];
+	Draw draw = draws[pushConsts.drawIndex];
+	vec3 pos = mix(draw.boundsMin.xyz, draw.boundsMax.xyz, bvec3(corner & 1u, corner & 2u, corner & 4u));
+	gl_Position = ubo.viewProjection * vec4(pos, 1.0);
+}
@@ -0,0 +1,31 @@
+#version 450
+
+// Per glyph instance, the quad is generated from the vertex index
+layout (location = 0) in vec4 inRect;
+layout (location = 1) in vec4 inUV;
+layout (location = 2) in vec4 inColor;
+layout (location = 3) in vec4 inOutlineColor;
+
+layout (push_constant) uniform PushConsts {
+	vec2 scale;
+	float outlineWidth;
+} pushConsts;
+
+layout (location = 0) out vec2 outUV;
+layout (location = 1) out vec4 outColor;
+layout (location = 2) out vec4 outOutlineColor;
+
+out gl_PerVertex
+{
+	vec4 gl_Position;
+};
+
+void main()
+{
+	vec2 corner = vec2(gl_VertexIndex & 1, (gl_VertexIndex >> 1) & 1);
+	vec2 pos = inRect.xy + corner * inRect.zw;
+	outUV = mix(inUV.xy, inUV.zw, corner);
+	outColor = inColor;
+	outOutlineColor = inOutlineColor;
+	gl_Position = vec4(pos * pushConsts.scale - 1.0, 0.0, 1.0);
+}
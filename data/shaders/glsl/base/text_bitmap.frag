@@ -0,0 +1,14 @@
+#version 450
+
+layout (binding = 0) uniform sampler2D samplerFont;
+
+layout (location = 0) in vec2 inUV;
+layout (location = 1) in vec4 inColor;
+layout (location = 2) in vec4 inOutlineColor;
+
+layout (location = 0) out vec4 outFragColor;
+
+void main()
+{
+	outFragColor = vec4(inColor.rgb, inColor.a * texture(samplerFont, inUV).a);
+}
@@ -0,0 +1,32 @@
+#version 450
+
+layout (binding = 0) uniform sampler2D samplerFont;
+
+layout (push_constant) uniform PushConsts {
+	vec2 scale;
+	float outlineWidth;
+} pushConsts;
+
+layout (location = 0) in vec2 inUV;
+layout (location = 1) in vec4 inColor;
+layout (location = 2) in vec4 inOutlineColor;
+
+layout (location = 0) out vec4 outFragColor;
+
+void main()
+{
+	float distance = texture(samplerFont, inUV).a;
+	float smoothWidth = fwidth(distance);
+	float alpha = smoothstep(0.5 - smoothWidth, 0.5 + smoothWidth, distance);
+	vec4 color = vec4(inColor.rgb, inColor.a * alpha);
+
+	// The outline covers the distance band of the given width outside of the glyph
+	if (inOutlineColor.a > 0.0)
+	{
+		float edge = 0.5 - pushConsts.outlineWidth;
+		float outlineAlpha = smoothstep(edge - smoothWidth, edge + smoothWidth, distance);
+		color = vec4(mix(inOutlineColor.rgb, inColor.rgb, alpha), mix(inOutlineColor.a * outlineAlpha, inColor.a, alpha));
+	}
+
+	outFragColor = color;
+}
@@ -5,10 +5,12 @@ layout (binding = 1) uniform sampler2D colorMap;
 layout (location = 0) in vec3 inColor;
 layout (location = 1) in vec2 inUV;
 
+// Scales the glow color above the bloom threshold
+layout (constant_id = 0) const float EMISSIVE_STRENGTH = 1.0;
+
 layout (location = 0) out vec4 outFragColor;
 
 void main() 
 {
-	outFragColor.rgb = inColor;
-//	outFragColor = texture(colorMap, inUV);// * vec4(inColor, 1.0);
-}
\ No newline at end of file
+	outFragColor = vec4(inColor * EMISSIVE_STRENGTH, 1.0);
+}
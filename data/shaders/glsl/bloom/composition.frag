@@ -0,0 +1,28 @@
+#version 450
+
+layout (binding = 0) uniform sampler2D samplerScene;
+layout (binding = 1) uniform sampler2D samplerBloom;
+
+layout (binding = 2) uniform UBO 
+{
+	float threshold;
+	float knee;
+	float radius;
+	float intensity;
+} ubo;
+
+layout (push_constant) uniform PushConsts {
+	// Zero if bloom is disabled
+	float bloomScale;
+} pushConsts;
+
+layout (location = 0) in vec2 inUV;
+
+layout (location = 0) out vec4 outFragColor;
+
+void main() 
+{
+	vec3 color = texture(samplerScene, inUV).rgb;
+	vec3 bloom = texture(samplerBloom, inUV).rgb;
+	outFragColor = vec4(color + bloom * ubo.intensity * pushConsts.bloomScale, 1.0);
+}
@@ -1,33 +1,78 @@
 #version 450
 
-layout (binding = 1) uniform sampler2D samplerposition;
-layout (binding = 2) uniform sampler2D samplerNormal;
-layout (binding = 3) uniform sampler2D samplerAlbedo;
-
-layout (location = 0) in vec2 inUV;
-
-layout (location = 0) out vec4 outFragcolor;
+// The G-buffer is written by the previous subpass and read at the current pixel
+layout (input_attachment_index = 0, binding = 1) uniform subpassInput inputPosition;
+layout (input_attachment_index = 1, binding = 2) uniform subpassInput inputNormal;
+layout (input_attachment_index = 2, binding = 3) uniform subpassInput inputAlbedo;
 
 struct Light {
-	vec4 position;
-	vec3 color;
-	float radius;
+	vec4 position;	// xyz = position, w = radius
+	vec4 color;
 };
 
-layout (binding = 4) uniform UBO 
+layout (set = 1, binding = 0) uniform UBO
 {
-	Light lights[6];
+	mat4 view;
+	mat4 projection;
 	vec4 viewPos;
+	uvec4 gridSize;		// xyz = cluster count, w = light count
+	vec4 sliceParams;	// x = slice scale, y = slice bias, z = near plane, w = far plane
+	vec2 screenSize;
+	float radiusScale;
+	float time;
 	int displayDebugTarget;
+	uint maxLightIndices;
 } ubo;
 
-void main() 
+layout (std430, set = 1, binding = 2) readonly buffer Lights {
+	Light lights[ ];
+};
+
+// x = first light index, y = light count
+layout (std430, set = 1, binding = 5) readonly buffer ClusterGrid {
+	uvec2 clusterGrid[ ];
+};
+
+layout (std430, set = 1, binding = 6) readonly buffer LightIndices {
+	uint lightIndices[ ];
+};
+
+layout (location = 0) in vec2 inUV;
+
+layout (location = 0) out vec4 outFragcolor;
+
+uint clusterIndex(vec3 worldPos)
+{
+	float depth = -(ubo.view * vec4(worldPos, 1.0)).z;
+	uvec2 tile = min(uvec2(gl_FragCoord.xy / ubo.screenSize * vec2(ubo.gridSize.xy)), ubo.gridSize.xy - 1);
+	uint slice = uint(clamp(int(floor(log(depth) * ubo.sliceParams.x + ubo.sliceParams.y)), 0, int(ubo.gridSize.z) - 1));
+	return tile.x + tile.y * ubo.gridSize.x + slice * ubo.gridSize.x * ubo.gridSize.y;
+}
+
+// Inverse square falloff windowed to reach zero at the light radius, lights are only binned into the clusters they reach
+float attenuation(float dist, float radius)
+{
+	float x = dist / radius;
+	float window = clamp(1.0 - x * x * x * x, 0.0, 1.0);
+	return window * window / (dist * dist + 1.0);
+}
+
+void main()
 {
 	// Get G-Buffer values
-	vec3 fragPos = texture(samplerposition, inUV).rgb;
-	vec3 normal = texture(samplerNormal, inUV).rgb;
-	vec4 albedo = texture(samplerAlbedo, inUV);
-	
+	vec4 position = subpassLoad(inputPosition);
+	vec3 fragPos = position.rgb;
+	vec3 normal = subpassLoad(inputNormal).rgb;
+	vec4 albedo = subpassLoad(inputAlbedo);
+
+	// Nothing has been written to the G-buffer at the background
+	if (position.a == 0.0) {
+		outFragcolor = vec4(0.0);
+		return;
+	}
+
+	uvec2 cluster = clusterGrid[clusterIndex(fragPos)];
+
 	// Debug display
 	if (ubo.displayDebugTarget > 0) {
 		switch (ubo.displayDebugTarget) {
@@ -43,6 +88,10 @@ void main()
 			case 4: 
 				outFragcolor.rgb = albedo.aaa;
 				break;
+			case 5:
+				// Lights per cluster, blue to red at 64
+				outFragcolor.rgb = mix(vec3(0.0, 0.0, 1.0), vec3(1.0, 0.0, 0.0), min(float(cluster.y) / 64.0, 1.0)) * min(float(cluster.y), 1.0);
+				break;
 		}		
 		outFragcolor.a = 1.0;
 		return;
@@ -50,45 +99,46 @@ void main()
 
 	// Render-target composition
 
-	#define lightCount 6
 	#define ambient 0.0
 	
 	// Ambient part
 	vec3 fragcolor  = albedo.rgb * ambient;
-	
-	for(int i = 0; i < lightCount; ++i)
+
+	// Viewer to fragment
+	vec3 V = normalize(ubo.viewPos.xyz - fragPos);
+	vec3 N = normalize(normal);
+
+	// Only the lights binned into the cluster of the fragment
+	for (uint i = 0; i < cluster.y; ++i)
 	{
+		Light light = lights[lightIndices[cluster.x + i]];
+
 		// Vector to light
-		vec3 L = ubo.lights[i].position.xyz - fragPos;
+		vec3 L = light.position.xyz - fragPos;
 		// Distance from light to fragment position
 		float dist = length(L);
+		if (dist >= light.position.w) {
+			continue;
+		}
+
+		// Light to fragment
+		L = normalize(L);
+
+		// Attenuation
+		float atten = attenuation(dist, light.position.w);
+
+		// Diffuse part
+		float NdotL = max(0.0, dot(N, L));
+		vec3 diff = light.color.rgb * albedo.rgb * NdotL * atten;
+
+		// Specular part
+		// Specular map values are stored in alpha of albedo mrt
+		vec3 R = reflect(-L, N);
+		float NdotR = max(0.0, dot(R, V));
+		vec3 spec = light.color.rgb * albedo.a * pow(NdotR, 16.0) * atten;
 
-		// Viewer to fragment
-		vec3 V = ubo.viewPos.xyz - fragPos;
-		V = normalize(V);
-		
-		//if(dist < ubo.lights[i].radius)
-		{
-			// Light to fragment
-			L = normalize(L);
-
-			// Attenuation
-			float atten = ubo.lights[i].radius / (pow(dist, 2.0) + 1.0);
-
-			// Diffuse part
-			vec3 N = normalize(normal);
-			float NdotL = max(0.0, dot(N, L));
-			vec3 diff = ubo.lights[i].color * albedo.rgb * NdotL * atten;
-
-			// Specular part
-			// Specular map values are stored in alpha of albedo mrt
-			vec3 R = reflect(-L, N);
-			float NdotR = max(0.0, dot(R, V));
-			vec3 spec = ubo.lights[i].color * albedo.a * pow(NdotR, 16.0) * atten;
-
-			fragcolor += diff + spec;	
-		}	
+		fragcolor += diff + spec;	
 	}    	
    
   outFragcolor = vec4(fragcolor, 1.0);	
-}
\ No newline at end of file
+}
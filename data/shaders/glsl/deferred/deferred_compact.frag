@@ -0,0 +1,166 @@
+#version 450
+
+// The G-buffer is written by the previous subpass and read at the current pixel, the position is reconstructed from depth
+layout (input_attachment_index = 0, binding = 1) uniform subpassInput inputDepth;
+layout (input_attachment_index = 1, binding = 2) uniform subpassInput inputNormal;
+layout (input_attachment_index = 2, binding = 3) uniform subpassInput inputAlbedo;
+
+struct Light {
+	vec4 position;	// xyz = position, w = radius
+	vec4 color;
+};
+
+layout (set = 1, binding = 0) uniform UBO
+{
+	mat4 view;
+	mat4 projection;
+	vec4 viewPos;
+	uvec4 gridSize;		// xyz = cluster count, w = light count
+	vec4 sliceParams;	// x = slice scale, y = slice bias, z = near plane, w = far plane
+	vec2 screenSize;
+	float radiusScale;
+	float time;
+	int displayDebugTarget;
+	uint maxLightIndices;
+} ubo;
+
+layout (std430, set = 1, binding = 2) readonly buffer Lights {
+	Light lights[ ];
+};
+
+// x = first light index, y = light count
+layout (std430, set = 1, binding = 5) readonly buffer ClusterGrid {
+	uvec2 clusterGrid[ ];
+};
+
+layout (std430, set = 1, binding = 6) readonly buffer LightIndices {
+	uint lightIndices[ ];
+};
+
+layout (location = 0) in vec2 inUV;
+
+layout (location = 0) out vec4 outFragcolor;
+
+uint clusterIndex(vec3 worldPos)
+{
+	float depth = -(ubo.view * vec4(worldPos, 1.0)).z;
+	uvec2 tile = min(uvec2(gl_FragCoord.xy / ubo.screenSize * vec2(ubo.gridSize.xy)), ubo.gridSize.xy - 1);
+	uint slice = uint(clamp(int(floor(log(depth) * ubo.sliceParams.x + ubo.sliceParams.y)), 0, int(ubo.gridSize.z) - 1));
+	return tile.x + tile.y * ubo.gridSize.x + slice * ubo.gridSize.x * ubo.gridSize.y;
+}
+
+vec3 octDecode(vec2 e)
+{
+	e = e * 2.0 - 1.0;
+	vec3 n = vec3(e, 1.0 - abs(e.x) - abs(e.y));
+	if (n.z < 0.0) {
+		vec2 signs = vec2(n.x >= 0.0 ? 1.0 : -1.0, n.y >= 0.0 ? 1.0 : -1.0);
+		n.xy = (1.0 - abs(n.yx)) * signs;
+	}
+	return normalize(n);
+}
+
+// The projection has no off-center terms, so the view space position follows from its diagonal and the window position
+vec3 worldPosition(float depth)
+{
+	vec2 ndc = gl_FragCoord.xy / ubo.screenSize * 2.0 - 1.0;
+	float viewZ = -ubo.projection[3][2] / (depth + ubo.projection[2][2]);
+	vec3 viewPos = vec3(ndc * -viewZ / vec2(ubo.projection[0][0], ubo.projection[1][1]), viewZ);
+	// The view matrix is a rigid transform, its inverse rotation is the transposed one
+	return transpose(mat3(ubo.view)) * (viewPos - ubo.view[3].xyz);
+}
+
+// Inverse square falloff windowed to reach zero at the light radius, lights are only binned into the clusters they reach
+float attenuation(float dist, float radius)
+{
+	float x = dist / radius;
+	float window = clamp(1.0 - x * x * x * x, 0.0, 1.0);
+	return window * window / (dist * dist + 1.0);
+}
+
+void main()
+{
+	// Get G-Buffer values
+	float depth = subpassLoad(inputDepth).r;
+
+	// Nothing has been written to the G-buffer at the background
+	if (depth == 1.0) {
+		outFragcolor = vec4(0.0);
+		return;
+	}
+
+	vec3 fragPos = worldPosition(depth);
+	vec3 normal = octDecode(subpassLoad(inputNormal).rg);
+	vec4 albedo = subpassLoad(inputAlbedo);
+
+	uvec2 cluster = clusterGrid[clusterIndex(fragPos)];
+
+	// Debug display
+	if (ubo.displayDebugTarget > 0) {
+		switch (ubo.displayDebugTarget) {
+			case 1: 
+				outFragcolor.rgb = fragPos;
+				break;
+			case 2: 
+				outFragcolor.rgb = normal;
+				break;
+			case 3: 
+				outFragcolor.rgb = albedo.rgb;
+				break;
+			case 4: 
+				outFragcolor.rgb = albedo.aaa;
+				break;
+			case 5:
+				// Lights per cluster, blue to red at 64
+				outFragcolor.rgb = mix(vec3(0.0, 0.0, 1.0), vec3(1.0, 0.0, 0.0), min(float(cluster.y) / 64.0, 1.0)) * min(float(cluster.y), 1.0);
+				break;
+		}		
+		outFragcolor.a = 1.0;
+		return;
+	}
+
+	// Render-target composition
+
+	#define ambient 0.0
+	
+	// Ambient part
+	vec3 fragcolor  = albedo.rgb * ambient;
+
+	// Viewer to fragment
+	vec3 V = normalize(ubo.viewPos.xyz - fragPos);
+	vec3 N = normalize(normal);
+
+	// Only the lights binned into the cluster of the fragment
+	for (uint i = 0; i < cluster.y; ++i)
+	{
+		Light light = lights[lightIndices[cluster.x + i]];
+
+		// Vector to light
+		vec3 L = light.position.xyz - fragPos;
+		// Distance from light to fragment position
+		float dist = length(L);
+		if (dist >= light.position.w) {
+			continue;
+		}
+
+		// Light to fragment
+		L = normalize(L);
+
+		// Attenuation
+		float atten = attenuation(dist, light.position.w);
+
+		// Diffuse part
+		float NdotL = max(0.0, dot(N, L));
+		vec3 diff = light.color.rgb * albedo.rgb * NdotL * atten;
+
+		// Specular part
+		// Specular map values are stored in alpha of albedo mrt
+		vec3 R = reflect(-L, N);
+		float NdotR = max(0.0, dot(R, V));
+		vec3 spec = light.color.rgb * albedo.a * pow(NdotR, 16.0) * atten;
+
+		fragcolor += diff + spec;	
+	}    	
+   
+  outFragcolor = vec4(fragcolor, 1.0);	
+}
@@ -0,0 +1,128 @@
+#version 450
+
+// Forward+ shading of the scene with the same light clusters as the deferred composition
+
+layout (binding = 1) uniform sampler2D samplerColor;
+layout (binding = 2) uniform sampler2D samplerNormalMap;
+
+struct Light {
+	vec4 position;	// xyz = position, w = radius
+	vec4 color;
+};
+
+layout (set = 1, binding = 0) uniform UBO
+{
+	mat4 view;
+	mat4 projection;
+	vec4 viewPos;
+	uvec4 gridSize;		// xyz = cluster count, w = light count
+	vec4 sliceParams;	// x = slice scale, y = slice bias, z = near plane, w = far plane
+	vec2 screenSize;
+	float radiusScale;
+	float time;
+	int displayDebugTarget;
+	uint maxLightIndices;
+} ubo;
+
+layout (std430, set = 1, binding = 2) readonly buffer Lights {
+	Light lights[ ];
+};
+
+// x = first light index, y = light count
+layout (std430, set = 1, binding = 5) readonly buffer ClusterGrid {
+	uvec2 clusterGrid[ ];
+};
+
+layout (std430, set = 1, binding = 6) readonly buffer LightIndices {
+	uint lightIndices[ ];
+};
+
+layout (location = 0) in vec3 inNormal;
+layout (location = 1) in vec2 inUV;
+layout (location = 2) in vec3 inColor;
+layout (location = 3) in vec3 inWorldPos;
+layout (location = 4) in vec3 inTangent;
+
+layout (location = 0) out vec4 outFragcolor;
+
+uint clusterIndex(vec3 worldPos)
+{
+	float depth = -(ubo.view * vec4(worldPos, 1.0)).z;
+	uvec2 tile = min(uvec2(gl_FragCoord.xy / ubo.screenSize * vec2(ubo.gridSize.xy)), ubo.gridSize.xy - 1);
+	uint slice = uint(clamp(int(floor(log(depth) * ubo.sliceParams.x + ubo.sliceParams.y)), 0, int(ubo.gridSize.z) - 1));
+	return tile.x + tile.y * ubo.gridSize.x + slice * ubo.gridSize.x * ubo.gridSize.y;
+}
+
+// Inverse square falloff windowed to reach zero at the light radius, lights are only binned into the clusters they reach
+float attenuation(float dist, float radius)
+{
+	float x = dist / radius;
+	float window = clamp(1.0 - x * x * x * x, 0.0, 1.0);
+	return window * window / (dist * dist + 1.0);
+}
+
+void main()
+{
+	// Calculate normal in tangent space
+	vec3 N = normalize(inNormal);
+	vec3 T = normalize(inTangent);
+	vec3 B = cross(N, T);
+	mat3 TBN = mat3(T, B, N);
+	N = TBN * normalize(texture(samplerNormalMap, inUV).xyz * 2.0 - vec3(1.0));
+	vec4 albedo = texture(samplerColor, inUV);
+
+	uvec2 cluster = clusterGrid[clusterIndex(inWorldPos)];
+
+	// Debug display
+	if (ubo.displayDebugTarget > 0) {
+		switch (ubo.displayDebugTarget) {
+			case 1: 
+				outFragcolor.rgb = inWorldPos;
+				break;
+			case 2: 
+				outFragcolor.rgb = N;
+				break;
+			case 3: 
+				outFragcolor.rgb = albedo.rgb;
+				break;
+			case 4: 
+				outFragcolor.rgb = albedo.aaa;
+				break;
+			case 5:
+				// Lights per cluster, blue to red at 64
+				outFragcolor.rgb = mix(vec3(0.0, 0.0, 1.0), vec3(1.0, 0.0, 0.0), min(float(cluster.y) / 64.0, 1.0)) * min(float(cluster.y), 1.0);
+				break;
+		}
+		outFragcolor.a = 1.0;
+		return;
+	}
+
+	vec3 fragcolor = vec3(0.0);
+	vec3 V = normalize(ubo.viewPos.xyz - inWorldPos);
+	N = normalize(N);
+
+	for (uint i = 0; i < cluster.y; ++i)
+	{
+		Light light = lights[lightIndices[cluster.x + i]];
+		vec3 L = light.position.xyz - inWorldPos;
+		float dist = length(L);
+		if (dist >= light.position.w) {
+			continue;
+		}
+		L = normalize(L);
+		float atten = attenuation(dist, light.position.w);
+
+		// Diffuse part
+		float NdotL = max(0.0, dot(N, L));
+		vec3 diff = light.color.rgb * albedo.rgb * NdotL * atten;
+
+		// Specular part, specular map values are stored in the alpha channel of the color map
+		vec3 R = reflect(-L, N);
+		float NdotR = max(0.0, dot(R, V));
+		vec3 spec = light.color.rgb * albedo.a * pow(NdotR, 16.0) * atten;
+
+		fragcolor += diff + spec;
+	}
+
+	outFragcolor = vec4(fragcolor, 1.0);
+}
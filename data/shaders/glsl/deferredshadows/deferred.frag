@@ -25,6 +25,8 @@ struct Light
 layout (binding = 4) uniform UBO 
 {
 	vec4 viewPos;
+	mat4 view;
+	mat4 projection;
 	Light lights[LIGHT_COUNT];
 	int useShadows;
 	int debugDisplayTarget;
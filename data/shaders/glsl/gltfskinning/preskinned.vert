@@ -0,0 +1,50 @@
+#version 450
+
+// Position and normal were skinned by skinning.comp
+layout (location = 0) in vec3 inPos;
+layout (location = 1) in vec3 inNormal;
+layout (location = 2) in vec2 inUV;
+layout (location = 3) in vec3 inColor;
+
+layout (set = 0, binding = 0) uniform UBOScene
+{
+	mat4 projection;
+	mat4 view;
+	vec4 lightPos;
+} uboScene;
+
+layout(push_constant) uniform PushConsts {
+	mat4 model;
+} primitive;
+
+// Flattens the model onto the ground plane along the light direction
+layout (constant_id = 0) const bool PLANAR_SHADOW = false;
+
+layout (location = 0) out vec3 outNormal;
+layout (location = 1) out vec3 outColor;
+layout (location = 2) out vec2 outUV;
+layout (location = 3) out vec3 outViewVec;
+layout (location = 4) out vec3 outLightVec;
+
+void main() 
+{
+	outColor = inColor;
+	outUV = inUV;
+
+	if (PLANAR_SHADOW) {
+		vec4 worldPos = primitive.model * vec4(inPos.xyz, 1.0);
+		vec3 lightDir = normalize(uboScene.lightPos.xyz);
+		worldPos.xyz -= lightDir * (worldPos.y / lightDir.y);
+		gl_Position = uboScene.projection * uboScene.view * worldPos;
+		return;
+	}
+
+	gl_Position = uboScene.projection * uboScene.view * primitive.model * vec4(inPos.xyz, 1.0);
+	
+	outNormal = normalize(transpose(inverse(mat3(uboScene.view * primitive.model))) * inNormal);
+
+	vec4 pos = uboScene.view * vec4(inPos, 1.0);
+	vec3 lPos = mat3(uboScene.view) * uboScene.lightPos.xyz;
+	outLightVec = lPos - pos.xyz;
+	outViewVec = -pos.xyz;
+}
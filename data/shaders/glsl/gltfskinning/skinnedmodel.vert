@@ -22,6 +22,9 @@ layout(std430, set = 1, binding = 0) readonly buffer JointMatrices {
 	mat4 jointMatrices[];
 };
 
+// Flattens the skinned model onto the ground plane along the light direction
+layout (constant_id = 0) const bool PLANAR_SHADOW = false;
+
 layout (location = 0) out vec3 outNormal;
 layout (location = 1) out vec3 outColor;
 layout (location = 2) out vec2 outUV;
@@ -41,6 +44,14 @@ void main()
 		inJointWeights.z * jointMatrices[int(inJointIndices.z)] +
 		inJointWeights.w * jointMatrices[int(inJointIndices.w)];
 
+	if (PLANAR_SHADOW) {
+		vec4 worldPos = primitive.model * skinMat * vec4(inPos.xyz, 1.0);
+		vec3 lightDir = normalize(uboScene.lightPos.xyz);
+		worldPos.xyz -= lightDir * (worldPos.y / lightDir.y);
+		gl_Position = uboScene.projection * uboScene.view * worldPos;
+		return;
+	}
+
 	gl_Position = uboScene.projection * uboScene.view * primitive.model * skinMat * vec4(inPos.xyz, 1.0);
 	
 	outNormal = normalize(transpose(inverse(mat3(uboScene.view * primitive.model * skinMat))) * inNormal);
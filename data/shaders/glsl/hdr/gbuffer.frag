@@ -22,10 +22,6 @@ layout (constant_id = 0) const int type = 0;
 #define PI 3.1415926
 #define TwoPI (2.0 * PI)
 
-layout (binding = 2) uniform Exposure {
-	float exposure;
-} exposure;
-
 void main()
 {
 	vec4 color;
@@ -85,12 +81,13 @@ void main()
 	}
 
 
-	// Color with manual exposure into attachment 0
-	outColor0.rgb = vec3(1.0) - exp(-color.rgb * exposure.exposure);
+	// Unexposed HDR color into attachment 0, exposure and tone mapping are applied by the post processing stage
+	outColor0 = vec4(color.rgb, 1.0);
 
-	// Bright parts for bloom into attachment 1
-	float l = dot(outColor0.rgb, vec3(0.2126, 0.7152, 0.0722));
+	// Bright parts for bloom into attachment 1, selected at a fixed exposure so the bloom input stays bounded
+	vec3 mapped = vec3(1.0) - exp(-color.rgb);
+	float l = dot(mapped, vec3(0.2126, 0.7152, 0.0722));
 	float threshold = 0.75;
-	outColor1.rgb = (l > threshold) ? outColor0.rgb : vec3(0.0);
+	outColor1.rgb = (l > threshold) ? mapped : vec3(0.0);
 	outColor1.a = 1.0;
 }
\ No newline at end of file
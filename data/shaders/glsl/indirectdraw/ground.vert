@@ -10,12 +10,14 @@ layout (binding = 0) uniform UBO
 {
 	mat4 projection;
 	mat4 modelview;
+	float groundScale;
 } ubo;
 
 layout (location = 0) out vec2 outUV;
 
 void main() 
 {
-	outUV = inUV * 32.0;
-	gl_Position = ubo.projection * ubo.modelview * vec4(inPos.xyz, 1.0);
+	// The plane is scaled to the plant field, the texture keeps its size
+	outUV = inUV * 32.0 * ubo.groundScale;
+	gl_Position = ubo.projection * ubo.modelview * vec4(inPos.xyz * vec3(ubo.groundScale, 1.0, ubo.groundScale), 1.0);
 }
@@ -62,7 +62,9 @@ void main()
 		
 	outNormal = inNormal * mat3(rotMat);
 	
-	vec4 pos = vec4((inPos.xyz * instanceScale) + instancePos, 1.0) * rotMat;
+	// Rotate around the instance's own origin, the instance grid culls the plants at their positions
+	vec4 pos = vec4(inPos.xyz * instanceScale, 1.0) * rotMat;
+	pos.xyz += instancePos;
 
 	gl_Position = ubo.projection * ubo.modelview * pos;
 	
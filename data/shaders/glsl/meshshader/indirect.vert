@@ -0,0 +1,54 @@
+/* Copyright (c) 2021, Sascha Willems
+ *
+ * SPDX-License-Identifier: MIT
+ *
+ */
+
+#version 450
+
+layout (location = 0) in vec3 inPos;
+layout (location = 1) in vec3 inNormal;
+layout (location = 2) in vec4 inColor;
+
+layout (binding = 0) uniform UBO
+{
+	mat4 projection;
+	mat4 model;
+	mat4 view;
+	vec4 frustumPlanes[6];
+	vec4 cameraPos;
+	uint meshletCount;
+	uint vertexStride;
+	uint frustumCulling;
+	uint coneCulling;
+	uint colorMeshlets;
+	uint meshletIndexAsInstance;
+} ubo;
+
+layout (location = 0) out VertexOutput
+{
+	vec3 normal;
+	vec3 color;
+	vec3 viewVec;
+	vec3 lightVec;
+} vertexOutput;
+
+const vec3 lightPos = vec3(10.0, -10.0, 10.0);
+
+vec3 meshletColor(uint index)
+{
+	uint hash = index * 2654435761u;
+	return vec3(hash & 0xFF, (hash >> 8) & 0xFF, (hash >> 16) & 0xFF) / 255.0;
+}
+
+void main()
+{
+	mat4 modelView = ubo.view * ubo.model;
+	vec4 viewPos = modelView * vec4(inPos, 1.0);
+	gl_Position = ubo.projection * viewPos;
+	vertexOutput.normal = mat3(modelView) * inNormal;
+	// The cull shader passes the meshlet index as instance index if the device supports it
+	vertexOutput.color = (ubo.colorMeshlets == 1 && ubo.meshletIndexAsInstance == 1) ? meshletColor(gl_InstanceIndex) : inColor.rgb;
+	vertexOutput.viewVec = -viewPos.xyz;
+	vertexOutput.lightVec = (ubo.view * vec4(lightPos, 1.0)).xyz - viewPos.xyz;
+}
@@ -3,13 +3,14 @@
 layout (location = 0) in vec3 inPos;
 layout (location = 1) in vec3 inNormal;
 layout (location = 2) in vec3 inColor;
+// Per instance attributes
+layout (location = 3) in mat4 instanceModel;
+layout (location = 7) in vec4 instanceColor;
 
 layout (binding = 0) uniform UBO 
 {
 	mat4 projection;
 	mat4 view;
-	mat4 model;
-	vec4 color;
 	vec4 lightPos;
 } ubo;
 
@@ -17,6 +18,6 @@ layout (location = 0) out vec3 outColor;
 
 void main() 
 {
-	outColor = inColor * ubo.color.rgb;
-	gl_Position = ubo.projection * ubo.view * ubo.model * vec4(inPos.xyz, 1.0);
-}
\ No newline at end of file
+	outColor = inColor * instanceColor.rgb;
+	gl_Position = ubo.projection * ubo.view * instanceModel * vec4(inPos.xyz, 1.0);
+}
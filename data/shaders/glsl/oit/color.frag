@@ -1,10 +1,13 @@
 #version 450
 
-#define MAX_FRAGMENT_COUNT 128
+// Must match MAX_K_BUFFER_SIZE in oit.cpp
+#define MAX_K_BUFFER_SIZE 16
+// Bounds the list traversal in case of very deep lists
+#define MAX_LIST_LENGTH 1024
 
 struct Node
 {
-    vec4 color;
+    uint color;
     float depth;
     uint next;
 };
@@ -18,39 +21,84 @@ layout (set = 0, binding = 1) buffer LinkedListSBO
     Node nodes[];
 };
 
+layout (set = 0, binding = 2) uniform sampler2D samplerAccumulation;
+layout (set = 0, binding = 3) uniform sampler2D samplerRevealage;
+
+layout(push_constant) uniform PushConsts {
+    uint kBufferSize;
+} pushConsts;
+
 void main()
 {
-    Node fragments[MAX_FRAGMENT_COUNT];
-    int count = 0;
+    // The k nearest fragments are kept sorted front to back, all other fragments are merged into an order independent tail
+    uint kColors[MAX_K_BUFFER_SIZE];
+    float kDepths[MAX_K_BUFFER_SIZE];
+    uint count = 0;
+    uint kSize = clamp(pushConsts.kBufferSize, 1u, uint(MAX_K_BUFFER_SIZE));
+    vec4 tailAccumulation = vec4(0.0);
+    float tailRevealage = 1.0;
 
     uint nodeIdx = imageLoad(headIndexImage, ivec2(gl_FragCoord.xy)).r;
 
-    while (nodeIdx != 0xffffffff && count < MAX_FRAGMENT_COUNT)
-    {
-        fragments[count] = nodes[nodeIdx];
-        nodeIdx = fragments[count].next;
-        ++count;
-    }
-    
-    // Do the insertion sort
-    for (uint i = 1; i < count; ++i)
+    for (uint n = 0; n < MAX_LIST_LENGTH && nodeIdx != 0xffffffff; ++n)
     {
-        Node insert = fragments[i];
-        uint j = i;
-        while (j > 0 && insert.depth > fragments[j - 1].depth)
+        Node node = nodes[nodeIdx];
+        nodeIdx = node.next;
+
+        uint slot;
+        if (count < kSize)
+        {
+            slot = count++;
+        }
+        else
         {
-            fragments[j] = fragments[j-1];
-            --j;
+            uint mergeColor = node.color;
+            if (node.depth < kDepths[kSize - 1])
+            {
+                // Nearer than the farthest kept fragment, which is evicted into the tail
+                mergeColor = kColors[kSize - 1];
+                slot = kSize - 1;
+            }
+            else
+            {
+                slot = MAX_K_BUFFER_SIZE;
+            }
+            vec4 mergeFragment = unpackUnorm4x8(mergeColor);
+            tailAccumulation += vec4(mergeFragment.rgb * mergeFragment.a, mergeFragment.a);
+            tailRevealage *= 1.0 - mergeFragment.a;
+            if (slot == MAX_K_BUFFER_SIZE)
+            {
+                continue;
+            }
         }
-        fragments[j] = insert;
+
+        // Insertion into the sorted k-buffer
+        while (slot > 0 && node.depth < kDepths[slot - 1])
+        {
+            kColors[slot] = kColors[slot - 1];
+            kDepths[slot] = kDepths[slot - 1];
+            --slot;
+        }
+        kColors[slot] = node.color;
+        kDepths[slot] = node.depth;
     }
 
-    // Do blending
     vec4 color = vec4(0.025, 0.025, 0.025, 1.0f);
-    for (int i = 0; i < count; ++i)
+
+    // Fragments that overflowed the node buffer (weighted blended)
+    vec4 accumulation = texelFetch(samplerAccumulation, ivec2(gl_FragCoord.xy), 0);
+    float revealage = texelFetch(samplerRevealage, ivec2(gl_FragCoord.xy), 0).r;
+    color.rgb = mix(color.rgb, accumulation.rgb / max(accumulation.a, 1e-5), 1.0 - revealage);
+
+    // Fragments behind the k-buffer (weighted average)
+    color.rgb = mix(color.rgb, tailAccumulation.rgb / max(tailAccumulation.a, 1e-5), 1.0 - tailRevealage);
+
+    // Do blending of the k nearest fragments back to front
+    for (int i = int(count) - 1; i >= 0; --i)
     {
-        color = mix(color, fragments[i].color, fragments[i].color.a);
+        vec4 fragmentColor = unpackUnorm4x8(kColors[i]);
+        color = mix(color, fragmentColor, fragmentColor.a);
     }
 
     outFragColor = color;
-}
\ No newline at end of file
+}
@@ -2,9 +2,10 @@
 
 layout (early_fragment_tests) in;
 
+// Color is packed to RGBA8 to keep nodes at 12 bytes
 struct Node
 {
-    vec4 color;
+    uint color;
     float depth;
     uint next;
 };
@@ -12,6 +13,7 @@ struct Node
 layout (set = 0, binding = 1) buffer GeometrySBO
 {
     uint count;
+    uint overflowCount;
     uint maxNodeCount;
 };
 
@@ -27,6 +29,10 @@ layout(push_constant) uniform PushConsts {
     vec4 color;
 } pushConsts;
 
+// Weighted blended accumulation for fragments that don't fit into the node buffer
+layout (location = 0) out vec4 outAccumulation;
+layout (location = 1) out float outRevealage;
+
 void main()
 {
     // Increase the node count
@@ -39,8 +45,21 @@ void main()
         uint prevHeadIdx = imageAtomicExchange(headIndexImage, ivec2(gl_FragCoord.xy), nodeIdx);
 
         // Store node data
-        nodes[nodeIdx].color = pushConsts.color;
+        nodes[nodeIdx].color = packUnorm4x8(pushConsts.color);
         nodes[nodeIdx].depth = gl_FragCoord.z;
         nodes[nodeIdx].next = prevHeadIdx;
+
+        // Leaves the accumulation targets unchanged
+        outAccumulation = vec4(0.0);
+        outRevealage = 0.0;
+    }
+    else
+    {
+        // The node buffer is full, fall back to weighted blended transparency (depth weight by McGuire and Bavoil)
+        atomicAdd(overflowCount, 1);
+        vec4 color = pushConsts.color;
+        float weight = clamp(color.a * max(1e-2, 3e3 * pow(1.0 - gl_FragCoord.z, 3.0)), 1e-2, 3e3);
+        outAccumulation = vec4(color.rgb * color.a, color.a) * weight;
+        outRevealage = color.a;
     }
-}
\ No newline at end of file
+}
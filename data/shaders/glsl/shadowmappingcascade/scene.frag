@@ -22,7 +22,7 @@ layout (set = 0, binding = 2) uniform UBO {
 	mat4 cascadeViewProjMat[SHADOW_MAP_CASCADE_COUNT];
 	mat4 inverseViewMat;
 	vec3 lightDir;
-	float _pad;
+	int cascadeCount;
 	int colorCascades;
 } ubo;
 
@@ -77,7 +77,7 @@ void main()
 
 	// Get cascade index for the current fragment's view position
 	uint cascadeIndex = 0;
-	for(uint i = 0; i < SHADOW_MAP_CASCADE_COUNT - 1; ++i) {
+	for(uint i = 0; i < uint(ubo.cascadeCount) - 1; ++i) {
 		if(inViewPos.z < ubo.cascadeSplits[i]) {	
 			cascadeIndex = i + 1;
 		}
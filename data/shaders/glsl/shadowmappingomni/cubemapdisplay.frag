@@ -1,6 +1,28 @@
 #version 450
 
-layout (binding = 1) uniform samplerCube shadowCubeMap;
+#define MAX_LIGHTS 32
+#define NEAR_PLANE 0.1
+
+struct Light 
+{
+	mat4 faceViewProjection[6];
+	vec4 position;
+	vec4 color;
+};
+
+layout (binding = 2) uniform UBOLights 
+{
+	Light lights[MAX_LIGHTS];
+} uboLights;
+
+layout (binding = 3) uniform samplerCubeArray shadowCubeMaps;
+
+layout(push_constant) uniform PushConsts 
+{
+	mat4 model;
+	uint light;
+	uint faceMask;
+} pushConsts;
 
 layout (location = 0) in vec2 inUV;
 
@@ -48,7 +70,10 @@ void main()
 	}
 
 	if ((samplePos.x != 0.0f) && (samplePos.y != 0.0f)) {
-		float dist = length(texture(shadowCubeMap, samplePos).xyz) * 0.005;
-		outFragColor = vec4(vec3(dist), 1.0);
+		// Linearize the depth of the selected light
+		float range = uboLights.lights[pushConsts.light].position.w;
+		float depth = texture(shadowCubeMaps, vec4(samplePos, float(pushConsts.light))).r;
+		float dist = (NEAR_PLANE * range) / (range - depth * (range - NEAR_PLANE));
+		outFragColor = vec4(vec3(dist / range), 1.0);
 	}
 }
\ No newline at end of file
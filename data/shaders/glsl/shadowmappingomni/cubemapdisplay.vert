@@ -1,12 +1,5 @@
 #version 450
 
-layout (binding = 0) uniform UBO 
-{
-	mat4 projection;
-	mat4 view;
-	mat4 model;
-} ubo;
-
 layout (location = 0) out vec2 outUV;
 
 void main() 
@@ -14,4 +7,3 @@ void main()
 	outUV = vec2((gl_VertexIndex << 1) & 2, gl_VertexIndex & 2);
 	gl_Position = vec4(outUV.xy * 2.0f - 1.0f, 0.0f, 1.0f);
 }
-
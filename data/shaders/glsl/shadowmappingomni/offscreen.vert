@@ -1,21 +1,28 @@
 #version 450
 
+#extension GL_EXT_multiview : enable
+
+#define MAX_LIGHTS 32
+
 layout (location = 0) in vec3 inPos;
 
-layout (location = 0) out vec4 outPos;
-layout (location = 1) out vec3 outLightPos;
+struct Light 
+{
+	mat4 faceViewProjection[6];
+	vec4 position;
+	vec4 color;
+};
 
-layout (binding = 0) uniform UBO 
+layout (binding = 2) uniform UBOLights 
 {
-	mat4 projection;
-	mat4 view; 
-	mat4 model;
-	vec4 lightPos;
-} ubo;
+	Light lights[MAX_LIGHTS];
+} uboLights;
 
 layout(push_constant) uniform PushConsts 
 {
-	mat4 view;
+	mat4 model;
+	uint light;
+	uint faceMask;
 } pushConsts;
  
 out gl_PerVertex 
@@ -25,8 +32,11 @@ out gl_PerVertex
  
 void main()
 {
-	gl_Position = ubo.projection * pushConsts.view * ubo.model * vec4(inPos, 1.0);
-
-	outPos = vec4(inPos, 1.0);	
-	outLightPos = ubo.lightPos.xyz; 
-}
\ No newline at end of file
+	// Each view renders one face of the light's cube map
+	if ((pushConsts.faceMask & (1u << gl_ViewIndex)) == 0u) {
+		// The draw can't reach this face, move all vertices outside of the clip volume so the triangles get culled
+		gl_Position = vec4(2.0, 2.0, 2.0, 1.0);
+		return;
+	}
+	gl_Position = uboLights.lights[pushConsts.light].faceViewProjection[gl_ViewIndex] * pushConsts.model * vec4(inPos, 1.0);
+}
@@ -1,40 +1,62 @@
 #version 450
 
-layout (binding = 1) uniform samplerCube shadowCubeMap;
+#define MAX_LIGHTS 32
+
+layout (binding = 0) uniform UBO 
+{
+	mat4 projection;
+	mat4 view;
+	ivec4 params;
+} ubo;
+
+layout (binding = 1) uniform samplerCubeArrayShadow shadowCubeMaps;
+
+struct Light 
+{
+	mat4 faceViewProjection[6];
+	vec4 position;
+	vec4 color;
+};
+
+layout (binding = 2) uniform UBOLights 
+{
+	Light lights[MAX_LIGHTS];
+} uboLights;
 
 layout (location = 0) in vec3 inNormal;
 layout (location = 1) in vec3 inColor;
-layout (location = 2) in vec3 inEyePos;
-layout (location = 3) in vec3 inLightVec;
-layout (location = 4) in vec3 inWorldPos;
-layout (location = 5) in vec3 inLightPos;
+layout (location = 2) in vec3 inWorldPos;
 
 layout (location = 0) out vec4 outFragColor;
 
-#define EPSILON 0.15
-#define SHADOW_OPACITY 0.5
+#define EPSILON 0.05
+#define NEAR_PLANE 0.1
+#define AMBIENT 0.05
 
 void main() 
 {
-	// Lighting
 	vec3 N = normalize(inNormal);
-	vec3 L = normalize(vec3(1.0));	
-	
-	vec3 Eye = normalize(-inEyePos);
-	vec3 Reflected = normalize(reflect(-inLightVec, inNormal)); 
-
-	vec4 IAmbient = vec4(vec3(0.05), 1.0);
-	vec4 IDiffuse = vec4(1.0) * max(dot(inNormal, inLightVec), 0.0);
-
-	outFragColor = vec4(IAmbient + IDiffuse * vec4(inColor, 1.0));		
-		
-	// Shadow
-	vec3 lightVec = inWorldPos - inLightPos;
-    float sampledDist = texture(shadowCubeMap, lightVec).r;
-    float dist = length(lightVec);
-
-	// Check if fragment is in shadow
-    float shadow = (dist <= sampledDist + EPSILON) ? 1.0 : SHADOW_OPACITY;
-
-	outFragColor.rgb *= shadow;
-}
\ No newline at end of file
+	vec3 color = vec3(AMBIENT);
+
+	for (int i = 0; i < ubo.params.x; i++) {
+		vec3 lightVec = inWorldPos - uboLights.lights[i].position.xyz;
+		float range = uboLights.lights[i].position.w;
+		float dist = length(lightVec);
+		if (dist >= range) {
+			continue;
+		}
+
+		vec3 L = -lightVec / dist;
+		float attenuation = 1.0 - smoothstep(0.0, range, dist);
+		float diffuse = max(dot(N, L), 0.0) * attenuation;
+
+		// The depth stored in a cube face is the distance along the face's major axis
+		float z = max(max(abs(lightVec.x), abs(lightVec.y)), abs(lightVec.z)) - EPSILON;
+		float depth = range * (z - NEAR_PLANE) / (z * (range - NEAR_PLANE));
+		float shadow = texture(shadowCubeMaps, vec4(lightVec, float(i)), depth);
+
+		color += uboLights.lights[i].color.rgb * diffuse * shadow;
+	}
+
+	outFragColor = vec4(color * inColor, 1.0);
+}
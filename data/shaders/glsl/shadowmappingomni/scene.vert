@@ -8,16 +8,19 @@ layout (binding = 0) uniform UBO
 {
 	mat4 projection;
 	mat4 view;
-	mat4 model;
-	vec4 lightPos;
+	ivec4 params;
 } ubo;
 
+layout(push_constant) uniform PushConsts 
+{
+	mat4 model;
+	uint light;
+	uint faceMask;
+} pushConsts;
+
 layout (location = 0) out vec3 outNormal;
 layout (location = 1) out vec3 outColor;
-layout (location = 2) out vec3 outEyePos;
-layout (location = 3) out vec3 outLightVec;
-layout (location = 4) out vec3 outWorldPos;
-layout (location = 5) out vec3 outLightPos;
+layout (location = 2) out vec3 outWorldPos;
 
 out gl_PerVertex 
 {
@@ -27,13 +30,7 @@ out gl_PerVertex
 void main() 
 {
 	outColor = inColor;
-	outNormal = inNormal;
-	
-	gl_Position = ubo.projection * ubo.view * ubo.model * vec4(inPos.xyz, 1.0);
-	outEyePos = vec3(ubo.model * vec4(inPos, 1.0f));
-	outLightVec = normalize(ubo.lightPos.xyz - inPos.xyz);	
-	outWorldPos = inPos;
-	
-	outLightPos = ubo.lightPos.xyz;
+	outNormal = mat3(pushConsts.model) * inNormal;
+	outWorldPos = vec3(pushConsts.model * vec4(inPos, 1.0));
+	gl_Position = ubo.projection * ubo.view * vec4(outWorldPos, 1.0);
 }
-
@@ -0,0 +1,14 @@
+#version 450
+
+// Copies the resolved occlusion into the history that is read by the next frame
+
+layout (binding = 0) uniform sampler2D samplerResolved;
+
+layout (location = 0) in vec2 inUV;
+
+layout (location = 0) out vec2 outFragColor;
+
+void main() 
+{
+	outFragColor = texture(samplerResolved, inUV).rg;
+}
@@ -15,23 +15,49 @@ layout (binding = 3) uniform UBOSSAOKernel
 layout (binding = 4) uniform UBO 
 {
 	mat4 projection;
+	int ssao;
+	int ssaoOnly;
+	int ssaoBlur;
+	int production;
+	mat4 viewToPreviousView;
+	int sampleCount;
+	uint frameIndex;
+	float temporalWeight;
+	int historyValid;
 } ubo;
 
 layout (location = 0) in vec2 inUV;
 
 layout (location = 0) out float outFragColor;
 
+// Interleaved gradient noise (Jimenez 2014), neighbouring pixels get well spread rotations that a small blur averages out
+float interleavedGradientNoise(vec2 position)
+{
+	return fract(52.9829189 * fract(dot(position, vec2(0.06711056, 0.00583715))));
+}
+
 void main() 
 {
 	// Get G-Buffer values
 	vec3 fragPos = texture(samplerPositionDepth, inUV).rgb;
 	vec3 normal = normalize(texture(samplerNormal, inUV).rgb * 2.0 - 1.0);
 
-	// Get a random vector using a noise lookup
-	ivec2 texDim = textureSize(samplerPositionDepth, 0); 
-	ivec2 noiseDim = textureSize(ssaoNoise, 0);
-	const vec2 noiseUV = vec2(float(texDim.x)/float(noiseDim.x), float(texDim.y)/(noiseDim.y)) * inUV;  
-	vec3 randomVec = texture(ssaoNoise, noiseUV).xyz * 2.0 - 1.0;
+	vec3 randomVec;
+	int sampleCount = SSAO_KERNEL_SIZE;
+	if (ubo.production == 1) {
+		// Rotate the kernel per pixel with interleaved noise that is offset every frame, so the temporal accumulation sees different samples
+		vec2 pixel = gl_FragCoord.xy + 5.588238 * float(ubo.frameIndex % 64);
+		float angle = interleavedGradientNoise(pixel) * 6.28318530718;
+		randomVec = vec3(cos(angle), sin(angle), 0.0);
+		// The kernel is ordered so that any number of leading samples covers the whole radius
+		sampleCount = clamp(ubo.sampleCount, 1, SSAO_KERNEL_SIZE);
+	} else {
+		// Get a random vector using a noise lookup
+		ivec2 texDim = textureSize(samplerPositionDepth, 0); 
+		ivec2 noiseDim = textureSize(ssaoNoise, 0);
+		const vec2 noiseUV = vec2(float(texDim.x)/float(noiseDim.x), float(texDim.y)/(noiseDim.y)) * inUV;  
+		randomVec = texture(ssaoNoise, noiseUV).xyz * 2.0 - 1.0;
+	}
 	
 	// Create TBN matrix
 	vec3 tangent = normalize(randomVec - normal * dot(randomVec, normal));
@@ -42,7 +68,7 @@ void main()
 	float occlusion = 0.0f;
 	// remove banding
 	const float bias = 0.025f;
-	for(int i = 0; i < SSAO_KERNEL_SIZE; i++)
+	for(int i = 0; i < sampleCount; i++)
 	{		
 		vec3 samplePos = TBN * uboSSAOKernel.samples[i].xyz; 
 		samplePos = fragPos + samplePos * SSAO_RADIUS; 
@@ -58,7 +84,7 @@ void main()
 		float rangeCheck = smoothstep(0.0f, 1.0f, SSAO_RADIUS / abs(fragPos.z - sampleDepth));
 		occlusion += (sampleDepth >= samplePos.z + bias ? 1.0f : 0.0f) * rangeCheck;           
 	}
-	occlusion = 1.0 - (occlusion / float(SSAO_KERNEL_SIZE));
+	occlusion = 1.0 - (occlusion / float(sampleCount));
 	
 	outFragColor = occlusion;
 }
@@ -0,0 +1,67 @@
+#version 450
+
+// Accumulates the ambient occlusion over frames, the history is reprojected with the camera movement and rejected
+// where the reprojected surface was not visible in the previous frame
+
+layout (binding = 0) uniform sampler2D samplerPositionDepth;
+layout (binding = 1) uniform sampler2D samplerSSAO;
+// r = accumulated occlusion, g = view space depth of the previous frame
+layout (binding = 2) uniform sampler2D samplerHistory;
+layout (binding = 3) uniform UBO 
+{
+	mat4 projection;
+	int ssao;
+	int ssaoOnly;
+	int ssaoBlur;
+	int production;
+	mat4 viewToPreviousView;
+	int sampleCount;
+	uint frameIndex;
+	float temporalWeight;
+	int historyValid;
+} ubo;
+
+layout (location = 0) in vec2 inUV;
+
+layout (location = 0) out vec2 outFragColor;
+
+// Relative depth difference above which the history belongs to another surface
+const float depthTolerance = 0.1;
+
+void main() 
+{
+	vec4 positionDepth = texture(samplerPositionDepth, inUV);
+	float current = texture(samplerSSAO, inUV).r;
+
+	// The history is clamped to the range of the current occlusion around the pixel, which removes stale occlusion
+	// of moving geometry that passes the depth test
+	vec2 texelSize = 1.0 / vec2(textureSize(samplerSSAO, 0));
+	float minAO = current;
+	float maxAO = current;
+	for (int y = -1; y <= 1; y++) {
+		for (int x = -1; x <= 1; x++) {
+			float ao = texture(samplerSSAO, inUV + vec2(x, y) * texelSize).r;
+			minAO = min(minAO, ao);
+			maxAO = max(maxAO, ao);
+		}
+	}
+
+	// Reproject into the previous frame
+	vec4 previousViewPos = ubo.viewToPreviousView * vec4(positionDepth.xyz, 1.0);
+	vec4 previousClip = ubo.projection * previousViewPos;
+	vec2 previousUV = previousClip.xy / previousClip.w * 0.5 + 0.5;
+
+	float result = current;
+	bool onScreen = all(greaterThanEqual(previousUV, vec2(0.0))) && all(lessThanEqual(previousUV, vec2(1.0)));
+	if ((ubo.historyValid == 1) && onScreen && (previousClip.w > 0.0)) {
+		vec2 history = texture(samplerHistory, previousUV).rg;
+		// Disocclusion: the surface stored in the history is not the one reprojected to it
+		float expectedDepth = -previousViewPos.z;
+		if (abs(history.g - expectedDepth) < depthTolerance * expectedDepth) {
+			result = mix(clamp(history.r, minAO, maxAO), current, ubo.temporalWeight);
+		}
+	}
+
+	// The view space position is exact, unlike the linearized depth in w
+	outFragColor = vec2(result, -positionDepth.z);
+}
@@ -0,0 +1,58 @@
+#version 450
+
+// Depth aware (joint bilateral) upsampling of the reduced resolution ambient occlusion
+// Every full resolution pixel filters the 4x4 closest low resolution texels, weighted by distance and by how
+// well the G-Buffer at the texel center matches the pixel, so occlusion doesn't bleed across depth discontinuities
+
+layout (binding = 0) uniform sampler2D samplerPositionDepth;
+layout (binding = 1) uniform sampler2D samplerNormal;
+layout (binding = 2) uniform sampler2D samplerSSAO;
+
+layout (location = 0) in vec2 inUV;
+
+layout (location = 0) out float outFragColor;
+
+// Relative depth difference at which the weight of a texel falls to 1/e
+const float depthSigma = 0.05;
+const float normalPower = 8.0;
+
+void main() 
+{
+	float depth = texture(samplerPositionDepth, inUV).w;
+	vec3 normal = normalize(texture(samplerNormal, inUV).rgb * 2.0 - 1.0);
+
+	vec2 lowResSize = vec2(textureSize(samplerSSAO, 0));
+	// Position relative to the low resolution texel centers
+	vec2 lowResPos = inUV * lowResSize - 0.5;
+	vec2 base = floor(lowResPos);
+	vec2 f = lowResPos - base;
+
+	float result = 0.0;
+	float weightSum = 0.0;
+	float nearest = 0.0;
+	float nearestDepthDelta = 1e30;
+	for (int y = -1; y <= 2; y++) {
+		for (int x = -1; x <= 2; x++) {
+			vec2 sampleUV = (base + vec2(x, y) + 0.5) / lowResSize;
+			float ao = texture(samplerSSAO, sampleUV).r;
+			// The occlusion of a low resolution texel was computed from the G-Buffer at its center
+			float sampleDepth = texture(samplerPositionDepth, sampleUV).w;
+			vec3 sampleNormal = normalize(texture(samplerNormal, sampleUV).rgb * 2.0 - 1.0);
+			// Tent filter over two texels, wider than bilinear to also smooth the per pixel noise of the kernel rotation
+			vec2 distance = abs(vec2(x, y) - f);
+			float spatialWeight = max(2.0 - distance.x, 0.0) * max(2.0 - distance.y, 0.0);
+			float depthDelta = abs(depth - sampleDepth);
+			float depthWeight = exp(-depthDelta / (depthSigma * max(depth, 1e-4)));
+			float normalWeight = pow(max(dot(normal, sampleNormal), 0.0), normalPower);
+			float weight = spatialWeight * depthWeight * normalWeight;
+			result += ao * weight;
+			weightSum += weight;
+			if (depthDelta < nearestDepthDelta) {
+				nearestDepthDelta = depthDelta;
+				nearest = ao;
+			}
+		}
+	}
+	// Thin features can miss all low resolution samples, the texel closest in depth is the best guess for them
+	outFragColor = (weightSum > 1e-4) ? result / weightSum : nearest;
+}
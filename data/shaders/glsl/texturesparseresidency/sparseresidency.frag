@@ -5,35 +5,52 @@
 
 layout (binding = 1) uniform sampler2D samplerColor;
 
+// One flag per virtual page, read back and cleared by the application
+layout (binding = 2) buffer Feedback
+{
+	uint requests[];
+} feedback;
+
+layout (binding = 3) uniform PageTable
+{
+	uvec4 mips[16];	// x: first page index, y: pages per row, z: pages per column
+	uvec4 info;		// xy: page extent in texels, z: first mip level in the mip tail
+} pageTable;
+
 layout (location = 0) in vec2 inUV;
 layout (location = 1) in float inLodBias;
 
 layout (location = 0) out vec4 outFragColor;
 
-void main() 
+void main()
 {
+	// Request the page of the level selected by the sampler (nearest mip mode), resident pages are requested too so they stay in the cache
+	float lod = textureQueryLod(samplerColor, inUV).y + inLodBias;
+	uint level = uint(clamp(round(lod), 0.0, float(textureQueryLevels(samplerColor) - 1)));
+	uint mipTailStart = pageTable.info.z;
+	if (level < mipTailStart) {
+		ivec2 levelSize = textureSize(samplerColor, int(level));
+		uvec2 texel = uvec2(clamp(ivec2(clamp(inUV, 0.0, 1.0) * vec2(levelSize)), ivec2(0), levelSize - 1));
+		uvec2 page = texel / pageTable.info.xy;
+		uint index = pageTable.mips[level].x + page.y * pageTable.mips[level].y + page.x;
+		// Avoid redundant stores from all fragments covering the same page
+		if (feedback.requests[index] == 0) {
+			feedback.requests[index] = 1;
+		}
+	}
+
 	vec4 color = vec4(0.0);
 
 	// Get residency code for current texel
 	int residencyCode = sparseTextureARB(samplerColor, inUV, color, inLodBias);
 
-	// Fetch sparse until we get a valid texel
-	/*
-	float minLod = 1.0;
-	while (!sparseTexelsResidentARB(residencyCode)) 
-	{
-		residencyCode = sparseTextureClampARB(samplerColor, inUV, minLod, color);
-		minLod += 1.0f;
-	}
-	*/
-
-	// Check if texel is resident
-	bool texelResident = sparseTexelsResidentARB(residencyCode);
-
-	if (!texelResident)
+	// Fall back to coarser levels until a resident texel is found, the mip tail is always resident
+	float minLod = float(level + 1);
+	while (!sparseTexelsResidentARB(residencyCode) && (minLod <= float(mipTailStart)))
 	{
-		color = vec4(0.0, 0.0, 0.0, 0.0);
+		residencyCode = sparseTextureClampARB(samplerColor, inUV, minLod, color, inLodBias);
+		minLod += 1.0;
 	}
 
 	outFragColor = color;
-}
\ No newline at end of file
+}
@@ -0,0 +1,7 @@
+// Copyright 2020 Google LLC
+
+// Occlusion query proxies only count samples, no color is written
+
+void main()
+{
+}
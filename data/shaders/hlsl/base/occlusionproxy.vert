@@ -0,0 +1,53 @@
+// Copyright 2020 Google LLC
+
+// Bounding box of a draw, rendered for its occlusion query
+
+struct Draw
+{
+	float4 boundsMin;
+	float4 boundsMax;
+	uint indexCount;
+	uint firstIndex;
+	int vertexOffset;
+	uint firstInstance;
+};
+
+StructuredBuffer<Draw> draws : register(t0);
+
+struct UBO
+{
+	float4x4 viewProjection;
+	float4x4 previousViewProjection;
+	float4 frustumPlanes[6];
+	uint drawCount;
+	uint occlusionEnabled;
+	uint pyramidLevels;
+};
+
+cbuffer ubo : register(b3) { UBO ubo; }
+
+struct PushConsts
+{
+	uint drawIndex;
+};
+
+[[vk::push_constant]]
+PushConsts pushConsts;
+
+// Corners of the twelve box triangles, bit 0 selects x, bit 1 selects y and bit 2 selects z of the maximum
+static const uint indices[36] = {
+	0u, 2u, 1u, 1u, 2u, 3u,
+	4u, 5u, 6u, 5u, 7u, 6u,
+	0u, 1u, 4u, 1u, 5u, 4u,
+	2u, 6u, 3u, 3u, 6u, 7u,
+	0u, 4u, 2u, 2u, 4u, 6u,
+	1u, 3u, 5u, 3u, 7u, 5u
+};
+
+float4 main(uint VertexIndex : SV_VertexID) : SV_POSITION
+{
+	uint corner = indices[VertexIndex];
+	Draw draw = draws[pushConsts.drawIndex];
+	float3 pos = lerp(draw.boundsMin.xyz, draw.boundsMax.xyz, float3((corner & 1u) != 0, (corner & 2u) != 0, (corner & 4u) != 0));
+	return mul(ubo.viewProjection, float4(pos, 1.0));
+}
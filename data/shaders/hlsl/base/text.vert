@@ -0,0 +1,39 @@
+// Copyright 2020 Google LLC
+
+// Per glyph instance, the quad is generated from the vertex index
+struct VSInput
+{
+	[[vk::location(0)]]float4 Rect : POSITION0;
+	[[vk::location(1)]]float4 UV : TEXCOORD0;
+	[[vk::location(2)]]float4 Color : COLOR0;
+	[[vk::location(3)]]float4 OutlineColor : COLOR1;
+};
+
+struct VSOutput
+{
+	float4 Pos : SV_POSITION;
+	[[vk::location(0)]]float2 UV : TEXCOORD0;
+	[[vk::location(1)]]float4 Color : COLOR0;
+	[[vk::location(2)]]float4 OutlineColor : COLOR1;
+};
+
+struct PushConstants
+{
+	float2 scale;
+	float outlineWidth;
+};
+
+[[vk::push_constant]]
+PushConstants pushConstants;
+
+VSOutput main(VSInput input, uint VertexIndex : SV_VertexID)
+{
+	VSOutput output = (VSOutput)0;
+	float2 corner = float2(VertexIndex & 1, (VertexIndex >> 1) & 1);
+	float2 pos = input.Rect.xy + corner * input.Rect.zw;
+	output.UV = lerp(input.UV.xy, input.UV.zw, corner);
+	output.Color = input.Color;
+	output.OutlineColor = input.OutlineColor;
+	output.Pos = float4(pos * pushConstants.scale - 1.0, 0.0, 1.0);
+	return output;
+}
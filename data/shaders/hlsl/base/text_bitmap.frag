@@ -0,0 +1,16 @@
+// Copyright 2020 Google LLC
+
+Texture2D textureFont : register(t0);
+SamplerState samplerFont : register(s0);
+
+struct VSOutput
+{
+	[[vk::location(0)]]float2 UV : TEXCOORD0;
+	[[vk::location(1)]]float4 Color : COLOR0;
+	[[vk::location(2)]]float4 OutlineColor : COLOR1;
+};
+
+float4 main(VSOutput input) : SV_TARGET
+{
+	return float4(input.Color.rgb, input.Color.a * textureFont.Sample(samplerFont, input.UV).a);
+}
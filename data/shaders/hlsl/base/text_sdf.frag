@@ -0,0 +1,38 @@
+// Copyright 2020 Google LLC
+
+Texture2D textureFont : register(t0);
+SamplerState samplerFont : register(s0);
+
+struct PushConstants
+{
+	float2 scale;
+	float outlineWidth;
+};
+
+[[vk::push_constant]]
+PushConstants pushConstants;
+
+struct VSOutput
+{
+	[[vk::location(0)]]float2 UV : TEXCOORD0;
+	[[vk::location(1)]]float4 Color : COLOR0;
+	[[vk::location(2)]]float4 OutlineColor : COLOR1;
+};
+
+float4 main(VSOutput input) : SV_TARGET
+{
+	float distance = textureFont.Sample(samplerFont, input.UV).a;
+	float smoothWidth = fwidth(distance);
+	float alpha = smoothstep(0.5 - smoothWidth, 0.5 + smoothWidth, distance);
+	float4 color = float4(input.Color.rgb, input.Color.a * alpha);
+
+	// The outline covers the distance band of the given width outside of the glyph
+	if (input.OutlineColor.a > 0.0)
+	{
+		float edge = 0.5 - pushConstants.outlineWidth;
+		float outlineAlpha = smoothstep(edge - smoothWidth, edge + smoothWidth, distance);
+		color = float4(lerp(input.OutlineColor.rgb, input.Color.rgb, alpha), lerp(input.OutlineColor.a * outlineAlpha, input.Color.a, alpha));
+	}
+
+	return color;
+}
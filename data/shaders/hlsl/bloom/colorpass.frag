@@ -3,6 +3,9 @@
 Texture2D colorMapTexture : register(t1);
 SamplerState colorMapSampler : register(s1);
 
+// Scales the glow color above the bloom threshold
+[[vk::constant_id(0)]] const float EMISSIVE_STRENGTH = 1.0;
+
 struct VSOutput
 {
 	[[vk::location(0)]]float3 Color : COLOR0;
@@ -11,5 +14,5 @@ struct VSOutput
 
 float4 main(VSOutput input) : SV_TARGET
 {
-	return float4(input.Color, 1);
-}
\ No newline at end of file
+	return float4(input.Color * EMISSIVE_STRENGTH, 1);
+}
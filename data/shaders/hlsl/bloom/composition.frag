@@ -0,0 +1,30 @@
+// Copyright 2020 Google LLC
+
+Texture2D textureScene : register(t0);
+SamplerState samplerScene : register(s0);
+Texture2D textureBloom : register(t1);
+SamplerState samplerBloom : register(s1);
+
+struct UBO
+{
+	float threshold;
+	float knee;
+	float radius;
+	float intensity;
+};
+
+cbuffer ubo : register(b2) { UBO ubo; }
+
+struct PushConsts
+{
+	// Zero if bloom is disabled
+	float bloomScale;
+};
+[[vk::push_constant]] PushConsts pushConsts;
+
+float4 main([[vk::location(0)]] float2 inUV : TEXCOORD0) : SV_TARGET
+{
+	float3 color = textureScene.Sample(samplerScene, inUV).rgb;
+	float3 bloom = textureBloom.Sample(samplerBloom, inUV).rgb;
+	return float4(color + bloom * ubo.intensity * pushConsts.bloomScale, 1.0);
+}
@@ -27,12 +27,20 @@ cbuffer ubo : register(b0)
 	UBO ubo;
 };
 
+struct PushConsts
+{
+	float4 offset;
+};
+
+[[vk::push_constant]]
+PushConsts pushConsts;
+
 VSOutput main (VSInput input)
 {
 	VSOutput output = (VSOutput)0;
-	float4 eyePos = mul(ubo.modelview, float4(input.Pos.x, input.Pos.y, input.Pos.z, 1.0));
+	float4 pos = float4(input.Pos + pushConsts.offset.xyz, 1.0);
+	float4 eyePos = mul(ubo.modelview, pos);
 	output.Pos = mul(ubo.projection, eyePos);
-	float4 pos = float4(input.Pos, 1.0);
 	float3 lPos = ubo.lightPos.xyz;
 	output.LightVec = lPos - pos.xyz;
 	output.ViewVec = -pos.xyz;
@@ -1,34 +1,66 @@
 // Copyright 2020 Google LLC
 
-Texture2D textureposition : register(t1);
-SamplerState samplerposition : register(s1);
-Texture2D textureNormal : register(t2);
-SamplerState samplerNormal : register(s2);
-Texture2D textureAlbedo : register(t3);
-SamplerState samplerAlbedo : register(s3);
+// The G-buffer is written by the previous subpass and read at the current pixel
+[[vk::input_attachment_index(0)]][[vk::binding(1)]] SubpassInput inputPosition;
+[[vk::input_attachment_index(1)]][[vk::binding(2)]] SubpassInput inputNormal;
+[[vk::input_attachment_index(2)]][[vk::binding(3)]] SubpassInput inputAlbedo;
 
 struct Light {
-	float4 position;
-	float3 color;
-	float radius;
+	float4 position;	// xyz = position, w = radius
+	float4 color;
 };
 
 struct UBO
 {
-	Light lights[6];
+	float4x4 view;
+	float4x4 projection;
 	float4 viewPos;
+	uint4 gridSize;		// xyz = cluster count, w = light count
+	float4 sliceParams;	// x = slice scale, y = slice bias, z = near plane, w = far plane
+	float2 screenSize;
+	float radiusScale;
+	float time;
 	int displayDebugTarget;
+	uint maxLightIndices;
 };
 
-cbuffer ubo : register(b4) { UBO ubo; }
+cbuffer ubo : register(b0, space1) { UBO ubo; }
 
+StructuredBuffer<Light> lights : register(t2, space1);
+// x = first light index, y = light count
+StructuredBuffer<uint2> clusterGrid : register(t5, space1);
+StructuredBuffer<uint> lightIndices : register(t6, space1);
 
-float4 main([[vk::location(0)]] float2 inUV : TEXCOORD0) : SV_TARGET
+uint clusterIndex(float3 worldPos, float2 fragCoord)
+{
+	float depth = -mul(ubo.view, float4(worldPos, 1.0)).z;
+	uint2 tile = min(uint2(fragCoord / ubo.screenSize * float2(ubo.gridSize.xy)), ubo.gridSize.xy - 1);
+	uint slice = uint(clamp(int(floor(log(depth) * ubo.sliceParams.x + ubo.sliceParams.y)), 0, int(ubo.gridSize.z) - 1));
+	return tile.x + tile.y * ubo.gridSize.x + slice * ubo.gridSize.x * ubo.gridSize.y;
+}
+
+// Inverse square falloff windowed to reach zero at the light radius, lights are only binned into the clusters they reach
+float attenuation(float dist, float radius)
+{
+	float x = dist / radius;
+	float window = saturate(1.0 - x * x * x * x);
+	return window * window / (dist * dist + 1.0);
+}
+
+float4 main([[vk::location(0)]] float2 inUV : TEXCOORD0, float4 fragCoord : SV_Position) : SV_TARGET
 {
 	// Get G-Buffer values
-	float3 fragPos = textureposition.Sample(samplerposition, inUV).rgb;
-	float3 normal = textureNormal.Sample(samplerNormal, inUV).rgb;
-	float4 albedo = textureAlbedo.Sample(samplerAlbedo, inUV);
+	float4 position = inputPosition.SubpassLoad();
+	float3 fragPos = position.rgb;
+	float3 normal = inputNormal.SubpassLoad().rgb;
+	float4 albedo = inputAlbedo.SubpassLoad();
+
+	// Nothing has been written to the G-buffer at the background
+	if (position.a == 0.0) {
+		return float4(0.0, 0.0, 0.0, 0.0);
+	}
+
+	uint2 cluster = clusterGrid[clusterIndex(fragPos, fragCoord.xy)];
 
 	float3 fragcolor;
 
@@ -47,49 +79,54 @@ float4 main([[vk::location(0)]] float2 inUV : TEXCOORD0) : SV_TARGET
 			case 4: 
 				fragcolor.rgb = albedo.aaa;
 				break;
+			case 5:
+				// Lights per cluster, blue to red at 64
+				fragcolor.rgb = lerp(float3(0.0, 0.0, 1.0), float3(1.0, 0.0, 0.0), min(float(cluster.y) / 64.0, 1.0)) * min(float(cluster.y), 1.0);
+				break;
 		}		
 		return float4(fragcolor, 1.0);
 	}
 
-	#define lightCount 6
 	#define ambient 0.0
 
 	// Ambient part
 	fragcolor = albedo.rgb * ambient;
 
-	for(int i = 0; i < lightCount; ++i)
+	// Viewer to fragment
+	float3 V = normalize(ubo.viewPos.xyz - fragPos);
+	float3 N = normalize(normal);
+
+	// Only the lights binned into the cluster of the fragment
+	for (uint i = 0; i < cluster.y; ++i)
 	{
+		Light light = lights[lightIndices[cluster.x + i]];
+
 		// Vector to light
-		float3 L = ubo.lights[i].position.xyz - fragPos;
+		float3 L = light.position.xyz - fragPos;
 		// Distance from light to fragment position
 		float dist = length(L);
+		if (dist >= light.position.w) {
+			continue;
+		}
 
-		// Viewer to fragment
-		float3 V = ubo.viewPos.xyz - fragPos;
-		V = normalize(V);
-
-		//if(dist < ubo.lights[i].radius)
-		{
-			// Light to fragment
-			L = normalize(L);
+		// Light to fragment
+		L = normalize(L);
 
-			// Attenuation
-			float atten = ubo.lights[i].radius / (pow(dist, 2.0) + 1.0);
+		// Attenuation
+		float atten = attenuation(dist, light.position.w);
 
-			// Diffuse part
-			float3 N = normalize(normal);
-			float NdotL = max(0.0, dot(N, L));
-			float3 diff = ubo.lights[i].color * albedo.rgb * NdotL * atten;
+		// Diffuse part
+		float NdotL = max(0.0, dot(N, L));
+		float3 diff = light.color.rgb * albedo.rgb * NdotL * atten;
 
-			// Specular part
-			// Specular map values are stored in alpha of albedo mrt
-			float3 R = reflect(-L, N);
-			float NdotR = max(0.0, dot(R, V));
-			float3 spec = ubo.lights[i].color * albedo.a * pow(NdotR, 16.0) * atten;
+		// Specular part
+		// Specular map values are stored in alpha of albedo mrt
+		float3 R = reflect(-L, N);
+		float NdotR = max(0.0, dot(R, V));
+		float3 spec = light.color.rgb * albedo.a * pow(NdotR, 16.0) * atten;
 
-			fragcolor += diff + spec;
-		}
+		fragcolor += diff + spec;
 	}
 
   return float4(fragcolor, 1.0);
-}
\ No newline at end of file
+}
@@ -0,0 +1,155 @@
+// Copyright 2020 Google LLC
+
+// The G-buffer is written by the previous subpass and read at the current pixel, the position is reconstructed from depth
+[[vk::input_attachment_index(0)]][[vk::binding(1)]] SubpassInput inputDepth;
+[[vk::input_attachment_index(1)]][[vk::binding(2)]] SubpassInput inputNormal;
+[[vk::input_attachment_index(2)]][[vk::binding(3)]] SubpassInput inputAlbedo;
+
+struct Light {
+	float4 position;	// xyz = position, w = radius
+	float4 color;
+};
+
+struct UBO
+{
+	float4x4 view;
+	float4x4 projection;
+	float4 viewPos;
+	uint4 gridSize;		// xyz = cluster count, w = light count
+	float4 sliceParams;	// x = slice scale, y = slice bias, z = near plane, w = far plane
+	float2 screenSize;
+	float radiusScale;
+	float time;
+	int displayDebugTarget;
+	uint maxLightIndices;
+};
+
+cbuffer ubo : register(b0, space1) { UBO ubo; }
+
+StructuredBuffer<Light> lights : register(t2, space1);
+// x = first light index, y = light count
+StructuredBuffer<uint2> clusterGrid : register(t5, space1);
+StructuredBuffer<uint> lightIndices : register(t6, space1);
+
+uint clusterIndex(float3 worldPos, float2 fragCoord)
+{
+	float depth = -mul(ubo.view, float4(worldPos, 1.0)).z;
+	uint2 tile = min(uint2(fragCoord / ubo.screenSize * float2(ubo.gridSize.xy)), ubo.gridSize.xy - 1);
+	uint slice = uint(clamp(int(floor(log(depth) * ubo.sliceParams.x + ubo.sliceParams.y)), 0, int(ubo.gridSize.z) - 1));
+	return tile.x + tile.y * ubo.gridSize.x + slice * ubo.gridSize.x * ubo.gridSize.y;
+}
+
+float3 octDecode(float2 e)
+{
+	e = e * 2.0 - 1.0;
+	float3 n = float3(e, 1.0 - abs(e.x) - abs(e.y));
+	if (n.z < 0.0) {
+		float2 signs = float2(n.x >= 0.0 ? 1.0 : -1.0, n.y >= 0.0 ? 1.0 : -1.0);
+		n.xy = (1.0 - abs(n.yx)) * signs;
+	}
+	return normalize(n);
+}
+
+// The projection has no off-center terms, so the view space position follows from its diagonal and the window position
+float3 worldPosition(float depth, float2 fragCoord)
+{
+	float2 ndc = fragCoord / ubo.screenSize * 2.0 - 1.0;
+	float viewZ = -ubo.projection[2][3] / (depth + ubo.projection[2][2]);
+	float3 viewPos = float3(ndc * -viewZ / float2(ubo.projection[0][0], ubo.projection[1][1]), viewZ);
+	// The view matrix is a rigid transform, multiplying from the left applies its transposed (inverse) rotation
+	float3 translation = float3(ubo.view[0][3], ubo.view[1][3], ubo.view[2][3]);
+	return mul(viewPos - translation, (float3x3)ubo.view);
+}
+
+// Inverse square falloff windowed to reach zero at the light radius, lights are only binned into the clusters they reach
+float attenuation(float dist, float radius)
+{
+	float x = dist / radius;
+	float window = saturate(1.0 - x * x * x * x);
+	return window * window / (dist * dist + 1.0);
+}
+
+float4 main([[vk::location(0)]] float2 inUV : TEXCOORD0, float4 fragCoord : SV_Position) : SV_TARGET
+{
+	// Get G-Buffer values
+	float depth = inputDepth.SubpassLoad().r;
+
+	// Nothing has been written to the G-buffer at the background
+	if (depth == 1.0) {
+		return float4(0.0, 0.0, 0.0, 0.0);
+	}
+
+	float3 fragPos = worldPosition(depth, fragCoord.xy);
+	float3 normal = octDecode(inputNormal.SubpassLoad().rg);
+	float4 albedo = inputAlbedo.SubpassLoad();
+
+	uint2 cluster = clusterGrid[clusterIndex(fragPos, fragCoord.xy)];
+
+	float3 fragcolor;
+
+	// Debug display
+	if (ubo.displayDebugTarget > 0) {
+		switch (ubo.displayDebugTarget) {
+			case 1: 
+				fragcolor.rgb = fragPos;
+				break;
+			case 2: 
+				fragcolor.rgb = normal;
+				break;
+			case 3: 
+				fragcolor.rgb = albedo.rgb;
+				break;
+			case 4: 
+				fragcolor.rgb = albedo.aaa;
+				break;
+			case 5:
+				// Lights per cluster, blue to red at 64
+				fragcolor.rgb = lerp(float3(0.0, 0.0, 1.0), float3(1.0, 0.0, 0.0), min(float(cluster.y) / 64.0, 1.0)) * min(float(cluster.y), 1.0);
+				break;
+		}		
+		return float4(fragcolor, 1.0);
+	}
+
+	#define ambient 0.0
+
+	// Ambient part
+	fragcolor = albedo.rgb * ambient;
+
+	// Viewer to fragment
+	float3 V = normalize(ubo.viewPos.xyz - fragPos);
+	float3 N = normalize(normal);
+
+	// Only the lights binned into the cluster of the fragment
+	for (uint i = 0; i < cluster.y; ++i)
+	{
+		Light light = lights[lightIndices[cluster.x + i]];
+
+		// Vector to light
+		float3 L = light.position.xyz - fragPos;
+		// Distance from light to fragment position
+		float dist = length(L);
+		if (dist >= light.position.w) {
+			continue;
+		}
+
+		// Light to fragment
+		L = normalize(L);
+
+		// Attenuation
+		float atten = attenuation(dist, light.position.w);
+
+		// Diffuse part
+		float NdotL = max(0.0, dot(N, L));
+		float3 diff = light.color.rgb * albedo.rgb * NdotL * atten;
+
+		// Specular part
+		// Specular map values are stored in alpha of albedo mrt
+		float3 R = reflect(-L, N);
+		float NdotR = max(0.0, dot(R, V));
+		float3 spec = light.color.rgb * albedo.a * pow(NdotR, 16.0) * atten;
+
+		fragcolor += diff + spec;
+	}
+
+  return float4(fragcolor, 1.0);
+}
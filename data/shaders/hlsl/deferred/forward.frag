@@ -0,0 +1,127 @@
+// Copyright 2020 Google LLC
+
+// Forward+ shading of the scene with the same light clusters as the deferred composition
+
+Texture2D textureColor : register(t1);
+SamplerState samplerColor : register(s1);
+Texture2D textureNormalMap : register(t2);
+SamplerState samplerNormalMap : register(s2);
+
+struct Light {
+	float4 position;	// xyz = position, w = radius
+	float4 color;
+};
+
+struct UBO
+{
+	float4x4 view;
+	float4x4 projection;
+	float4 viewPos;
+	uint4 gridSize;		// xyz = cluster count, w = light count
+	float4 sliceParams;	// x = slice scale, y = slice bias, z = near plane, w = far plane
+	float2 screenSize;
+	float radiusScale;
+	float time;
+	int displayDebugTarget;
+	uint maxLightIndices;
+};
+
+cbuffer ubo : register(b0, space1) { UBO ubo; }
+
+StructuredBuffer<Light> lights : register(t2, space1);
+// x = first light index, y = light count
+StructuredBuffer<uint2> clusterGrid : register(t5, space1);
+StructuredBuffer<uint> lightIndices : register(t6, space1);
+
+struct VSOutput
+{
+	float4 Pos : SV_POSITION;
+[[vk::location(0)]] float3 Normal : NORMAL0;
+[[vk::location(1)]] float2 UV : TEXCOORD0;
+[[vk::location(2)]] float3 Color : COLOR0;
+[[vk::location(3)]] float3 WorldPos : POSITION0;
+[[vk::location(4)]] float3 Tangent : TEXCOORD1;
+};
+
+uint clusterIndex(float3 worldPos, float2 fragCoord)
+{
+	float depth = -mul(ubo.view, float4(worldPos, 1.0)).z;
+	uint2 tile = min(uint2(fragCoord / ubo.screenSize * float2(ubo.gridSize.xy)), ubo.gridSize.xy - 1);
+	uint slice = uint(clamp(int(floor(log(depth) * ubo.sliceParams.x + ubo.sliceParams.y)), 0, int(ubo.gridSize.z) - 1));
+	return tile.x + tile.y * ubo.gridSize.x + slice * ubo.gridSize.x * ubo.gridSize.y;
+}
+
+// Inverse square falloff windowed to reach zero at the light radius, lights are only binned into the clusters they reach
+float attenuation(float dist, float radius)
+{
+	float x = dist / radius;
+	float window = saturate(1.0 - x * x * x * x);
+	return window * window / (dist * dist + 1.0);
+}
+
+float4 main(VSOutput input) : SV_TARGET
+{
+	// Calculate normal in tangent space
+	float3 N = normalize(input.Normal);
+	float3 T = normalize(input.Tangent);
+	float3 B = cross(N, T);
+	float3x3 TBN = float3x3(T, B, N);
+	N = mul(normalize(textureNormalMap.Sample(samplerNormalMap, input.UV).xyz * 2.0 - float3(1.0, 1.0, 1.0)), TBN);
+	float4 albedo = textureColor.Sample(samplerColor, input.UV);
+
+	uint2 cluster = clusterGrid[clusterIndex(input.WorldPos, input.Pos.xy)];
+
+	float3 fragcolor;
+
+	// Debug display
+	if (ubo.displayDebugTarget > 0) {
+		switch (ubo.displayDebugTarget) {
+			case 1:
+				fragcolor.rgb = input.WorldPos;
+				break;
+			case 2:
+				fragcolor.rgb = N;
+				break;
+			case 3:
+				fragcolor.rgb = albedo.rgb;
+				break;
+			case 4:
+				fragcolor.rgb = albedo.aaa;
+				break;
+			case 5:
+				// Lights per cluster, blue to red at 64
+				fragcolor.rgb = lerp(float3(0.0, 0.0, 1.0), float3(1.0, 0.0, 0.0), min(float(cluster.y) / 64.0, 1.0)) * min(float(cluster.y), 1.0);
+				break;
+		}
+		return float4(fragcolor, 1.0);
+	}
+
+	fragcolor = float3(0.0, 0.0, 0.0);
+	float3 V = normalize(ubo.viewPos.xyz - input.WorldPos);
+	N = normalize(N);
+
+	for (uint i = 0; i < cluster.y; ++i)
+	{
+		Light light = lights[lightIndices[cluster.x + i]];
+		float3 L = light.position.xyz - input.WorldPos;
+		float dist = length(L);
+		if (dist >= light.position.w) {
+			continue;
+		}
+		L = normalize(L);
+		float atten = attenuation(dist, light.position.w);
+
+		// Diffuse part
+		float NdotL = max(0.0, dot(N, L));
+		float3 diff = light.color.rgb * albedo.rgb * NdotL * atten;
+
+		// Specular part, specular map values are stored in the alpha channel of the color map
+		float3 R = reflect(-L, N);
+		float NdotR = max(0.0, dot(R, V));
+		float3 spec = light.color.rgb * albedo.a * pow(NdotR, 16.0) * atten;
+
+		fragcolor += diff + spec;
+	}
+
+	return float4(fragcolor, 1.0);
+}
@@ -27,6 +27,8 @@ struct Light
 struct UBO
 {
 	float4 viewPos;
+	float4x4 view;
+	float4x4 projection;
 	Light lights[LIGHT_COUNT];
 	int useShadows;
 	int displayDebugTarget;
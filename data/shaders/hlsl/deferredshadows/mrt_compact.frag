@@ -0,0 +1,48 @@
+// Copyright 2020 Google LLC
+
+Texture2D textureColor : register(t1);
+SamplerState samplerColor : register(s1);
+Texture2D textureNormalMap : register(t2);
+SamplerState samplerNormalMap : register(s2);
+
+struct VSOutput
+{
+[[vk::location(0)]] float3 Normal : NORMAL0;
+[[vk::location(1)]] float2 UV : TEXCOORD0;
+[[vk::location(2)]] float3 Color : COLOR0;
+[[vk::location(3)]] float3 WorldPos : POSITION0;
+[[vk::location(4)]] float3 Tangent : TEXCOORD1;
+};
+
+// The position is reconstructed from depth, so only normal and albedo are stored
+struct FSOutput
+{
+	float4 Normal : SV_TARGET0;
+	float4 Albedo : SV_TARGET1;
+};
+
+// Maps the unit sphere onto an octahedron unfolded into the unit square, two channels keep the full direction
+float2 octEncode(float3 n)
+{
+	n /= abs(n.x) + abs(n.y) + abs(n.z);
+	float2 signs = float2(n.x >= 0.0 ? 1.0 : -1.0, n.y >= 0.0 ? 1.0 : -1.0);
+	float2 e = (n.z >= 0.0) ? n.xy : (1.0 - abs(n.yx)) * signs;
+	return e * 0.5 + 0.5;
+}
+
+FSOutput main(VSOutput input)
+{
+	FSOutput output = (FSOutput)0;
+	// Calculate normal in tangent space
+	float3 N = normalize(input.Normal);
+	float3 T = normalize(input.Tangent);
+	float3 B = cross(N, T);
+	float3x3 TBN = float3x3(T, B, N);
+	float3 tnorm = mul(normalize(textureNormalMap.Sample(samplerNormalMap, input.UV).xyz * 2.0 - float3(1.0, 1.0, 1.0)), TBN);
+	// Blue and alpha are left for further material parameters
+	output.Normal = float4(octEncode(normalize(tnorm)), 0.0, 0.0);
+
+	// Specular intensity is stored in the alpha channel
+	output.Albedo = textureColor.Sample(samplerColor, input.UV);
+	return output;
+}
\ No newline at end of file
@@ -12,6 +12,7 @@ struct UBO
 {
 	float4x4 projection;
 	float4x4 modelview;
+	float groundScale;
 };
 
 cbuffer ubo : register(b0) { UBO ubo; }
@@ -25,7 +26,8 @@ struct VSOutput
 VSOutput main(VSInput input)
 {
 	VSOutput output = (VSOutput)0;
-	output.UV = input.UV * 32.0;
-	output.Pos = mul(ubo.projection, mul(ubo.modelview, float4(input.Pos.xyz, 1.0)));
+	// The plane is scaled to the plant field, the texture keeps its size
+	output.UV = input.UV * 32.0 * ubo.groundScale;
+	output.Pos = mul(ubo.projection, mul(ubo.modelview, float4(input.Pos.xyz * float3(ubo.groundScale, 1.0, ubo.groundScale), 1.0)));
 	return output;
 }
@@ -69,7 +69,9 @@ VSOutput main(VSInput input)
 
 	output.Normal = mul((float4x3)rotMat, input.Normal).xyz;
 
-	float4 pos = mul(rotMat, float4((input.Pos.xyz * input.instanceScale) + input.instancePos, 1.0));
+	// Rotate around the instance's own origin, the instance grid culls the plants at their positions
+	float4 pos = mul(rotMat, float4(input.Pos.xyz * input.instanceScale, 1.0));
+	pos.xyz += input.instancePos;
 
 	output.Pos = mul(ubo.projection, mul(ubo.modelview, pos));
 
@@ -4,25 +4,17 @@ struct VSOutput
 {
 [[vk::location(0)]] float3 Normal : NORMAL0;
 [[vk::location(1)]] float3 Color : COLOR0;
-[[vk::location(2)]] float Visible : TEXCOORD3;
-[[vk::location(3)]] float3 ViewVec : TEXCOORD1;
-[[vk::location(4)]] float3 LightVec : TEXCOORD2;
+[[vk::location(2)]] float3 ViewVec : TEXCOORD1;
+[[vk::location(3)]] float3 LightVec : TEXCOORD2;
 };
 
 float4 main(VSOutput input) : SV_TARGET
 {
-	if (input.Visible > 0.0)
-	{
-		float3 N = normalize(input.Normal);
-		float3 L = normalize(input.LightVec);
-		float3 V = normalize(input.ViewVec);
-		float3 R = reflect(-L, N);
-		float3 diffuse = max(dot(N, L), 0.0) * input.Color;
-		float3 specular = pow(max(dot(R, V), 0.0), 8.0) * float3(0.75, 0.75, 0.75);
-		return float4(diffuse + specular, 1.0);
-	}
-	else
-	{
-		return float4(float3(0.1, 0.1, 0.1), 1.0);
-	}
-}
\ No newline at end of file
+	float3 N = normalize(input.Normal);
+	float3 L = normalize(input.LightVec);
+	float3 V = normalize(input.ViewVec);
+	float3 R = reflect(-L, N);
+	float3 diffuse = max(dot(N, L), 0.25) * input.Color;
+	float3 specular = pow(max(dot(R, V), 0.0), 8.0) * float3(0.75, 0.75, 0.75);
+	return float4(diffuse + specular, 1.0);
+}
@@ -5,14 +5,19 @@ struct VSInput
 [[vk::location(0)]] float3 Pos : POSITION0;
 [[vk::location(1)]] float3 Normal : NORMAL0;
 [[vk::location(2)]] float3 Color : COLOR0;
+// Per instance attributes
+[[vk::location(3)]] float4 InstanceModel0 : TEXCOORD3;
+[[vk::location(4)]] float4 InstanceModel1 : TEXCOORD4;
+[[vk::location(5)]] float4 InstanceModel2 : TEXCOORD5;
+[[vk::location(6)]] float4 InstanceModel3 : TEXCOORD6;
+[[vk::location(7)]] float4 InstanceColor : COLOR1;
 };
 
 struct UBO
 {
 	float4x4 projection;
-	float4x4 modelview;
+	float4x4 view;
 	float4 lightPos;
-	float visible;
 };
 
 cbuffer ubo : register(b0) { UBO ubo; }
@@ -22,23 +27,21 @@ struct VSOutput
 	float4 Pos : SV_POSITION;
 [[vk::location(0)]] float3 Normal : NORMAL0;
 [[vk::location(1)]] float3 Color : COLOR0;
-[[vk::location(2)]] float Visible : TEXCOORD3;
-[[vk::location(3)]] float3 ViewVec : TEXCOORD1;
-[[vk::location(4)]] float3 LightVec : TEXCOORD2;
+[[vk::location(2)]] float3 ViewVec : TEXCOORD1;
+[[vk::location(3)]] float3 LightVec : TEXCOORD2;
 };
 
 VSOutput main(VSInput input)
 {
 	VSOutput output = (VSOutput)0;
-	output.Normal = input.Normal;
-	output.Color = input.Color;
-	output.Visible = ubo.visible;
+	float4x4 model = transpose(float4x4(input.InstanceModel0, input.InstanceModel1, input.InstanceModel2, input.InstanceModel3));
+	output.Color = input.Color * input.InstanceColor.rgb;
 
-	output.Pos = mul(ubo.projection, mul(ubo.modelview, float4(input.Pos.xyz, 1.0)));
+	float4 pos = mul(model, float4(input.Pos, 1.0));
+	output.Pos = mul(ubo.projection, mul(ubo.view, pos));
 
-    float4 pos = mul(ubo.modelview, float4(input.Pos, 1.0));
-    output.Normal = mul((float3x3)ubo.modelview, input.Normal);
-    output.LightVec = ubo.lightPos.xyz - pos.xyz;
-    output.ViewVec = -pos.xyz;
+	output.Normal = mul((float3x3)model, input.Normal);
+	output.LightVec = ubo.lightPos.xyz - pos.xyz;
+	output.ViewVec = -pos.xyz;
 	return output;
-}
\ No newline at end of file
+}
@@ -1,9 +1,19 @@
 // Copyright 2020 Google LLC
 
+struct VSInput
+{
+[[vk::location(0)]] float3 Pos : POSITION0;
+// Per instance attributes
+[[vk::location(3)]] float4 InstanceModel0 : TEXCOORD3;
+[[vk::location(4)]] float4 InstanceModel1 : TEXCOORD4;
+[[vk::location(5)]] float4 InstanceModel2 : TEXCOORD5;
+[[vk::location(6)]] float4 InstanceModel3 : TEXCOORD6;
+};
+
 struct UBO
 {
 	float4x4 projection;
-	float4x4 modelview;
+	float4x4 view;
 	float4 lightPos;
 };
 
@@ -15,9 +25,10 @@ struct VSOutput
 [[vk::location(0)]] float3 Color : COLOR0;
 };
 
-VSOutput main([[vk::location(0)]] float3 Pos : POSITION0)
+VSOutput main(VSInput input)
 {
 	VSOutput output = (VSOutput)0;
-	output.Pos = mul(ubo.projection, mul(ubo.modelview, float4(Pos.xyz, 1.0)));
+	float4x4 model = transpose(float4x4(input.InstanceModel0, input.InstanceModel1, input.InstanceModel2, input.InstanceModel3));
+	output.Pos = mul(ubo.projection, mul(ubo.view, mul(model, float4(input.Pos.xyz, 1.0))));
 	return output;
-}
\ No newline at end of file
+}
@@ -1,6 +1,9 @@
 // Copyright 2020 Sascha Willems
 
-#define MAX_FRAGMENT_COUNT 128
+// Must match MAX_K_BUFFER_SIZE in oit.cpp
+#define MAX_K_BUFFER_SIZE 16
+// Bounds the list traversal in case of very deep lists
+#define MAX_LIST_LENGTH 1024
 
 struct VSOutput
 {
@@ -9,56 +12,102 @@ struct VSOutput
 
 struct Node
 {
-    float4 color;
+    uint color;
     float depth;
     uint next;
 };
 
 RWTexture2D<uint> headIndexImage : register(u0);
 
-struct Particle
-{
-	float2 pos;
-	float2 vel;
-	float4 gradientPos;
-};
-
 // Binding 0 : Position storage buffer
 RWStructuredBuffer<Node> nodes : register(u1);
 
+Texture2D textureAccumulation : register(t2);
+SamplerState samplerAccumulation : register(s2);
+Texture2D textureRevealage : register(t3);
+SamplerState samplerRevealage : register(s3);
+
+struct PushConsts {
+	uint kBufferSize;
+};
+[[vk::push_constant]] PushConsts pushConsts;
+
+float4 unpackUnorm4x8(uint value)
+{
+    return float4(value & 0xff, (value >> 8) & 0xff, (value >> 16) & 0xff, value >> 24) / 255.0;
+}
+
 float4 main(VSOutput input) : SV_TARGET
 {
-    Node fragments[MAX_FRAGMENT_COUNT];
-    int count = 0;
+    // The k nearest fragments are kept sorted front to back, all other fragments are merged into an order independent tail
+    uint kColors[MAX_K_BUFFER_SIZE];
+    float kDepths[MAX_K_BUFFER_SIZE];
+    uint count = 0;
+    uint kSize = clamp(pushConsts.kBufferSize, 1, MAX_K_BUFFER_SIZE);
+    float4 tailAccumulation = float4(0.0, 0.0, 0.0, 0.0);
+    float tailRevealage = 1.0;
 
     uint nodeIdx = headIndexImage[uint2(input.Pos.xy)].r;
 
-    while (nodeIdx != 0xffffffff && count < MAX_FRAGMENT_COUNT)
-    {
-        fragments[count] = nodes[nodeIdx];
-        nodeIdx = fragments[count].next;
-        ++count;
-    }
-    
-    // Do the insertion sort
-    for (uint i = 1; i < count; ++i)
+    for (uint n = 0; n < MAX_LIST_LENGTH && nodeIdx != 0xffffffff; ++n)
     {
-        Node insert = fragments[i];
-        uint j = i;
-        while (j > 0 && insert.depth > fragments[j - 1].depth)
+        Node node = nodes[nodeIdx];
+        nodeIdx = node.next;
+
+        uint slot;
+        if (count < kSize)
+        {
+            slot = count++;
+        }
+        else
         {
-            fragments[j] = fragments[j-1];
-            --j;
+            uint mergeColor = node.color;
+            if (node.depth < kDepths[kSize - 1])
+            {
+                // Nearer than the farthest kept fragment, which is evicted into the tail
+                mergeColor = kColors[kSize - 1];
+                slot = kSize - 1;
+            }
+            else
+            {
+                slot = MAX_K_BUFFER_SIZE;
+            }
+            float4 mergeFragment = unpackUnorm4x8(mergeColor);
+            tailAccumulation += float4(mergeFragment.rgb * mergeFragment.a, mergeFragment.a);
+            tailRevealage *= 1.0 - mergeFragment.a;
+            if (slot == MAX_K_BUFFER_SIZE)
+            {
+                continue;
+            }
         }
-        fragments[j] = insert;
+
+        // Insertion into the sorted k-buffer
+        while (slot > 0 && node.depth < kDepths[slot - 1])
+        {
+            kColors[slot] = kColors[slot - 1];
+            kDepths[slot] = kDepths[slot - 1];
+            --slot;
+        }
+        kColors[slot] = node.color;
+        kDepths[slot] = node.depth;
     }
 
-    // Do blending
     float4 color = float4(0.025, 0.025, 0.025, 1.0f);
-    for (uint f = 0; f < count; ++f)
+
+    // Fragments that overflowed the node buffer (weighted blended)
+    float4 accumulation = textureAccumulation.Load(int3(input.Pos.xy, 0));
+    float revealage = textureRevealage.Load(int3(input.Pos.xy, 0)).r;
+    color.rgb = lerp(color.rgb, accumulation.rgb / max(accumulation.a, 1e-5), 1.0 - revealage);
+
+    // Fragments behind the k-buffer (weighted average)
+    color.rgb = lerp(color.rgb, tailAccumulation.rgb / max(tailAccumulation.a, 1e-5), 1.0 - tailRevealage);
+
+    // Do blending of the k nearest fragments back to front
+    for (int i = int(count) - 1; i >= 0; --i)
     {
-        color = lerp(color, fragments[f].color, fragments[f].color.a);
+        float4 fragmentColor = unpackUnorm4x8(kColors[i]);
+        color = lerp(color, fragmentColor, fragmentColor.a);
     }
 
     return color;
-}
\ No newline at end of file
+}
@@ -5,9 +5,10 @@ struct VSOutput
 	float4 Pos : SV_POSITION;
 };
 
+// Color is packed to RGBA8 to keep nodes at 12 bytes
 struct Node
 {
-    float4 color;
+    uint color;
     float depth;
     uint next;
 };
@@ -15,6 +16,7 @@ struct Node
 struct GeometrySBO
 {
     uint count;
+    uint overflowCount;
     uint maxNodeCount;
 };
 // Binding 0 : Position storage buffer
@@ -30,9 +32,24 @@ struct PushConsts {
 };
 [[vk::push_constant]] PushConsts pushConsts;
 
+// Weighted blended accumulation for fragments that don't fit into the node buffer
+struct FSOutput
+{
+	float4 Accumulation : SV_TARGET0;
+	float Revealage : SV_TARGET1;
+};
+
+uint packUnorm4x8(float4 value)
+{
+    uint4 v = uint4(round(saturate(value) * 255.0));
+    return v.x | (v.y << 8) | (v.z << 16) | (v.w << 24);
+}
+
 [earlydepthstencil]
-void main(VSOutput input)
+FSOutput main(VSOutput input)
 {
+    FSOutput output;
+
     // Increase the node count
     uint nodeIdx;
     InterlockedAdd(geometrySBO[0].count, 1, nodeIdx);
@@ -45,8 +62,22 @@ void main(VSOutput input)
         InterlockedExchange(headIndexImage[uint2(input.Pos.xy)], nodeIdx, prevHeadIdx);
 
         // Store node data
-        nodes[nodeIdx].color = pushConsts.color;
+        nodes[nodeIdx].color = packUnorm4x8(pushConsts.color);
         nodes[nodeIdx].depth = input.Pos.z;
         nodes[nodeIdx].next = prevHeadIdx;
+
+        // Leaves the accumulation targets unchanged
+        output.Accumulation = float4(0.0, 0.0, 0.0, 0.0);
+        output.Revealage = 0.0;
+    }
+    else
+    {
+        // The node buffer is full, fall back to weighted blended transparency (depth weight by McGuire and Bavoil)
+        InterlockedAdd(geometrySBO[0].overflowCount, 1);
+        float4 color = pushConsts.color;
+        float weight = clamp(color.a * max(1e-2, 3e3 * pow(1.0 - input.Pos.z, 3.0)), 1e-2, 3e3);
+        output.Accumulation = float4(color.rgb * color.a, color.a) * weight;
+        output.Revealage = color.a;
     }
-}
\ No newline at end of file
+    return output;
+}
@@ -25,7 +25,7 @@ struct UBO {
 	float4x4 cascadeViewProjMat[SHADOW_MAP_CASCADE_COUNT];
 	float4x4 inverseViewMat;
 	float3 lightDir;
-	float _pad;
+	int cascadeCount;
 	int colorCascades;
 };
 cbuffer ubo : register(b2) { UBO ubo; };
@@ -83,7 +83,7 @@ float4 main(VSOutput input) : SV_TARGET
 
 	// Get cascade index for the current fragment's view position
 	uint cascadeIndex = 0;
-	for(uint i = 0; i < SHADOW_MAP_CASCADE_COUNT - 1; ++i) {
+	for(uint i = 0; i < uint(ubo.cascadeCount) - 1; ++i) {
 		if(input.ViewPos.z < ubo.cascadeSplits[i]) {
 			cascadeIndex = i + 1;
 		}
@@ -1,7 +1,27 @@
 // Copyright 2020 Google LLC
 
-TextureCube shadowCubeMapTexture : register(t1);
-SamplerState shadowCubeMapSampler : register(s1);
+#define MAX_LIGHTS 32
+#define NEAR_PLANE 0.1
+
+struct Light
+{
+	float4x4 faceViewProjection[6];
+	float4 position;
+	float4 color;
+};
+
+cbuffer uboLights : register(b2) { Light lights[MAX_LIGHTS]; }
+
+TextureCubeArray shadowCubeMapsTexture : register(t3);
+SamplerState shadowCubeMapsSampler : register(s3);
+
+struct PushConsts
+{
+	float4x4 model;
+	uint light;
+	uint faceMask;
+};
+[[vk::push_constant]] PushConsts pushConsts;
 
 float4 main([[vk::location(0)]] float2 inUV : TEXCOORD0) : SV_TARGET
 {
@@ -46,8 +66,11 @@ float4 main([[vk::location(0)]] float2 inUV : TEXCOORD0) : SV_TARGET
 	}
 
 	if ((samplePos.x != 0.0f) && (samplePos.y != 0.0f)) {
-		float dist = length(shadowCubeMapTexture.Sample(shadowCubeMapSampler, samplePos).xyz) * 0.005;
-		outFragColor = float4(dist.xxx, 1.0);
+		// Linearize the depth of the selected light
+		float range = lights[pushConsts.light].position.w;
+		float depth = shadowCubeMapsTexture.Sample(shadowCubeMapsSampler, float4(samplePos, float(pushConsts.light))).r;
+		float dist = (NEAR_PLANE * range) / (range - depth * (range - NEAR_PLANE));
+		outFragColor = float4((dist / range).xxx, 1.0);
 	}
 	return outFragColor;
 }
\ No newline at end of file
@@ -1,14 +1,5 @@
 // Copyright 2020 Google LLC
 
-struct UBO
-{
-	float4x4 projection;
-	float4x4 view;
-	float4x4 model;
-};
-
-cbuffer ubo : register(b0) { UBO ubo; }
-
 struct VSOutput
 {
 	float4 Pos : SV_POSITION;
@@ -22,4 +13,3 @@ VSOutput main(uint VertexIndex : SV_VertexID)
 	output.Pos = float4(output.UV.xy * 2.0f - 1.0f, 0.0f, 1.0f);
 	return output;
 }
-
@@ -1,34 +1,30 @@
 // Copyright 2020 Google LLC
 
-struct VSOutput
-{
-	float4 Pos : SV_POSITION;
-[[vk::location(0)]] float4 WorldPos : POSITION0;
-[[vk::location(1)]] float3 LightPos : POSITION1;
-};
+#define MAX_LIGHTS 32
 
-struct UBO
+struct Light
 {
-	float4x4 projection;
-	float4x4 view;
-	float4x4 model;
-	float4 lightPos;
+	float4x4 faceViewProjection[6];
+	float4 position;
+	float4 color;
 };
 
-cbuffer ubo : register(b0) { UBO ubo; }
+cbuffer uboLights : register(b2) { Light lights[MAX_LIGHTS]; }
 
 struct PushConsts
 {
-	float4x4 view;
+	float4x4 model;
+	uint light;
+	uint faceMask;
 };
 [[vk::push_constant]] PushConsts pushConsts;
 
-VSOutput main([[vk::location(0)]] float3 Pos : POSITION0)
+float4 main([[vk::location(0)]] float3 Pos : POSITION0, uint ViewIndex : SV_ViewID) : SV_POSITION
 {
-	VSOutput output = (VSOutput)0;
-	output.Pos = mul(ubo.projection, mul(pushConsts.view, mul(ubo.model, float4(Pos, 1.0))));
-
-	output.WorldPos = float4(Pos, 1.0);
-	output.LightPos = ubo.lightPos.xyz;
-	return output;
-}
\ No newline at end of file
+	// Each view renders one face of the light's cube map
+	if ((pushConsts.faceMask & (1u << ViewIndex)) == 0u) {
+		// The draw can't reach this face, move all vertices outside of the clip volume so the triangles get culled
+		return float4(2.0, 2.0, 2.0, 1.0);
+	}
+	return mul(lights[pushConsts.light].faceViewProjection[ViewIndex], mul(pushConsts.model, float4(Pos, 1.0)));
+}
@@ -1,43 +1,63 @@
 // Copyright 2020 Google LLC
 
-TextureCube shadowCubeMapTexture : register(t1);
-SamplerState shadowCubeMapSampler : register(s1);
+#define MAX_LIGHTS 32
+
+struct UBO
+{
+	float4x4 projection;
+	float4x4 view;
+	int4 params;
+};
+
+cbuffer ubo : register(b0) { UBO ubo; }
+
+TextureCubeArray shadowCubeMapsTexture : register(t1);
+SamplerComparisonState shadowCubeMapsSampler : register(s1);
+
+struct Light
+{
+	float4x4 faceViewProjection[6];
+	float4 position;
+	float4 color;
+};
+
+cbuffer uboLights : register(b2) { Light lights[MAX_LIGHTS]; }
 
 struct VSOutput
 {
 [[vk::location(0)]] float3 Normal : NORMAL0;
 [[vk::location(1)]] float3 Color : COLOR0;
-[[vk::location(2)]] float3 EyePos : POSITION0;
-[[vk::location(3)]] float3 LightVec : TEXCOORD2;
-[[vk::location(4)]] float3 WorldPos : POSITION1;
-[[vk::location(5)]] float3 LightPos : POSITION2;
+[[vk::location(2)]] float3 WorldPos : POSITION0;
 };
 
-#define EPSILON 0.15
-#define SHADOW_OPACITY 0.5
+#define EPSILON 0.05
+#define NEAR_PLANE 0.1
+#define AMBIENT 0.05
 
 float4 main(VSOutput input) : SV_TARGET
 {
-	// Lighting
 	float3 N = normalize(input.Normal);
-	float3 L = normalize(float3(1.0, 1.0, 1.0));
-
-	float3 Eye = normalize(-input.EyePos);
-	float3 Reflected = normalize(reflect(-input.LightVec, input.Normal));
-
-	float4 IAmbient = float4(float3(0.05, 0.05, 0.05), 1.0);
-	float4 IDiffuse = float4(1.0, 1.0, 1.0, 1.0) * max(dot(input.Normal, input.LightVec), 0.0);
-
-	float4 outFragColor = float4(IAmbient + IDiffuse * float4(input.Color, 1.0));
-
-	// Shadow
-	float3 lightVec = input.WorldPos - input.LightPos;
-    float sampledDist = shadowCubeMapTexture.Sample(shadowCubeMapSampler, lightVec).r;
-    float dist = length(lightVec);
-
-	// Check if fragment is in shadow
-    float shadow = (dist <= sampledDist + EPSILON) ? 1.0 : SHADOW_OPACITY;
-
-	outFragColor.rgb *= shadow;
-	return outFragColor;
-}
\ No newline at end of file
+	float3 color = AMBIENT.xxx;
+
+	for (int i = 0; i < ubo.params.x; i++) {
+		float3 lightVec = input.WorldPos - lights[i].position.xyz;
+		float range = lights[i].position.w;
+		float dist = length(lightVec);
+		if (dist >= range) {
+			continue;
+		}
+
+		float3 L = -lightVec / dist;
+		float attenuation = 1.0 - smoothstep(0.0, range, dist);
+		float diffuse = max(dot(N, L), 0.0) * attenuation;
+
+		// The depth stored in a cube face is the distance along the face's major axis
+		float z = max(max(abs(lightVec.x), abs(lightVec.y)), abs(lightVec.z)) - EPSILON;
+		float depth = range * (z - NEAR_PLANE) / (z * (range - NEAR_PLANE));
+		float shadow = shadowCubeMapsTexture.SampleCmp(shadowCubeMapsSampler, float4(lightVec, float(i)), depth);
+
+		color += lights[i].color.rgb * diffuse * shadow;
+	}
+
+	return float4(color * input.Color, 1.0);
+}
@@ -11,35 +11,33 @@ struct UBO
 {
 	float4x4 projection;
 	float4x4 view;
-	float4x4 model;
-	float4 lightPos;
+	int4 params;
 };
 
 cbuffer ubo : register(b0) { UBO ubo; }
 
+struct PushConsts
+{
+	float4x4 model;
+	uint light;
+	uint faceMask;
+};
+[[vk::push_constant]] PushConsts pushConsts;
+
 struct VSOutput
 {
 	float4 Pos : SV_POSITION;
 [[vk::location(0)]] float3 Normal : NORMAL0;
 [[vk::location(1)]] float3 Color : COLOR0;
-[[vk::location(2)]] float3 EyePos : POSITION0;
-[[vk::location(3)]] float3 LightVec : TEXCOORD2;
-[[vk::location(4)]] float3 WorldPos : POSITION1;
-[[vk::location(5)]] float3 LightPos : POSITION2;
+[[vk::location(2)]] float3 WorldPos : POSITION0;
 };
 
 VSOutput main(VSInput input)
 {
 	VSOutput output = (VSOutput)0;
 	output.Color = input.Color;
-	output.Normal = input.Normal;
-
-	output.Pos = mul(ubo.projection, mul(ubo.view, mul(ubo.model, float4(input.Pos.xyz, 1.0))));
-	output.EyePos = mul(ubo.model, float4(input.Pos, 1.0f)).xyz;
-	output.LightVec = normalize(ubo.lightPos.xyz - input.Pos.xyz);
-	output.WorldPos = input.Pos;
-
-	output.LightPos = ubo.lightPos.xyz;
+	output.Normal = mul((float3x3)pushConsts.model, input.Normal);
+	output.WorldPos = mul(pushConsts.model, float4(input.Pos, 1.0)).xyz;
+	output.Pos = mul(ubo.projection, mul(ubo.view, float4(output.WorldPos, 1.0)));
 	return output;
 }
-
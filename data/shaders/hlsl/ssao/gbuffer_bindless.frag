@@ -0,0 +1,65 @@
+// Copyright 2020 Google LLC
+
+struct VSOutput
+{
+	float4 Pos : SV_POSITION;
+[[vk::location(0)]] float3 Normal : NORMAL0;
+[[vk::location(1)]] float2 UV : TEXCOORD0;
+[[vk::location(2)]] float3 Color : COLOR0;
+[[vk::location(3)]] float3 WorldPos : POSITION0;
+[[vk::location(4)]] nointerpolation uint Material : TEXCOORD1;
+};
+
+struct UBO
+{
+	float4x4 projection;
+	float4x4 model;
+	float4x4 view;
+	float nearPlane;
+	float farPlane;
+};
+
+cbuffer ubo : register(b0) { UBO ubo; }
+
+// Matches vkglTF::MaterialData, texture indices point into the global texture array
+struct Material
+{
+	float4 baseColorFactor;
+	uint baseColorTexture;
+	uint normalTexture;
+	uint metallicRoughnessTexture;
+	uint occlusionTexture;
+	uint emissiveTexture;
+	uint alphaMode;
+	float alphaCutoff;
+	float metallicFactor;
+	float roughnessFactor;
+	uint3 _pad;
+};
+
+StructuredBuffer<Material> materials : register(t0, space1);
+Texture2D textures[] : register(t1, space1);
+SamplerState samplerTextures : register(s1, space1);
+
+struct FSOutput
+{
+	float4 Position : SV_TARGET0;
+	float4 Normal : SV_TARGET1;
+	float4 Albedo : SV_TARGET2;
+};
+
+float linearDepth(float depth)
+{
+	float z = depth * 2.0f - 1.0f;
+	return (2.0f * ubo.nearPlane * ubo.farPlane) / (ubo.farPlane + ubo.nearPlane - z * (ubo.farPlane - ubo.nearPlane));
+}
+
+FSOutput main(VSOutput input)
+{
+	FSOutput output = (FSOutput)0;
+	uint textureIndex = materials[input.Material].baseColorTexture;
+	output.Position = float4(input.WorldPos, linearDepth(input.Pos.z));
+	output.Normal = float4(normalize(input.Normal) * 0.5 + 0.5, 1.0);
+	output.Albedo = textures[NonUniformResourceIndex(textureIndex)].Sample(samplerTextures, input.UV) * float4(input.Color, 1.0);
+	return output;
+}
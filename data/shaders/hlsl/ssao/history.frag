@@ -0,0 +1,11 @@
+// Copyright 2020 Google LLC
+
+// Copies the resolved occlusion into the history that is read by the next frame
+
+Texture2D textureResolved : register(t0);
+SamplerState samplerResolved : register(s0);
+
+float2 main([[vk::location(0)]] float2 inUV : TEXCOORD0) : SV_TARGET
+{
+	return textureResolved.Sample(samplerResolved, inUV).rg;
+}
@@ -20,22 +20,48 @@ cbuffer uboSSAOKernel : register(b3) { UBOSSAOKernel uboSSAOKernel; };
 struct UBO
 {
 	float4x4 projection;
+	int ssao;
+	int ssaoOnly;
+	int ssaoBlur;
+	int production;
+	float4x4 viewToPreviousView;
+	int sampleCount;
+	uint frameIndex;
+	float temporalWeight;
+	int historyValid;
 };
 cbuffer ubo : register(b4) { UBO ubo; };
 
-float main([[vk::location(0)]] float2 inUV : TEXCOORD0) : SV_TARGET
+// Interleaved gradient noise (Jimenez 2014), neighbouring pixels get well spread rotations that a small blur averages out
+float interleavedGradientNoise(float2 position)
+{
+	return frac(52.9829189 * frac(dot(position, float2(0.06711056, 0.00583715))));
+}
+
+float main([[vk::location(0)]] float2 inUV : TEXCOORD0, float4 fragCoord : SV_POSITION) : SV_TARGET
 {
 	// Get G-Buffer values
 	float3 fragPos = texturePositionDepth.Sample(samplerPositionDepth, inUV).rgb;
 	float3 normal = normalize(textureNormal.Sample(samplerNormal, inUV).rgb * 2.0 - 1.0);
 
-	// Get a random vector using a noise lookup
-	int2 texDim;
-	texturePositionDepth.GetDimensions(texDim.x, texDim.y);
-	int2 noiseDim;
-	ssaoNoiseTexture.GetDimensions(noiseDim.x, noiseDim.y);
-	const float2 noiseUV = float2(float(texDim.x)/float(noiseDim.x), float(texDim.y)/(noiseDim.y)) * inUV;
-	float3 randomVec = ssaoNoiseTexture.Sample(ssaoNoiseSampler, noiseUV).xyz * 2.0 - 1.0;
+	float3 randomVec;
+	int sampleCount = SSAO_KERNEL_SIZE;
+	if (ubo.production == 1) {
+		// Rotate the kernel per pixel with interleaved noise that is offset every frame, so the temporal accumulation sees different samples
+		float2 pixel = fragCoord.xy + 5.588238 * float(ubo.frameIndex % 64);
+		float angle = interleavedGradientNoise(pixel) * 6.28318530718;
+		randomVec = float3(cos(angle), sin(angle), 0.0);
+		// The kernel is ordered so that any number of leading samples covers the whole radius
+		sampleCount = clamp(ubo.sampleCount, 1, SSAO_KERNEL_SIZE);
+	} else {
+		// Get a random vector using a noise lookup
+		int2 texDim;
+		texturePositionDepth.GetDimensions(texDim.x, texDim.y);
+		int2 noiseDim;
+		ssaoNoiseTexture.GetDimensions(noiseDim.x, noiseDim.y);
+		const float2 noiseUV = float2(float(texDim.x)/float(noiseDim.x), float(texDim.y)/(noiseDim.y)) * inUV;
+		randomVec = ssaoNoiseTexture.Sample(ssaoNoiseSampler, noiseUV).xyz * 2.0 - 1.0;
+	}
 
 	// Create TBN matrix
 	float3 tangent = normalize(randomVec - normal * dot(randomVec, normal));
@@ -44,7 +70,7 @@ float main([[vk::location(0)]] float2 inUV : TEXCOORD0) : SV_TARGET
 
 	// Calculate occlusion value
 	float occlusion = 0.0f;
-	for(int i = 0; i < SSAO_KERNEL_SIZE; i++)
+	for(int i = 0; i < sampleCount; i++)
 	{
 		float3 samplePos = mul(TBN, uboSSAOKernel.samples[i].xyz);
 		samplePos = fragPos + samplePos * SSAO_RADIUS;
@@ -60,7 +86,7 @@ float main([[vk::location(0)]] float2 inUV : TEXCOORD0) : SV_TARGET
 		float rangeCheck = smoothstep(0.0f, 1.0f, SSAO_RADIUS / abs(fragPos.z - sampleDepth));
 		occlusion += (sampleDepth >= samplePos.z ? 1.0f : 0.0f) * rangeCheck;
 	}
-	occlusion = 1.0 - (occlusion / float(SSAO_KERNEL_SIZE));
+	occlusion = 1.0 - (occlusion / float(sampleCount));
 
 	return occlusion;
 }
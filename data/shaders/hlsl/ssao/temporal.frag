@@ -0,0 +1,74 @@
+// Copyright 2020 Google LLC
+
+// Accumulates the ambient occlusion over frames, the history is reprojected with the camera movement and rejected
+// where the reprojected surface was not visible in the previous frame
+
+Texture2D texturePositionDepth : register(t0);
+SamplerState samplerPositionDepth : register(s0);
+Texture2D textureSSAO : register(t1);
+SamplerState samplerSSAO : register(s1);
+// r = accumulated occlusion, g = view space depth of the previous frame
+Texture2D textureHistory : register(t2);
+SamplerState samplerHistory : register(s2);
+
+struct UBO
+{
+	float4x4 projection;
+	int ssao;
+	int ssaoOnly;
+	int ssaoBlur;
+	int production;
+	float4x4 viewToPreviousView;
+	int sampleCount;
+	uint frameIndex;
+	float temporalWeight;
+	int historyValid;
+};
+cbuffer ubo : register(b3) { UBO ubo; };
+
+// Relative depth difference above which the history belongs to another surface
+static const float depthTolerance = 0.1;
+
+float2 main([[vk::location(0)]] float2 inUV : TEXCOORD0) : SV_TARGET
+{
+	float4 positionDepth = texturePositionDepth.Sample(samplerPositionDepth, inUV);
+	float current = textureSSAO.Sample(samplerSSAO, inUV).r;
+
+	// The history is clamped to the range of the current occlusion around the pixel, which removes stale occlusion
+	// of moving geometry that passes the depth test
+	int2 texDim;
+	textureSSAO.GetDimensions(texDim.x, texDim.y);
+	float2 texelSize = 1.0 / float2(texDim);
+	float minAO = current;
+	float maxAO = current;
+	for (int y = -1; y <= 1; y++)
+	{
+		for (int x = -1; x <= 1; x++)
+		{
+			float ao = textureSSAO.Sample(samplerSSAO, inUV + float2(x, y) * texelSize).r;
+			minAO = min(minAO, ao);
+			maxAO = max(maxAO, ao);
+		}
+	}
+
+	// Reproject into the previous frame
+	float4 previousViewPos = mul(ubo.viewToPreviousView, float4(positionDepth.xyz, 1.0));
+	float4 previousClip = mul(ubo.projection, previousViewPos);
+	float2 previousUV = previousClip.xy / previousClip.w * 0.5 + 0.5;
+
+	float result = current;
+	bool onScreen = all(previousUV >= 0.0) && all(previousUV <= 1.0);
+	if ((ubo.historyValid == 1) && onScreen && (previousClip.w > 0.0))
+	{
+		float2 history = textureHistory.Sample(samplerHistory, previousUV).rg;
+		// Disocclusion: the surface stored in the history is not the one reprojected to it
+		float expectedDepth = -previousViewPos.z;
+		if (abs(history.g - expectedDepth) < depthTolerance * expectedDepth)
+		{
+			result = lerp(clamp(history.r, minAO, maxAO), current, ubo.temporalWeight);
+		}
+	}
+
+	// The view space position is exact, unlike the linearized depth in w
+	return float2(result, -positionDepth.z);
+}
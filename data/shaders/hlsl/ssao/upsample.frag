@@ -0,0 +1,62 @@
+// Copyright 2020 Google LLC
+
+// Depth aware (joint bilateral) upsampling of the reduced resolution ambient occlusion
+// Every full resolution pixel filters the 4x4 closest low resolution texels, weighted by distance and by how
+// well the G-Buffer at the texel center matches the pixel, so occlusion doesn't bleed across depth discontinuities
+
+Texture2D texturePositionDepth : register(t0);
+SamplerState samplerPositionDepth : register(s0);
+Texture2D textureNormal : register(t1);
+SamplerState samplerNormal : register(s1);
+Texture2D textureSSAO : register(t2);
+SamplerState samplerSSAO : register(s2);
+
+// Relative depth difference at which the weight of a texel falls to 1/e
+static const float depthSigma = 0.05;
+static const float normalPower = 8.0;
+
+float main([[vk::location(0)]] float2 inUV : TEXCOORD0) : SV_TARGET
+{
+	float depth = texturePositionDepth.Sample(samplerPositionDepth, inUV).w;
+	float3 normal = normalize(textureNormal.Sample(samplerNormal, inUV).rgb * 2.0 - 1.0);
+
+	int2 texDim;
+	textureSSAO.GetDimensions(texDim.x, texDim.y);
+	float2 lowResSize = float2(texDim);
+	// Position relative to the low resolution texel centers
+	float2 lowResPos = inUV * lowResSize - 0.5;
+	float2 base = floor(lowResPos);
+	float2 f = lowResPos - base;
+
+	float result = 0.0;
+	float weightSum = 0.0;
+	float nearest = 0.0;
+	float nearestDepthDelta = 1e30;
+	for (int y = -1; y <= 2; y++)
+	{
+		for (int x = -1; x <= 2; x++)
+		{
+			float2 sampleUV = (base + float2(x, y) + 0.5) / lowResSize;
+			float ao = textureSSAO.Sample(samplerSSAO, sampleUV).r;
+			// The occlusion of a low resolution texel was computed from the G-Buffer at its center
+			float sampleDepth = texturePositionDepth.Sample(samplerPositionDepth, sampleUV).w;
+			float3 sampleNormal = normalize(textureNormal.Sample(samplerNormal, sampleUV).rgb * 2.0 - 1.0);
+			// Tent filter over two texels, wider than bilinear to also smooth the per pixel noise of the kernel rotation
+			float2 distance = abs(float2(x, y) - f);
+			float spatialWeight = max(2.0 - distance.x, 0.0) * max(2.0 - distance.y, 0.0);
+			float depthDelta = abs(depth - sampleDepth);
+			float depthWeight = exp(-depthDelta / (depthSigma * max(depth, 1e-4)));
+			float normalWeight = pow(max(dot(normal, sampleNormal), 0.0), normalPower);
+			float weight = spatialWeight * depthWeight * normalWeight;
+			result += ao * weight;
+			weightSum += weight;
+			if (depthDelta < nearestDepthDelta)
+			{
+				nearestDepthDelta = depthDelta;
+				nearest = ao;
+			}
+		}
+	}
+	// Thin features can miss all low resolution samples, the texel closest in depth is the best guess for them
+	return (weightSum > 1e-4) ? result / weightSum : nearest;
+}
@@ -3,6 +3,16 @@
 Texture2D textureColor : register(t1);
 SamplerState samplerColor : register(s1);
 
+// One flag per virtual page, read back and cleared by the application
+RWStructuredBuffer<uint> feedbackRequests : register(u2);
+
+struct PageTable
+{
+	uint4 mips[16];	// x: first page index, y: pages per row, z: pages per column
+	uint4 info;		// xy: page extent in texels, z: first mip level in the mip tail
+};
+cbuffer pageTable : register(b3) { PageTable pageTable; }
+
 struct VSOutput
 {
 [[vk::location(0)]] float2 UV : TEXCOORD0;
@@ -14,11 +24,26 @@ struct VSOutput
 
 float4 main(VSOutput input) : SV_TARGET
 {
+	// Request the page of the level selected by the sampler, resident pages are requested too so they stay in the cache
+	uint width, height, levels;
+	textureColor.GetDimensions(0, width, height, levels);
+	float lod = textureColor.CalculateLevelOfDetailUnclamped(samplerColor, input.UV) + input.LodBias;
+	uint level = uint(clamp(round(lod), 0.0, float(levels - 1)));
+	if (level < pageTable.info.z) {
+		int2 levelSize = int2(max(width >> level, 1), max(height >> level, 1));
+		uint2 texel = uint2(clamp(int2(saturate(input.UV) * float2(levelSize)), int2(0, 0), levelSize - 1));
+		uint2 page = texel / pageTable.info.xy;
+		uint index = pageTable.mips[level].x + page.y * pageTable.mips[level].y + page.x;
+		if (feedbackRequests[index] == 0) {
+			feedbackRequests[index] = 1;
+		}
+	}
+
 	float4 color = float4(0.0, 0.0, 0.0, 0.0);
 
-	// Fetch sparse until we get a valid texel
+	// Fetch sparse until we get a valid texel, the mip tail is always resident
 	uint status;
-	float minLod = input.LodBias;
+	float minLod = float(level);
 	do
 	{
 		color = textureColor.SampleLevel(samplerColor, input.UV, minLod, 0, status);
@@ -1,5 +1,9 @@
 /*
-* Vulkan Example - Implements a separable two-pass fullscreen blur (also known as bloom)
+* Vulkan Example - Compute shader bloom using a mip chain
+*
+* The scene is rendered into a full resolution HDR target. Compute shaders extract the bright parts of it, downsample them
+* into a mip chain and upsample that chain back up with a tent filter, adding each level onto the next larger one. The
+* result is added on top of the scene when it's composed into the swapchain image
 *
 * Copyright (C) Sascha Willems - www.saschawillems.de
 *
@@ -11,9 +15,13 @@
 
 #define ENABLE_VALIDATION false
 
-// Offscreen frame buffer properties
-#define FB_DIM 256
-#define FB_COLOR_FORMAT VK_FORMAT_R8G8B8A8_UNORM
+// HDR scene color target and bloom mip chain
+#define SCENE_COLOR_FORMAT VK_FORMAT_R16G16B16A16_SFLOAT
+#define BLOOM_FORMAT VK_FORMAT_R16G16B16A16_SFLOAT
+// The first bloom level has half the resolution of the scene, every further level halves it again
+#define BLOOM_MAX_LEVELS 6
+// Stop adding levels once they would get smaller than this
+#define BLOOM_MIN_SIZE 8
 
 class VulkanExample : public VulkanExampleBase
 {
@@ -31,7 +39,7 @@ public:
 	struct {
 		vks::Buffer scene;
 		vks::Buffer skyBox;
-		vks::Buffer blurParams;
+		vks::Buffer bloomParams;
 	} uniformBuffers;
 
 	struct UBO {
@@ -40,38 +48,50 @@ public:
 		glm::mat4 model;
 	};
 
-	struct UBOBlurParams {
-		float blurScale = 1.0f;
-		float blurStrength = 1.5f;
+	struct UBOBloomParams {
+		// Brightness above which parts of the scene start to bloom
+		float threshold = 1.0f;
+		// Fraction of the threshold below it over which the bloom fades in
+		float knee = 0.5f;
+		// Upsampling tent filter radius in texels
+		float radius = 1.0f;
+		float intensity = 0.25f;
 	};
 
 	struct {
 		UBO scene, skyBox;
-		UBOBlurParams blurParams;
+		UBOBloomParams bloomParams;
 	} ubos;
 
 	struct {
-		VkPipeline blurVert;
-		VkPipeline blurHorz;
+		VkPipeline bloomPrefilter;
+		VkPipeline bloomDownsample;
+		VkPipeline bloomUpsample;
+		VkPipeline composition;
 		VkPipeline glowPass;
 		VkPipeline phongPass;
 		VkPipeline skyBox;
 	} pipelines;
 
 	struct {
-		VkPipelineLayout blur;
+		VkPipelineLayout bloom;
+		VkPipelineLayout composition;
 		VkPipelineLayout scene;
 	} pipelineLayouts;
 
 	struct {
-		VkDescriptorSet blurVert;
-		VkDescriptorSet blurHorz;
+		// Set i reads the previous level (or the scene for the first one) and writes level i
+		std::array<VkDescriptorSet, BLOOM_MAX_LEVELS> bloomDownsample;
+		// Set i reads level i + 1 and adds it onto level i
+		std::array<VkDescriptorSet, BLOOM_MAX_LEVELS - 1> bloomUpsample;
+		VkDescriptorSet composition;
 		VkDescriptorSet scene;
 		VkDescriptorSet skyBox;
 	} descriptorSets;
 
 	struct {
-		VkDescriptorSetLayout blur;
+		VkDescriptorSetLayout bloom;
+		VkDescriptorSetLayout composition;
 		VkDescriptorSetLayout scene;
 	} descriptorSetLayouts;
 
@@ -81,21 +101,34 @@ public:
 		VkDeviceMemory mem;
 		VkImageView view;
 	};
-	struct FrameBuffer {
+	// Full resolution HDR scene, recreated on resize
+	struct OffscreenPass {
 		VkFramebuffer framebuffer;
 		FrameBufferAttachment color, depth;
-		VkDescriptorImageInfo descriptor;
-	};
-	struct OffscreenPass {
-		int32_t width, height;
-		VkRenderPass renderPass;
+		VkRenderPass renderPass = VK_NULL_HANDLE;
 		VkSampler sampler;
-		std::array<FrameBuffer, 2> framebuffers;
 	} offscreenPass;
 
+	// Mip chain the bloom is computed in, kept in the general layout as it's both written and sampled by the compute shaders
+	struct BloomChain {
+		VkImage image;
+		VkDeviceMemory mem;
+		// One view per level, storage image writes need single level views
+		std::array<VkImageView, BLOOM_MAX_LEVELS> views;
+		std::array<VkExtent2D, BLOOM_MAX_LEVELS> extents;
+		uint32_t levels = 0;
+	} bloomChain;
+
+	// GPU times of the scene pass, the threshold and downsample dispatches, the upsample dispatches and the composition in milliseconds
+	enum Stage { StageScene = 0, StageDownsample = 1, StageUpsample = 2, StageComposition = 3, StageCount = 4 };
+	struct Timings {
+		VkQueryPool queryPool = VK_NULL_HANDLE;
+		std::array<float, StageCount> stages = {};
+	} timings;
+
 	VulkanExample() : VulkanExampleBase(ENABLE_VALIDATION)
 	{
-		title = "Bloom (offscreen rendering)";
+		title = "Bloom (compute mip chain)";
 		timerSpeed *= 0.5f;
 		camera.type = Camera::CameraType::lookat;
 		camera.setPosition(glm::vec3(0.0f, 0.0f, -10.25f));
@@ -108,149 +141,75 @@ public:
 		// Clean up used Vulkan resources
 		// Note : Inherited destructor cleans up resources stored in base class
 
+		destroyOffscreenImages();
 		vkDestroySampler(device, offscreenPass.sampler, nullptr);
-
-		// Frame buffer
-		for (auto& framebuffer : offscreenPass.framebuffers)
-		{
-			// Attachments
-			vkDestroyImageView(device, framebuffer.color.view, nullptr);
-			vkDestroyImage(device, framebuffer.color.image, nullptr);
-			vkFreeMemory(device, framebuffer.color.mem, nullptr);
-			vkDestroyImageView(device, framebuffer.depth.view, nullptr);
-			vkDestroyImage(device, framebuffer.depth.image, nullptr);
-			vkFreeMemory(device, framebuffer.depth.mem, nullptr);
-
-			vkDestroyFramebuffer(device, framebuffer.framebuffer, nullptr);
-		}
 		vkDestroyRenderPass(device, offscreenPass.renderPass, nullptr);
 
-		vkDestroyPipeline(device, pipelines.blurHorz, nullptr);
-		vkDestroyPipeline(device, pipelines.blurVert, nullptr);
+		vkDestroyPipeline(device, pipelines.bloomPrefilter, nullptr);
+		vkDestroyPipeline(device, pipelines.bloomDownsample, nullptr);
+		vkDestroyPipeline(device, pipelines.bloomUpsample, nullptr);
+		vkDestroyPipeline(device, pipelines.composition, nullptr);
 		vkDestroyPipeline(device, pipelines.phongPass, nullptr);
 		vkDestroyPipeline(device, pipelines.glowPass, nullptr);
 		vkDestroyPipeline(device, pipelines.skyBox, nullptr);
 
-		vkDestroyPipelineLayout(device, pipelineLayouts.blur , nullptr);
+		vkDestroyPipelineLayout(device, pipelineLayouts.bloom, nullptr);
+		vkDestroyPipelineLayout(device, pipelineLayouts.composition, nullptr);
 		vkDestroyPipelineLayout(device, pipelineLayouts.scene, nullptr);
 
-		vkDestroyDescriptorSetLayout(device, descriptorSetLayouts.blur, nullptr);
+		vkDestroyDescriptorSetLayout(device, descriptorSetLayouts.bloom, nullptr);
+		vkDestroyDescriptorSetLayout(device, descriptorSetLayouts.composition, nullptr);
 		vkDestroyDescriptorSetLayout(device, descriptorSetLayouts.scene, nullptr);
 
+		if (timings.queryPool != VK_NULL_HANDLE) {
+			vkDestroyQueryPool(device, timings.queryPool, nullptr);
+		}
+
 		// Uniform buffers
 		uniformBuffers.scene.destroy();
 		uniformBuffers.skyBox.destroy();
-		uniformBuffers.blurParams.destroy();
+		uniformBuffers.bloomParams.destroy();
 
 		cubemap.destroy();
 	}
 
-	// Setup the offscreen framebuffer for rendering the mirrored scene
-	// The color attachment of this framebuffer will then be sampled from
-	void prepareOffscreenFramebuffer(FrameBuffer *frameBuf, VkFormat colorFormat, VkFormat depthFormat)
+	void createAttachment(FrameBufferAttachment *attachment, VkFormat format, VkImageUsageFlags usage, VkImageAspectFlags aspectMask)
 	{
-		// Color attachment
 		VkImageCreateInfo image = vks::initializers::imageCreateInfo();
 		image.imageType = VK_IMAGE_TYPE_2D;
-		image.format = colorFormat;
-		image.extent.width = FB_DIM;
-		image.extent.height = FB_DIM;
+		image.format = format;
+		image.extent.width = width;
+		image.extent.height = height;
 		image.extent.depth = 1;
 		image.mipLevels = 1;
 		image.arrayLayers = 1;
 		image.samples = VK_SAMPLE_COUNT_1_BIT;
 		image.tiling = VK_IMAGE_TILING_OPTIMAL;
-		// We will sample directly from the color attachment
-		image.usage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
+		image.usage = usage;
+		VK_CHECK_RESULT(vkCreateImage(device, &image, nullptr, &attachment->image));
 
 		VkMemoryAllocateInfo memAlloc = vks::initializers::memoryAllocateInfo();
 		VkMemoryRequirements memReqs;
-
-		VkImageViewCreateInfo colorImageView = vks::initializers::imageViewCreateInfo();
-		colorImageView.viewType = VK_IMAGE_VIEW_TYPE_2D;
-		colorImageView.format = colorFormat;
-		colorImageView.flags = 0;
-		colorImageView.subresourceRange = {};
-		colorImageView.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-		colorImageView.subresourceRange.baseMipLevel = 0;
-		colorImageView.subresourceRange.levelCount = 1;
-		colorImageView.subresourceRange.baseArrayLayer = 0;
-		colorImageView.subresourceRange.layerCount = 1;
-
-		VK_CHECK_RESULT(vkCreateImage(device, &image, nullptr, &frameBuf->color.image));
-		vkGetImageMemoryRequirements(device, frameBuf->color.image, &memReqs);
+		vkGetImageMemoryRequirements(device, attachment->image, &memReqs);
 		memAlloc.allocationSize = memReqs.size;
 		memAlloc.memoryTypeIndex = vulkanDevice->getMemoryType(memReqs.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
-		VK_CHECK_RESULT(vkAllocateMemory(device, &memAlloc, nullptr, &frameBuf->color.mem));
-		VK_CHECK_RESULT(vkBindImageMemory(device, frameBuf->color.image, frameBuf->color.mem, 0));
-
-		colorImageView.image = frameBuf->color.image;
-		VK_CHECK_RESULT(vkCreateImageView(device, &colorImageView, nullptr, &frameBuf->color.view));
-
-		// Depth stencil attachment
-		image.format = depthFormat;
-		image.usage = VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT;
-
-		VkImageViewCreateInfo depthStencilView = vks::initializers::imageViewCreateInfo();
-		depthStencilView.viewType = VK_IMAGE_VIEW_TYPE_2D;
-		depthStencilView.format = depthFormat;
-		depthStencilView.flags = 0;
-		depthStencilView.subresourceRange = {};
-		depthStencilView.subresourceRange.aspectMask = VK_IMAGE_ASPECT_DEPTH_BIT;
-		if (vks::tools::formatHasStencil(depthFormat)) {
-			depthStencilView.subresourceRange.aspectMask |= VK_IMAGE_ASPECT_STENCIL_BIT;
-		}
-		depthStencilView.subresourceRange.baseMipLevel = 0;
-		depthStencilView.subresourceRange.levelCount = 1;
-		depthStencilView.subresourceRange.baseArrayLayer = 0;
-		depthStencilView.subresourceRange.layerCount = 1;
-
-		VK_CHECK_RESULT(vkCreateImage(device, &image, nullptr, &frameBuf->depth.image));
-		vkGetImageMemoryRequirements(device, frameBuf->depth.image, &memReqs);
-		memAlloc.allocationSize = memReqs.size;
-		memAlloc.memoryTypeIndex = vulkanDevice->getMemoryType(memReqs.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
-		VK_CHECK_RESULT(vkAllocateMemory(device, &memAlloc, nullptr, &frameBuf->depth.mem));
-		VK_CHECK_RESULT(vkBindImageMemory(device, frameBuf->depth.image, frameBuf->depth.mem, 0));
-
-		depthStencilView.image = frameBuf->depth.image;
-		VK_CHECK_RESULT(vkCreateImageView(device, &depthStencilView, nullptr, &frameBuf->depth.view));
-
-		VkImageView attachments[2];
-		attachments[0] = frameBuf->color.view;
-		attachments[1] = frameBuf->depth.view;
-
-		VkFramebufferCreateInfo fbufCreateInfo = vks::initializers::framebufferCreateInfo();
-		fbufCreateInfo.renderPass = offscreenPass.renderPass;
-		fbufCreateInfo.attachmentCount = 2;
-		fbufCreateInfo.pAttachments = attachments;
-		fbufCreateInfo.width = FB_DIM;
-		fbufCreateInfo.height = FB_DIM;
-		fbufCreateInfo.layers = 1;
-
-		VK_CHECK_RESULT(vkCreateFramebuffer(device, &fbufCreateInfo, nullptr, &frameBuf->framebuffer));
-
-		// Fill a descriptor for later use in a descriptor set
-		frameBuf->descriptor.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
-		frameBuf->descriptor.imageView = frameBuf->color.view;
-		frameBuf->descriptor.sampler = offscreenPass.sampler;
+		VK_CHECK_RESULT(vkAllocateMemory(device, &memAlloc, nullptr, &attachment->mem));
+		VK_CHECK_RESULT(vkBindImageMemory(device, attachment->image, attachment->mem, 0));
+
+		VkImageViewCreateInfo imageView = vks::initializers::imageViewCreateInfo();
+		imageView.viewType = VK_IMAGE_VIEW_TYPE_2D;
+		imageView.format = format;
+		imageView.subresourceRange = { aspectMask, 0, 1, 0, 1 };
+		imageView.image = attachment->image;
+		VK_CHECK_RESULT(vkCreateImageView(device, &imageView, nullptr, &attachment->view));
 	}
 
-	// Prepare the offscreen framebuffers used for the vertical- and horizontal blur
+	// Render pass and sampler of the HDR scene, these don't depend on the window size
 	void prepareOffscreen()
 	{
-		offscreenPass.width = FB_DIM;
-		offscreenPass.height = FB_DIM;
-
-		// Find a suitable depth format
-		VkFormat fbDepthFormat;
-		VkBool32 validDepthFormat = vks::tools::getSupportedDepthFormat(physicalDevice, &fbDepthFormat);
-		assert(validDepthFormat);
-
-		// Create a separate render pass for the offscreen rendering as it may differ from the one used for scene rendering
-
 		std::array<VkAttachmentDescription, 2> attchmentDescriptions = {};
 		// Color attachment
-		attchmentDescriptions[0].format = FB_COLOR_FORMAT;
+		attchmentDescriptions[0].format = SCENE_COLOR_FORMAT;
 		attchmentDescriptions[0].samples = VK_SAMPLE_COUNT_1_BIT;
 		attchmentDescriptions[0].loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
 		attchmentDescriptions[0].storeOp = VK_ATTACHMENT_STORE_OP_STORE;
@@ -259,7 +218,7 @@ public:
 		attchmentDescriptions[0].initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
 		attchmentDescriptions[0].finalLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
 		// Depth attachment
-		attchmentDescriptions[1].format = fbDepthFormat;
+		attchmentDescriptions[1].format = depthFormat;
 		attchmentDescriptions[1].samples = VK_SAMPLE_COUNT_1_BIT;
 		attchmentDescriptions[1].loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
 		attchmentDescriptions[1].storeOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
@@ -278,23 +237,24 @@ public:
 		subpassDescription.pDepthStencilAttachment = &depthReference;
 
 		// Use subpass dependencies for layout transitions
+		// The scene color is read by the bloom compute shaders and the composition fragment shader
 		std::array<VkSubpassDependency, 2> dependencies;
 
 		dependencies[0].srcSubpass = VK_SUBPASS_EXTERNAL;
 		dependencies[0].dstSubpass = 0;
-		dependencies[0].srcStageMask = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
+		dependencies[0].srcStageMask = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT;
 		dependencies[0].dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
 		dependencies[0].srcAccessMask = VK_ACCESS_SHADER_READ_BIT;
 		dependencies[0].dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
-		dependencies[0].dependencyFlags = VK_DEPENDENCY_BY_REGION_BIT;
+		dependencies[0].dependencyFlags = 0;
 
 		dependencies[1].srcSubpass = 0;
 		dependencies[1].dstSubpass = VK_SUBPASS_EXTERNAL;
 		dependencies[1].srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
-		dependencies[1].dstStageMask = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
+		dependencies[1].dstStageMask = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT;
 		dependencies[1].srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
 		dependencies[1].dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
-		dependencies[1].dependencyFlags = VK_DEPENDENCY_BY_REGION_BIT;
+		dependencies[1].dependencyFlags = 0;
 
 		// Create the actual renderpass
 		VkRenderPassCreateInfo renderPassInfo = {};
@@ -308,24 +268,152 @@ public:
 
 		VK_CHECK_RESULT(vkCreateRenderPass(device, &renderPassInfo, nullptr, &offscreenPass.renderPass));
 
-		// Create sampler to sample from the color attachments
+		// Shared by all passes reading the scene and the bloom levels, clamping keeps the filters from wrapping around the edges
 		VkSamplerCreateInfo sampler = vks::initializers::samplerCreateInfo();
 		sampler.magFilter = VK_FILTER_LINEAR;
 		sampler.minFilter = VK_FILTER_LINEAR;
-		sampler.mipmapMode = VK_SAMPLER_MIPMAP_MODE_LINEAR;
+		sampler.mipmapMode = VK_SAMPLER_MIPMAP_MODE_NEAREST;
 		sampler.addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
 		sampler.addressModeV = sampler.addressModeU;
 		sampler.addressModeW = sampler.addressModeU;
 		sampler.mipLodBias = 0.0f;
 		sampler.maxAnisotropy = 1.0f;
 		sampler.minLod = 0.0f;
-		sampler.maxLod = 1.0f;
+		sampler.maxLod = 0.0f;
 		sampler.borderColor = VK_BORDER_COLOR_FLOAT_OPAQUE_WHITE;
 		VK_CHECK_RESULT(vkCreateSampler(device, &sampler, nullptr, &offscreenPass.sampler));
 
-		// Create two frame buffers
-		prepareOffscreenFramebuffer(&offscreenPass.framebuffers[0], FB_COLOR_FORMAT, fbDepthFormat);
-		prepareOffscreenFramebuffer(&offscreenPass.framebuffers[1], FB_COLOR_FORMAT, fbDepthFormat);
+		prepareOffscreenImages();
+	}
+
+	// Scene targets and the bloom chain, sized relative to the window
+	void prepareOffscreenImages()
+	{
+		createAttachment(&offscreenPass.color, SCENE_COLOR_FORMAT, VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT, VK_IMAGE_ASPECT_COLOR_BIT);
+		VkImageAspectFlags depthAspectMask = VK_IMAGE_ASPECT_DEPTH_BIT;
+		if (vks::tools::formatHasStencil(depthFormat)) {
+			depthAspectMask |= VK_IMAGE_ASPECT_STENCIL_BIT;
+		}
+		createAttachment(&offscreenPass.depth, depthFormat, VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT, depthAspectMask);
+
+		VkImageView attachments[2] = { offscreenPass.color.view, offscreenPass.depth.view };
+		VkFramebufferCreateInfo fbufCreateInfo = vks::initializers::framebufferCreateInfo();
+		fbufCreateInfo.renderPass = offscreenPass.renderPass;
+		fbufCreateInfo.attachmentCount = 2;
+		fbufCreateInfo.pAttachments = attachments;
+		fbufCreateInfo.width = width;
+		fbufCreateInfo.height = height;
+		fbufCreateInfo.layers = 1;
+		VK_CHECK_RESULT(vkCreateFramebuffer(device, &fbufCreateInfo, nullptr, &offscreenPass.framebuffer));
+
+		// Bloom mip chain
+		bloomChain.levels = 0;
+		uint32_t levelWidth = std::max(width / 2, 1u);
+		uint32_t levelHeight = std::max(height / 2, 1u);
+		while (bloomChain.levels < BLOOM_MAX_LEVELS && (bloomChain.levels == 0 || std::min(levelWidth, levelHeight) >= BLOOM_MIN_SIZE)) {
+			bloomChain.extents[bloomChain.levels] = { levelWidth, levelHeight };
+			bloomChain.levels++;
+			levelWidth = std::max(levelWidth / 2, 1u);
+			levelHeight = std::max(levelHeight / 2, 1u);
+		}
+
+		VkImageCreateInfo image = vks::initializers::imageCreateInfo();
+		image.imageType = VK_IMAGE_TYPE_2D;
+		image.format = BLOOM_FORMAT;
+		image.extent = { bloomChain.extents[0].width, bloomChain.extents[0].height, 1 };
+		image.mipLevels = bloomChain.levels;
+		image.arrayLayers = 1;
+		image.samples = VK_SAMPLE_COUNT_1_BIT;
+		image.tiling = VK_IMAGE_TILING_OPTIMAL;
+		image.usage = VK_IMAGE_USAGE_STORAGE_BIT | VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT;
+		VK_CHECK_RESULT(vkCreateImage(device, &image, nullptr, &bloomChain.image));
+
+		VkMemoryAllocateInfo memAlloc = vks::initializers::memoryAllocateInfo();
+		VkMemoryRequirements memReqs;
+		vkGetImageMemoryRequirements(device, bloomChain.image, &memReqs);
+		memAlloc.allocationSize = memReqs.size;
+		memAlloc.memoryTypeIndex = vulkanDevice->getMemoryType(memReqs.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+		VK_CHECK_RESULT(vkAllocateMemory(device, &memAlloc, nullptr, &bloomChain.mem));
+		VK_CHECK_RESULT(vkBindImageMemory(device, bloomChain.image, bloomChain.mem, 0));
+
+		for (uint32_t i = 0; i < bloomChain.levels; i++) {
+			VkImageViewCreateInfo imageView = vks::initializers::imageViewCreateInfo();
+			imageView.viewType = VK_IMAGE_VIEW_TYPE_2D;
+			imageView.format = BLOOM_FORMAT;
+			imageView.subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, i, 1, 0, 1 };
+			imageView.image = bloomChain.image;
+			VK_CHECK_RESULT(vkCreateImageView(device, &imageView, nullptr, &bloomChain.views[i]));
+		}
+
+		// Clear the chain once, so composing with bloom disabled never reads undefined values
+		VkCommandBuffer copyCmd = vulkanDevice->createCommandBuffer(VK_COMMAND_BUFFER_LEVEL_PRIMARY, true);
+		VkImageSubresourceRange subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, 0, bloomChain.levels, 0, 1 };
+		VkImageMemoryBarrier imageMemoryBarrier = vks::initializers::imageMemoryBarrier();
+		imageMemoryBarrier.image = bloomChain.image;
+		imageMemoryBarrier.subresourceRange = subresourceRange;
+		imageMemoryBarrier.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+		imageMemoryBarrier.newLayout = VK_IMAGE_LAYOUT_GENERAL;
+		imageMemoryBarrier.srcAccessMask = 0;
+		imageMemoryBarrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+		vkCmdPipelineBarrier(copyCmd, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 0, nullptr, 1, &imageMemoryBarrier);
+		VkClearColorValue clearColor = { { 0.0f, 0.0f, 0.0f, 0.0f } };
+		vkCmdClearColorImage(copyCmd, bloomChain.image, VK_IMAGE_LAYOUT_GENERAL, &clearColor, 1, &subresourceRange);
+		imageMemoryBarrier.oldLayout = VK_IMAGE_LAYOUT_GENERAL;
+		imageMemoryBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+		imageMemoryBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+		vkCmdPipelineBarrier(copyCmd, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0, 0, nullptr, 0, nullptr, 1, &imageMemoryBarrier);
+		vulkanDevice->flushCommandBuffer(copyCmd, queue, true);
+	}
+
+	void destroyOffscreenImages()
+	{
+		for (auto attachment : { &offscreenPass.color, &offscreenPass.depth }) {
+			vkDestroyImageView(device, attachment->view, nullptr);
+			vkDestroyImage(device, attachment->image, nullptr);
+			vkFreeMemory(device, attachment->mem, nullptr);
+		}
+		vkDestroyFramebuffer(device, offscreenPass.framebuffer, nullptr);
+		for (uint32_t i = 0; i < bloomChain.levels; i++) {
+			vkDestroyImageView(device, bloomChain.views[i], nullptr);
+		}
+		vkDestroyImage(device, bloomChain.image, nullptr);
+		vkFreeMemory(device, bloomChain.mem, nullptr);
+	}
+
+	// Timestamps are written before and after every stage of each command buffer, there's one command buffer per swapchain image
+	void prepareTimestamps()
+	{
+		if (timings.queryPool != VK_NULL_HANDLE) {
+			vkDestroyQueryPool(device, timings.queryPool, nullptr);
+			timings.queryPool = VK_NULL_HANDLE;
+		}
+		if (vulkanDevice->queueFamilyProperties[vulkanDevice->queueFamilyIndices.graphics].timestampValidBits == 0) {
+			return;
+		}
+		VkQueryPoolCreateInfo queryPoolCI = {};
+		queryPoolCI.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+		queryPoolCI.queryType = VK_QUERY_TYPE_TIMESTAMP;
+		queryPoolCI.queryCount = swapChain.imageCount * (StageCount + 1);
+		VK_CHECK_RESULT(vkCreateQueryPool(device, &queryPoolCI, nullptr, &timings.queryPool));
+	}
+
+	// Makes the compute writes to the bloom chain visible to the next dispatch or the composition
+	void bloomBarrier(VkCommandBuffer commandBuffer, VkPipelineStageFlags dstStageMask)
+	{
+		VkImageMemoryBarrier imageMemoryBarrier = vks::initializers::imageMemoryBarrier();
+		imageMemoryBarrier.image = bloomChain.image;
+		imageMemoryBarrier.subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, 0, bloomChain.levels, 0, 1 };
+		imageMemoryBarrier.oldLayout = VK_IMAGE_LAYOUT_GENERAL;
+		imageMemoryBarrier.newLayout = VK_IMAGE_LAYOUT_GENERAL;
+		imageMemoryBarrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+		imageMemoryBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+		vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, dstStageMask, 0, 0, nullptr, 0, nullptr, 1, &imageMemoryBarrier);
+	}
+
+	void dispatchBloomLevel(VkCommandBuffer commandBuffer, VkDescriptorSet descriptorSet, VkExtent2D extent)
+	{
+		vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipelineLayouts.bloom, 0, 1, &descriptorSet, 0, nullptr);
+		vkCmdDispatch(commandBuffer, (extent.width + 7) / 8, (extent.height + 7) / 8, 1);
 	}
 
 	void buildCommandBuffers()
@@ -333,76 +421,100 @@ public:
 		VkCommandBufferBeginInfo cmdBufInfo = vks::initializers::commandBufferBeginInfo();
 
 		VkClearValue clearValues[2];
-		VkViewport viewport;
-		VkRect2D scissor;
-
-		/*
-			The blur method used in this example is multi pass and renders the vertical blur first and then the horizontal one
-			While it's possible to blur in one pass, this method is widely used as it requires far less samples to generate the blur
-		*/
 
 		for (int32_t i = 0; i < drawCmdBuffers.size(); ++i)
 		{
 			VK_CHECK_RESULT(vkBeginCommandBuffer(drawCmdBuffers[i], &cmdBufInfo));
 
-			if (bloom) {
+			const uint32_t firstQuery = i * (StageCount + 1);
+			if (timings.queryPool != VK_NULL_HANDLE) {
+				vkCmdResetQueryPool(drawCmdBuffers[i], timings.queryPool, firstQuery, StageCount + 1);
+				vkCmdWriteTimestamp(drawCmdBuffers[i], VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, timings.queryPool, firstQuery);
+			}
+
+			/*
+				First render pass: Render the scene into the HDR target, the glow parts of the model are added as emissive light
+			*/
+			{
 				clearValues[0].color = { { 0.0f, 0.0f, 0.0f, 1.0f } };
 				clearValues[1].depthStencil = { 1.0f, 0 };
 
 				VkRenderPassBeginInfo renderPassBeginInfo = vks::initializers::renderPassBeginInfo();
 				renderPassBeginInfo.renderPass = offscreenPass.renderPass;
-				renderPassBeginInfo.framebuffer = offscreenPass.framebuffers[0].framebuffer;
-				renderPassBeginInfo.renderArea.extent.width = offscreenPass.width;
-				renderPassBeginInfo.renderArea.extent.height = offscreenPass.height;
+				renderPassBeginInfo.framebuffer = offscreenPass.framebuffer;
+				renderPassBeginInfo.renderArea.extent.width = width;
+				renderPassBeginInfo.renderArea.extent.height = height;
 				renderPassBeginInfo.clearValueCount = 2;
 				renderPassBeginInfo.pClearValues = clearValues;
 
-				viewport = vks::initializers::viewport((float)offscreenPass.width, (float)offscreenPass.height, 0.0f, 1.0f);
+				vkCmdBeginRenderPass(drawCmdBuffers[i], &renderPassBeginInfo, VK_SUBPASS_CONTENTS_INLINE);
+
+				VkViewport viewport = vks::initializers::viewport((float)width, (float)height, 0.0f, 1.0f);
 				vkCmdSetViewport(drawCmdBuffers[i], 0, 1, &viewport);
 
-				scissor = vks::initializers::rect2D(offscreenPass.width, offscreenPass.height, 0, 0);
+				VkRect2D scissor = vks::initializers::rect2D(width, height, 0, 0);
 				vkCmdSetScissor(drawCmdBuffers[i], 0, 1, &scissor);
 
-				/*
-					First render pass: Render glow parts of the model (separate mesh) to an offscreen frame buffer
-				*/
-
-				vkCmdBeginRenderPass(drawCmdBuffers[i], &renderPassBeginInfo, VK_SUBPASS_CONTENTS_INLINE);
+				// Skybox
+				vkCmdBindDescriptorSets(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayouts.scene, 0, 1, &descriptorSets.skyBox, 0, NULL);
+				vkCmdBindPipeline(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pipelines.skyBox);
+				models.skyBox.draw(drawCmdBuffers[i]);
 
+				// 3D scene
 				vkCmdBindDescriptorSets(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayouts.scene, 0, 1, &descriptorSets.scene, 0, NULL);
-				vkCmdBindPipeline(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pipelines.glowPass);
+				vkCmdBindPipeline(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pipelines.phongPass);
+				models.ufo.draw(drawCmdBuffers[i]);
 
+				// Glow parts
+				vkCmdBindPipeline(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pipelines.glowPass);
 				models.ufoGlow.draw(drawCmdBuffers[i]);
 
 				vkCmdEndRenderPass(drawCmdBuffers[i]);
+			}
 
-				/*
-					Second render pass: Vertical blur
-
-					Render contents of the first pass into a second framebuffer and apply a vertical blur
-					This is the first blur pass, the horizontal blur is applied when rendering on top of the scene
-				*/
-
-				renderPassBeginInfo.framebuffer = offscreenPass.framebuffers[1].framebuffer;
-
-				vkCmdBeginRenderPass(drawCmdBuffers[i], &renderPassBeginInfo, VK_SUBPASS_CONTENTS_INLINE);
-
-				vkCmdBindDescriptorSets(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayouts.blur, 0, 1, &descriptorSets.blurVert, 0, NULL);
-				vkCmdBindPipeline(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pipelines.blurVert);
-				vkCmdDraw(drawCmdBuffers[i], 3, 1, 0, 0);
-
-				vkCmdEndRenderPass(drawCmdBuffers[i]);
+			if (timings.queryPool != VK_NULL_HANDLE) {
+				vkCmdWriteTimestamp(drawCmdBuffers[i], VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, timings.queryPool, firstQuery + 1);
 			}
 
 			/*
-				Note: Explicit synchronization is not required between the render pass, as this is done implicit via sub pass dependencies
+				Bloom: Threshold and downsample the scene into the mip chain, then upsample it again adding each level onto the next larger one
 			*/
+			if (bloom) {
+				// The previous frame's composition may still read the chain
+				VkMemoryBarrier memoryBarrier = vks::initializers::memoryBarrier();
+				memoryBarrier.srcAccessMask = VK_ACCESS_SHADER_READ_BIT;
+				memoryBarrier.dstAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+				vkCmdPipelineBarrier(drawCmdBuffers[i], VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1, &memoryBarrier, 0, nullptr, 0, nullptr);
+
+				// The first level applies the threshold with firefly suppression
+				vkCmdBindPipeline(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_COMPUTE, pipelines.bloomPrefilter);
+				dispatchBloomLevel(drawCmdBuffers[i], descriptorSets.bloomDownsample[0], bloomChain.extents[0]);
+				vkCmdBindPipeline(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_COMPUTE, pipelines.bloomDownsample);
+				for (uint32_t level = 1; level < bloomChain.levels; level++) {
+					bloomBarrier(drawCmdBuffers[i], VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT);
+					dispatchBloomLevel(drawCmdBuffers[i], descriptorSets.bloomDownsample[level], bloomChain.extents[level]);
+				}
+				if (timings.queryPool != VK_NULL_HANDLE) {
+					vkCmdWriteTimestamp(drawCmdBuffers[i], VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, timings.queryPool, firstQuery + 2);
+				}
 
-			/*
-				Third render pass: Scene rendering with applied vertical blur
+				vkCmdBindPipeline(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_COMPUTE, pipelines.bloomUpsample);
+				for (int32_t level = static_cast<int32_t>(bloomChain.levels) - 2; level >= 0; level--) {
+					bloomBarrier(drawCmdBuffers[i], VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT);
+					dispatchBloomLevel(drawCmdBuffers[i], descriptorSets.bloomUpsample[level], bloomChain.extents[level]);
+				}
+				bloomBarrier(drawCmdBuffers[i], VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT);
+			}
+			else if (timings.queryPool != VK_NULL_HANDLE) {
+				vkCmdWriteTimestamp(drawCmdBuffers[i], VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, timings.queryPool, firstQuery + 2);
+			}
 
-				Renders the scene and the (vertically blurred) contents of the second framebuffer and apply a horizontal blur
+			if (timings.queryPool != VK_NULL_HANDLE) {
+				vkCmdWriteTimestamp(drawCmdBuffers[i], VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, timings.queryPool, firstQuery + 3);
+			}
 
+			/*
+				Second render pass: Compose the scene and the bloom into the swapchain image
 			*/
 			{
 				clearValues[0].color = defaultClearColor;
@@ -424,27 +536,20 @@ public:
 				VkRect2D scissor = vks::initializers::rect2D(width, height, 0, 0);
 				vkCmdSetScissor(drawCmdBuffers[i], 0, 1, &scissor);
 
-				// Skybox
-				vkCmdBindDescriptorSets(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayouts.scene, 0, 1, &descriptorSets.skyBox, 0, NULL);
-				vkCmdBindPipeline(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pipelines.skyBox);
-				models.skyBox.draw(drawCmdBuffers[i]);
-
-				// 3D scene
-				vkCmdBindDescriptorSets(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayouts.scene, 0, 1, &descriptorSets.scene, 0, NULL);
-				vkCmdBindPipeline(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pipelines.phongPass);
-				models.ufo.draw(drawCmdBuffers[i]);
-
-				if (bloom)
-				{
-					vkCmdBindDescriptorSets(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayouts.blur, 0, 1, &descriptorSets.blurHorz, 0, NULL);
-					vkCmdBindPipeline(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pipelines.blurHorz);
-					vkCmdDraw(drawCmdBuffers[i], 3, 1, 0, 0);
-				}
+				vkCmdBindDescriptorSets(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayouts.composition, 0, 1, &descriptorSets.composition, 0, NULL);
+				vkCmdBindPipeline(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pipelines.composition);
+				// Bloom is disabled by scaling it with zero
+				const float bloomScale = bloom ? 1.0f : 0.0f;
+				vkCmdPushConstants(drawCmdBuffers[i], pipelineLayouts.composition, VK_SHADER_STAGE_FRAGMENT_BIT, 0, sizeof(float), &bloomScale);
+				vkCmdDraw(drawCmdBuffers[i], 3, 1, 0, 0);
 
 				drawUI(drawCmdBuffers[i]);
 
 				vkCmdEndRenderPass(drawCmdBuffers[i]);
+			}
 
+			if (timings.queryPool != VK_NULL_HANDLE) {
+				vkCmdWriteTimestamp(drawCmdBuffers[i], VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, timings.queryPool, firstQuery + 4);
 			}
 
 			VK_CHECK_RESULT(vkEndCommandBuffer(drawCmdBuffers[i]));
@@ -462,11 +567,14 @@ public:
 
 	void setupDescriptorPool()
 	{
+		// The bloom sets are allocated for the largest possible chain, so resizing only has to update them
+		const uint32_t bloomSetCount = BLOOM_MAX_LEVELS * 2 - 1;
 		std::vector<VkDescriptorPoolSize> poolSizes = {
-			vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 8),
-			vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 6)
+			vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 4 + bloomSetCount),
+			vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 4 + bloomSetCount),
+			vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, bloomSetCount)
 		};
-		VkDescriptorPoolCreateInfo descriptorPoolInfo = vks::initializers::descriptorPoolCreateInfo(poolSizes, 5);
+		VkDescriptorPoolCreateInfo descriptorPoolInfo = vks::initializers::descriptorPoolCreateInfo(poolSizes, 3 + bloomSetCount);
 		VK_CHECK_RESULT(vkCreateDescriptorPool(device, &descriptorPoolInfo, nullptr, &descriptorPool));
 	}
 
@@ -476,15 +584,30 @@ public:
 		VkDescriptorSetLayoutCreateInfo descriptorSetLayoutCreateInfo;
 		VkPipelineLayoutCreateInfo pipelineLayoutCreateInfo;
 
-		// Fullscreen blur
+		// Bloom downsample and upsample
+		setLayoutBindings = {
+			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_COMPUTE_BIT, 0),	// Binding 0: Source level
+			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, VK_SHADER_STAGE_COMPUTE_BIT, 1),			// Binding 1: Destination level
+			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT, 2),			// Binding 2: Bloom parameters
+		};
+		descriptorSetLayoutCreateInfo = vks::initializers::descriptorSetLayoutCreateInfo(setLayoutBindings.data(), static_cast<uint32_t>(setLayoutBindings.size()));
+		VK_CHECK_RESULT(vkCreateDescriptorSetLayout(device, &descriptorSetLayoutCreateInfo, nullptr, &descriptorSetLayouts.bloom));
+		pipelineLayoutCreateInfo = vks::initializers::pipelineLayoutCreateInfo(&descriptorSetLayouts.bloom, 1);
+		VK_CHECK_RESULT(vkCreatePipelineLayout(device, &pipelineLayoutCreateInfo, nullptr, &pipelineLayouts.bloom));
+
+		// Composition
 		setLayoutBindings = {
-			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, VK_SHADER_STAGE_FRAGMENT_BIT, 0),			// Binding 0: Fragment shader uniform buffer
-			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_FRAGMENT_BIT, 1)	// Binding 1: Fragment shader image sampler
+			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_FRAGMENT_BIT, 0),	// Binding 0: Scene color
+			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_FRAGMENT_BIT, 1),	// Binding 1: First bloom level
+			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, VK_SHADER_STAGE_FRAGMENT_BIT, 2),			// Binding 2: Bloom parameters
 		};
 		descriptorSetLayoutCreateInfo = vks::initializers::descriptorSetLayoutCreateInfo(setLayoutBindings.data(), static_cast<uint32_t>(setLayoutBindings.size()));
-		VK_CHECK_RESULT(vkCreateDescriptorSetLayout(device, &descriptorSetLayoutCreateInfo, nullptr, &descriptorSetLayouts.blur));
-		pipelineLayoutCreateInfo = vks::initializers::pipelineLayoutCreateInfo(&descriptorSetLayouts.blur, 1);
-		VK_CHECK_RESULT(vkCreatePipelineLayout(device, &pipelineLayoutCreateInfo, nullptr, &pipelineLayouts.blur));
+		VK_CHECK_RESULT(vkCreateDescriptorSetLayout(device, &descriptorSetLayoutCreateInfo, nullptr, &descriptorSetLayouts.composition));
+		pipelineLayoutCreateInfo = vks::initializers::pipelineLayoutCreateInfo(&descriptorSetLayouts.composition, 1);
+		VkPushConstantRange pushConstantRange = vks::initializers::pushConstantRange(VK_SHADER_STAGE_FRAGMENT_BIT, sizeof(float), 0);
+		pipelineLayoutCreateInfo.pushConstantRangeCount = 1;
+		pipelineLayoutCreateInfo.pPushConstantRanges = &pushConstantRange;
+		VK_CHECK_RESULT(vkCreatePipelineLayout(device, &pipelineLayoutCreateInfo, nullptr, &pipelineLayouts.composition));
 
 		// Scene rendering
 		setLayoutBindings = {
@@ -504,23 +627,19 @@ public:
 		VkDescriptorSetAllocateInfo descriptorSetAllocInfo;
 		std::vector<VkWriteDescriptorSet> writeDescriptorSets;
 
-		// Full screen blur
-		// Vertical
-		descriptorSetAllocInfo = vks::initializers::descriptorSetAllocateInfo(descriptorPool, &descriptorSetLayouts.blur, 1);
-		VK_CHECK_RESULT(vkAllocateDescriptorSets(device, &descriptorSetAllocInfo, &descriptorSets.blurVert));
-		writeDescriptorSets = {
-			vks::initializers::writeDescriptorSet(descriptorSets.blurVert, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 0, &uniformBuffers.blurParams.descriptor),				// Binding 0: Fragment shader uniform buffer
-			vks::initializers::writeDescriptorSet(descriptorSets.blurVert, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 1, &offscreenPass.framebuffers[0].descriptor),	// Binding 1: Fragment shader texture sampler
-		};
-		vkUpdateDescriptorSets(device, writeDescriptorSets.size(), writeDescriptorSets.data(), 0, NULL);
-		// Horizontal
-		descriptorSetAllocInfo = vks::initializers::descriptorSetAllocateInfo(descriptorPool, &descriptorSetLayouts.blur, 1);
-		VK_CHECK_RESULT(vkAllocateDescriptorSets(device, &descriptorSetAllocInfo, &descriptorSets.blurHorz));
-		writeDescriptorSets = {
-			vks::initializers::writeDescriptorSet(descriptorSets.blurHorz, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 0, &uniformBuffers.blurParams.descriptor),				// Binding 0: Fragment shader uniform buffer
-			vks::initializers::writeDescriptorSet(descriptorSets.blurHorz, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 1, &offscreenPass.framebuffers[1].descriptor),	// Binding 1: Fragment shader texture sampler
-		};
-		vkUpdateDescriptorSets(device, writeDescriptorSets.size(), writeDescriptorSets.data(), 0, NULL);
+		// Bloom levels
+		std::array<VkDescriptorSetLayout, BLOOM_MAX_LEVELS> bloomSetLayouts;
+		bloomSetLayouts.fill(descriptorSetLayouts.bloom);
+		descriptorSetAllocInfo = vks::initializers::descriptorSetAllocateInfo(descriptorPool, bloomSetLayouts.data(), static_cast<uint32_t>(descriptorSets.bloomDownsample.size()));
+		VK_CHECK_RESULT(vkAllocateDescriptorSets(device, &descriptorSetAllocInfo, descriptorSets.bloomDownsample.data()));
+		descriptorSetAllocInfo = vks::initializers::descriptorSetAllocateInfo(descriptorPool, bloomSetLayouts.data(), static_cast<uint32_t>(descriptorSets.bloomUpsample.size()));
+		VK_CHECK_RESULT(vkAllocateDescriptorSets(device, &descriptorSetAllocInfo, descriptorSets.bloomUpsample.data()));
+
+		// Composition
+		descriptorSetAllocInfo = vks::initializers::descriptorSetAllocateInfo(descriptorPool, &descriptorSetLayouts.composition, 1);
+		VK_CHECK_RESULT(vkAllocateDescriptorSets(device, &descriptorSetAllocInfo, &descriptorSets.composition));
+
+		updateImageDescriptorSets();
 
 		// Scene rendering
 		descriptorSetAllocInfo = vks::initializers::descriptorSetAllocateInfo(descriptorPool, &descriptorSetLayouts.scene, 1);
@@ -539,20 +658,50 @@ public:
 		vkUpdateDescriptorSets(device, writeDescriptorSets.size(), writeDescriptorSets.data(), 0, NULL);
 	}
 
+	// Points the bloom and composition sets at the current scene target and bloom chain
+	void updateImageDescriptorSets()
+	{
+		VkDescriptorImageInfo sceneDescriptor = vks::initializers::descriptorImageInfo(offscreenPass.sampler, offscreenPass.color.view, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+		std::array<VkDescriptorImageInfo, BLOOM_MAX_LEVELS> sampledLevels;
+		std::array<VkDescriptorImageInfo, BLOOM_MAX_LEVELS> storageLevels;
+		for (uint32_t i = 0; i < bloomChain.levels; i++) {
+			sampledLevels[i] = vks::initializers::descriptorImageInfo(offscreenPass.sampler, bloomChain.views[i], VK_IMAGE_LAYOUT_GENERAL);
+			storageLevels[i] = vks::initializers::descriptorImageInfo(VK_NULL_HANDLE, bloomChain.views[i], VK_IMAGE_LAYOUT_GENERAL);
+		}
+
+		std::vector<VkWriteDescriptorSet> writeDescriptorSets;
+		for (uint32_t i = 0; i < bloomChain.levels; i++) {
+			VkDescriptorSet set = descriptorSets.bloomDownsample[i];
+			writeDescriptorSets.push_back(vks::initializers::writeDescriptorSet(set, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 0, (i == 0) ? &sceneDescriptor : &sampledLevels[i - 1]));
+			writeDescriptorSets.push_back(vks::initializers::writeDescriptorSet(set, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, 1, &storageLevels[i]));
+			writeDescriptorSets.push_back(vks::initializers::writeDescriptorSet(set, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 2, &uniformBuffers.bloomParams.descriptor));
+		}
+		for (uint32_t i = 0; i + 1 < bloomChain.levels; i++) {
+			VkDescriptorSet set = descriptorSets.bloomUpsample[i];
+			writeDescriptorSets.push_back(vks::initializers::writeDescriptorSet(set, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 0, &sampledLevels[i + 1]));
+			writeDescriptorSets.push_back(vks::initializers::writeDescriptorSet(set, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, 1, &storageLevels[i]));
+			writeDescriptorSets.push_back(vks::initializers::writeDescriptorSet(set, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 2, &uniformBuffers.bloomParams.descriptor));
+		}
+		writeDescriptorSets.push_back(vks::initializers::writeDescriptorSet(descriptorSets.composition, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 0, &sceneDescriptor));
+		writeDescriptorSets.push_back(vks::initializers::writeDescriptorSet(descriptorSets.composition, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 1, &sampledLevels[0]));
+		writeDescriptorSets.push_back(vks::initializers::writeDescriptorSet(descriptorSets.composition, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 2, &uniformBuffers.bloomParams.descriptor));
+		vkUpdateDescriptorSets(device, static_cast<uint32_t>(writeDescriptorSets.size()), writeDescriptorSets.data(), 0, nullptr);
+	}
+
 	void preparePipelines()
 	{
 		VkPipelineInputAssemblyStateCreateInfo inputAssemblyStateCI = vks::initializers::pipelineInputAssemblyStateCreateInfo(VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST, 0, VK_FALSE);
 		VkPipelineRasterizationStateCreateInfo rasterizationStateCI = vks::initializers::pipelineRasterizationStateCreateInfo(VK_POLYGON_MODE_FILL, VK_CULL_MODE_NONE, VK_FRONT_FACE_COUNTER_CLOCKWISE, 0);
 		VkPipelineColorBlendAttachmentState blendAttachmentState = vks::initializers::pipelineColorBlendAttachmentState(0xf, VK_FALSE);
 		VkPipelineColorBlendStateCreateInfo colorBlendStateCI = vks::initializers::pipelineColorBlendStateCreateInfo(1, &blendAttachmentState);
-		VkPipelineDepthStencilStateCreateInfo depthStencilStateCI = vks::initializers::pipelineDepthStencilStateCreateInfo(VK_TRUE, VK_TRUE, VK_COMPARE_OP_LESS_OR_EQUAL);
+		VkPipelineDepthStencilStateCreateInfo depthStencilStateCI = vks::initializers::pipelineDepthStencilStateCreateInfo(VK_FALSE, VK_FALSE, VK_COMPARE_OP_LESS_OR_EQUAL);
 		VkPipelineViewportStateCreateInfo viewportStateCI = vks::initializers::pipelineViewportStateCreateInfo(1, 1, 0);
 		VkPipelineMultisampleStateCreateInfo multisampleStateCI = vks::initializers::pipelineMultisampleStateCreateInfo(VK_SAMPLE_COUNT_1_BIT, 0);
 		std::vector<VkDynamicState> dynamicStateEnables = { VK_DYNAMIC_STATE_VIEWPORT, VK_DYNAMIC_STATE_SCISSOR };
 		VkPipelineDynamicStateCreateInfo dynamicStateCI = vks::initializers::pipelineDynamicStateCreateInfo(dynamicStateEnables.data(), dynamicStateEnables.size(), 0);
 		std::array<VkPipelineShaderStageCreateInfo, 2> shaderStages;
 
-		VkGraphicsPipelineCreateInfo pipelineCI = vks::initializers::pipelineCreateInfo(pipelineLayouts.blur, renderPass, 0);
+		VkGraphicsPipelineCreateInfo pipelineCI = vks::initializers::pipelineCreateInfo(pipelineLayouts.composition, renderPass, 0);
 		pipelineCI.pInputAssemblyState = &inputAssemblyStateCI;
 		pipelineCI.pRasterizationState = &rasterizationStateCI;
 		pipelineCI.pColorBlendState = &colorBlendStateCI;
@@ -563,60 +712,64 @@ public:
 		pipelineCI.stageCount = shaderStages.size();
 		pipelineCI.pStages = shaderStages.data();
 
-		// Blur pipelines
-		shaderStages[0] = loadShader(getShadersPath() + "bloom/gaussblur.vert.spv", VK_SHADER_STAGE_VERTEX_BIT);
-		shaderStages[1] = loadShader(getShadersPath() + "bloom/gaussblur.frag.spv", VK_SHADER_STAGE_FRAGMENT_BIT);
+		// Composition pipeline, full screen triangle
+		shaderStages[0] = loadShader(getShadersPath() + "bloom/composition.vert.spv", VK_SHADER_STAGE_VERTEX_BIT);
+		shaderStages[1] = loadShader(getShadersPath() + "bloom/composition.frag.spv", VK_SHADER_STAGE_FRAGMENT_BIT);
 		// Empty vertex input state
 		VkPipelineVertexInputStateCreateInfo emptyInputState = vks::initializers::pipelineVertexInputStateCreateInfo();
 		pipelineCI.pVertexInputState = &emptyInputState;
-		pipelineCI.layout = pipelineLayouts.blur;
-		// Additive blending
-		blendAttachmentState.colorWriteMask = 0xF;
-		blendAttachmentState.blendEnable = VK_TRUE;
-		blendAttachmentState.colorBlendOp = VK_BLEND_OP_ADD;
-		blendAttachmentState.srcColorBlendFactor = VK_BLEND_FACTOR_ONE;
-		blendAttachmentState.dstColorBlendFactor = VK_BLEND_FACTOR_ONE;
-		blendAttachmentState.alphaBlendOp = VK_BLEND_OP_ADD;
-		blendAttachmentState.srcAlphaBlendFactor = VK_BLEND_FACTOR_SRC_ALPHA;
-		blendAttachmentState.dstAlphaBlendFactor = VK_BLEND_FACTOR_DST_ALPHA;
-
-		// Use specialization constants to select between horizontal and vertical blur
-		uint32_t blurdirection = 0;
-		VkSpecializationMapEntry specializationMapEntry = vks::initializers::specializationMapEntry(0, 0, sizeof(uint32_t));
-		VkSpecializationInfo specializationInfo = vks::initializers::specializationInfo(1, &specializationMapEntry, sizeof(uint32_t), &blurdirection);
-		shaderStages[1].pSpecializationInfo = &specializationInfo;
-		// Vertical blur pipeline
-		pipelineCI.renderPass = offscreenPass.renderPass;
-		VK_CHECK_RESULT(vkCreateGraphicsPipelines(device, pipelineCache, 1, &pipelineCI, nullptr, &pipelines.blurVert));
-		// Horizontal blur pipeline
-		blurdirection = 1;
-		pipelineCI.renderPass = renderPass;
-		VK_CHECK_RESULT(vkCreateGraphicsPipelines(device, pipelineCache, 1, &pipelineCI, nullptr, &pipelines.blurHorz));
+		VK_CHECK_RESULT(vkCreateGraphicsPipelines(device, pipelineCache, 1, &pipelineCI, nullptr, &pipelines.composition));
 
 		// Phong pass (3D model)
 		pipelineCI.pVertexInputState = vkglTF::Vertex::getPipelineVertexInputState({vkglTF::VertexComponent::Position, vkglTF::VertexComponent::UV, vkglTF::VertexComponent::Color, vkglTF::VertexComponent::Normal});
 		pipelineCI.layout = pipelineLayouts.scene;
+		pipelineCI.renderPass = offscreenPass.renderPass;
 		shaderStages[0] = loadShader(getShadersPath() + "bloom/phongpass.vert.spv", VK_SHADER_STAGE_VERTEX_BIT);
 		shaderStages[1] = loadShader(getShadersPath() + "bloom/phongpass.frag.spv", VK_SHADER_STAGE_FRAGMENT_BIT);
-		blendAttachmentState.blendEnable = VK_FALSE;
+		depthStencilStateCI.depthTestEnable = VK_TRUE;
 		depthStencilStateCI.depthWriteEnable = VK_TRUE;
 		rasterizationStateCI.cullMode = VK_CULL_MODE_BACK_BIT;
-		pipelineCI.renderPass = renderPass;
 		VK_CHECK_RESULT(vkCreateGraphicsPipelines(device, pipelineCache, 1, &pipelineCI, nullptr, &pipelines.phongPass));
 
-		// Color only pass (offscreen blur base)
+		// Glow pass, adds the emissive color of the glow parts on top of the shaded model
+		// The emissive strength pushes these parts above the bloom threshold
+		float emissiveStrength = 2.0f;
+		VkSpecializationMapEntry specializationMapEntry = vks::initializers::specializationMapEntry(0, 0, sizeof(float));
+		VkSpecializationInfo specializationInfo = vks::initializers::specializationInfo(1, &specializationMapEntry, sizeof(float), &emissiveStrength);
 		shaderStages[0] = loadShader(getShadersPath() + "bloom/colorpass.vert.spv", VK_SHADER_STAGE_VERTEX_BIT);
 		shaderStages[1] = loadShader(getShadersPath() + "bloom/colorpass.frag.spv", VK_SHADER_STAGE_FRAGMENT_BIT);
-		pipelineCI.renderPass = offscreenPass.renderPass;
+		shaderStages[1].pSpecializationInfo = &specializationInfo;
+		depthStencilStateCI.depthWriteEnable = VK_FALSE;
+		blendAttachmentState.blendEnable = VK_TRUE;
+		blendAttachmentState.colorBlendOp = VK_BLEND_OP_ADD;
+		blendAttachmentState.srcColorBlendFactor = VK_BLEND_FACTOR_ONE;
+		blendAttachmentState.dstColorBlendFactor = VK_BLEND_FACTOR_ONE;
+		blendAttachmentState.alphaBlendOp = VK_BLEND_OP_ADD;
+		blendAttachmentState.srcAlphaBlendFactor = VK_BLEND_FACTOR_ZERO;
+		blendAttachmentState.dstAlphaBlendFactor = VK_BLEND_FACTOR_ONE;
 		VK_CHECK_RESULT(vkCreateGraphicsPipelines(device, pipelineCache, 1, &pipelineCI, nullptr, &pipelines.glowPass));
 
 		// Skybox (cubemap)
 		shaderStages[0] = loadShader(getShadersPath() + "bloom/skybox.vert.spv", VK_SHADER_STAGE_VERTEX_BIT);
 		shaderStages[1] = loadShader(getShadersPath() + "bloom/skybox.frag.spv", VK_SHADER_STAGE_FRAGMENT_BIT);
+		blendAttachmentState.blendEnable = VK_FALSE;
 		depthStencilStateCI.depthWriteEnable = VK_FALSE;
 		rasterizationStateCI.cullMode = VK_CULL_MODE_FRONT_BIT;
-		pipelineCI.renderPass = renderPass;
 		VK_CHECK_RESULT(vkCreateGraphicsPipelines(device, pipelineCache, 1, &pipelineCI, nullptr, &pipelines.skyBox));
+
+		// Bloom compute pipelines
+		// The prefilter variant of the downsample shader applies the threshold to the scene color
+		VkBool32 prefilter = VK_TRUE;
+		specializationMapEntry = vks::initializers::specializationMapEntry(0, 0, sizeof(VkBool32));
+		specializationInfo = vks::initializers::specializationInfo(1, &specializationMapEntry, sizeof(VkBool32), &prefilter);
+		VkComputePipelineCreateInfo computePipelineCI = vks::initializers::computePipelineCreateInfo(pipelineLayouts.bloom, 0);
+		computePipelineCI.stage = loadShader(getShadersPath() + "bloom/downsample.comp.spv", VK_SHADER_STAGE_COMPUTE_BIT);
+		computePipelineCI.stage.pSpecializationInfo = &specializationInfo;
+		VK_CHECK_RESULT(vkCreateComputePipelines(device, pipelineCache, 1, &computePipelineCI, nullptr, &pipelines.bloomPrefilter));
+		prefilter = VK_FALSE;
+		VK_CHECK_RESULT(vkCreateComputePipelines(device, pipelineCache, 1, &computePipelineCI, nullptr, &pipelines.bloomDownsample));
+		computePipelineCI.stage = loadShader(getShadersPath() + "bloom/upsample.comp.spv", VK_SHADER_STAGE_COMPUTE_BIT);
+		VK_CHECK_RESULT(vkCreateComputePipelines(device, pipelineCache, 1, &computePipelineCI, nullptr, &pipelines.bloomUpsample));
 	}
 
 	// Prepare and initialize uniform buffer containing shader uniforms
@@ -629,12 +782,12 @@ public:
 			&uniformBuffers.scene,
 			sizeof(ubos.scene)));
 
-		// Blur parameters uniform buffers
+		// Bloom parameters uniform buffers
 		VK_CHECK_RESULT(vulkanDevice->createBuffer(
 			VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
 			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
-			&uniformBuffers.blurParams,
-			sizeof(ubos.blurParams)));
+			&uniformBuffers.bloomParams,
+			sizeof(ubos.bloomParams)));
 
 		// Skybox
 		VK_CHECK_RESULT(vulkanDevice->createBuffer(
@@ -645,12 +798,12 @@ public:
 
 		// Map persistent
 		VK_CHECK_RESULT(uniformBuffers.scene.map());
-		VK_CHECK_RESULT(uniformBuffers.blurParams.map());
+		VK_CHECK_RESULT(uniformBuffers.bloomParams.map());
 		VK_CHECK_RESULT(uniformBuffers.skyBox.map());
 
 		// Initialize uniform buffers
 		updateUniformBuffersScene();
-		updateUniformBuffersBlur();
+		updateUniformBuffersBloom();
 	}
 
 	// Update uniform buffers for rendering the 3D scene
@@ -674,10 +827,25 @@ public:
 		memcpy(uniformBuffers.skyBox.mapped, &ubos.skyBox, sizeof(ubos.skyBox));
 	}
 
-	// Update blur pass parameter uniform buffer
-	void updateUniformBuffersBlur()
+	// Update bloom parameter uniform buffer
+	void updateUniformBuffersBloom()
 	{
-		memcpy(uniformBuffers.blurParams.mapped, &ubos.blurParams, sizeof(ubos.blurParams));
+		memcpy(uniformBuffers.bloomParams.mapped, &ubos.bloomParams, sizeof(ubos.bloomParams));
+	}
+
+	// Reads the timestamps of the frame that just finished
+	void updateTimings()
+	{
+		if (timings.queryPool == VK_NULL_HANDLE) {
+			return;
+		}
+		std::array<uint64_t, StageCount + 1> timestamps;
+		if (vkGetQueryPoolResults(device, timings.queryPool, currentBuffer * (StageCount + 1), StageCount + 1, sizeof(timestamps), timestamps.data(), sizeof(uint64_t), VK_QUERY_RESULT_64_BIT) == VK_SUCCESS) {
+			const float timestampPeriod = vulkanDevice->properties.limits.timestampPeriod;
+			for (uint32_t i = 0; i < StageCount; i++) {
+				timings.stages[i] = static_cast<float>(timestamps[i + 1] - timestamps[i]) * timestampPeriod / 1000000.0f;
+			}
+		}
 	}
 
 	void draw()
@@ -687,6 +855,7 @@ public:
 		submitInfo.pCommandBuffers = &drawCmdBuffers[currentBuffer];
 		VK_CHECK_RESULT(vkQueueSubmit(queue, 1, &submitInfo, VK_NULL_HANDLE));
 		VulkanExampleBase::submitFrame();
+		updateTimings();
 	}
 
 	void prepare()
@@ -695,6 +864,7 @@ public:
 		loadAssets();
 		prepareUniformBuffers();
 		prepareOffscreen();
+		prepareTimestamps();
 		setupDescriptorSetLayout();
 		preparePipelines();
 		setupDescriptorPool();
@@ -703,6 +873,18 @@ public:
 		prepared = true;
 	}
 
+	// The scene target and the bloom chain depend on the window size, the number of command buffers on the swapchain
+	virtual void setupFrameBuffer()
+	{
+		VulkanExampleBase::setupFrameBuffer();
+		if (offscreenPass.renderPass != VK_NULL_HANDLE) {
+			destroyOffscreenImages();
+			prepareOffscreenImages();
+			updateImageDescriptorSets();
+			prepareTimestamps();
+		}
+	}
+
 	virtual void render()
 	{
 		if (!prepared)
@@ -720,8 +902,23 @@ public:
 			if (overlay->checkBox("Bloom", &bloom)) {
 				buildCommandBuffers();
 			}
-			if (overlay->inputFloat("Scale", &ubos.blurParams.blurScale, 0.1f, 2)) {
-				updateUniformBuffersBlur();
+			if (overlay->sliderFloat("Intensity", &ubos.bloomParams.intensity, 0.0f, 2.0f)) {
+				updateUniformBuffersBloom();
+			}
+			if (overlay->sliderFloat("Radius", &ubos.bloomParams.radius, 0.5f, 4.0f)) {
+				updateUniformBuffersBloom();
+			}
+			if (overlay->sliderFloat("Threshold", &ubos.bloomParams.threshold, 0.0f, 4.0f)) {
+				updateUniformBuffersBloom();
+			}
+		}
+		if (overlay->header("Statistics")) {
+			overlay->text("Bloom levels: %d", bloomChain.levels);
+			if (timings.queryPool != VK_NULL_HANDLE) {
+				overlay->text("Scene: %.3f ms", timings.stages[StageScene]);
+				overlay->text("Threshold + downsample: %.3f ms", timings.stages[StageDownsample]);
+				overlay->text("Upsample: %.3f ms", timings.stages[StageUpsample]);
+				overlay->text("Composition: %.3f ms", timings.stages[StageComposition]);
 			}
 		}
 	}
@@ -1,6 +1,11 @@
 /*
 * Vulkan Example - Compute shader cloth simulation
 *
+* Cloth pieces are simulated with extended position based dynamics (XPBD), see xpbdcloth.h for the data layout
+* Every substep predicts the particle positions and solves the constraints inside 16x16 tiles in shared memory,
+* followed by one dispatch per colour batch of the constraints crossing tiles. Particles collide with the triangles
+* of the scene geometry, looked up in a spatial hash
+*
 * Copyright (C) 2016-2017 by Sascha Willems - www.saschawillems.de
 *
 * This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
@@ -8,6 +13,7 @@
 
 #include "vulkanexamplebase.h"
 #include "VulkanglTFModel.h"
+#include "xpbdcloth.h"
 
 #define ENABLE_VALIDATION false
 
@@ -15,14 +21,17 @@ class VulkanExample : public VulkanExampleBase
 {
 public:
 	uint32_t sceneSetup = 0;
-	uint32_t readSet = 0;
 	uint32_t indexCount;
 	bool simulateWind = false;
-	bool specializedComputeQueue = false;
 
 	vks::Texture2D textureCloth;
 	vkglTF::Model modelSphere;
 
+	XpbdCloth xpbdCloth;
+	CollisionHash collisionHash;
+	// One collision sphere below every cloth piece, drawn with the offset as a push constant
+	std::vector<glm::vec4> sphereOffsets;
+
 	// Resources for the graphics part of the example
 	struct {
 		VkDescriptorSetLayout descriptorSetLayout;
@@ -34,6 +43,8 @@ public:
 		} pipelines;
 		vks::Buffer indices;
 		vks::Buffer uniformBuffer;
+		// Shared async compute buffer the cloth is drawn from
+		uint32_t vertexBuffer;
 		struct graphicsUBO {
 			glm::mat4 projection;
 			glm::mat4 view;
@@ -42,51 +53,61 @@ public:
 	} graphics;
 
 	// Resources for the compute part of the example
+	// Queue, command pool and synchronization with graphics are handled by the async compute service of the base class
 	struct {
+		// Only used on the compute queue, graphics draws copies of the particle buffer
 		struct StorageBuffers {
-			vks::Buffer input;
-			vks::Buffer output;
+			vks::Buffer particles;
+			vks::Buffer previous;
+			vks::Buffer tiles;
+			vks::Buffer tileConstraints;
+			vks::Buffer boundaryConstraints;
+			vks::Buffer neighbours;
+			vks::Buffer triangles;
+			vks::Buffer hashCells;
+			vks::Buffer hashEntries;
 		} storageBuffers;
-		struct Semaphores {
-			VkSemaphore ready{ 0L };
-			VkSemaphore complete{ 0L };
-		} semaphores;
 		vks::Buffer uniformBuffer;
-		VkQueue queue;
-		VkCommandPool commandPool;
-		std::array<VkCommandBuffer,2> commandBuffers;
+		// One command buffer per shared buffer slot
+		std::array<VkCommandBuffer, vks::AsyncCompute::slotCount> commandBuffers;
 		VkDescriptorSetLayout descriptorSetLayout;
-		std::array<VkDescriptorSet,2> descriptorSets;
+		VkDescriptorSet descriptorSet;
 		VkPipelineLayout pipelineLayout;
-		VkPipeline pipeline;
+		struct Pipelines {
+			VkPipeline solve;
+			VkPipeline boundary;
+			VkPipeline finalize;
+		} pipelines;
+		int32_t substeps = 8;
 		struct computeUBO {
+			// Time step of a single substep
 			float deltaT = 0.0f;
-			float particleMass = 0.1f;
-			float springStiffness = 2000.0f;
-			float damping = 0.25f;
-			float restDistH;
-			float restDistV;
-			float restDistD;
-			float sphereRadius = 1.0f;
-			glm::vec4 spherePos = glm::vec4(0.0f, 0.0f, 0.0f, 0.0f);
+			float damping = 0.1f;
+			float thickness = 0.02f;
+			float friction = 0.3f;
 			glm::vec4 gravity = glm::vec4(0.0f, 9.8f, 0.0f, 0.0f);
-			glm::ivec2 particleCount;
+			// Inverse stiffness of the stretch, shear and bending constraints
+			glm::vec4 compliance = glm::vec4(0.0f, 1.0e-6f, 1.0e-4f, 0.0f);
+			float hashCellSize = 1.0f;
+			uint32_t hashTableSize = 0;
+			uint32_t particleCount = 0;
+			// Iterations over the constraints inside a tile per substep
+			uint32_t localIterations = 4;
 		} ubo;
 	} compute;
 
-	// SSBO cloth grid particle declaration
-	struct Particle {
-		glm::vec4 pos;
-		glm::vec4 vel;
-		glm::vec4 uv;
-		glm::vec4 normal;
-		float pinned;
-		glm::vec3 _pad0;
+	struct ComputePushConstants {
+		// Colour batch of the boundary constraints
+		uint32_t firstConstraint;
+		uint32_t constraintCount;
+		// The first substep of a frame starts from the stored velocities
+		uint32_t firstSubstep;
 	};
 
 	struct Cloth {
 		glm::uvec2 gridsize = glm::uvec2(60, 60);
 		glm::vec2 size = glm::vec2(5.0f);
+		uint32_t count = 1;
 	} cloth;
 
 	VulkanExample() : VulkanExampleBase(ENABLE_VALIDATION)
@@ -96,6 +117,21 @@ public:
 		camera.setPerspective(60.0f, (float)width / (float)height, 0.1f, 512.0f);
 		camera.setRotation(glm::vec3(-30.0f, -45.0f, 0.0f));
 		camera.setTranslation(glm::vec3(0.0f, 0.0f, -5.0f));
+		// Compute runs on its own queue concurrently with graphics, timeline semaphores require at least Vulkan 1.1
+		useAsyncCompute = true;
+		apiVersion = VK_API_VERSION_1_1;
+
+		commandLineParser.add("gridsize", { "-gs", "--gridsize" }, 1, "Set the number of particles along each side of a cloth piece");
+		commandLineParser.add("clothcount", { "-cc", "--clothcount" }, 1, "Set the number of cloth pieces");
+		commandLineParser.add("solverbenchmark", { "-sb", "--solverbenchmark" }, 0, "Time the cloth solver on the compute queue, print its throughput and exit (use a USE_HEADLESS build to run without a window)");
+		commandLineParser.parse(args);
+		if (commandLineParser.isSet("gridsize")) {
+			const uint32_t gridsize = std::max(2, commandLineParser.getValueAsInt("gridsize", cloth.gridsize.x));
+			cloth.gridsize = glm::uvec2(gridsize);
+		}
+		if (commandLineParser.isSet("clothcount")) {
+			cloth.count = std::max(1, commandLineParser.getValueAsInt("clothcount", cloth.count));
+		}
 	}
 
 	~VulkanExample()
@@ -110,15 +146,21 @@ public:
 		textureCloth.destroy();
 
 		// Compute
-		compute.storageBuffers.input.destroy();
-		compute.storageBuffers.output.destroy();
+		compute.storageBuffers.particles.destroy();
+		compute.storageBuffers.previous.destroy();
+		compute.storageBuffers.tiles.destroy();
+		compute.storageBuffers.tileConstraints.destroy();
+		compute.storageBuffers.boundaryConstraints.destroy();
+		compute.storageBuffers.neighbours.destroy();
+		compute.storageBuffers.triangles.destroy();
+		compute.storageBuffers.hashCells.destroy();
+		compute.storageBuffers.hashEntries.destroy();
 		compute.uniformBuffer.destroy();
 		vkDestroyPipelineLayout(device, compute.pipelineLayout, nullptr);
 		vkDestroyDescriptorSetLayout(device, compute.descriptorSetLayout, nullptr);
-		vkDestroyPipeline(device, compute.pipeline, nullptr);
-		vkDestroySemaphore(device, compute.semaphores.ready, nullptr);
-		vkDestroySemaphore(device, compute.semaphores.complete, nullptr);
-		vkDestroyCommandPool(device, compute.commandPool, nullptr);
+		vkDestroyPipeline(device, compute.pipelines.solve, nullptr);
+		vkDestroyPipeline(device, compute.pipelines.boundary, nullptr);
+		vkDestroyPipeline(device, compute.pipelines.finalize, nullptr);
 	}
 
 	// Enable physical device features required for this example
@@ -131,85 +173,38 @@ public:
 
 	void loadAssets()
 	{
-		const uint32_t glTFLoadingFlags = vkglTF::FileLoadingFlags::PreTransformVertices | vkglTF::FileLoadingFlags::PreMultiplyVertexColors | vkglTF::FileLoadingFlags::FlipY;
+		// The sphere geometry is kept on the host for the collision hash
+		const uint32_t glTFLoadingFlags = vkglTF::FileLoadingFlags::PreTransformVertices | vkglTF::FileLoadingFlags::PreMultiplyVertexColors | vkglTF::FileLoadingFlags::FlipY | vkglTF::FileLoadingFlags::KeepGeometry;
 		modelSphere.loadFromFile(getAssetPath() + "models/sphere.gltf", vulkanDevice, queue, glTFLoadingFlags);
 		textureCloth.loadFromFile(getAssetPath() + "textures/vulkan_cloth_rgba.ktx", VK_FORMAT_R8G8B8A8_UNORM, vulkanDevice, queue);
 	}
 
-	void addGraphicsToComputeBarriers(VkCommandBuffer commandBuffer, VkAccessFlags srcAccessMask, VkAccessFlags dstAccessMask, VkPipelineStageFlags srcStageMask, VkPipelineStageFlags dstStageMask)
-	{
-		if (specializedComputeQueue) {
-			VkBufferMemoryBarrier bufferBarrier = vks::initializers::bufferMemoryBarrier();
-			bufferBarrier.srcAccessMask = srcAccessMask;
-			bufferBarrier.dstAccessMask = dstAccessMask;
-			bufferBarrier.srcQueueFamilyIndex = vulkanDevice->queueFamilyIndices.graphics;
-			bufferBarrier.dstQueueFamilyIndex = vulkanDevice->queueFamilyIndices.compute;
-			bufferBarrier.size = VK_WHOLE_SIZE;
-
-			std::vector<VkBufferMemoryBarrier> bufferBarriers;
-			bufferBarrier.buffer = compute.storageBuffers.input.buffer;
-			bufferBarriers.push_back(bufferBarrier);
-			bufferBarrier.buffer = compute.storageBuffers.output.buffer;
-			bufferBarriers.push_back(bufferBarrier);
-			vkCmdPipelineBarrier(commandBuffer,
-				srcStageMask,
-				dstStageMask,
-				VK_FLAGS_NONE,
-				0, nullptr,
-				static_cast<uint32_t>(bufferBarriers.size()), bufferBarriers.data(),
-				0, nullptr);
-		}
-	}
-
 	void addComputeToComputeBarriers(VkCommandBuffer commandBuffer)
 	{
-		VkBufferMemoryBarrier bufferBarrier = vks::initializers::bufferMemoryBarrier();
-		bufferBarrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
-		bufferBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
-		bufferBarrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
-		bufferBarrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
-		bufferBarrier.size = VK_WHOLE_SIZE;
-		std::vector<VkBufferMemoryBarrier> bufferBarriers;
-		bufferBarrier.buffer = compute.storageBuffers.input.buffer;
-		bufferBarriers.push_back(bufferBarrier);
-		bufferBarrier.buffer = compute.storageBuffers.output.buffer;
-		bufferBarriers.push_back(bufferBarrier);
+		// All solver passes read and write the particles in place, so every pass waits for all writes of the previous one
+		VkMemoryBarrier memoryBarrier = vks::initializers::memoryBarrier();
+		memoryBarrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+		memoryBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
 		vkCmdPipelineBarrier(
 			commandBuffer,
 			VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
 			VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
 			VK_FLAGS_NONE,
+			1, &memoryBarrier,
 			0, nullptr,
-			static_cast<uint32_t>(bufferBarriers.size()), bufferBarriers.data(),
 			0, nullptr);
 	}
 
-	void addComputeToGraphicsBarriers(VkCommandBuffer commandBuffer, VkAccessFlags srcAccessMask, VkAccessFlags dstAccessMask, VkPipelineStageFlags srcStageMask, VkPipelineStageFlags dstStageMask)
+	void buildCommandBuffers()
 	{
-		if (specializedComputeQueue) {
-			VkBufferMemoryBarrier bufferBarrier = vks::initializers::bufferMemoryBarrier();
-			bufferBarrier.srcAccessMask = srcAccessMask;
-			bufferBarrier.dstAccessMask = dstAccessMask;
-			bufferBarrier.srcQueueFamilyIndex = vulkanDevice->queueFamilyIndices.compute;
-			bufferBarrier.dstQueueFamilyIndex = vulkanDevice->queueFamilyIndices.graphics;
-			bufferBarrier.size = VK_WHOLE_SIZE;
-			std::vector<VkBufferMemoryBarrier> bufferBarriers;
-			bufferBarrier.buffer = compute.storageBuffers.input.buffer;
-			bufferBarriers.push_back(bufferBarrier);
-			bufferBarrier.buffer = compute.storageBuffers.output.buffer;
-			bufferBarriers.push_back(bufferBarrier);
-			vkCmdPipelineBarrier(
-				commandBuffer,
-				srcStageMask,
-				dstStageMask,
-				VK_FLAGS_NONE,
-				0, nullptr,
-				static_cast<uint32_t>(bufferBarriers.size()), bufferBarriers.data(),
-				0, nullptr);
+		for (int32_t i = 0; i < drawCmdBuffers.size(); ++i)
+		{
+			buildDrawCommandBuffer(i);
 		}
 	}
 
-	void buildCommandBuffers()
+	// Graphics draws the shared buffer slot holding the results of the previous compute frame, which changes every frame
+	void buildDrawCommandBuffer(uint32_t index)
 	{
 		VkCommandBufferBeginInfo cmdBufInfo = vks::initializers::commandBufferBeginInfo();
 
@@ -225,194 +220,214 @@ public:
 		renderPassBeginInfo.renderArea.extent.height = height;
 		renderPassBeginInfo.clearValueCount = 2;
 		renderPassBeginInfo.pClearValues = clearValues;
+		// Set target frame buffer
+		renderPassBeginInfo.framebuffer = frameBuffers[index];
 
-		for (int32_t i = 0; i < drawCmdBuffers.size(); ++i)
-		{
-			// Set target frame buffer
-			renderPassBeginInfo.framebuffer = frameBuffers[i];
-
-			VK_CHECK_RESULT(vkBeginCommandBuffer(drawCmdBuffers[i], &cmdBufInfo));
-
-			// Acquire storage buffers from compute queue
-			addComputeToGraphicsBarriers(drawCmdBuffers[i], 0, VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_VERTEX_INPUT_BIT);
+		VkCommandBuffer commandBuffer = drawCmdBuffers[index];
+		VK_CHECK_RESULT(vkBeginCommandBuffer(commandBuffer, &cmdBufInfo));
 
-			// Draw the particle system using the update vertex buffer
+		// Acquire the cloth vertices from the compute queue
+		asyncCompute.beginGraphics(commandBuffer);
 
-			vkCmdBeginRenderPass(drawCmdBuffers[i], &renderPassBeginInfo, VK_SUBPASS_CONTENTS_INLINE);
+		vkCmdBeginRenderPass(commandBuffer, &renderPassBeginInfo, VK_SUBPASS_CONTENTS_INLINE);
 
-			VkViewport viewport = vks::initializers::viewport((float)width, (float)height, 0.0f, 1.0f);
-			vkCmdSetViewport(drawCmdBuffers[i], 0, 1, &viewport);
+		VkViewport viewport = vks::initializers::viewport((float)width, (float)height, 0.0f, 1.0f);
+		vkCmdSetViewport(commandBuffer, 0, 1, &viewport);
 
-			VkRect2D scissor = vks::initializers::rect2D(width, height, 0, 0);
-			vkCmdSetScissor(drawCmdBuffers[i], 0, 1, &scissor);
+		VkRect2D scissor = vks::initializers::rect2D(width, height, 0, 0);
+		vkCmdSetScissor(commandBuffer, 0, 1, &scissor);
 
-			VkDeviceSize offsets[1] = { 0 };
+		VkDeviceSize offsets[1] = { 0 };
 
-			// Render sphere
-			if (sceneSetup == 0) {
-				vkCmdBindPipeline(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, graphics.pipelines.sphere);
-				vkCmdBindDescriptorSets(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, graphics.pipelineLayout, 0, 1, &graphics.descriptorSet, 0, NULL);
-				modelSphere.draw(drawCmdBuffers[i]);
+		// Render spheres
+		if (!sphereOffsets.empty()) {
+			vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, graphics.pipelines.sphere);
+			vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, graphics.pipelineLayout, 0, 1, &graphics.descriptorSet, 0, NULL);
+			for (const glm::vec4 &offset : sphereOffsets) {
+				vkCmdPushConstants(commandBuffer, graphics.pipelineLayout, VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(glm::vec4), &offset);
+				modelSphere.draw(commandBuffer);
 			}
+		}
+
+		// Render cloth
+		const vks::Buffer &vertexBuffer = asyncCompute.sharedBuffer(graphics.vertexBuffer, asyncCompute.graphicsSlot());
+		vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, graphics.pipelines.cloth);
+		vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, graphics.pipelineLayout, 0, 1, &graphics.descriptorSet, 0, NULL);
+		vkCmdBindIndexBuffer(commandBuffer, graphics.indices.buffer, 0, VK_INDEX_TYPE_UINT32);
+		vkCmdBindVertexBuffers(commandBuffer, 0, 1, &vertexBuffer.buffer, offsets);
+		vkCmdDrawIndexed(commandBuffer, indexCount, 1, 0, 0, 0);
 
-			// Render cloth
-			vkCmdBindPipeline(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, graphics.pipelines.cloth);
-			vkCmdBindDescriptorSets(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, graphics.pipelineLayout, 0, 1, &graphics.descriptorSet, 0, NULL);
-			vkCmdBindIndexBuffer(drawCmdBuffers[i], graphics.indices.buffer, 0, VK_INDEX_TYPE_UINT32);
-			vkCmdBindVertexBuffers(drawCmdBuffers[i], 0, 1, &compute.storageBuffers.output.buffer, offsets);
-			vkCmdDrawIndexed(drawCmdBuffers[i], indexCount, 1, 0, 0, 0);
+		drawUI(commandBuffer);
 
-			drawUI(drawCmdBuffers[i]);
+		vkCmdEndRenderPass(commandBuffer);
 
-			vkCmdEndRenderPass(drawCmdBuffers[i]);
+		// Release the cloth vertices back to the compute queue
+		asyncCompute.endGraphics(commandBuffer);
 
-			// release the storage buffers to the compute queue
-			addGraphicsToComputeBarriers(drawCmdBuffers[i], VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT, 0, VK_PIPELINE_STAGE_VERTEX_INPUT_BIT, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT);
+		VK_CHECK_RESULT(vkEndCommandBuffer(commandBuffer));
+	}
 
-			VK_CHECK_RESULT(vkEndCommandBuffer(drawCmdBuffers[i]));
+	// Records the solver work of one frame
+	void recordSimulation(VkCommandBuffer commandBuffer)
+	{
+		const uint32_t workGroupSize = 256;
+		vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, compute.pipelineLayout, 0, 1, &compute.descriptorSet, 0, 0);
+
+		ComputePushConstants pushConstants = {};
+		for (int32_t substep = 0; substep < compute.substeps; substep++) {
+			// Prediction, collisions and all constraints inside a tile in one dispatch
+			pushConstants.firstSubstep = (substep == 0) ? 1 : 0;
+			vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, compute.pipelines.solve);
+			vkCmdPushConstants(commandBuffer, compute.pipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(pushConstants), &pushConstants);
+			vkCmdDispatch(commandBuffer, static_cast<uint32_t>(xpbdCloth.tiles.size()), 1, 1);
+			addComputeToComputeBarriers(commandBuffer);
+
+			// Constraints crossing tiles, one dispatch per colour
+			vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, compute.pipelines.boundary);
+			for (uint32_t color = 0; color < xpbdCloth.boundaryColors(); color++) {
+				pushConstants.firstConstraint = xpbdCloth.boundaryColorOffsets[color];
+				pushConstants.constraintCount = xpbdCloth.boundaryColorOffsets[color + 1] - xpbdCloth.boundaryColorOffsets[color];
+				vkCmdPushConstants(commandBuffer, compute.pipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(pushConstants), &pushConstants);
+				vkCmdDispatch(commandBuffer, (pushConstants.constraintCount + workGroupSize - 1) / workGroupSize, 1, 1);
+				addComputeToComputeBarriers(commandBuffer);
+			}
 		}
 
+		// Velocities and normals
+		vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, compute.pipelines.finalize);
+		vkCmdDispatch(commandBuffer, (compute.ubo.particleCount + workGroupSize - 1) / workGroupSize, 1, 1);
 	}
 
-	// todo: check barriers (validation, separate compute queue)
-	void buildComputeCommandBuffer()
+	void buildComputeCommandBuffers()
 	{
 		VkCommandBufferBeginInfo cmdBufInfo = vks::initializers::commandBufferBeginInfo();
-		cmdBufInfo.flags = VK_COMMAND_BUFFER_USAGE_SIMULTANEOUS_USE_BIT;
-
-		for (uint32_t i = 0; i < 2; i++) {
-
-			VK_CHECK_RESULT(vkBeginCommandBuffer(compute.commandBuffers[i], &cmdBufInfo));
-
-			// Acquire the storage buffers from the graphics queue
-			addGraphicsToComputeBarriers(compute.commandBuffers[i], 0, VK_ACCESS_SHADER_WRITE_BIT, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT);
 
-			vkCmdBindPipeline(compute.commandBuffers[i], VK_PIPELINE_BIND_POINT_COMPUTE, compute.pipeline);
+		for (uint32_t slot = 0; slot < vks::AsyncCompute::slotCount; slot++) {
+			VkCommandBuffer commandBuffer = compute.commandBuffers[slot];
+			VK_CHECK_RESULT(vkBeginCommandBuffer(commandBuffer, &cmdBufInfo));
 
-			uint32_t calculateNormals = 0;
-			vkCmdPushConstants(compute.commandBuffers[i], compute.pipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(uint32_t), &calculateNormals);
-
-			// Dispatch the compute job
-			const uint32_t iterations = 64;
-			for (uint32_t j = 0; j < iterations; j++) {
-				readSet = 1 - readSet;
-				vkCmdBindDescriptorSets(compute.commandBuffers[i], VK_PIPELINE_BIND_POINT_COMPUTE, compute.pipelineLayout, 0, 1, &compute.descriptorSets[readSet], 0, 0);
-
-				if (j == iterations - 1) {
-					calculateNormals = 1;
-					vkCmdPushConstants(compute.commandBuffers[i], compute.pipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(uint32_t), &calculateNormals);
-				}
+			asyncCompute.beginCompute(commandBuffer, slot);
 
-				vkCmdDispatch(compute.commandBuffers[i], cloth.gridsize.x / 10, cloth.gridsize.y / 10, 1);
+			recordSimulation(commandBuffer);
 
-				// Don't add a barrier on the last iteration of the loop, since we'll have an explicit release to the graphics queue
-				if (j != iterations - 1) {
-					addComputeToComputeBarriers(compute.commandBuffers[i]);
-				}
-
-			}
-
-			// release the storage buffers back to the graphics queue
-			addComputeToGraphicsBarriers(compute.commandBuffers[i], VK_ACCESS_SHADER_WRITE_BIT, 0, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT);
-			vkEndCommandBuffer(compute.commandBuffers[i]);
+			// Copy the particle buffer to the shared buffer slot and release it to the graphics queue
+			asyncCompute.endCompute(commandBuffer, slot);
+			VK_CHECK_RESULT(vkEndCommandBuffer(commandBuffer));
 		}
 	}
 
-	// Setup and fill the compute shader storage buffers containing the particles
-	void prepareStorageBuffers()
+	// Creates a device local storage buffer owned by the compute queue family
+	void createStorageBuffer(vks::Buffer &buffer, const void *data, VkDeviceSize size, VkBufferUsageFlags usage = 0)
 	{
-		std::vector<Particle> particleBuffer(cloth.gridsize.x *  cloth.gridsize.y);
-
-		float dx =  cloth.size.x / (cloth.gridsize.x - 1);
-		float dy =  cloth.size.y / (cloth.gridsize.y - 1);
-		float du = 1.0f / (cloth.gridsize.x - 1);
-		float dv = 1.0f / (cloth.gridsize.y - 1);
-
-		switch (sceneSetup) {
-			case 0 :
-			{
-				// Horz. cloth falls onto sphere
-				glm::mat4 transM = glm::translate(glm::mat4(1.0f), glm::vec3(- cloth.size.x / 2.0f, -2.0f, - cloth.size.y / 2.0f));
-				for (uint32_t i = 0; i <  cloth.gridsize.y; i++) {
-					for (uint32_t j = 0; j <  cloth.gridsize.x; j++) {
-						particleBuffer[i + j * cloth.gridsize.y].pos = transM * glm::vec4(dx * j, 0.0f, dy * i, 1.0f);
-						particleBuffer[i + j * cloth.gridsize.y].vel = glm::vec4(0.0f);
-						particleBuffer[i + j * cloth.gridsize.y].uv = glm::vec4(1.0f - du * i, dv * j, 0.0f, 0.0f);
-					}
-				}
-				break;
-			}
-			case 1:
-			{
-				// Vert. Pinned cloth
-				glm::mat4 transM = glm::translate(glm::mat4(1.0f), glm::vec3(- cloth.size.x / 2.0f, - cloth.size.y / 2.0f, 0.0f));
-				for (uint32_t i = 0; i <  cloth.gridsize.y; i++) {
-					for (uint32_t j = 0; j <  cloth.gridsize.x; j++) {
-						particleBuffer[i + j * cloth.gridsize.y].pos = transM * glm::vec4(dx * j, dy * i, 0.0f, 1.0f);
-						particleBuffer[i + j * cloth.gridsize.y].vel = glm::vec4(0.0f);
-						particleBuffer[i + j * cloth.gridsize.y].uv = glm::vec4(du * j, dv * i, 0.0f, 0.0f);
-						// Pin some particles
-						particleBuffer[i + j * cloth.gridsize.y].pinned = (i == 0) && ((j == 0) || (j ==  cloth.gridsize.x / 3) || (j ==  cloth.gridsize.x -  cloth.gridsize.x / 3) || (j ==  cloth.gridsize.x - 1));
-						// Remove sphere
-						compute.ubo.spherePos.z = -10.0f;
-					}
-				}
-				break;
-			}
-		}
-
-		VkDeviceSize storageBufferSize = particleBuffer.size() * sizeof(Particle);
-
-		// Staging
-		// SSBO won't be changed on the host after upload so copy to device local memory
-
 		vks::Buffer stagingBuffer;
-
 		vulkanDevice->createBuffer(
 			VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
 			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
 			&stagingBuffer,
-			storageBufferSize,
-			particleBuffer.data());
-
-		vulkanDevice->createBuffer(
-			VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
-			VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
-			&compute.storageBuffers.input,
-			storageBufferSize);
+			size,
+			const_cast<void*>(data));
 
 		vulkanDevice->createBuffer(
-			VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+			VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT | usage,
 			VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
-			&compute.storageBuffers.output,
-			storageBufferSize);
+			&buffer,
+			size);
 
-		// Copy from staging buffer
-		VkCommandBuffer copyCmd = vulkanDevice->createCommandBuffer(VK_COMMAND_BUFFER_LEVEL_PRIMARY, true);
+		VkCommandBuffer copyCmd = vulkanDevice->createCommandBuffer(VK_COMMAND_BUFFER_LEVEL_PRIMARY, asyncCompute.commandPool, true);
 		VkBufferCopy copyRegion = {};
-		copyRegion.size = storageBufferSize;
-		vkCmdCopyBuffer(copyCmd, stagingBuffer.buffer, compute.storageBuffers.output.buffer, 1, &copyRegion);
-		// Add an initial release barrier to the graphics queue,
-		// so that when the compute command buffer executes for the first time
-		// it doesn't complain about a lack of a corresponding "release" to its "acquire"
-		addGraphicsToComputeBarriers(copyCmd, VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT, 0, VK_PIPELINE_STAGE_VERTEX_INPUT_BIT, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT);
-		vulkanDevice->flushCommandBuffer(copyCmd, queue, true);
+		copyRegion.size = size;
+		vkCmdCopyBuffer(copyCmd, stagingBuffer.buffer, buffer.buffer, 1, &copyRegion);
+		vulkanDevice->flushCommandBuffer(copyCmd, asyncCompute.queue, asyncCompute.commandPool);
 
 		stagingBuffer.destroy();
+	}
 
-		// Indices
-		std::vector<uint32_t> indices;
-		for (uint32_t y = 0; y <  cloth.gridsize.y - 1; y++) {
-			for (uint32_t x = 0; x <  cloth.gridsize.x; x++) {
-				indices.push_back((y + 1) *  cloth.gridsize.x + x);
-				indices.push_back((y)*  cloth.gridsize.x + x);
+	// Generate the cloth pieces and the collision geometry of the scene
+	void prepareScene()
+	{
+		const float spacing = cloth.size.x + 1.0f;
+		for (uint32_t i = 0; i < cloth.count; i++) {
+			const glm::vec3 offset((static_cast<float>(i) - 0.5f * static_cast<float>(cloth.count - 1)) * spacing, 0.0f, 0.0f);
+			switch (sceneSetup) {
+				case 0:
+				{
+					// Horz. cloth falls onto sphere
+					glm::mat4 transM = glm::translate(glm::mat4(1.0f), offset + glm::vec3(-cloth.size.x / 2.0f, -2.0f, -cloth.size.y / 2.0f));
+					transM = glm::rotate(transM, glm::radians(90.0f), glm::vec3(1.0f, 0.0f, 0.0f));
+					xpbdCloth.addPiece(cloth.gridsize, cloth.size, transM);
+					sphereOffsets.push_back(glm::vec4(offset, 0.0f));
+					break;
+				}
+				case 1:
+				{
+					// Vert. Pinned cloth
+					glm::mat4 transM = glm::translate(glm::mat4(1.0f), offset + glm::vec3(-cloth.size.x / 2.0f, -cloth.size.y / 2.0f, 0.0f));
+					const uint32_t piece = xpbdCloth.addPiece(cloth.gridsize, cloth.size, transM);
+					for (uint32_t x : { 0u, cloth.gridsize.x / 3, cloth.gridsize.x - cloth.gridsize.x / 3, cloth.gridsize.x - 1 }) {
+						xpbdCloth.pin(piece, x, 0);
+					}
+					break;
+				}
+			}
+		}
+		xpbdCloth.build();
+
+		if (!sphereOffsets.empty()) {
+			std::vector<glm::vec3> positions, normals;
+			for (const vkglTF::Vertex &vertex : modelSphere.geometry.vertices) {
+				positions.push_back(vertex.pos);
+				normals.push_back(vertex.normal);
 			}
-			// Primitive restart (signaled by special value 0xFFFFFFFF)
-			indices.push_back(0xFFFFFFFF);
+			for (const glm::vec4 &offset : sphereOffsets) {
+				collisionHash.addMesh(positions, normals, modelSphere.geometry.indices, glm::vec3(offset));
+			}
+		}
+		collisionHash.build(compute.ubo.thickness);
+		compute.ubo.hashCellSize = collisionHash.cellSize;
+		compute.ubo.hashTableSize = collisionHash.triangles.empty() ? 0 : collisionHash.tableSize();
+		compute.ubo.particleCount = static_cast<uint32_t>(xpbdCloth.particles.size());
+
+		if (xpbdCloth.tiles.size() > vulkanDevice->properties.limits.maxComputeWorkGroupCount[0]) {
+			vks::tools::exitFatal("Too many cloth tiles for a single dispatch, reduce the grid size or the number of cloth pieces", -1);
 		}
+	}
+
+	// Setup and fill the compute shader storage buffers containing the particles, constraints and collision geometry
+	void prepareStorageBuffers()
+	{
+		// Storage buffers are filled on the compute queue, so they are owned by the compute queue family
+		createStorageBuffer(compute.storageBuffers.particles, xpbdCloth.particles.data(), xpbdCloth.particles.size() * sizeof(Particle), VK_BUFFER_USAGE_TRANSFER_SRC_BIT);
+		std::vector<glm::vec4> previous(xpbdCloth.particles.size());
+		for (size_t i = 0; i < previous.size(); i++) {
+			previous[i] = xpbdCloth.particles[i].pos;
+		}
+		createStorageBuffer(compute.storageBuffers.previous, previous.data(), previous.size() * sizeof(glm::vec4));
+		createStorageBuffer(compute.storageBuffers.tiles, xpbdCloth.tiles.data(), xpbdCloth.tiles.size() * sizeof(XpbdCloth::Tile));
+		// Keep the buffers non-empty for grids without interior or boundary constraints
+		xpbdCloth.tileConstraints.push_back(glm::uvec2(0));
+		xpbdCloth.boundaryConstraints.push_back(XpbdCloth::BoundaryConstraint());
+		createStorageBuffer(compute.storageBuffers.tileConstraints, xpbdCloth.tileConstraints.data(), xpbdCloth.tileConstraints.size() * sizeof(glm::uvec2));
+		createStorageBuffer(compute.storageBuffers.boundaryConstraints, xpbdCloth.boundaryConstraints.data(), xpbdCloth.boundaryConstraints.size() * sizeof(XpbdCloth::BoundaryConstraint));
+		createStorageBuffer(compute.storageBuffers.neighbours, xpbdCloth.neighbours.data(), xpbdCloth.neighbours.size() * sizeof(glm::uvec4));
+		if (collisionHash.triangles.empty()) {
+			collisionHash.triangles.resize(3, glm::vec4(0.0f));
+		}
+		if (collisionHash.entries.empty()) {
+			collisionHash.entries.push_back(0);
+		}
+		createStorageBuffer(compute.storageBuffers.triangles, collisionHash.triangles.data(), collisionHash.triangles.size() * sizeof(glm::vec4));
+		createStorageBuffer(compute.storageBuffers.hashCells, collisionHash.cells.data(), collisionHash.cells.size() * sizeof(glm::uvec2));
+		createStorageBuffer(compute.storageBuffers.hashEntries, collisionHash.entries.data(), collisionHash.entries.size() * sizeof(uint32_t));
+
+		// Graphics renders from double buffered copies of the particle buffer
+		graphics.vertexBuffer = asyncCompute.addSharedBuffer(compute.storageBuffers.particles);
+
+		// Indices
+		std::vector<uint32_t> indices = xpbdCloth.triangleStripIndices();
 		uint32_t indexBufferSize = static_cast<uint32_t>(indices.size()) * sizeof(uint32_t);
 		indexCount = static_cast<uint32_t>(indices.size());
 
+		vks::Buffer stagingBuffer;
 		vulkanDevice->createBuffer(
 			VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
 			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
@@ -427,8 +442,8 @@ public:
 			indexBufferSize);
 
 		// Copy from staging buffer
-		copyCmd = vulkanDevice->createCommandBuffer(VK_COMMAND_BUFFER_LEVEL_PRIMARY, true);
-		copyRegion = {};
+		VkCommandBuffer copyCmd = vulkanDevice->createCommandBuffer(VK_COMMAND_BUFFER_LEVEL_PRIMARY, true);
+		VkBufferCopy copyRegion = {};
 		copyRegion.size = indexBufferSize;
 		vkCmdCopyBuffer(copyCmd, stagingBuffer.buffer, graphics.indices.buffer, 1, &copyRegion);
 		vulkanDevice->flushCommandBuffer(copyCmd, queue, true);
@@ -439,13 +454,13 @@ public:
 	void setupDescriptorPool()
 	{
 		std::vector<VkDescriptorPoolSize> poolSizes = {
-			vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 3),
-			vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 4),
-			vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 2)
+			vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 2),
+			vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 9),
+			vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 1)
 		};
 
 		VkDescriptorPoolCreateInfo descriptorPoolInfo =
-			vks::initializers::descriptorPoolCreateInfo(poolSizes, 3);
+			vks::initializers::descriptorPoolCreateInfo(poolSizes, 2);
 
 		VK_CHECK_RESULT(vkCreateDescriptorPool(device, &descriptorPoolInfo, nullptr, &descriptorPool));
 	}
@@ -463,6 +478,10 @@ public:
 
 		VkPipelineLayoutCreateInfo pipelineLayoutCreateInfo =
 			vks::initializers::pipelineLayoutCreateInfo(&graphics.descriptorSetLayout, 1);
+		// Sphere offset
+		VkPushConstantRange pushConstantRange = vks::initializers::pushConstantRange(VK_SHADER_STAGE_VERTEX_BIT, sizeof(glm::vec4), 0);
+		pipelineLayoutCreateInfo.pushConstantRangeCount = 1;
+		pipelineLayoutCreateInfo.pPushConstantRanges = &pushConstantRange;
 		VK_CHECK_RESULT(vkCreatePipelineLayout(device, &pipelineLayoutCreateInfo, nullptr, &graphics.pipelineLayout));
 
 		// Set
@@ -562,14 +581,28 @@ public:
 
 	void prepareCompute()
 	{
-		// Create a compute capable device queue
-		vkGetDeviceQueue(device, vulkanDevice->queueFamilyIndices.compute, 0, &compute.queue);
-
-		// Create compute pipeline
+		// Create compute pipelines
 		std::vector<VkDescriptorSetLayoutBinding> setLayoutBindings = {
+			// Binding 0 : Particles
 			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT, 0),
+			// Binding 1 : Positions at the start of the substep
 			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT, 1),
+			// Binding 2 : Simulation parameters
 			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT, 2),
+			// Binding 3 : Tiles
+			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT, 3),
+			// Binding 4 : Constraints inside tiles
+			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT, 4),
+			// Binding 5 : Constraints crossing tiles
+			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT, 5),
+			// Binding 6 : Particle neighbours
+			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT, 6),
+			// Binding 7 : Collision triangles
+			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT, 7),
+			// Binding 8 : Spatial hash buckets
+			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT, 8),
+			// Binding 9 : Spatial hash entries
+			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT, 9),
 		};
 
 		VkDescriptorSetLayoutCreateInfo descriptorLayout =
@@ -580,9 +613,9 @@ public:
 		VkPipelineLayoutCreateInfo pipelineLayoutCreateInfo =
 			vks::initializers::pipelineLayoutCreateInfo(&compute.descriptorSetLayout, 1);
 
-		// Push constants used to pass some parameters
+		// Push constants used to pass the constraint batch and the substep
 		VkPushConstantRange pushConstantRange =
-			vks::initializers::pushConstantRange(VK_SHADER_STAGE_COMPUTE_BIT, sizeof(uint32_t), 0);
+			vks::initializers::pushConstantRange(VK_SHADER_STAGE_COMPUTE_BIT, sizeof(ComputePushConstants), 0);
 		pipelineLayoutCreateInfo.pushConstantRangeCount = 1;
 		pipelineLayoutCreateInfo.pPushConstantRanges = &pushConstantRange;
 
@@ -590,48 +623,38 @@ public:
 
 		VkDescriptorSetAllocateInfo allocInfo =
 			vks::initializers::descriptorSetAllocateInfo(descriptorPool, &compute.descriptorSetLayout, 1);
-
-		// Create two descriptor sets with input and output buffers switched
-		VK_CHECK_RESULT(vkAllocateDescriptorSets(device, &allocInfo, &compute.descriptorSets[0]));
-		VK_CHECK_RESULT(vkAllocateDescriptorSets(device, &allocInfo, &compute.descriptorSets[1]));
+		VK_CHECK_RESULT(vkAllocateDescriptorSets(device, &allocInfo, &compute.descriptorSet));
 
 		std::vector<VkWriteDescriptorSet> computeWriteDescriptorSets = {
-			vks::initializers::writeDescriptorSet(compute.descriptorSets[0], VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 0, &compute.storageBuffers.input.descriptor),
-			vks::initializers::writeDescriptorSet(compute.descriptorSets[0], VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1, &compute.storageBuffers.output.descriptor),
-			vks::initializers::writeDescriptorSet(compute.descriptorSets[0], VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 2, &compute.uniformBuffer.descriptor),
-
-			vks::initializers::writeDescriptorSet(compute.descriptorSets[1], VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 0, &compute.storageBuffers.output.descriptor),
-			vks::initializers::writeDescriptorSet(compute.descriptorSets[1], VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1, &compute.storageBuffers.input.descriptor),
-			vks::initializers::writeDescriptorSet(compute.descriptorSets[1], VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 2, &compute.uniformBuffer.descriptor)
+			vks::initializers::writeDescriptorSet(compute.descriptorSet, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 0, &compute.storageBuffers.particles.descriptor),
+			vks::initializers::writeDescriptorSet(compute.descriptorSet, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1, &compute.storageBuffers.previous.descriptor),
+			vks::initializers::writeDescriptorSet(compute.descriptorSet, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 2, &compute.uniformBuffer.descriptor),
+			vks::initializers::writeDescriptorSet(compute.descriptorSet, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 3, &compute.storageBuffers.tiles.descriptor),
+			vks::initializers::writeDescriptorSet(compute.descriptorSet, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 4, &compute.storageBuffers.tileConstraints.descriptor),
+			vks::initializers::writeDescriptorSet(compute.descriptorSet, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 5, &compute.storageBuffers.boundaryConstraints.descriptor),
+			vks::initializers::writeDescriptorSet(compute.descriptorSet, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 6, &compute.storageBuffers.neighbours.descriptor),
+			vks::initializers::writeDescriptorSet(compute.descriptorSet, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 7, &compute.storageBuffers.triangles.descriptor),
+			vks::initializers::writeDescriptorSet(compute.descriptorSet, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 8, &compute.storageBuffers.hashCells.descriptor),
+			vks::initializers::writeDescriptorSet(compute.descriptorSet, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 9, &compute.storageBuffers.hashEntries.descriptor)
 		};
 
 		vkUpdateDescriptorSets(device, static_cast<uint32_t>(computeWriteDescriptorSets.size()), computeWriteDescriptorSets.data(), 0, NULL);
 
-		// Create pipeline
+		// Create pipelines
 		VkComputePipelineCreateInfo computePipelineCreateInfo = vks::initializers::computePipelineCreateInfo(compute.pipelineLayout, 0);
-		computePipelineCreateInfo.stage = loadShader(getShadersPath() + "computecloth/cloth.comp.spv", VK_SHADER_STAGE_COMPUTE_BIT);
-		VK_CHECK_RESULT(vkCreateComputePipelines(device, pipelineCache, 1, &computePipelineCreateInfo, nullptr, &compute.pipeline));
-
-		// Separate command pool as queue family for compute may be different than graphics
-		VkCommandPoolCreateInfo cmdPoolInfo = {};
-		cmdPoolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
-		cmdPoolInfo.queueFamilyIndex = vulkanDevice->queueFamilyIndices.compute;
-		cmdPoolInfo.flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
-		VK_CHECK_RESULT(vkCreateCommandPool(device, &cmdPoolInfo, nullptr, &compute.commandPool));
-
-		// Create a command buffer for compute operations
+		computePipelineCreateInfo.stage = loadShader(getShadersPath() + "computecloth/cloth_solve.comp.spv", VK_SHADER_STAGE_COMPUTE_BIT);
+		VK_CHECK_RESULT(vkCreateComputePipelines(device, pipelineCache, 1, &computePipelineCreateInfo, nullptr, &compute.pipelines.solve));
+		computePipelineCreateInfo.stage = loadShader(getShadersPath() + "computecloth/cloth_boundary.comp.spv", VK_SHADER_STAGE_COMPUTE_BIT);
+		VK_CHECK_RESULT(vkCreateComputePipelines(device, pipelineCache, 1, &computePipelineCreateInfo, nullptr, &compute.pipelines.boundary));
+		computePipelineCreateInfo.stage = loadShader(getShadersPath() + "computecloth/cloth_finalize.comp.spv", VK_SHADER_STAGE_COMPUTE_BIT);
+		VK_CHECK_RESULT(vkCreateComputePipelines(device, pipelineCache, 1, &computePipelineCreateInfo, nullptr, &compute.pipelines.finalize));
+
+		// Command buffers for the compute queue, one per shared buffer slot
 		VkCommandBufferAllocateInfo cmdBufAllocateInfo =
-			vks::initializers::commandBufferAllocateInfo(compute.commandPool, VK_COMMAND_BUFFER_LEVEL_PRIMARY, 2);
-
-		VK_CHECK_RESULT(vkAllocateCommandBuffers(device, &cmdBufAllocateInfo, &compute.commandBuffers[0]));
-
-		// Semaphores for graphics / compute synchronization
-		VkSemaphoreCreateInfo semaphoreCreateInfo = vks::initializers::semaphoreCreateInfo();
-		VK_CHECK_RESULT(vkCreateSemaphore(device, &semaphoreCreateInfo, nullptr, &compute.semaphores.ready));
-		VK_CHECK_RESULT(vkCreateSemaphore(device, &semaphoreCreateInfo, nullptr, &compute.semaphores.complete));
+			vks::initializers::commandBufferAllocateInfo(asyncCompute.commandPool, VK_COMMAND_BUFFER_LEVEL_PRIMARY, vks::AsyncCompute::slotCount);
+		VK_CHECK_RESULT(vkAllocateCommandBuffers(device, &cmdBufAllocateInfo, compute.commandBuffers.data()));
 
-		// Build a single command buffer containing the compute dispatch commands
-		buildComputeCommandBuffer();
+		buildComputeCommandBuffers();
 	}
 
 	// Prepare and initialize uniform buffer containing shader uniforms
@@ -645,15 +668,6 @@ public:
 			sizeof(compute.ubo));
 		VK_CHECK_RESULT(compute.uniformBuffer.map());
 
-		// Initial values
-		float dx = cloth.size.x / (cloth.gridsize.x - 1);
-		float dy = cloth.size.y / (cloth.gridsize.y - 1);
-
-		compute.ubo.restDistH = dx;
-		compute.ubo.restDistV = dy;
-		compute.ubo.restDistD = sqrtf(dx * dx + dy * dy);
-		compute.ubo.particleCount = cloth.gridsize;
-
 		updateComputeUBO();
 
 		// Vertex shader uniform buffer block
@@ -670,10 +684,8 @@ public:
 	void updateComputeUBO()
 	{
 		if (!paused) {
-			//compute.ubo.deltaT = 0.000005f;
-			// todo: base on frametime
 			// SRS - Clamp frameTimer to max 20ms refresh period (e.g. if blocked on resize), otherwise image breakup can occur
-			compute.ubo.deltaT = fmin(frameTimer, 0.02) * 0.0025f;
+			compute.ubo.deltaT = static_cast<float>(fmin(frameTimer, 0.02)) / static_cast<float>(compute.substeps);
 
 			if (simulateWind) {
 				std::default_random_engine rndEngine(benchmark.active ? 0 : (unsigned)time(nullptr));
@@ -699,47 +711,83 @@ public:
 		memcpy(graphics.uniformBuffer.mapped, &graphics.ubo, sizeof(graphics.ubo));
 	}
 
-	void draw()
+	// Times the solver on the compute queue without rendering, works on any implementation including software ones
+	void runSolverBenchmark()
 	{
-		static bool firstDraw = true;
-		VkSubmitInfo computeSubmitInfo = vks::initializers::submitInfo();
-		// FIXME find a better way to do this (without using fences, which is much slower)
-		VkPipelineStageFlags computeWaitDstStageMask = VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT;
-		if (!firstDraw) {
-			computeSubmitInfo.waitSemaphoreCount = 1;
-			computeSubmitInfo.pWaitSemaphores = &compute.semaphores.ready;
-			computeSubmitInfo.pWaitDstStageMask = &computeWaitDstStageMask;
-		} else {
-			firstDraw = false;
+		const uint32_t warmupFrames = 10;
+		const uint32_t frames = 100;
+
+		compute.ubo.deltaT = (1.0f / 60.0f) / static_cast<float>(compute.substeps);
+		memcpy(compute.uniformBuffer.mapped, &compute.ubo, sizeof(compute.ubo));
+
+		const bool timestamps = vulkanDevice->queueFamilyProperties[asyncCompute.queueFamilyIndex].timestampValidBits > 0;
+		VkQueryPool queryPool = VK_NULL_HANDLE;
+		if (timestamps) {
+			VkQueryPoolCreateInfo queryPoolInfo{};
+			queryPoolInfo.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+			queryPoolInfo.queryType = VK_QUERY_TYPE_TIMESTAMP;
+			queryPoolInfo.queryCount = 2;
+			VK_CHECK_RESULT(vkCreateQueryPool(device, &queryPoolInfo, nullptr, &queryPool));
 		}
-		computeSubmitInfo.signalSemaphoreCount = 1;
-		computeSubmitInfo.pSignalSemaphores = &compute.semaphores.complete;
-		computeSubmitInfo.commandBufferCount = 1;
-		computeSubmitInfo.pCommandBuffers = &compute.commandBuffers[readSet];
 
-		VK_CHECK_RESULT( vkQueueSubmit( compute.queue, 1, &computeSubmitInfo, VK_NULL_HANDLE) );
+		for (uint32_t pass = 0; pass < 2; pass++) {
+			const bool timed = (pass == 1);
+			VkCommandBuffer commandBuffer = vulkanDevice->createCommandBuffer(VK_COMMAND_BUFFER_LEVEL_PRIMARY, asyncCompute.commandPool, true);
+			if (timed && timestamps) {
+				vkCmdResetQueryPool(commandBuffer, queryPool, 0, 2);
+				vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, queryPool, 0);
+			}
+			for (uint32_t frame = 0; frame < (timed ? frames : warmupFrames); frame++) {
+				recordSimulation(commandBuffer);
+				addComputeToComputeBarriers(commandBuffer);
+			}
+			if (timed && timestamps) {
+				vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, queryPool, 1);
+			}
+			auto tStart = std::chrono::high_resolution_clock::now();
+			vulkanDevice->flushCommandBuffer(commandBuffer, asyncCompute.queue, asyncCompute.commandPool);
+			auto tEnd = std::chrono::high_resolution_clock::now();
+			if (!timed) {
+				continue;
+			}
 
-		// Submit graphics commands
-		VulkanExampleBase::prepareFrame();
+			// Fall back to the host time of the submission if the compute queue has no timestamps
+			double totalTime = std::chrono::duration<double, std::milli>(tEnd - tStart).count();
+			if (timestamps) {
+				uint64_t results[2];
+				VK_CHECK_RESULT(vkGetQueryPoolResults(device, queryPool, 0, 2, sizeof(results), results, sizeof(uint64_t), VK_QUERY_RESULT_64_BIT | VK_QUERY_RESULT_WAIT_BIT));
+				totalTime = static_cast<double>(results[1] - results[0]) * vulkanDevice->properties.limits.timestampPeriod / 1.0e6;
+			}
 
-		VkPipelineStageFlags waitDstStageMask[2] = {
-			submitPipelineStages, VK_PIPELINE_STAGE_VERTEX_INPUT_BIT
-		};
-		VkSemaphore waitSemaphores[2] = {
-			semaphores.presentComplete, compute.semaphores.complete
-		};
-		VkSemaphore signalSemaphores[2] = {
-			semaphores.renderComplete, compute.semaphores.ready
-		};
+			const double frameTime = totalTime / frames;
+			const double iterations = static_cast<double>(compute.substeps) * compute.ubo.localIterations;
+			std::cout << std::fixed << std::setprecision(3);
+			std::cout << "Cloth solver benchmark on " << vulkanDevice->properties.deviceName << "\n";
+			std::cout << "particles: " << compute.ubo.particleCount << " (" << cloth.count << " x " << cloth.gridsize.x << "x" << cloth.gridsize.y << "), tiles: " << xpbdCloth.tiles.size() << ", tile colours: " << xpbdCloth.maxTileColors() << ", boundary colours: " << xpbdCloth.boundaryColors() << "\n";
+			std::cout << "substeps: " << compute.substeps << ", tile iterations: " << compute.ubo.localIterations << ", collision triangles: " << (compute.ubo.hashTableSize > 0 ? collisionHash.triangles.size() / 3 : 0) << "\n";
+			std::cout << "time per frame: " << frameTime << " ms (" << (timestamps ? "GPU timestamps" : "host time") << ")" << "\n";
+			std::cout << "throughput: " << compute.ubo.particleCount * iterations / frameTime << " vertices*iterations/ms" << "\n";
+		}
 
-		submitInfo.waitSemaphoreCount = 2;
-		submitInfo.pWaitDstStageMask = waitDstStageMask;
-		submitInfo.pWaitSemaphores = waitSemaphores;
-		submitInfo.signalSemaphoreCount = 2;
-		submitInfo.pSignalSemaphores = signalSemaphores;
-		submitInfo.commandBufferCount = 1;
-		submitInfo.pCommandBuffers = &drawCmdBuffers[currentBuffer];
-		VK_CHECK_RESULT(vkQueueSubmit(queue, 1, &submitInfo, VK_NULL_HANDLE));
+		if (queryPool != VK_NULL_HANDLE) {
+			vkDestroyQueryPool(device, queryPool, nullptr);
+		}
+	}
+
+	void draw()
+	{
+		// Wait for the compute work of the last frame before changing its uniforms
+		asyncCompute.beginFrame();
+		updateComputeUBO();
+
+		// Submit compute commands, they run concurrently with the graphics work of this frame
+		asyncCompute.submitCompute(compute.commandBuffers[asyncCompute.computeSlot()]);
+
+		VulkanExampleBase::prepareFrame();
+
+		// Submit graphics commands, they draw the cloth of the previous compute frame
+		buildDrawCommandBuffer(currentBuffer);
+		asyncCompute.submitGraphics(drawCmdBuffers[currentBuffer], semaphores.presentComplete, submitPipelineStages, semaphores.renderComplete);
 
 		VulkanExampleBase::submitFrame();
 	}
@@ -747,19 +795,18 @@ public:
 	void prepare()
 	{
 		VulkanExampleBase::prepare();
-		// Make sure the code works properly both with different queues families for graphics and compute and the same queue family
-#ifdef DEBUG_FORCE_SHARED_GRAPHICS_COMPUTE_QUEUE
-		vulkanDevice->queueFamilyIndices.compute = vulkanDevice->queueFamilyIndices.graphics;
-#endif
-		// Check whether the compute queue family is distinct from the graphics queue family
-		specializedComputeQueue = vulkanDevice->queueFamilyIndices.graphics != vulkanDevice->queueFamilyIndices.compute;
 		loadAssets();
+		prepareScene();
 		prepareStorageBuffers();
 		prepareUniformBuffers();
 		setupDescriptorPool();
 		setupLayoutsAndDescriptors();
 		preparePipelines();
 		prepareCompute();
+		if (commandLineParser.isSet("solverbenchmark")) {
+			runSolverBenchmark();
+			exit(0);
+		}
 		buildCommandBuffers();
 		prepared = true;
 	}
@@ -769,8 +816,6 @@ public:
 		if (!prepared)
 			return;
 		draw();
-
-		updateComputeUBO();
 	}
 
 	virtual void viewChanged()
@@ -782,7 +827,22 @@ public:
 	{
 		if (overlay->header("Settings")) {
 			overlay->checkBox("Simulate wind", &simulateWind);
+			if (overlay->sliderInt("Substeps", &compute.substeps, 1, 32)) {
+				VK_CHECK_RESULT(vkQueueWaitIdle(asyncCompute.queue));
+				buildComputeCommandBuffers();
+			}
+			int32_t localIterations = static_cast<int32_t>(compute.ubo.localIterations);
+			if (overlay->sliderInt("Tile iterations", &localIterations, 1, 16)) {
+				compute.ubo.localIterations = static_cast<uint32_t>(localIterations);
+			}
+		}
+		if (overlay->header("Solver")) {
+			overlay->text("%u particles in %u pieces", compute.ubo.particleCount, cloth.count);
+			overlay->text("%u tiles, %u colours", static_cast<uint32_t>(xpbdCloth.tiles.size()), xpbdCloth.maxTileColors());
+			overlay->text("%u boundary constraints, %u colours", xpbdCloth.boundaryColorOffsets.back(), xpbdCloth.boundaryColors());
+			overlay->text("%u collision triangles", compute.ubo.hashTableSize > 0 ? static_cast<uint32_t>(collisionHash.triangles.size() / 3) : 0);
 		}
+		asyncCompute.updateUIOverlay(overlay);
 	}
 };
 
@@ -0,0 +1,332 @@
+/*
+* XPBD cloth setup
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#include "xpbdcloth.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cstring>
+#include <cmath>
+#include <string>
+
+#include "VulkanTools.h"
+
+const uint32_t XpbdCloth::tileWidth;
+const uint32_t XpbdCloth::tileSize;
+const uint32_t XpbdCloth::maxTileConstraints;
+const uint32_t XpbdCloth::maxColors;
+
+uint32_t XpbdCloth::addPiece(const glm::uvec2 &gridsize, const glm::vec2 &size, const glm::mat4 &transform)
+{
+	assert(gridsize.x > 1 && gridsize.y > 1);
+
+	Piece piece;
+	piece.gridsize = gridsize;
+	piece.tileCount = (gridsize + glm::uvec2(tileWidth - 1)) / tileWidth;
+	piece.firstTile = static_cast<uint32_t>(tiles.size());
+	pieces.push_back(piece);
+	const uint32_t pieceIndex = static_cast<uint32_t>(pieces.size() - 1);
+
+	const glm::vec2 spacing = size / glm::vec2(gridsize - glm::uvec2(1));
+	const glm::vec2 uvSpacing = glm::vec2(1.0f) / glm::vec2(gridsize - glm::uvec2(1));
+
+	// Particles of a tile are stored row by row, tiles at the right and upper borders may be smaller
+	for (uint32_t ty = 0; ty < piece.tileCount.y; ty++) {
+		for (uint32_t tx = 0; tx < piece.tileCount.x; tx++) {
+			const glm::uvec2 origin(tx * tileWidth, ty * tileWidth);
+			const glm::uvec2 extent = glm::min(glm::uvec2(tileWidth), gridsize - origin);
+			Tile tile{};
+			tile.firstParticle = static_cast<uint32_t>(particles.size());
+			tile.particleCount = extent.x * extent.y;
+			tiles.push_back(tile);
+			for (uint32_t ly = 0; ly < extent.y; ly++) {
+				for (uint32_t lx = 0; lx < extent.x; lx++) {
+					const glm::vec2 gridPos = glm::vec2(origin + glm::uvec2(lx, ly));
+					Particle particle{};
+					particle.pos = glm::vec4(glm::vec3(transform * glm::vec4(gridPos * spacing, 0.0f, 1.0f)), 1.0f);
+					particle.uv = glm::vec4(gridPos * uvSpacing, 0.0f, 0.0f);
+					particles.push_back(particle);
+				}
+			}
+		}
+	}
+
+	neighbours.resize(particles.size());
+	for (uint32_t y = 0; y < gridsize.y; y++) {
+		for (uint32_t x = 0; x < gridsize.x; x++) {
+			neighbours[particleIndex(pieceIndex, x, y)] = glm::uvec4(
+				x > 0 ? particleIndex(pieceIndex, x - 1, y) : ~0u,
+				x < gridsize.x - 1 ? particleIndex(pieceIndex, x + 1, y) : ~0u,
+				y > 0 ? particleIndex(pieceIndex, x, y - 1) : ~0u,
+				y < gridsize.y - 1 ? particleIndex(pieceIndex, x, y + 1) : ~0u);
+		}
+	}
+
+	return pieceIndex;
+}
+
+uint32_t XpbdCloth::particleIndex(uint32_t piece, uint32_t x, uint32_t y) const
+{
+	const Piece &p = pieces[piece];
+	const glm::uvec2 tile(x / tileWidth, y / tileWidth);
+	const uint32_t width = std::min(tileWidth, p.gridsize.x - tile.x * tileWidth);
+	return tiles[p.firstTile + tile.y * p.tileCount.x + tile.x].firstParticle + (y % tileWidth) * width + x % tileWidth;
+}
+
+void XpbdCloth::pin(uint32_t piece, uint32_t x, uint32_t y)
+{
+	Particle &particle = particles[particleIndex(piece, x, y)];
+	particle.pos.w = 0.0f;
+	particle.pinned = 1.0f;
+}
+
+uint32_t XpbdCloth::assignColor(std::vector<uint32_t> &usedColors, uint32_t a, uint32_t b)
+{
+	const uint32_t used = usedColors[a] | usedColors[b];
+	uint32_t color = 0;
+	while ((color < maxColors) && (used & (1u << color))) {
+		color++;
+	}
+	if (color == maxColors) {
+		vks::tools::exitFatal("Cloth constraints need more than " + std::to_string(maxColors) + " colours", -1);
+	}
+	usedColors[a] |= 1u << color;
+	usedColors[b] |= 1u << color;
+	return color;
+}
+
+void XpbdCloth::addConstraint(std::vector<Constraint> &constraints, uint32_t piece, glm::uvec2 a, glm::uvec2 b, ConstraintType type) const
+{
+	const glm::uvec2 &gridsize = pieces[piece].gridsize;
+	if ((a.x >= gridsize.x) || (a.y >= gridsize.y) || (b.x >= gridsize.x) || (b.y >= gridsize.y)) {
+		return;
+	}
+	Constraint constraint;
+	constraint.a = particleIndex(piece, a.x, a.y);
+	constraint.b = particleIndex(piece, b.x, b.y);
+	constraint.restLength = glm::distance(glm::vec3(particles[constraint.a].pos), glm::vec3(particles[constraint.b].pos));
+	constraint.type = type;
+	constraints.push_back(constraint);
+}
+
+void XpbdCloth::build()
+{
+	// Constraint families are generated one after another, greedy colouring of such regular sets stays close to the optimum of two colours per family
+	struct Family {
+		glm::uvec2 a;
+		glm::uvec2 b;
+		ConstraintType type;
+	};
+	const Family families[] = {
+		{ glm::uvec2(0, 0), glm::uvec2(1, 0), ConstraintStretch },
+		{ glm::uvec2(0, 0), glm::uvec2(0, 1), ConstraintStretch },
+		{ glm::uvec2(0, 0), glm::uvec2(1, 1), ConstraintShear },
+		{ glm::uvec2(1, 0), glm::uvec2(0, 1), ConstraintShear },
+		{ glm::uvec2(0, 0), glm::uvec2(2, 0), ConstraintBending },
+		{ glm::uvec2(0, 0), glm::uvec2(0, 2), ConstraintBending },
+	};
+	std::vector<Constraint> constraints;
+	for (uint32_t piece = 0; piece < pieces.size(); piece++) {
+		const glm::uvec2 &gridsize = pieces[piece].gridsize;
+		for (const Family &family : families) {
+			for (uint32_t y = 0; y < gridsize.y; y++) {
+				for (uint32_t x = 0; x < gridsize.x; x++) {
+					addConstraint(constraints, piece, glm::uvec2(x, y) + family.a, glm::uvec2(x, y) + family.b, family.type);
+				}
+			}
+		}
+	}
+
+	// Split into constraints inside a single tile and constraints crossing tiles
+	std::vector<uint32_t> particleTiles(particles.size());
+	for (uint32_t i = 0; i < tiles.size(); i++) {
+		std::fill(particleTiles.begin() + tiles[i].firstParticle, particleTiles.begin() + tiles[i].firstParticle + tiles[i].particleCount, i);
+	}
+	std::vector<std::vector<Constraint>> interior(tiles.size());
+	std::vector<Constraint> boundary;
+	for (const Constraint &constraint : constraints) {
+		if (particleTiles[constraint.a] == particleTiles[constraint.b]) {
+			interior[particleTiles[constraint.a]].push_back(constraint);
+		} else {
+			boundary.push_back(constraint);
+		}
+	}
+
+	std::vector<uint32_t> usedColors(particles.size(), 0);
+	std::vector<uint32_t> colors;
+
+	tileConstraints.clear();
+	for (uint32_t i = 0; i < tiles.size(); i++) {
+		Tile &tile = tiles[i];
+		const std::vector<Constraint> &tileList = interior[i];
+		if (tileList.size() > maxTileConstraints) {
+			vks::tools::exitFatal("Cloth tile exceeds the maximum of " + std::to_string(maxTileConstraints) + " constraints", -1);
+		}
+		colors.resize(tileList.size());
+		tile.colorCount = 0;
+		for (size_t j = 0; j < tileList.size(); j++) {
+			colors[j] = assignColor(usedColors, tileList[j].a, tileList[j].b);
+			tile.colorCount = std::max(tile.colorCount, colors[j] + 1);
+		}
+		// Sort by colour
+		std::memset(tile.colorOffsets, 0, sizeof(tile.colorOffsets));
+		for (size_t j = 0; j < tileList.size(); j++) {
+			tile.colorOffsets[colors[j] + 1]++;
+		}
+		for (uint32_t c = 0; c < tile.colorCount; c++) {
+			tile.colorOffsets[c + 1] += tile.colorOffsets[c];
+		}
+		tile.firstConstraint = static_cast<uint32_t>(tileConstraints.size());
+		tileConstraints.resize(tileConstraints.size() + tileList.size());
+		std::vector<uint32_t> cursors(tile.colorOffsets, tile.colorOffsets + tile.colorCount);
+		for (size_t j = 0; j < tileList.size(); j++) {
+			const Constraint &constraint = tileList[j];
+			uint32_t restLength;
+			std::memcpy(&restLength, &constraint.restLength, sizeof(restLength));
+			const uint32_t packed = (constraint.a - tile.firstParticle) | ((constraint.b - tile.firstParticle) << 8) | (constraint.type << 16);
+			tileConstraints[tile.firstConstraint + cursors[colors[j]]++] = glm::uvec2(packed, restLength);
+		}
+	}
+
+	std::fill(usedColors.begin(), usedColors.end(), 0);
+	colors.resize(boundary.size());
+	uint32_t colorCount = 0;
+	for (size_t j = 0; j < boundary.size(); j++) {
+		colors[j] = assignColor(usedColors, boundary[j].a, boundary[j].b);
+		colorCount = std::max(colorCount, colors[j] + 1);
+	}
+	boundaryColorOffsets.assign(colorCount + 1, 0);
+	for (size_t j = 0; j < boundary.size(); j++) {
+		boundaryColorOffsets[colors[j] + 1]++;
+	}
+	for (uint32_t c = 0; c < colorCount; c++) {
+		boundaryColorOffsets[c + 1] += boundaryColorOffsets[c];
+	}
+	boundaryConstraints.resize(boundary.size());
+	std::vector<uint32_t> cursors(boundaryColorOffsets.begin(), boundaryColorOffsets.end() - 1);
+	for (size_t j = 0; j < boundary.size(); j++) {
+		const Constraint &constraint = boundary[j];
+		BoundaryConstraint &target = boundaryConstraints[cursors[colors[j]]++];
+		target.a = constraint.a;
+		target.b = constraint.b;
+		target.restLength = constraint.restLength;
+		target.type = constraint.type;
+	}
+}
+
+std::vector<uint32_t> XpbdCloth::triangleStripIndices() const
+{
+	std::vector<uint32_t> indices;
+	for (uint32_t piece = 0; piece < pieces.size(); piece++) {
+		const glm::uvec2 &gridsize = pieces[piece].gridsize;
+		for (uint32_t y = 0; y < gridsize.y - 1; y++) {
+			for (uint32_t x = 0; x < gridsize.x; x++) {
+				indices.push_back(particleIndex(piece, x, y + 1));
+				indices.push_back(particleIndex(piece, x, y));
+			}
+			// Primitive restart (signaled by special value 0xFFFFFFFF)
+			indices.push_back(0xFFFFFFFF);
+		}
+	}
+	return indices;
+}
+
+uint32_t XpbdCloth::maxTileColors() const
+{
+	uint32_t colorCount = 0;
+	for (const Tile &tile : tiles) {
+		colorCount = std::max(colorCount, tile.colorCount);
+	}
+	return colorCount;
+}
+
+uint32_t XpbdCloth::boundaryColors() const
+{
+	return boundaryColorOffsets.empty() ? 0 : static_cast<uint32_t>(boundaryColorOffsets.size() - 1);
+}
+
+void CollisionHash::addMesh(const std::vector<glm::vec3> &positions, const std::vector<glm::vec3> &normals, const std::vector<uint32_t> &indices, const glm::vec3 &offset)
+{
+	for (size_t i = 0; i + 2 < indices.size(); i += 3) {
+		const glm::vec3 v0 = positions[indices[i]];
+		const glm::vec3 v1 = positions[indices[i + 1]];
+		const glm::vec3 v2 = positions[indices[i + 2]];
+		glm::vec3 normal = glm::cross(v1 - v0, v2 - v0);
+		const float length = glm::length(normal);
+		if (length < 1.0e-12f) {
+			continue;
+		}
+		normal /= length;
+		// The winding may have been flipped on load, the vertex normals tell which side is outside
+		if (glm::dot(normal, normals[indices[i]] + normals[indices[i + 1]] + normals[indices[i + 2]]) < 0.0f) {
+			normal = -normal;
+		}
+		triangles.push_back(glm::vec4(v0 + offset, normal.x));
+		triangles.push_back(glm::vec4(v1 + offset, normal.y));
+		triangles.push_back(glm::vec4(v2 + offset, normal.z));
+	}
+}
+
+void CollisionHash::build(float thickness)
+{
+	const uint32_t triangleCount = static_cast<uint32_t>(triangles.size() / 3);
+	entries.clear();
+	if (triangleCount == 0) {
+		// Keep one empty bucket so the buffers are never empty
+		cells.assign(1, glm::uvec2(0));
+		return;
+	}
+
+	// Cells are as large as the largest triangle, so every triangle only touches a few of them
+	float maxExtent = 0.0f;
+	for (uint32_t i = 0; i < triangleCount; i++) {
+		const glm::vec3 extent = glm::max(glm::max(glm::vec3(triangles[i * 3]), glm::vec3(triangles[i * 3 + 1])), glm::vec3(triangles[i * 3 + 2]))
+			- glm::min(glm::min(glm::vec3(triangles[i * 3]), glm::vec3(triangles[i * 3 + 1])), glm::vec3(triangles[i * 3 + 2]));
+		maxExtent = std::max(maxExtent, std::max(extent.x, std::max(extent.y, extent.z)));
+	}
+	cellSize = std::max(maxExtent, 4.0f * thickness);
+	const float margin = 0.5f * cellSize + thickness;
+	const uint32_t size = 2 * triangleCount;
+
+	// (bucket, triangle) pairs, sorted so the entries of a bucket are contiguous
+	std::vector<std::pair<uint32_t, uint32_t>> pairs;
+	for (uint32_t i = 0; i < triangleCount; i++) {
+		const glm::vec3 minimum = glm::min(glm::min(glm::vec3(triangles[i * 3]), glm::vec3(triangles[i * 3 + 1])), glm::vec3(triangles[i * 3 + 2])) - glm::vec3(margin);
+		const glm::vec3 maximum = glm::max(glm::max(glm::vec3(triangles[i * 3]), glm::vec3(triangles[i * 3 + 1])), glm::vec3(triangles[i * 3 + 2])) + glm::vec3(margin);
+		const glm::ivec3 first = glm::ivec3(glm::floor(minimum / cellSize));
+		const glm::ivec3 last = glm::ivec3(glm::floor(maximum / cellSize));
+		for (int32_t z = first.z; z <= last.z; z++) {
+			for (int32_t y = first.y; y <= last.y; y++) {
+				for (int32_t x = first.x; x <= last.x; x++) {
+					pairs.push_back(std::make_pair(hash(glm::ivec3(x, y, z), size), i));
+				}
+			}
+		}
+	}
+	std::sort(pairs.begin(), pairs.end());
+	pairs.erase(std::unique(pairs.begin(), pairs.end()), pairs.end());
+
+	cells.assign(size, glm::uvec2(0));
+	entries.resize(pairs.size());
+	for (size_t i = 0; i < pairs.size(); i++) {
+		glm::uvec2 &cell = cells[pairs[i].first];
+		if (cell.y == 0) {
+			cell.x = static_cast<uint32_t>(i);
+		}
+		cell.y++;
+		entries[i] = pairs[i].second;
+	}
+}
+
+uint32_t CollisionHash::tableSize() const
+{
+	return static_cast<uint32_t>(cells.size());
+}
+
+uint32_t CollisionHash::hash(const glm::ivec3 &cell, uint32_t tableSize)
+{
+	return ((static_cast<uint32_t>(cell.x) * 92837111u) ^ (static_cast<uint32_t>(cell.y) * 689287499u) ^ (static_cast<uint32_t>(cell.z) * 283923481u)) % tableSize;
+}
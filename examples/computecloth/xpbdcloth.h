@@ -0,0 +1,120 @@
+/*
+* XPBD cloth setup
+*
+* Host side preparation of the data used by the cloth compute shaders
+* Particles of every cloth piece are stored in tiles of 16x16, each tile is simulated by one workgroup that solves the
+* constraints between its own particles in shared memory. Constraints crossing tiles are solved on global memory after that.
+* Both sets are split into batches by greedy graph colouring, no two constraints of a batch move the same particle
+* Scene geometry used for collisions is stored in a spatial hash of triangles
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#pragma once
+
+#include <vector>
+#include <stdint.h>
+
+#define GLM_FORCE_RADIANS
+#define GLM_FORCE_DEPTH_ZERO_TO_ONE
+#include <glm/glm.hpp>
+
+// SSBO cloth particle declaration, also used as the vertex layout for rendering
+struct Particle {
+	glm::vec4 pos;								// xyz = position, w = inverse mass (0 for pinned particles)
+	glm::vec4 vel;
+	glm::vec4 uv;
+	glm::vec4 normal;
+	float pinned;
+	glm::vec3 _pad0;
+};
+
+class XpbdCloth
+{
+public:
+	static const uint32_t tileWidth = 16;
+	// Workgroup size of the tile solver
+	static const uint32_t tileSize = tileWidth * tileWidth;
+	// Must match the shared memory and tile declarations of cloth_solve.comp
+	static const uint32_t maxTileConstraints = 2048;
+	static const uint32_t maxColors = 31;
+
+	enum ConstraintType { ConstraintStretch = 0, ConstraintShear = 1, ConstraintBending = 2 };
+
+	// Particles [firstParticle, firstParticle + particleCount) are simulated by one workgroup
+	// Interior constraints of colour c are [firstConstraint + colorOffsets[c], firstConstraint + colorOffsets[c + 1])
+	struct Tile {
+		uint32_t firstParticle;
+		uint32_t particleCount;
+		uint32_t firstConstraint;
+		uint32_t colorCount;
+		uint32_t colorOffsets[maxColors + 1];
+	};
+
+	// Constraint between particles of different tiles, uses global particle indices
+	struct BoundaryConstraint {
+		uint32_t a;
+		uint32_t b;
+		float restLength;
+		uint32_t type;
+	};
+
+	struct Piece {
+		glm::uvec2 gridsize;
+		glm::uvec2 tileCount;
+		uint32_t firstTile;
+	};
+
+	std::vector<Particle> particles;
+	// Left, right, lower and upper neighbour of every particle used for the normals, ~0 at the borders
+	std::vector<glm::uvec4> neighbours;
+	std::vector<Tile> tiles;
+	// x = local index a | local index b << 8 | type << 16, y = rest length as float bits
+	std::vector<glm::uvec2> tileConstraints;
+	std::vector<BoundaryConstraint> boundaryConstraints;
+	// Boundary constraints of colour c are [boundaryColorOffsets[c], boundaryColorOffsets[c + 1])
+	std::vector<uint32_t> boundaryColorOffsets;
+	std::vector<Piece> pieces;
+
+	// Adds a grid of particles spanning size on the xy plane of the given transform
+	uint32_t addPiece(const glm::uvec2 &gridsize, const glm::vec2 &size, const glm::mat4 &transform);
+	uint32_t particleIndex(uint32_t piece, uint32_t x, uint32_t y) const;
+	void pin(uint32_t piece, uint32_t x, uint32_t y);
+	// Generates the stretch, shear and bending constraints of all pieces and colours them
+	void build();
+	// Triangle strips for all pieces, rows are separated by primitive restart indices
+	std::vector<uint32_t> triangleStripIndices() const;
+	uint32_t maxTileColors() const;
+	uint32_t boundaryColors() const;
+
+private:
+	struct Constraint {
+		uint32_t a;
+		uint32_t b;
+		float restLength;
+		uint32_t type;
+	};
+
+	static uint32_t assignColor(std::vector<uint32_t> &usedColors, uint32_t a, uint32_t b);
+	void addConstraint(std::vector<Constraint> &constraints, uint32_t piece, glm::uvec2 a, glm::uvec2 b, ConstraintType type) const;
+};
+
+// Spatial hash of collision triangles, cells are hashed into a fixed size table so the scene needs no grid bounds
+class CollisionHash
+{
+public:
+	float cellSize = 1.0f;
+	// Three vec4 per triangle, the w components of the vertices store the outward facing normal
+	std::vector<glm::vec4> triangles;
+	// x = first entry, y = entry count of every hash table bucket
+	std::vector<glm::uvec2> cells;
+	std::vector<uint32_t> entries;
+
+	// Vertex normals are only used to orient the triangle normals
+	void addMesh(const std::vector<glm::vec3> &positions, const std::vector<glm::vec3> &normals, const std::vector<uint32_t> &indices, const glm::vec3 &offset);
+	// Triangles are inserted into every cell within half a cell size of them, so a particle only has to look up its own cell
+	void build(float thickness);
+	uint32_t tableSize() const;
+	// Must match hashCell() of cloth_solve.comp
+	static uint32_t hash(const glm::ivec3 &cell, uint32_t tableSize);
+};
@@ -1,12 +1,16 @@
 /*
 * Vulkan Example - Compute shader N-body simulation using two passes and shared compute shader memory
 *
+* Large particle counts use a Barnes-Hut style approximation based on a grid pyramid that is rebuilt every frame
+* A multithreaded CPU implementation (see nbodycpu.h) serves as a reference to validate the GPU results
+*
 * Copyright (C) by Sascha Willems - www.saschawillems.de
 *
 * This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
 */
 
 #include "vulkanexamplebase.h"
+#include "nbodycpu.h"
 
 #define VERTEX_BUFFER_BIND_ID 0
 #define ENABLE_VALIDATION false
@@ -16,11 +20,40 @@
 #else
 #define PARTICLES_PER_ATTRACTOR 4 * 1024
 #endif
+// The direct O(N^2) simulation is used by default up to this particle count
+#define DIRECT_SIMULATION_LIMIT 64 * 1024
+// Grid pyramid used by the Barnes-Hut simulation, the finest level has 2^(GRID_LEVELS - 1) cells per axis
+#define GRID_LEVELS 7
+#define GRID_EXTENT 32.0f
+// The GPU results are validated with a smaller particle set, the direct CPU reference is O(N^2)
+#define VALIDATION_PARTICLE_COUNT 16 * 1024
+#define VALIDATION_STEPS 8
+#define VALIDATION_DELTA_T 0.001f
 
 class VulkanExample : public VulkanExampleBase
 {
 public:
+	enum SimulationMode { SimulationDirect = 0, SimulationGrid = 1 };
+
 	uint32_t numParticles;
+	uint32_t particlesPerAttractor = PARTICLES_PER_ATTRACTOR;
+	int32_t simulationMode = SimulationDirect;
+
+#if 0
+	std::vector<glm::vec3> attractors = {
+		glm::vec3(2.5f, 1.5f, 0.0f),
+		glm::vec3(-2.5f, -1.5f, 0.0f),
+	};
+#else
+	std::vector<glm::vec3> attractors = {
+		glm::vec3(5.0f, 0.0f, 0.0f),
+		glm::vec3(-5.0f, 0.0f, 0.0f),
+		glm::vec3(0.0f, 0.0f, 5.0f),
+		glm::vec3(0.0f, 0.0f, -5.0f),
+		glm::vec3(0.0f, 4.0f, 0.0f),
+		glm::vec3(0.0f, -8.0f, 0.0f),
+	};
+#endif
 
 	struct {
 		vks::Texture2D particle;
@@ -35,13 +68,12 @@ public:
 
 	// Resources for the graphics part of the example
 	struct {
-		uint32_t queueFamilyIndex;					// Used to check if compute and graphics queue families differ and require additional barriers
 		vks::Buffer uniformBuffer;					// Contains scene matrices
 		VkDescriptorSetLayout descriptorSetLayout;	// Particle system rendering shader binding layout
 		VkDescriptorSet descriptorSet;				// Particle system rendering shader bindings
 		VkPipelineLayout pipelineLayout;			// Layout of the graphics pipeline
 		VkPipeline pipeline;						// Particle rendering pipeline
-		VkSemaphore semaphore;                      // Execution dependency between compute & graphic submission
+		uint32_t vertexBuffer;						// Shared async compute buffer the particles are drawn from
 		struct {
 			glm::mat4 projection;
 			glm::mat4 view;
@@ -50,19 +82,23 @@ public:
 	} graphics;
 
 	// Resources for the compute part of the example
+	// Queue, command pool and synchronization with graphics are handled by the async compute service of the base class
 	struct {
-		uint32_t queueFamilyIndex;					// Used to check if compute and graphics queue families differ and require additional barriers
-		vks::Buffer storageBuffer;					// (Shader) storage buffer object containing the particles
+		vks::Buffer storageBuffer;					// (Shader) storage buffer object containing the particles, only used on the compute queue
 		vks::Buffer uniformBuffer;					// Uniform buffer object containing particle system parameters
-		VkQueue queue;								// Separate queue for compute commands (queue family may differ from the one used for graphics)
-		VkCommandPool commandPool;					// Use a separate command pool (queue family may differ from the one used for graphics)
-		VkCommandBuffer commandBuffer;				// Command buffer storing the dispatch commands and barriers
-		VkSemaphore semaphore;                      // Execution dependency between compute & graphic submission
+		std::array<VkCommandBuffer, vks::AsyncCompute::slotCount> commandBuffers;	// Dispatch commands for every shared buffer slot
 		VkDescriptorSetLayout descriptorSetLayout;	// Compute shader binding layout
 		VkDescriptorSet descriptorSet;				// Compute shader bindings
 		VkPipelineLayout pipelineLayout;			// Layout of the compute pipeline
 		VkPipeline pipelineCalculate;				// Compute pipeline for N-Body velocity calculation (1st pass)
 		VkPipeline pipelineIntegrate;				// Compute pipeline for euler integration (2nd pass)
+		struct {
+			VkPipeline count;						// Bins the particles into the finest grid level
+			VkPipeline scan;						// Prefix sum over the cell counts
+			VkPipeline scatter;						// Sorts the particle indices by cell
+			VkPipeline reduce;						// Builds the center of mass pyramid one level at a time
+			VkPipeline calculate;					// Replaces the 1st pass with a traversal of the pyramid
+		} gridPipelines;
 		VkPipeline blur;
 		VkPipelineLayout pipelineLayoutBlur;
 		VkDescriptorSetLayout descriptorSetLayoutBlur;
@@ -70,14 +106,35 @@ public:
 		struct computeUBO {							// Compute shader uniform block object
 			float deltaT;							//		Frame delta time
 			int32_t particleCount;
+			float theta = 0.5f;						//		Barnes-Hut opening criterion of the grid simulation
+			uint32_t gridLevels;
+			glm::vec4 gridOrigin;					//		xyz = minimum corner of the grid, w = edge length of the finest cells
+			glm::uvec4 levelOffsets[2];				//		Offsets of the grid levels in the cell data buffer
 		} ubo;
 	} compute;
 
-	// SSBO particle declaration
-	struct Particle {
-		glm::vec4 pos;								// xyz = position, w = mass
-		glm::vec4 vel;								// xyz = velocity, w = gradient texture position
-	};
+	// Storage buffers of the grid simulation, only used on the compute queue
+	struct {
+		vks::Buffer cellCounts;
+		vks::Buffer cellStarts;
+		vks::Buffer particleCells;
+		vks::Buffer sortedIndices;
+		vks::Buffer cellData;
+	} grid;
+
+	// Separate particle set used to compare the GPU simulation against the CPU reference
+	struct {
+		vks::Buffer storageBuffer;
+		vks::Buffer uniformBuffer;
+		VkDescriptorSet descriptorSet;
+		std::unique_ptr<NBodyCpu> cpu;
+		bool valid = false;
+		uint32_t particleCount = 0;
+		NBodyCpu::Error gpuError;
+		NBodyCpu::Error barnesHutError;
+		double directTime = 0.0;
+		double barnesHutTime = 0.0;
+	} validation;
 
 	VulkanExample() : VulkanExampleBase(ENABLE_VALIDATION)
 	{
@@ -87,6 +144,25 @@ public:
 		camera.setRotation(glm::vec3(-26.0f, 75.0f, 0.0f));
 		camera.setTranslation(glm::vec3(0.0f, 0.0f, -14.0f));
 		camera.movementSpeed = 2.5f;
+		// Compute runs on its own queue concurrently with graphics, timeline semaphores require at least Vulkan 1.1
+		useAsyncCompute = true;
+		apiVersion = VK_API_VERSION_1_1;
+
+		commandLineParser.add("particlecount", { "-pc", "--particlecount" }, 1, "Set the total number of particles");
+		commandLineParser.add("cpubenchmark", { "-cb", "--cpubenchmark" }, 0, "Run the CPU reference simulation without a window and print timings");
+		commandLineParser.add("validate", { "-val", "--validate" }, 0, "Compare the GPU simulation against the CPU reference at startup");
+		commandLineParser.parse(args);
+		if (commandLineParser.isSet("particlecount")) {
+			const uint32_t particleCount = commandLineParser.getValueAsInt("particlecount", particlesPerAttractor * static_cast<uint32_t>(attractors.size()));
+			particlesPerAttractor = std::max(1u, particleCount / static_cast<uint32_t>(attractors.size()));
+		}
+		if (particlesPerAttractor * attractors.size() > DIRECT_SIMULATION_LIMIT) {
+			simulationMode = SimulationGrid;
+		}
+		if (commandLineParser.isSet("cpubenchmark")) {
+			runCpuBenchmark();
+			exit(0);
+		}
 	}
 
 	~VulkanExample()
@@ -96,7 +172,6 @@ public:
 		vkDestroyPipeline(device, graphics.pipeline, nullptr);
 		vkDestroyPipelineLayout(device, graphics.pipelineLayout, nullptr);
 		vkDestroyDescriptorSetLayout(device, graphics.descriptorSetLayout, nullptr);
-		vkDestroySemaphore(device, graphics.semaphore, nullptr);
 
 		// Compute
 		compute.storageBuffer.destroy();
@@ -105,8 +180,18 @@ public:
 		vkDestroyDescriptorSetLayout(device, compute.descriptorSetLayout, nullptr);
 		vkDestroyPipeline(device, compute.pipelineCalculate, nullptr);
 		vkDestroyPipeline(device, compute.pipelineIntegrate, nullptr);
-		vkDestroySemaphore(device, compute.semaphore, nullptr);
-		vkDestroyCommandPool(device, compute.commandPool, nullptr);
+		vkDestroyPipeline(device, compute.gridPipelines.count, nullptr);
+		vkDestroyPipeline(device, compute.gridPipelines.scan, nullptr);
+		vkDestroyPipeline(device, compute.gridPipelines.scatter, nullptr);
+		vkDestroyPipeline(device, compute.gridPipelines.reduce, nullptr);
+		vkDestroyPipeline(device, compute.gridPipelines.calculate, nullptr);
+		grid.cellCounts.destroy();
+		grid.cellStarts.destroy();
+		grid.particleCells.destroy();
+		grid.sortedIndices.destroy();
+		grid.cellData.destroy();
+		validation.storageBuffer.destroy();
+		validation.uniformBuffer.destroy();
 
 		textures.particle.destroy();
 		textures.gradient.destroy();
@@ -119,6 +204,15 @@ public:
 	}
 
 	void buildCommandBuffers()
+	{
+		for (int32_t i = 0; i < drawCmdBuffers.size(); ++i)
+		{
+			buildDrawCommandBuffer(i);
+		}
+	}
+
+	// Graphics draws the shared buffer slot holding the results of the previous compute frame, which changes every frame
+	void buildDrawCommandBuffer(uint32_t index)
 	{
 		VkCommandBufferBeginInfo cmdBufInfo = vks::initializers::commandBufferBeginInfo();
 
@@ -134,214 +228,133 @@ public:
 		renderPassBeginInfo.renderArea.extent.height = height;
 		renderPassBeginInfo.clearValueCount = 2;
 		renderPassBeginInfo.pClearValues = clearValues;
+		// Set target frame buffer
+		renderPassBeginInfo.framebuffer = frameBuffers[index];
 
-		for (int32_t i = 0; i < drawCmdBuffers.size(); ++i)
-		{
-			// Set target frame buffer
-			renderPassBeginInfo.framebuffer = frameBuffers[i];
-
-			VK_CHECK_RESULT(vkBeginCommandBuffer(drawCmdBuffers[i], &cmdBufInfo));
-
-			// Acquire barrier
-			if (graphics.queueFamilyIndex != compute.queueFamilyIndex)
-			{
-				VkBufferMemoryBarrier buffer_barrier =
-				{
-					VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER,
-					nullptr,
-					0,
-					VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT,
-					compute.queueFamilyIndex,
-					graphics.queueFamilyIndex,
-					compute.storageBuffer.buffer,
-					0,
-					compute.storageBuffer.size
-				};
-
-				vkCmdPipelineBarrier(
-					drawCmdBuffers[i],
-					VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,
-					VK_PIPELINE_STAGE_VERTEX_INPUT_BIT,
-					0,
-					0, nullptr,
-					1, &buffer_barrier,
-					0, nullptr);
-			}
+		VkCommandBuffer commandBuffer = drawCmdBuffers[index];
+		VK_CHECK_RESULT(vkBeginCommandBuffer(commandBuffer, &cmdBufInfo));
 
-			// Draw the particle system using the update vertex buffer
-			vkCmdBeginRenderPass(drawCmdBuffers[i], &renderPassBeginInfo, VK_SUBPASS_CONTENTS_INLINE);
+		// Acquires the shared buffer from the compute queue if the queue families differ
+		asyncCompute.beginGraphics(commandBuffer);
 
-			VkViewport viewport = vks::initializers::viewport((float)width, (float)height, 0.0f, 1.0f);
-			vkCmdSetViewport(drawCmdBuffers[i], 0, 1, &viewport);
+		// Draw the particle system using the update vertex buffer
+		vkCmdBeginRenderPass(commandBuffer, &renderPassBeginInfo, VK_SUBPASS_CONTENTS_INLINE);
 
-			VkRect2D scissor = vks::initializers::rect2D(width, height, 0, 0);
-			vkCmdSetScissor(drawCmdBuffers[i], 0, 1, &scissor);
+		VkViewport viewport = vks::initializers::viewport((float)width, (float)height, 0.0f, 1.0f);
+		vkCmdSetViewport(commandBuffer, 0, 1, &viewport);
 
-			vkCmdBindPipeline(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, graphics.pipeline);
-			vkCmdBindDescriptorSets(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, graphics.pipelineLayout, 0, 1, &graphics.descriptorSet, 0, nullptr);
+		VkRect2D scissor = vks::initializers::rect2D(width, height, 0, 0);
+		vkCmdSetScissor(commandBuffer, 0, 1, &scissor);
 
-			VkDeviceSize offsets[1] = { 0 };
-			vkCmdBindVertexBuffers(drawCmdBuffers[i], VERTEX_BUFFER_BIND_ID, 1, &compute.storageBuffer.buffer, offsets);
-			vkCmdDraw(drawCmdBuffers[i], numParticles, 1, 0, 0);
+		vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, graphics.pipeline);
+		vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, graphics.pipelineLayout, 0, 1, &graphics.descriptorSet, 0, nullptr);
 
-			drawUI(drawCmdBuffers[i]);
+		VkDeviceSize offsets[1] = { 0 };
+		const vks::Buffer &vertexBuffer = asyncCompute.sharedBuffer(graphics.vertexBuffer, asyncCompute.graphicsSlot());
+		vkCmdBindVertexBuffers(commandBuffer, VERTEX_BUFFER_BIND_ID, 1, &vertexBuffer.buffer, offsets);
+		vkCmdDraw(commandBuffer, numParticles, 1, 0, 0);
 
-			vkCmdEndRenderPass(drawCmdBuffers[i]);
+		drawUI(commandBuffer);
 
-			// Release barrier
-			if (graphics.queueFamilyIndex != compute.queueFamilyIndex)
-			{
-				VkBufferMemoryBarrier buffer_barrier =
-				{
-					VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER,
-					nullptr,
-					VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT,
-					0,
-					graphics.queueFamilyIndex,
-					compute.queueFamilyIndex,
-					compute.storageBuffer.buffer,
-					0,
-					compute.storageBuffer.size
-				};
-
-				vkCmdPipelineBarrier(
-					drawCmdBuffers[i],
-					VK_PIPELINE_STAGE_VERTEX_INPUT_BIT,
-					VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT,
-					0,
-					0, nullptr,
-					1, &buffer_barrier,
-					0, nullptr);
-			}
+		vkCmdEndRenderPass(commandBuffer);
 
-			VK_CHECK_RESULT(vkEndCommandBuffer(drawCmdBuffers[i]));
-		}
+		// Releases the shared buffer back to the compute queue
+		asyncCompute.endGraphics(commandBuffer);
 
+		VK_CHECK_RESULT(vkEndCommandBuffer(commandBuffer));
 	}
 
-	void buildComputeCommandBuffer()
+	void buildComputeCommandBuffers()
 	{
 		VkCommandBufferBeginInfo cmdBufInfo = vks::initializers::commandBufferBeginInfo();
 
-		VK_CHECK_RESULT(vkBeginCommandBuffer(compute.commandBuffer, &cmdBufInfo));
-
-		// Acquire barrier
-		if (graphics.queueFamilyIndex != compute.queueFamilyIndex)
+		for (uint32_t slot = 0; slot < vks::AsyncCompute::slotCount; slot++)
 		{
-			VkBufferMemoryBarrier buffer_barrier =
-			{
-				VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER,
-				nullptr,
-				0,
-				VK_ACCESS_SHADER_WRITE_BIT,
-				graphics.queueFamilyIndex,
-				compute.queueFamilyIndex,
-				compute.storageBuffer.buffer,
-				0,
-				compute.storageBuffer.size
-			};
+			VkCommandBuffer commandBuffer = compute.commandBuffers[slot];
+			VK_CHECK_RESULT(vkBeginCommandBuffer(commandBuffer, &cmdBufInfo));
 
-			vkCmdPipelineBarrier(
-				compute.commandBuffer,
-				VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,
-				VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
-				0,
-				0, nullptr,
-				1, &buffer_barrier,
-				0, nullptr);
+			asyncCompute.beginCompute(commandBuffer, slot);
+
+			recordSimulationStep(commandBuffer, compute.descriptorSet, numParticles);
+
+			// Copies the particles to the shared buffer slot and releases it to the graphics queue
+			asyncCompute.endCompute(commandBuffer, slot);
+
+			VK_CHECK_RESULT(vkEndCommandBuffer(commandBuffer));
 		}
+	}
 
-		// First pass: Calculate particle movement
-		// -------------------------------------------------------------------------------------------------------
-		vkCmdBindPipeline(compute.commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, compute.pipelineCalculate);
-		vkCmdBindDescriptorSets(compute.commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, compute.pipelineLayout, 0, 1, &compute.descriptorSet, 0, 0);
-		vkCmdDispatch(compute.commandBuffer, numParticles / 256, 1, 1);
+	// Makes the results of previous compute (or transfer) commands visible to the next dispatch
+	void computeBarrier(VkCommandBuffer commandBuffer, VkPipelineStageFlags srcStageMask = VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VkAccessFlags srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT)
+	{
+		VkMemoryBarrier memoryBarrier = vks::initializers::memoryBarrier();
+		memoryBarrier.srcAccessMask = srcAccessMask;
+		memoryBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+		vkCmdPipelineBarrier(commandBuffer, srcStageMask, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_FLAGS_NONE, 1, &memoryBarrier, 0, nullptr, 0, nullptr);
+	}
 
-		// Add memory barrier to ensure that the computer shader has finished writing to the buffer
-		VkBufferMemoryBarrier bufferBarrier = vks::initializers::bufferMemoryBarrier();
-		bufferBarrier.buffer = compute.storageBuffer.buffer;
-		bufferBarrier.size = compute.storageBuffer.descriptor.range;
-		bufferBarrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
-		bufferBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
-		// Transfer ownership if compute and graphics queue family indices differ
-		bufferBarrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
-		bufferBarrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
-
-		vkCmdPipelineBarrier(
-			compute.commandBuffer,
-			VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
-			VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
-			VK_FLAGS_NONE,
-			0, nullptr,
-			1, &bufferBarrier,
-			0, nullptr);
+	// Records one simulation step for the particles of the given descriptor set
+	void recordSimulationStep(VkCommandBuffer commandBuffer, VkDescriptorSet descriptorSet, uint32_t particleCount)
+	{
+		const uint32_t particleGroups = (particleCount + 255) / 256;
+		vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, compute.pipelineLayout, 0, 1, &descriptorSet, 0, 0);
 
-		// Second pass: Integrate particles
+		// First pass: Calculate particle movement
 		// -------------------------------------------------------------------------------------------------------
-		vkCmdBindPipeline(compute.commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, compute.pipelineIntegrate);
-		vkCmdDispatch(compute.commandBuffer, numParticles / 256, 1, 1);
-
-		// Release barrier
-		if (graphics.queueFamilyIndex != compute.queueFamilyIndex)
+		if (simulationMode == SimulationGrid)
 		{
-			VkBufferMemoryBarrier buffer_barrier =
-			{
-				VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER,
-				nullptr,
-				VK_ACCESS_SHADER_WRITE_BIT,
-				0,
-				compute.queueFamilyIndex,
-				graphics.queueFamilyIndex,
-				compute.storageBuffer.buffer,
-				0,
-				compute.storageBuffer.size
-			};
+			// Sort the particles into the cells of the finest grid level
+			vkCmdFillBuffer(commandBuffer, grid.cellCounts.buffer, 0, VK_WHOLE_SIZE, 0);
+			computeBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_WRITE_BIT);
+			vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, compute.gridPipelines.count);
+			vkCmdDispatch(commandBuffer, particleGroups, 1, 1);
+			computeBarrier(commandBuffer);
+			vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, compute.gridPipelines.scan);
+			vkCmdDispatch(commandBuffer, 1, 1, 1);
+			computeBarrier(commandBuffer);
+			vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, compute.gridPipelines.scatter);
+			vkCmdDispatch(commandBuffer, particleGroups, 1, 1);
+			computeBarrier(commandBuffer);
+
+			// Accumulate mass and center of mass from the finest to the coarsest level
+			vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, compute.gridPipelines.reduce);
+			for (uint32_t level = 0; level < GRID_LEVELS; level++) {
+				const uint32_t dim = 1 << (GRID_LEVELS - 1 - level);
+				vkCmdPushConstants(commandBuffer, compute.pipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(uint32_t), &level);
+				vkCmdDispatch(commandBuffer, (dim * dim * dim + 255) / 256, 1, 1);
+				computeBarrier(commandBuffer);
+			}
 
-			vkCmdPipelineBarrier(
-				compute.commandBuffer,
-				VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
-				VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT,
-				0,
-				0, nullptr,
-				1, &buffer_barrier,
-				0, nullptr);
+			vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, compute.gridPipelines.calculate);
+			vkCmdDispatch(commandBuffer, particleGroups, 1, 1);
+		}
+		else
+		{
+			vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, compute.pipelineCalculate);
+			vkCmdDispatch(commandBuffer, particleGroups, 1, 1);
 		}
 
-		vkEndCommandBuffer(compute.commandBuffer);
+		// Add memory barrier to ensure that the computer shader has finished writing to the buffer
+		computeBarrier(commandBuffer);
+
+		// Second pass: Integrate particles
+		// -------------------------------------------------------------------------------------------------------
+		vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, compute.pipelineIntegrate);
+		vkCmdDispatch(commandBuffer, particleGroups, 1, 1);
 	}
 
-	// Setup and fill the compute shader storage buffers containing the particles
-	void prepareStorageBuffers()
+	std::vector<Particle> generateParticles(uint32_t perAttractor, unsigned seed)
 	{
-#if 0
-		std::vector<glm::vec3> attractors = {
-			glm::vec3(2.5f, 1.5f, 0.0f),
-			glm::vec3(-2.5f, -1.5f, 0.0f),
-		};
-#else
-		std::vector<glm::vec3> attractors = {
-			glm::vec3(5.0f, 0.0f, 0.0f),
-			glm::vec3(-5.0f, 0.0f, 0.0f),
-			glm::vec3(0.0f, 0.0f, 5.0f),
-			glm::vec3(0.0f, 0.0f, -5.0f),
-			glm::vec3(0.0f, 4.0f, 0.0f),
-			glm::vec3(0.0f, -8.0f, 0.0f),
-		};
-#endif
-
-		numParticles = static_cast<uint32_t>(attractors.size()) * PARTICLES_PER_ATTRACTOR;
-
-		// Initial particle positions
-		std::vector<Particle> particleBuffer(numParticles);
+		std::vector<Particle> particleBuffer(attractors.size() * perAttractor);
 
-		std::default_random_engine rndEngine(benchmark.active ? 0 : (unsigned)time(nullptr));
+		std::default_random_engine rndEngine(seed);
 		std::normal_distribution<float> rndDist(0.0f, 1.0f);
 
 		for (uint32_t i = 0; i < static_cast<uint32_t>(attractors.size()); i++)
 		{
-			for (uint32_t j = 0; j < PARTICLES_PER_ATTRACTOR; j++)
+			for (uint32_t j = 0; j < perAttractor; j++)
 			{
-				Particle &particle = particleBuffer[i * PARTICLES_PER_ATTRACTOR + j];
+				Particle &particle = particleBuffer[i * perAttractor + j];
 
 				// First particle in group as heavy center of gravity
 				if (j == 0)
@@ -370,6 +383,16 @@ public:
 			}
 		}
 
+		return particleBuffer;
+	}
+
+	// Setup and fill the compute shader storage buffers containing the particles
+	void prepareStorageBuffers()
+	{
+		// Initial particle positions
+		std::vector<Particle> particleBuffer = generateParticles(particlesPerAttractor, benchmark.active ? 0 : (unsigned)time(nullptr));
+		numParticles = static_cast<uint32_t>(particleBuffer.size());
+
 		compute.ubo.particleCount = numParticles;
 
 		VkDeviceSize storageBufferSize = particleBuffer.size() * sizeof(Particle);
@@ -387,46 +410,25 @@ public:
 			particleBuffer.data());
 
 		vulkanDevice->createBuffer(
-			// The SSBO will be used as a storage buffer for the compute pipeline and as a vertex buffer in the graphics pipeline
-			VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+			// The SSBO is only used by the compute pipelines, graphics draws copies of it that are handed over by the async compute service
+			VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
 			VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
 			&compute.storageBuffer,
 			storageBufferSize);
 
-		// Copy from staging buffer to storage buffer
-		VkCommandBuffer copyCmd = vulkanDevice->createCommandBuffer(VK_COMMAND_BUFFER_LEVEL_PRIMARY, true);
+		// Copy from staging buffer to storage buffer on the compute queue, so it's owned by the compute queue family
+		VkCommandBuffer copyCmd = vulkanDevice->createCommandBuffer(VK_COMMAND_BUFFER_LEVEL_PRIMARY, asyncCompute.commandPool, true);
 		VkBufferCopy copyRegion = {};
 		copyRegion.size = storageBufferSize;
 		vkCmdCopyBuffer(copyCmd, stagingBuffer.buffer, compute.storageBuffer.buffer, 1, &copyRegion);
-		// Execute a transfer barrier to the compute queue, if necessary
-		if (graphics.queueFamilyIndex != compute.queueFamilyIndex)
-		{
-			VkBufferMemoryBarrier buffer_barrier =
-			{
-				VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER,
-				nullptr,
-				VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT,
-				0,
-				graphics.queueFamilyIndex,
-				compute.queueFamilyIndex,
-				compute.storageBuffer.buffer,
-				0,
-				compute.storageBuffer.size
-			};
-
-			vkCmdPipelineBarrier(
-				copyCmd,
-				VK_PIPELINE_STAGE_VERTEX_INPUT_BIT,
-				VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT,
-				0,
-				0, nullptr,
-				1, &buffer_barrier,
-				0, nullptr);
-		}
-		vulkanDevice->flushCommandBuffer(copyCmd, queue, true);
+		vulkanDevice->flushCommandBuffer(copyCmd, asyncCompute.queue, asyncCompute.commandPool);
 
 		stagingBuffer.destroy();
 
+		// Graphics renders from double buffered copies of the storage buffer
+		graphics.vertexBuffer = asyncCompute.addSharedBuffer(compute.storageBuffer);
+		prepareGridBuffers();
+
 		// Binding description
 		vertices.bindingDescriptions.resize(1);
 		vertices.bindingDescriptions[0] =
@@ -461,12 +463,32 @@ public:
 		vertices.inputState.pVertexAttributeDescriptions = vertices.attributeDescriptions.data();
 	}
 
+	// The grid is shared by the simulation and the validation, which never run at the same time
+	void prepareGridBuffers()
+	{
+		const uint32_t dim = 1 << (GRID_LEVELS - 1);
+		uint32_t cellDataCount = 0;
+		for (uint32_t level = 0; level < GRID_LEVELS; level++) {
+			compute.ubo.levelOffsets[level / 4][level % 4] = cellDataCount;
+			cellDataCount += (dim >> level) * (dim >> level) * (dim >> level);
+		}
+		compute.ubo.gridLevels = GRID_LEVELS;
+		compute.ubo.gridOrigin = glm::vec4(glm::vec3(-GRID_EXTENT), 2.0f * GRID_EXTENT / (float)dim);
+
+		const VkDeviceSize cellCount = dim * dim * dim;
+		VK_CHECK_RESULT(vulkanDevice->createBuffer(VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, &grid.cellCounts, cellCount * sizeof(uint32_t)));
+		VK_CHECK_RESULT(vulkanDevice->createBuffer(VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, &grid.cellStarts, cellCount * sizeof(uint32_t)));
+		VK_CHECK_RESULT(vulkanDevice->createBuffer(VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, &grid.particleCells, numParticles * sizeof(glm::uvec2)));
+		VK_CHECK_RESULT(vulkanDevice->createBuffer(VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, &grid.sortedIndices, numParticles * sizeof(uint32_t)));
+		VK_CHECK_RESULT(vulkanDevice->createBuffer(VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, &grid.cellData, cellDataCount * sizeof(glm::vec4)));
+	}
+
 	void setupDescriptorPool()
 	{
 		std::vector<VkDescriptorPoolSize> poolSizes =
 		{
-			vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 2),
-			vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1),
+			vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 3),
+			vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 12),
 			vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 2)
 		};
 
@@ -474,7 +496,7 @@ public:
 			vks::initializers::descriptorPoolCreateInfo(
 				static_cast<uint32_t>(poolSizes.size()),
 				poolSizes.data(),
-				2);
+				3);
 
 		VK_CHECK_RESULT(vkCreateDescriptorPool(device, &descriptorPoolInfo, nullptr, &descriptorPool));
 	}
@@ -616,26 +638,12 @@ public:
 		setupDescriptorSetLayout();
 		preparePipelines();
 		setupDescriptorSet();
-
-		// Semaphore for compute & graphics sync
-		VkSemaphoreCreateInfo semaphoreCreateInfo = vks::initializers::semaphoreCreateInfo();
-		VK_CHECK_RESULT(vkCreateSemaphore(device, &semaphoreCreateInfo, nullptr, &graphics.semaphore));
-
-		// Signal the semaphore
-		VkSubmitInfo submitInfo = vks::initializers::submitInfo();
-		submitInfo.signalSemaphoreCount = 1;
-		submitInfo.pSignalSemaphores = &graphics.semaphore;
-		VK_CHECK_RESULT(vkQueueSubmit(queue, 1, &submitInfo, VK_NULL_HANDLE));
-		VK_CHECK_RESULT(vkQueueWaitIdle(queue));
 	}
 
 	void prepareCompute()
 	{
-		// Create a compute capable device queue
-		// The VulkanDevice::createLogicalDevice functions finds a compute capable queue and prefers queue families that only support compute
-		// Depending on the implementation this may result in different queue family indices for graphics and computes,
-		// requiring proper synchronization (see the memory barriers in buildComputeCommandBuffer)
-		vkGetDeviceQueue(device, compute.queueFamilyIndex, 0, &compute.queue);
+		// The compute queue is selected by the async compute service of the base class
+		// It prefers queue families that only support compute, the queue family ownership transfers this may require are handled by the service
 
 		// Create compute pipeline
 		// Compute pipelines are created separate from graphics pipelines even if they use the same queue (family index)
@@ -651,6 +659,12 @@ public:
 				VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER,
 				VK_SHADER_STAGE_COMPUTE_BIT,
 				1),
+			// Binding 2 - 6 : Grid storage buffers (cell counts, cell starts, particle cells, sorted indices, cell data)
+			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT, 2),
+			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT, 3),
+			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT, 4),
+			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT, 5),
+			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT, 6),
 		};
 
 		VkDescriptorSetLayoutCreateInfo descriptorLayout =
@@ -665,6 +679,11 @@ public:
 				&compute.descriptorSetLayout,
 				1);
 
+		// The grid level reduced by a dispatch is passed as a push constant
+		VkPushConstantRange pushConstantRange = vks::initializers::pushConstantRange(VK_SHADER_STAGE_COMPUTE_BIT, sizeof(uint32_t), 0);
+		pPipelineLayoutCreateInfo.pushConstantRangeCount = 1;
+		pPipelineLayoutCreateInfo.pPushConstantRanges = &pushConstantRange;
+
 		VK_CHECK_RESULT(vkCreatePipelineLayout(device, &pPipelineLayoutCreateInfo, nullptr,	&compute.pipelineLayout));
 
 		VkDescriptorSetAllocateInfo allocInfo =
@@ -674,24 +693,15 @@ public:
 				1);
 
 		VK_CHECK_RESULT(vkAllocateDescriptorSets(device, &allocInfo, &compute.descriptorSet));
+		updateComputeDescriptorSet(compute.descriptorSet, compute.storageBuffer, compute.uniformBuffer);
 
-		std::vector<VkWriteDescriptorSet> computeWriteDescriptorSets =
-		{
-			// Binding 0 : Particle position storage buffer
-			vks::initializers::writeDescriptorSet(
-				compute.descriptorSet,
-				VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
-				0,
-				&compute.storageBuffer.descriptor),
-			// Binding 1 : Uniform buffer
-			vks::initializers::writeDescriptorSet(
-				compute.descriptorSet,
-				VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER,
-				1,
-				&compute.uniformBuffer.descriptor)
-		};
-
-		vkUpdateDescriptorSets(device, static_cast<uint32_t>(computeWriteDescriptorSets.size()), computeWriteDescriptorSets.data(), 0, nullptr);
+		// The validation uses its own particles and parameters
+		const VkDeviceSize validationSize = std::min(numParticles, (uint32_t)VALIDATION_PARTICLE_COUNT) * sizeof(Particle);
+		VK_CHECK_RESULT(vulkanDevice->createBuffer(VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, &validation.storageBuffer, validationSize));
+		VK_CHECK_RESULT(vulkanDevice->createBuffer(VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, &validation.uniformBuffer, sizeof(compute.ubo)));
+		VK_CHECK_RESULT(validation.uniformBuffer.map());
+		VK_CHECK_RESULT(vkAllocateDescriptorSets(device, &allocInfo, &validation.descriptorSet));
+		updateComputeDescriptorSet(validation.descriptorSet, validation.storageBuffer, validation.uniformBuffer);
 
 		// Create pipelines
 		VkComputePipelineCreateInfo computePipelineCreateInfo = vks::initializers::computePipelineCreateInfo(compute.pipelineLayout, 0);
@@ -715,6 +725,7 @@ public:
 
 		specializationData.sharedDataSize = std::min((uint32_t)1024, (uint32_t)(vulkanDevice->properties.limits.maxComputeSharedMemorySize / sizeof(glm::vec4)));
 
+		// Keep in sync with the defaults of NBodyCpu::Parameters, which serves as the reference
 		specializationData.gravity = 0.002f;
 		specializationData.power = 0.75f;
 		specializationData.soften = 0.05f;
@@ -725,80 +736,49 @@ public:
 
 		VK_CHECK_RESULT(vkCreateComputePipelines(device, pipelineCache, 1, &computePipelineCreateInfo, nullptr, &compute.pipelineCalculate));
 
+		// The grid traversal replaces the 1st pass and uses the same force parameters
+		computePipelineCreateInfo.stage = loadShader(getShadersPath() + "computenbody/grid_calculate.comp.spv", VK_SHADER_STAGE_COMPUTE_BIT);
+		computePipelineCreateInfo.stage.pSpecializationInfo = &specializationInfo;
+		VK_CHECK_RESULT(vkCreateComputePipelines(device, pipelineCache, 1, &computePipelineCreateInfo, nullptr, &compute.gridPipelines.calculate));
+
 		// 2nd pass
 		computePipelineCreateInfo.stage = loadShader(getShadersPath() + "computenbody/particle_integrate.comp.spv", VK_SHADER_STAGE_COMPUTE_BIT);
 		VK_CHECK_RESULT(vkCreateComputePipelines(device, pipelineCache, 1, &computePipelineCreateInfo, nullptr, &compute.pipelineIntegrate));
 
-		// Separate command pool as queue family for compute may be different than graphics
-		VkCommandPoolCreateInfo cmdPoolInfo = {};
-		cmdPoolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
-		cmdPoolInfo.queueFamilyIndex = compute.queueFamilyIndex;
-		cmdPoolInfo.flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
-		VK_CHECK_RESULT(vkCreateCommandPool(device, &cmdPoolInfo, nullptr, &compute.commandPool));
-
-		// Create a command buffer for compute operations
-		compute.commandBuffer = vulkanDevice->createCommandBuffer(VK_COMMAND_BUFFER_LEVEL_PRIMARY, compute.commandPool);
-
-		// Semaphore for compute & graphics sync
-		VkSemaphoreCreateInfo semaphoreCreateInfo = vks::initializers::semaphoreCreateInfo();
-		VK_CHECK_RESULT(vkCreateSemaphore(device, &semaphoreCreateInfo, nullptr, &compute.semaphore));
-
-		// Build a single command buffer containing the compute dispatch commands
-		buildComputeCommandBuffer();
+		// Grid construction
+		computePipelineCreateInfo.stage = loadShader(getShadersPath() + "computenbody/grid_count.comp.spv", VK_SHADER_STAGE_COMPUTE_BIT);
+		VK_CHECK_RESULT(vkCreateComputePipelines(device, pipelineCache, 1, &computePipelineCreateInfo, nullptr, &compute.gridPipelines.count));
+		computePipelineCreateInfo.stage = loadShader(getShadersPath() + "computenbody/grid_scan.comp.spv", VK_SHADER_STAGE_COMPUTE_BIT);
+		VK_CHECK_RESULT(vkCreateComputePipelines(device, pipelineCache, 1, &computePipelineCreateInfo, nullptr, &compute.gridPipelines.scan));
+		computePipelineCreateInfo.stage = loadShader(getShadersPath() + "computenbody/grid_scatter.comp.spv", VK_SHADER_STAGE_COMPUTE_BIT);
+		VK_CHECK_RESULT(vkCreateComputePipelines(device, pipelineCache, 1, &computePipelineCreateInfo, nullptr, &compute.gridPipelines.scatter));
+		computePipelineCreateInfo.stage = loadShader(getShadersPath() + "computenbody/grid_reduce.comp.spv", VK_SHADER_STAGE_COMPUTE_BIT);
+		VK_CHECK_RESULT(vkCreateComputePipelines(device, pipelineCache, 1, &computePipelineCreateInfo, nullptr, &compute.gridPipelines.reduce));
+
+		// Command buffers for the compute queue, one per shared buffer slot
+		VkCommandBufferAllocateInfo cmdBufAllocateInfo =
+			vks::initializers::commandBufferAllocateInfo(asyncCompute.commandPool, VK_COMMAND_BUFFER_LEVEL_PRIMARY, vks::AsyncCompute::slotCount);
+		VK_CHECK_RESULT(vkAllocateCommandBuffers(device, &cmdBufAllocateInfo, compute.commandBuffers.data()));
+
+		buildComputeCommandBuffers();
+	}
 
-		// SRS - By reordering compute and graphics within draw(), the following code is no longer needed:
-		// If graphics and compute queue family indices differ, acquire and immediately release the storage buffer, so that the initial acquire from the graphics command buffers are matched up properly
-		/*
-		if (graphics.queueFamilyIndex != compute.queueFamilyIndex)
+	void updateComputeDescriptorSet(VkDescriptorSet descriptorSet, vks::Buffer &storageBuffer, vks::Buffer &uniformBuffer)
+	{
+		std::vector<VkWriteDescriptorSet> computeWriteDescriptorSets =
 		{
-			// Create a transient command buffer for setting up the initial buffer transfer state
-			VkCommandBuffer transferCmd = vulkanDevice->createCommandBuffer(VK_COMMAND_BUFFER_LEVEL_PRIMARY, compute.commandPool, true);
-
-			VkBufferMemoryBarrier acquire_buffer_barrier =
-			{
-				VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER,
-				nullptr,
-				0,
-				VK_ACCESS_SHADER_WRITE_BIT,
-				graphics.queueFamilyIndex,
-				compute.queueFamilyIndex,
-				compute.storageBuffer.buffer,
-				0,
-				compute.storageBuffer.size
-			};
-			vkCmdPipelineBarrier(
-				transferCmd,
-				VK_PIPELINE_STAGE_VERTEX_INPUT_BIT,
-				VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
-				0,
-				0, nullptr,
-				1, &acquire_buffer_barrier,
-				0, nullptr);
-
-			VkBufferMemoryBarrier release_buffer_barrier =
-			{
-				VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER,
-				nullptr,
-				VK_ACCESS_SHADER_WRITE_BIT,
-				0,
-				compute.queueFamilyIndex,
-				graphics.queueFamilyIndex,
-				compute.storageBuffer.buffer,
-				0,
-				compute.storageBuffer.size
-			};
-			vkCmdPipelineBarrier(
-				transferCmd,
-				VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
-				VK_PIPELINE_STAGE_VERTEX_INPUT_BIT,
-				0,
-				0, nullptr,
-				1, &release_buffer_barrier,
-				0, nullptr);
-
-			vulkanDevice->flushCommandBuffer(transferCmd, compute.queue, compute.commandPool);
-		}
-		*/
+			// Binding 0 : Particle position storage buffer
+			vks::initializers::writeDescriptorSet(descriptorSet, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 0, &storageBuffer.descriptor),
+			// Binding 1 : Uniform buffer
+			vks::initializers::writeDescriptorSet(descriptorSet, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 1, &uniformBuffer.descriptor),
+			// Binding 2 - 6 : Grid storage buffers
+			vks::initializers::writeDescriptorSet(descriptorSet, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 2, &grid.cellCounts.descriptor),
+			vks::initializers::writeDescriptorSet(descriptorSet, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 3, &grid.cellStarts.descriptor),
+			vks::initializers::writeDescriptorSet(descriptorSet, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 4, &grid.particleCells.descriptor),
+			vks::initializers::writeDescriptorSet(descriptorSet, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 5, &grid.sortedIndices.descriptor),
+			vks::initializers::writeDescriptorSet(descriptorSet, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 6, &grid.cellData.descriptor),
+		};
+		vkUpdateDescriptorSets(device, static_cast<uint32_t>(computeWriteDescriptorSets.size()), computeWriteDescriptorSets.data(), 0, nullptr);
 	}
 
 	// Prepare and initialize uniform buffer containing shader uniforms
@@ -842,37 +822,121 @@ public:
 		memcpy(graphics.uniformBuffer.mapped, &graphics.ubo, sizeof(graphics.ubo));
 	}
 
+	// Headless benchmark of the CPU reference, runs before any Vulkan object has been created
+	void runCpuBenchmark()
+	{
+		std::vector<Particle> particles = generateParticles(particlesPerAttractor, 0);
+		const uint32_t particleCount = static_cast<uint32_t>(particles.size());
+		NBodyCpu cpu;
+
+		std::cout << std::fixed << std::setprecision(3);
+		std::cout << "CPU N-body benchmark" << "\n";
+		std::cout << "particles: " << particleCount << ", threads: " << cpu.threadCount() << ", AVX2: " << (NBodyCpu::simdSupported() ? "yes" : "no") << "\n";
+
+		// The direct sum is quadratic, so the reference is only computed for an evenly spaced sample of the particles
+		std::vector<uint32_t> sample;
+		const uint32_t stride = std::max(1u, particleCount / 4096);
+		for (uint32_t i = 0; i < particleCount; i += stride) {
+			sample.push_back(i);
+		}
+		std::vector<glm::vec4> reference, accelerations;
+		cpu.computeAccelerations(particles, sample, reference, NBodyCpu::MethodDirect);
+		std::cout << "direct: " << cpu.statistics.forceTime * particleCount / sample.size() << " ms per step, " << cpu.statistics.interactions / (cpu.statistics.forceTime * 1.0e6) << " G interactions/s" << "\n";
+
+		for (float theta : { 0.25f, 0.5f, 0.75f, 1.0f }) {
+			cpu.parameters.theta = theta;
+			cpu.computeAccelerations(particles, accelerations, NBodyCpu::MethodBarnesHut);
+			std::vector<glm::vec4> sampled(sample.size());
+			for (size_t i = 0; i < sample.size(); i++) {
+				sampled[i] = accelerations[sample[i]];
+			}
+			std::cout << "barnes-hut theta " << theta << ": " << cpu.statistics.buildTime + cpu.statistics.forceTime << " ms per step (build " << cpu.statistics.buildTime << " ms, " << cpu.statistics.nodeCount << " nodes), "
+				<< (double)cpu.statistics.interactions / particleCount << " interactions per particle, relative error " << NBodyCpu::compare(reference, sampled) << "\n";
+		}
+	}
+
+	// Runs a few steps of the GPU simulation on a separate particle set and compares the result with the CPU reference
+	void validateGpu()
+	{
+		VK_CHECK_RESULT(vkDeviceWaitIdle(device));
+
+		std::vector<Particle> initial = generateParticles(static_cast<uint32_t>(validation.storageBuffer.size / sizeof(Particle) / attractors.size()), 0);
+		const uint32_t particleCount = static_cast<uint32_t>(initial.size());
+		const VkDeviceSize size = particleCount * sizeof(Particle);
+
+		decltype(compute.ubo) ubo = compute.ubo;
+		ubo.deltaT = VALIDATION_DELTA_T;
+		ubo.particleCount = particleCount;
+		memcpy(validation.uniformBuffer.mapped, &ubo, sizeof(ubo));
+
+		vks::Buffer stagingBuffer;
+		VK_CHECK_RESULT(vulkanDevice->createBuffer(VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, &stagingBuffer, size, initial.data()));
+
+		// All steps are recorded into a single command buffer on the compute queue, so no ownership transfers are required
+		VkCommandBuffer commandBuffer = vulkanDevice->createCommandBuffer(VK_COMMAND_BUFFER_LEVEL_PRIMARY, asyncCompute.commandPool, true);
+		VkBufferCopy copyRegion = { 0, 0, size };
+		vkCmdCopyBuffer(commandBuffer, stagingBuffer.buffer, validation.storageBuffer.buffer, 1, &copyRegion);
+		computeBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_WRITE_BIT);
+		for (uint32_t step = 0; step < VALIDATION_STEPS; step++) {
+			recordSimulationStep(commandBuffer, validation.descriptorSet, particleCount);
+			// The next step also clears the cell counts with a transfer
+			VkMemoryBarrier memoryBarrier = vks::initializers::memoryBarrier();
+			memoryBarrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+			memoryBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT | VK_ACCESS_TRANSFER_READ_BIT | VK_ACCESS_TRANSFER_WRITE_BIT;
+			vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_TRANSFER_BIT, VK_FLAGS_NONE, 1, &memoryBarrier, 0, nullptr, 0, nullptr);
+		}
+		vkCmdCopyBuffer(commandBuffer, validation.storageBuffer.buffer, stagingBuffer.buffer, 1, &copyRegion);
+		VkMemoryBarrier hostBarrier = vks::initializers::memoryBarrier();
+		hostBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+		hostBarrier.dstAccessMask = VK_ACCESS_HOST_READ_BIT;
+		vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_HOST_BIT, VK_FLAGS_NONE, 1, &hostBarrier, 0, nullptr, 0, nullptr);
+		vulkanDevice->flushCommandBuffer(commandBuffer, asyncCompute.queue, asyncCompute.commandPool);
+
+		std::vector<Particle> gpuResult(particleCount);
+		VK_CHECK_RESULT(stagingBuffer.map());
+		memcpy(gpuResult.data(), stagingBuffer.mapped, size);
+		stagingBuffer.destroy();
+
+		// The CPU keeps its worker threads between validations
+		if (!validation.cpu) {
+			validation.cpu.reset(new NBodyCpu());
+		}
+		NBodyCpu &cpu = *validation.cpu;
+		cpu.parameters.theta = compute.ubo.theta;
+		std::vector<Particle> direct = initial;
+		std::vector<Particle> barnesHut = initial;
+		validation.directTime = 0.0;
+		validation.barnesHutTime = 0.0;
+		for (uint32_t step = 0; step < VALIDATION_STEPS; step++) {
+			cpu.step(direct, VALIDATION_DELTA_T, NBodyCpu::MethodDirect);
+			validation.directTime += cpu.statistics.forceTime / VALIDATION_STEPS;
+			cpu.step(barnesHut, VALIDATION_DELTA_T, NBodyCpu::MethodBarnesHut);
+			validation.barnesHutTime += (cpu.statistics.buildTime + cpu.statistics.forceTime) / VALIDATION_STEPS;
+		}
+		validation.gpuError = NBodyCpu::compare(direct, gpuResult);
+		validation.barnesHutError = NBodyCpu::compare(direct, barnesHut);
+		validation.particleCount = particleCount;
+		validation.valid = true;
+
+		std::cout << "Validation of the " << (simulationMode == SimulationGrid ? "grid" : "direct") << " simulation with " << particleCount << " particles over " << VALIDATION_STEPS << " steps" << "\n";
+		std::cout << "GPU relative error: position " << validation.gpuError.position << ", velocity " << validation.gpuError.velocity << "\n";
+		std::cout << "CPU Barnes-Hut relative error: position " << validation.barnesHutError.position << ", velocity " << validation.barnesHutError.velocity << "\n";
+	}
+
 	void draw()
 	{
-		// Wait for rendering finished
-		VkPipelineStageFlags waitStageMask = VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT;
-
-		// Submit compute commands
-		VkSubmitInfo computeSubmitInfo = vks::initializers::submitInfo();
-		computeSubmitInfo.commandBufferCount = 1;
-		computeSubmitInfo.pCommandBuffers = &compute.commandBuffer;
-		computeSubmitInfo.waitSemaphoreCount = 1;
-		computeSubmitInfo.pWaitSemaphores = &graphics.semaphore;
-		computeSubmitInfo.pWaitDstStageMask = &waitStageMask;
-		computeSubmitInfo.signalSemaphoreCount = 1;
-		computeSubmitInfo.pSignalSemaphores = &compute.semaphore;
-		VK_CHECK_RESULT(vkQueueSubmit(compute.queue, 1, &computeSubmitInfo, VK_NULL_HANDLE));
+		// Wait for the compute work of the last frame before changing its uniforms
+		asyncCompute.beginFrame();
+		updateComputeUniformBuffers();
 
-		VulkanExampleBase::prepareFrame();
+		// Submit compute commands, they run concurrently with the graphics work of this frame
+		asyncCompute.submitCompute(compute.commandBuffers[asyncCompute.computeSlot()]);
 
-		VkPipelineStageFlags graphicsWaitStageMasks[] = { VK_PIPELINE_STAGE_VERTEX_INPUT_BIT, VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT };
-		VkSemaphore graphicsWaitSemaphores[] = { compute.semaphore, semaphores.presentComplete };
-		VkSemaphore graphicsSignalSemaphores[] = { graphics.semaphore, semaphores.renderComplete };
+		VulkanExampleBase::prepareFrame();
 
-		// Submit graphics commands
-		submitInfo.commandBufferCount = 1;
-		submitInfo.pCommandBuffers = &drawCmdBuffers[currentBuffer];
-		submitInfo.waitSemaphoreCount = 2;
-		submitInfo.pWaitSemaphores = graphicsWaitSemaphores;
-		submitInfo.pWaitDstStageMask = graphicsWaitStageMasks;
-		submitInfo.signalSemaphoreCount = 2;
-		submitInfo.pSignalSemaphores = graphicsSignalSemaphores;
-		VK_CHECK_RESULT(vkQueueSubmit(queue, 1, &submitInfo, VK_NULL_HANDLE));
+		// Submit graphics commands, they draw the particles of the previous compute frame
+		buildDrawCommandBuffer(currentBuffer);
+		asyncCompute.submitGraphics(drawCmdBuffers[currentBuffer], semaphores.presentComplete, submitPipelineStages, semaphores.renderComplete);
 
 		VulkanExampleBase::submitFrame();
 	}
@@ -880,15 +944,14 @@ public:
 	void prepare()
 	{
 		VulkanExampleBase::prepare();
-		// We will be using the queue family indices to check if graphics and compute queue families differ
-		// If that's the case, we need additional barriers for acquiring and releasing resources
-		graphics.queueFamilyIndex = vulkanDevice->queueFamilyIndices.graphics;
-		compute.queueFamilyIndex = vulkanDevice->queueFamilyIndices.compute;
 		loadAssets();
 		setupDescriptorPool();
 		prepareGraphics();
 		prepareCompute();
 		buildCommandBuffers();
+		if (commandLineParser.isSet("validate")) {
+			validateGpu();
+		}
 		prepared = true;
 	}
 
@@ -897,7 +960,6 @@ public:
 		if (!prepared)
 			return;
 		draw();
-		updateComputeUniformBuffers();
 		if (camera.updated) {
 			updateGraphicsUniformBuffers();
 		}
@@ -907,6 +969,34 @@ public:
 	{
 		updateGraphicsUniformBuffers();
 	}
+
+	virtual void OnUpdateUIOverlay(vks::UIOverlay *overlay)
+	{
+		if (overlay->header("Settings")) {
+			overlay->text("%u particles", numParticles);
+			if (overlay->comboBox("Simulation", &simulationMode, { "Direct O(N^2)", "Grid Barnes-Hut" })) {
+				VK_CHECK_RESULT(vkQueueWaitIdle(asyncCompute.queue));
+				buildComputeCommandBuffers();
+			}
+			if (simulationMode == SimulationGrid) {
+				overlay->sliderFloat("Theta", &compute.ubo.theta, 0.1f, 1.5f);
+			}
+		}
+		if (overlay->header("CPU reference")) {
+			overlay->text("AVX2: %s", NBodyCpu::simdSupported() ? "yes" : "no");
+			if (overlay->button("Validate GPU simulation")) {
+				validateGpu();
+			}
+			if (validation.valid) {
+				overlay->text("%u particles, %u steps", validation.particleCount, VALIDATION_STEPS);
+				overlay->text("GPU error: %.2e (velocity)", validation.gpuError.velocity);
+				overlay->text("Barnes-Hut error: %.2e (velocity)", validation.barnesHutError.velocity);
+				overlay->text("CPU direct: %.2f ms/step", validation.directTime);
+				overlay->text("CPU Barnes-Hut: %.2f ms/step", validation.barnesHutTime);
+			}
+		}
+		asyncCompute.updateUIOverlay(overlay);
+	}
 };
 
 VULKAN_EXAMPLE_MAIN()
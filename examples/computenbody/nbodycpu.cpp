@@ -0,0 +1,484 @@
+/*
+* CPU N-body simulation
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#include "nbodycpu.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <limits>
+
+#include "threadpool.hpp"
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#define NBODY_CPU_X86
+#include <immintrin.h>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+#endif
+
+#if defined(NBODY_CPU_X86) && (defined(__GNUC__) || defined(__clang__))
+#define NBODY_TARGET_AVX2 __attribute__((target("avx2,fma")))
+#else
+#define NBODY_TARGET_AVX2
+#endif
+
+namespace
+{
+	// Number of sources per tile of the direct summation, four float arrays of this size stay in the L1/L2 cache
+	const uint32_t directTileSize = 2048;
+	// Number of targets that share a tile before moving on to the next one
+	const uint32_t directBlockSize = 64;
+	// Morton codes use ten bits per axis, which also limits the depth of the octree
+	const uint32_t treeLevels = 10;
+	const uint64_t indexMask = 0xFFFFFFFFull;
+
+	inline float inversePower(float x, float power, int mode)
+	{
+		// Common exponents avoid the generic pow
+		switch (mode) {
+		case 1:
+			return 1.0f / (std::sqrt(x) * std::sqrt(std::sqrt(x)));
+		case 2:
+			return 1.0f / (x * std::sqrt(x));
+		default:
+			return 1.0f / std::pow(x, power);
+		}
+	}
+
+	// Spreads the lower ten bits of a value so that there are two zero bits between each of them
+	inline uint32_t expandBits(uint32_t v)
+	{
+		v = (v * 0x00010001u) & 0xFF0000FFu;
+		v = (v * 0x00000101u) & 0x0F00F00Fu;
+		v = (v * 0x00000011u) & 0xC30C30C3u;
+		v = (v * 0x00000005u) & 0x49249249u;
+		return v;
+	}
+
+	void accumulateScalar(const float *x, const float *y, const float *z, const float *m, uint32_t count, const glm::vec3 &position, float soften, float power, int mode, glm::vec3 &acceleration)
+	{
+		glm::vec3 sum(0.0f);
+		for (uint32_t j = 0; j < count; j++) {
+			const glm::vec3 d(x[j] - position.x, y[j] - position.y, z[j] - position.z);
+			sum += d * (m[j] * inversePower(glm::dot(d, d) + soften, power, mode));
+		}
+		acceleration += sum;
+	}
+
+#if defined(NBODY_CPU_X86)
+	NBODY_TARGET_AVX2 inline float horizontalSum(__m256 v)
+	{
+		__m128 sum = _mm_add_ps(_mm256_castps256_ps128(v), _mm256_extractf128_ps(v, 1));
+		sum = _mm_add_ps(sum, _mm_movehl_ps(sum, sum));
+		sum = _mm_add_ss(sum, _mm_shuffle_ps(sum, sum, 0x55));
+		return _mm_cvtss_f32(sum);
+	}
+
+	// Count must be a multiple of eight, padded sources have zero mass
+	NBODY_TARGET_AVX2 void accumulateAVX2(const float *x, const float *y, const float *z, const float *m, uint32_t count, const glm::vec3 &position, float soften, int mode, glm::vec3 &acceleration)
+	{
+		const __m256 px = _mm256_set1_ps(position.x);
+		const __m256 py = _mm256_set1_ps(position.y);
+		const __m256 pz = _mm256_set1_ps(position.z);
+		const __m256 vsoften = _mm256_set1_ps(soften);
+		__m256 ax = _mm256_setzero_ps();
+		__m256 ay = _mm256_setzero_ps();
+		__m256 az = _mm256_setzero_ps();
+		for (uint32_t j = 0; j < count; j += 8) {
+			const __m256 dx = _mm256_sub_ps(_mm256_loadu_ps(x + j), px);
+			const __m256 dy = _mm256_sub_ps(_mm256_loadu_ps(y + j), py);
+			const __m256 dz = _mm256_sub_ps(_mm256_loadu_ps(z + j), pz);
+			const __m256 r2 = _mm256_fmadd_ps(dx, dx, _mm256_fmadd_ps(dy, dy, _mm256_fmadd_ps(dz, dz, vsoften)));
+			const __m256 r = _mm256_sqrt_ps(r2);
+			const __m256 denominator = (mode == 1) ? _mm256_mul_ps(r, _mm256_sqrt_ps(r)) : _mm256_mul_ps(r2, r);
+			const __m256 f = _mm256_div_ps(_mm256_loadu_ps(m + j), denominator);
+			ax = _mm256_fmadd_ps(dx, f, ax);
+			ay = _mm256_fmadd_ps(dy, f, ay);
+			az = _mm256_fmadd_ps(dz, f, az);
+		}
+		acceleration += glm::vec3(horizontalSum(ax), horizontalSum(ay), horizontalSum(az));
+	}
+#endif
+
+	double milliseconds(const std::chrono::high_resolution_clock::time_point &start)
+	{
+		return std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+	}
+}
+
+NBodyCpu::NBodyCpu(uint32_t threadCount)
+{
+	if (threadCount == 0) {
+		threadCount = std::max(1u, std::thread::hardware_concurrency());
+	}
+	threadPool.reset(new vks::ThreadPool());
+	threadPool->setThreadCount(threadCount);
+}
+
+NBodyCpu::~NBodyCpu()
+{
+}
+
+uint32_t NBodyCpu::threadCount() const
+{
+	return static_cast<uint32_t>(threadPool->threads.size());
+}
+
+bool NBodyCpu::simdSupported()
+{
+#if defined(NBODY_CPU_X86) && (defined(__GNUC__) || defined(__clang__))
+	static const bool supported = __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma");
+	return supported;
+#elif defined(NBODY_CPU_X86) && defined(_MSC_VER)
+	static const bool supported = [] {
+		int info[4];
+		__cpuid(info, 0);
+		if (info[0] < 7) {
+			return false;
+		}
+		__cpuid(info, 1);
+		const bool fma = (info[2] & (1 << 12)) != 0;
+		const bool osxsave = (info[2] & (1 << 27)) != 0;
+		// The OS has to preserve the upper halves of the ymm registers
+		if (!fma || !osxsave || ((_xgetbv(0) & 0x6) != 0x6)) {
+			return false;
+		}
+		__cpuidex(info, 7, 0);
+		return (info[1] & (1 << 5)) != 0;
+	}();
+	return supported;
+#else
+	return false;
+#endif
+}
+
+NBodyCpu::PowerMode NBodyCpu::powerMode() const
+{
+	if (parameters.power == 0.75f) {
+		return PowerThreeQuarters;
+	}
+	if (parameters.power == 1.5f) {
+		return PowerThreeHalves;
+	}
+	return PowerGeneric;
+}
+
+// Distributes blocks of the range over the pool's threads, blocks are fetched on demand as the cost per element varies
+void NBodyCpu::parallelFor(uint32_t count, uint32_t blockSize, const std::function<void(uint32_t begin, uint32_t end)> &function)
+{
+	std::atomic<uint32_t> next(0);
+	for (auto &thread : threadPool->threads) {
+		thread->addJob([&] {
+			uint32_t begin;
+			while ((begin = next.fetch_add(blockSize)) < count) {
+				function(begin, std::min(begin + blockSize, count));
+			}
+		});
+	}
+	threadPool->wait();
+}
+
+void NBodyCpu::prepareSources(const std::vector<Particle> &particles)
+{
+	const size_t paddedCount = (particles.size() + 7) & ~size_t(7);
+	sourceX.assign(paddedCount, 0.0f);
+	sourceY.assign(paddedCount, 0.0f);
+	sourceZ.assign(paddedCount, 0.0f);
+	sourceMass.assign(paddedCount, 0.0f);
+	for (size_t i = 0; i < particles.size(); i++) {
+		sourceX[i] = particles[i].pos.x;
+		sourceY[i] = particles[i].pos.y;
+		sourceZ[i] = particles[i].pos.z;
+		sourceMass[i] = particles[i].pos.w;
+	}
+}
+
+void NBodyCpu::directBlock(const std::vector<Particle> &particles, const uint32_t *targets, uint32_t count, glm::vec4 *accelerations, bool simd) const
+{
+	const uint32_t sourceCount = static_cast<uint32_t>(sourceX.size());
+	const int mode = static_cast<int>(powerMode());
+	glm::vec3 sums[directBlockSize];
+	for (uint32_t i = 0; i < count; i++) {
+		sums[i] = glm::vec3(0.0f);
+	}
+	// All targets of the block go through a tile of sources before the next tile is loaded
+	for (uint32_t tile = 0; tile < sourceCount; tile += directTileSize) {
+		const uint32_t tileCount = std::min(directTileSize, sourceCount - tile);
+		for (uint32_t i = 0; i < count; i++) {
+			const glm::vec3 position(particles[targets[i]].pos);
+#if defined(NBODY_CPU_X86)
+			if (simd) {
+				accumulateAVX2(&sourceX[tile], &sourceY[tile], &sourceZ[tile], &sourceMass[tile], tileCount, position, parameters.soften, mode, sums[i]);
+				continue;
+			}
+#endif
+			accumulateScalar(&sourceX[tile], &sourceY[tile], &sourceZ[tile], &sourceMass[tile], tileCount, position, parameters.soften, parameters.power, mode, sums[i]);
+		}
+	}
+	for (uint32_t i = 0; i < count; i++) {
+		accelerations[i] = glm::vec4(sums[i] * parameters.gravity, 0.0f);
+	}
+}
+
+void NBodyCpu::buildTree(const std::vector<Particle> &particles)
+{
+	const uint32_t count = static_cast<uint32_t>(particles.size());
+
+	// Root cube enclosing all particles
+	glm::vec3 minimum(std::numeric_limits<float>::max());
+	glm::vec3 maximum(-std::numeric_limits<float>::max());
+	for (const Particle &particle : particles) {
+		minimum = glm::min(minimum, glm::vec3(particle.pos));
+		maximum = glm::max(maximum, glm::vec3(particle.pos));
+	}
+	const glm::vec3 extent = maximum - minimum;
+	const float size = std::max(std::max(extent.x, extent.y), std::max(extent.z, 1e-6f)) * 1.0001f;
+
+	// Keys store the Morton code in the upper and the particle index in the lower 32 bits
+	keys.resize(count);
+	const float scale = float(1 << treeLevels) / size;
+	parallelFor(count, 4096, [&](uint32_t begin, uint32_t end) {
+		for (uint32_t i = begin; i < end; i++) {
+			const glm::vec3 cell = glm::clamp((glm::vec3(particles[i].pos) - minimum) * scale, glm::vec3(0.0f), glm::vec3(float((1 << treeLevels) - 1)));
+			const uint32_t code = expandBits(uint32_t(cell.x)) | (expandBits(uint32_t(cell.y)) << 1) | (expandBits(uint32_t(cell.z)) << 2);
+			keys[i] = (uint64_t(code) << 32) | i;
+		}
+	});
+
+	// Sort chunks in parallel and merge them pairwise
+	const uint32_t chunkCount = std::min(threadCount(), std::max(1u, count / 4096));
+	std::vector<uint32_t> bounds(chunkCount + 1);
+	for (uint32_t i = 0; i <= chunkCount; i++) {
+		bounds[i] = uint32_t(uint64_t(count) * i / chunkCount);
+	}
+	parallelFor(chunkCount, 1, [&](uint32_t begin, uint32_t end) {
+		for (uint32_t c = begin; c < end; c++) {
+			std::sort(keys.begin() + bounds[c], keys.begin() + bounds[c + 1]);
+		}
+	});
+	for (uint32_t width = 1; width < chunkCount; width *= 2) {
+		const uint32_t pairCount = (chunkCount + 2 * width - 1) / (2 * width);
+		parallelFor(pairCount, 1, [&](uint32_t begin, uint32_t end) {
+			for (uint32_t p = begin; p < end; p++) {
+				const uint32_t first = p * 2 * width;
+				const uint32_t middle = std::min(first + width, chunkCount);
+				const uint32_t last = std::min(first + 2 * width, chunkCount);
+				if (middle < last) {
+					std::inplace_merge(keys.begin() + bounds[first], keys.begin() + bounds[middle], keys.begin() + bounds[last]);
+				}
+			}
+		});
+	}
+
+	sortedPositions.resize(count);
+	parallelFor(count, 4096, [&](uint32_t begin, uint32_t end) {
+		for (uint32_t k = begin; k < end; k++) {
+			sortedPositions[k] = particles[keys[k] & indexMask].pos;
+		}
+	});
+
+	nodes.clear();
+	nodes.reserve(std::max(1u, 2 * count / std::max(1u, parameters.leafSize)));
+	nodes.push_back(Node());
+	if (count > 0) {
+		buildNode(0, 0, count, 0, minimum, size);
+	}
+}
+
+void NBodyCpu::buildNode(uint32_t index, uint32_t first, uint32_t count, uint32_t level, const glm::vec3 &minimum, float size)
+{
+	Node node = {};
+	node.size = size;
+	node.first = first;
+	node.count = count;
+
+	float mass = 0.0f;
+	glm::vec3 weighted(0.0f);
+	if ((count <= parameters.leafSize) || (level == treeLevels)) {
+		for (uint32_t k = first; k < first + count; k++) {
+			mass += sortedPositions[k].w;
+			weighted += glm::vec3(sortedPositions[k]) * sortedPositions[k].w;
+		}
+	} else {
+		// All keys of this node share the bits above the current level, so the octants are consecutive ranges
+		const uint32_t shift = 32 + 3 * (treeLevels - 1 - level);
+		uint32_t octantFirst[8], octantCount[8];
+		uint32_t begin = first;
+		for (uint32_t octant = 0; octant < 8; octant++) {
+			const uint32_t end = static_cast<uint32_t>(std::partition_point(keys.begin() + begin, keys.begin() + first + count, [&](uint64_t key) { return ((key >> shift) & 7) <= octant; }) - keys.begin());
+			octantFirst[octant] = begin;
+			octantCount[octant] = end - begin;
+			node.childCount += (end > begin) ? 1 : 0;
+			begin = end;
+		}
+		// Children are stored next to each other, so their slots are allocated before descending
+		node.firstChild = static_cast<uint32_t>(nodes.size());
+		nodes.resize(nodes.size() + node.childCount);
+		uint32_t child = node.firstChild;
+		for (uint32_t octant = 0; octant < 8; octant++) {
+			if (octantCount[octant] == 0) {
+				continue;
+			}
+			const glm::vec3 childMinimum = minimum + glm::vec3(float(octant & 1), float((octant >> 1) & 1), float(octant >> 2)) * (size * 0.5f);
+			buildNode(child, octantFirst[octant], octantCount[octant], level + 1, childMinimum, size * 0.5f);
+			mass += nodes[child].centerOfMass.w;
+			weighted += glm::vec3(nodes[child].centerOfMass) * nodes[child].centerOfMass.w;
+			child++;
+		}
+	}
+	const glm::vec3 center = (mass > 0.0f) ? weighted / mass : minimum + glm::vec3(size * 0.5f);
+	node.centerOfMass = glm::vec4(center, mass);
+	nodes[index] = node;
+}
+
+glm::vec3 NBodyCpu::treeAcceleration(const glm::vec3 &position, uint64_t &interactions) const
+{
+	const float theta2 = parameters.theta * parameters.theta;
+	const int mode = static_cast<int>(powerMode());
+	// Every level pops one node and pushes at most eight
+	uint32_t stack[8 * (treeLevels + 1)];
+	uint32_t stackSize = 0;
+	stack[stackSize++] = 0;
+	glm::vec3 acceleration(0.0f);
+	while (stackSize > 0) {
+		const Node &node = nodes[stack[--stackSize]];
+		if (node.centerOfMass.w <= 0.0f) {
+			continue;
+		}
+		const glm::vec3 d = glm::vec3(node.centerOfMass) - position;
+		const float distance2 = glm::dot(d, d);
+		if (node.size * node.size < theta2 * distance2) {
+			acceleration += d * (node.centerOfMass.w * inversePower(distance2 + parameters.soften, parameters.power, mode));
+			interactions++;
+			continue;
+		}
+		if (node.childCount == 0) {
+			for (uint32_t k = node.first; k < node.first + node.count; k++) {
+				const glm::vec3 dk = glm::vec3(sortedPositions[k]) - position;
+				acceleration += dk * (sortedPositions[k].w * inversePower(glm::dot(dk, dk) + parameters.soften, parameters.power, mode));
+			}
+			interactions += node.count;
+			continue;
+		}
+		for (uint32_t c = 0; c < node.childCount; c++) {
+			stack[stackSize++] = node.firstChild + c;
+		}
+	}
+	return acceleration * parameters.gravity;
+}
+
+// Without a target list all particles are visited in Morton order, so neighbouring targets traverse mostly the same nodes
+void NBodyCpu::treePass(const std::vector<Particle> &particles, const uint32_t *targets, uint32_t count, glm::vec4 *accelerations)
+{
+	auto tStart = std::chrono::high_resolution_clock::now();
+	buildTree(particles);
+	statistics.buildTime = milliseconds(tStart);
+	statistics.nodeCount = static_cast<uint32_t>(nodes.size());
+
+	tStart = std::chrono::high_resolution_clock::now();
+	std::atomic<uint64_t> interactions(0);
+	parallelFor(count, 256, [&](uint32_t begin, uint32_t end) {
+		uint64_t localInteractions = 0;
+		for (uint32_t k = begin; k < end; k++) {
+			const uint32_t index = targets ? targets[k] : static_cast<uint32_t>(keys[k] & indexMask);
+			const uint32_t slot = targets ? k : index;
+			accelerations[slot] = glm::vec4(treeAcceleration(glm::vec3(particles[index].pos), localInteractions), 0.0f);
+		}
+		interactions += localInteractions;
+	});
+	statistics.forceTime = milliseconds(tStart);
+	statistics.interactions = interactions;
+}
+
+void NBodyCpu::computeAccelerations(const std::vector<Particle> &particles, std::vector<glm::vec4> &accelerations, Method method)
+{
+	const uint32_t count = static_cast<uint32_t>(particles.size());
+	if (method == MethodBarnesHut) {
+		statistics = Statistics();
+		accelerations.resize(count);
+		treePass(particles, nullptr, count, accelerations.data());
+		return;
+	}
+	std::vector<uint32_t> targets(count);
+	for (uint32_t i = 0; i < count; i++) {
+		targets[i] = i;
+	}
+	computeAccelerations(particles, targets, accelerations, method);
+}
+
+void NBodyCpu::computeAccelerations(const std::vector<Particle> &particles, const std::vector<uint32_t> &targets, std::vector<glm::vec4> &accelerations, Method method)
+{
+	const uint32_t count = static_cast<uint32_t>(targets.size());
+	statistics = Statistics();
+	accelerations.resize(count);
+	if (method == MethodBarnesHut) {
+		treePass(particles, targets.data(), count, accelerations.data());
+		return;
+	}
+	statistics.simd = simdSupported() && (powerMode() != PowerGeneric);
+	auto tStart = std::chrono::high_resolution_clock::now();
+	prepareSources(particles);
+	parallelFor(count, directBlockSize, [&](uint32_t begin, uint32_t end) {
+		directBlock(particles, &targets[begin], end - begin, &accelerations[begin], statistics.simd);
+	});
+	statistics.forceTime = milliseconds(tStart);
+	statistics.interactions = uint64_t(count) * particles.size();
+}
+
+void NBodyCpu::step(std::vector<Particle> &particles, float deltaT, Method method)
+{
+	std::vector<glm::vec4> accelerations;
+	computeAccelerations(particles, accelerations, method);
+	integrate(particles, accelerations, deltaT);
+}
+
+// Mirrors the velocity update of the calculate shaders and the integrate shader
+void NBodyCpu::integrate(std::vector<Particle> &particles, const std::vector<glm::vec4> &accelerations, float deltaT)
+{
+	for (size_t i = 0; i < particles.size(); i++) {
+		Particle &particle = particles[i];
+		particle.vel += glm::vec4(glm::vec3(accelerations[i]) * deltaT, 0.1f * deltaT);
+		if (particle.vel.w > 1.0f) {
+			particle.vel.w -= 1.0f;
+		}
+		particle.pos += glm::vec4(glm::vec3(particle.vel) * deltaT, 0.0f);
+	}
+}
+
+NBodyCpu::Error NBodyCpu::compare(const std::vector<Particle> &reference, const std::vector<Particle> &particles)
+{
+	double positionError = 0.0, positionNorm = 0.0, velocityError = 0.0, velocityNorm = 0.0;
+	const size_t count = std::min(reference.size(), particles.size());
+	for (size_t i = 0; i < count; i++) {
+		const glm::dvec3 p(glm::vec3(reference[i].pos)), v(glm::vec3(reference[i].vel));
+		const glm::dvec3 dp = p - glm::dvec3(glm::vec3(particles[i].pos));
+		const glm::dvec3 dv = v - glm::dvec3(glm::vec3(particles[i].vel));
+		positionError += glm::dot(dp, dp);
+		velocityError += glm::dot(dv, dv);
+		positionNorm += glm::dot(p, p);
+		velocityNorm += glm::dot(v, v);
+	}
+	Error error;
+	error.position = (positionNorm > 0.0) ? std::sqrt(positionError / positionNorm) : 0.0;
+	error.velocity = (velocityNorm > 0.0) ? std::sqrt(velocityError / velocityNorm) : 0.0;
+	return error;
+}
+
+double NBodyCpu::compare(const std::vector<glm::vec4> &reference, const std::vector<glm::vec4> &accelerations)
+{
+	double error = 0.0, norm = 0.0;
+	const size_t count = std::min(reference.size(), accelerations.size());
+	for (size_t i = 0; i < count; i++) {
+		const glm::dvec3 a(glm::vec3(reference[i]));
+		const glm::dvec3 d = a - glm::dvec3(glm::vec3(accelerations[i]));
+		error += glm::dot(d, d);
+		norm += glm::dot(a, a);
+	}
+	return (norm > 0.0) ? std::sqrt(error / norm) : 0.0;
+}
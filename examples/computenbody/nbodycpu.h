@@ -0,0 +1,108 @@
+/*
+* CPU N-body simulation
+*
+* Reference implementation of the force law used by the compute shaders of the N-body example
+* Offers a tiled O(N^2) direct summation (AVX2 if supported by the CPU) and a multithreaded Barnes-Hut octree
+* Used as a headless benchmark and to validate the results of the GPU simulation
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#pragma once
+
+#include <vector>
+#include <memory>
+#include <functional>
+#include <stdint.h>
+
+#define GLM_FORCE_RADIANS
+#define GLM_FORCE_DEPTH_ZERO_TO_ONE
+#include <glm/glm.hpp>
+
+namespace vks
+{
+	class ThreadPool;
+}
+
+// SSBO particle declaration, shared by the storage buffers and the CPU simulation
+struct Particle {
+	glm::vec4 pos;								// xyz = position, w = mass
+	glm::vec4 vel;								// xyz = velocity, w = gradient texture position
+};
+
+class NBodyCpu
+{
+public:
+	enum Method { MethodDirect = 0, MethodBarnesHut = 1 };
+
+	// Same force law as the compute shaders: a += gravity * d * m / (dot(d, d) + soften)^power
+	struct Parameters {
+		float gravity = 0.002f;
+		float power = 0.75f;
+		float soften = 0.05f;
+		// Barnes-Hut opening criterion, a node is approximated by its center of mass if size / distance < theta
+		float theta = 0.5f;
+		// Maximum number of particles stored in a leaf of the octree
+		uint32_t leafSize = 16;
+	} parameters;
+
+	// Timings in milliseconds of the last call to computeAccelerations
+	struct Statistics {
+		double buildTime = 0.0;
+		double forceTime = 0.0;
+		uint64_t interactions = 0;
+		uint32_t nodeCount = 0;
+		bool simd = false;
+	} statistics;
+
+	// Relative root mean square differences between two particle sets
+	struct Error {
+		double position = 0.0;
+		double velocity = 0.0;
+	};
+
+	explicit NBodyCpu(uint32_t threadCount = 0);
+	~NBodyCpu();
+
+	uint32_t threadCount() const;
+	static bool simdSupported();
+
+	void computeAccelerations(const std::vector<Particle> &particles, std::vector<glm::vec4> &accelerations, Method method);
+	void computeAccelerations(const std::vector<Particle> &particles, const std::vector<uint32_t> &targets, std::vector<glm::vec4> &accelerations, Method method);
+	void step(std::vector<Particle> &particles, float deltaT, Method method);
+
+	static void integrate(std::vector<Particle> &particles, const std::vector<glm::vec4> &accelerations, float deltaT);
+	static Error compare(const std::vector<Particle> &reference, const std::vector<Particle> &particles);
+	static double compare(const std::vector<glm::vec4> &reference, const std::vector<glm::vec4> &accelerations);
+
+private:
+	enum PowerMode { PowerGeneric, PowerThreeQuarters, PowerThreeHalves };
+
+	struct Node {
+		glm::vec4 centerOfMass;					// xyz = center of mass, w = total mass
+		float size;								// Edge length of the node's cube
+		uint32_t firstChild;
+		uint32_t childCount;					// 0 for leaves
+		uint32_t first;							// Range of the node's particles in the sorted arrays
+		uint32_t count;
+	};
+
+	std::unique_ptr<vks::ThreadPool> threadPool;
+
+	// Structure of arrays copy of the particle positions for the direct summation, padded to a multiple of the SIMD width
+	std::vector<float> sourceX, sourceY, sourceZ, sourceMass;
+
+	// Octree, particles are sorted along a Morton curve so every node covers a contiguous range
+	std::vector<Node> nodes;
+	std::vector<uint64_t> keys;
+	std::vector<glm::vec4> sortedPositions;
+
+	PowerMode powerMode() const;
+	void parallelFor(uint32_t count, uint32_t blockSize, const std::function<void(uint32_t begin, uint32_t end)> &function);
+	void prepareSources(const std::vector<Particle> &particles);
+	void buildTree(const std::vector<Particle> &particles);
+	void buildNode(uint32_t index, uint32_t first, uint32_t count, uint32_t level, const glm::vec3 &minimum, float size);
+	void directBlock(const std::vector<Particle> &particles, const uint32_t *targets, uint32_t count, glm::vec4 *accelerations, bool simd) const;
+	glm::vec3 treeAcceleration(const glm::vec3 &position, uint64_t &interactions) const;
+	void treePass(const std::vector<Particle> &particles, const uint32_t *targets, uint32_t count, glm::vec4 *accelerations);
+};
@@ -1,6 +1,14 @@
 /*
 * Vulkan Example - Deferred shading with multiple render targets (aka G-Buffer) example
 *
+* Lights are binned into clusters (screen tiles x exponential depth slices) by compute shaders every frame, shading only
+* loops over the lights of the cluster a pixel falls into. The same clusters are used by the deferred composition and by
+* an optional forward+ path that shades the scene directly
+*
+* The G-buffer comes in two layouts: the full one stores world space positions and normals at 16 bit per channel, the
+* compact one reconstructs positions from depth, stores octahedral encoded normals in 10 bit channels and leaves the
+* specular intensity packed into the albedo alpha, which halves the bytes written and read per pixel
+*
 * Copyright (C) 2016 by Sascha Willems - www.saschawillems.de
 *
 * This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
@@ -8,20 +16,33 @@
 
 #include "vulkanexamplebase.h"
 #include "VulkanglTFModel.h"
+#include "VulkanRenderGraph.h"
 
 #define ENABLE_VALIDATION false
 
-// Texture properties
-#define TEX_DIM 2048
-#define TEX_FILTER VK_FILTER_LINEAR
-
-// Offscreen frame buffer properties
-#define FB_DIM TEX_DIM
+#define CLUSTER_GRID_X 16
+#define CLUSTER_GRID_Y 9
+#define CLUSTER_GRID_Z 24
+#define MAX_LIGHT_COUNT 65536
+// Capacity of the compact light index list shared by all clusters, clusters past it are shaded with fewer lights
+#define MAX_LIGHT_INDICES (1 << 21)
 
 class VulkanExample : public VulkanExampleBase
 {
 public:
+	enum ShadingPath { ShadingDeferred = 0, ShadingForward = 1 };
+	enum GBufferLayout { GBufferFull = 0, GBufferCompact = 1 };
+
 	int32_t debugDisplayTarget = 0;
+	int32_t shadingPath = ShadingDeferred;
+	int32_t gbufferLayout = GBufferFull;
+	// Depth is read back as an input attachment with the compact layout, which requires a format without stencil
+	VkFormat sceneDepthFormat = VK_FORMAT_UNDEFINED;
+	int32_t lightCountIndex = 3;
+	const std::vector<uint32_t> lightCounts = { 64, 256, 1024, 4096, 16384, MAX_LIGHT_COUNT };
+	// Slices are distributed exponentially between these depths, the first slice also covers everything in front of it
+	const float clusterNear = 0.5f;
+	const float clusterFar = 256.0f;
 
 	struct {
 		struct {
@@ -46,59 +67,81 @@ public:
 		glm::vec4 instancePos[3];
 	} uboOffscreenVS;
 
-	struct Light {
-		glm::vec4 position;
-		glm::vec3 color;
-		float radius;
+	// Base state of a light, animated into the light buffer by a compute shader
+	struct LightSource {
+		glm::vec4 position;		// xyz = base position, w = radius
+		glm::vec4 color;		// rgb = color, w = phase
 	};
 
+	// Shared by the light animation, the light binning and the shading passes
 	struct {
-		Light lights[6];
+		glm::mat4 view;
+		glm::mat4 projection;
 		glm::vec4 viewPos;
-		int debugDisplayTarget = 0;
-	} uboComposition;
+		glm::uvec4 gridSize;	// xyz = cluster count, w = light count
+		glm::vec4 sliceParams;	// x = slice scale, y = slice bias, z = near plane, w = far plane
+		glm::vec2 screenSize;
+		float radiusScale;
+		float time;
+		int32_t debugDisplayTarget;
+		uint32_t maxLightIndices;
+	} uboLighting;
 
 	struct {
 		vks::Buffer offscreen;
-		vks::Buffer composition;
+		vks::Buffer lighting;
 	} uniformBuffers;
 
 	struct {
-		VkPipeline offscreen;
-		VkPipeline composition;
+		vks::Buffer lightSources;
+		vks::Buffer lights;
+		// View space minimum and maximum corner of every cluster, only changes with the projection
+		vks::Buffer clusterBounds;
+		vks::Buffer clusterCounts;
+		// First light index and light count of every cluster
+		vks::Buffer clusterGrid;
+		vks::Buffer lightIndices;
+		vks::Buffer statistics;
+	} clusterBuffers;
+
+	// Written by the prefix sum, read back after the frame
+	struct {
+		uint32_t requiredLightIndices = 0;
+		uint32_t maxClusterLights = 0;
+	} clusterStatistics;
+
+	struct {
+		VkPipeline offscreen = VK_NULL_HANDLE;
+		VkPipeline composition = VK_NULL_HANDLE;
+		VkPipeline forward;
+		VkPipeline lights;
+		VkPipeline clusterCount;
+		VkPipeline clusterOffsets;
+		VkPipeline clusterAssign;
 	} pipelines;
-	VkPipelineLayout pipelineLayout;
+
+	struct {
+		VkPipelineLayout scene;
+		VkPipelineLayout composition;
+		VkPipelineLayout forward;
+		VkPipelineLayout clusters;
+	} pipelineLayouts;
 
 	struct {
 		VkDescriptorSet model;
 		VkDescriptorSet floor;
+		VkDescriptorSet composition;
+		VkDescriptorSet clusters;
 	} descriptorSets;
 
-	VkDescriptorSet descriptorSet;
-	VkDescriptorSetLayout descriptorSetLayout;
-
-	// Framebuffer for offscreen rendering
-	struct FrameBufferAttachment {
-		VkImage image;
-		VkDeviceMemory mem;
-		VkImageView view;
-		VkFormat format;
-	};
-	struct FrameBuffer {
-		int32_t width, height;
-		VkFramebuffer frameBuffer;
-		FrameBufferAttachment position, normal, albedo;
-		FrameBufferAttachment depth;
-		VkRenderPass renderPass;
-	} offScreenFrameBuf;
-
-	// One sampler for the frame buffer color attachments
-	VkSampler colorSampler;
-
-	VkCommandBuffer offScreenCmdBuffer = VK_NULL_HANDLE;
+	struct {
+		VkDescriptorSetLayout scene;
+		VkDescriptorSetLayout composition;
+		VkDescriptorSetLayout clusters;
+	} descriptorSetLayouts;
 
-	// Semaphore used to synchronize between offscreen and final scene rendering
-	VkSemaphore offscreenSemaphore = VK_NULL_HANDLE;
+	// Owns the G-buffer attachments and the render pass shared by the G-buffer and the composition pass
+	vks::RenderGraph renderGraph;
 
 	VulkanExample() : VulkanExampleBase(ENABLE_VALIDATION)
 	{
@@ -111,6 +154,12 @@ public:
 		camera.position = { 2.15f, 0.3f, -8.75f };
 		camera.setRotation(glm::vec3(-0.75f, 12.5f, 0.0f));
 		camera.setPerspective(60.0f, (float)width / (float)height, 0.1f, 256.0f);
+
+		commandLineParser.add("compactgbuffer", { "-cg", "--compactgbuffer" }, 0, "Start with the compact G-buffer layout");
+		commandLineParser.parse(args);
+		if (commandLineParser.isSet("compactgbuffer")) {
+			gbufferLayout = GBufferCompact;
+		}
 	}
 
 	~VulkanExample()
@@ -118,49 +167,41 @@ public:
 		// Clean up used Vulkan resources
 		// Note : Inherited destructor cleans up resources stored in base class
 
-		vkDestroySampler(device, colorSampler, nullptr);
-
-		// Frame buffer
-
-		// Color attachments
-		vkDestroyImageView(device, offScreenFrameBuf.position.view, nullptr);
-		vkDestroyImage(device, offScreenFrameBuf.position.image, nullptr);
-		vkFreeMemory(device, offScreenFrameBuf.position.mem, nullptr);
-
-		vkDestroyImageView(device, offScreenFrameBuf.normal.view, nullptr);
-		vkDestroyImage(device, offScreenFrameBuf.normal.image, nullptr);
-		vkFreeMemory(device, offScreenFrameBuf.normal.mem, nullptr);
-
-		vkDestroyImageView(device, offScreenFrameBuf.albedo.view, nullptr);
-		vkDestroyImage(device, offScreenFrameBuf.albedo.image, nullptr);
-		vkFreeMemory(device, offScreenFrameBuf.albedo.mem, nullptr);
-
-		// Depth attachment
-		vkDestroyImageView(device, offScreenFrameBuf.depth.view, nullptr);
-		vkDestroyImage(device, offScreenFrameBuf.depth.image, nullptr);
-		vkFreeMemory(device, offScreenFrameBuf.depth.mem, nullptr);
-
-		vkDestroyFramebuffer(device, offScreenFrameBuf.frameBuffer, nullptr);
+		renderGraph.destroy();
 
 		vkDestroyPipeline(device, pipelines.composition, nullptr);
 		vkDestroyPipeline(device, pipelines.offscreen, nullptr);
+		vkDestroyPipeline(device, pipelines.forward, nullptr);
+		vkDestroyPipeline(device, pipelines.lights, nullptr);
+		vkDestroyPipeline(device, pipelines.clusterCount, nullptr);
+		vkDestroyPipeline(device, pipelines.clusterOffsets, nullptr);
+		vkDestroyPipeline(device, pipelines.clusterAssign, nullptr);
 
-		vkDestroyPipelineLayout(device, pipelineLayout, nullptr);
+		vkDestroyPipelineLayout(device, pipelineLayouts.scene, nullptr);
+		vkDestroyPipelineLayout(device, pipelineLayouts.composition, nullptr);
+		vkDestroyPipelineLayout(device, pipelineLayouts.forward, nullptr);
+		vkDestroyPipelineLayout(device, pipelineLayouts.clusters, nullptr);
 
-		vkDestroyDescriptorSetLayout(device, descriptorSetLayout, nullptr);
+		vkDestroyDescriptorSetLayout(device, descriptorSetLayouts.scene, nullptr);
+		vkDestroyDescriptorSetLayout(device, descriptorSetLayouts.composition, nullptr);
+		vkDestroyDescriptorSetLayout(device, descriptorSetLayouts.clusters, nullptr);
 
 		// Uniform buffers
 		uniformBuffers.offscreen.destroy();
-		uniformBuffers.composition.destroy();
+		uniformBuffers.lighting.destroy();
 
-		vkDestroyRenderPass(device, offScreenFrameBuf.renderPass, nullptr);
+		clusterBuffers.lightSources.destroy();
+		clusterBuffers.lights.destroy();
+		clusterBuffers.clusterBounds.destroy();
+		clusterBuffers.clusterCounts.destroy();
+		clusterBuffers.clusterGrid.destroy();
+		clusterBuffers.lightIndices.destroy();
+		clusterBuffers.statistics.destroy();
 
 		textures.model.colorMap.destroy();
 		textures.model.normalMap.destroy();
 		textures.floor.colorMap.destroy();
 		textures.floor.normalMap.destroy();
-
-		vkDestroySemaphore(device, offscreenSemaphore, nullptr);
 	}
 
 	// Enable physical device features required for this example
@@ -172,265 +213,219 @@ public:
 		}
 	};
 
-	// Create a frame buffer attachment
-	void createAttachment(
-		VkFormat format,
-		VkImageUsageFlagBits usage,
-		FrameBufferAttachment *attachment)
+	uint32_t lightCount() const
 	{
-		VkImageAspectFlags aspectMask = 0;
-		VkImageLayout imageLayout;
+		return lightCounts[lightCountIndex];
+	}
 
-		attachment->format = format;
+	// Color attachments of a G-buffer layout, the depth attachment is used by both
+	std::vector<VkFormat> gbufferColorFormats(int32_t layout) const
+	{
+		if (layout == GBufferCompact) {
+			// Octahedral encoded normal, albedo with the specular intensity in alpha
+			return { VK_FORMAT_A2B10G10R10_UNORM_PACK32, VK_FORMAT_R8G8B8A8_UNORM };
+		}
+		// World space position, world space normal, albedo with the specular intensity in alpha
+		return { VK_FORMAT_R16G16B16A16_SFLOAT, VK_FORMAT_R16G16B16A16_SFLOAT, VK_FORMAT_R8G8B8A8_UNORM };
+	}
 
-		if (usage & VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT)
-		{
-			aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-			imageLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+	// Bytes the G-buffer pass writes and the composition reads in one frame at the current resolution
+	// With the subpasses merged and the attachments transient, tiling GPUs may keep all of this in tile memory
+	VkDeviceSize gbufferFrameBytes(int32_t layout) const
+	{
+		uint32_t bytesPerPixel = vks::tools::formatSize(sceneDepthFormat);
+		if (layout == GBufferCompact) {
+			bytesPerPixel *= 2;
 		}
-		if (usage & VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT)
-		{
-			aspectMask = VK_IMAGE_ASPECT_DEPTH_BIT;
-			if (format >= VK_FORMAT_D16_UNORM_S8_UINT)
-				aspectMask |=VK_IMAGE_ASPECT_STENCIL_BIT;
-			imageLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+		for (auto format : gbufferColorFormats(layout)) {
+			bytesPerPixel += vks::tools::formatSize(format) * 2;
 		}
-
-		assert(aspectMask > 0);
-
-		VkImageCreateInfo image = vks::initializers::imageCreateInfo();
-		image.imageType = VK_IMAGE_TYPE_2D;
-		image.format = format;
-		image.extent.width = offScreenFrameBuf.width;
-		image.extent.height = offScreenFrameBuf.height;
-		image.extent.depth = 1;
-		image.mipLevels = 1;
-		image.arrayLayers = 1;
-		image.samples = VK_SAMPLE_COUNT_1_BIT;
-		image.tiling = VK_IMAGE_TILING_OPTIMAL;
-		image.usage = usage | VK_IMAGE_USAGE_SAMPLED_BIT;
-
-		VkMemoryAllocateInfo memAlloc = vks::initializers::memoryAllocateInfo();
-		VkMemoryRequirements memReqs;
-
-		VK_CHECK_RESULT(vkCreateImage(device, &image, nullptr, &attachment->image));
-		vkGetImageMemoryRequirements(device, attachment->image, &memReqs);
-		memAlloc.allocationSize = memReqs.size;
-		memAlloc.memoryTypeIndex = vulkanDevice->getMemoryType(memReqs.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
-		VK_CHECK_RESULT(vkAllocateMemory(device, &memAlloc, nullptr, &attachment->mem));
-		VK_CHECK_RESULT(vkBindImageMemory(device, attachment->image, attachment->mem, 0));
-
-		VkImageViewCreateInfo imageView = vks::initializers::imageViewCreateInfo();
-		imageView.viewType = VK_IMAGE_VIEW_TYPE_2D;
-		imageView.format = format;
-		imageView.subresourceRange = {};
-		imageView.subresourceRange.aspectMask = aspectMask;
-		imageView.subresourceRange.baseMipLevel = 0;
-		imageView.subresourceRange.levelCount = 1;
-		imageView.subresourceRange.baseArrayLayer = 0;
-		imageView.subresourceRange.layerCount = 1;
-		imageView.image = attachment->image;
-		VK_CHECK_RESULT(vkCreateImageView(device, &imageView, nullptr, &attachment->view));
+		return static_cast<VkDeviceSize>(bytesPerPixel) * width * height;
 	}
 
-	// Prepare a new framebuffer and attachments for offscreen rendering (G-Buffer)
-	void prepareOffscreenFramebuffer()
+	// Light binning runs in compute passes ahead of the shading passes, the graph derives the barriers between them.
+	// With deferred shading the G-buffer is written by the first pass and read at the same pixel by the composition as
+	// input attachments, so the graph merges both into subpasses of a single render pass and the G-buffer never has to leave tile memory
+	void prepareRenderGraph()
 	{
-		offScreenFrameBuf.width = FB_DIM;
-		offScreenFrameBuf.height = FB_DIM;
-
-		// Color attachments
-
-		// (World space) Positions
-		createAttachment(
-			VK_FORMAT_R16G16B16A16_SFLOAT,
-			VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT,
-			&offScreenFrameBuf.position);
-
-		// (World space) Normals
-		createAttachment(
-			VK_FORMAT_R16G16B16A16_SFLOAT,
-			VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT,
-			&offScreenFrameBuf.normal);
-
-		// Albedo (color)
-		createAttachment(
-			VK_FORMAT_R8G8B8A8_UNORM,
-			VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT,
-			&offScreenFrameBuf.albedo);
-
-		// Depth attachment
-
-		// Find a suitable depth format
-		VkFormat attDepthFormat;
-		VkBool32 validDepthFormat = vks::tools::getSupportedDepthFormat(physicalDevice, &attDepthFormat);
-		assert(validDepthFormat);
-
-		createAttachment(
-			attDepthFormat,
-			VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT,
-			&offScreenFrameBuf.depth);
-
-		// Set up separate renderpass with references to the color and depth attachments
-		std::array<VkAttachmentDescription, 4> attachmentDescs = {};
-
-		// Init attachment properties
-		for (uint32_t i = 0; i < 4; ++i)
-		{
-			attachmentDescs[i].samples = VK_SAMPLE_COUNT_1_BIT;
-			attachmentDescs[i].loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
-			attachmentDescs[i].storeOp = VK_ATTACHMENT_STORE_OP_STORE;
-			attachmentDescs[i].stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
-			attachmentDescs[i].stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
-			if (i == 3)
-			{
-				attachmentDescs[i].initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-				attachmentDescs[i].finalLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+		renderGraph.reset();
+
+		// With the compact layout the position is reconstructed from depth instead of being stored
+		const std::vector<std::string> gbufferNames = (gbufferLayout == GBufferCompact) ? std::vector<std::string>{ "normal", "albedo" } : std::vector<std::string>{ "position", "normal", "albedo" };
+		const std::vector<VkFormat> gbufferFormats = gbufferColorFormats(gbufferLayout);
+
+		vks::RenderGraph::ImageInfo imageInfo;
+		if (shadingPath == ShadingDeferred) {
+			for (size_t i = 0; i < gbufferNames.size(); i++) {
+				imageInfo.format = gbufferFormats[i];
+				renderGraph.addImage(gbufferNames[i], imageInfo);
 			}
-			else
-			{
-				attachmentDescs[i].initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-				attachmentDescs[i].finalLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+		}
+		imageInfo.format = sceneDepthFormat;
+		imageInfo.clearValue.depthStencil = { 1.0f, 0 };
+		renderGraph.addImage("depth", imageInfo);
+
+		std::vector<VkImage> swapChainImages;
+		std::vector<VkImageView> swapChainViews;
+		for (auto &buffer : swapChain.buffers) {
+			swapChainImages.push_back(buffer.image);
+			swapChainViews.push_back(buffer.view);
+		}
+		VkClearValue clearValue;
+		clearValue.color = { { 0.0f, 0.0f, 0.2f, 0.0f } };
+		renderGraph.importImage("swapchain", swapChain.colorFormat, { width, height }, swapChainImages, swapChainViews, VK_IMAGE_LAYOUT_PRESENT_SRC_KHR, clearValue);
+		renderGraph.addOutput("swapchain");
+
+		renderGraph.importBuffer("lights", clusterBuffers.lights.buffer);
+		renderGraph.importBuffer("clusterCounts", clusterBuffers.clusterCounts.buffer);
+		renderGraph.importBuffer("clusterGrid", clusterBuffers.clusterGrid.buffer);
+		renderGraph.importBuffer("lightIndices", clusterBuffers.lightIndices.buffer);
+
+		renderGraph.addComputePass("lights")
+			.addStorageOutput("lights")
+			.setRecordFunction([this](VkCommandBuffer commandBuffer) {
+				// The graph only orders accesses within a frame, the cluster buffers are also written and read by the previous one
+				VkMemoryBarrier memoryBarrier = vks::initializers::memoryBarrier();
+				memoryBarrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT | VK_ACCESS_TRANSFER_WRITE_BIT;
+				memoryBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+				vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT | VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1, &memoryBarrier, 0, nullptr, 0, nullptr);
+				vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipelines.lights);
+				vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipelineLayouts.clusters, 0, 1, &descriptorSets.clusters, 0, nullptr);
+				vkCmdDispatch(commandBuffer, (lightCount() + 63) / 64, 1, 1);
+			});
+
+		// Binning is light centric: every light visits the clusters its bounding box covers, first counting, then filling the ranges
+		renderGraph.addComputePass("clusterCount")
+			.addStorageInput("lights")
+			.addStorageOutput("clusterCounts")
+			.setRecordFunction([this](VkCommandBuffer commandBuffer) {
+				vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipelines.clusterCount);
+				vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipelineLayouts.clusters, 0, 1, &descriptorSets.clusters, 0, nullptr);
+				vkCmdDispatch(commandBuffer, (lightCount() + 63) / 64, 1, 1);
+			});
+
+		renderGraph.addComputePass("clusterOffsets")
+			.addStorageInput("clusterCounts")
+			.addStorageOutput("clusterGrid")
+			.setRecordFunction([this](VkCommandBuffer commandBuffer) {
+				vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipelines.clusterOffsets);
+				vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipelineLayouts.clusters, 0, 1, &descriptorSets.clusters, 0, nullptr);
+				vkCmdDispatch(commandBuffer, 1, 1, 1);
+				// The statistics are read on the host after the frame and are not tracked by the graph
+				VkBufferMemoryBarrier bufferBarrier = vks::initializers::bufferMemoryBarrier();
+				bufferBarrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+				bufferBarrier.dstAccessMask = VK_ACCESS_HOST_READ_BIT;
+				bufferBarrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+				bufferBarrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+				bufferBarrier.buffer = clusterBuffers.statistics.buffer;
+				bufferBarrier.size = VK_WHOLE_SIZE;
+				vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_HOST_BIT, 0, 0, nullptr, 1, &bufferBarrier, 0, nullptr);
+			});
+
+		renderGraph.addComputePass("clusterAssign")
+			.addStorageInput("lights")
+			.addStorageInput("clusterGrid")
+			.addStorageOutput("clusterCounts")
+			.addStorageOutput("lightIndices")
+			.setRecordFunction([this](VkCommandBuffer commandBuffer) {
+				vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipelines.clusterAssign);
+				vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipelineLayouts.clusters, 0, 1, &descriptorSets.clusters, 0, nullptr);
+				vkCmdDispatch(commandBuffer, (lightCount() + 63) / 64, 1, 1);
+			});
+
+		if (shadingPath == ShadingDeferred) {
+			vks::RenderGraph::Pass &gbufferPass = renderGraph.addGraphicsPass("gbuffer");
+			for (auto &name : gbufferNames) {
+				gbufferPass.addColorOutput(name);
 			}
+			gbufferPass.setDepthStencilOutput("depth")
+				.setRecordFunction([this](VkCommandBuffer commandBuffer) {
+					vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelines.offscreen);
+					drawScene(commandBuffer, pipelineLayouts.scene);
+				});
+
+			// Input attachment indices follow the order of the inputs, the first one is the position or the depth it is reconstructed from
+			vks::RenderGraph::Pass &compositionPass = renderGraph.addGraphicsPass("composition");
+			if (gbufferLayout == GBufferCompact) {
+				compositionPass.addAttachmentInput("depth");
+			}
+			for (auto &name : gbufferNames) {
+				compositionPass.addAttachmentInput(name);
+			}
+			compositionPass.addStorageInput("lights", VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT)
+				.addStorageInput("clusterGrid", VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT)
+				.addStorageInput("lightIndices", VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT)
+				.addColorOutput("swapchain")
+				.setRecordFunction([this](VkCommandBuffer commandBuffer) {
+					std::array<VkDescriptorSet, 2> sets = { descriptorSets.composition, descriptorSets.clusters };
+					vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayouts.composition, 0, static_cast<uint32_t>(sets.size()), sets.data(), 0, nullptr);
+					vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelines.composition);
+					// Final composition as full screen triangle
+					// Note: Also used for debug display if debugDisplayTarget > 0
+					vkCmdDraw(commandBuffer, 3, 1, 0, 0);
+
+					drawUI(commandBuffer);
+				});
+		} else {
+			// Forward+ shades every rasterized fragment, including the ones that are overdrawn later
+			renderGraph.addGraphicsPass("forward")
+				.addStorageInput("lights", VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT)
+				.addStorageInput("clusterGrid", VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT)
+				.addStorageInput("lightIndices", VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT)
+				.addColorOutput("swapchain")
+				.setDepthStencilOutput("depth")
+				.setRecordFunction([this](VkCommandBuffer commandBuffer) {
+					vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelines.forward);
+					vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayouts.forward, 1, 1, &descriptorSets.clusters, 0, nullptr);
+					drawScene(commandBuffer, pipelineLayouts.forward);
+
+					drawUI(commandBuffer);
+				});
 		}
 
-		// Formats
-		attachmentDescs[0].format = offScreenFrameBuf.position.format;
-		attachmentDescs[1].format = offScreenFrameBuf.normal.format;
-		attachmentDescs[2].format = offScreenFrameBuf.albedo.format;
-		attachmentDescs[3].format = offScreenFrameBuf.depth.format;
-
-		std::vector<VkAttachmentReference> colorReferences;
-		colorReferences.push_back({ 0, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL });
-		colorReferences.push_back({ 1, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL });
-		colorReferences.push_back({ 2, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL });
-
-		VkAttachmentReference depthReference = {};
-		depthReference.attachment = 3;
-		depthReference.layout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
-
-		VkSubpassDescription subpass = {};
-		subpass.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
-		subpass.pColorAttachments = colorReferences.data();
-		subpass.colorAttachmentCount = static_cast<uint32_t>(colorReferences.size());
-		subpass.pDepthStencilAttachment = &depthReference;
-
-		// Use subpass dependencies for attachment layout transitions
-		std::array<VkSubpassDependency, 2> dependencies;
-
-		dependencies[0].srcSubpass = VK_SUBPASS_EXTERNAL;
-		dependencies[0].dstSubpass = 0;
-		dependencies[0].srcStageMask = VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT;
-		dependencies[0].dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
-		dependencies[0].srcAccessMask = VK_ACCESS_MEMORY_READ_BIT;
-		dependencies[0].dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
-		dependencies[0].dependencyFlags = VK_DEPENDENCY_BY_REGION_BIT;
-
-		dependencies[1].srcSubpass = 0;
-		dependencies[1].dstSubpass = VK_SUBPASS_EXTERNAL;
-		dependencies[1].srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
-		dependencies[1].dstStageMask = VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT;
-		dependencies[1].srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
-		dependencies[1].dstAccessMask = VK_ACCESS_MEMORY_READ_BIT;
-		dependencies[1].dependencyFlags = VK_DEPENDENCY_BY_REGION_BIT;
-
-		VkRenderPassCreateInfo renderPassInfo = {};
-		renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
-		renderPassInfo.pAttachments = attachmentDescs.data();
-		renderPassInfo.attachmentCount = static_cast<uint32_t>(attachmentDescs.size());
-		renderPassInfo.subpassCount = 1;
-		renderPassInfo.pSubpasses = &subpass;
-		renderPassInfo.dependencyCount = 2;
-		renderPassInfo.pDependencies = dependencies.data();
-
-		VK_CHECK_RESULT(vkCreateRenderPass(device, &renderPassInfo, nullptr, &offScreenFrameBuf.renderPass));
-
-		std::array<VkImageView,4> attachments;
-		attachments[0] = offScreenFrameBuf.position.view;
-		attachments[1] = offScreenFrameBuf.normal.view;
-		attachments[2] = offScreenFrameBuf.albedo.view;
-		attachments[3] = offScreenFrameBuf.depth.view;
-
-		VkFramebufferCreateInfo fbufCreateInfo = {};
-		fbufCreateInfo.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
-		fbufCreateInfo.pNext = NULL;
-		fbufCreateInfo.renderPass = offScreenFrameBuf.renderPass;
-		fbufCreateInfo.pAttachments = attachments.data();
-		fbufCreateInfo.attachmentCount = static_cast<uint32_t>(attachments.size());
-		fbufCreateInfo.width = offScreenFrameBuf.width;
-		fbufCreateInfo.height = offScreenFrameBuf.height;
-		fbufCreateInfo.layers = 1;
-		VK_CHECK_RESULT(vkCreateFramebuffer(device, &fbufCreateInfo, nullptr, &offScreenFrameBuf.frameBuffer));
-
-		// Create sampler to sample from the color attachments
-		VkSamplerCreateInfo sampler = vks::initializers::samplerCreateInfo();
-		sampler.magFilter = VK_FILTER_NEAREST;
-		sampler.minFilter = VK_FILTER_NEAREST;
-		sampler.mipmapMode = VK_SAMPLER_MIPMAP_MODE_LINEAR;
-		sampler.addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
-		sampler.addressModeV = sampler.addressModeU;
-		sampler.addressModeW = sampler.addressModeU;
-		sampler.mipLodBias = 0.0f;
-		sampler.maxAnisotropy = 1.0f;
-		sampler.minLod = 0.0f;
-		sampler.maxLod = 1.0f;
-		sampler.borderColor = VK_BORDER_COLOR_FLOAT_OPAQUE_WHITE;
-		VK_CHECK_RESULT(vkCreateSampler(device, &sampler, nullptr, &colorSampler));
+		renderGraph.compile({ width, height });
 	}
 
-	// Build command buffer for rendering the scene to the offscreen frame buffer attachments
-	void buildDeferredCommandBuffer()
+	void drawScene(VkCommandBuffer commandBuffer, VkPipelineLayout pipelineLayout)
 	{
-		if (offScreenCmdBuffer == VK_NULL_HANDLE)
-		{
-			offScreenCmdBuffer = vulkanDevice->createCommandBuffer(VK_COMMAND_BUFFER_LEVEL_PRIMARY, false);
-		}
-
-		// Create a semaphore used to synchronize offscreen rendering and usage
-		VkSemaphoreCreateInfo semaphoreCreateInfo = vks::initializers::semaphoreCreateInfo();
-		VK_CHECK_RESULT(vkCreateSemaphore(device, &semaphoreCreateInfo, nullptr, &offscreenSemaphore));
-
-		VkCommandBufferBeginInfo cmdBufInfo = vks::initializers::commandBufferBeginInfo();
-
-		// Clear values for all attachments written in the fragment shader
-		std::array<VkClearValue,4> clearValues;
-		clearValues[0].color = { { 0.0f, 0.0f, 0.0f, 0.0f } };
-		clearValues[1].color = { { 0.0f, 0.0f, 0.0f, 0.0f } };
-		clearValues[2].color = { { 0.0f, 0.0f, 0.0f, 0.0f } };
-		clearValues[3].depthStencil = { 1.0f, 0 };
-
-		VkRenderPassBeginInfo renderPassBeginInfo = vks::initializers::renderPassBeginInfo();
-		renderPassBeginInfo.renderPass =  offScreenFrameBuf.renderPass;
-		renderPassBeginInfo.framebuffer = offScreenFrameBuf.frameBuffer;
-		renderPassBeginInfo.renderArea.extent.width = offScreenFrameBuf.width;
-		renderPassBeginInfo.renderArea.extent.height = offScreenFrameBuf.height;
-		renderPassBeginInfo.clearValueCount = static_cast<uint32_t>(clearValues.size());
-		renderPassBeginInfo.pClearValues = clearValues.data();
-
-		VK_CHECK_RESULT(vkBeginCommandBuffer(offScreenCmdBuffer, &cmdBufInfo));
-
-		vkCmdBeginRenderPass(offScreenCmdBuffer, &renderPassBeginInfo, VK_SUBPASS_CONTENTS_INLINE);
-
-		VkViewport viewport = vks::initializers::viewport((float)offScreenFrameBuf.width, (float)offScreenFrameBuf.height, 0.0f, 1.0f);
-		vkCmdSetViewport(offScreenCmdBuffer, 0, 1, &viewport);
-
-		VkRect2D scissor = vks::initializers::rect2D(offScreenFrameBuf.width, offScreenFrameBuf.height, 0, 0);
-		vkCmdSetScissor(offScreenCmdBuffer, 0, 1, &scissor);
-
-		vkCmdBindPipeline(offScreenCmdBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelines.offscreen);
-
 		// Background
-		vkCmdBindDescriptorSets(offScreenCmdBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 0, 1, &descriptorSets.floor, 0, nullptr);
-		models.floor.draw(offScreenCmdBuffer);
+		vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 0, 1, &descriptorSets.floor, 0, nullptr);
+		models.floor.draw(commandBuffer);
 
 		// Instanced object
-		vkCmdBindDescriptorSets(offScreenCmdBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 0, 1, &descriptorSets.model, 0, nullptr);
-		models.model.bindBuffers(offScreenCmdBuffer);
-		vkCmdDrawIndexed(offScreenCmdBuffer, models.model.indices.count, 3, 0, 0, 0);
+		vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 0, 1, &descriptorSets.model, 0, nullptr);
+		models.model.bindBuffers(commandBuffer);
+		vkCmdDrawIndexed(commandBuffer, models.model.indices.count, 3, 0, 0, 0);
+	}
 
-		vkCmdEndRenderPass(offScreenCmdBuffer);
+	// The UI is drawn by the last pass of the shading path instead of the base class render pass
+	void prepareUIPipeline()
+	{
+		if (!settings.overlay) {
+			return;
+		}
+		const std::string pass = (shadingPath == ShadingDeferred) ? "composition" : "forward";
+		vkDestroyPipeline(device, UIOverlay.pipeline, nullptr);
+		vkDestroyPipelineLayout(device, UIOverlay.pipelineLayout, nullptr);
+		UIOverlay.subpass = renderGraph.subpass(pass);
+		UIOverlay.preparePipeline(pipelineCache, renderGraph.renderPass(pass), swapChain.colorFormat, sceneDepthFormat);
+	}
 
-		VK_CHECK_RESULT(vkEndCommandBuffer(offScreenCmdBuffer));
+	// The swapchain is recreated on resize, the graph imports its images and sizes the G-buffer relative to it
+	virtual void setupFrameBuffer()
+	{
+		VulkanExampleBase::setupFrameBuffer();
+		if (renderGraph.isCompiled()) {
+			prepareRenderGraph();
+			updateCompositionDescriptorSet();
+		}
+	}
+
+	// Cluster bounds and the screen size depend on the projection
+	virtual void windowResized()
+	{
+		updateClusterBounds();
+		updateUniformBufferLighting();
 	}
 
 	void loadAssets()
@@ -448,43 +443,12 @@ public:
 	{
 		VkCommandBufferBeginInfo cmdBufInfo = vks::initializers::commandBufferBeginInfo();
 
-		VkClearValue clearValues[2];
-		clearValues[0].color = { { 0.0f, 0.0f, 0.2f, 0.0f } };
-		clearValues[1].depthStencil = { 1.0f, 0 };
-
-		VkRenderPassBeginInfo renderPassBeginInfo = vks::initializers::renderPassBeginInfo();
-		renderPassBeginInfo.renderPass = renderPass;
-		renderPassBeginInfo.renderArea.offset.x = 0;
-		renderPassBeginInfo.renderArea.offset.y = 0;
-		renderPassBeginInfo.renderArea.extent.width = width;
-		renderPassBeginInfo.renderArea.extent.height = height;
-		renderPassBeginInfo.clearValueCount = 2;
-		renderPassBeginInfo.pClearValues = clearValues;
-
 		for (int32_t i = 0; i < drawCmdBuffers.size(); ++i)
 		{
-			renderPassBeginInfo.framebuffer = frameBuffers[i];
-
 			VK_CHECK_RESULT(vkBeginCommandBuffer(drawCmdBuffers[i], &cmdBufInfo));
 
-			vkCmdBeginRenderPass(drawCmdBuffers[i], &renderPassBeginInfo, VK_SUBPASS_CONTENTS_INLINE);
-
-			VkViewport viewport = vks::initializers::viewport((float)width, (float)height, 0.0f, 1.0f);
-			vkCmdSetViewport(drawCmdBuffers[i], 0, 1, &viewport);
-
-			VkRect2D scissor = vks::initializers::rect2D(width, height, 0, 0);
-			vkCmdSetScissor(drawCmdBuffers[i], 0, 1, &scissor);
-
-			vkCmdBindDescriptorSets(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 0, 1, &descriptorSet, 0, nullptr);
-
-   			vkCmdBindPipeline(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pipelines.composition);
-			// Final composition as full screen quad
-			// Note: Also used for debug display if debugDisplayTarget > 0
-			vkCmdDraw(drawCmdBuffers[i], 3, 1, 0, 0);
-
-			drawUI(drawCmdBuffers[i]);
-
-			vkCmdEndRenderPass(drawCmdBuffers[i]);
+			// Command buffers are indexed like the swapchain images, which selects the framebuffer of the composition pass
+			renderGraph.execute(drawCmdBuffers[i], i);
 
 			VK_CHECK_RESULT(vkEndCommandBuffer(drawCmdBuffers[i]));
 		}
@@ -494,76 +458,133 @@ public:
 	{
 		std::vector<VkDescriptorPoolSize> poolSizes = {
 			vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 8),
-			vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 9)
+			vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 9),
+			vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_INPUT_ATTACHMENT, 3),
+			vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 7)
 		};
 
-		VkDescriptorPoolCreateInfo descriptorPoolInfo = vks::initializers::descriptorPoolCreateInfo(poolSizes, 3);
+		VkDescriptorPoolCreateInfo descriptorPoolInfo = vks::initializers::descriptorPoolCreateInfo(poolSizes, 4);
 		VK_CHECK_RESULT(vkCreateDescriptorPool(device, &descriptorPoolInfo, nullptr, &descriptorPool));
 	}
 
 	void setupDescriptorSetLayout()
 	{
-		// Deferred shading layout
+		// Scene rendering layout
 		std::vector<VkDescriptorSetLayoutBinding> setLayoutBindings = {
 			// Binding 0 : Vertex shader uniform buffer
-			vks::initializers::descriptorSetLayoutBinding( VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, VK_SHADER_STAGE_VERTEX_BIT, 0),
-			// Binding 1 : Position texture target / Scene colormap
+			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, VK_SHADER_STAGE_VERTEX_BIT, 0),
+			// Binding 1 : Scene colormap
 			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_FRAGMENT_BIT, 1),
-			// Binding 2 : Normals texture target
+			// Binding 2 : Scene normal map
 			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_FRAGMENT_BIT, 2),
-			// Binding 3 : Albedo texture target
-			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_FRAGMENT_BIT, 3),
-			// Binding 4 : Fragment shader uniform buffer
-			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, VK_SHADER_STAGE_FRAGMENT_BIT, 4),
 		};
-
 		VkDescriptorSetLayoutCreateInfo descriptorLayout = vks::initializers::descriptorSetLayoutCreateInfo(setLayoutBindings);
-		VK_CHECK_RESULT(vkCreateDescriptorSetLayout(device, &descriptorLayout, nullptr, &descriptorSetLayout));
+		VK_CHECK_RESULT(vkCreateDescriptorSetLayout(device, &descriptorLayout, nullptr, &descriptorSetLayouts.scene));
+
+		// Deferred composition layout
+		setLayoutBindings = {
+			// Binding 1 : Position (full layout) or depth (compact layout) input attachment
+			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_INPUT_ATTACHMENT, VK_SHADER_STAGE_FRAGMENT_BIT, 1),
+			// Binding 2 : Normals input attachment
+			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_INPUT_ATTACHMENT, VK_SHADER_STAGE_FRAGMENT_BIT, 2),
+			// Binding 3 : Albedo input attachment
+			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_INPUT_ATTACHMENT, VK_SHADER_STAGE_FRAGMENT_BIT, 3),
+		};
+		descriptorLayout = vks::initializers::descriptorSetLayoutCreateInfo(setLayoutBindings);
+		VK_CHECK_RESULT(vkCreateDescriptorSetLayout(device, &descriptorLayout, nullptr, &descriptorSetLayouts.composition));
+
+		// Light clusters, used by the compute passes and by the shading of both paths
+		const VkShaderStageFlags clusterStages = VK_SHADER_STAGE_COMPUTE_BIT | VK_SHADER_STAGE_FRAGMENT_BIT;
+		setLayoutBindings = {
+			// Binding 0 : Lighting uniform buffer
+			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, clusterStages, 0),
+			// Binding 1 : Light sources
+			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, clusterStages, 1),
+			// Binding 2 : Animated lights
+			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, clusterStages, 2),
+			// Binding 3 : Cluster bounds
+			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, clusterStages, 3),
+			// Binding 4 : Light counts per cluster
+			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, clusterStages, 4),
+			// Binding 5 : Light index ranges per cluster
+			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, clusterStages, 5),
+			// Binding 6 : Light index list
+			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, clusterStages, 6),
+			// Binding 7 : Binning statistics
+			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, clusterStages, 7),
+		};
+		descriptorLayout = vks::initializers::descriptorSetLayoutCreateInfo(setLayoutBindings);
+		VK_CHECK_RESULT(vkCreateDescriptorSetLayout(device, &descriptorLayout, nullptr, &descriptorSetLayouts.clusters));
+
+		VkPipelineLayoutCreateInfo pipelineLayoutCreateInfo = vks::initializers::pipelineLayoutCreateInfo(&descriptorSetLayouts.scene, 1);
+		VK_CHECK_RESULT(vkCreatePipelineLayout(device, &pipelineLayoutCreateInfo, nullptr, &pipelineLayouts.scene));
+		pipelineLayoutCreateInfo.pSetLayouts = &descriptorSetLayouts.clusters;
+		VK_CHECK_RESULT(vkCreatePipelineLayout(device, &pipelineLayoutCreateInfo, nullptr, &pipelineLayouts.clusters));
+
+		// The shading passes use the clusters as set 1
+		std::array<VkDescriptorSetLayout, 2> setLayouts = { descriptorSetLayouts.composition, descriptorSetLayouts.clusters };
+		pipelineLayoutCreateInfo = vks::initializers::pipelineLayoutCreateInfo(setLayouts.data(), static_cast<uint32_t>(setLayouts.size()));
+		VK_CHECK_RESULT(vkCreatePipelineLayout(device, &pipelineLayoutCreateInfo, nullptr, &pipelineLayouts.composition));
+		setLayouts[0] = descriptorSetLayouts.scene;
+		VK_CHECK_RESULT(vkCreatePipelineLayout(device, &pipelineLayoutCreateInfo, nullptr, &pipelineLayouts.forward));
+	}
 
-		// Shared pipeline layout used by all pipelines
-		VkPipelineLayoutCreateInfo pPipelineLayoutCreateInfo = vks::initializers::pipelineLayoutCreateInfo(&descriptorSetLayout, 1);
-		VK_CHECK_RESULT(vkCreatePipelineLayout(device, &pPipelineLayoutCreateInfo, nullptr, &pipelineLayout));
+	// The G-buffer attachments are recreated whenever the graph is compiled
+	void updateCompositionDescriptorSet()
+	{
+		if (shadingPath != ShadingDeferred) {
+			return;
+		}
+		std::array<VkDescriptorImageInfo, 3> imageDescriptors = {
+			vks::initializers::descriptorImageInfo(VK_NULL_HANDLE, renderGraph.imageView((gbufferLayout == GBufferCompact) ? "depth" : "position"), VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL),
+			vks::initializers::descriptorImageInfo(VK_NULL_HANDLE, renderGraph.imageView("normal"), VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL),
+			vks::initializers::descriptorImageInfo(VK_NULL_HANDLE, renderGraph.imageView("albedo"), VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL),
+		};
+		std::vector<VkWriteDescriptorSet> writeDescriptorSets = {
+			// Binding 1 : Position or depth input attachment
+			vks::initializers::writeDescriptorSet(descriptorSets.composition, VK_DESCRIPTOR_TYPE_INPUT_ATTACHMENT, 1, &imageDescriptors[0]),
+			// Binding 2 : Normals input attachment
+			vks::initializers::writeDescriptorSet(descriptorSets.composition, VK_DESCRIPTOR_TYPE_INPUT_ATTACHMENT, 2, &imageDescriptors[1]),
+			// Binding 3 : Albedo input attachment
+			vks::initializers::writeDescriptorSet(descriptorSets.composition, VK_DESCRIPTOR_TYPE_INPUT_ATTACHMENT, 3, &imageDescriptors[2]),
+		};
+		vkUpdateDescriptorSets(device, static_cast<uint32_t>(writeDescriptorSets.size()), writeDescriptorSets.data(), 0, nullptr);
 	}
 
 	void setupDescriptorSet()
 	{
 		std::vector<VkWriteDescriptorSet> writeDescriptorSets;
-		VkDescriptorSetAllocateInfo allocInfo = vks::initializers::descriptorSetAllocateInfo(descriptorPool, &descriptorSetLayout, 1);
-
-		// Image descriptors for the offscreen color attachments
-		VkDescriptorImageInfo texDescriptorPosition =
-			vks::initializers::descriptorImageInfo(
-				colorSampler,
-				offScreenFrameBuf.position.view,
-				VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
-
-		VkDescriptorImageInfo texDescriptorNormal =
-			vks::initializers::descriptorImageInfo(
-				colorSampler,
-				offScreenFrameBuf.normal.view,
-				VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
-
-		VkDescriptorImageInfo texDescriptorAlbedo =
-			vks::initializers::descriptorImageInfo(
-				colorSampler,
-				offScreenFrameBuf.albedo.view,
-				VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+		VkDescriptorSetAllocateInfo allocInfo = vks::initializers::descriptorSetAllocateInfo(descriptorPool, &descriptorSetLayouts.composition, 1);
 
 		// Deferred composition
-		VK_CHECK_RESULT(vkAllocateDescriptorSets(device, &allocInfo, &descriptorSet));
+		VK_CHECK_RESULT(vkAllocateDescriptorSets(device, &allocInfo, &descriptorSets.composition));
+		updateCompositionDescriptorSet();
+
+		// Light clusters
+		allocInfo.pSetLayouts = &descriptorSetLayouts.clusters;
+		VK_CHECK_RESULT(vkAllocateDescriptorSets(device, &allocInfo, &descriptorSets.clusters));
 		writeDescriptorSets = {
-			// Binding 1 : Position texture target
-			vks::initializers::writeDescriptorSet(descriptorSet, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 1, &texDescriptorPosition),
-			// Binding 2 : Normals texture target
-			vks::initializers::writeDescriptorSet(descriptorSet, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 2, &texDescriptorNormal),
-			// Binding 3 : Albedo texture target
-			vks::initializers::writeDescriptorSet(descriptorSet, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 3, &texDescriptorAlbedo),
-			// Binding 4 : Fragment shader uniform buffer
-			vks::initializers::writeDescriptorSet(descriptorSet, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 4, &uniformBuffers.composition.descriptor),
+			// Binding 0 : Lighting uniform buffer
+			vks::initializers::writeDescriptorSet(descriptorSets.clusters, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 0, &uniformBuffers.lighting.descriptor),
+			// Binding 1 : Light sources
+			vks::initializers::writeDescriptorSet(descriptorSets.clusters, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1, &clusterBuffers.lightSources.descriptor),
+			// Binding 2 : Animated lights
+			vks::initializers::writeDescriptorSet(descriptorSets.clusters, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 2, &clusterBuffers.lights.descriptor),
+			// Binding 3 : Cluster bounds
+			vks::initializers::writeDescriptorSet(descriptorSets.clusters, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 3, &clusterBuffers.clusterBounds.descriptor),
+			// Binding 4 : Light counts per cluster
+			vks::initializers::writeDescriptorSet(descriptorSets.clusters, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 4, &clusterBuffers.clusterCounts.descriptor),
+			// Binding 5 : Light index ranges per cluster
+			vks::initializers::writeDescriptorSet(descriptorSets.clusters, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 5, &clusterBuffers.clusterGrid.descriptor),
+			// Binding 6 : Light index list
+			vks::initializers::writeDescriptorSet(descriptorSets.clusters, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 6, &clusterBuffers.lightIndices.descriptor),
+			// Binding 7 : Binning statistics
+			vks::initializers::writeDescriptorSet(descriptorSets.clusters, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 7, &clusterBuffers.statistics.descriptor),
 		};
 		vkUpdateDescriptorSets(device, static_cast<uint32_t>(writeDescriptorSets.size()), writeDescriptorSets.data(), 0, nullptr);
 
 		// Offscreen (scene)
+		allocInfo.pSetLayouts = &descriptorSetLayouts.scene;
 
 		// Model
 		VK_CHECK_RESULT(vkAllocateDescriptorSets(device, &allocInfo, &descriptorSets.model));
@@ -603,7 +624,12 @@ public:
 		VkPipelineDynamicStateCreateInfo dynamicState = vks::initializers::pipelineDynamicStateCreateInfo(dynamicStateEnables);
 		std::array<VkPipelineShaderStageCreateInfo, 2> shaderStages;
 
-		VkGraphicsPipelineCreateInfo pipelineCI = vks::initializers::pipelineCreateInfo(pipelineLayout, renderPass);
+		// Pipelines need a render pass compatible with the one they are used in, so the graph is compiled once for every shading path
+		const int32_t selectedShadingPath = shadingPath;
+		shadingPath = ShadingForward;
+		prepareRenderGraph();
+
+		VkGraphicsPipelineCreateInfo pipelineCI = vks::initializers::pipelineCreateInfo(pipelineLayouts.forward, renderGraph.renderPass("forward"), renderGraph.subpass("forward"));
 		pipelineCI.pInputAssemblyState = &inputAssemblyState;
 		pipelineCI.pRasterizationState = &rasterizationState;
 		pipelineCI.pColorBlendState = &colorBlendState;
@@ -614,39 +640,187 @@ public:
 		pipelineCI.stageCount = static_cast<uint32_t>(shaderStages.size());
 		pipelineCI.pStages = shaderStages.data();
 
+		// Forward+ pipeline
+		pipelineCI.pVertexInputState = vkglTF::Vertex::getPipelineVertexInputState({vkglTF::VertexComponent::Position, vkglTF::VertexComponent::UV, vkglTF::VertexComponent::Color, vkglTF::VertexComponent::Normal, vkglTF::VertexComponent::Tangent});
+		shaderStages[0] = loadShader(getShadersPath() + "deferred/mrt.vert.spv", VK_SHADER_STAGE_VERTEX_BIT);
+		shaderStages[1] = loadShader(getShadersPath() + "deferred/forward.frag.spv", VK_SHADER_STAGE_FRAGMENT_BIT);
+		VK_CHECK_RESULT(vkCreateGraphicsPipelines(device, pipelineCache, 1, &pipelineCI, nullptr, &pipelines.forward));
+
+		shadingPath = selectedShadingPath;
+		prepareGBufferPipelines();
+
+		// Light animation and binning
+		VkComputePipelineCreateInfo computePipelineCI = vks::initializers::computePipelineCreateInfo(pipelineLayouts.clusters, 0);
+		computePipelineCI.stage = loadShader(getShadersPath() + "deferred/lights.comp.spv", VK_SHADER_STAGE_COMPUTE_BIT);
+		VK_CHECK_RESULT(vkCreateComputePipelines(device, pipelineCache, 1, &computePipelineCI, nullptr, &pipelines.lights));
+
+		computePipelineCI.stage = loadShader(getShadersPath() + "deferred/cluster_offsets.comp.spv", VK_SHADER_STAGE_COMPUTE_BIT);
+		VK_CHECK_RESULT(vkCreateComputePipelines(device, pipelineCache, 1, &computePipelineCI, nullptr, &pipelines.clusterOffsets));
+
+		// Counting and assigning use the same shader, a specialization constant selects the second run
+		uint32_t assign = 0;
+		VkSpecializationMapEntry specializationMapEntry = vks::initializers::specializationMapEntry(0, 0, sizeof(uint32_t));
+		VkSpecializationInfo specializationInfo = vks::initializers::specializationInfo(1, &specializationMapEntry, sizeof(uint32_t), &assign);
+		computePipelineCI.stage = loadShader(getShadersPath() + "deferred/cluster_bin.comp.spv", VK_SHADER_STAGE_COMPUTE_BIT);
+		computePipelineCI.stage.pSpecializationInfo = &specializationInfo;
+		VK_CHECK_RESULT(vkCreateComputePipelines(device, pipelineCache, 1, &computePipelineCI, nullptr, &pipelines.clusterCount));
+		assign = 1;
+		VK_CHECK_RESULT(vkCreateComputePipelines(device, pipelineCache, 1, &computePipelineCI, nullptr, &pipelines.clusterAssign));
+	}
+
+	// The attachments of the G-buffer pass and the shaders of both deferred pipelines depend on the G-buffer layout,
+	// so they are created again whenever the layout changes
+	void prepareGBufferPipelines()
+	{
+		vkDestroyPipeline(device, pipelines.offscreen, nullptr);
+		vkDestroyPipeline(device, pipelines.composition, nullptr);
+
+		VkPipelineInputAssemblyStateCreateInfo inputAssemblyState = vks::initializers::pipelineInputAssemblyStateCreateInfo(VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST, 0, VK_FALSE);
+		VkPipelineRasterizationStateCreateInfo rasterizationState = vks::initializers::pipelineRasterizationStateCreateInfo(VK_POLYGON_MODE_FILL, VK_CULL_MODE_FRONT_BIT, VK_FRONT_FACE_COUNTER_CLOCKWISE, 0);
+		VkPipelineColorBlendAttachmentState blendAttachmentState = vks::initializers::pipelineColorBlendAttachmentState(0xf, VK_FALSE);
+		VkPipelineColorBlendStateCreateInfo colorBlendState = vks::initializers::pipelineColorBlendStateCreateInfo(1, &blendAttachmentState);
+		VkPipelineDepthStencilStateCreateInfo depthStencilState = vks::initializers::pipelineDepthStencilStateCreateInfo(VK_TRUE, VK_TRUE, VK_COMPARE_OP_LESS_OR_EQUAL);
+		VkPipelineViewportStateCreateInfo viewportState = vks::initializers::pipelineViewportStateCreateInfo(1, 1, 0);
+		VkPipelineMultisampleStateCreateInfo multisampleState = vks::initializers::pipelineMultisampleStateCreateInfo(VK_SAMPLE_COUNT_1_BIT, 0);
+		std::vector<VkDynamicState> dynamicStateEnables = {VK_DYNAMIC_STATE_VIEWPORT, VK_DYNAMIC_STATE_SCISSOR};
+		VkPipelineDynamicStateCreateInfo dynamicState = vks::initializers::pipelineDynamicStateCreateInfo(dynamicStateEnables);
+		std::array<VkPipelineShaderStageCreateInfo, 2> shaderStages;
+
+		// G-buffer and composition are subpasses of the same render pass
+		const int32_t selectedShadingPath = shadingPath;
+		shadingPath = ShadingDeferred;
+		prepareRenderGraph();
+
+		const bool compact = (gbufferLayout == GBufferCompact);
+
 		// Final fullscreen composition pass pipeline
-		rasterizationState.cullMode = VK_CULL_MODE_FRONT_BIT;
+		VkGraphicsPipelineCreateInfo pipelineCI = vks::initializers::pipelineCreateInfo(pipelineLayouts.composition, renderGraph.renderPass("composition"), renderGraph.subpass("composition"));
+		pipelineCI.pInputAssemblyState = &inputAssemblyState;
+		pipelineCI.pRasterizationState = &rasterizationState;
+		pipelineCI.pColorBlendState = &colorBlendState;
+		pipelineCI.pMultisampleState = &multisampleState;
+		pipelineCI.pViewportState = &viewportState;
+		pipelineCI.pDepthStencilState = &depthStencilState;
+		pipelineCI.pDynamicState = &dynamicState;
+		pipelineCI.stageCount = static_cast<uint32_t>(shaderStages.size());
+		pipelineCI.pStages = shaderStages.data();
 		shaderStages[0] = loadShader(getShadersPath() + "deferred/deferred.vert.spv", VK_SHADER_STAGE_VERTEX_BIT);
-		shaderStages[1] = loadShader(getShadersPath() + "deferred/deferred.frag.spv", VK_SHADER_STAGE_FRAGMENT_BIT);
+		shaderStages[1] = loadShader(getShadersPath() + (compact ? "deferred/deferred_compact.frag.spv" : "deferred/deferred.frag.spv"), VK_SHADER_STAGE_FRAGMENT_BIT);
 		// Empty vertex input state, vertices are generated by the vertex shader
 		VkPipelineVertexInputStateCreateInfo emptyInputState = vks::initializers::pipelineVertexInputStateCreateInfo();
 		pipelineCI.pVertexInputState = &emptyInputState;
 		VK_CHECK_RESULT(vkCreateGraphicsPipelines(device, pipelineCache, 1, &pipelineCI, nullptr, &pipelines.composition));
 
 		// Vertex input state from glTF model for pipeline rendering models
+		pipelineCI.layout = pipelineLayouts.scene;
+		pipelineCI.renderPass = renderGraph.renderPass("gbuffer");
+		pipelineCI.subpass = renderGraph.subpass("gbuffer");
 		pipelineCI.pVertexInputState = vkglTF::Vertex::getPipelineVertexInputState({vkglTF::VertexComponent::Position, vkglTF::VertexComponent::UV, vkglTF::VertexComponent::Color, vkglTF::VertexComponent::Normal, vkglTF::VertexComponent::Tangent});
 		rasterizationState.cullMode = VK_CULL_MODE_BACK_BIT;
 
 		// Offscreen pipeline
 		shaderStages[0] = loadShader(getShadersPath() + "deferred/mrt.vert.spv", VK_SHADER_STAGE_VERTEX_BIT);
-		shaderStages[1] = loadShader(getShadersPath() + "deferred/mrt.frag.spv", VK_SHADER_STAGE_FRAGMENT_BIT);
-
-		// Separate render pass
-		pipelineCI.renderPass = offScreenFrameBuf.renderPass;
+		shaderStages[1] = loadShader(getShadersPath() + (compact ? "deferred/mrt_compact.frag.spv" : "deferred/mrt.frag.spv"), VK_SHADER_STAGE_FRAGMENT_BIT);
 
 		// Blend attachment states required for all color attachments
 		// This is important, as color write mask will otherwise be 0x0 and you
 		// won't see anything rendered to the attachment
-		std::array<VkPipelineColorBlendAttachmentState, 3> blendAttachmentStates = {
-			vks::initializers::pipelineColorBlendAttachmentState(0xf, VK_FALSE),
-			vks::initializers::pipelineColorBlendAttachmentState(0xf, VK_FALSE),
-			vks::initializers::pipelineColorBlendAttachmentState(0xf, VK_FALSE)
-		};
+		std::vector<VkPipelineColorBlendAttachmentState> blendAttachmentStates(gbufferColorFormats(gbufferLayout).size(), vks::initializers::pipelineColorBlendAttachmentState(0xf, VK_FALSE));
 
 		colorBlendState.attachmentCount = static_cast<uint32_t>(blendAttachmentStates.size());
 		colorBlendState.pAttachments = blendAttachmentStates.data();
 
 		VK_CHECK_RESULT(vkCreateGraphicsPipelines(device, pipelineCache, 1, &pipelineCI, nullptr, &pipelines.offscreen));
+
+		if (selectedShadingPath != shadingPath) {
+			shadingPath = selectedShadingPath;
+			prepareRenderGraph();
+		}
+	}
+
+	// Creates a device local buffer, optionally filled with data through a staging buffer
+	void createDeviceBuffer(vks::Buffer *buffer, VkBufferUsageFlags usageFlags, VkDeviceSize size, const void *data = nullptr)
+	{
+		VK_CHECK_RESULT(vulkanDevice->createBuffer(usageFlags | VK_BUFFER_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, buffer, size));
+		if (data == nullptr) {
+			return;
+		}
+		vks::Buffer stagingBuffer;
+		VK_CHECK_RESULT(vulkanDevice->createBuffer(VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, &stagingBuffer, size, const_cast<void*>(data)));
+		vulkanDevice->copyBuffer(&stagingBuffer, buffer, queue);
+		stagingBuffer.destroy();
+	}
+
+	// Generates light sources for the maximum light count, the selected count only limits how many of them are animated and binned
+	void prepareClusterBuffers()
+	{
+		std::default_random_engine rndEngine(benchmark.active ? 0 : (unsigned)time(nullptr));
+		std::uniform_real_distribution<float> rndDist(0.0f, 1.0f);
+		std::vector<LightSource> lightSources(MAX_LIGHT_COUNT);
+		for (auto &lightSource : lightSources) {
+			// Negative y is up in this scene
+			lightSource.position = glm::vec4(rndDist(rndEngine) * 20.0f - 10.0f, -0.1f - rndDist(rndEngine) * 2.4f, rndDist(rndEngine) * 20.0f - 10.0f, 2.5f + rndDist(rndEngine) * 1.5f);
+			glm::vec3 color = glm::vec3(rndDist(rndEngine), rndDist(rndEngine), rndDist(rndEngine));
+			color /= std::max(std::max(color.r, color.g), std::max(color.b, 0.01f));
+			lightSource.color = glm::vec4(color * 1.5f, rndDist(rndEngine) * 2.0f * glm::pi<float>());
+		}
+		createDeviceBuffer(&clusterBuffers.lightSources, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, lightSources.size() * sizeof(LightSource), lightSources.data());
+		createDeviceBuffer(&clusterBuffers.lights, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, MAX_LIGHT_COUNT * 2 * sizeof(glm::vec4));
+
+		const uint32_t clusterCount = CLUSTER_GRID_X * CLUSTER_GRID_Y * CLUSTER_GRID_Z;
+		createDeviceBuffer(&clusterBuffers.clusterCounts, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, clusterCount * sizeof(uint32_t));
+		createDeviceBuffer(&clusterBuffers.clusterGrid, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, clusterCount * sizeof(glm::uvec2));
+		createDeviceBuffer(&clusterBuffers.lightIndices, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, MAX_LIGHT_INDICES * sizeof(uint32_t));
+
+		// The assign pass counts back down, so the counts only have to be cleared once
+		VkCommandBuffer copyCmd = vulkanDevice->createCommandBuffer(VK_COMMAND_BUFFER_LEVEL_PRIMARY, true);
+		vkCmdFillBuffer(copyCmd, clusterBuffers.clusterCounts.buffer, 0, VK_WHOLE_SIZE, 0);
+		vulkanDevice->flushCommandBuffer(copyCmd, queue, true);
+
+		VK_CHECK_RESULT(vulkanDevice->createBuffer(
+			VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+			&clusterBuffers.clusterBounds,
+			clusterCount * 2 * sizeof(glm::vec4)));
+		VK_CHECK_RESULT(vulkanDevice->createBuffer(
+			VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+			&clusterBuffers.statistics,
+			sizeof(clusterStatistics),
+			&clusterStatistics));
+		VK_CHECK_RESULT(clusterBuffers.clusterBounds.map());
+		VK_CHECK_RESULT(clusterBuffers.statistics.map());
+
+		updateClusterBounds();
+	}
+
+	// View space bounding boxes of the clusters, the tile frustums are cut at the depths of their slice
+	void updateClusterBounds()
+	{
+		const glm::mat4 inverseProjection = glm::inverse(camera.matrices.perspective);
+		const float sliceRatio = clusterFar / clusterNear;
+		glm::vec4 *bounds = (glm::vec4*)clusterBuffers.clusterBounds.mapped;
+		for (uint32_t z = 0; z < CLUSTER_GRID_Z; z++) {
+			const float depthNear = (z == 0) ? camera.getNearClip() : clusterNear * pow(sliceRatio, (float)z / CLUSTER_GRID_Z);
+			const float depthFar = clusterNear * pow(sliceRatio, (float)(z + 1) / CLUSTER_GRID_Z);
+			for (uint32_t y = 0; y < CLUSTER_GRID_Y; y++) {
+				for (uint32_t x = 0; x < CLUSTER_GRID_X; x++) {
+					glm::vec3 minimum(std::numeric_limits<float>::max());
+					glm::vec3 maximum(-std::numeric_limits<float>::max());
+					for (uint32_t i = 0; i < 4; i++) {
+						const glm::vec2 ndc = glm::vec2((float)(x + (i & 1)) / CLUSTER_GRID_X, (float)(y + (i >> 1)) / CLUSTER_GRID_Y) * 2.0f - 1.0f;
+						glm::vec4 corner = inverseProjection * glm::vec4(ndc, 0.0f, 1.0f);
+						// Direction of the tile corner scaled to a view space depth of one
+						const glm::vec3 direction = glm::vec3(corner) / -corner.z;
+						minimum = glm::min(minimum, glm::min(direction * depthNear, direction * depthFar));
+						maximum = glm::max(maximum, glm::max(direction * depthNear, direction * depthFar));
+					}
+					const uint32_t cluster = x + y * CLUSTER_GRID_X + z * CLUSTER_GRID_X * CLUSTER_GRID_Y;
+					bounds[cluster * 2] = glm::vec4(minimum, 0.0f);
+					bounds[cluster * 2 + 1] = glm::vec4(maximum, 0.0f);
+				}
+			}
+		}
 	}
 
 	// Prepare and initialize uniform buffer containing shader uniforms
@@ -659,16 +833,16 @@ public:
 		    &uniformBuffers.offscreen,
 			sizeof(uboOffscreenVS)));
 
-		// Deferred fragment shader
+		// Light animation, binning and shading
 		VK_CHECK_RESULT(vulkanDevice->createBuffer(
 			VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
 			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
-		    &uniformBuffers.composition,
-			sizeof(uboComposition)));
+		    &uniformBuffers.lighting,
+			sizeof(uboLighting)));
 
 		// Map persistent
 		VK_CHECK_RESULT(uniformBuffers.offscreen.map());
-		VK_CHECK_RESULT(uniformBuffers.composition.map());
+		VK_CHECK_RESULT(uniformBuffers.lighting.map());
 
 		// Setup instanced model positions
 		uboOffscreenVS.instancePos[0] = glm::vec4(0.0f);
@@ -677,7 +851,7 @@ public:
 
 		// Update
 		updateUniformBufferOffscreen();
-		updateUniformBufferComposition();
+		updateUniformBufferLighting();
 	}
 
 	// Update matrices used for the offscreen rendering of the scene
@@ -689,110 +863,58 @@ public:
 		memcpy(uniformBuffers.offscreen.mapped, &uboOffscreenVS, sizeof(uboOffscreenVS));
 	}
 
-	// Update lights and parameters passed to the composition shaders
-	void updateUniformBufferComposition()
+	// Update the parameters shared by the light animation, binning and shading
+	void updateUniformBufferLighting()
 	{
-		// White
-		uboComposition.lights[0].position = glm::vec4(0.0f, 0.0f, 1.0f, 0.0f);
-		uboComposition.lights[0].color = glm::vec3(1.5f);
-		uboComposition.lights[0].radius = 15.0f * 0.25f;
-		// Red
-		uboComposition.lights[1].position = glm::vec4(-2.0f, 0.0f, 0.0f, 0.0f);
-		uboComposition.lights[1].color = glm::vec3(1.0f, 0.0f, 0.0f);
-		uboComposition.lights[1].radius = 15.0f;
-		// Blue
-		uboComposition.lights[2].position = glm::vec4(2.0f, -1.0f, 0.0f, 0.0f);
-		uboComposition.lights[2].color = glm::vec3(0.0f, 0.0f, 2.5f);
-		uboComposition.lights[2].radius = 5.0f;
-		// Yellow
-		uboComposition.lights[3].position = glm::vec4(0.0f, -0.9f, 0.5f, 0.0f);
-		uboComposition.lights[3].color = glm::vec3(1.0f, 1.0f, 0.0f);
-		uboComposition.lights[3].radius = 2.0f;
-		// Green
-		uboComposition.lights[4].position = glm::vec4(0.0f, -0.5f, 0.0f, 0.0f);
-		uboComposition.lights[4].color = glm::vec3(0.0f, 1.0f, 0.2f);
-		uboComposition.lights[4].radius = 5.0f;
-		// Yellow
-		uboComposition.lights[5].position = glm::vec4(0.0f, -1.0f, 0.0f, 0.0f);
-		uboComposition.lights[5].color = glm::vec3(1.0f, 0.7f, 0.3f);
-		uboComposition.lights[5].radius = 25.0f;
-
-		uboComposition.lights[0].position.x = sin(glm::radians(360.0f * timer)) * 5.0f;
-		uboComposition.lights[0].position.z = cos(glm::radians(360.0f * timer)) * 5.0f;
-
-		uboComposition.lights[1].position.x = -4.0f + sin(glm::radians(360.0f * timer) + 45.0f) * 2.0f;
-		uboComposition.lights[1].position.z =  0.0f + cos(glm::radians(360.0f * timer) + 45.0f) * 2.0f;
-
-		uboComposition.lights[2].position.x = 4.0f + sin(glm::radians(360.0f * timer)) * 2.0f;
-		uboComposition.lights[2].position.z = 0.0f + cos(glm::radians(360.0f * timer)) * 2.0f;
-
-		uboComposition.lights[4].position.x = 0.0f + sin(glm::radians(360.0f * timer + 90.0f)) * 5.0f;
-		uboComposition.lights[4].position.z = 0.0f - cos(glm::radians(360.0f * timer + 45.0f)) * 5.0f;
-
-		uboComposition.lights[5].position.x = 0.0f + sin(glm::radians(-360.0f * timer + 135.0f)) * 10.0f;
-		uboComposition.lights[5].position.z = 0.0f - cos(glm::radians(-360.0f * timer - 45.0f)) * 10.0f;
-
+		uboLighting.view = camera.matrices.view;
+		uboLighting.projection = camera.matrices.perspective;
 		// Current view position
-		uboComposition.viewPos = glm::vec4(camera.position, 0.0f) * glm::vec4(-1.0f, 1.0f, -1.0f, 1.0f);
-
-		uboComposition.debugDisplayTarget = debugDisplayTarget;
-
-		memcpy(uniformBuffers.composition.mapped, &uboComposition, sizeof(uboComposition));
+		uboLighting.viewPos = glm::vec4(camera.position, 0.0f) * glm::vec4(-1.0f, 1.0f, -1.0f, 1.0f);
+		uboLighting.gridSize = glm::uvec4(CLUSTER_GRID_X, CLUSTER_GRID_Y, CLUSTER_GRID_Z, lightCount());
+		// Slice of a view space depth d is log(d) * scale + bias
+		const float logRatio = log(clusterFar / clusterNear);
+		uboLighting.sliceParams = glm::vec4(CLUSTER_GRID_Z / logRatio, -CLUSTER_GRID_Z * log(clusterNear) / logRatio, camera.getNearClip(), camera.getFarClip());
+		uboLighting.screenSize = glm::vec2((float)width, (float)height);
+		// Keeps the number of lights affecting a pixel roughly constant for all light counts
+		uboLighting.radiusScale = std::cbrt(64.0f / (float)lightCount());
+		uboLighting.time = timer;
+		uboLighting.debugDisplayTarget = debugDisplayTarget;
+		uboLighting.maxLightIndices = MAX_LIGHT_INDICES;
+		memcpy(uniformBuffers.lighting.mapped, &uboLighting, sizeof(uboLighting));
 	}
 
 	void draw()
 	{
 		VulkanExampleBase::prepareFrame();
 
-		// The scene render command buffer has to wait for the offscreen
-		// rendering to be finished before we can use the framebuffer
-		// color image for sampling during final rendering
-		// To ensure this we use a dedicated offscreen synchronization
-		// semaphore that will be signaled when offscreen rendering
-		// has been finished
-		// This is necessary as an implementation may start both
-		// command buffers at the same time, there is no guarantee
-		// that command buffers will be executed in the order they
-		// have been submitted by the application
-
-		// Offscreen rendering
-
-		// Wait for swap chain presentation to finish
-		submitInfo.pWaitSemaphores = &semaphores.presentComplete;
-		// Signal ready with offscreen semaphore
-		submitInfo.pSignalSemaphores = &offscreenSemaphore;
-
-		// Submit work
+		// Light binning and shading are recorded into the same command buffer, the graph orders all passes
 		submitInfo.commandBufferCount = 1;
-		submitInfo.pCommandBuffers = &offScreenCmdBuffer;
-		VK_CHECK_RESULT(vkQueueSubmit(queue, 1, &submitInfo, VK_NULL_HANDLE));
-
-		// Scene rendering
-
-		// Wait for offscreen semaphore
-		submitInfo.pWaitSemaphores = &offscreenSemaphore;
-		// Signal ready with render complete semaphore
-		submitInfo.pSignalSemaphores = &semaphores.renderComplete;
-
-		// Submit work
 		submitInfo.pCommandBuffers = &drawCmdBuffers[currentBuffer];
 		VK_CHECK_RESULT(vkQueueSubmit(queue, 1, &submitInfo, VK_NULL_HANDLE));
 
 		VulkanExampleBase::submitFrame();
+
+		// The frame has finished at this point, so its timestamps and binning statistics can be read
+		renderGraph.updateTimings(currentBuffer);
+		memcpy(&clusterStatistics, clusterBuffers.statistics.mapped, sizeof(clusterStatistics));
 	}
 
 	void prepare()
 	{
 		VulkanExampleBase::prepare();
+		if (!vks::tools::getSupportedDepthOnlyFormat(physicalDevice, false, &sceneDepthFormat)) {
+			vks::tools::exitFatal("Could not find a depth format without stencil", -1);
+		}
 		loadAssets();
-		prepareOffscreenFramebuffer();
 		prepareUniformBuffers();
+		prepareClusterBuffers();
 		setupDescriptorSetLayout();
+		renderGraph.prepare(vulkanDevice);
 		preparePipelines();
+		prepareUIPipeline();
 		setupDescriptorPool();
 		setupDescriptorSet();
 		buildCommandBuffers();
-		buildDeferredCommandBuffer();
 		prepared = true;
 	}
 
@@ -801,9 +923,9 @@ public:
 		if (!prepared)
 			return;
 		draw();
-		if (!paused)
+		if (!paused || camera.updated)
 		{
-			updateUniformBufferComposition();
+			updateUniformBufferLighting();
 		}
 		if (camera.updated)
 		{
@@ -814,16 +936,57 @@ public:
 	virtual void viewChanged()
 	{
 		updateUniformBufferOffscreen();
+		updateUniformBufferLighting();
 	}
 
 	virtual void OnUpdateUIOverlay(vks::UIOverlay *overlay)
 	{
+		bool shadingChanged = false;
+		bool gbufferChanged = false;
 		if (overlay->header("Settings")) {
-			if (overlay->comboBox("Display", &debugDisplayTarget, {"Final composition", "Position", "Normals", "Albedo", "Specular" }))
+			if (overlay->comboBox("Display", &debugDisplayTarget, {"Final composition", "Position", "Normals", "Albedo", "Specular", "Lights per cluster" }))
+			{
+				updateUniformBufferLighting();
+			}
+			shadingChanged = overlay->comboBox("Shading", &shadingPath, { "Deferred", "Forward+" });
+			gbufferChanged = overlay->comboBox("G-buffer", &gbufferLayout, { "Full", "Compact" });
+			// The dispatch sizes change with the light count, the command buffers are rebuilt after UI changes
+			if (overlay->comboBox("Lights", &lightCountIndex, { "64", "256", "1024", "4096", "16384", "65536" }))
 			{
-				updateUniformBufferComposition();
+				updateUniformBufferLighting();
 			}
 		}
+		if (gbufferChanged) {
+			vkDeviceWaitIdle(device);
+			prepareGBufferPipelines();
+		}
+		if (renderGraph.updateUIOverlay(overlay) || shadingChanged || gbufferChanged) {
+			vkDeviceWaitIdle(device);
+			prepareRenderGraph();
+			updateCompositionDescriptorSet();
+			if (shadingChanged) {
+				prepareUIPipeline();
+			}
+		}
+		if (overlay->header("Light clusters")) {
+			overlay->text("Grid: %dx%dx%d", CLUSTER_GRID_X, CLUSTER_GRID_Y, CLUSTER_GRID_Z);
+			overlay->text("Light indices: %d / %d%s", clusterStatistics.requiredLightIndices, MAX_LIGHT_INDICES, (clusterStatistics.requiredLightIndices > MAX_LIGHT_INDICES) ? " (overflow)" : "");
+			overlay->text("Max lights per cluster: %d", clusterStatistics.maxClusterLights);
+			overlay->text("Light animation: %.3f ms", renderGraph.passTime("lights"));
+			overlay->text("Light binning: %.3f ms", renderGraph.passTime("clusterCount") + renderGraph.passTime("clusterOffsets") + renderGraph.passTime("clusterAssign"));
+			if (shadingPath == ShadingDeferred) {
+				overlay->text("G-buffer: %.3f ms", renderGraph.passTime("gbuffer"));
+				overlay->text("Composition: %.3f ms", renderGraph.passTime("composition"));
+			} else {
+				overlay->text("Forward+ shading: %.3f ms", renderGraph.passTime("forward"));
+			}
+		}
+		if (overlay->header("G-buffer")) {
+			// Written by the G-buffer subpass plus read by the composition subpass
+			overlay->text("Full: %.1f MB per frame%s", (float)gbufferFrameBytes(GBufferFull) / (1024.0f * 1024.0f), (gbufferLayout == GBufferFull) ? " (active)" : "");
+			overlay->text("Compact: %.1f MB per frame%s", (float)gbufferFrameBytes(GBufferCompact) / (1024.0f * 1024.0f), (gbufferLayout == GBufferCompact) ? " (active)" : "");
+			overlay->text("Lazily allocated: %.1f MB", (float)renderGraph.statistics.lazilyAllocatedMemory / (1024.0f * 1024.0f));
+		}
 	}
 };
 
@@ -1,6 +1,9 @@
 /*
 * Vulkan Example - Deferred shading with shadows from multiple light sources using geometry shader instancing
 *
+* The compact G-buffer layout reconstructs positions from the depth attachment and stores octahedral encoded normals
+* in 10 bit channels instead of full precision world space positions and normals
+*
 * Copyright (C) 2016 by Sascha Willems - www.saschawillems.de
 *
 * This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
@@ -33,7 +36,10 @@
 class VulkanExample : public VulkanExampleBase
 {
 public:
+	enum GBufferLayout { GBufferFull = 0, GBufferCompact = 1 };
+
 	int32_t debugDisplayTarget = 0;
+	int32_t gbufferLayout = GBufferFull;
 	bool enableShadows = true;
 
 	// Keep depth range as small as possible
@@ -87,6 +93,9 @@ public:
 
 	struct {
 		glm::vec4 viewPos;
+		// Used to reconstruct positions from depth with the compact G-buffer layout
+		glm::mat4 view;
+		glm::mat4 projection;
 		Light lights[LIGHT_COUNT];
 		uint32_t useShadows = 1;
 		int32_t debugDisplayTarget = 0;
@@ -99,9 +108,9 @@ public:
 	} uniformBuffers;
 
 	struct {
-		VkPipeline deferred;
-		VkPipeline offscreen;
-		VkPipeline shadowpass;
+		VkPipeline deferred = VK_NULL_HANDLE;
+		VkPipeline offscreen = VK_NULL_HANDLE;
+		VkPipeline shadowpass = VK_NULL_HANDLE;
 	} pipelines;
 	VkPipelineLayout pipelineLayout;
 
@@ -144,6 +153,12 @@ public:
 		camera.setPerspective(60.0f, (float)width / (float)height, zNear, zFar);
 		timerSpeed *= 0.25f;
 		paused = true;
+
+		commandLineParser.add("compactgbuffer", { "-cg", "--compactgbuffer" }, 0, "Start with the compact G-buffer layout");
+		commandLineParser.parse(args);
+		if (commandLineParser.isSet("compactgbuffer")) {
+			gbufferLayout = GBufferCompact;
+		}
 	}
 
 	~VulkanExample()
@@ -249,34 +264,56 @@ public:
 		frameBuffers.deferred->width = FB_DIM;
 		frameBuffers.deferred->height = FB_DIM;
 
-		// Four attachments (3 color, 1 depth)
 		vks::AttachmentCreateInfo attachmentInfo = {};
 		attachmentInfo.width = FB_DIM;
 		attachmentInfo.height = FB_DIM;
 		attachmentInfo.layerCount = 1;
 		attachmentInfo.usage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
 
-		// Color attachments
-		// Attachment 0: (World space) Positions
-		attachmentInfo.format = VK_FORMAT_R16G16B16A16_SFLOAT;
-		frameBuffers.deferred->addAttachment(attachmentInfo);
-
-		// Attachment 1: (World space) Normals
-		attachmentInfo.format = VK_FORMAT_R16G16B16A16_SFLOAT;
-		frameBuffers.deferred->addAttachment(attachmentInfo);
-
-		// Attachment 2: Albedo (color)
-		attachmentInfo.format = VK_FORMAT_R8G8B8A8_UNORM;
-		frameBuffers.deferred->addAttachment(attachmentInfo);
-
-		// Depth attachment
-		// Find a suitable depth format
 		VkFormat attDepthFormat;
-		VkBool32 validDepthFormat = vks::tools::getSupportedDepthFormat(physicalDevice, &attDepthFormat);
-		assert(validDepthFormat);
+		if (gbufferLayout == GBufferCompact)
+		{
+			// Three attachments (2 color, 1 depth)
+			// Color attachments
+			// Attachment 0: Octahedral encoded (world space) normals
+			attachmentInfo.format = VK_FORMAT_A2B10G10R10_UNORM_PACK32;
+			frameBuffers.deferred->addAttachment(attachmentInfo);
+
+			// Attachment 1: Albedo (color)
+			attachmentInfo.format = VK_FORMAT_R8G8B8A8_UNORM;
+			frameBuffers.deferred->addAttachment(attachmentInfo);
+
+			// Depth attachment
+			// Sampled by the composition to reconstruct the positions, which requires a format without stencil
+			VkBool32 validDepthFormat = vks::tools::getSupportedDepthOnlyFormat(physicalDevice, true, &attDepthFormat);
+			assert(validDepthFormat);
+			attachmentInfo.usage = VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
+		}
+		else
+		{
+			// Four attachments (3 color, 1 depth)
+			// Color attachments
+			// Attachment 0: (World space) Positions
+			attachmentInfo.format = VK_FORMAT_R16G16B16A16_SFLOAT;
+			frameBuffers.deferred->addAttachment(attachmentInfo);
+
+			// Attachment 1: (World space) Normals
+			attachmentInfo.format = VK_FORMAT_R16G16B16A16_SFLOAT;
+			frameBuffers.deferred->addAttachment(attachmentInfo);
+
+			// Attachment 2: Albedo (color)
+			attachmentInfo.format = VK_FORMAT_R8G8B8A8_UNORM;
+			frameBuffers.deferred->addAttachment(attachmentInfo);
+
+			// Depth attachment
+			// Find a suitable depth format
+			VkBool32 validDepthFormat = vks::tools::getSupportedDepthFormat(physicalDevice, &attDepthFormat);
+			assert(validDepthFormat);
+			// Depth is only used within the render pass, so it doesn't need to be stored and may be lazily allocated
+			attachmentInfo.usage = VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSIENT_ATTACHMENT_BIT;
+		}
 
 		attachmentInfo.format = attDepthFormat;
-		attachmentInfo.usage = VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT;
 		frameBuffers.deferred->addAttachment(attachmentInfo);
 
 		// Create sampler to sample from the color attachments
@@ -286,6 +323,19 @@ public:
 		VK_CHECK_RESULT(frameBuffers.deferred->createRenderPass());
 	}
 
+	// Bytes written to the G-buffer and read back by the composition in one frame, attachments that are not stored
+	// at the end of the render pass (depth with the full layout) never have to leave tile memory on tiling GPUs
+	VkDeviceSize gbufferFrameBytes() const
+	{
+		VkDeviceSize bytes = 0;
+		for (auto &attachment : frameBuffers.deferred->attachments) {
+			if (attachment.description.storeOp == VK_ATTACHMENT_STORE_OP_STORE) {
+				bytes += static_cast<VkDeviceSize>(vks::tools::formatSize(attachment.format)) * 2 * frameBuffers.deferred->width * frameBuffers.deferred->height;
+			}
+		}
+		return bytes;
+	}
+
 	// Put render commands for the scene into the given command buffer
 	void renderScene(VkCommandBuffer cmdBuffer, bool shadow)
 	{
@@ -308,8 +358,11 @@ public:
 		}
 
 		// Create a semaphore used to synchronize offscreen rendering and usage
-		VkSemaphoreCreateInfo semaphoreCreateInfo = vks::initializers::semaphoreCreateInfo();
-		VK_CHECK_RESULT(vkCreateSemaphore(device, &semaphoreCreateInfo, nullptr, &offscreenSemaphore));
+		if (offscreenSemaphore == VK_NULL_HANDLE)
+		{
+			VkSemaphoreCreateInfo semaphoreCreateInfo = vks::initializers::semaphoreCreateInfo();
+			VK_CHECK_RESULT(vkCreateSemaphore(device, &semaphoreCreateInfo, nullptr, &offscreenSemaphore));
+		}
 
 		VkCommandBufferBeginInfo cmdBufInfo = vks::initializers::commandBufferBeginInfo();
 
@@ -353,17 +406,19 @@ public:
 		// Second pass: Deferred calculations
 		// -------------------------------------------------------------------------------------------------------
 
-		// Clear values for all attachments written in the fragment shader
-		clearValues[0].color = { { 0.0f, 0.0f, 0.0f, 0.0f } };
-		clearValues[1].color = { { 0.0f, 0.0f, 0.0f, 0.0f } };
-		clearValues[2].color = { { 0.0f, 0.0f, 0.0f, 0.0f } };
-		clearValues[3].depthStencil = { 1.0f, 0 };
+		// Clear values for all attachments written in the fragment shader, the depth attachment is the last one
+		const uint32_t attachmentCount = static_cast<uint32_t>(frameBuffers.deferred->attachments.size());
+		for (uint32_t i = 0; i < attachmentCount - 1; i++)
+		{
+			clearValues[i].color = { { 0.0f, 0.0f, 0.0f, 0.0f } };
+		}
+		clearValues[attachmentCount - 1].depthStencil = { 1.0f, 0 };
 
 		renderPassBeginInfo.renderPass = frameBuffers.deferred->renderPass;
 		renderPassBeginInfo.framebuffer = frameBuffers.deferred->framebuffer;
 		renderPassBeginInfo.renderArea.extent.width = frameBuffers.deferred->width;
 		renderPassBeginInfo.renderArea.extent.height = frameBuffers.deferred->height;
-		renderPassBeginInfo.clearValueCount = static_cast<uint32_t>(clearValues.size());
+		renderPassBeginInfo.clearValueCount = attachmentCount;
 		renderPassBeginInfo.pClearValues = clearValues.data();
 
 		vkCmdBeginRenderPass(commandBuffers.deferred, &renderPassBeginInfo, VK_SUBPASS_CONTENTS_INLINE);
@@ -462,7 +517,7 @@ public:
 		std::vector<VkDescriptorSetLayoutBinding> setLayoutBindings = {
 			// Binding 0: Vertex shader uniform buffer
 			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_GEOMETRY_BIT, 0),
-			// Binding 1: Position texture
+			// Binding 1: Position texture (full layout) or depth texture (compact layout)
 			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_FRAGMENT_BIT, 1),
 			// Binding 2: Normals texture
 			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_FRAGMENT_BIT, 2),
@@ -481,28 +536,27 @@ public:
 		VK_CHECK_RESULT(vkCreatePipelineLayout(device, &pPipelineLayoutCreateInfo, nullptr, &pipelineLayout));
 	}
 
-	void setupDescriptorSet()
+	// The G-buffer attachments are recreated whenever the G-buffer layout changes
+	void updateCompositionDescriptorSet()
 	{
-		std::vector<VkWriteDescriptorSet> writeDescriptorSets;
-		VkDescriptorSetAllocateInfo allocInfo = vks::initializers::descriptorSetAllocateInfo(descriptorPool, &descriptorSetLayout, 1);
-
-		// Image descriptors for the offscreen color attachments
+		// Image descriptors for the offscreen attachments, with the compact layout the first one is the depth attachment
+		const bool compact = (gbufferLayout == GBufferCompact);
 		VkDescriptorImageInfo texDescriptorPosition =
 			vks::initializers::descriptorImageInfo(
 				frameBuffers.deferred->sampler,
-				frameBuffers.deferred->attachments[0].view,
-				VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+				compact ? frameBuffers.deferred->attachments[2].view : frameBuffers.deferred->attachments[0].view,
+				compact ? VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL : VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
 
 		VkDescriptorImageInfo texDescriptorNormal =
 			vks::initializers::descriptorImageInfo(
 				frameBuffers.deferred->sampler,
-				frameBuffers.deferred->attachments[1].view,
+				frameBuffers.deferred->attachments[compact ? 0 : 1].view,
 				VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
 
 		VkDescriptorImageInfo texDescriptorAlbedo =
 			vks::initializers::descriptorImageInfo(
 				frameBuffers.deferred->sampler,
-				frameBuffers.deferred->attachments[2].view,
+				frameBuffers.deferred->attachments[compact ? 1 : 2].view,
 				VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
 
 		VkDescriptorImageInfo texDescriptorShadowMap =
@@ -511,10 +565,8 @@ public:
 				frameBuffers.shadow->attachments[0].view,
 				VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL);
 
-		// Deferred composition
-		VK_CHECK_RESULT(vkAllocateDescriptorSets(device, &allocInfo, &descriptorSet));
-		writeDescriptorSets = {
-			// Binding 1: World space position texture
+		std::vector<VkWriteDescriptorSet> writeDescriptorSets = {
+			// Binding 1: World space position or depth texture
 			vks::initializers::writeDescriptorSet(descriptorSet, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 1, &texDescriptorPosition),
 			// Binding 2: World space normals texture
 			vks::initializers::writeDescriptorSet(descriptorSet, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 2, &texDescriptorNormal),
@@ -526,6 +578,16 @@ public:
 			vks::initializers::writeDescriptorSet(descriptorSet, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 5, &texDescriptorShadowMap),
 		};
 		vkUpdateDescriptorSets(device, static_cast<uint32_t>(writeDescriptorSets.size()), writeDescriptorSets.data(), 0, NULL);
+	}
+
+	void setupDescriptorSet()
+	{
+		std::vector<VkWriteDescriptorSet> writeDescriptorSets;
+		VkDescriptorSetAllocateInfo allocInfo = vks::initializers::descriptorSetAllocateInfo(descriptorPool, &descriptorSetLayout, 1);
+
+		// Deferred composition
+		VK_CHECK_RESULT(vkAllocateDescriptorSets(device, &allocInfo, &descriptorSet));
+		updateCompositionDescriptorSet();
 
 		// Offscreen (scene)
 
@@ -589,7 +651,9 @@ public:
 		// Final fullscreen composition pass pipeline
 		rasterizationState.cullMode = VK_CULL_MODE_FRONT_BIT;
 		shaderStages[0] = loadShader(getShadersPath() + "deferredshadows/deferred.vert.spv", VK_SHADER_STAGE_VERTEX_BIT);
-		shaderStages[1] = loadShader(getShadersPath() + "deferredshadows/deferred.frag.spv", VK_SHADER_STAGE_FRAGMENT_BIT);
+		// The G-buffer layout selects the shaders that write and read it
+		const bool compact = (gbufferLayout == GBufferCompact);
+		shaderStages[1] = loadShader(getShadersPath() + (compact ? "deferredshadows/deferred_compact.frag.spv" : "deferredshadows/deferred.frag.spv"), VK_SHADER_STAGE_FRAGMENT_BIT);
 		// Empty vertex input state, vertices are generated by the vertex shader
 		VkPipelineVertexInputStateCreateInfo emptyInputState = vks::initializers::pipelineVertexInputStateCreateInfo();
 		pipelineCI.pVertexInputState = &emptyInputState;
@@ -606,17 +670,12 @@ public:
 		// Blend attachment states required for all color attachments
 		// This is important, as color write mask will otherwise be 0x0 and you
 		// won't see anything rendered to the attachment
-		std::array<VkPipelineColorBlendAttachmentState, 3> blendAttachmentStates =
-		{
-			vks::initializers::pipelineColorBlendAttachmentState(0xf, VK_FALSE),
-			vks::initializers::pipelineColorBlendAttachmentState(0xf, VK_FALSE),
-			vks::initializers::pipelineColorBlendAttachmentState(0xf, VK_FALSE)
-		};
+		std::vector<VkPipelineColorBlendAttachmentState> blendAttachmentStates(frameBuffers.deferred->attachments.size() - 1, vks::initializers::pipelineColorBlendAttachmentState(0xf, VK_FALSE));
 		colorBlendState.attachmentCount = static_cast<uint32_t>(blendAttachmentStates.size());
 		colorBlendState.pAttachments = blendAttachmentStates.data();
 
 		shaderStages[0] = loadShader(getShadersPath() + "deferredshadows/mrt.vert.spv", VK_SHADER_STAGE_VERTEX_BIT);
-		shaderStages[1] = loadShader(getShadersPath() + "deferredshadows/mrt.frag.spv", VK_SHADER_STAGE_FRAGMENT_BIT);
+		shaderStages[1] = loadShader(getShadersPath() + (compact ? "deferredshadows/mrt_compact.frag.spv" : "deferredshadows/mrt.frag.spv"), VK_SHADER_STAGE_FRAGMENT_BIT);
 		VK_CHECK_RESULT(vkCreateGraphicsPipelines(device, pipelineCache, 1, &pipelineCI, nullptr, &pipelines.offscreen));
 
 		// Shadow mapping pipeline
@@ -739,6 +798,8 @@ public:
 		memcpy(uniformBuffers.shadowGeometryShader.mapped, &uboShadowGeometryShader, sizeof(uboShadowGeometryShader));
 
 		uboComposition.viewPos = glm::vec4(camera.position, 0.0f) * glm::vec4(-1.0f, 1.0f, -1.0f, 1.0f);;
+		uboComposition.view = camera.matrices.view;
+		uboComposition.projection = camera.matrices.perspective;
 		uboComposition.debugDisplayTarget = debugDisplayTarget;
 
 		memcpy(uniformBuffers.composition.mapped, &uboComposition, sizeof(uboComposition));
@@ -810,6 +871,20 @@ public:
 		updateUniformBufferOffscreen();
 	}
 
+	// The attachments and the shaders of the G-buffer and composition pipelines depend on the layout
+	void changeGBufferLayout()
+	{
+		vkDeviceWaitIdle(device);
+		delete frameBuffers.deferred;
+		deferredSetup();
+		vkDestroyPipeline(device, pipelines.deferred, nullptr);
+		vkDestroyPipeline(device, pipelines.offscreen, nullptr);
+		vkDestroyPipeline(device, pipelines.shadowpass, nullptr);
+		preparePipelines();
+		updateCompositionDescriptorSet();
+		buildDeferredCommandBuffer();
+	}
+
 	virtual void OnUpdateUIOverlay(vks::UIOverlay *overlay)
 	{
 		if (overlay->header("Settings")) {
@@ -822,6 +897,18 @@ public:
 				uboComposition.useShadows = shadows;
 				updateUniformBufferDeferredLights();
 			}
+			if (overlay->comboBox("G-buffer", &gbufferLayout, { "Full", "Compact" })) {
+				changeGBufferLayout();
+			}
+		}
+		if (overlay->header("G-buffer")) {
+			// Written by the G-buffer pass plus read by the composition pass
+			overlay->text("%.1f MB per frame", (float)gbufferFrameBytes() / (1024.0f * 1024.0f));
+			for (auto &attachment : frameBuffers.deferred->attachments) {
+				if (attachment.lazilyAllocated) {
+					overlay->text("Lazily allocated: %.1f MB", (float)attachment.memorySize / (1024.0f * 1024.0f));
+				}
+			}
 		}
 	}
 };
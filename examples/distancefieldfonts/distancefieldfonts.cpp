@@ -9,6 +9,7 @@
 */
 
 #include "vulkanexamplebase.h"
+#include "VulkanTextRenderer.h"
 
 #define VERTEX_BUFFER_BIND_ID 0
 #define ENABLE_VALIDATION false
@@ -19,36 +20,14 @@ struct Vertex {
 	float uv[2];
 };
 
-// AngelCode .fnt format structs and classes
-struct bmchar {
-	uint32_t x, y;
-	uint32_t width;
-	uint32_t height;
-	int32_t xoffset;
-	int32_t yoffset;
-	int32_t xadvance;
-	uint32_t page;
-};
-
-// Quick and dirty : complete ASCII table
-// Only chars present in the .fnt are filled with data!
-std::array<bmchar, 255> fontChars;
-
-int32_t nextValuePair(std::stringstream *stream)
-{
-	std::string pair;
-	*stream >> pair;
-	uint32_t spos = pair.find("=");
-	std::string value = pair.substr(spos + 1);
-	int32_t val = std::stoi(value);
-	return val;
-}
-
 class VulkanExample : public VulkanExampleBase
 {
 public:
 	bool splitScreen = true;
 
+	// Glyph metrics of both font atlases, read from an AngelCode bitmap font file
+	vks::FontMetrics fontMetrics;
+
 	struct {
 		vks::Texture2D fontSDF;
 		vks::Texture2D fontBitmap;
@@ -124,61 +103,11 @@ public:
 		uniformBuffers.fs.destroy();
 	}
 
-	// Basic parser for AngelCode bitmap font format files
-	// See http://www.angelcode.com/products/bmfont/doc/file_format.html for details
-	void parsebmFont()
+	void loadFontMetrics()
 	{
-		std::string fileName = getAssetPath() + "font.fnt";
-
-#if defined(__ANDROID__)
-		// Font description file is stored inside the apk
-		// So we need to load it using the asset manager
-		AAsset* asset = AAssetManager_open(androidApp->activity->assetManager, fileName.c_str(), AASSET_MODE_STREAMING);
-		assert(asset);
-		size_t size = AAsset_getLength(asset);
-
-		assert(size > 0);
-
-		void *fileData = malloc(size);
-		AAsset_read(asset, fileData, size);
-		AAsset_close(asset);
-
-		std::stringbuf sbuf((const char*)fileData);
-		std::istream istream(&sbuf);
-#else
-		std::filebuf fileBuffer;
-		fileBuffer.open(fileName, std::ios::in);
-		std::istream istream(&fileBuffer);
-#endif
-
-		assert(istream.good());
-
-		while (!istream.eof())
-		{
-			std::string line;
-			std::stringstream lineStream;
-			std::getline(istream, line);
-			lineStream << line;
-
-			std::string info;
-			lineStream >> info;
-
-			if (info == "char")
-			{
-				// char id
-				uint32_t charid = nextValuePair(&lineStream);
-				// Char properties
-				fontChars[charid].x = nextValuePair(&lineStream);
-				fontChars[charid].y = nextValuePair(&lineStream);
-				fontChars[charid].width = nextValuePair(&lineStream);
-				fontChars[charid].height = nextValuePair(&lineStream);
-				fontChars[charid].xoffset = nextValuePair(&lineStream);
-				fontChars[charid].yoffset = nextValuePair(&lineStream);
-				fontChars[charid].xadvance = nextValuePair(&lineStream);
-				fontChars[charid].page = nextValuePair(&lineStream);
-			}
+		if (!fontMetrics.loadFromFile(getAssetPath() + "font.fnt")) {
+			vks::tools::exitFatal("Could not load font metrics from \"" + getAssetPath() + "font.fnt\"", -1);
 		}
-
 	}
 
 	void loadAssets()
@@ -252,30 +181,37 @@ public:
 		std::vector<uint32_t> indices;
 		uint32_t indexOffset = 0;
 
-		float w = textures.fontSDF.width;
+		// Glyph metrics are in pixels of the 36 pixel font
+		const float fontSize = 36.0f;
 
 		float posx = 0.0f;
 		float posy = 0.0f;
 
 		for (uint32_t i = 0; i < text.size(); i++)
 		{
-			bmchar *charInfo = &fontChars[(int)text[i]];
+			const vks::Glyph *glyph = fontMetrics.glyph(static_cast<uint8_t>(text[i]));
+			if (!glyph)
+				continue;
+
+			float advance = glyph->advance / fontSize;
 
-			if (charInfo->width == 0)
-				charInfo->width = 36;
+			// Whitespace only advances the pen
+			if ((glyph->size.x == 0.0f) || (glyph->size.y == 0.0f))
+			{
+				posx += advance;
+				continue;
+			}
 
-			float charw = ((float)(charInfo->width) / 36.0f);
-			float dimx = 1.0f * charw;
-			float charh = ((float)(charInfo->height) / 36.0f);
-			float dimy = 1.0f * charh;
+			float dimx = glyph->size.x / fontSize;
+			float dimy = glyph->size.y / fontSize;
 
-			float us = charInfo->x / w;
-			float ue = (charInfo->x + charInfo->width) / w;
-			float ts = charInfo->y / w;
-			float te = (charInfo->y + charInfo->height) / w;
+			float us = glyph->uv.x;
+			float ue = glyph->uv.z;
+			float ts = glyph->uv.y;
+			float te = glyph->uv.w;
 
-			float xo = charInfo->xoffset / 36.0f;
-			float yo = charInfo->yoffset / 36.0f;
+			float xo = glyph->offset.x / fontSize;
+			float yo = glyph->offset.y / fontSize;
 
 			posy = yo;
 
@@ -291,7 +227,6 @@ public:
 			}
 			indexOffset += 4;
 
-			float advance = ((float)(charInfo->xadvance) / 36.0f);
 			posx += advance;
 		}
 		indexCount = indices.size();
@@ -621,7 +556,7 @@ public:
 	void prepare()
 	{
 		VulkanExampleBase::prepare();
-		parsebmFont();
+		loadFontMetrics();
 		loadAssets();
 		generateText("Vulkan");
 		setupVertexDescriptions();
@@ -55,6 +55,7 @@ VulkanglTFModel::~VulkanglTFModel()
 	{
 		skin.ssbo.destroy();
 	}
+	sharedJointMatrices.destroy();
 }
 
 /*
@@ -171,6 +172,7 @@ VulkanglTFModel::Node *VulkanglTFModel::nodeFromIndex(uint32_t index)
 void VulkanglTFModel::loadSkins(tinygltf::Model &input)
 {
 	skins.resize(input.skins.size());
+	uint32_t jointCount = 0;
 
 	for (size_t i = 0; i < input.skins.size(); i++)
 	{
@@ -209,7 +211,18 @@ void VulkanglTFModel::loadSkins(tinygltf::Model &input)
 			    skins[i].inverseBindMatrices.data()));
 			VK_CHECK_RESULT(skins[i].ssbo.map());
 		}
+
+		skins[i].jointOffset = jointCount;
+		jointCount += static_cast<uint32_t>(skins[i].joints.size());
 	}
+
+	// Always created, the compute skinning pass binds it even if the model has no skins
+	VK_CHECK_RESULT(vulkanDevice->createBuffer(
+	    VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+	    VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+	    &sharedJointMatrices,
+	    sizeof(glm::mat4) * std::max(jointCount, 1u)));
+	VK_CHECK_RESULT(sharedJointMatrices.map());
 }
 
 // POI: Load the animations from the glTF model
@@ -457,6 +470,8 @@ void VulkanglTFModel::loadNode(const tinygltf::Node &inputNode, const tinygltf::
 			Primitive primitive{};
 			primitive.firstIndex    = firstIndex;
 			primitive.indexCount    = indexCount;
+			primitive.firstVertex   = vertexStart;
+			primitive.vertexCount   = static_cast<uint32_t>(vertexBuffer.size()) - vertexStart;
 			primitive.materialIndex = glTFPrimitive.material;
 			node->mesh.primitives.push_back(primitive);
 		}
@@ -506,6 +521,7 @@ void VulkanglTFModel::updateJoints(VulkanglTFModel::Node *node)
 		}
 		// Update ssbo
 		skin.ssbo.copyTo(jointMatrices.data(), jointMatrices.size() * sizeof(glm::mat4));
+		memcpy(static_cast<glm::mat4 *>(sharedJointMatrices.mapped) + skin.jointOffset, jointMatrices.data(), jointMatrices.size() * sizeof(glm::mat4));
 	}
 
 	for (auto &child : node->children)
@@ -618,11 +634,20 @@ void VulkanglTFModel::drawNode(VkCommandBuffer commandBuffer, VkPipelineLayout p
 }
 
 // Draw the glTF scene starting at the top-level-nodes
-void VulkanglTFModel::draw(VkCommandBuffer commandBuffer, VkPipelineLayout pipelineLayout)
+// If pre-skinned vertices are passed, they are bound to binding 0 and the model's vertices provide the remaining attributes at binding 1
+void VulkanglTFModel::draw(VkCommandBuffer commandBuffer, VkPipelineLayout pipelineLayout, VkBuffer skinnedVertices)
 {
 	// All vertices and indices are stored in single buffers, so we only need to bind once
-	VkDeviceSize offsets[1] = {0};
-	vkCmdBindVertexBuffers(commandBuffer, 0, 1, &vertices.buffer, offsets);
+	VkDeviceSize offsets[2] = {0, 0};
+	if (skinnedVertices != VK_NULL_HANDLE)
+	{
+		const VkBuffer buffers[2] = {skinnedVertices, vertices.buffer};
+		vkCmdBindVertexBuffers(commandBuffer, 0, 2, buffers, offsets);
+	}
+	else
+	{
+		vkCmdBindVertexBuffers(commandBuffer, 0, 1, &vertices.buffer, offsets);
+	}
 	vkCmdBindIndexBuffer(commandBuffer, indices.buffer, 0, VK_INDEX_TYPE_UINT32);
 	// Render all nodes at top-level
 	for (auto &node : nodes)
@@ -656,11 +681,30 @@ VulkanExample::~VulkanExample()
 		vkDestroyPipeline(device, pipelines.wireframe, nullptr);
 	}
 
+	vkDestroyPipeline(device, pipelines.shadow, nullptr);
+	vkDestroyPipeline(device, pipelines.preskinnedSolid, nullptr);
+	if (pipelines.preskinnedWireframe != VK_NULL_HANDLE)
+	{
+		vkDestroyPipeline(device, pipelines.preskinnedWireframe, nullptr);
+	}
+	vkDestroyPipeline(device, pipelines.preskinnedShadow, nullptr);
+
 	vkDestroyPipelineLayout(device, pipelineLayout, nullptr);
 	vkDestroyDescriptorSetLayout(device, descriptorSetLayouts.matrices, nullptr);
 	vkDestroyDescriptorSetLayout(device, descriptorSetLayouts.textures, nullptr);
 	vkDestroyDescriptorSetLayout(device, descriptorSetLayouts.jointMatrices, nullptr);
 
+	vkDestroyPipeline(device, computeSkinning.pipeline, nullptr);
+	vkDestroyPipelineLayout(device, computeSkinning.pipelineLayout, nullptr);
+	vkDestroyDescriptorSetLayout(device, computeSkinning.descriptorSetLayout, nullptr);
+	computeSkinning.jobBuffer.destroy();
+	computeSkinning.skinnedVertices.destroy();
+
+	if (timings.queryPool != VK_NULL_HANDLE)
+	{
+		vkDestroyQueryPool(device, timings.queryPool, nullptr);
+	}
+
 	shaderData.buffer.destroy();
 }
 
@@ -698,19 +742,72 @@ void VulkanExample::buildCommandBuffers()
 	{
 		renderPassBeginInfo.framebuffer = frameBuffers[i];
 		VK_CHECK_RESULT(vkBeginCommandBuffer(drawCmdBuffers[i], &cmdBufInfo));
+
+		// Three timestamps per command buffer: start, after skinning, after the render pass
+		const uint32_t firstQuery = i * 3;
+		if (timings.queryPool != VK_NULL_HANDLE)
+		{
+			vkCmdResetQueryPool(drawCmdBuffers[i], timings.queryPool, firstQuery, 3);
+			vkCmdWriteTimestamp(drawCmdBuffers[i], VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, timings.queryPool, firstQuery);
+		}
+
+		// POI: Skin the vertices of all primitives once in a single dispatch, every later pass uses the result
+		if (skinningMode == SkinningCompute)
+		{
+			const uint32_t inputStride = sizeof(VulkanglTFModel::Vertex) / sizeof(float);
+			vkCmdBindPipeline(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_COMPUTE, computeSkinning.pipeline);
+			vkCmdBindDescriptorSets(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_COMPUTE, computeSkinning.pipelineLayout, 0, 1, &computeSkinning.descriptorSet, 0, nullptr);
+			vkCmdPushConstants(drawCmdBuffers[i], computeSkinning.pipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(uint32_t), &inputStride);
+			vkCmdDispatch(drawCmdBuffers[i], (computeSkinning.maxJobVertices + 63) / 64, static_cast<uint32_t>(computeSkinning.jobs.size()), 1);
+
+			VkMemoryBarrier memoryBarrier = vks::initializers::memoryBarrier();
+			memoryBarrier.srcAccessMask   = VK_ACCESS_SHADER_WRITE_BIT;
+			memoryBarrier.dstAccessMask   = VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT;
+			vkCmdPipelineBarrier(drawCmdBuffers[i], VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_VERTEX_INPUT_BIT, 0, 1, &memoryBarrier, 0, nullptr, 0, nullptr);
+		}
+		if (timings.queryPool != VK_NULL_HANDLE)
+		{
+			vkCmdWriteTimestamp(drawCmdBuffers[i], VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, timings.queryPool, firstQuery + 1);
+		}
+
 		vkCmdBeginRenderPass(drawCmdBuffers[i], &renderPassBeginInfo, VK_SUBPASS_CONTENTS_INLINE);
 		vkCmdSetViewport(drawCmdBuffers[i], 0, 1, &viewport);
 		vkCmdSetScissor(drawCmdBuffers[i], 0, 1, &scissor);
-		// Bind scene matrices descriptor to set 0
-		vkCmdBindDescriptorSets(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 0, 1, &descriptorSet, 0, nullptr);
-		vkCmdBindPipeline(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, wireframe ? pipelines.wireframe : pipelines.solid);
-		glTFModel.draw(drawCmdBuffers[i], pipelineLayout);
+		drawScene(drawCmdBuffers[i]);
 		drawUI(drawCmdBuffers[i]);
 		vkCmdEndRenderPass(drawCmdBuffers[i]);
+
+		if (timings.queryPool != VK_NULL_HANDLE)
+		{
+			vkCmdWriteTimestamp(drawCmdBuffers[i], VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, timings.queryPool, firstQuery + 2);
+		}
 		VK_CHECK_RESULT(vkEndCommandBuffer(drawCmdBuffers[i]));
 	}
 }
 
+void VulkanExample::drawScene(VkCommandBuffer commandBuffer)
+{
+	// Bind scene matrices descriptor to set 0
+	vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 0, 1, &descriptorSet, 0, nullptr);
+	// Pre-skinned vertices are drawn like static geometry, otherwise each pass skins the vertices in its vertex shader
+	const bool     preskinned      = (skinningMode == SkinningCompute);
+	const VkBuffer skinnedVertices = preskinned ? computeSkinning.skinnedVertices.buffer : VK_NULL_HANDLE;
+	if (planarShadow)
+	{
+		vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, preskinned ? pipelines.preskinnedShadow : pipelines.shadow);
+		glTFModel.draw(commandBuffer, pipelineLayout, skinnedVertices);
+	}
+	if (preskinned)
+	{
+		vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, wireframe ? pipelines.preskinnedWireframe : pipelines.preskinnedSolid);
+	}
+	else
+	{
+		vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, wireframe ? pipelines.wireframe : pipelines.solid);
+	}
+	glTFModel.draw(commandBuffer, pipelineLayout, skinnedVertices);
+}
+
 void VulkanExample::loadglTFFile(std::string filename)
 {
 	tinygltf::Model    glTFInput;
@@ -787,8 +884,9 @@ void VulkanExample::loadglTFFile(std::string filename)
 	    indexBuffer.data()));
 
 	// Create device local buffers (target)
+	// The compute skinning pass reads the vertices from a storage buffer
 	VK_CHECK_RESULT(vulkanDevice->createBuffer(
-	    VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+	    VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
 	    VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
 	    vertexBufferSize,
 	    &glTFModel.vertices.buffer,
@@ -826,11 +924,11 @@ void VulkanExample::setupDescriptors()
 	    vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 1),
 	    // One combined image sampler per material image/texture
 	    vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, static_cast<uint32_t>(glTFModel.images.size())),
-	    // One ssbo per skin
-	    vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, static_cast<uint32_t>(glTFModel.skins.size())),
+	    // One ssbo per skin and four for compute skinning
+	    vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, static_cast<uint32_t>(glTFModel.skins.size()) + 4),
 	};
-	// Number of descriptor sets = One for the scene ubo + one per image + one per skin
-	const uint32_t             maxSetCount        = static_cast<uint32_t>(glTFModel.images.size()) + static_cast<uint32_t>(glTFModel.skins.size()) + 1;
+	// Number of descriptor sets = One for the scene ubo + one per image + one per skin + one for compute skinning
+	const uint32_t             maxSetCount        = static_cast<uint32_t>(glTFModel.images.size()) + static_cast<uint32_t>(glTFModel.skins.size()) + 2;
 	VkDescriptorPoolCreateInfo descriptorPoolInfo = vks::initializers::descriptorPoolCreateInfo(poolSizes, maxSetCount);
 	VK_CHECK_RESULT(vkCreateDescriptorPool(device, &descriptorPoolInfo, nullptr, &descriptorPool));
 
@@ -890,6 +988,38 @@ void VulkanExample::setupDescriptors()
 		VkWriteDescriptorSet writeDescriptorSet = vks::initializers::writeDescriptorSet(image.descriptorSet, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 0, &image.texture.descriptor);
 		vkUpdateDescriptorSets(device, 1, &writeDescriptorSet, 0, nullptr);
 	}
+
+	// Compute skinning
+	// Binding 0 = Jobs
+	// Binding 1 = Joint matrices of all skins
+	// Binding 2 = Model vertices
+	// Binding 3 = Skinned vertices
+	const std::vector<VkDescriptorSetLayoutBinding> computeSetLayoutBindings = {
+	    vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT, 0),
+	    vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT, 1),
+	    vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT, 2),
+	    vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT, 3),
+	};
+	descriptorSetLayoutCI = vks::initializers::descriptorSetLayoutCreateInfo(computeSetLayoutBindings);
+	VK_CHECK_RESULT(vkCreateDescriptorSetLayout(device, &descriptorSetLayoutCI, nullptr, &computeSkinning.descriptorSetLayout));
+
+	VkPipelineLayoutCreateInfo computePipelineLayoutCI = vks::initializers::pipelineLayoutCreateInfo(&computeSkinning.descriptorSetLayout, 1);
+	// Vertex stride of the model's vertices in floats
+	VkPushConstantRange computePushConstantRange     = vks::initializers::pushConstantRange(VK_SHADER_STAGE_COMPUTE_BIT, sizeof(uint32_t), 0);
+	computePipelineLayoutCI.pushConstantRangeCount   = 1;
+	computePipelineLayoutCI.pPushConstantRanges      = &computePushConstantRange;
+	VK_CHECK_RESULT(vkCreatePipelineLayout(device, &computePipelineLayoutCI, nullptr, &computeSkinning.pipelineLayout));
+
+	allocInfo = vks::initializers::descriptorSetAllocateInfo(descriptorPool, &computeSkinning.descriptorSetLayout, 1);
+	VK_CHECK_RESULT(vkAllocateDescriptorSets(device, &allocInfo, &computeSkinning.descriptorSet));
+	VkDescriptorBufferInfo                  modelVerticesDescriptor = {glTFModel.vertices.buffer, 0, VK_WHOLE_SIZE};
+	const std::vector<VkWriteDescriptorSet> computeWriteDescriptorSets = {
+	    vks::initializers::writeDescriptorSet(computeSkinning.descriptorSet, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 0, &computeSkinning.jobBuffer.descriptor),
+	    vks::initializers::writeDescriptorSet(computeSkinning.descriptorSet, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1, &glTFModel.sharedJointMatrices.descriptor),
+	    vks::initializers::writeDescriptorSet(computeSkinning.descriptorSet, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 2, &modelVerticesDescriptor),
+	    vks::initializers::writeDescriptorSet(computeSkinning.descriptorSet, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 3, &computeSkinning.skinnedVertices.descriptor),
+	};
+	vkUpdateDescriptorSets(device, static_cast<uint32_t>(computeWriteDescriptorSets.size()), computeWriteDescriptorSets.data(), 0, nullptr);
 }
 
 void VulkanExample::preparePipelines()
@@ -923,10 +1053,15 @@ void VulkanExample::preparePipelines()
 	vertexInputStateCI.vertexAttributeDescriptionCount      = static_cast<uint32_t>(vertexInputAttributes.size());
 	vertexInputStateCI.pVertexAttributeDescriptions         = vertexInputAttributes.data();
 
-	const std::array<VkPipelineShaderStageCreateInfo, 2> shaderStages = {
+	std::array<VkPipelineShaderStageCreateInfo, 2> shaderStages = {
 	    loadShader(getShadersPath() + "gltfskinning/skinnedmodel.vert.spv", VK_SHADER_STAGE_VERTEX_BIT),
 	    loadShader(getShadersPath() + "gltfskinning/skinnedmodel.frag.spv", VK_SHADER_STAGE_FRAGMENT_BIT)};
 
+	// The planar shadow variants of the vertex shaders are selected with a specialization constant
+	const VkBool32                 planarShadowConstant = VK_TRUE;
+	const VkSpecializationMapEntry specializationMapEntry = vks::initializers::specializationMapEntry(0, 0, sizeof(VkBool32));
+	const VkSpecializationInfo     specializationInfo     = vks::initializers::specializationInfo(1, &specializationMapEntry, sizeof(VkBool32), &planarShadowConstant);
+
 	VkGraphicsPipelineCreateInfo pipelineCI = vks::initializers::pipelineCreateInfo(pipelineLayout, renderPass, 0);
 	pipelineCI.pVertexInputState            = &vertexInputStateCI;
 	pipelineCI.pInputAssemblyState          = &inputAssemblyStateCI;
@@ -948,7 +1083,56 @@ void VulkanExample::preparePipelines()
 		rasterizationStateCI.polygonMode = VK_POLYGON_MODE_LINE;
 		rasterizationStateCI.lineWidth   = 1.0f;
 		VK_CHECK_RESULT(vkCreateGraphicsPipelines(device, pipelineCache, 1, &pipelineCI, nullptr, &pipelines.wireframe));
+		rasterizationStateCI.polygonMode = VK_POLYGON_MODE_FILL;
 	}
+
+	// Planar shadow pipeline, skins the vertices a second time
+	// The flattened geometry is seen from both sides, so culling is disabled
+	rasterizationStateCI.cullMode = VK_CULL_MODE_NONE;
+	shaderStages[0].pSpecializationInfo = &specializationInfo;
+	shaderStages[1] = loadShader(getShadersPath() + "gltfskinning/shadow.frag.spv", VK_SHADER_STAGE_FRAGMENT_BIT);
+	VK_CHECK_RESULT(vkCreateGraphicsPipelines(device, pipelineCache, 1, &pipelineCI, nullptr, &pipelines.shadow));
+
+	// POI: Pipelines for the vertices skinned by the compute shader
+	// Positions and normals come from the skinned vertex buffer, the remaining attributes from the model's vertex buffer
+	const std::vector<VkVertexInputBindingDescription> preskinnedVertexInputBindings = {
+	    vks::initializers::vertexInputBindingDescription(0, sizeof(float) * 6, VK_VERTEX_INPUT_RATE_VERTEX),
+	    vks::initializers::vertexInputBindingDescription(1, sizeof(VulkanglTFModel::Vertex), VK_VERTEX_INPUT_RATE_VERTEX),
+	};
+	const std::vector<VkVertexInputAttributeDescription> preskinnedVertexInputAttributes = {
+	    {0, 0, VK_FORMAT_R32G32B32_SFLOAT, 0},
+	    {1, 0, VK_FORMAT_R32G32B32_SFLOAT, sizeof(float) * 3},
+	    {2, 1, VK_FORMAT_R32G32_SFLOAT, offsetof(VulkanglTFModel::Vertex, uv)},
+	    {3, 1, VK_FORMAT_R32G32B32_SFLOAT, offsetof(VulkanglTFModel::Vertex, color)},
+	};
+	vertexInputStateCI.vertexBindingDescriptionCount   = static_cast<uint32_t>(preskinnedVertexInputBindings.size());
+	vertexInputStateCI.pVertexBindingDescriptions      = preskinnedVertexInputBindings.data();
+	vertexInputStateCI.vertexAttributeDescriptionCount = static_cast<uint32_t>(preskinnedVertexInputAttributes.size());
+	vertexInputStateCI.pVertexAttributeDescriptions    = preskinnedVertexInputAttributes.data();
+
+	// Planar shadow
+	shaderStages[0] = loadShader(getShadersPath() + "gltfskinning/preskinned.vert.spv", VK_SHADER_STAGE_VERTEX_BIT);
+	shaderStages[0].pSpecializationInfo = &specializationInfo;
+	VK_CHECK_RESULT(vkCreateGraphicsPipelines(device, pipelineCache, 1, &pipelineCI, nullptr, &pipelines.preskinnedShadow));
+
+	// Solid
+	rasterizationStateCI.cullMode = VK_CULL_MODE_BACK_BIT;
+	shaderStages[0].pSpecializationInfo = nullptr;
+	shaderStages[1] = loadShader(getShadersPath() + "gltfskinning/skinnedmodel.frag.spv", VK_SHADER_STAGE_FRAGMENT_BIT);
+	VK_CHECK_RESULT(vkCreateGraphicsPipelines(device, pipelineCache, 1, &pipelineCI, nullptr, &pipelines.preskinnedSolid));
+
+	// Wire frame
+	if (deviceFeatures.fillModeNonSolid)
+	{
+		rasterizationStateCI.polygonMode = VK_POLYGON_MODE_LINE;
+		rasterizationStateCI.lineWidth   = 1.0f;
+		VK_CHECK_RESULT(vkCreateGraphicsPipelines(device, pipelineCache, 1, &pipelineCI, nullptr, &pipelines.preskinnedWireframe));
+	}
+
+	// Compute skinning pipeline
+	VkComputePipelineCreateInfo computePipelineCI = vks::initializers::computePipelineCreateInfo(computeSkinning.pipelineLayout, 0);
+	computePipelineCI.stage                       = loadShader(getShadersPath() + "gltfskinning/skinning.comp.spv", VK_SHADER_STAGE_COMPUTE_BIT);
+	VK_CHECK_RESULT(vkCreateComputePipelines(device, pipelineCache, 1, &computePipelineCI, nullptr, &computeSkinning.pipeline));
 }
 
 void VulkanExample::prepareUniformBuffers()
@@ -970,10 +1154,95 @@ void VulkanExample::loadAssets()
 	loadglTFFile(getAssetPath() + "models/CesiumMan/glTF/CesiumMan.gltf");
 }
 
+/*
+	Compute skinning
+*/
+
+void VulkanExample::prepareComputeSkinning()
+{
+	// One job per primitive of all mesh nodes, primitives of nodes without a skin are copied unchanged
+	computeSkinning.jobs.clear();
+	computeSkinning.maxJobVertices     = 0;
+	computeSkinning.skinnedVertexCount = 0;
+	uint32_t                             vertexCount = 0;
+	std::vector<VulkanglTFModel::Node *> nodeStack(glTFModel.nodes.begin(), glTFModel.nodes.end());
+	while (!nodeStack.empty())
+	{
+		VulkanglTFModel::Node *node = nodeStack.back();
+		nodeStack.pop_back();
+		nodeStack.insert(nodeStack.end(), node->children.begin(), node->children.end());
+		for (VulkanglTFModel::Primitive &primitive : node->mesh.primitives)
+		{
+			ComputeSkinning::Job job;
+			job.firstVertex = primitive.firstVertex;
+			job.vertexCount = primitive.vertexCount;
+			job.jointOffset = node->skin > -1 ? glTFModel.skins[node->skin].jointOffset : 0;
+			job.skinned     = node->skin > -1 ? 1 : 0;
+			computeSkinning.jobs.push_back(job);
+			computeSkinning.maxJobVertices = std::max(computeSkinning.maxJobVertices, job.vertexCount);
+			if (job.skinned)
+			{
+				computeSkinning.skinnedVertexCount += job.vertexCount;
+			}
+			vertexCount = std::max(vertexCount, job.firstVertex + job.vertexCount);
+		}
+	}
+	if (computeSkinning.jobs.empty())
+	{
+		vks::tools::exitFatal("The glTF model contains no mesh primitives", -1);
+	}
+
+	// To keep this sample simple, the jobs are stored in a host visible buffer
+	VK_CHECK_RESULT(vulkanDevice->createBuffer(
+	    VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+	    VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+	    &computeSkinning.jobBuffer,
+	    sizeof(ComputeSkinning::Job) * computeSkinning.jobs.size(),
+	    computeSkinning.jobs.data()));
+
+	// Output vertex buffer with a skinned position and normal per model vertex, written once per frame and read by all passes
+	VK_CHECK_RESULT(vulkanDevice->createBuffer(
+	    VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT,
+	    VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+	    &computeSkinning.skinnedVertices,
+	    sizeof(float) * 6 * vertexCount));
+
+	// Timestamps for the skinning and render pass times, if the graphics queue supports them
+	uint32_t queueFamilyCount;
+	vkGetPhysicalDeviceQueueFamilyProperties(physicalDevice, &queueFamilyCount, nullptr);
+	std::vector<VkQueueFamilyProperties> queueFamilyProperties(queueFamilyCount);
+	vkGetPhysicalDeviceQueueFamilyProperties(physicalDevice, &queueFamilyCount, queueFamilyProperties.data());
+	if (queueFamilyProperties[vulkanDevice->queueFamilyIndices.graphics].timestampValidBits > 0)
+	{
+		VkQueryPoolCreateInfo queryPoolCI = {};
+		queryPoolCI.sType                 = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+		queryPoolCI.queryType             = VK_QUERY_TYPE_TIMESTAMP;
+		queryPoolCI.queryCount            = static_cast<uint32_t>(drawCmdBuffers.size()) * 3;
+		VK_CHECK_RESULT(vkCreateQueryPool(device, &queryPoolCI, nullptr, &timings.queryPool));
+	}
+}
+
+void VulkanExample::readTimings()
+{
+	if (timings.queryPool == VK_NULL_HANDLE)
+	{
+		return;
+	}
+	// The frame has finished on the device once renderFrame returns
+	uint64_t timestamps[3];
+	if (vkGetQueryPoolResults(device, timings.queryPool, currentBuffer * 3, 3, sizeof(timestamps), timestamps, sizeof(uint64_t), VK_QUERY_RESULT_64_BIT) == VK_SUCCESS)
+	{
+		const float timestampPeriod = vulkanDevice->properties.limits.timestampPeriod;
+		timings.skinning            = static_cast<float>(timestamps[1] - timestamps[0]) * timestampPeriod / 1000000.0f;
+		timings.passes              = static_cast<float>(timestamps[2] - timestamps[1]) * timestampPeriod / 1000000.0f;
+	}
+}
+
 void VulkanExample::prepare()
 {
 	VulkanExampleBase::prepare();
 	loadAssets();
+	prepareComputeSkinning();
 	prepareUniformBuffers();
 	setupDescriptors();
 	preparePipelines();
@@ -984,6 +1253,7 @@ void VulkanExample::prepare()
 void VulkanExample::render()
 {
 	renderFrame();
+	readTimings();
 	if (camera.updated)
 	{
 		updateUniformBuffers();
@@ -1008,6 +1278,26 @@ void VulkanExample::OnUpdateUIOverlay(vks::UIOverlay *overlay)
 		{
 			buildCommandBuffers();
 		}
+		if (overlay->comboBox("Skinning", &skinningMode, {"Vertex shader", "Compute"}))
+		{
+			buildCommandBuffers();
+		}
+		if (overlay->checkBox("Planar shadow", &planarShadow))
+		{
+			buildCommandBuffers();
+		}
+	}
+	if (overlay->header("Statistics"))
+	{
+		// The vertex shader path skins every vertex once per pass
+		const uint32_t passCount = planarShadow ? 2 : 1;
+		const uint32_t skinned   = computeSkinning.skinnedVertexCount * (skinningMode == SkinningCompute ? 1 : passCount);
+		overlay->text("Skinned vertices per frame: %d", skinned);
+		if (timings.queryPool != VK_NULL_HANDLE)
+		{
+			overlay->text("Skinning dispatch: %.3f ms", timings.skinning);
+			overlay->text("Render pass: %.3f ms", timings.passes);
+		}
 	}
 }
 
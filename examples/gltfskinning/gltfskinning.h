@@ -88,6 +88,8 @@ class VulkanglTFModel
 	{
 		uint32_t firstIndex;
 		uint32_t indexCount;
+		uint32_t firstVertex;
+		uint32_t vertexCount;
 		int32_t  materialIndex;
 	};
 
@@ -132,6 +134,8 @@ class VulkanglTFModel
 		std::vector<Node *>    joints;
 		vks::Buffer            ssbo;
 		VkDescriptorSet        descriptorSet;
+		// First matrix of this skin in the shared joint matrix buffer
+		uint32_t               jointOffset = 0;
 	};
 
 	/*
@@ -169,6 +173,9 @@ class VulkanglTFModel
 	std::vector<Skin>      skins;
 	std::vector<Animation> animations;
 
+	// Joint matrices of all skins in one buffer, so compute skinning can skin all meshes in a single dispatch
+	vks::Buffer sharedJointMatrices;
+
 	uint32_t activeAnimation = 0;
 
 	~VulkanglTFModel();
@@ -184,13 +191,23 @@ class VulkanglTFModel
 	void      updateJoints(VulkanglTFModel::Node *node);
 	void      updateAnimation(float deltaTime);
 	void      drawNode(VkCommandBuffer commandBuffer, VkPipelineLayout pipelineLayout, VulkanglTFModel::Node node);
-	void      draw(VkCommandBuffer commandBuffer, VkPipelineLayout pipelineLayout);
+	void      draw(VkCommandBuffer commandBuffer, VkPipelineLayout pipelineLayout, VkBuffer skinnedVertices = VK_NULL_HANDLE);
 };
 
 class VulkanExample : public VulkanExampleBase
 {
   public:
 	bool wireframe = false;
+	// Draws the model a second time flattened onto the ground, so every skinned vertex is used by two passes
+	bool planarShadow = true;
+
+	// POI: With compute skinning, the vertices are skinned once per frame and all passes draw the result as static geometry
+	enum SkinningMode
+	{
+		SkinningVertexShader = 0,
+		SkinningCompute      = 1
+	};
+	int32_t skinningMode = SkinningCompute;
 
 	struct ShaderData
 	{
@@ -208,8 +225,43 @@ class VulkanExample : public VulkanExampleBase
 	{
 		VkPipeline solid;
 		VkPipeline wireframe = VK_NULL_HANDLE;
+		VkPipeline shadow;
+		// Draw the pre-skinned vertices
+		VkPipeline preskinnedSolid;
+		VkPipeline preskinnedWireframe = VK_NULL_HANDLE;
+		VkPipeline preskinnedShadow;
 	} pipelines;
 
+	struct ComputeSkinning
+	{
+		// One job per primitive, the dispatch has one row of workgroups per job
+		struct Job
+		{
+			uint32_t firstVertex;
+			uint32_t vertexCount;
+			uint32_t jointOffset;
+			uint32_t skinned;
+		};
+		std::vector<Job>      jobs;
+		uint32_t              maxJobVertices = 0;
+		uint32_t              skinnedVertexCount = 0;
+		vks::Buffer           jobBuffer;
+		// Skinned positions and normals, parallel to the model's vertex buffer
+		vks::Buffer           skinnedVertices;
+		VkDescriptorSetLayout descriptorSetLayout;
+		VkDescriptorSet       descriptorSet;
+		VkPipelineLayout      pipelineLayout;
+		VkPipeline            pipeline;
+	} computeSkinning;
+
+	// GPU times of the skinning dispatch and the render pass in milliseconds
+	struct Timings
+	{
+		VkQueryPool queryPool = VK_NULL_HANDLE;
+		float       skinning  = 0.0f;
+		float       passes    = 0.0f;
+	} timings;
+
 	struct DescriptorSetLayouts
 	{
 		VkDescriptorSetLayout matrices;
@@ -225,7 +277,10 @@ class VulkanExample : public VulkanExampleBase
 	void         loadglTFFile(std::string filename);
 	virtual void getEnabledFeatures();
 	void         buildCommandBuffers();
+	void         drawScene(VkCommandBuffer commandBuffer);
 	void         loadAssets();
+	void         prepareComputeSkinning();
+	void         readTimings();
 	void         setupDescriptors();
 	void         preparePipelines();
 	void         prepareUniformBuffers();
@@ -13,14 +13,30 @@
 
 #define ENABLE_VALIDATION false
 
+// Edge length of the 3D colour grading LUT
+#define GRADING_LUT_SIZE 32
+// Number of separate passes the post processing is split into for the chained comparison mode
+#define POST_CHAIN_PASSES 4
+
 class VulkanExample : public VulkanExampleBase
 {
 public:
 	bool bloom = true;
 	bool displaySkybox = true;
 
+	// Post processing either runs as a single fused compute pass or as a chain of separate passes for comparison
+	enum PostMode { PostFused = 0, PostChained = 1 };
+	int32_t postMode = PostFused;
+	std::vector<std::string> postModeNames = { "Fused", "Chained" };
+	std::vector<std::string> tonemapperNames = { "Exponential", "Reinhard", "ACES", "Uncharted 2" };
+	enum GradingPreset { GradingNeutral = 0, GradingWarm = 1, GradingCool = 2, GradingBleachBypass = 3 };
+	int32_t gradingPreset = GradingWarm;
+	std::vector<std::string> gradingPresetNames = { "Neutral", "Warm", "Cool", "Bleach bypass" };
+
 	struct {
 		vks::TextureCubeMap envmap;
+		// Generated 3D colour grading LUT
+		vks::Texture lut;
 	} textures;
 
 	struct Models {
@@ -40,21 +56,55 @@ public:
 		glm::mat4 inverseModelview;
 	} uboVS;
 
+	// Shared by the auto exposure and post processing compute shaders
 	struct UBOParams {
+		// Used instead of the adapted exposure if auto exposure is disabled
 		float exposure = 1.0f;
+		// Exposure maps the adapted average luminance to this value
+		float exposureKey = 0.18f;
+		// Log2 luminance range covered by the histogram
+		float minLogLuminance = -8.0f;
+		float logLuminanceRange = 12.0f;
+		float adaptationRate = 1.5f;
+		float deltaTime = 0.0f;
+		float gradingStrength = 1.0f;
+		float vignette = 0.35f;
+		int32_t autoExposure = 1;
+		int32_t tonemapper = 2;
+		int32_t bloom = 1;
+		int32_t dither = 1;
+		uint32_t pixelCount = 0;
 	} uboParams;
 
+	struct {
+		// Luminance histogram, cleared by the exposure pass after it has been read
+		vks::Buffer histogram;
+		// Adapted average luminance and the resulting exposure, host visible for display
+		vks::Buffer adaptation;
+	} storageBuffers;
+
+	struct Adaptation {
+		float luminance;
+		float exposure;
+	};
+
 	struct {
 		VkPipeline skybox;
 		VkPipeline reflect;
 		VkPipeline composition;
-		VkPipeline bloom[2];
+		VkPipeline bloom;
+		VkPipeline histogram;
+		VkPipeline exposure;
+		VkPipeline postFused;
+		std::array<VkPipeline, POST_CHAIN_PASSES> postChain;
 	} pipelines;
 
 	struct {
 		VkPipelineLayout models;
 		VkPipelineLayout composition;
 		VkPipelineLayout bloomFilter;
+		VkPipelineLayout autoExposure;
+		VkPipelineLayout post;
 	} pipelineLayouts;
 
 	struct {
@@ -62,12 +112,17 @@ public:
 		VkDescriptorSet skybox;
 		VkDescriptorSet composition;
 		VkDescriptorSet bloomFilter;
+		VkDescriptorSet autoExposure;
+		VkDescriptorSet postFused;
+		std::array<VkDescriptorSet, POST_CHAIN_PASSES> postChain;
 	} descriptorSets;
 
 	struct {
 		VkDescriptorSetLayout models;
 		VkDescriptorSetLayout composition;
 		VkDescriptorSetLayout bloomFilter;
+		VkDescriptorSetLayout autoExposure;
+		VkDescriptorSetLayout post;
 	} descriptorSetLayouts;
 
 	// Framebuffer for offscreen rendering
@@ -100,6 +155,20 @@ public:
 		VkSampler sampler;
 	} filterPass;
 
+	// Storage images written by the post processing compute passes, kept in general layout
+	struct {
+		FrameBufferAttachment output;
+		// Ping-pong targets between the passes of the chained comparison mode
+		FrameBufferAttachment intermediate[2];
+	} postTargets;
+
+	// GPU times of the scene and bloom filter passes, the auto exposure, the post processing and the presentation in milliseconds
+	enum Stage { StageScene = 0, StageAutoExposure = 1, StagePost = 2, StagePresent = 3, StageCount = 4 };
+	struct Timings {
+		VkQueryPool queryPool = VK_NULL_HANDLE;
+		std::array<float, StageCount> stages = {};
+	} timings;
+
 	std::vector<std::string> objectNames;
 
 	VulkanExample() : VulkanExampleBase(ENABLE_VALIDATION)
@@ -116,16 +185,25 @@ public:
 		vkDestroyPipeline(device, pipelines.skybox, nullptr);
 		vkDestroyPipeline(device, pipelines.reflect, nullptr);
 		vkDestroyPipeline(device, pipelines.composition, nullptr);
-		vkDestroyPipeline(device, pipelines.bloom[0], nullptr);
-		vkDestroyPipeline(device, pipelines.bloom[1], nullptr);
+		vkDestroyPipeline(device, pipelines.bloom, nullptr);
+		vkDestroyPipeline(device, pipelines.histogram, nullptr);
+		vkDestroyPipeline(device, pipelines.exposure, nullptr);
+		vkDestroyPipeline(device, pipelines.postFused, nullptr);
+		for (VkPipeline pipeline : pipelines.postChain) {
+			vkDestroyPipeline(device, pipeline, nullptr);
+		}
 
 		vkDestroyPipelineLayout(device, pipelineLayouts.models, nullptr);
 		vkDestroyPipelineLayout(device, pipelineLayouts.composition, nullptr);
 		vkDestroyPipelineLayout(device, pipelineLayouts.bloomFilter, nullptr);
+		vkDestroyPipelineLayout(device, pipelineLayouts.autoExposure, nullptr);
+		vkDestroyPipelineLayout(device, pipelineLayouts.post, nullptr);
 
 		vkDestroyDescriptorSetLayout(device, descriptorSetLayouts.models, nullptr);
 		vkDestroyDescriptorSetLayout(device, descriptorSetLayouts.composition, nullptr);
 		vkDestroyDescriptorSetLayout(device, descriptorSetLayouts.bloomFilter, nullptr);
+		vkDestroyDescriptorSetLayout(device, descriptorSetLayouts.autoExposure, nullptr);
+		vkDestroyDescriptorSetLayout(device, descriptorSetLayouts.post, nullptr);
 
 		vkDestroyRenderPass(device, offscreen.renderPass, nullptr);
 		vkDestroyRenderPass(device, filterPass.renderPass, nullptr);
@@ -142,9 +220,49 @@ public:
 
 		filterPass.color[0].destroy(device);
 
+		postTargets.output.destroy(device);
+		postTargets.intermediate[0].destroy(device);
+		postTargets.intermediate[1].destroy(device);
+
+		if (timings.queryPool != VK_NULL_HANDLE) {
+			vkDestroyQueryPool(device, timings.queryPool, nullptr);
+		}
+
 		uniformBuffers.matrices.destroy();
 		uniformBuffers.params.destroy();
+		storageBuffers.histogram.destroy();
+		storageBuffers.adaptation.destroy();
 		textures.envmap.destroy();
+		textures.lut.destroy();
+	}
+
+	// Timestamps are written before and after every stage of each command buffer, there's one command buffer per swapchain image
+	void prepareTimestamps()
+	{
+		if (vulkanDevice->queueFamilyProperties[vulkanDevice->queueFamilyIndices.graphics].timestampValidBits == 0) {
+			return;
+		}
+		VkQueryPoolCreateInfo queryPoolCI = {};
+		queryPoolCI.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+		queryPoolCI.queryType = VK_QUERY_TYPE_TIMESTAMP;
+		queryPoolCI.queryCount = swapChain.imageCount * (StageCount + 1);
+		VK_CHECK_RESULT(vkCreateQueryPool(device, &queryPoolCI, nullptr, &timings.queryPool));
+	}
+
+	// Makes compute shader writes visible to the following dispatches or the presentation pass
+	void computeBarrier(VkCommandBuffer commandBuffer, VkPipelineStageFlags dstStageMask)
+	{
+		VkMemoryBarrier memoryBarrier = vks::initializers::memoryBarrier();
+		memoryBarrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+		memoryBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+		vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, dstStageMask, 0, 1, &memoryBarrier, 0, nullptr, 0, nullptr);
+	}
+
+	void dispatchPost(VkCommandBuffer commandBuffer, VkPipeline pipeline, VkDescriptorSet descriptorSet)
+	{
+		vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipeline);
+		vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipelineLayouts.post, 0, 1, &descriptorSet, 0, nullptr);
+		vkCmdDispatch(commandBuffer, (offscreen.width + 7) / 8, (offscreen.height + 7) / 8, 1);
 	}
 
 	void buildCommandBuffers()
@@ -162,13 +280,16 @@ public:
 		renderPassBeginInfo.clearValueCount = 2;
 		renderPassBeginInfo.pClearValues = clearValues;
 
-		VkViewport viewport;
-		VkRect2D scissor;
-
 		for (int32_t i = 0; i < drawCmdBuffers.size(); ++i)
 		{
 			VK_CHECK_RESULT(vkBeginCommandBuffer(drawCmdBuffers[i], &cmdBufInfo));
 
+			const uint32_t firstQuery = i * (StageCount + 1);
+			if (timings.queryPool != VK_NULL_HANDLE) {
+				vkCmdResetQueryPool(drawCmdBuffers[i], timings.queryPool, firstQuery, StageCount + 1);
+				vkCmdWriteTimestamp(drawCmdBuffers[i], VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, timings.queryPool, firstQuery);
+			}
+
 			{
 				/*
 					First pass: Render scene to offscreen framebuffer
@@ -244,18 +365,58 @@ public:
 
 				vkCmdBindDescriptorSets(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayouts.bloomFilter, 0, 1, &descriptorSets.bloomFilter, 0, NULL);
 
-				vkCmdBindPipeline(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pipelines.bloom[1]);
+				vkCmdBindPipeline(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pipelines.bloom);
 				vkCmdDraw(drawCmdBuffers[i], 3, 1, 0, 0);
 
 				vkCmdEndRenderPass(drawCmdBuffers[i]);
 			}
 
 			/*
-				Note: Explicit synchronization is not required between the render pass, as this is done implicit via sub pass dependencies
+				Note: Explicit synchronization is not required between the render passes and the compute passes reading their results, as this is done implicit via sub pass dependencies
 			*/
 
+			if (timings.queryPool != VK_NULL_HANDLE) {
+				vkCmdWriteTimestamp(drawCmdBuffers[i], VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, timings.queryPool, firstQuery + 1);
+			}
+
 			/*
-				Third render pass: Scene rendering with applied second bloom pass (when enabled)
+				Auto exposure: Luminance histogram of the HDR scene, reduced to the temporally adapted exposure by a single workgroup
+			*/
+			if (uboParams.autoExposure == 1) {
+				vkCmdBindPipeline(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_COMPUTE, pipelines.histogram);
+				vkCmdBindDescriptorSets(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_COMPUTE, pipelineLayouts.autoExposure, 0, 1, &descriptorSets.autoExposure, 0, nullptr);
+				vkCmdDispatch(drawCmdBuffers[i], (offscreen.width + 15) / 16, (offscreen.height + 15) / 16, 1);
+				computeBarrier(drawCmdBuffers[i], VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT);
+				vkCmdBindPipeline(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_COMPUTE, pipelines.exposure);
+				vkCmdDispatch(drawCmdBuffers[i], 1, 1, 1);
+				computeBarrier(drawCmdBuffers[i], VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT);
+			}
+
+			if (timings.queryPool != VK_NULL_HANDLE) {
+				vkCmdWriteTimestamp(drawCmdBuffers[i], VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, timings.queryPool, firstQuery + 2);
+			}
+
+			/*
+				Post processing: Tone mapping, bloom composite, colour grading, vignette and dithering
+			*/
+			if (postMode == PostFused) {
+				dispatchPost(drawCmdBuffers[i], pipelines.postFused, descriptorSets.postFused);
+			} else {
+				for (uint32_t pass = 0; pass < POST_CHAIN_PASSES; pass++) {
+					if (pass > 0) {
+						computeBarrier(drawCmdBuffers[i], VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT);
+					}
+					dispatchPost(drawCmdBuffers[i], pipelines.postChain[pass], descriptorSets.postChain[pass]);
+				}
+			}
+			computeBarrier(drawCmdBuffers[i], VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT);
+
+			if (timings.queryPool != VK_NULL_HANDLE) {
+				vkCmdWriteTimestamp(drawCmdBuffers[i], VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, timings.queryPool, firstQuery + 3);
+			}
+
+			/*
+				Third render pass: Presents the post processed image, storage images can't be used for the swapchain
 			*/
 			{
 				VkClearValue clearValues[2];
@@ -281,21 +442,18 @@ public:
 
 				vkCmdBindDescriptorSets(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayouts.composition, 0, 1, &descriptorSets.composition, 0, NULL);
 
-				// Scene
 				vkCmdBindPipeline(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pipelines.composition);
 				vkCmdDraw(drawCmdBuffers[i], 3, 1, 0, 0);
 
-				// Bloom
-				if (bloom) {
-					vkCmdBindPipeline(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pipelines.bloom[0]);
-					vkCmdDraw(drawCmdBuffers[i], 3, 1, 0, 0);
-				}
-
 				drawUI(drawCmdBuffers[i]);
 
 				vkCmdEndRenderPass(drawCmdBuffers[i]);
 			}
 
+			if (timings.queryPool != VK_NULL_HANDLE) {
+				vkCmdWriteTimestamp(drawCmdBuffers[i], VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, timings.queryPool, firstQuery + 4);
+			}
+
 			VK_CHECK_RESULT(vkEndCommandBuffer(drawCmdBuffers[i]));
 		}
 	}
@@ -425,13 +583,14 @@ public:
 			dependencies[0].dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
 			dependencies[0].dependencyFlags = VK_DEPENDENCY_BY_REGION_BIT;
 
+			// The attachments are read by the following fragment and compute passes
 			dependencies[1].srcSubpass = 0;
 			dependencies[1].dstSubpass = VK_SUBPASS_EXTERNAL;
 			dependencies[1].srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
-			dependencies[1].dstStageMask = VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT;
+			dependencies[1].dstStageMask = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT;
 			dependencies[1].srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
-			dependencies[1].dstAccessMask = VK_ACCESS_MEMORY_READ_BIT;
-			dependencies[1].dependencyFlags = VK_DEPENDENCY_BY_REGION_BIT;
+			dependencies[1].dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+			dependencies[1].dependencyFlags = 0;
 
 			VkRenderPassCreateInfo renderPassInfo = {};
 			renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
@@ -518,13 +677,14 @@ public:
 			dependencies[0].dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
 			dependencies[0].dependencyFlags = VK_DEPENDENCY_BY_REGION_BIT;
 
+			// The attachments are read by the following fragment and compute passes
 			dependencies[1].srcSubpass = 0;
 			dependencies[1].dstSubpass = VK_SUBPASS_EXTERNAL;
 			dependencies[1].srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
-			dependencies[1].dstStageMask = VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT;
+			dependencies[1].dstStageMask = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT;
 			dependencies[1].srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
-			dependencies[1].dstAccessMask = VK_ACCESS_MEMORY_READ_BIT;
-			dependencies[1].dependencyFlags = VK_DEPENDENCY_BY_REGION_BIT;
+			dependencies[1].dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+			dependencies[1].dependencyFlags = 0;
 
 			VkRenderPassCreateInfo renderPassInfo = {};
 			renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
@@ -568,6 +728,167 @@ public:
 		}
 	}
 
+	void createStorageImage(VkFormat format, FrameBufferAttachment *attachment)
+	{
+		attachment->format = format;
+
+		VkImageCreateInfo image = vks::initializers::imageCreateInfo();
+		image.imageType = VK_IMAGE_TYPE_2D;
+		image.format = format;
+		image.extent.width = offscreen.width;
+		image.extent.height = offscreen.height;
+		image.extent.depth = 1;
+		image.mipLevels = 1;
+		image.arrayLayers = 1;
+		image.samples = VK_SAMPLE_COUNT_1_BIT;
+		image.tiling = VK_IMAGE_TILING_OPTIMAL;
+		image.usage = VK_IMAGE_USAGE_STORAGE_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
+
+		VkMemoryAllocateInfo memAlloc = vks::initializers::memoryAllocateInfo();
+		VkMemoryRequirements memReqs;
+
+		VK_CHECK_RESULT(vkCreateImage(device, &image, nullptr, &attachment->image));
+		vkGetImageMemoryRequirements(device, attachment->image, &memReqs);
+		memAlloc.allocationSize = memReqs.size;
+		memAlloc.memoryTypeIndex = vulkanDevice->getMemoryType(memReqs.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+		VK_CHECK_RESULT(vkAllocateMemory(device, &memAlloc, nullptr, &attachment->mem));
+		VK_CHECK_RESULT(vkBindImageMemory(device, attachment->image, attachment->mem, 0));
+
+		VkImageViewCreateInfo imageView = vks::initializers::imageViewCreateInfo();
+		imageView.viewType = VK_IMAGE_VIEW_TYPE_2D;
+		imageView.format = format;
+		imageView.subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1 };
+		imageView.image = attachment->image;
+		VK_CHECK_RESULT(vkCreateImageView(device, &imageView, nullptr, &attachment->view));
+	}
+
+	// Targets of the post processing compute passes
+	void preparePostTargets()
+	{
+		// Half float keeps enough precision for the dither to survive until the final quantization in the presentation pass
+		createStorageImage(VK_FORMAT_R16G16B16A16_SFLOAT, &postTargets.output);
+		createStorageImage(VK_FORMAT_R16G16B16A16_SFLOAT, &postTargets.intermediate[0]);
+		createStorageImage(VK_FORMAT_R16G16B16A16_SFLOAT, &postTargets.intermediate[1]);
+
+		VkCommandBuffer layoutCmd = vulkanDevice->createCommandBuffer(VK_COMMAND_BUFFER_LEVEL_PRIMARY, true);
+		vks::tools::setImageLayout(layoutCmd, postTargets.output.image, VK_IMAGE_ASPECT_COLOR_BIT, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_GENERAL);
+		vks::tools::setImageLayout(layoutCmd, postTargets.intermediate[0].image, VK_IMAGE_ASPECT_COLOR_BIT, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_GENERAL);
+		vks::tools::setImageLayout(layoutCmd, postTargets.intermediate[1].image, VK_IMAGE_ASPECT_COLOR_BIT, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_GENERAL);
+		// The post processing shaders always access the bloom input, so it needs a valid layout even if the filter pass never ran
+		vks::tools::setImageLayout(layoutCmd, filterPass.color[0].image, VK_IMAGE_ASPECT_COLOR_BIT, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+		vulkanDevice->flushCommandBuffer(layoutCmd, queue, true);
+	}
+
+	// Colour transform baked into the grading LUT, applied to tone mapped colors
+	glm::vec3 gradeColor(glm::vec3 color)
+	{
+		switch (gradingPreset) {
+		case GradingWarm:
+			return glm::pow(color * glm::vec3(1.08f, 1.0f, 0.86f), glm::vec3(0.95f));
+		case GradingCool:
+			return glm::pow(color * glm::vec3(0.9f, 1.0f, 1.1f), glm::vec3(1.05f));
+		case GradingBleachBypass: {
+			// Desaturated with increased contrast
+			const float luminance = glm::dot(color, glm::vec3(0.2126f, 0.7152f, 0.0722f));
+			glm::vec3 desaturated = glm::mix(color, glm::vec3(luminance), 0.6f);
+			return desaturated * desaturated * (glm::vec3(3.0f) - 2.0f * desaturated);
+		}
+		default:
+			return color;
+		}
+	}
+
+	void prepareGradingLut()
+	{
+		textures.lut.device = vulkanDevice;
+		textures.lut.width = GRADING_LUT_SIZE;
+		textures.lut.height = GRADING_LUT_SIZE;
+		textures.lut.mipLevels = 1;
+		textures.lut.layerCount = 1;
+
+		VkImageCreateInfo image = vks::initializers::imageCreateInfo();
+		image.imageType = VK_IMAGE_TYPE_3D;
+		image.format = VK_FORMAT_R8G8B8A8_UNORM;
+		image.extent = { GRADING_LUT_SIZE, GRADING_LUT_SIZE, GRADING_LUT_SIZE };
+		image.mipLevels = 1;
+		image.arrayLayers = 1;
+		image.samples = VK_SAMPLE_COUNT_1_BIT;
+		image.tiling = VK_IMAGE_TILING_OPTIMAL;
+		image.usage = VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
+
+		VkMemoryAllocateInfo memAlloc = vks::initializers::memoryAllocateInfo();
+		VkMemoryRequirements memReqs;
+		VK_CHECK_RESULT(vkCreateImage(device, &image, nullptr, &textures.lut.image));
+		vkGetImageMemoryRequirements(device, textures.lut.image, &memReqs);
+		memAlloc.allocationSize = memReqs.size;
+		memAlloc.memoryTypeIndex = vulkanDevice->getMemoryType(memReqs.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+		VK_CHECK_RESULT(vkAllocateMemory(device, &memAlloc, nullptr, &textures.lut.deviceMemory));
+		VK_CHECK_RESULT(vkBindImageMemory(device, textures.lut.image, textures.lut.deviceMemory, 0));
+
+		VkImageViewCreateInfo imageView = vks::initializers::imageViewCreateInfo();
+		imageView.viewType = VK_IMAGE_VIEW_TYPE_3D;
+		imageView.format = image.format;
+		imageView.subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1 };
+		imageView.image = textures.lut.image;
+		VK_CHECK_RESULT(vkCreateImageView(device, &imageView, nullptr, &textures.lut.view));
+
+		// Trilinear filtering between the LUT entries
+		VkSamplerCreateInfo sampler = vks::initializers::samplerCreateInfo();
+		sampler.magFilter = VK_FILTER_LINEAR;
+		sampler.minFilter = VK_FILTER_LINEAR;
+		sampler.mipmapMode = VK_SAMPLER_MIPMAP_MODE_NEAREST;
+		sampler.addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+		sampler.addressModeV = sampler.addressModeU;
+		sampler.addressModeW = sampler.addressModeU;
+		sampler.maxAnisotropy = 1.0f;
+		sampler.maxLod = 0.0f;
+		sampler.borderColor = VK_BORDER_COLOR_FLOAT_OPAQUE_WHITE;
+		VK_CHECK_RESULT(vkCreateSampler(device, &sampler, nullptr, &textures.lut.sampler));
+
+		textures.lut.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+		textures.lut.updateDescriptor();
+
+		updateGradingLut();
+	}
+
+	// Bakes the selected grading preset into the LUT, the whole image is replaced so previous contents are discarded
+	void updateGradingLut()
+	{
+		const uint32_t size = GRADING_LUT_SIZE;
+		std::vector<uint8_t> lutData(size * size * size * 4);
+		for (uint32_t b = 0; b < size; b++) {
+			for (uint32_t g = 0; g < size; g++) {
+				for (uint32_t r = 0; r < size; r++) {
+					const glm::vec3 color = glm::clamp(gradeColor(glm::vec3(r, g, b) / static_cast<float>(size - 1)), 0.0f, 1.0f);
+					uint8_t *texel = &lutData[((b * size + g) * size + r) * 4];
+					texel[0] = static_cast<uint8_t>(color.r * 255.0f + 0.5f);
+					texel[1] = static_cast<uint8_t>(color.g * 255.0f + 0.5f);
+					texel[2] = static_cast<uint8_t>(color.b * 255.0f + 0.5f);
+					texel[3] = 255;
+				}
+			}
+		}
+
+		vks::Buffer stagingBuffer;
+		VK_CHECK_RESULT(vulkanDevice->createBuffer(
+			VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+			&stagingBuffer,
+			lutData.size(),
+			lutData.data()));
+
+		VkCommandBuffer copyCmd = vulkanDevice->createCommandBuffer(VK_COMMAND_BUFFER_LEVEL_PRIMARY, true);
+		vks::tools::setImageLayout(copyCmd, textures.lut.image, VK_IMAGE_ASPECT_COLOR_BIT, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL);
+		VkBufferImageCopy copyRegion = {};
+		copyRegion.imageSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1 };
+		copyRegion.imageExtent = { size, size, size };
+		vkCmdCopyBufferToImage(copyCmd, stagingBuffer.buffer, textures.lut.image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &copyRegion);
+		vks::tools::setImageLayout(copyCmd, textures.lut.image, VK_IMAGE_ASPECT_COLOR_BIT, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+		vulkanDevice->flushCommandBuffer(copyCmd, queue, true);
+
+		stagingBuffer.destroy();
+	}
+
 	void loadAssets()
 	{
 		// Load glTF models
@@ -586,10 +907,12 @@ public:
 	void setupDescriptorPool()
 	{
 		std::vector<VkDescriptorPoolSize> poolSizes = {
-			vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 4),
-			vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 6)
+			vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 3 + POST_CHAIN_PASSES),
+			vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 9 + 3 * POST_CHAIN_PASSES),
+			vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, 1 + POST_CHAIN_PASSES),
+			vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 3 + POST_CHAIN_PASSES)
 		};
-		uint32_t numDescriptorSets = 4;
+		uint32_t numDescriptorSets = 6 + POST_CHAIN_PASSES;
 		VkDescriptorPoolCreateInfo descriptorPoolInfo =
 			vks::initializers::descriptorPoolCreateInfo(static_cast<uint32_t>(poolSizes.size()), poolSizes.data(), numDescriptorSets);
 		VK_CHECK_RESULT(vkCreateDescriptorPool(device, &descriptorPoolInfo, nullptr, &descriptorPool));
@@ -600,7 +923,6 @@ public:
 		std::vector<VkDescriptorSetLayoutBinding> setLayoutBindings = {
 			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT, 0),
 			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_FRAGMENT_BIT, 1),
-			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, VK_SHADER_STAGE_FRAGMENT_BIT, 2),
 		};
 
 		VkDescriptorSetLayoutCreateInfo descriptorLayoutInfo =
@@ -638,6 +960,57 @@ public:
 
 		pipelineLayoutCreateInfo = vks::initializers::pipelineLayoutCreateInfo(&descriptorSetLayouts.composition, 1);
 		VK_CHECK_RESULT(vkCreatePipelineLayout(device, &pipelineLayoutCreateInfo, nullptr, &pipelineLayouts.composition));
+
+		// Auto exposure (histogram and exposure passes)
+		setLayoutBindings = {
+			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_COMPUTE_BIT, 0),
+			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT, 1),
+			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT, 2),
+			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT, 3),
+		};
+
+		descriptorLayoutInfo = vks::initializers::descriptorSetLayoutCreateInfo(setLayoutBindings.data(), static_cast<uint32_t>(setLayoutBindings.size()));
+		VK_CHECK_RESULT(vkCreateDescriptorSetLayout(device, &descriptorLayoutInfo, nullptr, &descriptorSetLayouts.autoExposure));
+
+		pipelineLayoutCreateInfo = vks::initializers::pipelineLayoutCreateInfo(&descriptorSetLayouts.autoExposure, 1);
+		VK_CHECK_RESULT(vkCreatePipelineLayout(device, &pipelineLayoutCreateInfo, nullptr, &pipelineLayouts.autoExposure));
+
+		// Post processing, shared by the fused pass and the passes of the chain
+		setLayoutBindings = {
+			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_COMPUTE_BIT, 0),
+			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_COMPUTE_BIT, 1),
+			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_COMPUTE_BIT, 2),
+			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, VK_SHADER_STAGE_COMPUTE_BIT, 3),
+			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT, 4),
+			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT, 5),
+		};
+
+		descriptorLayoutInfo = vks::initializers::descriptorSetLayoutCreateInfo(setLayoutBindings.data(), static_cast<uint32_t>(setLayoutBindings.size()));
+		VK_CHECK_RESULT(vkCreateDescriptorSetLayout(device, &descriptorLayoutInfo, nullptr, &descriptorSetLayouts.post));
+
+		pipelineLayoutCreateInfo = vks::initializers::pipelineLayoutCreateInfo(&descriptorSetLayouts.post, 1);
+		VK_CHECK_RESULT(vkCreatePipelineLayout(device, &pipelineLayoutCreateInfo, nullptr, &pipelineLayouts.post));
+	}
+
+	// Post processing descriptor set reading from the input and writing to the output image
+	VkDescriptorSet allocatePostDescriptorSet(VkDescriptorImageInfo input, FrameBufferAttachment &output)
+	{
+		VkDescriptorSet descriptorSet;
+		VkDescriptorSetAllocateInfo allocInfo = vks::initializers::descriptorSetAllocateInfo(descriptorPool, &descriptorSetLayouts.post, 1);
+		VK_CHECK_RESULT(vkAllocateDescriptorSets(device, &allocInfo, &descriptorSet));
+
+		VkDescriptorImageInfo bloomDescriptor = vks::initializers::descriptorImageInfo(filterPass.sampler, filterPass.color[0].view, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+		VkDescriptorImageInfo outputDescriptor = vks::initializers::descriptorImageInfo(VK_NULL_HANDLE, output.view, VK_IMAGE_LAYOUT_GENERAL);
+		std::vector<VkWriteDescriptorSet> writeDescriptorSets = {
+			vks::initializers::writeDescriptorSet(descriptorSet, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 0, &input),
+			vks::initializers::writeDescriptorSet(descriptorSet, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 1, &bloomDescriptor),
+			vks::initializers::writeDescriptorSet(descriptorSet, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 2, &textures.lut.descriptor),
+			vks::initializers::writeDescriptorSet(descriptorSet, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, 3, &outputDescriptor),
+			vks::initializers::writeDescriptorSet(descriptorSet, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 4, &uniformBuffers.params.descriptor),
+			vks::initializers::writeDescriptorSet(descriptorSet, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 5, &storageBuffers.adaptation.descriptor),
+		};
+		vkUpdateDescriptorSets(device, static_cast<uint32_t>(writeDescriptorSets.size()), writeDescriptorSets.data(), 0, NULL);
+		return descriptorSet;
 	}
 
 	void setupDescriptorSets()
@@ -654,7 +1027,6 @@ public:
 		std::vector<VkWriteDescriptorSet> writeDescriptorSets = {
 			vks::initializers::writeDescriptorSet(descriptorSets.object, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 0, &uniformBuffers.matrices.descriptor),
 			vks::initializers::writeDescriptorSet(descriptorSets.object, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 1, &textures.envmap.descriptor),
-			vks::initializers::writeDescriptorSet(descriptorSets.object, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 2, &uniformBuffers.params.descriptor),
 		};
 		vkUpdateDescriptorSets(device, static_cast<uint32_t>(writeDescriptorSets.size()), writeDescriptorSets.data(), 0, NULL);
 
@@ -664,7 +1036,6 @@ public:
 		writeDescriptorSets = {
 			vks::initializers::writeDescriptorSet(descriptorSets.skybox, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 0,&uniformBuffers.matrices.descriptor),
 			vks::initializers::writeDescriptorSet(descriptorSets.skybox, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 1, &textures.envmap.descriptor),
-			vks::initializers::writeDescriptorSet(descriptorSets.skybox, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 2, &uniformBuffers.params.descriptor),
 		};
 		vkUpdateDescriptorSets(device, static_cast<uint32_t>(writeDescriptorSets.size()), writeDescriptorSets.data(), 0, NULL);
 
@@ -683,12 +1054,12 @@ public:
 		};
 		vkUpdateDescriptorSets(device, static_cast<uint32_t>(writeDescriptorSets.size()), writeDescriptorSets.data(), 0, NULL);
 
-		// Composition descriptor set
+		// Composition descriptor set, presents the result of the post processing
 		allocInfo =	vks::initializers::descriptorSetAllocateInfo(descriptorPool, &descriptorSetLayouts.composition, 1);
 		VK_CHECK_RESULT(vkAllocateDescriptorSets(device, &allocInfo, &descriptorSets.composition));
 
 		colorDescriptors = {
-			vks::initializers::descriptorImageInfo(offscreen.sampler, offscreen.color[0].view, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL),
+			vks::initializers::descriptorImageInfo(offscreen.sampler, postTargets.output.view, VK_IMAGE_LAYOUT_GENERAL),
 			vks::initializers::descriptorImageInfo(offscreen.sampler, filterPass.color[0].view, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL),
 		};
 
@@ -697,6 +1068,32 @@ public:
 			vks::initializers::writeDescriptorSet(descriptorSets.composition, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 1, &colorDescriptors[1]),
 		};
 		vkUpdateDescriptorSets(device, static_cast<uint32_t>(writeDescriptorSets.size()), writeDescriptorSets.data(), 0, NULL);
+
+		// Auto exposure descriptor set
+		allocInfo = vks::initializers::descriptorSetAllocateInfo(descriptorPool, &descriptorSetLayouts.autoExposure, 1);
+		VK_CHECK_RESULT(vkAllocateDescriptorSets(device, &allocInfo, &descriptorSets.autoExposure));
+
+		VkDescriptorImageInfo sceneDescriptor = vks::initializers::descriptorImageInfo(offscreen.sampler, offscreen.color[0].view, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+		writeDescriptorSets = {
+			vks::initializers::writeDescriptorSet(descriptorSets.autoExposure, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 0, &sceneDescriptor),
+			vks::initializers::writeDescriptorSet(descriptorSets.autoExposure, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1, &storageBuffers.histogram.descriptor),
+			vks::initializers::writeDescriptorSet(descriptorSets.autoExposure, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 2, &storageBuffers.adaptation.descriptor),
+			vks::initializers::writeDescriptorSet(descriptorSets.autoExposure, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 3, &uniformBuffers.params.descriptor),
+		};
+		vkUpdateDescriptorSets(device, static_cast<uint32_t>(writeDescriptorSets.size()), writeDescriptorSets.data(), 0, NULL);
+
+		// Post processing descriptor sets
+		// The fused pass reads the scene and writes the output directly
+		descriptorSets.postFused = allocatePostDescriptorSet(sceneDescriptor, postTargets.output);
+		// The chain ping-pongs between the intermediate targets: tone mapping, bloom composite, colour grading, vignette and dither
+		std::array<VkDescriptorImageInfo, 2> intermediateDescriptors = {
+			vks::initializers::descriptorImageInfo(offscreen.sampler, postTargets.intermediate[0].view, VK_IMAGE_LAYOUT_GENERAL),
+			vks::initializers::descriptorImageInfo(offscreen.sampler, postTargets.intermediate[1].view, VK_IMAGE_LAYOUT_GENERAL),
+		};
+		descriptorSets.postChain[0] = allocatePostDescriptorSet(sceneDescriptor, postTargets.intermediate[0]);
+		descriptorSets.postChain[1] = allocatePostDescriptorSet(intermediateDescriptors[0], postTargets.intermediate[1]);
+		descriptorSets.postChain[2] = allocatePostDescriptorSet(intermediateDescriptors[1], postTargets.intermediate[0]);
+		descriptorSets.postChain[3] = allocatePostDescriptorSet(intermediateDescriptors[0], postTargets.output);
 	}
 
 	void preparePipelines()
@@ -761,15 +1158,13 @@ public:
 
 		// Set constant parameters via specialization constants
 		specializationMapEntries[0] = vks::initializers::specializationMapEntry(0, 0, sizeof(uint32_t));
-		uint32_t dir = 1;
+		uint32_t dir = 0;
 		specializationInfo = vks::initializers::specializationInfo(1, specializationMapEntries.data(), sizeof(dir), &dir);
 		shaderStages[1].pSpecializationInfo = &specializationInfo;
-		VK_CHECK_RESULT(vkCreateGraphicsPipelines(device, pipelineCache, 1, &pipelineCI, nullptr, &pipelines.bloom[0]));
 
-		// Second blur pass (into separate framebuffer)
+		// First blur pass (into separate framebuffer), the second one is done by the post processing
 		pipelineCI.renderPass = filterPass.renderPass;
-		dir = 0;
-		VK_CHECK_RESULT(vkCreateGraphicsPipelines(device, pipelineCache, 1, &pipelineCI, nullptr, &pipelines.bloom[1]));
+		VK_CHECK_RESULT(vkCreateGraphicsPipelines(device, pipelineCache, 1, &pipelineCI, nullptr, &pipelines.bloom));
 
 		// Object rendering pipelines
 		// Use vertex input state from glTF model setup
@@ -800,6 +1195,34 @@ public:
 		// Flip cull mode
 		rasterizationState.cullMode = VK_CULL_MODE_BACK_BIT;
 		VK_CHECK_RESULT(vkCreateGraphicsPipelines(device, pipelineCache, 1, &pipelineCI, nullptr, &pipelines.reflect));
+
+		// Auto exposure compute pipelines
+		VkComputePipelineCreateInfo computePipelineCI = vks::initializers::computePipelineCreateInfo(pipelineLayouts.autoExposure, 0);
+		computePipelineCI.stage = loadShader(getShadersPath() + "hdr/histogram.comp.spv", VK_SHADER_STAGE_COMPUTE_BIT);
+		VK_CHECK_RESULT(vkCreateComputePipelines(device, pipelineCache, 1, &computePipelineCI, nullptr, &pipelines.histogram));
+		computePipelineCI.stage = loadShader(getShadersPath() + "hdr/exposure.comp.spv", VK_SHADER_STAGE_COMPUTE_BIT);
+		VK_CHECK_RESULT(vkCreateComputePipelines(device, pipelineCache, 1, &computePipelineCI, nullptr, &pipelines.exposure));
+
+		// Post processing compute pipelines
+		// Specialization constants select the stages (tone mapping, bloom composite, grading, vignette and dither) a pipeline applies
+		std::array<VkSpecializationMapEntry, POST_CHAIN_PASSES> postMapEntries;
+		for (uint32_t i = 0; i < POST_CHAIN_PASSES; i++) {
+			postMapEntries[i] = vks::initializers::specializationMapEntry(i, i * sizeof(VkBool32), sizeof(VkBool32));
+		}
+		std::array<VkBool32, POST_CHAIN_PASSES> postStages;
+		VkSpecializationInfo postSpecializationInfo = vks::initializers::specializationInfo(POST_CHAIN_PASSES, postMapEntries.data(), sizeof(postStages), postStages.data());
+		computePipelineCI.layout = pipelineLayouts.post;
+		computePipelineCI.stage = loadShader(getShadersPath() + "hdr/post.comp.spv", VK_SHADER_STAGE_COMPUTE_BIT);
+		computePipelineCI.stage.pSpecializationInfo = &postSpecializationInfo;
+		// Fused pass with all stages enabled
+		postStages.fill(VK_TRUE);
+		VK_CHECK_RESULT(vkCreateComputePipelines(device, pipelineCache, 1, &computePipelineCI, nullptr, &pipelines.postFused));
+		// One stage per pass for the chained comparison mode
+		for (uint32_t i = 0; i < POST_CHAIN_PASSES; i++) {
+			postStages.fill(VK_FALSE);
+			postStages[i] = VK_TRUE;
+			VK_CHECK_RESULT(vkCreateComputePipelines(device, pipelineCache, 1, &computePipelineCI, nullptr, &pipelines.postChain[i]));
+		}
 	}
 
 	// Prepare and initialize uniform buffer containing shader uniforms
@@ -823,6 +1246,25 @@ public:
 		VK_CHECK_RESULT(uniformBuffers.matrices.map());
 		VK_CHECK_RESULT(uniformBuffers.params.map());
 
+		// Auto exposure buffers, both start zeroed: an empty histogram and no adapted luminance yet
+		std::array<uint32_t, 256> histogram = {};
+		VK_CHECK_RESULT(vulkanDevice->createBuffer(
+			VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+			&storageBuffers.histogram,
+			sizeof(histogram),
+			histogram.data()));
+		Adaptation adaptation = {};
+		VK_CHECK_RESULT(vulkanDevice->createBuffer(
+			VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+			&storageBuffers.adaptation,
+			sizeof(adaptation),
+			&adaptation));
+		VK_CHECK_RESULT(storageBuffers.adaptation.map());
+
+		uboParams.pixelCount = width * height;
+
 		updateUniformBuffers();
 		updateParams();
 	}
@@ -840,6 +1282,35 @@ public:
 		memcpy(uniformBuffers.params.mapped, &uboParams, sizeof(uboParams));
 	}
 
+	// Reads the timestamps of the frame that just finished
+	void updateTimings()
+	{
+		if (timings.queryPool == VK_NULL_HANDLE) {
+			return;
+		}
+		std::array<uint64_t, StageCount + 1> timestamps;
+		if (vkGetQueryPoolResults(device, timings.queryPool, currentBuffer * (StageCount + 1), StageCount + 1, sizeof(timestamps), timestamps.data(), sizeof(uint64_t), VK_QUERY_RESULT_64_BIT) == VK_SUCCESS) {
+			const float timestampPeriod = vulkanDevice->properties.limits.timestampPeriod;
+			for (uint32_t i = 0; i < StageCount; i++) {
+				timings.stages[i] = static_cast<float>(timestamps[i + 1] - timestamps[i]) * timestampPeriod / 1000000.0f;
+			}
+		}
+	}
+
+	// Estimated full frame image reads and writes of the post processing, repeated texture fetches of the bloom blur and the LUT are assumed to hit the cache
+	VkDeviceSize postProcessingBytes()
+	{
+		const VkDeviceSize pixels = static_cast<VkDeviceSize>(offscreen.width) * offscreen.height;
+		const VkDeviceSize sceneBytes = pixels * vks::tools::formatSize(offscreen.color[0].format);
+		const VkDeviceSize bloomBytes = bloom ? pixels * vks::tools::formatSize(filterPass.color[0].format) : 0;
+		const VkDeviceSize targetBytes = pixels * vks::tools::formatSize(postTargets.output.format);
+		if (postMode == PostFused) {
+			return sceneBytes + bloomBytes + targetBytes;
+		}
+		// Every pass of the chain reads its input and writes a full frame, the bloom input is only read by its own pass
+		return sceneBytes + bloomBytes + targetBytes + (POST_CHAIN_PASSES - 1) * 2 * targetBytes;
+	}
+
 	void draw()
 	{
 		VulkanExampleBase::prepareFrame();
@@ -847,6 +1318,7 @@ public:
 		submitInfo.pCommandBuffers = &drawCmdBuffers[currentBuffer];
 		VK_CHECK_RESULT(vkQueueSubmit(queue, 1, &submitInfo, VK_NULL_HANDLE));
 		VulkanExampleBase::submitFrame();
+		updateTimings();
 	}
 
 	void prepare()
@@ -855,6 +1327,9 @@ public:
 		loadAssets();
 		prepareUniformBuffers();
 		prepareoffscreenfer();
+		preparePostTargets();
+		prepareGradingLut();
+		prepareTimestamps();
 		setupDescriptorSetLayout();
 		preparePipelines();
 		setupDescriptorPool();
@@ -867,6 +1342,9 @@ public:
 	{
 		if (!prepared)
 			return;
+		// The parameters are uploaded every frame, the auto exposure adapts based on the frame time
+		uboParams.deltaTime = frameTimer;
+		updateParams();
 		draw();
 		if (camera.updated)
 			updateUniformBuffers();
@@ -884,16 +1362,54 @@ public:
 				updateUniformBuffers();
 				buildCommandBuffers();
 			}
-			if (overlay->inputFloat("Exposure", &uboParams.exposure, 0.025f, 3)) {
-				updateParams();
-			}
 			if (overlay->checkBox("Bloom", &bloom)) {
+				uboParams.bloom = bloom ? 1 : 0;
 				buildCommandBuffers();
 			}
 			if (overlay->checkBox("Skybox", &displaySkybox)) {
 				buildCommandBuffers();
 			}
 		}
+		if (overlay->header("Post processing")) {
+			if (overlay->comboBox("Mode", &postMode, postModeNames)) {
+				buildCommandBuffers();
+			}
+			bool autoExposure = (uboParams.autoExposure == 1);
+			if (overlay->checkBox("Auto exposure", &autoExposure)) {
+				uboParams.autoExposure = autoExposure ? 1 : 0;
+				buildCommandBuffers();
+			}
+			if (autoExposure) {
+				overlay->sliderFloat("Key value", &uboParams.exposureKey, 0.05f, 1.0f);
+				overlay->sliderFloat("Adaptation rate", &uboParams.adaptationRate, 0.1f, 5.0f);
+			} else {
+				overlay->inputFloat("Exposure", &uboParams.exposure, 0.025f, 3);
+			}
+			overlay->comboBox("Tone mapping", &uboParams.tonemapper, tonemapperNames);
+			if (overlay->comboBox("Colour grading", &gradingPreset, gradingPresetNames)) {
+				updateGradingLut();
+			}
+			overlay->sliderFloat("Grading strength", &uboParams.gradingStrength, 0.0f, 1.0f);
+			overlay->sliderFloat("Vignette", &uboParams.vignette, 0.0f, 1.0f);
+			bool dither = (uboParams.dither == 1);
+			if (overlay->checkBox("Dither", &dither)) {
+				uboParams.dither = dither ? 1 : 0;
+			}
+		}
+		if (overlay->header("Statistics")) {
+			const Adaptation *adaptation = static_cast<const Adaptation*>(storageBuffers.adaptation.mapped);
+			if (uboParams.autoExposure == 1) {
+				overlay->text("Average luminance: %.3f", adaptation->luminance);
+				overlay->text("Exposure: %.3f", adaptation->exposure);
+			}
+			overlay->text("Post processing traffic: %.1f MB", static_cast<float>(postProcessingBytes()) / (1024.0f * 1024.0f));
+			if (timings.queryPool != VK_NULL_HANDLE) {
+				overlay->text("Scene + bloom filter: %.3f ms", timings.stages[StageScene]);
+				overlay->text("Auto exposure: %.3f ms", timings.stages[StageAutoExposure]);
+				overlay->text("Post processing: %.3f ms", timings.stages[StagePost]);
+				overlay->text("Presentation: %.3f ms", timings.stages[StagePresent]);
+			}
+		}
 	}
 };
 
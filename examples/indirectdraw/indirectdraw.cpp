@@ -15,12 +15,17 @@
 * The example shows how to setup and fill such a buffer on the CPU side, stages it to the device and
 * shows how to render it using only one draw command.
 *
+* The plants are managed by vks::InstanceGrid: instances are bucketed into grid cells that are streamed to the GPU
+* around the camera, culled per cell and per instance and compacted per plant type and level of detail into the
+* indirect buffer every frame, which scales the scene to millions of plants (see --instancecount)
+*
 * See readme.md for details
 *
 */
 
 #include "vulkanexamplebase.h"
 #include "VulkanglTFModel.h"
+#include "VulkanInstanceGrid.h"
 
 #define VERTEX_BUFFER_BIND_ID 0
 #define INSTANCE_BUFFER_BIND_ID 1
@@ -51,23 +56,18 @@ public:
 		vkglTF::Model skysphere;
 	} models;
 
-	// Per-instance data block
-	struct InstanceData {
-		glm::vec3 pos;
-		glm::vec3 rot;
-		float scale;
-		uint32_t texIndex;
-	};
+	// Per-instance data block, the type selects the mesh and the texture array layer
+	typedef vks::InstanceGrid::Instance InstanceData;
 
-	// Contains the instanced data
-	vks::Buffer instanceBuffer;
-	// Contains the indirect drawing commands
-	vks::Buffer indirectCommandsBuffer;
-	uint32_t indirectDrawCount;
+	// Buckets the plants into cells and writes the indirect draws of the visible ones every frame
+	vks::InstanceGrid instanceGrid;
+	int32_t cellCulling = vks::InstanceGrid::CellCullingGPU;
 
 	struct {
 		glm::mat4 projection;
 		glm::mat4 view;
+		// Scales the ground plane to the extent of the plant field
+		float groundScale;
 	} uboVS;
 
 	struct {
@@ -87,9 +87,8 @@ public:
 	VkSampler samplerRepeat;
 
 	uint32_t objectCount = 0;
-
-	// Store the indirect draw commands containing index offsets and instance count per object
-	std::vector<VkDrawIndexedIndirectCommand> indirectCommands;
+	// Plant types in the model, one per mesh
+	uint32_t plantTypes = 0;
 
 	VulkanExample() : VulkanExampleBase(ENABLE_VALIDATION)
 	{
@@ -99,6 +98,10 @@ public:
 		camera.setRotation(glm::vec3(-12.0f, 159.0f, 0.0f));
 		camera.setTranslation(glm::vec3(0.4f, 1.25f, 0.0f));
 		camera.movementSpeed = 5.0f;
+
+		commandLineParser.add("instancecount", { "-ic", "--instancecount" }, 1, "Set the total number of plants, the field grows with the count at constant density");
+		commandLineParser.add("gridbenchmark", { "-gb", "--gridbenchmark" }, 0, "Fly over the plant field, print the streaming and culling costs of both cell culling modes and exit");
+		commandLineParser.parse(args);
 	}
 
 	~VulkanExample()
@@ -110,8 +113,7 @@ public:
 		vkDestroyDescriptorSetLayout(device, descriptorSetLayout, nullptr);
 		textures.plants.destroy();
 		textures.ground.destroy();
-		instanceBuffer.destroy();
-		indirectCommandsBuffer.destroy();
+		instanceGrid.destroy();
 		uniformData.scene.destroy();
 	}
 
@@ -128,7 +130,7 @@ public:
 		}
 	};
 
-	void buildCommandBuffers()
+	void buildCommandBuffer(uint32_t index)
 	{
 		VkCommandBufferBeginInfo cmdBufInfo = vks::initializers::commandBufferBeginInfo();
 
@@ -142,63 +144,52 @@ public:
 		renderPassBeginInfo.renderArea.extent.height = height;
 		renderPassBeginInfo.clearValueCount = 2;
 		renderPassBeginInfo.pClearValues = clearValues;
+		// Set target frame buffer
+		renderPassBeginInfo.framebuffer = frameBuffers[index];
 
-		for (int32_t i = 0; i < drawCmdBuffers.size(); ++i)
-		{
-			// Set target frame buffer
-			renderPassBeginInfo.framebuffer = frameBuffers[i];
-
-			VK_CHECK_RESULT(vkBeginCommandBuffer(drawCmdBuffers[i], &cmdBufInfo));
+		VkCommandBuffer commandBuffer = drawCmdBuffers[index];
+		VK_CHECK_RESULT(vkBeginCommandBuffer(commandBuffer, &cmdBufInfo));
 
-			vkCmdBeginRenderPass(drawCmdBuffers[i], &renderPassBeginInfo, VK_SUBPASS_CONTENTS_INLINE);
+		// [POI] Streams plant cells in and out, culls them and writes the indirect draw commands for this frame
+		instanceGrid.recordCulling(commandBuffer);
 
-			VkViewport viewport = vks::initializers::viewport((float)width, (float)height, 0.0f, 1.0f);
-			vkCmdSetViewport(drawCmdBuffers[i], 0, 1, &viewport);
+		vkCmdBeginRenderPass(commandBuffer, &renderPassBeginInfo, VK_SUBPASS_CONTENTS_INLINE);
 
-			VkRect2D scissor = vks::initializers::rect2D(width, height, 0, 0);
-			vkCmdSetScissor(drawCmdBuffers[i], 0, 1, &scissor);
+		VkViewport viewport = vks::initializers::viewport((float)width, (float)height, 0.0f, 1.0f);
+		vkCmdSetViewport(commandBuffer, 0, 1, &viewport);
 
-			VkDeviceSize offsets[1] = { 0 };
-			vkCmdBindDescriptorSets(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 0, 1, &descriptorSet, 0, NULL);
+		VkRect2D scissor = vks::initializers::rect2D(width, height, 0, 0);
+		vkCmdSetScissor(commandBuffer, 0, 1, &scissor);
 
-			// Skysphere
-			vkCmdBindPipeline(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pipelines.skysphere);
-			models.skysphere.draw(drawCmdBuffers[i]);
-			// Ground
-			vkCmdBindPipeline(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pipelines.ground);
-			models.ground.draw(drawCmdBuffers[i]);
+		VkDeviceSize offsets[1] = { 0 };
+		vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 0, 1, &descriptorSet, 0, NULL);
 
-			// [POI] Instanced multi draw rendering of the plants
-			vkCmdBindPipeline(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pipelines.plants);
-			// Binding point 0 : Mesh vertex buffer
-			vkCmdBindVertexBuffers(drawCmdBuffers[i], VERTEX_BUFFER_BIND_ID, 1, &models.plants.vertices.buffer, offsets);
-			// Binding point 1 : Instance data buffer
-			vkCmdBindVertexBuffers(drawCmdBuffers[i], INSTANCE_BUFFER_BIND_ID, 1, &instanceBuffer.buffer, offsets);
+		// Skysphere
+		vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelines.skysphere);
+		models.skysphere.draw(commandBuffer);
+		// Ground
+		vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelines.ground);
+		models.ground.draw(commandBuffer);
 
-			vkCmdBindIndexBuffer(drawCmdBuffers[i], models.plants.indices.buffer, 0, VK_INDEX_TYPE_UINT32);
+		// [POI] Instanced multi draw rendering of the plants
+		vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelines.plants);
+		// Binding point 0 : Mesh vertex buffer
+		vkCmdBindVertexBuffers(commandBuffer, VERTEX_BUFFER_BIND_ID, 1, &models.plants.vertices.buffer, offsets);
+		vkCmdBindIndexBuffer(commandBuffer, models.plants.indices.buffer, 0, VK_INDEX_TYPE_UINT32);
+		// Binding point 1 : Instance data of the visible plants, compacted per plant type and level of detail
+		// If the multi draw feature is supported one draw call is issued for all of them, otherwise one per plant type and level of detail
+		instanceGrid.draw(commandBuffer, INSTANCE_BUFFER_BIND_ID);
 
-			// If the multi draw feature is supported:
-			// One draw call for an arbitrary number of objects
-			// Index offsets and instance count are taken from the indirect buffer
-			if (vulkanDevice->features.multiDrawIndirect)
-			{
-				vkCmdDrawIndexedIndirect(drawCmdBuffers[i], indirectCommandsBuffer.buffer, 0, indirectDrawCount, sizeof(VkDrawIndexedIndirectCommand));
-			}
-			else
-			{
-				// If multi draw is not available, we must issue separate draw commands
-				for (auto j = 0; j < indirectCommands.size(); j++)
-				{
-					vkCmdDrawIndexedIndirect(drawCmdBuffers[i], indirectCommandsBuffer.buffer, j * sizeof(VkDrawIndexedIndirectCommand), 1, sizeof(VkDrawIndexedIndirectCommand));
-				}
-			}
+		drawUI(commandBuffer);
 
-			drawUI(drawCmdBuffers[i]);
+		vkCmdEndRenderPass(commandBuffer);
 
-			vkCmdEndRenderPass(drawCmdBuffers[i]);
+		VK_CHECK_RESULT(vkEndCommandBuffer(commandBuffer));
+	}
 
-			VK_CHECK_RESULT(vkEndCommandBuffer(drawCmdBuffers[i]));
-		}
+	// The plant draws change every frame, so the command buffer of the current frame is recorded again in draw
+	void buildCommandBuffers()
+	{
 	}
 
 	void loadAssets()
@@ -310,9 +301,9 @@ public:
 		    // Per-Instance attributes
 		    // These are fetched for each instance rendered
 		    vks::initializers::vertexInputAttributeDescription(INSTANCE_BUFFER_BIND_ID, 4, VK_FORMAT_R32G32B32_SFLOAT, offsetof(InstanceData, pos)),	// Location 4: Position
-		    vks::initializers::vertexInputAttributeDescription(INSTANCE_BUFFER_BIND_ID, 5, VK_FORMAT_R32G32B32_SFLOAT, offsetof(InstanceData, rot)),	// Location 5: Rotation
+		    vks::initializers::vertexInputAttributeDescription(INSTANCE_BUFFER_BIND_ID, 5, VK_FORMAT_R32G32B32_SFLOAT, offsetof(InstanceData, rotation)),	// Location 5: Rotation
 		    vks::initializers::vertexInputAttributeDescription(INSTANCE_BUFFER_BIND_ID, 6, VK_FORMAT_R32_SFLOAT, offsetof(InstanceData, scale)),		// Location 6: Scale
-		    vks::initializers::vertexInputAttributeDescription(INSTANCE_BUFFER_BIND_ID, 7, VK_FORMAT_R32_SINT, offsetof(InstanceData, texIndex)),		// Location 7: Texture array layer index
+		    vks::initializers::vertexInputAttributeDescription(INSTANCE_BUFFER_BIND_ID, 7, VK_FORMAT_R32_SINT, offsetof(InstanceData, type)),		// Location 7: Texture array layer index
 		};
 		inputState.pVertexBindingDescriptions = bindingDescriptions.data();
 		inputState.pVertexAttributeDescriptions = attributeDescriptions.data();
@@ -344,61 +335,53 @@ public:
 		VK_CHECK_RESULT(vkCreateGraphicsPipelines(device, pipelineCache, 1, &pipelineCreateInfo, nullptr, &pipelines.skysphere));
 	}
 
-	// Prepare (and stage) a buffer containing the indirect draw commands
+	// Register the plant meshes with the instance grid, with one mesh per plant type and level of detail
 	void prepareIndirectData()
 	{
-		indirectCommands.clear();
-
-		// Create on indirect command for node in the scene with a mesh attached to it
-		uint32_t m = 0;
+		// The plant model has no simplified meshes, so the distant levels thin out the plants instead
+		const std::vector<vks::InstanceGrid::LOD> lods = {
+			{ PLANT_RADIUS * 1.5f, 1.0f },
+			{ PLANT_RADIUS * 3.0f, 0.5f },
+			{ PLANT_RADIUS * 6.0f, 0.2f },
+		};
+		std::vector<vks::InstanceGrid::Mesh> meshes;
+		plantTypes = 0;
 		for (auto &node : models.plants.nodes)
 		{
 			if (node->mesh)
 			{
-				VkDrawIndexedIndirectCommand indirectCmd{};
-				indirectCmd.instanceCount = OBJECT_INSTANCE_COUNT;
-				indirectCmd.firstInstance = m * OBJECT_INSTANCE_COUNT;
 				// @todo: Multiple primitives
 				// A glTF node may consist of multiple primitives, so we may have to do multiple commands per mesh
-				indirectCmd.firstIndex = node->mesh->primitives[0]->firstIndex;
-				indirectCmd.indexCount = node->mesh->primitives[0]->indexCount;
-
-				indirectCommands.push_back(indirectCmd);
-
-				m++;
+				const vkglTF::Primitive *primitive = node->mesh->primitives[0];
+				vks::InstanceGrid::Mesh mesh{};
+				mesh.firstIndex = primitive->firstIndex;
+				mesh.indexCount = primitive->indexCount;
+				// Bounds the mesh around the instance position
+				mesh.radius = glm::length(primitive->dimensions.center) + primitive->dimensions.radius;
+				for (size_t lod = 0; lod < lods.size(); lod++) {
+					meshes.push_back(mesh);
+				}
+				plantTypes++;
 			}
 		}
 
-		indirectDrawCount = static_cast<uint32_t>(indirectCommands.size());
-
-		objectCount = 0;
-		for (auto indirectCmd : indirectCommands)
-		{
-			objectCount += indirectCmd.instanceCount;
-		}
-
-		vks::Buffer stagingBuffer;
-		VK_CHECK_RESULT(vulkanDevice->createBuffer(
-			VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
-			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
-			&stagingBuffer,
-			indirectCommands.size() * sizeof(VkDrawIndexedIndirectCommand),
-			indirectCommands.data()));
-
-		VK_CHECK_RESULT(vulkanDevice->createBuffer(
-			VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
-			VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
-			&indirectCommandsBuffer,
-			stagingBuffer.size));
-
-		vulkanDevice->copyBuffer(&stagingBuffer, &indirectCommandsBuffer, queue);
-
-		stagingBuffer.destroy();
+		vks::InstanceGrid::Settings settings;
+		settings.cellSize = 8.0f;
+		settings.streamingRadius = lods.back().distance + settings.cellSize;
+		instanceGrid.prepare(vulkanDevice, pipelineCache, getShadersPath() + "base/", settings);
+		instanceGrid.setMeshes(meshes, lods);
 	}
 
-	// Prepare (and stage) a buffer containing instanced data for the mesh draws
+	// Scatter the plants over a square field with the density of the original circular one and bucket them into the grid
 	void prepareInstanceData()
 	{
+		objectCount = OBJECT_INSTANCE_COUNT * plantTypes;
+		if (commandLineParser.isSet("instancecount")) {
+			objectCount = std::max(1, commandLineParser.getValueAsInt("instancecount", objectCount));
+		}
+		const float density = static_cast<float>(OBJECT_INSTANCE_COUNT * plantTypes) / (float(M_PI) * PLANT_RADIUS * PLANT_RADIUS);
+		const float halfSize = sqrt(static_cast<float>(objectCount) / density) * 0.5f;
+
 		std::vector<InstanceData> instanceData;
 		instanceData.resize(objectCount);
 
@@ -406,31 +389,84 @@ public:
 		std::uniform_real_distribution<float> uniformDist(0.0f, 1.0f);
 
 		for (uint32_t i = 0; i < objectCount; i++) {
-			float theta = 2 * float(M_PI) * uniformDist(rndEngine);
-			float phi = acos(1 - 2 * uniformDist(rndEngine));
-			instanceData[i].rot = glm::vec3(0.0f, float(M_PI) * uniformDist(rndEngine), 0.0f);
-			instanceData[i].pos = glm::vec3(sin(phi) * cos(theta), 0.0f, cos(phi)) * PLANT_RADIUS;
+			instanceData[i].rotation = glm::vec3(0.0f, float(M_PI) * uniformDist(rndEngine), 0.0f);
+			instanceData[i].pos = glm::vec3(uniformDist(rndEngine) * 2.0f - 1.0f, 0.0f, uniformDist(rndEngine) * 2.0f - 1.0f) * halfSize;
 			instanceData[i].scale = 1.0f + uniformDist(rndEngine) * 2.0f;
-			instanceData[i].texIndex = i / OBJECT_INSTANCE_COUNT;
+			instanceData[i].type = i % plantTypes;
 		}
 
-		vks::Buffer stagingBuffer;
-		VK_CHECK_RESULT(vulkanDevice->createBuffer(
-			VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
-			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
-			&stagingBuffer,
-			instanceData.size() * sizeof(InstanceData),
-			instanceData.data()));
+		instanceGrid.build(instanceData);
+		uboVS.groundScale = std::max(halfSize / PLANT_RADIUS, 1.0f);
+	}
 
-		VK_CHECK_RESULT(vulkanDevice->createBuffer(
-			VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
-			VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
-			&instanceBuffer,
-			stagingBuffer.size));
+	/*
+	* Flies the camera over the plant field once per cell culling mode without rendering and prints the host time of
+	* the streaming and cell culling, the GPU time of the uploads and culling passes and the visible plants
+	*/
+	void runGridBenchmark()
+	{
+		const uint32_t frames = 600;
+		const glm::vec4 extent = instanceGrid.extent();
+		const glm::mat4 projection = camera.matrices.perspective;
+		const bool timestamps = vulkanDevice->queueFamilyProperties[vulkanDevice->queueFamilyIndices.graphics].timestampValidBits > 0;
+		VkQueryPool queryPool = VK_NULL_HANDLE;
+		if (timestamps) {
+			VkQueryPoolCreateInfo queryPoolInfo{};
+			queryPoolInfo.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+			queryPoolInfo.queryType = VK_QUERY_TYPE_TIMESTAMP;
+			queryPoolInfo.queryCount = 2;
+			VK_CHECK_RESULT(vkCreateQueryPool(device, &queryPoolInfo, nullptr, &queryPool));
+		}
 
-		vulkanDevice->copyBuffer(&stagingBuffer, &instanceBuffer, queue);
+		std::cout << std::fixed << std::setprecision(3);
+		std::cout << "Instance grid benchmark on " << vulkanDevice->properties.deviceName << "\n";
+		std::cout << "instances: " << instanceGrid.statistics.instances << ", cells: " << instanceGrid.statistics.cells << ", slots: " << instanceGrid.statistics.slots << ", build: " << instanceGrid.statistics.buildTime << " ms\n";
+		const char* modes[] = { "CPU", "GPU" };
+		for (int32_t mode = vks::InstanceGrid::CellCullingCPU; mode <= vks::InstanceGrid::CellCullingGPU; mode++) {
+			instanceGrid.cellCulling = static_cast<vks::InstanceGrid::CellCulling>(mode);
+			double updateTime = 0.0;
+			double cullTime = 0.0;
+			uint64_t visibleInstances = 0;
+			uint64_t uploads = 0;
+			for (uint32_t frame = 0; frame < frames; frame++) {
+				// Diagonal flight across the field, looking ahead
+				const float t = static_cast<float>(frame) / static_cast<float>(frames - 1);
+				const glm::vec3 position = glm::vec3(glm::mix(extent.x, extent.z, t), 2.0f, glm::mix(extent.y, extent.w, t));
+				const glm::mat4 view = glm::lookAt(position, position + glm::vec3(1.0f, -0.1f, 1.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+				instanceGrid.update(position, projection * view);
+				updateTime += instanceGrid.statistics.updateTime;
+				uploads += instanceGrid.statistics.uploads;
+				if (frame > 0) {
+					visibleInstances += instanceGrid.statistics.visibleInstances;
+				}
+
+				VkCommandBuffer commandBuffer = vulkanDevice->createCommandBuffer(VK_COMMAND_BUFFER_LEVEL_PRIMARY, true);
+				if (timestamps) {
+					vkCmdResetQueryPool(commandBuffer, queryPool, 0, 2);
+					vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, queryPool, 0);
+				}
+				instanceGrid.recordCulling(commandBuffer);
+				if (timestamps) {
+					vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, queryPool, 1);
+				}
+				auto tStart = std::chrono::high_resolution_clock::now();
+				vulkanDevice->flushCommandBuffer(commandBuffer, queue, true);
+				// Fall back to the host time of the submission without timestamps
+				double frameCullTime = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - tStart).count();
+				if (timestamps) {
+					uint64_t results[2];
+					VK_CHECK_RESULT(vkGetQueryPoolResults(device, queryPool, 0, 2, sizeof(results), results, sizeof(uint64_t), VK_QUERY_RESULT_64_BIT | VK_QUERY_RESULT_WAIT_BIT));
+					frameCullTime = static_cast<double>(results[1] - results[0]) * vulkanDevice->properties.limits.timestampPeriod / 1.0e6;
+				}
+				cullTime += frameCullTime;
+			}
+			std::cout << modes[mode] << " cell culling: update " << updateTime / frames << " ms (host), uploads and culling " << cullTime / frames << " ms (" << (timestamps ? "GPU timestamps" : "host time") << ")";
+			std::cout << ", visible plants " << visibleInstances / (frames - 1) << ", cells uploaded " << uploads << "\n";
+		}
 
-		stagingBuffer.destroy();
+		if (queryPool != VK_NULL_HANDLE) {
+			vkDestroyQueryPool(device, queryPool, nullptr);
+		}
 	}
 
 	void prepareUniformBuffers()
@@ -461,6 +497,11 @@ public:
 	{
 		VulkanExampleBase::prepareFrame();
 
+		// The previous frame has finished (the base class waits for the queue), so the grid can stream and cull on the host
+		instanceGrid.cellCulling = static_cast<vks::InstanceGrid::CellCulling>(cellCulling);
+		instanceGrid.update(glm::vec3(glm::inverse(camera.matrices.view)[3]), camera.matrices.perspective * camera.matrices.view);
+		buildCommandBuffer(currentBuffer);
+
 		// Command buffer to be submitted to the queue
 		submitInfo.commandBufferCount = 1;
 		submitInfo.pCommandBuffers = &drawCmdBuffers[currentBuffer];
@@ -477,12 +518,15 @@ public:
 		loadAssets();
 		prepareIndirectData();
 		prepareInstanceData();
+		if (commandLineParser.isSet("gridbenchmark")) {
+			runGridBenchmark();
+			exit(0);
+		}
 		prepareUniformBuffers();
 		setupDescriptorSetLayout();
 		preparePipelines();
 		setupDescriptorPool();
 		setupDescriptorSet();
-		buildCommandBuffers();
 		prepared = true;
 	}
 
@@ -511,8 +555,24 @@ public:
 				overlay->text("multiDrawIndirect not supported");
 			}
 		}
+		if (overlay->header("Settings")) {
+			overlay->comboBox("Cell culling", &cellCulling, { "CPU", "GPU" });
+		}
 		if (overlay->header("Statistics")) {
+			const vks::InstanceGrid::Statistics &stats = instanceGrid.statistics;
 			overlay->text("Objects: %d", objectCount);
+			overlay->text("Cells: %d resident of %d", stats.residentCells, stats.cells);
+			overlay->text("Visible cells: %d", stats.visibleCells);
+			overlay->text("Resident objects: %d", stats.residentInstances);
+			overlay->text("Visible objects: %d", stats.visibleInstances);
+			for (uint32_t i = 0; i < 3; i++) {
+				overlay->text("LOD %d: %d", i, stats.lodInstances[i]);
+			}
+			overlay->text("Uploads: %d, evictions: %d", stats.uploads, stats.evictions);
+			if (stats.missingCells > 0) {
+				overlay->text("Cells not fitting the pool: %d", stats.missingCells);
+			}
+			overlay->text("Update: %.3f ms", stats.updateTime);
 		}
 	}
 };
@@ -1,6 +1,10 @@
 /*
  * Vulkan Example - Using mesh shaders
  *
+ * Draws a glTF model that has been partitioned into meshlets at load time. A task shader culls the meshlets against the
+ * view frustum and with their normal cones, only visible meshlets are expanded into triangles by the mesh shader.
+ * Devices without VK_EXT_mesh_shader cull the meshlets in a compute pass and draw them with indexed indirect draws
+ *
  * Copyright (C) 2022 by Sascha Willems - www.saschawillems.de
  *
  * This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
@@ -8,68 +12,220 @@
 
 #include "vulkanexamplebase.h"
 #include "VulkanglTFModel.h"
+#include "frustum.hpp"
 
 #define ENABLE_VALIDATION false
 
+// Must match the workgroup sizes of the task and the cull shader
+#define MESHLETS_PER_TASK 32
+#define CULL_WORKGROUP_SIZE 64
+
 class VulkanExample : public VulkanExampleBase
 {
 public:
+	vkglTF::Model model;
+
+	enum RenderPath { RenderPathMeshShader = 0, RenderPathIndirect = 1 };
+	int32_t renderPath = RenderPathMeshShader;
+	bool meshShaderSupported = false;
+	bool frustumCulling = true;
+	bool coneCulling = true;
+	bool colorMeshlets = true;
+
 	struct UniformData {
 		glm::mat4 projection;
 		glm::mat4 model;
 		glm::mat4 view;
+		// Frustum planes and camera position are in model space, so the meshlet bounds can be used as they are
+		glm::vec4 frustumPlanes[6];
+		glm::vec4 cameraPos;
+		uint32_t meshletCount;
+		// Size of vkglTF::Vertex in floats, the mesh shader reads the vertex buffer as a float array
+		uint32_t vertexStride;
+		uint32_t frustumCulling;
+		uint32_t coneCulling;
+		uint32_t colorMeshlets;
+		// Set if indirect draws can pass the meshlet index as first instance
+		uint32_t meshletIndexAsInstance;
+		uint32_t pad[2];
 	} uniformData;
 	vks::Buffer uniformBuffer;
 
-	uint32_t indexCount;
+	// Number of visible meshlets, written by the task or cull shader and read back on the host
+	vks::Buffer statisticsBuffer;
+	uint32_t visibleMeshlets = 0;
 
-	VkPipeline pipeline;
+	// Indirect path, one draw per meshlet into an index buffer with the triangles of all meshlets
+	vks::Buffer indirectCommandsBuffer;
+	vks::Buffer meshletIndexBuffer;
+
+	struct {
+		VkPipeline meshShader = VK_NULL_HANDLE;
+		VkPipeline indirect = VK_NULL_HANDLE;
+		VkPipeline cull = VK_NULL_HANDLE;
+	} pipelines;
 	VkPipelineLayout pipelineLayout;
 	VkDescriptorSet descriptorSet;
 	VkDescriptorSetLayout descriptorSetLayout;
 
-	PFN_vkCmdDrawMeshTasksEXT vkCmdDrawMeshTasksEXT;
+	PFN_vkCmdDrawMeshTasksEXT vkCmdDrawMeshTasksEXT = nullptr;
 
 	VkPhysicalDeviceMeshShaderFeaturesEXT enabledMeshShaderFeatures{};
 
 	VulkanExample() : VulkanExampleBase(ENABLE_VALIDATION)
 	{
 		title = "Mesh shaders";
-		timerSpeed *= 0.25f;
 		camera.type = Camera::CameraType::lookat;
-		camera.setPerspective(60.0f, (float)width / (float)height, 0.1f, 512.0f);
-		camera.setRotation(glm::vec3(0.0f, 15.0f, 0.0f));
-		camera.setTranslation(glm::vec3(0.0f, 0.0f, -5.0f));
+		camera.setPosition(glm::vec3(0.0f, 0.0f, -3.5f));
+		camera.setRotation(glm::vec3(-25.0f, 23.75f, 0.0f));
+		camera.setRotationSpeed(0.75f);
+		camera.setPerspective(60.0f, (float)width / (float)height, 0.1f, 256.0f);
 
 		// Extension require at least Vulkan 1.1
 		apiVersion = VK_API_VERSION_1_1;
-
-		// Extensions required by mesh shading
 		enabledInstanceExtensions.push_back(VK_KHR_GET_PHYSICAL_DEVICE_PROPERTIES_2_EXTENSION_NAME);
-		enabledDeviceExtensions.push_back(VK_EXT_MESH_SHADER_EXTENSION_NAME);
-		enabledDeviceExtensions.push_back(VK_KHR_SPIRV_1_4_EXTENSION_NAME);
 
-		// Required by VK_KHR_spirv_1_4
-		enabledDeviceExtensions.push_back(VK_KHR_SHADER_FLOAT_CONTROLS_EXTENSION_NAME);
+		commandLineParser.add("meshletbenchmark", { "-mb", "--meshletbenchmark" }, 0, "Time the meshlet builder on the loaded model, print the results and exit");
+		commandLineParser.add("nomeshshader", { "-nms", "--nomeshshader" }, 0, "Don't use mesh shaders even if supported, meshlets are drawn with indirect draws");
+		commandLineParser.parse(args);
 	}
 
 	~VulkanExample()
 	{
-		vkDestroyPipeline(device, pipeline, nullptr);
+		vkDestroyPipeline(device, pipelines.meshShader, nullptr);
+		vkDestroyPipeline(device, pipelines.indirect, nullptr);
+		vkDestroyPipeline(device, pipelines.cull, nullptr);
 		vkDestroyPipelineLayout(device, pipelineLayout, nullptr);
 		vkDestroyDescriptorSetLayout(device, descriptorSetLayout, nullptr);
 		uniformBuffer.destroy();
+		statisticsBuffer.destroy();
+		indirectCommandsBuffer.destroy();
+		meshletIndexBuffer.destroy();
 	}
 
 	void getEnabledFeatures()
 	{
-		enabledMeshShaderFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MESH_SHADER_FEATURES_NV;
+		// Used by the indirect path if available
+		if (deviceFeatures.multiDrawIndirect) {
+			enabledFeatures.multiDrawIndirect = VK_TRUE;
+		}
+		if (deviceFeatures.drawIndirectFirstInstance) {
+			enabledFeatures.drawIndirectFirstInstance = VK_TRUE;
+		}
+	}
+
+	void getEnabledExtensions()
+	{
+		// Mesh shading is optional, without it the meshlets are drawn with indirect draws
+		if (commandLineParser.isSet("nomeshshader") || (vulkanDevice->properties.apiVersion < VK_API_VERSION_1_1)) {
+			return;
+		}
+		if (!vulkanDevice->extensionSupported(VK_EXT_MESH_SHADER_EXTENSION_NAME) || !vulkanDevice->extensionSupported(VK_KHR_SPIRV_1_4_EXTENSION_NAME) || !vulkanDevice->extensionSupported(VK_KHR_SHADER_FLOAT_CONTROLS_EXTENSION_NAME)) {
+			return;
+		}
+		VkPhysicalDeviceMeshShaderFeaturesEXT supportedFeatures{};
+		supportedFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MESH_SHADER_FEATURES_EXT;
+		VkPhysicalDeviceFeatures2 features2{};
+		features2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+		features2.pNext = &supportedFeatures;
+		vkGetPhysicalDeviceFeatures2(vulkanDevice->physicalDevice, &features2);
+		if (!supportedFeatures.meshShader || !supportedFeatures.taskShader) {
+			return;
+		}
+
+		// Extensions required by mesh shading
+		enabledDeviceExtensions.push_back(VK_EXT_MESH_SHADER_EXTENSION_NAME);
+		enabledDeviceExtensions.push_back(VK_KHR_SPIRV_1_4_EXTENSION_NAME);
+		// Required by VK_KHR_spirv_1_4
+		enabledDeviceExtensions.push_back(VK_KHR_SHADER_FLOAT_CONTROLS_EXTENSION_NAME);
+
+		enabledMeshShaderFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MESH_SHADER_FEATURES_EXT;
 		enabledMeshShaderFeatures.meshShader = VK_TRUE;
 		enabledMeshShaderFeatures.taskShader = VK_TRUE;
-
+		enabledMeshShaderFeatures.pNext = deviceCreatepNextChain;
 		deviceCreatepNextChain = &enabledMeshShaderFeatures;
+		meshShaderSupported = true;
 	}
 
+	void loadAssets()
+	{
+		// The mesh shader reads the vertices from a storage buffer
+		vkglTF::memoryPropertyFlags = VK_BUFFER_USAGE_STORAGE_BUFFER_BIT;
+		const uint32_t glTFLoadingFlags = vkglTF::FileLoadingFlags::PreTransformVertices | vkglTF::FileLoadingFlags::PreMultiplyVertexColors | vkglTF::FileLoadingFlags::FlipY | vkglTF::FileLoadingFlags::DontLoadImages | vkglTF::FileLoadingFlags::KeepGeometry | vkglTF::FileLoadingFlags::BuildMeshlets;
+		model.loadFromFile(getAssetPath() + "models/chinesedragon.gltf", vulkanDevice, queue, glTFLoadingFlags);
+	}
+
+	// Builds the meshlets of all primitives from the host copy of the model's geometry
+	void buildMeshlets(vks::MeshletBuilder &builder)
+	{
+		const std::vector<vkglTF::Vertex> &vertices = model.geometry.vertices;
+		for (auto node : model.linearNodes) {
+			if (!node->mesh) {
+				continue;
+			}
+			for (vkglTF::Primitive *primitive : node->mesh->primitives) {
+				vks::MeshletBuilder::Input input;
+				input.positions = &vertices[primitive->firstVertex].pos;
+				input.positionStride = sizeof(vkglTF::Vertex);
+				input.normals = &vertices[primitive->firstVertex].normal;
+				input.normalStride = sizeof(vkglTF::Vertex);
+				input.baseVertex = primitive->firstVertex;
+				input.vertexCount = primitive->vertexCount;
+				input.indices = model.geometry.indices.data() + primitive->firstIndex;
+				input.indexCount = primitive->indexCount;
+				builder.build(input);
+			}
+		}
+	}
+
+	void runMeshletBenchmark()
+	{
+		const uint32_t runs = 20;
+		vks::MeshletBuilder builder;
+		float minTime = FLT_MAX;
+		float totalTime = 0.0f;
+		for (uint32_t run = 0; run < runs; run++) {
+			builder.clear();
+			buildMeshlets(builder);
+			minTime = std::min(minTime, builder.statistics.buildTime);
+			totalTime += builder.statistics.buildTime;
+		}
+		const vks::MeshletBuilder::Statistics &stats = builder.statistics;
+		uint32_t coneMeshlets = 0;
+		for (const vks::Meshlet &meshlet : builder.meshlets) {
+			if (meshlet.cone.w < 1.0f) {
+				coneMeshlets++;
+			}
+		}
+		const uint32_t sourceVertices = static_cast<uint32_t>(model.geometry.vertices.size());
+
+		std::cout << std::fixed << std::setprecision(3);
+		std::cout << "Meshlet builder benchmark, limits: " << vks::MeshletBuilder::maxVertices << " vertices, " << vks::MeshletBuilder::maxTriangles << " triangles\n";
+		std::cout << "triangles: " << stats.triangles << ", vertices: " << sourceVertices << "\n";
+		std::cout << "meshlets: " << stats.meshlets << ", " << (float)stats.triangles / (float)stats.meshlets << " triangles and " << (float)stats.vertices / (float)stats.meshlets << " vertices per meshlet\n";
+		std::cout << "vertex transforms: " << (float)stats.vertices / (float)sourceVertices << " per source vertex\n";
+		std::cout << "cone cullable meshlets: " << coneMeshlets << " (" << 100.0f * (float)coneMeshlets / (float)stats.meshlets << "%)\n";
+		std::cout << "build time over " << runs << " runs: min " << minTime << " ms, avg " << totalTime / (float)runs << " ms, " << (float)stats.triangles / (minTime * 1000.0f) << " Mtris/s\n";
+	}
+
+	// Expands the meshlet triangles into an index buffer for the indirect path
+	void prepareIndirectData()
+	{
+		vks::MeshletBuilder builder;
+		builder.meshlets = model.geometry.meshlets;
+		builder.vertices = model.geometry.meshletVertices;
+		builder.triangles = model.geometry.meshletTriangles;
+		std::vector<uint32_t> indices = builder.indices();
+
+		vks::Buffer stagingBuffer;
+		VK_CHECK_RESULT(vulkanDevice->createBuffer(VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, &stagingBuffer, indices.size() * sizeof(uint32_t), indices.data()));
+		VK_CHECK_RESULT(vulkanDevice->createBuffer(VK_BUFFER_USAGE_INDEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, &meshletIndexBuffer, stagingBuffer.size));
+		vulkanDevice->copyBuffer(&stagingBuffer, &meshletIndexBuffer, queue);
+		stagingBuffer.destroy();
+
+		// Filled by the cull shader every frame
+		VK_CHECK_RESULT(vulkanDevice->createBuffer(VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, &indirectCommandsBuffer, model.meshlets.count * sizeof(VkDrawIndexedIndirectCommand)));
+	}
 
 	void buildCommandBuffers()
 	{
@@ -88,12 +244,34 @@ public:
 		renderPassBeginInfo.clearValueCount = 2;
 		renderPassBeginInfo.pClearValues = clearValues;
 
+		const bool meshShading = (renderPath == RenderPathMeshShader);
+		const VkPipelineStageFlags cullStage = meshShading ? VK_PIPELINE_STAGE_TASK_SHADER_BIT_EXT : VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT;
+
 		for (int32_t i = 0; i < drawCmdBuffers.size(); ++i)
 		{
 			renderPassBeginInfo.framebuffer = frameBuffers[i];
 
 			VK_CHECK_RESULT(vkBeginCommandBuffer(drawCmdBuffers[i], &cmdBufInfo));
 
+			// Reset the visible meshlet counter
+			vkCmdFillBuffer(drawCmdBuffers[i], statisticsBuffer.buffer, 0, VK_WHOLE_SIZE, 0);
+			VkMemoryBarrier memoryBarrier = vks::initializers::memoryBarrier();
+			memoryBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+			memoryBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+			vkCmdPipelineBarrier(drawCmdBuffers[i], VK_PIPELINE_STAGE_TRANSFER_BIT, cullStage, 0, 1, &memoryBarrier, 0, nullptr, 0, nullptr);
+
+			vkCmdBindDescriptorSets(drawCmdBuffers[i], meshShading ? VK_PIPELINE_BIND_POINT_GRAPHICS : VK_PIPELINE_BIND_POINT_COMPUTE, pipelineLayout, 0, 1, &descriptorSet, 0, NULL);
+
+			if (!meshShading) {
+				// Cull the meshlets and write one indirect draw per meshlet, culled ones with an instance count of zero
+				vkCmdBindPipeline(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_COMPUTE, pipelines.cull);
+				vkCmdDispatch(drawCmdBuffers[i], (model.meshlets.count + CULL_WORKGROUP_SIZE - 1) / CULL_WORKGROUP_SIZE, 1, 1);
+				memoryBarrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+				memoryBarrier.dstAccessMask = VK_ACCESS_INDIRECT_COMMAND_READ_BIT;
+				vkCmdPipelineBarrier(drawCmdBuffers[i], VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT, 0, 1, &memoryBarrier, 0, nullptr, 0, nullptr);
+				vkCmdBindDescriptorSets(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 0, 1, &descriptorSet, 0, NULL);
+			}
+
 			vkCmdBeginRenderPass(drawCmdBuffers[i], &renderPassBeginInfo, VK_SUBPASS_CONTENTS_INLINE);
 
 			VkViewport viewport = vks::initializers::viewport((float)width, (float)height, 0.0f, 1.0f);
@@ -102,31 +280,65 @@ public:
 			VkRect2D scissor = vks::initializers::rect2D(width, height,	0, 0);
 			vkCmdSetScissor(drawCmdBuffers[i], 0, 1, &scissor);
 
-			vkCmdBindDescriptorSets(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 0, 1, &descriptorSet, 0, NULL);
-
-			vkCmdBindPipeline(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline);
-			vkCmdDrawMeshTasksEXT(drawCmdBuffers[i], 1, 1, 1);
+			if (meshShading) {
+				// Each task workgroup culls a batch of meshlets and launches one mesh workgroup per visible meshlet
+				vkCmdBindPipeline(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pipelines.meshShader);
+				vkCmdDrawMeshTasksEXT(drawCmdBuffers[i], (model.meshlets.count + MESHLETS_PER_TASK - 1) / MESHLETS_PER_TASK, 1, 1);
+			} else {
+				vkCmdBindPipeline(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pipelines.indirect);
+				VkDeviceSize offsets[1] = { 0 };
+				vkCmdBindVertexBuffers(drawCmdBuffers[i], 0, 1, &model.vertices.buffer, offsets);
+				vkCmdBindIndexBuffer(drawCmdBuffers[i], meshletIndexBuffer.buffer, 0, VK_INDEX_TYPE_UINT32);
+				// Without multi draw indirect every meshlet needs its own draw call
+				const uint32_t maxDrawCount = vulkanDevice->features.multiDrawIndirect ? vulkanDevice->properties.limits.maxDrawIndirectCount : 1;
+				for (uint32_t first = 0; first < model.meshlets.count; first += maxDrawCount) {
+					vkCmdDrawIndexedIndirect(drawCmdBuffers[i], indirectCommandsBuffer.buffer, first * sizeof(VkDrawIndexedIndirectCommand), std::min(maxDrawCount, model.meshlets.count - first), sizeof(VkDrawIndexedIndirectCommand));
+				}
+			}
 
 			drawUI(drawCmdBuffers[i]);
 
 			vkCmdEndRenderPass(drawCmdBuffers[i]);
 
+			// Make the counter visible to the host
+			memoryBarrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+			memoryBarrier.dstAccessMask = VK_ACCESS_HOST_READ_BIT;
+			vkCmdPipelineBarrier(drawCmdBuffers[i], cullStage, VK_PIPELINE_STAGE_HOST_BIT, 0, 1, &memoryBarrier, 0, nullptr, 0, nullptr);
+
 			VK_CHECK_RESULT(vkEndCommandBuffer(drawCmdBuffers[i]));
 		}
 	}
 
 	void setupDescriptors()
 	{
+		// Stages that may only be used if mesh shading has been enabled
+		const VkShaderStageFlags taskStage = meshShaderSupported ? VK_SHADER_STAGE_TASK_BIT_EXT : 0;
+		const VkShaderStageFlags meshStage = meshShaderSupported ? VK_SHADER_STAGE_MESH_BIT_EXT : 0;
+
 		// Pool
 		std::vector<VkDescriptorPoolSize> poolSizes = {
 			vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 1),
+			vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 6),
 		};
 		VkDescriptorPoolCreateInfo descriptorPoolInfo = vks::initializers::descriptorPoolCreateInfo(static_cast<uint32_t>(poolSizes.size()), poolSizes.data(), 1);
 		VK_CHECK_RESULT(vkCreateDescriptorPool(device, &descriptorPoolInfo, nullptr, &descriptorPool));
 
 		// Layout
 		std::vector<VkDescriptorSetLayoutBinding> setLayoutBindings = {
-			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, VK_SHADER_STAGE_MESH_BIT_EXT, 0),
+			// Binding 0 : Uniform buffer
+			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, taskStage | meshStage | VK_SHADER_STAGE_COMPUTE_BIT | VK_SHADER_STAGE_VERTEX_BIT, 0),
+			// Binding 1 : Meshlets
+			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, taskStage | meshStage | VK_SHADER_STAGE_COMPUTE_BIT, 1),
+			// Binding 2 : Meshlet vertices
+			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, meshStage, 2),
+			// Binding 3 : Meshlet triangles
+			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, meshStage, 3),
+			// Binding 4 : Model vertices
+			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, meshStage, 4),
+			// Binding 5 : Statistics
+			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, taskStage | VK_SHADER_STAGE_COMPUTE_BIT, 5),
+			// Binding 6 : Indirect draw commands
+			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT, 6),
 		};
 		VkDescriptorSetLayoutCreateInfo descriptorLayoutInfo = vks::initializers::descriptorSetLayoutCreateInfo(setLayoutBindings);
 		VK_CHECK_RESULT(vkCreateDescriptorSetLayout(device, &descriptorLayoutInfo, nullptr, &descriptorSetLayout));
@@ -134,8 +346,15 @@ public:
 		// Set
 		VkDescriptorSetAllocateInfo allocInfo = vks::initializers::descriptorSetAllocateInfo(descriptorPool, &descriptorSetLayout, 1);
 		VK_CHECK_RESULT(vkAllocateDescriptorSets(device, &allocInfo, &descriptorSet));
+		VkDescriptorBufferInfo vertexBufferDescriptor{ model.vertices.buffer, 0, VK_WHOLE_SIZE };
 		std::vector<VkWriteDescriptorSet> modelWriteDescriptorSets = {
 			vks::initializers::writeDescriptorSet(descriptorSet, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 0, &uniformBuffer.descriptor),
+			vks::initializers::writeDescriptorSet(descriptorSet, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1, &model.meshlets.buffer.descriptor),
+			vks::initializers::writeDescriptorSet(descriptorSet, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 2, &model.meshlets.vertices.descriptor),
+			vks::initializers::writeDescriptorSet(descriptorSet, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 3, &model.meshlets.triangles.descriptor),
+			vks::initializers::writeDescriptorSet(descriptorSet, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 4, &vertexBufferDescriptor),
+			vks::initializers::writeDescriptorSet(descriptorSet, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 5, &statisticsBuffer.descriptor),
+			vks::initializers::writeDescriptorSet(descriptorSet, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 6, &indirectCommandsBuffer.descriptor),
 		};
 		vkUpdateDescriptorSets(device, static_cast<uint32_t>(modelWriteDescriptorSets.size()), modelWriteDescriptorSets.data(), 0, nullptr);
 	}
@@ -148,7 +367,7 @@ public:
 
 		// Pipeline
 		VkPipelineInputAssemblyStateCreateInfo inputAssemblyState = vks::initializers::pipelineInputAssemblyStateCreateInfo(VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST, 0, VK_FALSE);
-		VkPipelineRasterizationStateCreateInfo rasterizationState = vks::initializers::pipelineRasterizationStateCreateInfo(VK_POLYGON_MODE_FILL, VK_CULL_MODE_NONE, VK_FRONT_FACE_CLOCKWISE, 0);
+		VkPipelineRasterizationStateCreateInfo rasterizationState = vks::initializers::pipelineRasterizationStateCreateInfo(VK_POLYGON_MODE_FILL, VK_CULL_MODE_BACK_BIT, VK_FRONT_FACE_COUNTER_CLOCKWISE, 0);
 		VkPipelineColorBlendAttachmentState blendAttachmentState = vks::initializers::pipelineColorBlendAttachmentState(0xf, VK_FALSE);
 		VkPipelineColorBlendStateCreateInfo colorBlendState = vks::initializers::pipelineColorBlendStateCreateInfo(1, &blendAttachmentState);
 		VkPipelineDepthStencilStateCreateInfo depthStencilState = vks::initializers::pipelineDepthStencilStateCreateInfo(VK_TRUE, VK_TRUE, VK_COMPARE_OP_LESS_OR_EQUAL);
@@ -159,24 +378,36 @@ public:
 		std::array<VkPipelineShaderStageCreateInfo, 3> shaderStages;
 
 		VkGraphicsPipelineCreateInfo pipelineCI = vks::initializers::pipelineCreateInfo(pipelineLayout, renderPass, 0);
-
-		// Mesh shading doesn't require vertex input state
-		pipelineCI.pInputAssemblyState = nullptr;
-		pipelineCI.pVertexInputState = nullptr;
-
 		pipelineCI.pRasterizationState = &rasterizationState;
 		pipelineCI.pColorBlendState = &colorBlendState;
 		pipelineCI.pMultisampleState = &multisampleState;
 		pipelineCI.pViewportState = &viewportState;
 		pipelineCI.pDepthStencilState = &depthStencilState;
 		pipelineCI.pDynamicState = &dynamicState;
-		pipelineCI.stageCount = static_cast<uint32_t>(shaderStages.size());
 		pipelineCI.pStages = shaderStages.data();
 
-		shaderStages[0] = loadShader(getShadersPath() + "meshshader/meshshader.mesh.spv", VK_SHADER_STAGE_MESH_BIT_EXT);
-		shaderStages[1] = loadShader(getShadersPath() + "meshshader/meshshader.task.spv", VK_SHADER_STAGE_TASK_BIT_EXT);
-		shaderStages[2] = loadShader(getShadersPath() + "meshshader/meshshader.frag.spv", VK_SHADER_STAGE_FRAGMENT_BIT);
-		VK_CHECK_RESULT(vkCreateGraphicsPipelines(device, pipelineCache, 1, &pipelineCI, nullptr, &pipeline));
+		if (meshShaderSupported) {
+			// Mesh shading doesn't require vertex input state
+			pipelineCI.pInputAssemblyState = nullptr;
+			pipelineCI.pVertexInputState = nullptr;
+			pipelineCI.stageCount = 3;
+			shaderStages[0] = loadShader(getShadersPath() + "meshshader/meshshader.mesh.spv", VK_SHADER_STAGE_MESH_BIT_EXT);
+			shaderStages[1] = loadShader(getShadersPath() + "meshshader/meshshader.task.spv", VK_SHADER_STAGE_TASK_BIT_EXT);
+			shaderStages[2] = loadShader(getShadersPath() + "meshshader/meshshader.frag.spv", VK_SHADER_STAGE_FRAGMENT_BIT);
+			VK_CHECK_RESULT(vkCreateGraphicsPipelines(device, pipelineCache, 1, &pipelineCI, nullptr, &pipelines.meshShader));
+		}
+
+		// Indirect path
+		pipelineCI.pInputAssemblyState = &inputAssemblyState;
+		pipelineCI.pVertexInputState = vkglTF::Vertex::getPipelineVertexInputState({ vkglTF::VertexComponent::Position, vkglTF::VertexComponent::Normal, vkglTF::VertexComponent::Color });
+		pipelineCI.stageCount = 2;
+		shaderStages[0] = loadShader(getShadersPath() + "meshshader/indirect.vert.spv", VK_SHADER_STAGE_VERTEX_BIT);
+		shaderStages[1] = loadShader(getShadersPath() + "meshshader/meshshader.frag.spv", VK_SHADER_STAGE_FRAGMENT_BIT);
+		VK_CHECK_RESULT(vkCreateGraphicsPipelines(device, pipelineCache, 1, &pipelineCI, nullptr, &pipelines.indirect));
+
+		VkComputePipelineCreateInfo computePipelineCI = vks::initializers::computePipelineCreateInfo(pipelineLayout, 0);
+		computePipelineCI.stage = loadShader(getShadersPath() + "meshshader/meshletcull.comp.spv", VK_SHADER_STAGE_COMPUTE_BIT);
+		VK_CHECK_RESULT(vkCreateComputePipelines(device, pipelineCache, 1, &computePipelineCI, nullptr, &pipelines.cull));
 	}
 
 	// Prepare and initialize uniform buffer containing shader uniforms
@@ -184,6 +415,8 @@ public:
 	{
 		VK_CHECK_RESULT(vulkanDevice->createBuffer(VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, &uniformBuffer, sizeof(UniformData)));
 		VK_CHECK_RESULT(uniformBuffer.map());
+		VK_CHECK_RESULT(vulkanDevice->createBuffer(VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, &statisticsBuffer, sizeof(uint32_t)));
+		VK_CHECK_RESULT(statisticsBuffer.map());
 		updateUniformBuffers();
 	}
 
@@ -192,6 +425,17 @@ public:
 		uniformData.projection = camera.matrices.perspective;
 		uniformData.view = camera.matrices.view;
 		uniformData.model = glm::mat4(1.0f);
+		const glm::mat4 modelView = uniformData.view * uniformData.model;
+		vks::Frustum frustum;
+		frustum.update(uniformData.projection * modelView);
+		memcpy(uniformData.frustumPlanes, frustum.planes.data(), sizeof(glm::vec4) * 6);
+		uniformData.cameraPos = glm::inverse(modelView)[3];
+		uniformData.meshletCount = model.meshlets.count;
+		uniformData.vertexStride = sizeof(vkglTF::Vertex) / sizeof(float);
+		uniformData.frustumCulling = frustumCulling ? 1 : 0;
+		uniformData.coneCulling = coneCulling ? 1 : 0;
+		uniformData.colorMeshlets = colorMeshlets ? 1 : 0;
+		uniformData.meshletIndexAsInstance = vulkanDevice->features.drawIndirectFirstInstance ? 1 : 0;
 		memcpy(uniformBuffer.mapped, &uniformData, sizeof(UniformData));
 	}
 
@@ -204,15 +448,28 @@ public:
 		VK_CHECK_RESULT(vkQueueSubmit(queue, 1, &submitInfo, VK_NULL_HANDLE));
 
 		VulkanExampleBase::submitFrame();
+
+		// The base class waits for the queue, so the counter of this frame is available
+		visibleMeshlets = *static_cast<uint32_t*>(statisticsBuffer.mapped);
 	}
 
 	void prepare()
 	{
 		VulkanExampleBase::prepare();
+		loadAssets();
+		if (commandLineParser.isSet("meshletbenchmark")) {
+			runMeshletBenchmark();
+			exit(0);
+		}
 
-		// Get the function pointer of the mesh shader drawing funtion
-		vkCmdDrawMeshTasksEXT = reinterpret_cast<PFN_vkCmdDrawMeshTasksEXT>(vkGetDeviceProcAddr(device, "vkCmdDrawMeshTasksEXT"));
+		if (meshShaderSupported) {
+			// Get the function pointer of the mesh shader drawing funtion
+			vkCmdDrawMeshTasksEXT = reinterpret_cast<PFN_vkCmdDrawMeshTasksEXT>(vkGetDeviceProcAddr(device, "vkCmdDrawMeshTasksEXT"));
+		} else {
+			renderPath = RenderPathIndirect;
+		}
 
+		prepareIndirectData();
 		prepareUniformBuffers();
 		setupDescriptors();
 		preparePipelines();
@@ -231,6 +488,39 @@ public:
 	{
 		updateUniformBuffers();
 	}
+
+	virtual void OnUpdateUIOverlay(vks::UIOverlay *overlay)
+	{
+		if (overlay->header("Settings")) {
+			if (meshShaderSupported) {
+				if (overlay->comboBox("Path", &renderPath, { "Mesh shader", "Indirect draws" })) {
+					buildCommandBuffers();
+				}
+			} else {
+				overlay->text("Mesh shaders not supported, using indirect draws");
+			}
+			if (overlay->checkBox("Frustum culling", &frustumCulling)) {
+				updateUniformBuffers();
+			}
+			if (overlay->checkBox("Cone culling", &coneCulling)) {
+				updateUniformBuffers();
+			}
+			if (overlay->checkBox("Color meshlets", &colorMeshlets)) {
+				updateUniformBuffers();
+			}
+		}
+		if (overlay->header("Statistics")) {
+			const vks::MeshletBuilder::Statistics &stats = model.meshlets.statistics;
+			overlay->text("Meshlets: %d visible of %d", visibleMeshlets, stats.meshlets);
+			overlay->text("Triangles per meshlet: %.1f", (float)stats.triangles / (float)stats.meshlets);
+			overlay->text("Vertices per meshlet: %.1f", (float)stats.vertices / (float)stats.meshlets);
+			if (stats.cached) {
+				overlay->text("Loaded from cache");
+			} else {
+				overlay->text("Build: %.2f ms", stats.buildTime);
+			}
+		}
+	}
 };
 
 VULKAN_EXAMPLE_MAIN()
@@ -1,5 +1,10 @@
 /*
-* Vulkan Example - Using occlusion query for visibility testing
+* Vulkan Example - Occlusion culling with a hierarchical depth pyramid and non-blocking occlusion queries
+*
+* A grid of objects is placed on both sides of a large occluder. The draws of all objects are culled on the GPU against
+* the view frustum and a depth pyramid (Hi-Z) built from the previous frame's depth buffer, visible draws are then
+* issued with indirect draw commands. As a fallback occlusion queries are used, their results are read back from a
+* ring of per frame slots without waiting for the GPU
 *
 * Copyright (C) 2016 by Sascha Willems - www.saschawillems.de
 *
@@ -8,9 +13,15 @@
 
 #include "vulkanexamplebase.h"
 #include "VulkanglTFModel.h"
+#include "VulkanOcclusionCuller.h"
 
 #define VERTEX_BUFFER_BIND_ID 0
+#define INSTANCE_BUFFER_BIND_ID 1
 #define ENABLE_VALIDATION false
+// Objects per grid row and column on each side of the occluder
+#define OBJECT_GRID_DIM 12
+// Grid layers on each side of the occluder
+#define OBJECT_GRID_LAYERS 3
 
 class VulkanExample : public VulkanExampleBase
 {
@@ -23,47 +34,52 @@ public:
 	} models;
 
 	struct {
-		vks::Buffer occluder;
-		vks::Buffer teapot;
-		vks::Buffer sphere;
-	} uniformBuffers;
-
-	struct UBOVS {
 		glm::mat4 projection;
 		glm::mat4 view;
-		glm::mat4 model;
-		glm::vec4 color = glm::vec4(0.0f);
 		glm::vec4 lightPos = glm::vec4(10.0f, -10.0f, 10.0f, 1.0f);
-		float visible;
-	} uboVS;
+	} uboScene;
+
+	// Per object data, passed as per instance vertex attributes and selected with the first instance of a draw
+	struct ObjectData {
+		glm::mat4 model;
+		glm::vec4 color;
+	};
+	std::vector<ObjectData> objects;
+
+	struct {
+		vks::Buffer scene;
+		vks::Buffer objects;
+	} buffers;
 
 	struct {
 		VkPipeline solid;
 		VkPipeline occluder;
-		// Pipeline with basic shaders used for occlusion pass
-		VkPipeline simple;
+		// Writes the occluder's depth before the occlusion queries are issued
+		VkPipeline occluderDepth;
 	} pipelines;
 
-	struct {
-		VkDescriptorSet teapot;
-		VkDescriptorSet sphere;
-	} descriptorSets;
-
 	VkPipelineLayout pipelineLayout;
 	VkDescriptorSet descriptorSet;
 	VkDescriptorSetLayout descriptorSetLayout;
 
-	// Pool that stores all occlusion queries
-	VkQueryPool queryPool;
+	vks::OcclusionCuller occlusionCuller;
+	int32_t cullingMode = vks::OcclusionCuller::ModeHiZ;
 
-	// Passed query samples
-	uint64_t passedSamples[2] = { 1,1 };
+	// Draw ranges of the models, the vertex and index buffers are bound per model
+	struct DrawRange {
+		uint32_t first = 0;
+		uint32_t count = 0;
+	};
+	struct {
+		DrawRange teapot;
+		DrawRange sphere;
+	} drawRanges;
 
 	VulkanExample() : VulkanExampleBase(ENABLE_VALIDATION)
 	{
-		title = "Occlusion queries";
+		title = "Occlusion culling";
 		camera.type = Camera::CameraType::lookat;
-		camera.setPosition(glm::vec3(0.0f, 0.0f, -7.5f));
+		camera.setPosition(glm::vec3(0.0f, 0.0f, -20.0f));
 		camera.setRotation(glm::vec3(0.0f, -123.75f, 0.0f));
 		camera.setRotationSpeed(0.5f);
 		camera.setPerspective(60.0f, (float)width / (float)height, 1.0f, 256.0f);
@@ -75,44 +91,68 @@ public:
 		// Note : Inherited destructor cleans up resources stored in base class
 		vkDestroyPipeline(device, pipelines.solid, nullptr);
 		vkDestroyPipeline(device, pipelines.occluder, nullptr);
-		vkDestroyPipeline(device, pipelines.simple, nullptr);
+		vkDestroyPipeline(device, pipelines.occluderDepth, nullptr);
 
 		vkDestroyPipelineLayout(device, pipelineLayout, nullptr);
 		vkDestroyDescriptorSetLayout(device, descriptorSetLayout, nullptr);
 
-		vkDestroyQueryPool(device, queryPool, nullptr);
+		occlusionCuller.destroy();
 
-		uniformBuffers.occluder.destroy();
-		uniformBuffers.sphere.destroy();
-		uniformBuffers.teapot.destroy();
+		buffers.scene.destroy();
+		buffers.objects.destroy();
 	}
 
-	// Create a query pool for storing the occlusion query result
-	void setupQueryPool()
+	virtual void getEnabledFeatures()
 	{
-		VkQueryPoolCreateInfo queryPoolInfo = {};
-		queryPoolInfo.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
-		queryPoolInfo.queryType = VK_QUERY_TYPE_OCCLUSION;
-		queryPoolInfo.queryCount = 2;
-		VK_CHECK_RESULT(vkCreateQueryPool(device, &queryPoolInfo, NULL, &queryPool));
+		// Every object's data is selected with the first instance of its indirect draw command
+		if (deviceFeatures.drawIndirectFirstInstance) {
+			enabledFeatures.drawIndirectFirstInstance = VK_TRUE;
+		}
+		else {
+			vks::tools::exitFatal("Selected GPU does not support indirect draws with a first instance", VK_ERROR_FEATURE_NOT_PRESENT);
+		}
+		if (deviceFeatures.multiDrawIndirect) {
+			enabledFeatures.multiDrawIndirect = VK_TRUE;
+		}
 	}
 
-	// Retrieves the results of the occlusion queries submitted to the command buffer
-	void getQueryResults()
+	// The depth pyramid is built from the depth buffer, so it needs to be sampled in addition to being used as an attachment
+	void setupDepthStencil()
 	{
-		// We use vkGetQueryResults to copy the results into a host visible buffer
-		vkGetQueryPoolResults(
-			device,
-			queryPool,
-			0,
-			2,
-			sizeof(passedSamples),
-			passedSamples,
-			sizeof(uint64_t),
-			// Store results a 64 bit values and wait until the results have been finished
-			// If you don't want to wait, you can use VK_QUERY_RESULT_WITH_AVAILABILITY_BIT
-			// which also returns the state of the result (ready) in the result
-			VK_QUERY_RESULT_64_BIT | VK_QUERY_RESULT_WAIT_BIT);
+		VkImageCreateInfo imageCI = vks::initializers::imageCreateInfo();
+		imageCI.imageType = VK_IMAGE_TYPE_2D;
+		imageCI.format = depthFormat;
+		imageCI.extent = { width, height, 1 };
+		imageCI.mipLevels = 1;
+		imageCI.arrayLayers = 1;
+		imageCI.samples = VK_SAMPLE_COUNT_1_BIT;
+		imageCI.tiling = VK_IMAGE_TILING_OPTIMAL;
+		imageCI.usage = VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
+		VK_CHECK_RESULT(vkCreateImage(device, &imageCI, nullptr, &depthStencil.image));
+
+		VkMemoryRequirements memReqs{};
+		vkGetImageMemoryRequirements(device, depthStencil.image, &memReqs);
+		VkMemoryAllocateInfo memAlloc = vks::initializers::memoryAllocateInfo();
+		memAlloc.allocationSize = memReqs.size;
+		memAlloc.memoryTypeIndex = vulkanDevice->getMemoryType(memReqs.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+		VK_CHECK_RESULT(vkAllocateMemory(device, &memAlloc, nullptr, &depthStencil.mem));
+		VK_CHECK_RESULT(vkBindImageMemory(device, depthStencil.image, depthStencil.mem, 0));
+
+		VkImageViewCreateInfo imageViewCI = vks::initializers::imageViewCreateInfo();
+		imageViewCI.viewType = VK_IMAGE_VIEW_TYPE_2D;
+		imageViewCI.image = depthStencil.image;
+		imageViewCI.format = depthFormat;
+		imageViewCI.subresourceRange = { VK_IMAGE_ASPECT_DEPTH_BIT, 0, 1, 0, 1 };
+		// Stencil aspect should only be set on depth + stencil formats (VK_FORMAT_D16_UNORM_S8_UINT..VK_FORMAT_D32_SFLOAT_S8_UINT
+		if (depthFormat >= VK_FORMAT_D16_UNORM_S8_UINT) {
+			imageViewCI.subresourceRange.aspectMask |= VK_IMAGE_ASPECT_STENCIL_BIT;
+		}
+		VK_CHECK_RESULT(vkCreateImageView(device, &imageViewCI, nullptr, &depthStencil.view));
+
+		// Called again on resize before the command buffers are rebuilt
+		if (occlusionCuller.drawCount() > 0) {
+			occlusionCuller.resize(depthStencil.image, depthFormat, width, height);
+		}
 	}
 
 	void buildCommandBuffers()
@@ -132,6 +172,8 @@ public:
 		renderPassBeginInfo.clearValueCount = 2;
 		renderPassBeginInfo.pClearValues = clearValues;
 
+		occlusionCuller.mode = static_cast<vks::OcclusionCuller::Mode>(cullingMode);
+
 		for (int32_t i = 0; i < drawCmdBuffers.size(); ++i)
 		{
 			// Set target frame buffer
@@ -139,105 +181,62 @@ public:
 
 			VK_CHECK_RESULT(vkBeginCommandBuffer(drawCmdBuffers[i], &cmdBufInfo));
 
-			// Reset query pool
+			// Culling against the previous frame's depth pyramid (or reset of this frame's query slot)
 			// Must be done outside of render pass
-			vkCmdResetQueryPool(drawCmdBuffers[i], queryPool, 0, 2);
+			occlusionCuller.recordCulling(drawCmdBuffers[i], i);
 
 			vkCmdBeginRenderPass(drawCmdBuffers[i], &renderPassBeginInfo, VK_SUBPASS_CONTENTS_INLINE);
 
-			VkViewport viewport = vks::initializers::viewport(
-				(float)width,
-				(float)height,
-				0.0f,
-				1.0f);
+			VkViewport viewport = vks::initializers::viewport((float)width, (float)height, 0.0f, 1.0f);
 			vkCmdSetViewport(drawCmdBuffers[i], 0, 1, &viewport);
 
-			VkRect2D scissor = vks::initializers::rect2D(
-				width,
-				height,
-				0,
-				0);
+			VkRect2D scissor = vks::initializers::rect2D(width, height, 0, 0);
 			vkCmdSetScissor(drawCmdBuffers[i], 0, 1, &scissor);
 
-			glm::mat4 modelMatrix = glm::mat4(1.0f);
-
-			// Occlusion pass
-			vkCmdBindPipeline(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pipelines.simple);
-
-			// Occluder first
-			vkCmdBindDescriptorSets(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 0, 1, &descriptorSet, 0, NULL);
+			// Occluder depth first, the occlusion queries are tested against it
+			vkCmdBindPipeline(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pipelines.occluderDepth);
+			vkCmdBindDescriptorSets(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 0, 1, &descriptorSet, 0, nullptr);
+			VkDeviceSize offsets[1] = { 0 };
+			vkCmdBindVertexBuffers(drawCmdBuffers[i], INSTANCE_BUFFER_BIND_ID, 1, &buffers.objects.buffer, offsets);
 			models.plane.draw(drawCmdBuffers[i]);
 
-			// Teapot
-			vkCmdBeginQuery(drawCmdBuffers[i], queryPool, 0, VK_FLAGS_NONE);
-			vkCmdBindDescriptorSets(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 0, 1, &descriptorSets.teapot, 0, NULL);
-			models.teapot.draw(drawCmdBuffers[i]);
-			vkCmdEndQuery(drawCmdBuffers[i], queryPool, 0);
-
-			// Sphere
-			vkCmdBeginQuery(drawCmdBuffers[i], queryPool, 1, VK_FLAGS_NONE);
-			vkCmdBindDescriptorSets(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 0, 1, &descriptorSets.sphere, 0, NULL);
-			models.sphere.draw(drawCmdBuffers[i]);
-			vkCmdEndQuery(drawCmdBuffers[i], queryPool, 1);
-
-			// Visible pass
-			// Clear color and depth attachments
-			VkClearAttachment clearAttachments[2] = {};
-
-			clearAttachments[0].aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-			clearAttachments[0].clearValue.color = defaultClearColor;
-			clearAttachments[0].colorAttachment = 0;
-
-			clearAttachments[1].aspectMask = VK_IMAGE_ASPECT_DEPTH_BIT;
-			clearAttachments[1].clearValue.depthStencil = { 1.0f, 0 };
-
-			VkClearRect clearRect = {};
-			clearRect.layerCount = 1;
-			clearRect.rect.offset = { 0, 0 };
-			clearRect.rect.extent = { width, height };
-
-			vkCmdClearAttachments(
-				drawCmdBuffers[i],
-				2,
-				clearAttachments,
-				1,
-				&clearRect);
+			occlusionCuller.recordOcclusionQueries(drawCmdBuffers[i], i);
 
+			// Visible objects
 			vkCmdBindPipeline(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pipelines.solid);
-
-			// Teapot
-			vkCmdBindDescriptorSets(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 0, 1, &descriptorSets.teapot, 0, NULL);
-			models.teapot.draw(drawCmdBuffers[i]);
-
-			// Sphere
-			vkCmdBindDescriptorSets(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 0, 1, &descriptorSets.sphere, 0, NULL);
-			models.sphere.draw(drawCmdBuffers[i]);
+			vkCmdBindDescriptorSets(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 0, 1, &descriptorSet, 0, nullptr);
+			models.teapot.bindBuffers(drawCmdBuffers[i]);
+			occlusionCuller.drawIndirect(drawCmdBuffers[i], i, drawRanges.teapot.first, drawRanges.teapot.count);
+			models.sphere.bindBuffers(drawCmdBuffers[i]);
+			occlusionCuller.drawIndirect(drawCmdBuffers[i], i, drawRanges.sphere.first, drawRanges.sphere.count);
 
 			// Occluder
 			vkCmdBindPipeline(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pipelines.occluder);
-			vkCmdBindDescriptorSets(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 0, 1, &descriptorSet, 0, NULL);
 			models.plane.draw(drawCmdBuffers[i]);
 
 			drawUI(drawCmdBuffers[i]);
 
 			vkCmdEndRenderPass(drawCmdBuffers[i]);
 
+			// Depth pyramid for the next frame
+			occlusionCuller.recordDepthPyramid(drawCmdBuffers[i]);
+
 			VK_CHECK_RESULT(vkEndCommandBuffer(drawCmdBuffers[i]));
 		}
 	}
 
 	void draw()
 	{
-		updateUniformBuffers();
 		VulkanExampleBase::prepareFrame();
 
+		// Reads the results of the frame that last used this command buffer, which has already finished executing
+		updateUniformBuffers();
+		occlusionCuller.update(currentBuffer, camera.matrices.perspective * camera.matrices.view);
+
 		submitInfo.commandBufferCount = 1;
 		submitInfo.pCommandBuffers = &drawCmdBuffers[currentBuffer];
 		VK_CHECK_RESULT(vkQueueSubmit(queue, 1, &submitInfo, VK_NULL_HANDLE));
 
-		// Read query results for displaying in next frame
-		getQueryResults();
-
 		VulkanExampleBase::submitFrame();
 	}
 
@@ -249,87 +248,82 @@ public:
 		models.sphere.loadFromFile(getAssetPath() + "models/sphere.gltf", vulkanDevice, queue, glTFLoadingFlags);
 	}
 
-	void setupDescriptorPool()
+	// Object 0 is the occluder, followed by grids of teapots and spheres on both sides of it
+	void prepareObjects()
 	{
-		std::vector<VkDescriptorPoolSize> poolSizes =
-		{
-			// One uniform buffer block for each mesh
-			vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 3)
-		};
-
-		VkDescriptorPoolCreateInfo descriptorPoolInfo =
-			vks::initializers::descriptorPoolCreateInfo(
-				poolSizes.size(),
-				poolSizes.data(),
-				3);
+		ObjectData occluder;
+		occluder.model = glm::scale(glm::mat4(1.0f), glm::vec3(6.0f));
+		occluder.color = glm::vec4(0.0f, 0.0f, 1.0f, 0.5f);
+		objects.push_back(occluder);
+
+		std::vector<glm::vec3> positions;
+		const float spacing = 10.0f / static_cast<float>(OBJECT_GRID_DIM - 1);
+		for (int32_t side = -1; side <= 1; side += 2) {
+			for (uint32_t layer = 0; layer < OBJECT_GRID_LAYERS; layer++) {
+				for (uint32_t y = 0; y < OBJECT_GRID_DIM; y++) {
+					for (uint32_t x = 0; x < OBJECT_GRID_DIM; x++) {
+						positions.push_back(glm::vec3(-5.0f + x * spacing, -5.0f + y * spacing, static_cast<float>(side) * (2.0f + layer * 1.5f)));
+					}
+				}
+			}
+		}
 
-		VK_CHECK_RESULT(vkCreateDescriptorPool(device, &descriptorPoolInfo, nullptr, &descriptorPool));
+		// Draws of a model have to be consecutive, as they share vertex and index buffers
+		const bool flipY = true;
+		drawRanges.teapot.first = occlusionCuller.drawCount();
+		for (size_t i = 0; i < positions.size(); i += 2) {
+			ObjectData object;
+			object.model = glm::scale(glm::translate(glm::mat4(1.0f), positions[i]), glm::vec3(0.25f));
+			object.color = glm::vec4(1.0f, 0.0f, 0.0f, 1.0f);
+			occlusionCuller.addModel(models.teapot, object.model, static_cast<uint32_t>(objects.size()), flipY);
+			objects.push_back(object);
+		}
+		drawRanges.teapot.count = occlusionCuller.drawCount() - drawRanges.teapot.first;
+		drawRanges.sphere.first = occlusionCuller.drawCount();
+		for (size_t i = 1; i < positions.size(); i += 2) {
+			ObjectData object;
+			object.model = glm::scale(glm::translate(glm::mat4(1.0f), positions[i]), glm::vec3(0.35f));
+			object.color = glm::vec4(0.0f, 1.0f, 0.0f, 1.0f);
+			occlusionCuller.addModel(models.sphere, object.model, static_cast<uint32_t>(objects.size()), flipY);
+			objects.push_back(object);
+		}
+		drawRanges.sphere.count = occlusionCuller.drawCount() - drawRanges.sphere.first;
+		occlusionCuller.finalize();
+		occlusionCuller.resize(depthStencil.image, depthFormat, width, height);
+		cullingMode = occlusionCuller.mode;
 	}
 
-	void setupDescriptorSetLayout()
+	void setupDescriptors()
 	{
-		std::vector<VkDescriptorSetLayoutBinding> setLayoutBindings =
-		{
-			// Binding 0 : Vertex shader uniform buffer
-			vks::initializers::descriptorSetLayoutBinding(
-				VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER,
-				VK_SHADER_STAGE_VERTEX_BIT,
-				0)
+		// Pool
+		std::vector<VkDescriptorPoolSize> poolSizes = {
+			vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 1)
 		};
+		VkDescriptorPoolCreateInfo descriptorPoolInfo = vks::initializers::descriptorPoolCreateInfo(poolSizes, 1);
+		VK_CHECK_RESULT(vkCreateDescriptorPool(device, &descriptorPoolInfo, nullptr, &descriptorPool));
 
-		VkDescriptorSetLayoutCreateInfo descriptorLayout =
-			vks::initializers::descriptorSetLayoutCreateInfo(
-				setLayoutBindings.data(),
-				setLayoutBindings.size());
-
+		// Layout
+		std::vector<VkDescriptorSetLayoutBinding> setLayoutBindings = {
+			// Binding 0 : Vertex shader uniform buffer
+			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, VK_SHADER_STAGE_VERTEX_BIT, 0),
+		};
+		VkDescriptorSetLayoutCreateInfo descriptorLayout = vks::initializers::descriptorSetLayoutCreateInfo(setLayoutBindings);
 		VK_CHECK_RESULT(vkCreateDescriptorSetLayout(device, &descriptorLayout, nullptr, &descriptorSetLayout));
 
-		VkPipelineLayoutCreateInfo pPipelineLayoutCreateInfo =
-			vks::initializers::pipelineLayoutCreateInfo(
-				&descriptorSetLayout,
-				1);
-
-		VK_CHECK_RESULT(vkCreatePipelineLayout(device, &pPipelineLayoutCreateInfo, nullptr, &pipelineLayout));
-	}
-
-	void setupDescriptorSets()
-	{
-		VkDescriptorSetAllocateInfo allocInfo =
-			vks::initializers::descriptorSetAllocateInfo(
-				descriptorPool,
-				&descriptorSetLayout,
-				1);
-
-		// Occluder (plane)
+		// Set
+		VkDescriptorSetAllocateInfo allocInfo = vks::initializers::descriptorSetAllocateInfo(descriptorPool, &descriptorSetLayout, 1);
 		VK_CHECK_RESULT(vkAllocateDescriptorSets(device, &allocInfo, &descriptorSet));
-
-		std::vector<VkWriteDescriptorSet> writeDescriptorSets =
-		{
-			// Binding 0 : Vertex shader uniform buffer
-			vks::initializers::writeDescriptorSet(
-				descriptorSet,
-				VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER,
-				0,
-				&uniformBuffers.occluder.descriptor)
+		std::vector<VkWriteDescriptorSet> writeDescriptorSets = {
+			vks::initializers::writeDescriptorSet(descriptorSet, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 0, &buffers.scene.descriptor),
 		};
-
-		vkUpdateDescriptorSets(device, writeDescriptorSets.size(), writeDescriptorSets.data(), 0, NULL);
-
-		// Teapot
-		VK_CHECK_RESULT(vkAllocateDescriptorSets(device, &allocInfo, &descriptorSets.teapot));
-		writeDescriptorSets[0].dstSet = descriptorSets.teapot;
-		writeDescriptorSets[0].pBufferInfo = &uniformBuffers.teapot.descriptor;
-		vkUpdateDescriptorSets(device, writeDescriptorSets.size(), writeDescriptorSets.data(), 0, NULL);
-
-		// Sphere
-		VK_CHECK_RESULT(vkAllocateDescriptorSets(device, &allocInfo, &descriptorSets.sphere));
-		writeDescriptorSets[0].dstSet = descriptorSets.sphere;
-		writeDescriptorSets[0].pBufferInfo = &uniformBuffers.sphere.descriptor;
-		vkUpdateDescriptorSets(device, writeDescriptorSets.size(), writeDescriptorSets.data(), 0, NULL);
+		vkUpdateDescriptorSets(device, static_cast<uint32_t>(writeDescriptorSets.size()), writeDescriptorSets.data(), 0, nullptr);
 	}
 
 	void preparePipelines()
 	{
+		VkPipelineLayoutCreateInfo pipelineLayoutCreateInfo = vks::initializers::pipelineLayoutCreateInfo(&descriptorSetLayout, 1);
+		VK_CHECK_RESULT(vkCreatePipelineLayout(device, &pipelineLayoutCreateInfo, nullptr, &pipelineLayout));
+
 		VkPipelineInputAssemblyStateCreateInfo inputAssemblyState = vks::initializers::pipelineInputAssemblyStateCreateInfo(VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST, 0, VK_FALSE);
 		VkPipelineRasterizationStateCreateInfo rasterizationState = vks::initializers::pipelineRasterizationStateCreateInfo(VK_POLYGON_MODE_FILL, VK_CULL_MODE_NONE, VK_FRONT_FACE_COUNTER_CLOCKWISE, 0);
 		VkPipelineColorBlendAttachmentState blendAttachmentState = vks::initializers::pipelineColorBlendAttachmentState(0xf, VK_FALSE);
@@ -351,23 +345,35 @@ public:
 		pipelineCI.pDynamicState = &dynamicState;
 		pipelineCI.stageCount = shaderStages.size();
 		pipelineCI.pStages = shaderStages.data();
-		pipelineCI.pVertexInputState = vkglTF::Vertex::getPipelineVertexInputState({ vkglTF::VertexComponent::Position, vkglTF::VertexComponent::Normal, vkglTF::VertexComponent::Color });;
+		// Per vertex attributes from the glTF models and the per object data as per instance attributes
+		std::vector<VkVertexInputBindingDescription> bindingDescriptions = {
+			vkglTF::Vertex::inputBindingDescription(VERTEX_BUFFER_BIND_ID),
+			vks::initializers::vertexInputBindingDescription(INSTANCE_BUFFER_BIND_ID, sizeof(ObjectData), VK_VERTEX_INPUT_RATE_INSTANCE)
+		};
+		std::vector<VkVertexInputAttributeDescription> attributeDescriptions = vkglTF::Vertex::inputAttributeDescriptions(VERTEX_BUFFER_BIND_ID, { vkglTF::VertexComponent::Position, vkglTF::VertexComponent::Normal, vkglTF::VertexComponent::Color });
+		for (uint32_t i = 0; i < 5; i++) {
+			// Location 3 - 6: Model matrix columns, location 7: Color
+			attributeDescriptions.push_back(vks::initializers::vertexInputAttributeDescription(INSTANCE_BUFFER_BIND_ID, 3 + i, VK_FORMAT_R32G32B32A32_SFLOAT, i * sizeof(glm::vec4)));
+		}
+		VkPipelineVertexInputStateCreateInfo vertexInputState = vks::initializers::pipelineVertexInputStateCreateInfo(bindingDescriptions, attributeDescriptions);
+		pipelineCI.pVertexInputState = &vertexInputState;
 
 		// Solid rendering pipeline
 		shaderStages[0] = loadShader(getShadersPath() + "occlusionquery/mesh.vert.spv", VK_SHADER_STAGE_VERTEX_BIT);
 		shaderStages[1] = loadShader(getShadersPath() + "occlusionquery/mesh.frag.spv", VK_SHADER_STAGE_FRAGMENT_BIT);
 		VK_CHECK_RESULT(vkCreateGraphicsPipelines(device, pipelineCache, 1, &pipelineCI, nullptr, &pipelines.solid));
 
-		// Basic pipeline for coloring occluded objects
+		// Depth only pipeline for the occluder
 		shaderStages[0] = loadShader(getShadersPath() + "occlusionquery/simple.vert.spv", VK_SHADER_STAGE_VERTEX_BIT);
 		shaderStages[1] = loadShader(getShadersPath() + "occlusionquery/simple.frag.spv", VK_SHADER_STAGE_FRAGMENT_BIT);
-		rasterizationState.cullMode = VK_CULL_MODE_NONE;
-		VK_CHECK_RESULT(vkCreateGraphicsPipelines(device, pipelineCache, 1, &pipelineCI, nullptr, &pipelines.simple));
+		blendAttachmentState.colorWriteMask = 0;
+		VK_CHECK_RESULT(vkCreateGraphicsPipelines(device, pipelineCache, 1, &pipelineCI, nullptr, &pipelines.occluderDepth));
 
 		// Visual pipeline for the occluder
 		shaderStages[0] = loadShader(getShadersPath() + "occlusionquery/occluder.vert.spv", VK_SHADER_STAGE_VERTEX_BIT);
 		shaderStages[1] = loadShader(getShadersPath() + "occlusionquery/occluder.frag.spv", VK_SHADER_STAGE_FRAGMENT_BIT);
 		// Enable blending
+		blendAttachmentState.colorWriteMask = 0xf;
 		blendAttachmentState.blendEnable = VK_TRUE;
 		blendAttachmentState.colorBlendOp = VK_BLEND_OP_ADD;
 		blendAttachmentState.srcColorBlendFactor = VK_BLEND_FACTOR_SRC_COLOR;
@@ -375,75 +381,52 @@ public:
 		VK_CHECK_RESULT(vkCreateGraphicsPipelines(device, pipelineCache, 1, &pipelineCI, nullptr, &pipelines.occluder));
 	}
 
-	// Prepare and initialize uniform buffer containing shader uniforms
+	// Prepare and initialize the buffers containing shader uniforms and per object data
 	void prepareUniformBuffers()
 	{
 		// Vertex shader uniform buffer block
 		VK_CHECK_RESULT(vulkanDevice->createBuffer(
 			VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
 			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
-			&uniformBuffers.occluder,
-			sizeof(uboVS)));
+			&buffers.scene,
+			sizeof(uboScene)));
+		VK_CHECK_RESULT(buffers.scene.map());
 
-		// Teapot
+		// Objects don't move, so their data is uploaded once
+		vks::Buffer stagingBuffer;
 		VK_CHECK_RESULT(vulkanDevice->createBuffer(
-			VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
+			VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
 			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
-			&uniformBuffers.teapot,
-			sizeof(uboVS)));
-
-		// Sphere
+			&stagingBuffer,
+			objects.size() * sizeof(ObjectData),
+			objects.data()));
 		VK_CHECK_RESULT(vulkanDevice->createBuffer(
-			VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
-			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
-			&uniformBuffers.sphere,
-			sizeof(uboVS)));
-
-		// Map persistent
-		VK_CHECK_RESULT(uniformBuffers.occluder.map());
-		VK_CHECK_RESULT(uniformBuffers.teapot.map());
-		VK_CHECK_RESULT(uniformBuffers.sphere.map());
+			VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+			VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+			&buffers.objects,
+			objects.size() * sizeof(ObjectData)));
+		vulkanDevice->copyBuffer(&stagingBuffer, &buffers.objects, queue);
+		stagingBuffer.destroy();
 
 		updateUniformBuffers();
 	}
 
 	void updateUniformBuffers()
 	{
-		uboVS.projection = camera.matrices.perspective;
-		uboVS.view = camera.matrices.view;
-
-		uint8_t *pData;
-		// Occluder
-		uboVS.visible = 1.0f;
-		uboVS.model = glm::scale(glm::mat4(1.0f), glm::vec3(6.0f));
-		uboVS.color = glm::vec4(0.0f, 0.0f, 1.0f, 0.5f);
-		memcpy(uniformBuffers.occluder.mapped, &uboVS, sizeof(uboVS));
-
-		// Teapot
-		// Toggle color depending on visibility
-		uboVS.visible = (passedSamples[0] > 0) ? 1.0f : 0.0f;
-		uboVS.model = glm::translate(glm::mat4(1.0f), glm::vec3(0.0f, 0.0f, -3.0f));
-		uboVS.color = glm::vec4(1.0f, 0.0f, 0.0f, 1.0f);
-		memcpy(uniformBuffers.teapot.mapped, &uboVS, sizeof(uboVS));
-
-		// Sphere
-		// Toggle color depending on visibility
-		uboVS.visible = (passedSamples[1] > 0) ? 1.0f : 0.0f;
-		uboVS.model = glm::translate(glm::mat4(1.0f), glm::vec3(0.0f, 0.0f, 3.0f));
-		uboVS.color = glm::vec4(0.0f, 1.0f, 0.0f, 1.0f);
-		memcpy(uniformBuffers.sphere.mapped, &uboVS, sizeof(uboVS));
+		uboScene.projection = camera.matrices.perspective;
+		uboScene.view = camera.matrices.view;
+		memcpy(buffers.scene.mapped, &uboScene, sizeof(uboScene));
 	}
 
 	void prepare()
 	{
 		VulkanExampleBase::prepare();
 		loadAssets();
-		setupQueryPool();
+		occlusionCuller.prepare(vulkanDevice, queue, renderPass, pipelineCache, getShadersPath() + "base/", static_cast<uint32_t>(drawCmdBuffers.size()));
+		prepareObjects();
 		prepareUniformBuffers();
-		setupDescriptorSetLayout();
+		setupDescriptors();
 		preparePipelines();
-		setupDescriptorPool();
-		setupDescriptorSets();
 		buildCommandBuffers();
 		prepared = true;
 	}
@@ -457,9 +440,22 @@ public:
 
 	virtual void OnUpdateUIOverlay(vks::UIOverlay *overlay)
 	{
-		if (overlay->header("Occlusion query results")) {
-			overlay->text("Teapot: %d samples passed", passedSamples[0]);
-			overlay->text("Sphere: %d samples passed", passedSamples[1]);
+		if (overlay->header("Settings")) {
+			const std::vector<std::string> modes = { "Hi-Z pyramid (GPU)", "Occlusion queries (async)", "Disabled" };
+			if (overlay->comboBox("Culling", &cullingMode, modes)) {
+				if (!occlusionCuller.supported(static_cast<vks::OcclusionCuller::Mode>(cullingMode))) {
+					cullingMode = vks::OcclusionCuller::ModeQueries;
+				}
+				buildCommandBuffers();
+			}
+		}
+		if (overlay->header("Statistics")) {
+			const vks::OcclusionCuller::Statistics &statistics = occlusionCuller.statistics;
+			overlay->text("Draws: %d", statistics.drawCount);
+			overlay->text("Visible: %d", statistics.visibleCount);
+			overlay->text("Frustum culled: %d", statistics.frustumCulled);
+			overlay->text("Occlusion culled: %d", statistics.occlusionCulled);
+			overlay->text("Culled draws: %.1f %%", occlusionCuller.culledPercentage());
 		}
 	}
 
@@ -13,7 +13,8 @@
 #include "VulkanglTFModel.h"
 
 #define ENABLE_VALIDATION false
-#define NODE_COUNT 20
+// Upper limit of fragments per pixel that are kept sorted in the resolve pass, must match MAX_K_BUFFER_SIZE in color.frag
+#define MAX_K_BUFFER_SIZE 16
 
 class VulkanExample : public VulkanExampleBase
 {
@@ -27,14 +28,17 @@ public:
 		vks::Buffer renderPass;
 	} uniformBuffers;
 
+	// Color is stored as packed RGBA8, keeps the node at 12 bytes
 	struct Node {
-		glm::vec4 color;
+		uint32_t color;
 		float depth;
 		uint32_t next;
 	};
 
+	// Count is incremented for every transparent fragment, so it also contains the fragments that did not fit into the node buffer
 	struct {
 		uint32_t count;
+		uint32_t overflowCount;
 		uint32_t maxNodeCount;
 	} geometrySBO;
 
@@ -44,8 +48,34 @@ public:
 		vks::Buffer geometry;
 		vks::Texture headIndex;
 		vks::Buffer linkedList;
+		// Weighted blended accumulation targets for fragments that overflow the node buffer
+		vks::Texture accumulation;
+		vks::Texture revealage;
+		VkSampler sampler;
 	} geometryPass;
 
+	// The node buffer lives within a fixed memory budget that's independent of the resolution
+	// With adaptation enabled, its capacity follows the fragment count read back from the GPU
+	struct NodeBudget {
+		int32_t budgetMB = 64;
+		bool adaptive = true;
+		uint32_t capacity = 0;
+		uint32_t minCapacity = 1 << 18;
+		// Number of consecutive frames the demand was well below the capacity
+		uint32_t lowDemandFrames = 0;
+		uint32_t resizeCount = 0;
+	} nodeBudget;
+
+	// Counters are copied to one host visible buffer per command buffer and read when the command buffer is used again
+	struct CounterReadback {
+		std::vector<vks::Buffer> buffers;
+		std::vector<bool> valid;
+		uint32_t fragmentCount = 0;
+		uint32_t overflowCount = 0;
+	} counterReadback;
+
+	int32_t kBufferSize = 8;
+
 	struct {
 		glm::mat4 projection;
 		glm::mat4 view;
@@ -97,6 +127,10 @@ public:
 		vkDestroyDescriptorSetLayout(device, descriptorSetLayouts.color, nullptr);
 
 		destroyGeometryPass();
+		destroyNodeBuffer();
+		for (auto& buffer : counterReadback.buffers) {
+			buffer.destroy();
+		}
 
 		uniformBuffers.renderPass.destroy();
 	}
@@ -116,6 +150,8 @@ public:
 		loadAssets();
 		prepareUniformBuffers();
 		prepareGeometryPass();
+		prepareNodeBuffer(nodeBudget.adaptive ? std::min(nodeBudget.minCapacity, budgetNodeCount()) : budgetNodeCount());
+		prepareCounterReadback();
 		setupDescriptorSetLayout();
 		preparePipelines();
 		setupDescriptorPool();
@@ -129,15 +165,21 @@ public:
 	{
 		if (!prepared)
 			return;
+		readCounters();
+		adaptNodeCapacity();
 		draw();
 	}
 
 	void windowResized() override
 	{
+		// Only the per-pixel resources depend on the resolution, the node buffer keeps its size
 		destroyGeometryPass();
 		prepareGeometryPass();
 		vkResetDescriptorPool(device, descriptorPool, 0);
 		setupDescriptorSets();
+		for (size_t i = 0; i < counterReadback.valid.size(); i++) {
+			counterReadback.valid[i] = false;
+		}
 
 		resized = false;
 		buildCommandBuffers();
@@ -168,59 +210,129 @@ private:
 		VK_CHECK_RESULT(uniformBuffers.renderPass.map());
 	}
 
+	// Create a color attachment for the weighted blended accumulation of overflowing fragments.
+	void createAccumulationTarget(VkFormat format, vks::Texture& target)
+	{
+		target.device = vulkanDevice;
+
+		VkImageCreateInfo imageInfo = vks::initializers::imageCreateInfo();
+		imageInfo.imageType = VK_IMAGE_TYPE_2D;
+		imageInfo.format = format;
+		imageInfo.extent = { width, height, 1 };
+		imageInfo.mipLevels = 1;
+		imageInfo.arrayLayers = 1;
+		imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+		imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+		imageInfo.usage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
+		VK_CHECK_RESULT(vkCreateImage(device, &imageInfo, nullptr, &target.image));
+
+		VkMemoryRequirements memReqs;
+		vkGetImageMemoryRequirements(device, target.image, &memReqs);
+		VkMemoryAllocateInfo memAlloc = vks::initializers::memoryAllocateInfo();
+		memAlloc.allocationSize = memReqs.size;
+		memAlloc.memoryTypeIndex = vulkanDevice->getMemoryType(memReqs.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+		VK_CHECK_RESULT(vkAllocateMemory(device, &memAlloc, nullptr, &target.deviceMemory));
+		VK_CHECK_RESULT(vkBindImageMemory(device, target.image, target.deviceMemory, 0));
+
+		VkImageViewCreateInfo imageViewInfo = vks::initializers::imageViewCreateInfo();
+		imageViewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
+		imageViewInfo.format = format;
+		imageViewInfo.image = target.image;
+		imageViewInfo.subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1 };
+		VK_CHECK_RESULT(vkCreateImageView(device, &imageViewInfo, nullptr, &target.view));
+
+		target.width = width;
+		target.height = height;
+		target.mipLevels = 1;
+		target.layerCount = 1;
+		target.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+		// The sampler is owned by the geometry pass
+		target.sampler = VK_NULL_HANDLE;
+		target.descriptor.imageView = target.view;
+		target.descriptor.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+		target.descriptor.sampler = geometryPass.sampler;
+	}
+
 	void prepareGeometryPass()
 	{
+		// Sampler for reading the accumulation targets in the color pass
+		VkSamplerCreateInfo samplerInfo = vks::initializers::samplerCreateInfo();
+		samplerInfo.magFilter = VK_FILTER_NEAREST;
+		samplerInfo.minFilter = VK_FILTER_NEAREST;
+		samplerInfo.mipmapMode = VK_SAMPLER_MIPMAP_MODE_NEAREST;
+		samplerInfo.addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+		samplerInfo.addressModeV = samplerInfo.addressModeU;
+		samplerInfo.addressModeW = samplerInfo.addressModeU;
+		samplerInfo.maxAnisotropy = 1.0f;
+		samplerInfo.borderColor = VK_BORDER_COLOR_FLOAT_OPAQUE_WHITE;
+		VK_CHECK_RESULT(vkCreateSampler(device, &samplerInfo, nullptr, &geometryPass.sampler));
+
+		createAccumulationTarget(VK_FORMAT_R16G16B16A16_SFLOAT, geometryPass.accumulation);
+		createAccumulationTarget(VK_FORMAT_R16_SFLOAT, geometryPass.revealage);
+
+		// The geometry pass only writes to the weighted blended accumulation targets, all other fragments go to the linked lists.
+		std::array<VkAttachmentDescription, 2> attachmentDescs = {};
+		for (uint32_t i = 0; i < 2; ++i) {
+			attachmentDescs[i].samples = VK_SAMPLE_COUNT_1_BIT;
+			attachmentDescs[i].loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+			attachmentDescs[i].storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+			attachmentDescs[i].stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+			attachmentDescs[i].stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+			attachmentDescs[i].initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+			attachmentDescs[i].finalLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+		}
+		attachmentDescs[0].format = VK_FORMAT_R16G16B16A16_SFLOAT;
+		attachmentDescs[1].format = VK_FORMAT_R16_SFLOAT;
+
+		std::array<VkAttachmentReference, 2> colorReferences = { {
+			{ 0, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL },
+			{ 1, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL }
+		} };
+
 		VkSubpassDescription subpassDescription = {};
 		subpassDescription.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
+		subpassDescription.colorAttachmentCount = static_cast<uint32_t>(colorReferences.size());
+		subpassDescription.pColorAttachments = colorReferences.data();
+
+		// Use subpass dependencies for the accumulation target layout transitions
+		std::array<VkSubpassDependency, 2> dependencies;
+		dependencies[0].srcSubpass = VK_SUBPASS_EXTERNAL;
+		dependencies[0].dstSubpass = 0;
+		dependencies[0].srcStageMask = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
+		dependencies[0].dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+		dependencies[0].srcAccessMask = VK_ACCESS_SHADER_READ_BIT;
+		dependencies[0].dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+		dependencies[0].dependencyFlags = VK_DEPENDENCY_BY_REGION_BIT;
+
+		dependencies[1].srcSubpass = 0;
+		dependencies[1].dstSubpass = VK_SUBPASS_EXTERNAL;
+		dependencies[1].srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+		dependencies[1].dstStageMask = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
+		dependencies[1].srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+		dependencies[1].dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+		dependencies[1].dependencyFlags = VK_DEPENDENCY_BY_REGION_BIT;
 
-		// Geometry render pass doesn't need any output attachment.
 		VkRenderPassCreateInfo renderPassInfo = vks::initializers::renderPassCreateInfo();
-		renderPassInfo.attachmentCount = 0;
+		renderPassInfo.attachmentCount = static_cast<uint32_t>(attachmentDescs.size());
+		renderPassInfo.pAttachments = attachmentDescs.data();
 		renderPassInfo.subpassCount = 1;
 		renderPassInfo.pSubpasses = &subpassDescription;
+		renderPassInfo.dependencyCount = static_cast<uint32_t>(dependencies.size());
+		renderPassInfo.pDependencies = dependencies.data();
 
 		VK_CHECK_RESULT(vkCreateRenderPass(device, &renderPassInfo, nullptr, &geometryPass.renderPass));
 
-		// Geometry frame buffer doesn't need any output attachment.
+		std::array<VkImageView, 2> attachments = { geometryPass.accumulation.view, geometryPass.revealage.view };
 		VkFramebufferCreateInfo fbufCreateInfo = vks::initializers::framebufferCreateInfo();
 		fbufCreateInfo.renderPass = geometryPass.renderPass;
-		fbufCreateInfo.attachmentCount = 0;
+		fbufCreateInfo.attachmentCount = static_cast<uint32_t>(attachments.size());
+		fbufCreateInfo.pAttachments = attachments.data();
 		fbufCreateInfo.width = width;
 		fbufCreateInfo.height = height;
 		fbufCreateInfo.layers = 1;
 
 		VK_CHECK_RESULT(vkCreateFramebuffer(device, &fbufCreateInfo, nullptr, &geometryPass.framebuffer));
 
-		// Create a buffer for GeometrySBO
-		vks::Buffer stagingBuffer;
-	
-		VK_CHECK_RESULT(vulkanDevice->createBuffer(
-			VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
-			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
-			&stagingBuffer,
-			sizeof(geometrySBO)));
-		VK_CHECK_RESULT(stagingBuffer.map());
-
-		VK_CHECK_RESULT(vulkanDevice->createBuffer(
-			VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
-			VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
-			&geometryPass.geometry,
-			sizeof(geometrySBO)));
-
-		// Set up GeometrySBO data.
-		geometrySBO.count = 0;
-		geometrySBO.maxNodeCount = NODE_COUNT * width * height;
-		memcpy(stagingBuffer.mapped, &geometrySBO, sizeof(geometrySBO));
-
-		// Copy data to device
-		VkCommandBuffer copyCmd = vulkanDevice->createCommandBuffer(VK_COMMAND_BUFFER_LEVEL_PRIMARY, true);
-		VkBufferCopy copyRegion = {};
-		copyRegion.size = sizeof(geometrySBO);
-		vkCmdCopyBuffer(copyCmd, stagingBuffer.buffer, geometryPass.geometry.buffer, 1, &copyRegion);
-		vulkanDevice->flushCommandBuffer(copyCmd, queue, true);
-
-		stagingBuffer.destroy();
-		
 		// Create a texture for HeadIndex.
 		// This image will track the head index of each fragment.
 		geometryPass.headIndex.device = vulkanDevice;
@@ -277,13 +389,6 @@ private:
 		geometryPass.headIndex.descriptor.imageLayout = VK_IMAGE_LAYOUT_GENERAL;
 		geometryPass.headIndex.sampler = VK_NULL_HANDLE;
 
-		// Create a buffer for LinkedListSBO
-		VK_CHECK_RESULT(vulkanDevice->createBuffer(
-			VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
-			VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
-			&geometryPass.linkedList,
-			sizeof(Node) * geometrySBO.maxNodeCount));
-
 		// Change HeadIndex image's layout from UNDEFINED to GENERAL
 		VkCommandBufferAllocateInfo cmdBufAllocInfo = vks::initializers::commandBufferAllocateInfo(cmdPool, VK_COMMAND_BUFFER_LEVEL_PRIMARY, 1);
 
@@ -314,6 +419,144 @@ private:
 		VK_CHECK_RESULT(vkQueueWaitIdle(queue));
 	}
 
+	// Number of nodes that fit into the configured memory budget
+	uint32_t budgetNodeCount()
+	{
+		return static_cast<uint32_t>((static_cast<VkDeviceSize>(nodeBudget.budgetMB) * 1024 * 1024) / sizeof(Node));
+	}
+
+	// Create the node buffer and the GeometrySBO holding the node counters for the given number of nodes.
+	void prepareNodeBuffer(uint32_t nodeCount)
+	{
+		nodeBudget.capacity = nodeCount;
+
+		// Create a buffer for GeometrySBO
+		vks::Buffer stagingBuffer;
+
+		VK_CHECK_RESULT(vulkanDevice->createBuffer(
+			VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+			&stagingBuffer,
+			sizeof(geometrySBO)));
+		VK_CHECK_RESULT(stagingBuffer.map());
+
+		VK_CHECK_RESULT(vulkanDevice->createBuffer(
+			VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+			VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+			&geometryPass.geometry,
+			sizeof(geometrySBO)));
+
+		// Set up GeometrySBO data.
+		geometrySBO.count = 0;
+		geometrySBO.overflowCount = 0;
+		geometrySBO.maxNodeCount = nodeBudget.capacity;
+		memcpy(stagingBuffer.mapped, &geometrySBO, sizeof(geometrySBO));
+
+		// Copy data to device
+		VkCommandBuffer copyCmd = vulkanDevice->createCommandBuffer(VK_COMMAND_BUFFER_LEVEL_PRIMARY, true);
+		VkBufferCopy copyRegion = {};
+		copyRegion.size = sizeof(geometrySBO);
+		vkCmdCopyBuffer(copyCmd, stagingBuffer.buffer, geometryPass.geometry.buffer, 1, &copyRegion);
+		vulkanDevice->flushCommandBuffer(copyCmd, queue, true);
+
+		stagingBuffer.destroy();
+
+		// Create a buffer for LinkedListSBO
+		VK_CHECK_RESULT(vulkanDevice->createBuffer(
+			VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+			VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+			&geometryPass.linkedList,
+			sizeof(Node) * nodeBudget.capacity));
+	}
+
+	void destroyNodeBuffer()
+	{
+		geometryPass.geometry.destroy();
+		geometryPass.linkedList.destroy();
+	}
+
+	// Reallocate the node buffer, only done when the capacity changes significantly to avoid frequent stalls.
+	void resizeNodeBuffer(uint32_t nodeCount)
+	{
+		vkDeviceWaitIdle(device);
+		destroyNodeBuffer();
+		prepareNodeBuffer(nodeCount);
+		vkResetDescriptorPool(device, descriptorPool, 0);
+		setupDescriptorSets();
+		for (size_t i = 0; i < counterReadback.valid.size(); i++) {
+			counterReadback.valid[i] = false;
+		}
+		nodeBudget.lowDemandFrames = 0;
+		nodeBudget.resizeCount++;
+		buildCommandBuffers();
+	}
+
+	void prepareCounterReadback()
+	{
+		counterReadback.buffers.resize(drawCmdBuffers.size());
+		counterReadback.valid.resize(drawCmdBuffers.size(), false);
+		for (auto& buffer : counterReadback.buffers) {
+			VK_CHECK_RESULT(vulkanDevice->createBuffer(
+				VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+				VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+				&buffer,
+				sizeof(geometrySBO)));
+			VK_CHECK_RESULT(buffer.map());
+		}
+	}
+
+	// Read the counters copied by the last submitted frame.
+	// The base class waits for the queue after presenting, so the copy has finished and reading it never stalls.
+	void readCounters()
+	{
+		const uint32_t index = currentBuffer;
+		if (!counterReadback.valid[index]) {
+			return;
+		}
+		uint32_t* counters = static_cast<uint32_t*>(counterReadback.buffers[index].mapped);
+		counterReadback.fragmentCount = counters[0];
+		counterReadback.overflowCount = counters[1];
+	}
+
+	// Grow the node buffer as soon as fragments overflow, shrink it when the demand stays well below the capacity.
+	// The capacity never exceeds the memory budget, fragments beyond it fall back to weighted blended transparency.
+	void adaptNodeCapacity()
+	{
+		const uint32_t budget = budgetNodeCount();
+		if (!nodeBudget.adaptive) {
+			if (nodeBudget.capacity != budget) {
+				resizeNodeBuffer(budget);
+			}
+			return;
+		}
+		// Capacities are rounded to multiples of the minimum capacity with 25% headroom
+		const uint64_t demand = counterReadback.fragmentCount;
+		auto capacityFor = [this, budget](uint64_t nodes) {
+			const uint64_t granularity = nodeBudget.minCapacity;
+			const uint64_t capacity = ((nodes + nodes / 4 + granularity - 1) / granularity) * granularity;
+			return static_cast<uint32_t>(std::min<uint64_t>(std::max<uint64_t>(capacity, granularity), budget));
+		};
+		if (nodeBudget.capacity > budget) {
+			resizeNodeBuffer(budget);
+		}
+		else if ((demand > nodeBudget.capacity) && (nodeBudget.capacity < budget)) {
+			resizeNodeBuffer(capacityFor(demand));
+		}
+		else if ((demand * 2 < nodeBudget.capacity) && (nodeBudget.capacity > nodeBudget.minCapacity)) {
+			// Shrink after two seconds (at 60 fps) of low demand to avoid oscillating
+			if (++nodeBudget.lowDemandFrames > 120) {
+				const uint32_t capacity = capacityFor(demand);
+				if (capacity < nodeBudget.capacity) {
+					resizeNodeBuffer(capacity);
+				}
+				nodeBudget.lowDemandFrames = 0;
+			}
+		}
+		else {
+			nodeBudget.lowDemandFrames = 0;
+		}
+	}
+
 	void setupDescriptorSetLayout()
 	{
 		// Create a geometry descriptor set layout.
@@ -363,6 +606,16 @@ private:
 				VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
 				VK_SHADER_STAGE_FRAGMENT_BIT,
 				1),
+			// Weighted blended accumulation
+			vks::initializers::descriptorSetLayoutBinding(
+				VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+				VK_SHADER_STAGE_FRAGMENT_BIT,
+				2),
+			// Weighted blended revealage
+			vks::initializers::descriptorSetLayoutBinding(
+				VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+				VK_SHADER_STAGE_FRAGMENT_BIT,
+				3),
 		};
 
 		descriptorLayoutCI = vks::initializers::descriptorSetLayoutCreateInfo(setLayoutBindings);
@@ -370,6 +623,10 @@ private:
 
 		// Create a color pipeline layout.
 		pipelineLayoutCI = vks::initializers::pipelineLayoutCreateInfo(&descriptorSetLayouts.color, 1);
+		// Size of the k-buffer passed using push constants
+		pushConstantRange = vks::initializers::pushConstantRange(VK_SHADER_STAGE_FRAGMENT_BIT, sizeof(uint32_t), 0);
+		pipelineLayoutCI.pushConstantRangeCount = 1;
+		pipelineLayoutCI.pPushConstantRanges = &pushConstantRange;
 		VK_CHECK_RESULT(vkCreatePipelineLayout(device, &pipelineLayoutCI, nullptr, &pipelineLayouts.color));
 	}
 
@@ -377,7 +634,23 @@ private:
 	{
 		VkPipelineInputAssemblyStateCreateInfo inputAssemblyState = vks::initializers::pipelineInputAssemblyStateCreateInfo(VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST, 0, VK_FALSE);
 		VkPipelineRasterizationStateCreateInfo rasterizationState = vks::initializers::pipelineRasterizationStateCreateInfo(VK_POLYGON_MODE_FILL, VK_CULL_MODE_BACK_BIT, VK_FRONT_FACE_COUNTER_CLOCKWISE, 0);
-		VkPipelineColorBlendStateCreateInfo colorBlendState = vks::initializers::pipelineColorBlendStateCreateInfo(0, nullptr);
+		// Fragments that don't fit into the node buffer are accumulated with additive blending (accumulation) and multiplicative blending (revealage)
+		std::array<VkPipelineColorBlendAttachmentState, 2> accumulationBlendStates;
+		accumulationBlendStates[0] = vks::initializers::pipelineColorBlendAttachmentState(0xf, VK_TRUE);
+		accumulationBlendStates[0].srcColorBlendFactor = VK_BLEND_FACTOR_ONE;
+		accumulationBlendStates[0].dstColorBlendFactor = VK_BLEND_FACTOR_ONE;
+		accumulationBlendStates[0].colorBlendOp = VK_BLEND_OP_ADD;
+		accumulationBlendStates[0].srcAlphaBlendFactor = VK_BLEND_FACTOR_ONE;
+		accumulationBlendStates[0].dstAlphaBlendFactor = VK_BLEND_FACTOR_ONE;
+		accumulationBlendStates[0].alphaBlendOp = VK_BLEND_OP_ADD;
+		accumulationBlendStates[1] = vks::initializers::pipelineColorBlendAttachmentState(0x1, VK_TRUE);
+		accumulationBlendStates[1].srcColorBlendFactor = VK_BLEND_FACTOR_ZERO;
+		accumulationBlendStates[1].dstColorBlendFactor = VK_BLEND_FACTOR_ONE_MINUS_SRC_COLOR;
+		accumulationBlendStates[1].colorBlendOp = VK_BLEND_OP_ADD;
+		accumulationBlendStates[1].srcAlphaBlendFactor = VK_BLEND_FACTOR_ZERO;
+		accumulationBlendStates[1].dstAlphaBlendFactor = VK_BLEND_FACTOR_ONE;
+		accumulationBlendStates[1].alphaBlendOp = VK_BLEND_OP_ADD;
+		VkPipelineColorBlendStateCreateInfo colorBlendState = vks::initializers::pipelineColorBlendStateCreateInfo(static_cast<uint32_t>(accumulationBlendStates.size()), accumulationBlendStates.data());
 		VkPipelineDepthStencilStateCreateInfo depthStencilState = vks::initializers::pipelineDepthStencilStateCreateInfo(VK_FALSE, VK_FALSE, VK_COMPARE_OP_LESS_OR_EQUAL);
 		VkPipelineViewportStateCreateInfo viewportState = vks::initializers::pipelineViewportStateCreateInfo(1, 1, 0);
 		VkPipelineMultisampleStateCreateInfo multisampleState = vks::initializers::pipelineMultisampleStateCreateInfo(VK_SAMPLE_COUNT_1_BIT, 0);
@@ -437,6 +710,7 @@ private:
 			vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, 1),
 			vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 3),
 			vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, 2),
+			vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 2),
 		};
 
 		VkDescriptorPoolCreateInfo descriptorPoolInfo =
@@ -506,7 +780,19 @@ private:
 				descriptorSets.color,
 				VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
 				1,
-				&geometryPass.linkedList.descriptor)
+				&geometryPass.linkedList.descriptor),
+			// Binding 2: Weighted blended accumulation
+			vks::initializers::writeDescriptorSet(
+				descriptorSets.color,
+				VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+				2,
+				&geometryPass.accumulation.descriptor),
+			// Binding 3: Weighted blended revealage
+			vks::initializers::writeDescriptorSet(
+				descriptorSets.color,
+				VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+				3,
+				&geometryPass.revealage.descriptor)
 		};
 
 		vkUpdateDescriptorSets(device, static_cast<uint32_t>(writeDescriptorSets.size()), writeDescriptorSets.data(), 0, NULL);
@@ -553,8 +839,8 @@ private:
 
 			vkCmdClearColorImage(drawCmdBuffers[i], geometryPass.headIndex.image, VK_IMAGE_LAYOUT_GENERAL, &clearColor, 1, &subresRange);
 
-			// Clear previous geometry pass data
-			vkCmdFillBuffer(drawCmdBuffers[i], geometryPass.geometry.buffer, 0, sizeof(uint32_t), 0);
+			// Clear previous geometry pass data (node and overflow counters)
+			vkCmdFillBuffer(drawCmdBuffers[i], geometryPass.geometry.buffer, 0, 2 * sizeof(uint32_t), 0);
 
 			// We need a barrier to make sure all writes are finished before starting to write again
 			VkMemoryBarrier memoryBarrier = vks::initializers::memoryBarrier();
@@ -563,10 +849,13 @@ private:
 			vkCmdPipelineBarrier(drawCmdBuffers[i], VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0, 1, &memoryBarrier, 0, nullptr, 0, nullptr);
 
 			// Begin the geometry render pass
+			VkClearValue accumulationClearValues[2];
+			accumulationClearValues[0].color = { { 0.0f, 0.0f, 0.0f, 0.0f } };
+			accumulationClearValues[1].color = { { 1.0f, 0.0f, 0.0f, 0.0f } };
 			renderPassBeginInfo.renderPass = geometryPass.renderPass;
 			renderPassBeginInfo.framebuffer = geometryPass.framebuffer;
-			renderPassBeginInfo.clearValueCount = 0;
-			renderPassBeginInfo.pClearValues = nullptr;
+			renderPassBeginInfo.clearValueCount = 2;
+			renderPassBeginInfo.pClearValues = accumulationClearValues;
 
 			vkCmdBeginRenderPass(drawCmdBuffers[i], &renderPassBeginInfo, VK_SUBPASS_CONTENTS_INLINE);
 			vkCmdBindPipeline(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pipelines.geometry);
@@ -624,10 +913,24 @@ private:
 			vkCmdBeginRenderPass(drawCmdBuffers[i], &renderPassBeginInfo, VK_SUBPASS_CONTENTS_INLINE);
 			vkCmdBindPipeline(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pipelines.color);
 			vkCmdBindDescriptorSets(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayouts.color, 0, 1, &descriptorSets.color, 0, nullptr);
+			const uint32_t kBufferSizePushConst = static_cast<uint32_t>(kBufferSize);
+			vkCmdPushConstants(drawCmdBuffers[i], pipelineLayouts.color, VK_SHADER_STAGE_FRAGMENT_BIT, 0, sizeof(uint32_t), &kBufferSizePushConst);
 			vkCmdDraw(drawCmdBuffers[i], 3, 1, 0, 0);
 			drawUI(drawCmdBuffers[i]);
 			vkCmdEndRenderPass(drawCmdBuffers[i]);
 
+			// Copy the node counters for the overflow statistics and the capacity adaptation, read on the host without waiting for this frame
+			memoryBarrier = vks::initializers::memoryBarrier();
+			memoryBarrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+			memoryBarrier.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+			vkCmdPipelineBarrier(drawCmdBuffers[i], VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 1, &memoryBarrier, 0, nullptr, 0, nullptr);
+			VkBufferCopy copyRegion = {};
+			copyRegion.size = sizeof(geometrySBO);
+			vkCmdCopyBuffer(drawCmdBuffers[i], geometryPass.geometry.buffer, counterReadback.buffers[i].buffer, 1, &copyRegion);
+			memoryBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+			memoryBarrier.dstAccessMask = VK_ACCESS_HOST_READ_BIT;
+			vkCmdPipelineBarrier(drawCmdBuffers[i], VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_HOST_BIT, 0, 1, &memoryBarrier, 0, nullptr, 0, nullptr);
+
 			VK_CHECK_RESULT(vkEndCommandBuffer(drawCmdBuffers[i]));
 		}
 	}
@@ -645,6 +948,7 @@ private:
 		submitInfo.commandBufferCount = 1;
 		submitInfo.pCommandBuffers = &drawCmdBuffers[currentBuffer];
 		VK_CHECK_RESULT(vkQueueSubmit(queue, 1, &submitInfo, VK_NULL_HANDLE));
+		counterReadback.valid[currentBuffer] = true;
 		VulkanExampleBase::submitFrame();
 	}
 
@@ -652,9 +956,32 @@ private:
 	{
 		vkDestroyRenderPass(device, geometryPass.renderPass, nullptr);
 		vkDestroyFramebuffer(device, geometryPass.framebuffer, nullptr);
-		geometryPass.geometry.destroy();
 		geometryPass.headIndex.destroy();
-		geometryPass.linkedList.destroy();
+		geometryPass.accumulation.destroy();
+		geometryPass.revealage.destroy();
+		vkDestroySampler(device, geometryPass.sampler, nullptr);
+	}
+
+	void OnUpdateUIOverlay(vks::UIOverlay* overlay) override
+	{
+		if (overlay->header("Settings")) {
+			overlay->sliderInt("Node budget (MB)", &nodeBudget.budgetMB, 4, 512);
+			overlay->checkBox("Adapt node capacity", &nodeBudget.adaptive);
+			overlay->sliderInt("K-buffer size", &kBufferSize, 1, MAX_K_BUFFER_SIZE);
+		}
+		if (overlay->header("Statistics")) {
+			const float nodeBufferMB = static_cast<float>(static_cast<VkDeviceSize>(nodeBudget.capacity) * sizeof(Node)) / (1024.0f * 1024.0f);
+			// Head index (32 bit), accumulation (64 bit) and revealage (16 bit) per pixel
+			const float perPixelMB = static_cast<float>(static_cast<VkDeviceSize>(width) * height * (4 + 8 + 2)) / (1024.0f * 1024.0f);
+			const uint32_t fragmentCount = counterReadback.fragmentCount;
+			const float overflowRate = (fragmentCount > 0) ? 100.0f * static_cast<float>(counterReadback.overflowCount) / static_cast<float>(fragmentCount) : 0.0f;
+			overlay->text("Node buffer: %.1f of %d MB", nodeBufferMB, nodeBudget.budgetMB);
+			overlay->text("Per-pixel buffers: %.1f MB", perPixelMB);
+			overlay->text("Nodes: %d / %d", std::min(fragmentCount, nodeBudget.capacity), nodeBudget.capacity);
+			overlay->text("Fragments: %d", fragmentCount);
+			overlay->text("Overflow: %d (%.2f %%)", counterReadback.overflowCount, overflowRate);
+			overlay->text("Capacity changes: %d", nodeBudget.resizeCount);
+		}
 	}
 
 private:
@@ -15,10 +15,16 @@
 
 	A further optimization could be done using a geometry shader to do a single-pass render for the depth map
 	cascades instead of multiple passes (geometry shaders are not supported on all target devices).
+
+	Cascades are stabilized by fitting them to a bounding sphere of their frustum split (so their size doesn't change with
+	the camera's rotation) and snapping their origin to whole shadow map texels (so their content doesn't move with the
+	camera's translation). Each cascade only draws the glTF primitives that intersect its light frustum, and distant
+	cascades are only rendered every few frames, reusing their shadow map layer and matrix from an earlier frame.
 */
 
 #include "vulkanexamplebase.h"
 #include "VulkanglTFModel.h"
+#include "frustum.hpp"
 
 #define ENABLE_VALIDATION false
 
@@ -28,6 +34,7 @@
 #define SHADOWMAP_DIM 4096
 #endif
 
+// Maximum number of cascades, must match the shaders
 #define SHADOW_MAP_CASCADE_COUNT 4
 
 class VulkanExample : public VulkanExampleBase
@@ -37,6 +44,20 @@ public:
 	int32_t displayDepthMapCascadeIndex = 0;
 	bool colorCascades = false;
 	bool filterPCF = false;
+	// Snap cascades to shadow map texels to remove shimmering
+	bool stableCascades = true;
+	// Only draw primitives that intersect a cascade's light frustum
+	bool cullCascades = true;
+	// Render distant cascades at a reduced rate
+	bool reducedRateUpdates = true;
+
+	int32_t cascadeCount = SHADOW_MAP_CASCADE_COUNT;
+	uint32_t shadowMapDim = SHADOWMAP_DIM;
+	int32_t shadowMapDimIndex = 0;
+	const std::vector<uint32_t> shadowMapDims = { 1024, 2048, 4096 };
+	// Set if all cascades need to be rendered in the next frame, e.g. after settings changed
+	bool forceCascadeUpdate = true;
+	uint32_t cascadeFrame = 0;
 
 	float cascadeSplitLambda = 0.95f;
 
@@ -50,6 +71,26 @@ public:
 		vkglTF::Model tree;
 	} models;
 
+	const std::vector<glm::vec3> treePositions = {
+		glm::vec3(0.0f, 0.0f, 0.0f),
+		glm::vec3(1.25f, 0.25f, 1.25f),
+		glm::vec3(-1.25f, -0.2f, 1.25f),
+		glm::vec3(1.25f, 0.1f, -1.25f),
+		glm::vec3(-1.25f, -0.25f, -1.25f),
+	};
+
+	// Primitive of a model instance drawn into the shadow map cascades, with world space bounds for culling
+	struct ShadowCaster {
+		vkglTF::Model *model;
+		glm::vec4 position;
+		VkDescriptorSet materialDescriptorSet;
+		uint32_t firstIndex;
+		uint32_t indexCount;
+		glm::vec3 center;
+		float radius;
+	};
+	std::vector<ShadowCaster> shadowCasters;
+
 	struct uniformBuffers {
 		vks::Buffer VS;
 		vks::Buffer FS;
@@ -67,7 +108,7 @@ public:
 		glm::mat4 cascadeViewProjMat[4];
 		glm::mat4 inverseViewMat;
 		glm::vec3 lightDir;
-		float _pad;
+		int32_t cascadeCount;
 		int32_t colorCascades;
 	} uboFS;
 
@@ -108,11 +149,11 @@ public:
 		VkDeviceMemory mem;
 		VkImageView view;
 		VkSampler sampler;
+		// The sampler is kept if the image is recreated with a different size
 		void destroy(VkDevice device) {
 			vkDestroyImageView(device, view, nullptr);
 			vkDestroyImage(device, image, nullptr);
 			vkFreeMemory(device, mem, nullptr);
-			vkDestroySampler(device, sampler, nullptr);
 		}
 	} depth;
 
@@ -124,6 +165,15 @@ public:
 
 		float splitDepth;
 		glm::mat4 viewProjMatrix;
+		vks::Frustum frustum;
+
+		// Rendered every n-th frame if reduced rate updates are enabled
+		uint32_t updateInterval;
+		// Rendered in the current frame, otherwise the layer and matrix of an earlier frame are reused
+		bool update;
+		uint32_t drawCount;
+		uint32_t culledCount;
+		float gpuTime;
 
 		void destroy(VkDevice device) {
 			vkDestroyImageView(device, view, nullptr);
@@ -132,6 +182,12 @@ public:
 	};
 	std::array<Cascade, SHADOW_MAP_CASCADE_COUNT> cascades;
 
+	// Timestamps before and after each cascade's pass, per command buffer
+	struct Timings {
+		VkQueryPool queryPool = VK_NULL_HANDLE;
+		std::vector<std::array<bool, SHADOW_MAP_CASCADE_COUNT>> written;
+	} timings;
+
 	VulkanExample() : VulkanExampleBase(ENABLE_VALIDATION)
 	{
 		title = "Cascaded shadow mapping";
@@ -142,6 +198,19 @@ public:
 		camera.setPosition(glm::vec3(-0.12f, 1.14f, -2.25f));
 		camera.setRotation(glm::vec3(-17.0f, 7.0f, 0.0f));
 		timer = 0.2f;
+		for (uint32_t i = 0; i < shadowMapDims.size(); i++) {
+			if (shadowMapDims[i] == SHADOWMAP_DIM) {
+				shadowMapDimIndex = i;
+			}
+		}
+		for (uint32_t i = 0; i < SHADOW_MAP_CASCADE_COUNT; i++) {
+			// Near cascades are rendered every frame, the others every second and fourth frame
+			cascades[i].updateInterval = (i < 2) ? 1 : (1 << (i - 1));
+			cascades[i].update = true;
+			cascades[i].drawCount = 0;
+			cascades[i].culledCount = 0;
+			cascades[i].gpuTime = 0.0f;
+		}
 	}
 
 	~VulkanExample()
@@ -150,6 +219,10 @@ public:
 			cascade.destroy(device);
 		}
 		depth.destroy(device);
+		vkDestroySampler(device, depth.sampler, nullptr);
+		if (timings.queryPool != VK_NULL_HANDLE) {
+			vkDestroyQueryPool(device, timings.queryPool, nullptr);
+		}
 
 		vkDestroyRenderPass(device, depthPass.renderPass, nullptr);
 
@@ -191,15 +264,7 @@ public:
 		models.terrain.draw(commandBuffer, vkglTF::RenderFlags::BindImages, pipelineLayout);
 
 		// Trees
-		const std::vector<glm::vec3> positions = {
-			glm::vec3(0.0f, 0.0f, 0.0f),
-			glm::vec3(1.25f, 0.25f, 1.25f),
-			glm::vec3(-1.25f, -0.2f, 1.25f),
-			glm::vec3(1.25f, 0.1f, -1.25f),
-			glm::vec3(-1.25f, -0.25f, -1.25f),
-		};
-
-		for (auto position : positions) {
+		for (auto position : treePositions) {
 			pushConstBlock.position = glm::vec4(position, 0.0f);
 			vkCmdPushConstants(commandBuffer, pipelineLayout, VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(PushConstBlock), &pushConstBlock);
 			vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 0, 1, &descriptorSet, 0, nullptr);
@@ -207,6 +272,96 @@ public:
 		}
 	}
 
+	// Primitives are culled against the cascade's light frustum, the near plane is skipped with depth clamp as casters between the light and the cascade still cast shadows into it
+	bool casterInCascade(const ShadowCaster &caster, const Cascade &cascade)
+	{
+		for (uint32_t i = 0; i < cascade.frustum.planes.size(); i++) {
+			if ((i == vks::Frustum::BACK) && deviceFeatures.depthClamp) {
+				continue;
+			}
+			const glm::vec4 &plane = cascade.frustum.planes[i];
+			if (glm::dot(glm::vec3(plane), caster.center) + plane.w <= -caster.radius) {
+				return false;
+			}
+		}
+		return true;
+	}
+
+	/*
+		Render the shadow casters intersecting a cascade into its depth map layer
+		Unlike renderScene this draws single primitives, so buffers, material sets and push constants are only bound if they change
+	*/
+	void renderShadowCasters(VkCommandBuffer commandBuffer, uint32_t cascadeIndex)
+	{
+		Cascade &cascade = cascades[cascadeIndex];
+		cascade.drawCount = 0;
+		cascade.culledCount = 0;
+
+		vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, depthPass.pipelineLayout, 0, 1, &cascade.descriptorSet, 0, nullptr);
+
+		vkglTF::Model *boundModel = nullptr;
+		VkDescriptorSet boundMaterialSet = VK_NULL_HANDLE;
+		PushConstBlock pushConstBlock = { glm::vec4(0.0f), cascadeIndex };
+		vkCmdPushConstants(commandBuffer, depthPass.pipelineLayout, VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(PushConstBlock), &pushConstBlock);
+
+		for (auto &caster : shadowCasters) {
+			if (cullCascades && !casterInCascade(caster, cascade)) {
+				cascade.culledCount++;
+				continue;
+			}
+			if (caster.model != boundModel) {
+				const VkDeviceSize offsets[1] = { 0 };
+				vkCmdBindVertexBuffers(commandBuffer, 0, 1, &caster.model->vertices.buffer, offsets);
+				vkCmdBindIndexBuffer(commandBuffer, caster.model->indices.buffer, 0, VK_INDEX_TYPE_UINT32);
+				boundModel = caster.model;
+			}
+			if (caster.materialDescriptorSet != boundMaterialSet) {
+				vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, depthPass.pipelineLayout, 1, 1, &caster.materialDescriptorSet, 0, nullptr);
+				boundMaterialSet = caster.materialDescriptorSet;
+			}
+			if (caster.position != pushConstBlock.position) {
+				pushConstBlock.position = caster.position;
+				vkCmdPushConstants(commandBuffer, depthPass.pipelineLayout, VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(PushConstBlock), &pushConstBlock);
+			}
+			vkCmdDrawIndexed(commandBuffer, caster.indexCount, 1, caster.firstIndex, 0, 0);
+			cascade.drawCount++;
+		}
+	}
+
+	// Adds the primitives of a model instance to the shadow casters, bounds are the primitive's accessor bounds transformed like the pre-transformed vertices
+	void addShadowCasters(vkglTF::Model &model, const glm::vec3 &position)
+	{
+		const glm::mat4 flip = glm::scale(glm::mat4(1.0f), glm::vec3(1.0f, -1.0f, 1.0f));
+		for (auto node : model.linearNodes) {
+			if (!node->mesh) {
+				continue;
+			}
+			const glm::mat4 matrix = glm::translate(glm::mat4(1.0f), position) * flip * node->getMatrix();
+			for (auto primitive : node->mesh->primitives) {
+				if (primitive->indexCount == 0) {
+					continue;
+				}
+				glm::vec3 boundsMin(FLT_MAX);
+				glm::vec3 boundsMax(-FLT_MAX);
+				for (uint32_t i = 0; i < 8; i++) {
+					glm::vec3 corner((i & 1) ? primitive->dimensions.max.x : primitive->dimensions.min.x, (i & 2) ? primitive->dimensions.max.y : primitive->dimensions.min.y, (i & 4) ? primitive->dimensions.max.z : primitive->dimensions.min.z);
+					corner = glm::vec3(matrix * glm::vec4(corner, 1.0f));
+					boundsMin = glm::min(boundsMin, corner);
+					boundsMax = glm::max(boundsMax, corner);
+				}
+				ShadowCaster caster{};
+				caster.model = &model;
+				caster.position = glm::vec4(position, 0.0f);
+				caster.materialDescriptorSet = primitive->material.descriptorSet;
+				caster.firstIndex = primitive->firstIndex;
+				caster.indexCount = primitive->indexCount;
+				caster.center = (boundsMin + boundsMax) * 0.5f;
+				caster.radius = glm::length(boundsMax - caster.center);
+				shadowCasters.push_back(caster);
+			}
+		}
+	}
+
 	/*
 		Setup resources used by the depth pass
 		The depth image is layered with each layer storing one shadow map cascade
@@ -267,14 +422,36 @@ public:
 
 		VK_CHECK_RESULT(vkCreateRenderPass(device, &renderPassCreateInfo, nullptr, &depthPass.renderPass));
 
-		/*
-			Layered depth image and views
-		*/
+		// Shared sampler for cascade depth reads
+		VkSamplerCreateInfo sampler = vks::initializers::samplerCreateInfo();
+		sampler.magFilter = VK_FILTER_LINEAR;
+		sampler.minFilter = VK_FILTER_LINEAR;
+		sampler.mipmapMode = VK_SAMPLER_MIPMAP_MODE_LINEAR;
+		sampler.addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+		sampler.addressModeV = sampler.addressModeU;
+		sampler.addressModeW = sampler.addressModeU;
+		sampler.mipLodBias = 0.0f;
+		sampler.maxAnisotropy = 1.0f;
+		sampler.minLod = 0.0f;
+		sampler.maxLod = 1.0f;
+		sampler.borderColor = VK_BORDER_COLOR_FLOAT_OPAQUE_WHITE;
+		VK_CHECK_RESULT(vkCreateSampler(device, &sampler, nullptr, &depth.sampler));
+
+		prepareDepthImage();
+	}
+
+	/*
+		Layered depth image and views
+		Recreated if the shadow map resolution is changed
+	*/
+	void prepareDepthImage()
+	{
+		VkFormat depthFormat = vulkanDevice->getSupportedDepthFormat(true);
 
 		VkImageCreateInfo imageInfo = vks::initializers::imageCreateInfo();
 		imageInfo.imageType = VK_IMAGE_TYPE_2D;
-		imageInfo.extent.width = SHADOWMAP_DIM;
-		imageInfo.extent.height = SHADOWMAP_DIM;
+		imageInfo.extent.width = shadowMapDim;
+		imageInfo.extent.height = shadowMapDim;
 		imageInfo.extent.depth = 1;
 		imageInfo.mipLevels = 1;
 		imageInfo.arrayLayers = SHADOW_MAP_CASCADE_COUNT;
@@ -323,124 +500,188 @@ public:
 			framebufferInfo.renderPass = depthPass.renderPass;
 			framebufferInfo.attachmentCount = 1;
 			framebufferInfo.pAttachments = &cascades[i].view;
-			framebufferInfo.width = SHADOWMAP_DIM;
-			framebufferInfo.height = SHADOWMAP_DIM;
+			framebufferInfo.width = shadowMapDim;
+			framebufferInfo.height = shadowMapDim;
 			framebufferInfo.layers = 1;
 			VK_CHECK_RESULT(vkCreateFramebuffer(device, &framebufferInfo, nullptr, &cascades[i].frameBuffer));
 		}
 
-		// Shared sampler for cascade depth reads
-		VkSamplerCreateInfo sampler = vks::initializers::samplerCreateInfo();
-		sampler.magFilter = VK_FILTER_LINEAR;
-		sampler.minFilter = VK_FILTER_LINEAR;
-		sampler.mipmapMode = VK_SAMPLER_MIPMAP_MODE_LINEAR;
-		sampler.addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
-		sampler.addressModeV = sampler.addressModeU;
-		sampler.addressModeW = sampler.addressModeU;
-		sampler.mipLodBias = 0.0f;
-		sampler.maxAnisotropy = 1.0f;
-		sampler.minLod = 0.0f;
-		sampler.maxLod = 1.0f;
-		sampler.borderColor = VK_BORDER_COLOR_FLOAT_OPAQUE_WHITE;
-		VK_CHECK_RESULT(vkCreateSampler(device, &sampler, nullptr, &depth.sampler));
+		// Cascades that are not rendered in a frame (or not used at all) are still sampled, so all layers start in the layout the depth pass leaves them in
+		VkCommandBuffer layoutCmd = vulkanDevice->createCommandBuffer(VK_COMMAND_BUFFER_LEVEL_PRIMARY, true);
+		VkImageSubresourceRange subresourceRange = { VK_IMAGE_ASPECT_DEPTH_BIT, 0, 1, 0, SHADOW_MAP_CASCADE_COUNT };
+		if (vks::tools::formatHasStencil(depthFormat)) {
+			subresourceRange.aspectMask |= VK_IMAGE_ASPECT_STENCIL_BIT;
+		}
+		vks::tools::setImageLayout(layoutCmd, depth.image, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL, subresourceRange);
+		vulkanDevice->flushCommandBuffer(layoutCmd, queue, true);
+
+		// All cascades need to be rendered into the new image
+		forceCascadeUpdate = true;
 	}
 
-	void buildCommandBuffers()
+	void destroyDepthImage()
+	{
+		for (auto cascade : cascades) {
+			cascade.destroy(device);
+		}
+		depth.destroy(device);
+	}
+
+	// Timestamps are written before and after each cascade's pass, there's one command buffer per swapchain image
+	void prepareTimestamps()
+	{
+		if (timings.queryPool != VK_NULL_HANDLE) {
+			vkDestroyQueryPool(device, timings.queryPool, nullptr);
+			timings.queryPool = VK_NULL_HANDLE;
+		}
+		if (vulkanDevice->queueFamilyProperties[vulkanDevice->queueFamilyIndices.graphics].timestampValidBits == 0) {
+			return;
+		}
+		VkQueryPoolCreateInfo queryPoolCI = {};
+		queryPoolCI.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+		queryPoolCI.queryType = VK_QUERY_TYPE_TIMESTAMP;
+		queryPoolCI.queryCount = static_cast<uint32_t>(drawCmdBuffers.size()) * SHADOW_MAP_CASCADE_COUNT * 2;
+		VK_CHECK_RESULT(vkCreateQueryPool(device, &queryPoolCI, nullptr, &timings.queryPool));
+		std::array<bool, SHADOW_MAP_CASCADE_COUNT> none;
+		none.fill(false);
+		timings.written.assign(drawCmdBuffers.size(), none);
+	}
+
+	// Reads the timestamps of the cascades rendered in the frame that just finished
+	void updateTimings()
 	{
+		if (timings.queryPool == VK_NULL_HANDLE) {
+			return;
+		}
+		const float timestampPeriod = vulkanDevice->properties.limits.timestampPeriod;
+		for (uint32_t i = 0; i < SHADOW_MAP_CASCADE_COUNT; i++) {
+			if (!timings.written[currentBuffer][i]) {
+				continue;
+			}
+			std::array<uint64_t, 2> timestamps;
+			const uint32_t firstQuery = (currentBuffer * SHADOW_MAP_CASCADE_COUNT + i) * 2;
+			if (vkGetQueryPoolResults(device, timings.queryPool, firstQuery, 2, sizeof(timestamps), timestamps.data(), sizeof(uint64_t), VK_QUERY_RESULT_64_BIT) == VK_SUCCESS) {
+				cascades[i].gpuTime = static_cast<float>(timestamps[1] - timestamps[0]) * timestampPeriod / 1000000.0f;
+			}
+		}
+	}
+
+	void buildCommandBuffer(uint32_t index)
+	{
+		VkCommandBuffer commandBuffer = drawCmdBuffers[index];
 		VkCommandBufferBeginInfo cmdBufInfo = vks::initializers::commandBufferBeginInfo();
 
-		for (int32_t i = 0; i < drawCmdBuffers.size(); i++) {
-
-			VK_CHECK_RESULT(vkBeginCommandBuffer(drawCmdBuffers[i], &cmdBufInfo));
-
-			/*
-				Generate depth map cascades
-
-				Uses multiple passes with each pass rendering the scene to the cascade's depth image layer
-				Could be optimized using a geometry shader (and layered frame buffer) on devices that support geometry shaders
-			*/
-			{
-				VkClearValue clearValues[1];
-				clearValues[0].depthStencil = { 1.0f, 0 };
-
-				VkRenderPassBeginInfo renderPassBeginInfo = vks::initializers::renderPassBeginInfo();
-				renderPassBeginInfo.renderPass = depthPass.renderPass;
-				renderPassBeginInfo.renderArea.offset.x = 0;
-				renderPassBeginInfo.renderArea.offset.y = 0;
-				renderPassBeginInfo.renderArea.extent.width = SHADOWMAP_DIM;
-				renderPassBeginInfo.renderArea.extent.height = SHADOWMAP_DIM;
-				renderPassBeginInfo.clearValueCount = 1;
-				renderPassBeginInfo.pClearValues = clearValues;
-
-				VkViewport viewport = vks::initializers::viewport((float)SHADOWMAP_DIM, (float)SHADOWMAP_DIM, 0.0f, 1.0f);
-				vkCmdSetViewport(drawCmdBuffers[i], 0, 1, &viewport);
-
-				VkRect2D scissor = vks::initializers::rect2D(SHADOWMAP_DIM, SHADOWMAP_DIM, 0, 0);
-				vkCmdSetScissor(drawCmdBuffers[i], 0, 1, &scissor);
-
-				// One pass per cascade
-				// The layer that this pass renders to is defined by the cascade's image view (selected via the cascade's descriptor set)
-				for (uint32_t j = 0; j < SHADOW_MAP_CASCADE_COUNT; j++) {
-					renderPassBeginInfo.framebuffer = cascades[j].frameBuffer;
-					vkCmdBeginRenderPass(drawCmdBuffers[i], &renderPassBeginInfo, VK_SUBPASS_CONTENTS_INLINE);
-					vkCmdBindPipeline(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, depthPass.pipeline);
-					renderScene(drawCmdBuffers[i], depthPass.pipelineLayout, cascades[j].descriptorSet, j);
-					vkCmdEndRenderPass(drawCmdBuffers[i]);
+		VK_CHECK_RESULT(vkBeginCommandBuffer(commandBuffer, &cmdBufInfo));
+
+		if (timings.queryPool != VK_NULL_HANDLE) {
+			vkCmdResetQueryPool(commandBuffer, timings.queryPool, index * SHADOW_MAP_CASCADE_COUNT * 2, SHADOW_MAP_CASCADE_COUNT * 2);
+			timings.written[index].fill(false);
+		}
+
+		/*
+			Generate depth map cascades
+
+			Uses multiple passes with each pass rendering the scene to the cascade's depth image layer
+			Could be optimized using a geometry shader (and layered frame buffer) on devices that support geometry shaders
+			Cascades that are not updated in this frame keep the depth from the frame they were last rendered in
+		*/
+		{
+			VkClearValue clearValues[1];
+			clearValues[0].depthStencil = { 1.0f, 0 };
+
+			VkRenderPassBeginInfo renderPassBeginInfo = vks::initializers::renderPassBeginInfo();
+			renderPassBeginInfo.renderPass = depthPass.renderPass;
+			renderPassBeginInfo.renderArea.offset.x = 0;
+			renderPassBeginInfo.renderArea.offset.y = 0;
+			renderPassBeginInfo.renderArea.extent.width = shadowMapDim;
+			renderPassBeginInfo.renderArea.extent.height = shadowMapDim;
+			renderPassBeginInfo.clearValueCount = 1;
+			renderPassBeginInfo.pClearValues = clearValues;
+
+			VkViewport viewport = vks::initializers::viewport((float)shadowMapDim, (float)shadowMapDim, 0.0f, 1.0f);
+			vkCmdSetViewport(commandBuffer, 0, 1, &viewport);
+
+			VkRect2D scissor = vks::initializers::rect2D(shadowMapDim, shadowMapDim, 0, 0);
+			vkCmdSetScissor(commandBuffer, 0, 1, &scissor);
+
+			// One pass per cascade
+			// The layer that this pass renders to is defined by the cascade's image view (selected via the cascade's descriptor set)
+			for (uint32_t j = 0; j < static_cast<uint32_t>(cascadeCount); j++) {
+				if (!cascades[j].update) {
+					continue;
+				}
+				const uint32_t firstQuery = (index * SHADOW_MAP_CASCADE_COUNT + j) * 2;
+				if (timings.queryPool != VK_NULL_HANDLE) {
+					vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, timings.queryPool, firstQuery);
+				}
+				renderPassBeginInfo.framebuffer = cascades[j].frameBuffer;
+				vkCmdBeginRenderPass(commandBuffer, &renderPassBeginInfo, VK_SUBPASS_CONTENTS_INLINE);
+				vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, depthPass.pipeline);
+				renderShadowCasters(commandBuffer, j);
+				vkCmdEndRenderPass(commandBuffer);
+				if (timings.queryPool != VK_NULL_HANDLE) {
+					vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, timings.queryPool, firstQuery + 1);
+					timings.written[index][j] = true;
 				}
 			}
+		}
 
-			/*
-				Note: Explicit synchronization is not required between the render pass, as this is done implicit via sub pass dependencies
-			*/
-
-			/*
-				Scene rendering using depth cascades for shadow mapping
-			*/
-
-			{
-				VkClearValue clearValues[2];
-				clearValues[0].color = { { 0.0f, 0.0f, 0.2f, 1.0f } };
-				clearValues[1].depthStencil = { 1.0f, 0 };
-
-				VkRenderPassBeginInfo renderPassBeginInfo = vks::initializers::renderPassBeginInfo();
-				renderPassBeginInfo.renderPass = renderPass;
-				renderPassBeginInfo.framebuffer = frameBuffers[i];
-				renderPassBeginInfo.renderArea.offset.x = 0;
-				renderPassBeginInfo.renderArea.offset.y = 0;
-				renderPassBeginInfo.renderArea.extent.width = width;
-				renderPassBeginInfo.renderArea.extent.height = height;
-				renderPassBeginInfo.clearValueCount = 2;
-				renderPassBeginInfo.pClearValues = clearValues;
-
-				vkCmdBeginRenderPass(drawCmdBuffers[i], &renderPassBeginInfo, VK_SUBPASS_CONTENTS_INLINE);
-
-				VkViewport viewport = vks::initializers::viewport((float)width, (float)height, 0.0f, 1.0f);
-				vkCmdSetViewport(drawCmdBuffers[i], 0, 1, &viewport);
-
-				VkRect2D scissor = vks::initializers::rect2D(width, height, 0, 0);
-				vkCmdSetScissor(drawCmdBuffers[i], 0, 1, &scissor);
-
-				// Visualize shadow map cascade
-				if (displayDepthMap) {
-					vkCmdBindDescriptorSets(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 0, 1, &descriptorSet, 0, NULL);
-					vkCmdBindPipeline(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pipelines.debugShadowMap);
-					PushConstBlock pushConstBlock = {};
-					pushConstBlock.cascadeIndex = displayDepthMapCascadeIndex;
-					vkCmdPushConstants(drawCmdBuffers[i], pipelineLayout, VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(PushConstBlock), &pushConstBlock);
-					vkCmdDraw(drawCmdBuffers[i], 3, 1, 0, 0);
-				}
+		/*
+			Note: Explicit synchronization is not required between the render pass, as this is done implicit via sub pass dependencies
+		*/
+
+		/*
+			Scene rendering using depth cascades for shadow mapping
+		*/
+
+		{
+			VkClearValue clearValues[2];
+			clearValues[0].color = { { 0.0f, 0.0f, 0.2f, 1.0f } };
+			clearValues[1].depthStencil = { 1.0f, 0 };
 
-				// Render shadowed scene
-				vkCmdBindPipeline(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, (filterPCF) ? pipelines.sceneShadowPCF : pipelines.sceneShadow);
-				renderScene(drawCmdBuffers[i], pipelineLayout, descriptorSet);
+			VkRenderPassBeginInfo renderPassBeginInfo = vks::initializers::renderPassBeginInfo();
+			renderPassBeginInfo.renderPass = renderPass;
+			renderPassBeginInfo.framebuffer = frameBuffers[index];
+			renderPassBeginInfo.renderArea.offset.x = 0;
+			renderPassBeginInfo.renderArea.offset.y = 0;
+			renderPassBeginInfo.renderArea.extent.width = width;
+			renderPassBeginInfo.renderArea.extent.height = height;
+			renderPassBeginInfo.clearValueCount = 2;
+			renderPassBeginInfo.pClearValues = clearValues;
 
-				drawUI(drawCmdBuffers[i]);
+			vkCmdBeginRenderPass(commandBuffer, &renderPassBeginInfo, VK_SUBPASS_CONTENTS_INLINE);
 
-				vkCmdEndRenderPass(drawCmdBuffers[i]);
+			VkViewport viewport = vks::initializers::viewport((float)width, (float)height, 0.0f, 1.0f);
+			vkCmdSetViewport(commandBuffer, 0, 1, &viewport);
+
+			VkRect2D scissor = vks::initializers::rect2D(width, height, 0, 0);
+			vkCmdSetScissor(commandBuffer, 0, 1, &scissor);
+
+			// Visualize shadow map cascade
+			if (displayDepthMap) {
+				vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 0, 1, &descriptorSet, 0, NULL);
+				vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelines.debugShadowMap);
+				PushConstBlock pushConstBlock = {};
+				pushConstBlock.cascadeIndex = std::min(displayDepthMapCascadeIndex, cascadeCount - 1);
+				vkCmdPushConstants(commandBuffer, pipelineLayout, VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(PushConstBlock), &pushConstBlock);
+				vkCmdDraw(commandBuffer, 3, 1, 0, 0);
 			}
 
-			VK_CHECK_RESULT(vkEndCommandBuffer(drawCmdBuffers[i]));
+			// Render shadowed scene
+			vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, (filterPCF) ? pipelines.sceneShadowPCF : pipelines.sceneShadow);
+			renderScene(commandBuffer, pipelineLayout, descriptorSet);
+
+			drawUI(commandBuffer);
+
+			vkCmdEndRenderPass(commandBuffer);
 		}
+
+		VK_CHECK_RESULT(vkEndCommandBuffer(commandBuffer));
+	}
+
+	// The cascades rendered change from frame to frame, so the command buffer of the current frame is recorded again in draw
+	void buildCommandBuffers()
+	{
 	}
 
 	void loadAssets()
@@ -448,6 +689,11 @@ public:
 		uint32_t glTFLoadingFlags = vkglTF::FileLoadingFlags::PreTransformVertices | vkglTF::FileLoadingFlags::FlipY;
 		models.terrain.loadFromFile(getAssetPath() + "models/terrain_gridlines.gltf", vulkanDevice, queue, glTFLoadingFlags);
 		models.tree.loadFromFile(getAssetPath() + "models/oaktree.gltf", vulkanDevice, queue, glTFLoadingFlags);
+
+		addShadowCasters(models.terrain, glm::vec3(0.0f));
+		for (auto position : treePositions) {
+			addShadowCasters(models.tree, position);
+		}
 	}
 
 	void setupLayoutsAndDescriptors()
@@ -483,9 +729,6 @@ public:
 
 		std::vector<VkWriteDescriptorSet> writeDescriptorSets;
 
-		VkDescriptorImageInfo depthMapDescriptor =
-			vks::initializers::descriptorImageInfo(depth.sampler, depth.view, VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL);
-
 		VkDescriptorSetAllocateInfo allocInfo =
 			vks::initializers::descriptorSetAllocateInfo(descriptorPool, &descriptorSetLayouts.base, 1);
 
@@ -493,7 +736,6 @@ public:
 		VK_CHECK_RESULT(vkAllocateDescriptorSets(device, &allocInfo, &descriptorSet));
 		writeDescriptorSets = {
 			vks::initializers::writeDescriptorSet(descriptorSet, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 0, &uniformBuffers.VS.descriptor),
-			vks::initializers::writeDescriptorSet(descriptorSet, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 1, &depthMapDescriptor),
 			vks::initializers::writeDescriptorSet(descriptorSet, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 2, &uniformBuffers.FS.descriptor),
 		};
 		vkUpdateDescriptorSets(device, static_cast<uint32_t>(writeDescriptorSets.size()), writeDescriptorSets.data(), 0, NULL);
@@ -502,14 +744,14 @@ public:
 		// Each descriptor set represents a single layer of the array texture
 		for (uint32_t i = 0; i < SHADOW_MAP_CASCADE_COUNT; i++) {
 			VK_CHECK_RESULT(vkAllocateDescriptorSets(device, &allocInfo, &cascades[i].descriptorSet));
-			VkDescriptorImageInfo cascadeImageInfo = vks::initializers::descriptorImageInfo(depth.sampler, depth.view, VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL);
 			writeDescriptorSets = {
 				vks::initializers::writeDescriptorSet(cascades[i].descriptorSet, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 0, &depthPass.uniformBuffer.descriptor),
-				vks::initializers::writeDescriptorSet(cascades[i].descriptorSet, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 1, &cascadeImageInfo)
 			};
 			vkUpdateDescriptorSets(device, static_cast<uint32_t>(writeDescriptorSets.size()), writeDescriptorSets.data(), 0, NULL);
 		}
 
+		updateDepthImageDescriptors();
+
 		/*
 			Pipeline layouts
 		*/
@@ -535,6 +777,20 @@ public:
 		}
 	}
 
+	// Depth map image descriptors, updated again if the image is recreated
+	void updateDepthImageDescriptors()
+	{
+		VkDescriptorImageInfo depthMapDescriptor =
+			vks::initializers::descriptorImageInfo(depth.sampler, depth.view, VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL);
+		std::vector<VkWriteDescriptorSet> writeDescriptorSets = {
+			vks::initializers::writeDescriptorSet(descriptorSet, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 1, &depthMapDescriptor),
+		};
+		for (uint32_t i = 0; i < SHADOW_MAP_CASCADE_COUNT; i++) {
+			writeDescriptorSets.push_back(vks::initializers::writeDescriptorSet(cascades[i].descriptorSet, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 1, &depthMapDescriptor));
+		}
+		vkUpdateDescriptorSets(device, static_cast<uint32_t>(writeDescriptorSets.size()), writeDescriptorSets.data(), 0, NULL);
+	}
+
 	void preparePipelines()
 	{
 		VkPipelineInputAssemblyStateCreateInfo inputAssemblyState = vks::initializers::pipelineInputAssemblyStateCreateInfo(VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST, 0, VK_FALSE);
@@ -649,8 +905,8 @@ public:
 
 		// Calculate split depths based on view camera frustum
 		// Based on method presented in https://developer.nvidia.com/gpugems/GPUGems3/gpugems3_ch10.html
-		for (uint32_t i = 0; i < SHADOW_MAP_CASCADE_COUNT; i++) {
-			float p = (i + 1) / static_cast<float>(SHADOW_MAP_CASCADE_COUNT);
+		for (uint32_t i = 0; i < static_cast<uint32_t>(cascadeCount); i++) {
+			float p = (i + 1) / static_cast<float>(cascadeCount);
 			float log = minZ * std::pow(ratio, p);
 			float uniform = minZ + range * p;
 			float d = cascadeSplitLambda * (log - uniform) + uniform;
@@ -659,9 +915,17 @@ public:
 
 		// Calculate orthographic projection matrix for each cascade
 		float lastSplitDist = 0.0;
-		for (uint32_t i = 0; i < SHADOW_MAP_CASCADE_COUNT; i++) {
+		for (uint32_t i = 0; i < static_cast<uint32_t>(cascadeCount); i++) {
 			float splitDist = cascadeSplits[i];
 
+			// Split depths only change with the settings, so they're valid for cascades that reuse an earlier frame
+			cascades[i].splitDepth = (camera.getNearClip() + splitDist * clipRange) * -1.0f;
+			cascades[i].update = forceCascadeUpdate || !reducedRateUpdates || ((cascadeFrame + i) % cascades[i].updateInterval == 0);
+			if (!cascades[i].update) {
+				lastSplitDist = cascadeSplits[i];
+				continue;
+			}
+
 			glm::vec3 frustumCorners[8] = {
 				glm::vec3(-1.0f,  1.0f, 0.0f),
 				glm::vec3( 1.0f,  1.0f, 0.0f),
@@ -693,6 +957,7 @@ public:
 			}
 			frustumCenter /= 8.0f;
 
+			// The bounding sphere of the split doesn't change with the camera's rotation, so the size of the cascade stays the same
 			float radius = 0.0f;
 			for (uint32_t i = 0; i < 8; i++) {
 				float distance = glm::length(frustumCorners[i] - frustumCenter);
@@ -707,12 +972,25 @@ public:
 			glm::mat4 lightViewMatrix = glm::lookAt(frustumCenter - lightDir * -minExtents.z, frustumCenter, glm::vec3(0.0f, 1.0f, 0.0f));
 			glm::mat4 lightOrthoMatrix = glm::ortho(minExtents.x, maxExtents.x, minExtents.y, maxExtents.y, 0.0f, maxExtents.z - minExtents.z);
 
-			// Store split distance and matrix in cascade
-			cascades[i].splitDepth = (camera.getNearClip() + splitDist * clipRange) * -1.0f;
+			// Snap the projection to whole texels, so the shadow map content doesn't move in sub texel steps with the camera
+			if (stableCascades) {
+				glm::vec4 shadowOrigin = (lightOrthoMatrix * lightViewMatrix) * glm::vec4(0.0f, 0.0f, 0.0f, 1.0f);
+				shadowOrigin *= static_cast<float>(shadowMapDim) / 2.0f;
+				glm::vec4 roundOffset = glm::round(shadowOrigin) - shadowOrigin;
+				roundOffset *= 2.0f / static_cast<float>(shadowMapDim);
+				lightOrthoMatrix[3][0] += roundOffset.x;
+				lightOrthoMatrix[3][1] += roundOffset.y;
+			}
+
+			// Store matrix and light frustum in cascade
 			cascades[i].viewProjMatrix = lightOrthoMatrix * lightViewMatrix;
+			cascades[i].frustum.update(cascades[i].viewProjMatrix);
 
 			lastSplitDist = cascadeSplits[i];
 		}
+
+		forceCascadeUpdate = false;
+		cascadeFrame++;
 	}
 
 	void updateLight()
@@ -749,6 +1027,7 @@ public:
 		}
 		uboFS.inverseViewMat = glm::inverse(camera.matrices.view);
 		uboFS.lightDir = normalize(-lightPos);
+		uboFS.cascadeCount = cascadeCount;
 		uboFS.colorCascades = colorCascades;
 		memcpy(uniformBuffers.FS.mapped, &uboFS, sizeof(uboFS));
 	}
@@ -756,10 +1035,25 @@ public:
 	void draw()
 	{
 		VulkanExampleBase::prepareFrame();
+
+		// The previous frame has finished (the base class waits for the queue), so the cascades can be updated and the frame recorded
+		if (!paused || camera.updated || forceCascadeUpdate) {
+			updateLight();
+			updateCascades();
+			updateUniformBuffers();
+		} else {
+			// Neither the light nor the camera moved, all cascades are still valid
+			for (auto &cascade : cascades) {
+				cascade.update = false;
+			}
+		}
+		buildCommandBuffer(currentBuffer);
+
 		submitInfo.commandBufferCount = 1;
 		submitInfo.pCommandBuffers = &drawCmdBuffers[currentBuffer];
 		VK_CHECK_RESULT(vkQueueSubmit(queue, 1, &submitInfo, VK_NULL_HANDLE));
 		VulkanExampleBase::submitFrame();
+		updateTimings();
 	}
 
 	void prepare()
@@ -770,44 +1064,67 @@ public:
 		updateCascades();
 		prepareDepthPass();
 		prepareUniformBuffers();
+		prepareTimestamps();
 		setupLayoutsAndDescriptors();
 		preparePipelines();
-		buildCommandBuffers();
 		prepared = true;
 	}
 
+	// The number of command buffers depends on the swapchain, and the cascades on the camera's aspect ratio
+	virtual void windowResized()
+	{
+		prepareTimestamps();
+		forceCascadeUpdate = true;
+	}
+
 	virtual void render()
 	{
 		if (!prepared)
 			return;
 		draw();
-		if (!paused || camera.updated) {
-			updateLight();
-			updateCascades();
-			updateUniformBuffers();
-		}
 	}
 
 	virtual void OnUpdateUIOverlay(vks::UIOverlay *overlay)
 	{
 		if (overlay->header("Settings")) {
+			if (overlay->sliderInt("Cascades", &cascadeCount, 1, SHADOW_MAP_CASCADE_COUNT)) {
+				forceCascadeUpdate = true;
+			}
+			std::vector<std::string> shadowMapDimNames;
+			for (auto dim : shadowMapDims) {
+				shadowMapDimNames.push_back(std::to_string(dim));
+			}
+			if (overlay->comboBox("Shadow map size", &shadowMapDimIndex, shadowMapDimNames)) {
+				vkDeviceWaitIdle(device);
+				shadowMapDim = shadowMapDims[shadowMapDimIndex];
+				destroyDepthImage();
+				prepareDepthImage();
+				updateDepthImageDescriptors();
+			}
 			if (overlay->sliderFloat("Split lambda", &cascadeSplitLambda, 0.1f, 1.0f)) {
-				updateCascades();
-				updateUniformBuffers();
+				forceCascadeUpdate = true;
 			}
+			if (overlay->checkBox("Stable cascades", &stableCascades)) {
+				forceCascadeUpdate = true;
+			}
+			overlay->checkBox("Cull casters per cascade", &cullCascades);
+			overlay->checkBox("Reduced rate for distant cascades", &reducedRateUpdates);
 			if (overlay->checkBox("Color cascades", &colorCascades)) {
 				updateUniformBuffers();
 			}
-			if (overlay->checkBox("Display depth map", &displayDepthMap)) {
-				buildCommandBuffers();
-			}
+			overlay->checkBox("Display depth map", &displayDepthMap);
 			if (displayDepthMap) {
-				if (overlay->sliderInt("Cascade", &displayDepthMapCascadeIndex, 0, SHADOW_MAP_CASCADE_COUNT - 1)) {
-					buildCommandBuffers();
-				}
+				overlay->sliderInt("Cascade", &displayDepthMapCascadeIndex, 0, cascadeCount - 1);
 			}
-			if (overlay->checkBox("PCF filtering", &filterPCF)) {
-				buildCommandBuffers();
+			overlay->checkBox("PCF filtering", &filterPCF);
+		}
+		if (overlay->header("Statistics")) {
+			for (uint32_t i = 0; i < static_cast<uint32_t>(cascadeCount); i++) {
+				if (cascades[i].update) {
+					overlay->text("Cascade %d: %d draws, %d culled, %.3f ms", i, cascades[i].drawCount, cascades[i].culledCount, cascades[i].gpuTime);
+				} else {
+					overlay->text("Cascade %d: reused", i);
+				}
 			}
 		}
 	}
@@ -1,5 +1,10 @@
 /*
-* Vulkan Example - Omni directional shadows using a dynamic cube map
+* Vulkan Example - Omni directional shadows for many point lights using multiview cube map arrays
+*
+* All six faces of a light's shadow cube map are rendered in a single pass with VK_KHR_multiview, each view writes one
+* layer of the light's cube in a depth cube map array. Static geometry is rendered into a separate cache that is only
+* updated when a light moves, each frame the cached depth is copied to the shadow map and only the dynamic casters in
+* range of a light are rendered on top. Faces that a caster can't reach are culled in the vertex shader
 *
 * Copyright (C) by Sascha Willems - www.saschawillems.de
 *
@@ -11,18 +16,24 @@
 
 #define ENABLE_VALIDATION false
 
-// Texture properties
-#define TEX_DIM 1024
-#define TEX_FILTER VK_FILTER_LINEAR
-
-// Offscreen frame buffer properties
-#define FB_DIM TEX_DIM
-#define FB_COLOR_FORMAT VK_FORMAT_R32_SFLOAT
+// Must match the shaders
+#define MAX_LIGHTS 32
+#define DYNAMIC_CASTER_COUNT 8
+#define SHADOW_NEAR_PLANE 0.1f
 
 class VulkanExample : public VulkanExampleBase
 {
 public:
 	bool displayCubeMap = false;
+	int32_t displayLight = 0;
+	int32_t lightCount = 8;
+	// Size of a shadow cube map face, selectable in the UI
+	const std::vector<uint32_t> shadowMapSizes = { 256, 512, 1024, 2048 };
+	int32_t shadowMapSizeIndex = 2;
+	bool animateLights = false;
+	bool animateCasters = true;
+	// Disabling the cache renders static geometry for all lights every frame for comparison
+	bool cacheStaticShadows = true;
 
 	float zNear = 0.1f;
 	float zFar = 1024.0f;
@@ -32,325 +43,149 @@ public:
 		vkglTF::Model debugcube;
 	} models;
 
-	struct {
-		vks::Buffer scene;
-		vks::Buffer offscreen;
-	} uniformBuffers;
+	struct Light {
+		glm::vec3 position;
+		float range;
+		glm::vec3 color;
+		// Static geometry has to be rendered into the cache again
+		bool staticDirty = true;
+		// Dynamic casters were composited into the shadow map in the last frame
+		bool dynamicLastFrame = false;
+		uint32_t staticFaceMask = 0;
+	};
+	std::array<Light, MAX_LIGHTS> lights;
 
-	struct {
-		glm::mat4 projection;
+	struct Caster {
 		glm::mat4 model;
-	} uboVSquad;
-
-	glm::vec4 lightPos = glm::vec4(0.0f, -2.5f, 0.0f, 1.0);
+		glm::vec3 center;
+		float radius;
+	};
+	std::array<Caster, DYNAMIC_CASTER_COUNT> casters;
+	bool castersMoved = true;
 
-	struct UBO {
+	struct UBOScene {
 		glm::mat4 projection;
 		glm::mat4 view;
-		glm::mat4 model;
-		glm::vec4 lightPos;
+		// x = number of lights
+		glm::ivec4 params;
+	} uboScene;
+
+	// Per light data shared by the shadow and the scene passes
+	struct UBOLight {
+		glm::mat4 faceViewProjection[6];
+		// xyz = position, w = range
+		glm::vec4 position;
+		glm::vec4 color;
 	};
+	std::array<UBOLight, MAX_LIGHTS> uboLights;
+
+	struct {
+		vks::Buffer scene;
+		vks::Buffer lights;
+	} uniformBuffers;
 
-	UBO uboVSscene, uboOffscreenVS;
+	struct PushConsts {
+		glm::mat4 model;
+		uint32_t light;
+		// Bit per cube face, faces with a cleared bit are culled in the vertex shader
+		uint32_t faceMask;
+	};
 
 	struct {
 		VkPipeline scene;
-		VkPipeline offscreen;
+		VkPipeline shadow;
 		VkPipeline cubemapDisplay;
 	} pipelines;
 
-	struct {
-		VkPipelineLayout scene;
-		VkPipelineLayout offscreen;
-	} pipelineLayouts;
-
-	struct {
-		VkDescriptorSet scene;
-		VkDescriptorSet offscreen;
-	} descriptorSets;
-
+	VkPipelineLayout pipelineLayout;
+	VkDescriptorSet descriptorSet;
 	VkDescriptorSetLayout descriptorSetLayout;
 
-	vks::Texture shadowCubeMap;
-	std::array<VkImageView, 6> shadowCubeMapFaceImageViews;
-
-	// Framebuffer for offscreen rendering
-	struct FrameBufferAttachment {
+	// Depth cube map arrays with six layers per active light, recreated when the light count or the face size changes
+	struct ShadowMaps {
+		VkFormat format;
+		uint32_t size = 0;
+		uint32_t lightCount = 0;
+		// Static geometry only, only updated for lights that changed
+		VkImage cacheImage;
+		VkDeviceMemory cacheMemory;
+		std::vector<VkImageView> cacheViews;
+		std::vector<VkFramebuffer> cacheFramebuffers;
+		// Cache plus dynamic casters, sampled by the scene
 		VkImage image;
-		VkDeviceMemory mem;
-		VkImageView view;
-	};
-	struct OffscreenPass {
-		int32_t width, height;
-		std::array<VkFramebuffer, 6> frameBuffers;
-		FrameBufferAttachment depth;
-		VkRenderPass renderPass;
+		VkDeviceMemory memory;
+		std::vector<VkImageView> views;
+		std::vector<VkFramebuffer> framebuffers;
+		VkImageView cubeArrayView;
+		// Both passes are compatible, so the same pipeline is used
+		VkRenderPass staticPass;
+		VkRenderPass dynamicPass;
+		VkSampler compareSampler;
 		VkSampler sampler;
-		VkDescriptorImageInfo descriptor;
-	} offscreenPass;
+	} shadowMaps;
+
+	struct Statistics {
+		uint32_t staticUpdates = 0;
+		uint32_t composites = 0;
+		uint32_t dynamicDraws = 0;
+		uint32_t culledFaces = 0;
+	} statistics;
 
-	VkFormat fbDepthFormat;
+	VkPhysicalDeviceMultiviewFeaturesKHR physicalDeviceMultiviewFeatures{};
 
 	VulkanExample() : VulkanExampleBase(ENABLE_VALIDATION)
 	{
-		title = "Point light shadows (cubemap)";
+		title = "Point light shadows (multiview cube map arrays)";
 		camera.type = Camera::CameraType::lookat;
 		camera.setPerspective(45.0f, (float)width / (float)height, zNear, zFar);
 		camera.setRotation(glm::vec3(-20.5f, -673.0f, 0.0f));
 		camera.setPosition(glm::vec3(0.0f, 0.5f, -15.0f));
 		timerSpeed *= 0.5f;
+
+		// Enable extension required for multiview
+		enabledDeviceExtensions.push_back(VK_KHR_MULTIVIEW_EXTENSION_NAME);
+
+		// Reading device properties and features for multiview requires VK_KHR_get_physical_device_properties2 to be enabled
+		enabledInstanceExtensions.push_back(VK_KHR_GET_PHYSICAL_DEVICE_PROPERTIES_2_EXTENSION_NAME);
+
+		physicalDeviceMultiviewFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MULTIVIEW_FEATURES_KHR;
+		physicalDeviceMultiviewFeatures.multiview = VK_TRUE;
+		deviceCreatepNextChain = &physicalDeviceMultiviewFeatures;
 	}
 
 	~VulkanExample()
 	{
 		// Clean up used Vulkan resources
 		// Note : Inherited destructor cleans up resources stored in base class
+		destroyShadowMaps();
+		vkDestroySampler(device, shadowMaps.compareSampler, nullptr);
+		vkDestroySampler(device, shadowMaps.sampler, nullptr);
+		vkDestroyRenderPass(device, shadowMaps.staticPass, nullptr);
+		vkDestroyRenderPass(device, shadowMaps.dynamicPass, nullptr);
 
-		// Cube map
-		for (uint32_t i = 0; i < 6; i++)
-		{
-			vkDestroyImageView(device, shadowCubeMapFaceImageViews[i], nullptr);
-		}
-
-		vkDestroyImageView(device, shadowCubeMap.view, nullptr);
-		vkDestroyImage(device, shadowCubeMap.image, nullptr);
-		vkDestroySampler(device, shadowCubeMap.sampler, nullptr);
-		vkFreeMemory(device, shadowCubeMap.deviceMemory, nullptr);
-
-		// Depth attachment
-		vkDestroyImageView(device, offscreenPass.depth.view, nullptr);
-		vkDestroyImage(device, offscreenPass.depth.image, nullptr);
-		vkFreeMemory(device, offscreenPass.depth.mem, nullptr);
-
-		for (uint32_t i = 0; i < 6; i++)
-		{
-			vkDestroyFramebuffer(device, offscreenPass.frameBuffers[i], nullptr);
-		}
-
-		vkDestroyRenderPass(device, offscreenPass.renderPass, nullptr);
-
-		// Pipelines
 		vkDestroyPipeline(device, pipelines.scene, nullptr);
-		vkDestroyPipeline(device, pipelines.offscreen, nullptr);
+		vkDestroyPipeline(device, pipelines.shadow, nullptr);
 		vkDestroyPipeline(device, pipelines.cubemapDisplay, nullptr);
-
-		vkDestroyPipelineLayout(device, pipelineLayouts.scene, nullptr);
-		vkDestroyPipelineLayout(device, pipelineLayouts.offscreen, nullptr);
-
+		vkDestroyPipelineLayout(device, pipelineLayout, nullptr);
 		vkDestroyDescriptorSetLayout(device, descriptorSetLayout, nullptr);
 
-		// Uniform buffers
-		uniformBuffers.offscreen.destroy();
 		uniformBuffers.scene.destroy();
+		uniformBuffers.lights.destroy();
 	}
 
-	void prepareCubeMap()
-	{
-		shadowCubeMap.width = TEX_DIM;
-		shadowCubeMap.height = TEX_DIM;
-
-		// 32 bit float format for higher precision
-		VkFormat format = VK_FORMAT_R32_SFLOAT;
-
-		// Cube map image description
-		VkImageCreateInfo imageCreateInfo = vks::initializers::imageCreateInfo();
-		imageCreateInfo.imageType = VK_IMAGE_TYPE_2D;
-		imageCreateInfo.format = format;
-		imageCreateInfo.extent = { shadowCubeMap.width, shadowCubeMap.height, 1 };
-		imageCreateInfo.mipLevels = 1;
-		imageCreateInfo.arrayLayers = 6;
-		imageCreateInfo.samples = VK_SAMPLE_COUNT_1_BIT;
-		imageCreateInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
-		imageCreateInfo.usage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
-		imageCreateInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
-		imageCreateInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-		imageCreateInfo.flags = VK_IMAGE_CREATE_CUBE_COMPATIBLE_BIT;
-
-		VkMemoryAllocateInfo memAllocInfo = vks::initializers::memoryAllocateInfo();
-		VkMemoryRequirements memReqs;
-
-		VkCommandBuffer layoutCmd = vulkanDevice->createCommandBuffer(VK_COMMAND_BUFFER_LEVEL_PRIMARY, true);
-
-		// Create cube map image
-		VK_CHECK_RESULT(vkCreateImage(device, &imageCreateInfo, nullptr, &shadowCubeMap.image));
-
-		vkGetImageMemoryRequirements(device, shadowCubeMap.image, &memReqs);
-
-		memAllocInfo.allocationSize = memReqs.size;
-		memAllocInfo.memoryTypeIndex = vulkanDevice->getMemoryType(memReqs.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
-		VK_CHECK_RESULT(vkAllocateMemory(device, &memAllocInfo, nullptr, &shadowCubeMap.deviceMemory));
-		VK_CHECK_RESULT(vkBindImageMemory(device, shadowCubeMap.image, shadowCubeMap.deviceMemory, 0));
-
-		// Image barrier for optimal image (target)
-		VkImageSubresourceRange subresourceRange = {};
-		subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-		subresourceRange.baseMipLevel = 0;
-		subresourceRange.levelCount = 1;
-		subresourceRange.layerCount = 6;
-		vks::tools::setImageLayout(
-			layoutCmd,
-			shadowCubeMap.image,
-			VK_IMAGE_LAYOUT_UNDEFINED,
-			VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
-			subresourceRange);
-
-		vulkanDevice->flushCommandBuffer(layoutCmd, queue, true);
-
-		// Create sampler
-		VkSamplerCreateInfo sampler = vks::initializers::samplerCreateInfo();
-		sampler.magFilter = TEX_FILTER;
-		sampler.minFilter = TEX_FILTER;
-		sampler.mipmapMode = VK_SAMPLER_MIPMAP_MODE_LINEAR;
-		sampler.addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_BORDER;
-		sampler.addressModeV = sampler.addressModeU;
-		sampler.addressModeW = sampler.addressModeU;
-		sampler.mipLodBias = 0.0f;
-		sampler.maxAnisotropy = 1.0f;
-		sampler.compareOp = VK_COMPARE_OP_NEVER;
-		sampler.minLod = 0.0f;
-		sampler.maxLod = 1.0f;
-		sampler.borderColor = VK_BORDER_COLOR_FLOAT_OPAQUE_WHITE;
-		VK_CHECK_RESULT(vkCreateSampler(device, &sampler, nullptr, &shadowCubeMap.sampler));
-
-		// Create image view
-		VkImageViewCreateInfo view = vks::initializers::imageViewCreateInfo();
-		view.image = VK_NULL_HANDLE;
-		view.viewType = VK_IMAGE_VIEW_TYPE_CUBE;
-		view.format = format;
-		view.components = { VK_COMPONENT_SWIZZLE_R };
-		view.subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1 };
-		view.subresourceRange.layerCount = 6;
-		view.image = shadowCubeMap.image;
-		VK_CHECK_RESULT(vkCreateImageView(device, &view, nullptr, &shadowCubeMap.view));
-
-		view.viewType = VK_IMAGE_VIEW_TYPE_2D;
-		view.subresourceRange.layerCount = 1;
-		view.image = shadowCubeMap.image;
-
-		for (uint32_t i = 0; i < 6; i++)
-		{
-			view.subresourceRange.baseArrayLayer = i;
-			VK_CHECK_RESULT(vkCreateImageView(device, &view, nullptr, &shadowCubeMapFaceImageViews[i]));
-		}
-	}
-
-	// Prepare a new framebuffer for offscreen rendering
-	// The contents of this framebuffer are then
-	// copied to the different cube map faces
-	void prepareOffscreenFramebuffer()
+	virtual void getEnabledFeatures()
 	{
-		offscreenPass.width = FB_DIM;
-		offscreenPass.height = FB_DIM;
-
-		VkFormat fbColorFormat = FB_COLOR_FORMAT;
-
-		// Color attachment
-		VkImageCreateInfo imageCreateInfo = vks::initializers::imageCreateInfo();
-		imageCreateInfo.imageType = VK_IMAGE_TYPE_2D;
-		imageCreateInfo.format = fbColorFormat;
-		imageCreateInfo.extent.width = offscreenPass.width;
-		imageCreateInfo.extent.height = offscreenPass.height;
-		imageCreateInfo.extent.depth = 1;
-		imageCreateInfo.mipLevels = 1;
-		imageCreateInfo.arrayLayers = 1;
-		imageCreateInfo.samples = VK_SAMPLE_COUNT_1_BIT;
-		imageCreateInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
-		// Image of the framebuffer is blit source
-		imageCreateInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-		imageCreateInfo.usage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
-		imageCreateInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
-
-		VkImageViewCreateInfo colorImageView = vks::initializers::imageViewCreateInfo();
-		colorImageView.viewType = VK_IMAGE_VIEW_TYPE_2D;
-		colorImageView.format = fbColorFormat;
-		colorImageView.flags = 0;
-		colorImageView.subresourceRange = {};
-		colorImageView.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-		colorImageView.subresourceRange.baseMipLevel = 0;
-		colorImageView.subresourceRange.levelCount = 1;
-		colorImageView.subresourceRange.baseArrayLayer = 0;
-		colorImageView.subresourceRange.layerCount = 1;
-
-		VkCommandBuffer layoutCmd = vulkanDevice->createCommandBuffer(VK_COMMAND_BUFFER_LEVEL_PRIMARY, true);
-
-		// Depth stencil attachment
-		imageCreateInfo.format = fbDepthFormat;
-		imageCreateInfo.usage = VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
-
-		VkImageViewCreateInfo depthStencilView = vks::initializers::imageViewCreateInfo();
-		depthStencilView.viewType = VK_IMAGE_VIEW_TYPE_2D;
-		depthStencilView.format = fbDepthFormat;
-		depthStencilView.flags = 0;
-		depthStencilView.subresourceRange = {};
-		depthStencilView.subresourceRange.aspectMask = VK_IMAGE_ASPECT_DEPTH_BIT;
-		if (fbDepthFormat >= VK_FORMAT_D16_UNORM_S8_UINT)
-			depthStencilView.subresourceRange.aspectMask |= VK_IMAGE_ASPECT_STENCIL_BIT;
-		depthStencilView.subresourceRange.baseMipLevel = 0;
-		depthStencilView.subresourceRange.levelCount = 1;
-		depthStencilView.subresourceRange.baseArrayLayer = 0;
-		depthStencilView.subresourceRange.layerCount = 1;
-
-		VK_CHECK_RESULT(vkCreateImage(device, &imageCreateInfo, nullptr, &offscreenPass.depth.image));
-
-		VkMemoryRequirements memReqs;
-		vkGetImageMemoryRequirements(device, offscreenPass.depth.image, &memReqs);
-		
-		VkMemoryAllocateInfo memAlloc = vks::initializers::memoryAllocateInfo();
-		memAlloc.allocationSize = memReqs.size;
-		memAlloc.memoryTypeIndex = vulkanDevice->getMemoryType(memReqs.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
-		VK_CHECK_RESULT(vkAllocateMemory(device, &memAlloc, nullptr, &offscreenPass.depth.mem));
-		VK_CHECK_RESULT(vkBindImageMemory(device, offscreenPass.depth.image, offscreenPass.depth.mem, 0));
-
-		vks::tools::setImageLayout(
-			layoutCmd,
-			offscreenPass.depth.image,
-			VK_IMAGE_ASPECT_DEPTH_BIT | VK_IMAGE_ASPECT_STENCIL_BIT,
-			VK_IMAGE_LAYOUT_UNDEFINED,
-			VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL);
-
-		vulkanDevice->flushCommandBuffer(layoutCmd, queue, true);
-
-		depthStencilView.image = offscreenPass.depth.image;
-		VK_CHECK_RESULT(vkCreateImageView(device, &depthStencilView, nullptr, &offscreenPass.depth.view));
-
-		VkImageView attachments[2];
-		attachments[1] = offscreenPass.depth.view;
-
-		VkFramebufferCreateInfo fbufCreateInfo = vks::initializers::framebufferCreateInfo();
-		fbufCreateInfo.renderPass = offscreenPass.renderPass;
-		fbufCreateInfo.attachmentCount = 2;
-		fbufCreateInfo.pAttachments = attachments;
-		fbufCreateInfo.width = offscreenPass.width;
-		fbufCreateInfo.height = offscreenPass.height;
-		fbufCreateInfo.layers = 1;
-
-		for (uint32_t i = 0; i < 6; i++)
-		{
-			attachments[0] = shadowCubeMapFaceImageViews[i];
-			VK_CHECK_RESULT(vkCreateFramebuffer(device, &fbufCreateInfo, nullptr, &offscreenPass.frameBuffers[i]));
+		// The shadow maps of all lights are sampled from a single cube map array
+		if (deviceFeatures.imageCubeArray) {
+			enabledFeatures.imageCubeArray = VK_TRUE;
+		} else {
+			vks::tools::exitFatal("Selected GPU does not support cube map arrays!", VK_ERROR_FEATURE_NOT_PRESENT);
 		}
 	}
 
-	// Updates a single cube map face
-	// Renders the scene with face's view directly to the cubemap layer `faceIndex`
-	// Uses push constants for quick update of view matrix for the current cube map face
-	void updateCubeFace(uint32_t faceIndex, VkCommandBuffer commandBuffer)
+	// View matrices of the cube map faces, matching the cube map layer order (+X, -X, +Y, -Y, +Z, -Z)
+	glm::mat4 faceViewMatrix(uint32_t faceIndex)
 	{
-		VkClearValue clearValues[2];
-		clearValues[0].color = { { 0.0f, 0.0f, 0.0f, 1.0f } };
-		clearValues[1].depthStencil = { 1.0f, 0 };
-
-		VkRenderPassBeginInfo renderPassBeginInfo = vks::initializers::renderPassBeginInfo();
-		// Reuse render pass from example pass
-		renderPassBeginInfo.renderPass = offscreenPass.renderPass;
-		renderPassBeginInfo.framebuffer = offscreenPass.frameBuffers[faceIndex];
-		renderPassBeginInfo.renderArea.extent.width = offscreenPass.width;
-		renderPassBeginInfo.renderArea.extent.height = offscreenPass.height;
-		renderPassBeginInfo.clearValueCount = 2;
-		renderPassBeginInfo.pClearValues = clearValues;
-
-		// Update view matrix via push constant
-
 		glm::mat4 viewMatrix = glm::mat4(1.0f);
 		switch (faceIndex)
 		{
@@ -375,100 +210,491 @@ public:
 			viewMatrix = glm::rotate(viewMatrix, glm::radians(180.0f), glm::vec3(0.0f, 0.0f, 1.0f));
 			break;
 		}
+		return viewMatrix;
+	}
+
+	// Returns the cube faces of a light a bounding box can be seen from, 0 if the box is out of the light's range
+	uint32_t faceMask(const Light &light, const glm::vec3 &boxMin, const glm::vec3 &boxMax)
+	{
+		const glm::vec3 dMin = boxMin - light.position;
+		const glm::vec3 dMax = boxMax - light.position;
+		// Distance from the light to the box per axis, zero if the light is within the box's extent on that axis
+		const glm::vec3 nearest = glm::max(glm::max(dMin, -dMax), glm::vec3(0.0f));
+		if (glm::length(nearest) > light.range) {
+			return 0;
+		}
+		// A face can see the box if the box has a point within the face's pyramid (|other axes| <= distance along the face axis)
+		uint32_t mask = 0;
+		for (uint32_t axis = 0; axis < 3; axis++) {
+			const float other = std::max(nearest[(axis + 1) % 3], nearest[(axis + 2) % 3]);
+			if ((dMax[axis] > 0.0f) && (dMax[axis] >= other)) {
+				mask |= 1u << (axis * 2);
+			}
+			if ((dMin[axis] < 0.0f) && (-dMin[axis] >= other)) {
+				mask |= 1u << (axis * 2 + 1);
+			}
+		}
+		return mask;
+	}
+
+	void selectShadowMapFormat()
+	{
+		// Depth is compared in the scene shader, so the format needs to be usable as a sampled depth attachment
+		shadowMaps.format = VK_FORMAT_D16_UNORM;
+		VkFormatProperties formatProperties;
+		vkGetPhysicalDeviceFormatProperties(physicalDevice, VK_FORMAT_D32_SFLOAT, &formatProperties);
+		const VkFormatFeatureFlags requiredFeatures = VK_FORMAT_FEATURE_DEPTH_STENCIL_ATTACHMENT_BIT | VK_FORMAT_FEATURE_SAMPLED_IMAGE_BIT | VK_FORMAT_FEATURE_SAMPLED_IMAGE_FILTER_LINEAR_BIT;
+		if ((formatProperties.optimalTilingFeatures & requiredFeatures) == requiredFeatures) {
+			shadowMaps.format = VK_FORMAT_D32_SFLOAT;
+		}
+	}
+
+	void destroyShadowMaps()
+	{
+		for (uint32_t i = 0; i < shadowMaps.lightCount; i++) {
+			vkDestroyFramebuffer(device, shadowMaps.cacheFramebuffers[i], nullptr);
+			vkDestroyFramebuffer(device, shadowMaps.framebuffers[i], nullptr);
+			vkDestroyImageView(device, shadowMaps.cacheViews[i], nullptr);
+			vkDestroyImageView(device, shadowMaps.views[i], nullptr);
+		}
+		vkDestroyImageView(device, shadowMaps.cubeArrayView, nullptr);
+		vkDestroyImage(device, shadowMaps.cacheImage, nullptr);
+		vkFreeMemory(device, shadowMaps.cacheMemory, nullptr);
+		vkDestroyImage(device, shadowMaps.image, nullptr);
+		vkFreeMemory(device, shadowMaps.memory, nullptr);
+	}
+
+	// Only the layers of the active lights are allocated
+	void prepareShadowMaps()
+	{
+		shadowMaps.size = shadowMapSizes[shadowMapSizeIndex];
+		shadowMaps.lightCount = (uint32_t)lightCount;
+		shadowMaps.cacheViews.resize(shadowMaps.lightCount);
+		shadowMaps.cacheFramebuffers.resize(shadowMaps.lightCount);
+		shadowMaps.views.resize(shadowMaps.lightCount);
+		shadowMaps.framebuffers.resize(shadowMaps.lightCount);
+
+		VkImageCreateInfo imageCI = vks::initializers::imageCreateInfo();
+		imageCI.imageType = VK_IMAGE_TYPE_2D;
+		imageCI.format = shadowMaps.format;
+		imageCI.extent = { shadowMaps.size, shadowMaps.size, 1 };
+		imageCI.mipLevels = 1;
+		imageCI.arrayLayers = 6 * shadowMaps.lightCount;
+		imageCI.samples = VK_SAMPLE_COUNT_1_BIT;
+		imageCI.tiling = VK_IMAGE_TILING_OPTIMAL;
+		imageCI.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+		imageCI.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+
+		VkMemoryAllocateInfo memAllocInfo = vks::initializers::memoryAllocateInfo();
+		VkMemoryRequirements memReqs;
+
+		// Static cache
+		imageCI.usage = VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
+		VK_CHECK_RESULT(vkCreateImage(device, &imageCI, nullptr, &shadowMaps.cacheImage));
+		vkGetImageMemoryRequirements(device, shadowMaps.cacheImage, &memReqs);
+		memAllocInfo.allocationSize = memReqs.size;
+		memAllocInfo.memoryTypeIndex = vulkanDevice->getMemoryType(memReqs.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+		VK_CHECK_RESULT(vkAllocateMemory(device, &memAllocInfo, nullptr, &shadowMaps.cacheMemory));
+		VK_CHECK_RESULT(vkBindImageMemory(device, shadowMaps.cacheImage, shadowMaps.cacheMemory, 0));
+
+		// Shadow maps sampled by the scene
+		imageCI.usage = VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
+		imageCI.flags = VK_IMAGE_CREATE_CUBE_COMPATIBLE_BIT;
+		VK_CHECK_RESULT(vkCreateImage(device, &imageCI, nullptr, &shadowMaps.image));
+		vkGetImageMemoryRequirements(device, shadowMaps.image, &memReqs);
+		memAllocInfo.allocationSize = memReqs.size;
+		memAllocInfo.memoryTypeIndex = vulkanDevice->getMemoryType(memReqs.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+		VK_CHECK_RESULT(vkAllocateMemory(device, &memAllocInfo, nullptr, &shadowMaps.memory));
+		VK_CHECK_RESULT(vkBindImageMemory(device, shadowMaps.image, shadowMaps.memory, 0));
+
+		// Lights are rendered before they are sampled for the first time, but all layers need a defined layout
+		VkCommandBuffer layoutCmd = vulkanDevice->createCommandBuffer(VK_COMMAND_BUFFER_LEVEL_PRIMARY, true);
+		VkImageSubresourceRange subresourceRange = { VK_IMAGE_ASPECT_DEPTH_BIT, 0, 1, 0, 6 * shadowMaps.lightCount };
+		vks::tools::setImageLayout(layoutCmd, shadowMaps.image, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, subresourceRange);
+		vulkanDevice->flushCommandBuffer(layoutCmd, queue, true);
+
+		VkImageViewCreateInfo viewCI = vks::initializers::imageViewCreateInfo();
+		viewCI.format = shadowMaps.format;
+		viewCI.subresourceRange = { VK_IMAGE_ASPECT_DEPTH_BIT, 0, 1, 0, 6 * shadowMaps.lightCount };
+		viewCI.viewType = VK_IMAGE_VIEW_TYPE_CUBE_ARRAY;
+		viewCI.image = shadowMaps.image;
+		VK_CHECK_RESULT(vkCreateImageView(device, &viewCI, nullptr, &shadowMaps.cubeArrayView));
+
+		// The six layers of each light are the views of its multiview framebuffer
+		VkFramebufferCreateInfo framebufferCI = vks::initializers::framebufferCreateInfo();
+		framebufferCI.renderPass = shadowMaps.staticPass;
+		framebufferCI.attachmentCount = 1;
+		framebufferCI.width = shadowMaps.size;
+		framebufferCI.height = shadowMaps.size;
+		framebufferCI.layers = 1;
+		viewCI.viewType = VK_IMAGE_VIEW_TYPE_2D_ARRAY;
+		viewCI.subresourceRange.layerCount = 6;
+		for (uint32_t i = 0; i < shadowMaps.lightCount; i++) {
+			viewCI.subresourceRange.baseArrayLayer = i * 6;
+			viewCI.image = shadowMaps.cacheImage;
+			VK_CHECK_RESULT(vkCreateImageView(device, &viewCI, nullptr, &shadowMaps.cacheViews[i]));
+			viewCI.image = shadowMaps.image;
+			VK_CHECK_RESULT(vkCreateImageView(device, &viewCI, nullptr, &shadowMaps.views[i]));
+			framebufferCI.pAttachments = &shadowMaps.cacheViews[i];
+			VK_CHECK_RESULT(vkCreateFramebuffer(device, &framebufferCI, nullptr, &shadowMaps.cacheFramebuffers[i]));
+			framebufferCI.pAttachments = &shadowMaps.views[i];
+			VK_CHECK_RESULT(vkCreateFramebuffer(device, &framebufferCI, nullptr, &shadowMaps.framebuffers[i]));
+		}
+	}
+
+	void prepareShadowMapSamplers()
+	{
+		// Hardware depth comparison with filtering for the scene, plain sampling for the cube map display
+		VkSamplerCreateInfo samplerCI = vks::initializers::samplerCreateInfo();
+		samplerCI.magFilter = VK_FILTER_LINEAR;
+		samplerCI.minFilter = VK_FILTER_LINEAR;
+		samplerCI.mipmapMode = VK_SAMPLER_MIPMAP_MODE_NEAREST;
+		samplerCI.addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+		samplerCI.addressModeV = samplerCI.addressModeU;
+		samplerCI.addressModeW = samplerCI.addressModeU;
+		samplerCI.maxAnisotropy = 1.0f;
+		samplerCI.minLod = 0.0f;
+		samplerCI.maxLod = 1.0f;
+		samplerCI.borderColor = VK_BORDER_COLOR_FLOAT_OPAQUE_WHITE;
+		samplerCI.compareEnable = VK_TRUE;
+		samplerCI.compareOp = VK_COMPARE_OP_LESS_OR_EQUAL;
+		VK_CHECK_RESULT(vkCreateSampler(device, &samplerCI, nullptr, &shadowMaps.compareSampler));
+		samplerCI.compareEnable = VK_FALSE;
+		samplerCI.magFilter = VK_FILTER_NEAREST;
+		samplerCI.minFilter = VK_FILTER_NEAREST;
+		VK_CHECK_RESULT(vkCreateSampler(device, &samplerCI, nullptr, &shadowMaps.sampler));
+	}
+
+	// Depth only multiview render passes writing all six faces of a light at once
+	// The static pass clears the cache, the dynamic pass loads the copied cache and adds the dynamic casters
+	void prepareShadowRenderPasses()
+	{
+		VkAttachmentDescription attachment = {};
+		attachment.format = shadowMaps.format;
+		attachment.samples = VK_SAMPLE_COUNT_1_BIT;
+		attachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+		attachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+		attachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
 
-		// Render scene from cube face's point of view
-		vkCmdBeginRenderPass(commandBuffer, &renderPassBeginInfo, VK_SUBPASS_CONTENTS_INLINE);
+		VkAttachmentReference depthReference = { 0, VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL };
 
-		// Update shader push constant block
-		// Contains current face view matrix
-		vkCmdPushConstants(
-			commandBuffer,
-			pipelineLayouts.offscreen,
-			VK_SHADER_STAGE_VERTEX_BIT,
-			0,
-			sizeof(glm::mat4),
-			&viewMatrix);
+		VkSubpassDescription subpass = {};
+		subpass.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
+		subpass.pDepthStencilAttachment = &depthReference;
 
-		vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelines.offscreen);
-		vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayouts.offscreen, 0, 1, &descriptorSets.offscreen, 0, NULL);
-		models.scene.draw(commandBuffer);
+		// The static cache may still be read by a copy of the previous frame
+		VkSubpassDependency dependency = {};
+		dependency.srcSubpass = VK_SUBPASS_EXTERNAL;
+		dependency.dstSubpass = 0;
+		dependency.srcStageMask = VK_PIPELINE_STAGE_TRANSFER_BIT;
+		dependency.dstStageMask = VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT;
+		dependency.srcAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+		dependency.dstAccessMask = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+
+		// Each bit of the view mask renders to one layer of the attachment, gl_ViewIndex selects the face
+		const uint32_t viewMask = 0x3F;
+		const uint32_t correlationMask = 0x3F;
+		VkRenderPassMultiviewCreateInfo renderPassMultiviewCI{};
+		renderPassMultiviewCI.sType = VK_STRUCTURE_TYPE_RENDER_PASS_MULTIVIEW_CREATE_INFO;
+		renderPassMultiviewCI.subpassCount = 1;
+		renderPassMultiviewCI.pViewMasks = &viewMask;
+		renderPassMultiviewCI.correlationMaskCount = 1;
+		renderPassMultiviewCI.pCorrelationMasks = &correlationMask;
+
+		VkRenderPassCreateInfo renderPassCI = vks::initializers::renderPassCreateInfo();
+		renderPassCI.attachmentCount = 1;
+		renderPassCI.pAttachments = &attachment;
+		renderPassCI.subpassCount = 1;
+		renderPassCI.pSubpasses = &subpass;
+		renderPassCI.dependencyCount = 1;
+		renderPassCI.pDependencies = &dependency;
+		renderPassCI.pNext = &renderPassMultiviewCI;
+
+		attachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+		attachment.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+		attachment.finalLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+		VK_CHECK_RESULT(vkCreateRenderPass(device, &renderPassCI, nullptr, &shadowMaps.staticPass));
+
+		// Ordering against the copy into the shadow map is done with barriers in the command buffer
+		renderPassCI.dependencyCount = 0;
+		attachment.loadOp = VK_ATTACHMENT_LOAD_OP_LOAD;
+		attachment.initialLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+		attachment.finalLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+		VK_CHECK_RESULT(vkCreateRenderPass(device, &renderPassCI, nullptr, &shadowMaps.dynamicPass));
+	}
 
-		vkCmdEndRenderPass(commandBuffer);
+	// Light positions, dynamic casters and the faces they affect are updated on the host before recording
+	void updateLights()
+	{
+		const glm::vec3 sceneMin = models.scene.dimensions.min;
+		const glm::vec3 sceneMax = models.scene.dimensions.max;
+
+		for (int32_t i = 0; i < lightCount; i++) {
+			Light &light = lights[i];
+			glm::vec3 position;
+			if (i == 0) {
+				// Light in the center of the scene
+				position = glm::vec3(sin(glm::radians(timer * 360.0f)) * 0.15f, -2.5f, cos(glm::radians(timer * 360.0f)) * 0.15f);
+			} else {
+				// Remaining lights are distributed on rings around it, optionally rotating
+				const float angle = glm::radians(360.0f * (float)(i - 1) / (float)std::max(lightCount - 1, 1) + (animateLights ? timer * 360.0f : 0.0f));
+				const float radius = (i % 2 == 0) ? 5.0f : 3.5f;
+				position = glm::vec3(sin(angle) * radius, (i % 2 == 0) ? -1.5f : -2.5f, cos(angle) * radius);
+			}
+			if ((position != light.position) || !cacheStaticShadows) {
+				light.position = position;
+				light.staticDirty = true;
+			}
+			light.range = (i == 0) ? 12.0f : 6.0f;
+			light.color = (i == 0) ? glm::vec3(1.0f) : glm::vec3(0.5f + 0.5f * sin((float)i), 0.5f + 0.5f * sin((float)i + 2.0f), 0.5f + 0.5f * sin((float)i + 4.0f));
+			light.staticFaceMask = faceMask(light, sceneMin, sceneMax);
+
+			UBOLight &uboLight = uboLights[i];
+			const glm::mat4 projection = glm::perspective((float)(M_PI / 2.0), 1.0f, SHADOW_NEAR_PLANE, light.range);
+			const glm::mat4 model = glm::translate(glm::mat4(1.0f), -light.position);
+			for (uint32_t face = 0; face < 6; face++) {
+				uboLight.faceViewProjection[face] = projection * faceViewMatrix(face) * model;
+			}
+			uboLight.position = glm::vec4(light.position, light.range);
+			uboLight.color = glm::vec4(light.color, 1.0f);
+		}
+		memcpy(uniformBuffers.lights.mapped, uboLights.data(), sizeof(UBOLight) * lightCount);
 	}
 
-	void buildCommandBuffers()
+	void updateCasters()
+	{
+		castersMoved = animateCasters || castersMoved;
+		if (!castersMoved) {
+			return;
+		}
+		// Small cubes orbiting the center light
+		const float scale = 0.15f;
+		for (uint32_t i = 0; i < DYNAMIC_CASTER_COUNT; i++) {
+			const float angle = glm::radians(360.0f * (float)i / (float)DYNAMIC_CASTER_COUNT + timer * 360.0f);
+			const float radius = 1.25f + 0.5f * (float)(i % 2);
+			casters[i].center = glm::vec3(sin(angle) * radius, -1.25f - 0.5f * (float)(i % 3), cos(angle) * radius);
+			casters[i].model = glm::translate(glm::mat4(1.0f), casters[i].center);
+			casters[i].model = glm::rotate(casters[i].model, angle * 2.0f, glm::vec3(0.0f, 1.0f, 0.0f));
+			casters[i].model = glm::scale(casters[i].model, glm::vec3(scale));
+			casters[i].radius = models.debugcube.dimensions.radius * scale;
+		}
+	}
+
+	void buildCommandBuffer(uint32_t index)
 	{
+		VkCommandBuffer commandBuffer = drawCmdBuffers[index];
 		VkCommandBufferBeginInfo cmdBufInfo = vks::initializers::commandBufferBeginInfo();
+		VK_CHECK_RESULT(vkBeginCommandBuffer(commandBuffer, &cmdBufInfo));
 
-		for (int32_t i = 0; i < drawCmdBuffers.size(); ++i)
-		{
-			VK_CHECK_RESULT(vkBeginCommandBuffer(drawCmdBuffers[i], &cmdBufInfo));
+		statistics = Statistics();
 
-			/*
-				Generate shadow cube maps using one render pass per face
-			*/
-			{
-				VkViewport viewport = vks::initializers::viewport((float)offscreenPass.width, (float)offscreenPass.height, 0.0f, 1.0f);
-				vkCmdSetViewport(drawCmdBuffers[i], 0, 1, &viewport);
+		/*
+			Shadow cube maps
+		*/
+		{
+			VkViewport viewport = vks::initializers::viewport((float)shadowMaps.size, (float)shadowMaps.size, 0.0f, 1.0f);
+			vkCmdSetViewport(commandBuffer, 0, 1, &viewport);
+			VkRect2D scissor = vks::initializers::rect2D(shadowMaps.size, shadowMaps.size, 0, 0);
+			vkCmdSetScissor(commandBuffer, 0, 1, &scissor);
+			vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelines.shadow);
+			vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 0, 1, &descriptorSet, 0, nullptr);
+
+			VkClearValue clearValue;
+			clearValue.depthStencil = { 1.0f, 0 };
+			VkRenderPassBeginInfo renderPassBeginInfo = vks::initializers::renderPassBeginInfo();
+			renderPassBeginInfo.renderArea.extent = { shadowMaps.size, shadowMaps.size };
+
+			// Dynamic casters affecting each light
+			std::vector<std::array<uint32_t, DYNAMIC_CASTER_COUNT>> casterMasks(lightCount);
+			std::vector<bool> composite(lightCount, false);
+			std::vector<bool> dynamic(lightCount, false);
+			for (int32_t i = 0; i < lightCount; i++) {
+				for (uint32_t c = 0; c < DYNAMIC_CASTER_COUNT; c++) {
+					casterMasks[i][c] = faceMask(lights[i], casters[c].center - glm::vec3(casters[c].radius), casters[c].center + glm::vec3(casters[c].radius));
+					dynamic[i] = dynamic[i] || (casterMasks[i][c] != 0);
+				}
+				// The shadow map only has to be composited again if anything in it changed
+				composite[i] = lights[i].staticDirty || (castersMoved && (dynamic[i] || lights[i].dynamicLastFrame));
+			}
 
-				VkRect2D scissor = vks::initializers::rect2D(offscreenPass.width, offscreenPass.height, 0, 0);
-				vkCmdSetScissor(drawCmdBuffers[i], 0, 1, &scissor);
+			// Static geometry of lights that changed
+			renderPassBeginInfo.renderPass = shadowMaps.staticPass;
+			renderPassBeginInfo.clearValueCount = 1;
+			renderPassBeginInfo.pClearValues = &clearValue;
+			for (int32_t i = 0; i < lightCount; i++) {
+				if (!lights[i].staticDirty) {
+					continue;
+				}
+				renderPassBeginInfo.framebuffer = shadowMaps.cacheFramebuffers[i];
+				vkCmdBeginRenderPass(commandBuffer, &renderPassBeginInfo, VK_SUBPASS_CONTENTS_INLINE);
+				if (lights[i].staticFaceMask != 0) {
+					PushConsts pushConsts{ glm::mat4(1.0f), (uint32_t)i, lights[i].staticFaceMask };
+					vkCmdPushConstants(commandBuffer, pipelineLayout, VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT, 0, sizeof(PushConsts), &pushConsts);
+					models.scene.draw(commandBuffer);
+				}
+				vkCmdEndRenderPass(commandBuffer);
+				statistics.staticUpdates++;
+			}
 
-				for (uint32_t face = 0; face < 6; face++) {
-					updateCubeFace(face, drawCmdBuffers[i]);
+			// Copy the cached static depth into the shadow maps that need to be composited
+			std::vector<VkImageMemoryBarrier> barriers;
+			VkImageMemoryBarrier barrier = vks::initializers::imageMemoryBarrier();
+			barrier.subresourceRange = { VK_IMAGE_ASPECT_DEPTH_BIT, 0, 1, 0, 6 };
+			for (int32_t i = 0; i < lightCount; i++) {
+				barrier.subresourceRange.baseArrayLayer = i * 6;
+				if (lights[i].staticDirty) {
+					barrier.image = shadowMaps.cacheImage;
+					barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+					barrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+					barrier.srcAccessMask = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+					barrier.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+					barriers.push_back(barrier);
 				}
+				if (composite[i]) {
+					barrier.image = shadowMaps.image;
+					barrier.oldLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+					barrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+					barrier.srcAccessMask = VK_ACCESS_SHADER_READ_BIT;
+					barrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+					barriers.push_back(barrier);
+				}
+			}
+			if (!barriers.empty()) {
+				vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 0, nullptr, static_cast<uint32_t>(barriers.size()), barriers.data());
+			}
+			for (int32_t i = 0; i < lightCount; i++) {
+				if (!composite[i]) {
+					continue;
+				}
+				VkImageCopy copyRegion = {};
+				copyRegion.srcSubresource = { VK_IMAGE_ASPECT_DEPTH_BIT, 0, (uint32_t)i * 6, 6 };
+				copyRegion.dstSubresource = copyRegion.srcSubresource;
+				copyRegion.extent = { shadowMaps.size, shadowMaps.size, 1 };
+				vkCmdCopyImage(commandBuffer, shadowMaps.cacheImage, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, shadowMaps.image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &copyRegion);
+				statistics.composites++;
 			}
 
-			/*
-				Note: Explicit synchronization is not required between the render pass, as this is done implicit via sub pass dependencies
-			*/
+			// Shadow maps with dynamic casters are rendered to next, the others can be sampled right away
+			barriers.clear();
+			barrier.image = shadowMaps.image;
+			barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+			barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+			for (int32_t i = 0; i < lightCount; i++) {
+				if (!composite[i]) {
+					continue;
+				}
+				barrier.subresourceRange.baseArrayLayer = i * 6;
+				barrier.newLayout = dynamic[i] ? VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL : VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+				barrier.dstAccessMask = dynamic[i] ? (VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT) : VK_ACCESS_SHADER_READ_BIT;
+				barriers.push_back(barrier);
+			}
+			if (!barriers.empty()) {
+				vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0, 0, nullptr, 0, nullptr, static_cast<uint32_t>(barriers.size()), barriers.data());
+			}
 
-			/*
-				Scene rendering with applied shadow map
-			*/
-			{
-				VkClearValue clearValues[2];
-				clearValues[0].color = defaultClearColor;
-				clearValues[1].depthStencil = { 1.0f, 0 };
-
-				VkRenderPassBeginInfo renderPassBeginInfo = vks::initializers::renderPassBeginInfo();
-				renderPassBeginInfo.renderPass = renderPass;
-				renderPassBeginInfo.framebuffer = frameBuffers[i];
-				renderPassBeginInfo.renderArea.extent.width = width;
-				renderPassBeginInfo.renderArea.extent.height = height;
-				renderPassBeginInfo.clearValueCount = 2;
-				renderPassBeginInfo.pClearValues = clearValues;
-
-				vkCmdBeginRenderPass(drawCmdBuffers[i], &renderPassBeginInfo, VK_SUBPASS_CONTENTS_INLINE);
-
-				VkViewport viewport = vks::initializers::viewport((float)width, (float)height, 0.0f, 1.0f);
-				vkCmdSetViewport(drawCmdBuffers[i], 0, 1, &viewport);
-
-				VkRect2D scissor = vks::initializers::rect2D(width, height, 0, 0);
-				vkCmdSetScissor(drawCmdBuffers[i], 0, 1, &scissor);
-
-				vkCmdBindDescriptorSets(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayouts.scene, 0, 1, &descriptorSets.scene, 0, NULL);
-
-				if (displayCubeMap)
-				{
-					// Display all six sides of the shadow cube map
-					// Note: Visualization of the different faces is done in the fragment shader, see cubemapdisplay.frag
-					vkCmdBindPipeline(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pipelines.cubemapDisplay);
-					models.debugcube.draw(drawCmdBuffers[i]);
+			// Dynamic casters on top of the static depth
+			renderPassBeginInfo.renderPass = shadowMaps.dynamicPass;
+			renderPassBeginInfo.clearValueCount = 0;
+			renderPassBeginInfo.pClearValues = nullptr;
+			barriers.clear();
+			for (int32_t i = 0; i < lightCount; i++) {
+				if (!composite[i] || !dynamic[i]) {
+					continue;
+				}
+				renderPassBeginInfo.framebuffer = shadowMaps.framebuffers[i];
+				vkCmdBeginRenderPass(commandBuffer, &renderPassBeginInfo, VK_SUBPASS_CONTENTS_INLINE);
+				for (uint32_t c = 0; c < DYNAMIC_CASTER_COUNT; c++) {
+					if (casterMasks[i][c] == 0) {
+						continue;
+					}
+					PushConsts pushConsts{ casters[c].model, (uint32_t)i, casterMasks[i][c] };
+					vkCmdPushConstants(commandBuffer, pipelineLayout, VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT, 0, sizeof(PushConsts), &pushConsts);
+					models.debugcube.draw(commandBuffer);
+					statistics.dynamicDraws++;
+					for (uint32_t face = 0; face < 6; face++) {
+						statistics.culledFaces += ((casterMasks[i][c] & (1u << face)) == 0) ? 1 : 0;
+					}
 				}
-				else
-				{
-					vkCmdBindPipeline(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pipelines.scene);
-					models.scene.draw(drawCmdBuffers[i]);
+				vkCmdEndRenderPass(commandBuffer);
+				barrier.subresourceRange.baseArrayLayer = i * 6;
+				barrier.oldLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+				barrier.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+				barrier.srcAccessMask = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+				barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+				barriers.push_back(barrier);
+			}
+			if (!barriers.empty()) {
+				vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0, 0, nullptr, 0, nullptr, static_cast<uint32_t>(barriers.size()), barriers.data());
+			}
+
+			for (int32_t i = 0; i < lightCount; i++) {
+				if (composite[i]) {
+					lights[i].dynamicLastFrame = dynamic[i];
 				}
+				lights[i].staticDirty = false;
+			}
+			castersMoved = false;
+		}
+
+		/*
+			Scene rendering with applied shadow maps
+		*/
+		{
+			VkClearValue clearValues[2];
+			clearValues[0].color = defaultClearColor;
+			clearValues[1].depthStencil = { 1.0f, 0 };
+
+			VkRenderPassBeginInfo renderPassBeginInfo = vks::initializers::renderPassBeginInfo();
+			renderPassBeginInfo.renderPass = renderPass;
+			renderPassBeginInfo.framebuffer = frameBuffers[index];
+			renderPassBeginInfo.renderArea.extent.width = width;
+			renderPassBeginInfo.renderArea.extent.height = height;
+			renderPassBeginInfo.clearValueCount = 2;
+			renderPassBeginInfo.pClearValues = clearValues;
+
+			vkCmdBeginRenderPass(commandBuffer, &renderPassBeginInfo, VK_SUBPASS_CONTENTS_INLINE);
 
-				drawUI(drawCmdBuffers[i]);
+			VkViewport viewport = vks::initializers::viewport((float)width, (float)height, 0.0f, 1.0f);
+			vkCmdSetViewport(commandBuffer, 0, 1, &viewport);
 
-				vkCmdEndRenderPass(drawCmdBuffers[i]);
+			VkRect2D scissor = vks::initializers::rect2D(width, height, 0, 0);
+			vkCmdSetScissor(commandBuffer, 0, 1, &scissor);
+
+			vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 0, 1, &descriptorSet, 0, NULL);
+
+			if (displayCubeMap)
+			{
+				// Display all six sides of the selected light's shadow cube map
+				// Note: Visualization of the different faces is done in the fragment shader, see cubemapdisplay.frag
+				PushConsts pushConsts{ glm::mat4(1.0f), (uint32_t)std::min(displayLight, lightCount - 1), 0x3F };
+				vkCmdPushConstants(commandBuffer, pipelineLayout, VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT, 0, sizeof(PushConsts), &pushConsts);
+				vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelines.cubemapDisplay);
+				vkCmdDraw(commandBuffer, 3, 1, 0, 0);
+			}
+			else
+			{
+				vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelines.scene);
+				PushConsts pushConsts{ glm::mat4(1.0f), 0, 0x3F };
+				vkCmdPushConstants(commandBuffer, pipelineLayout, VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT, 0, sizeof(PushConsts), &pushConsts);
+				models.scene.draw(commandBuffer);
+				for (uint32_t c = 0; c < DYNAMIC_CASTER_COUNT; c++) {
+					pushConsts.model = casters[c].model;
+					vkCmdPushConstants(commandBuffer, pipelineLayout, VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT, 0, sizeof(PushConsts), &pushConsts);
+					models.debugcube.draw(commandBuffer);
+				}
 			}
 
-			VK_CHECK_RESULT(vkEndCommandBuffer(drawCmdBuffers[i]));
+			drawUI(commandBuffer);
+
+			vkCmdEndRenderPass(commandBuffer);
 		}
+
+		VK_CHECK_RESULT(vkEndCommandBuffer(commandBuffer));
+	}
+
+	// Lights and casters change every frame, so the command buffer of the current frame is recorded again in draw
+	void buildCommandBuffers()
+	{
 	}
 
 	void loadAssets()
@@ -480,123 +706,57 @@ public:
 
 	void setupDescriptorPool()
 	{
-		// Example uses three ubos and two image samplers
 		std::vector<VkDescriptorPoolSize> poolSizes = {
-			vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 3),
+			vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 2),
 			vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 2)
 		};
-		VkDescriptorPoolCreateInfo descriptorPoolInfo = vks::initializers::descriptorPoolCreateInfo(poolSizes.size(), poolSizes.data(), 3);
+		VkDescriptorPoolCreateInfo descriptorPoolInfo = vks::initializers::descriptorPoolCreateInfo(poolSizes.size(), poolSizes.data(), 1);
 		VK_CHECK_RESULT(vkCreateDescriptorPool(device, &descriptorPoolInfo, nullptr, &descriptorPool));
 	}
 
 	void setupDescriptorSetLayout()
 	{
-		// Shared pipeline layout
+		// Shared by all pipelines
 		std::vector<VkDescriptorSetLayoutBinding> setLayoutBindings = {
-			// Binding 0 : Vertex shader uniform buffer
-			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, VK_SHADER_STAGE_VERTEX_BIT, 0),
-			// Binding 1 : Fragment shader image sampler (cube map)
-			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_FRAGMENT_BIT, 1)
+			// Binding 0 : Scene uniform buffer
+			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT, 0),
+			// Binding 1 : Shadow cube map array with depth comparison
+			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_FRAGMENT_BIT, 1),
+			// Binding 2 : Light uniform buffer with the face matrices of all lights
+			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT, 2),
+			// Binding 3 : Shadow cube map array without comparison (cube map display)
+			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_FRAGMENT_BIT, 3),
 		};
 
 		VkDescriptorSetLayoutCreateInfo descriptorLayout = vks::initializers::descriptorSetLayoutCreateInfo(setLayoutBindings.data(), setLayoutBindings.size());
 		VK_CHECK_RESULT(vkCreateDescriptorSetLayout(device, &descriptorLayout, nullptr, &descriptorSetLayout));
 
-		// 3D scene pipeline layout
-		VkPipelineLayoutCreateInfo pPipelineLayoutCreateInfo = vks::initializers::pipelineLayoutCreateInfo(&descriptorSetLayout, 1);
-		VK_CHECK_RESULT(vkCreatePipelineLayout(device, &pPipelineLayoutCreateInfo, nullptr, &pipelineLayouts.scene));
-
-		// Offscreen pipeline layout
-		// Push constants for cube map face view matrices
-		VkPushConstantRange pushConstantRange = vks::initializers::pushConstantRange(VK_SHADER_STAGE_VERTEX_BIT, sizeof(glm::mat4), 0);
-		// Push constant ranges are part of the pipeline layout
-		pPipelineLayoutCreateInfo.pushConstantRangeCount = 1;
-		pPipelineLayoutCreateInfo.pPushConstantRanges = &pushConstantRange;
-		VK_CHECK_RESULT(vkCreatePipelineLayout(device, &pPipelineLayoutCreateInfo, nullptr, &pipelineLayouts.offscreen));
+		// Push constants for the model matrix, the light and the face mask of a draw
+		VkPushConstantRange pushConstantRange = vks::initializers::pushConstantRange(VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT, sizeof(PushConsts), 0);
+		VkPipelineLayoutCreateInfo pipelineLayoutCreateInfo = vks::initializers::pipelineLayoutCreateInfo(&descriptorSetLayout, 1);
+		pipelineLayoutCreateInfo.pushConstantRangeCount = 1;
+		pipelineLayoutCreateInfo.pPushConstantRanges = &pushConstantRange;
+		VK_CHECK_RESULT(vkCreatePipelineLayout(device, &pipelineLayoutCreateInfo, nullptr, &pipelineLayout));
 	}
 
 	void setupDescriptorSets()
 	{
 		VkDescriptorSetAllocateInfo allocInfo = vks::initializers::descriptorSetAllocateInfo(descriptorPool, &descriptorSetLayout, 1);
-
-		// 3D scene
-		VK_CHECK_RESULT(vkAllocateDescriptorSets(device, &allocInfo, &descriptorSets.scene));
-		// Image descriptor for the cube map
-		VkDescriptorImageInfo texDescriptor =
-			vks::initializers::descriptorImageInfo(
-				shadowCubeMap.sampler,
-				shadowCubeMap.view,
-				VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
-
-		std::vector<VkWriteDescriptorSet> sceneDescriptorSets = {
-			// Binding 0 : Vertex shader uniform buffer
-			vks::initializers::writeDescriptorSet(descriptorSets.scene, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 0, &uniformBuffers.scene.descriptor),
-			// Binding 1 : Fragment shader shadow sampler
-			vks::initializers::writeDescriptorSet(descriptorSets.scene, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 1, &texDescriptor)
-		};
-		vkUpdateDescriptorSets(device, sceneDescriptorSets.size(), sceneDescriptorSets.data(), 0, NULL);
-
-		// Offscreen
-		VK_CHECK_RESULT(vkAllocateDescriptorSets(device, &allocInfo, &descriptorSets.offscreen));
-		std::vector<VkWriteDescriptorSet> offScreenWriteDescriptorSets = {
-			// Binding 0 : Vertex shader uniform buffer
-			vks::initializers::writeDescriptorSet(descriptorSets.offscreen, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 0, &uniformBuffers.offscreen.descriptor),
-		};
-		vkUpdateDescriptorSets(device, offScreenWriteDescriptorSets.size(), offScreenWriteDescriptorSets.data(), 0, NULL);
+		VK_CHECK_RESULT(vkAllocateDescriptorSets(device, &allocInfo, &descriptorSet));
+		updateDescriptorSets();
 	}
 
-	// Set up a separate render pass for the offscreen frame buffer
-	// This is necessary as the offscreen frame buffer attachments
-	// use formats different to the ones from the visible frame buffer
-	// and at least the depth one may not be compatible
-	void prepareOffscreenRenderpass()
+	void updateDescriptorSets()
 	{
-		VkAttachmentDescription osAttachments[2] = {};
-
-		// Find a suitable depth format
-		VkBool32 validDepthFormat = vks::tools::getSupportedDepthFormat(physicalDevice, &fbDepthFormat);
-		assert(validDepthFormat);
-
-		osAttachments[0].format = FB_COLOR_FORMAT;
-		osAttachments[0].samples = VK_SAMPLE_COUNT_1_BIT;
-		osAttachments[0].loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
-		osAttachments[0].storeOp = VK_ATTACHMENT_STORE_OP_STORE;
-		osAttachments[0].stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
-		osAttachments[0].stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
-		osAttachments[0].initialLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
-		osAttachments[0].finalLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
-
-		// Depth attachment
-		osAttachments[1].format = fbDepthFormat;
-		osAttachments[1].samples = VK_SAMPLE_COUNT_1_BIT;
-		osAttachments[1].loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
-		osAttachments[1].storeOp = VK_ATTACHMENT_STORE_OP_STORE;
-		osAttachments[1].stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
-		osAttachments[1].stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
-		osAttachments[1].initialLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
-		osAttachments[1].finalLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
-
-		VkAttachmentReference colorReference = {};
-		colorReference.attachment = 0;
-		colorReference.layout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
-
-		VkAttachmentReference depthReference = {};
-		depthReference.attachment = 1;
-		depthReference.layout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
-
-		VkSubpassDescription subpass = {};
-		subpass.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
-		subpass.colorAttachmentCount = 1;
-		subpass.pColorAttachments = &colorReference;
-		subpass.pDepthStencilAttachment = &depthReference;
-
-		VkRenderPassCreateInfo renderPassCreateInfo = vks::initializers::renderPassCreateInfo();
-		renderPassCreateInfo.attachmentCount = 2;
-		renderPassCreateInfo.pAttachments = osAttachments;
-		renderPassCreateInfo.subpassCount = 1;
-		renderPassCreateInfo.pSubpasses = &subpass;
-
-		VK_CHECK_RESULT(vkCreateRenderPass(device, &renderPassCreateInfo, nullptr, &offscreenPass.renderPass));
+		VkDescriptorImageInfo shadowDescriptor = vks::initializers::descriptorImageInfo(shadowMaps.compareSampler, shadowMaps.cubeArrayView, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+		VkDescriptorImageInfo displayDescriptor = vks::initializers::descriptorImageInfo(shadowMaps.sampler, shadowMaps.cubeArrayView, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+		std::vector<VkWriteDescriptorSet> writeDescriptorSets = {
+			vks::initializers::writeDescriptorSet(descriptorSet, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 0, &uniformBuffers.scene.descriptor),
+			vks::initializers::writeDescriptorSet(descriptorSet, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 1, &shadowDescriptor),
+			vks::initializers::writeDescriptorSet(descriptorSet, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 2, &uniformBuffers.lights.descriptor),
+			vks::initializers::writeDescriptorSet(descriptorSet, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 3, &displayDescriptor),
+		};
+		vkUpdateDescriptorSets(device, writeDescriptorSets.size(), writeDescriptorSets.data(), 0, NULL);
 	}
 
 	void preparePipelines()
@@ -618,7 +778,7 @@ public:
 		shaderStages[0] = loadShader(getShadersPath() + "shadowmappingomni/scene.vert.spv", VK_SHADER_STAGE_VERTEX_BIT);
 		shaderStages[1] = loadShader(getShadersPath() + "shadowmappingomni/scene.frag.spv", VK_SHADER_STAGE_FRAGMENT_BIT);
 
-		VkGraphicsPipelineCreateInfo pipelineCI = vks::initializers::pipelineCreateInfo(pipelineLayouts.scene, renderPass, 0);
+		VkGraphicsPipelineCreateInfo pipelineCI = vks::initializers::pipelineCreateInfo(pipelineLayout, renderPass, 0);
 		pipelineCI.pInputAssemblyState = &inputAssemblyState;
 		pipelineCI.pRasterizationState = &rasterizationState;
 		pipelineCI.pColorBlendState = &colorBlendState;
@@ -631,72 +791,64 @@ public:
 		pipelineCI.pVertexInputState = vkglTF::Vertex::getPipelineVertexInputState({vkglTF::VertexComponent::Position, vkglTF::VertexComponent::Color, vkglTF::VertexComponent::Normal});
 		VK_CHECK_RESULT(vkCreateGraphicsPipelines(device, pipelineCache, 1, &pipelineCI, nullptr, &pipelines.scene));
 
-		// Offscreen pipeline
-		shaderStages[0] = loadShader(getShadersPath() + "shadowmappingomni/offscreen.vert.spv", VK_SHADER_STAGE_VERTEX_BIT);
-		shaderStages[1] = loadShader(getShadersPath() + "shadowmappingomni/offscreen.frag.spv", VK_SHADER_STAGE_FRAGMENT_BIT);
-		pipelineCI.layout = pipelineLayouts.offscreen;
-		pipelineCI.renderPass = offscreenPass.renderPass;
-		VK_CHECK_RESULT(vkCreateGraphicsPipelines(device, pipelineCache, 1, &pipelineCI, nullptr, &pipelines.offscreen));
-
 		// Cube map display pipeline
 		shaderStages[0] = loadShader(getShadersPath() + "shadowmappingomni/cubemapdisplay.vert.spv", VK_SHADER_STAGE_VERTEX_BIT);
 		shaderStages[1] = loadShader(getShadersPath() + "shadowmappingomni/cubemapdisplay.frag.spv", VK_SHADER_STAGE_FRAGMENT_BIT);
 		VkPipelineVertexInputStateCreateInfo emptyInputState = vks::initializers::pipelineVertexInputStateCreateInfo();
 		pipelineCI.pVertexInputState = &emptyInputState;
-		pipelineCI.layout = pipelineLayouts.scene;
-		pipelineCI.renderPass = renderPass;
 		rasterizationState.cullMode = VK_CULL_MODE_NONE;
 		VK_CHECK_RESULT(vkCreateGraphicsPipelines(device, pipelineCache, 1, &pipelineCI, nullptr, &pipelines.cubemapDisplay));
+
+		// Multiview shadow pipeline, depth only without a fragment shader
+		shaderStages[0] = loadShader(getShadersPath() + "shadowmappingomni/offscreen.vert.spv", VK_SHADER_STAGE_VERTEX_BIT);
+		pipelineCI.stageCount = 1;
+		pipelineCI.pVertexInputState = vkglTF::Vertex::getPipelineVertexInputState({vkglTF::VertexComponent::Position});
+		pipelineCI.renderPass = shadowMaps.staticPass;
+		colorBlendState.attachmentCount = 0;
+		rasterizationState.cullMode = VK_CULL_MODE_BACK_BIT;
+		VK_CHECK_RESULT(vkCreateGraphicsPipelines(device, pipelineCache, 1, &pipelineCI, nullptr, &pipelines.shadow));
 	}
 
 	// Prepare and initialize uniform buffer containing shader uniforms
 	void prepareUniformBuffers()
 	{
-		// Offscreen vertex shader uniform buffer
 		VK_CHECK_RESULT(vulkanDevice->createBuffer(
 			VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
 			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
-			&uniformBuffers.offscreen,
-			sizeof(uboOffscreenVS)));
+			&uniformBuffers.scene,
+			sizeof(uboScene)));
 
-		// Scene vertex shader uniform buffer
 		VK_CHECK_RESULT(vulkanDevice->createBuffer(
 			VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
 			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
-			&uniformBuffers.scene,
-			sizeof(uboVSscene)));
+			&uniformBuffers.lights,
+			sizeof(UBOLight) * MAX_LIGHTS));
 
 		// Map persistent
-		VK_CHECK_RESULT(uniformBuffers.offscreen.map());
 		VK_CHECK_RESULT(uniformBuffers.scene.map());
+		VK_CHECK_RESULT(uniformBuffers.lights.map());
 
-		updateUniformBufferOffscreen();
 		updateUniformBuffers();
 	}
 
 	void updateUniformBuffers()
 	{
-		uboVSscene.projection = camera.matrices.perspective;
-		uboVSscene.view = camera.matrices.view;
-		uboVSscene.model = glm::mat4(1.0f);
-		uboVSscene.lightPos = lightPos;
-		memcpy(uniformBuffers.scene.mapped, &uboVSscene, sizeof(uboVSscene));
-	}
-
-	void updateUniformBufferOffscreen()
-	{
-		lightPos.x = sin(glm::radians(timer * 360.0f)) * 0.15f;
-		lightPos.z = cos(glm::radians(timer * 360.0f)) * 0.15f;
-		uboOffscreenVS.projection = glm::perspective((float)(M_PI / 2.0), 1.0f, zNear, zFar);
-		uboOffscreenVS.view = glm::mat4(1.0f);
-		uboOffscreenVS.model = glm::translate(glm::mat4(1.0f), glm::vec3(-lightPos.x, -lightPos.y, -lightPos.z));
-		uboOffscreenVS.lightPos = lightPos;
-		memcpy(uniformBuffers.offscreen.mapped, &uboOffscreenVS, sizeof(uboOffscreenVS));
+		uboScene.projection = camera.matrices.perspective;
+		uboScene.view = camera.matrices.view;
+		uboScene.params = glm::ivec4(lightCount, 0, 0, 0);
+		memcpy(uniformBuffers.scene.mapped, &uboScene, sizeof(uboScene));
 	}
 
 	void draw()
 	{
 		VulkanExampleBase::prepareFrame();
+
+		// The previous frame has finished (the base class waits for the queue), so lights and casters can be updated and the frame recorded
+		updateLights();
+		updateCasters();
+		updateUniformBuffers();
+		buildCommandBuffer(currentBuffer);
+
 		submitInfo.commandBufferCount = 1;
 		submitInfo.pCommandBuffers = &drawCmdBuffers[currentBuffer];
 		VK_CHECK_RESULT(vkQueueSubmit(queue, 1, &submitInfo, VK_NULL_HANDLE));
@@ -708,14 +860,15 @@ public:
 		VulkanExampleBase::prepare();
 		loadAssets();
 		prepareUniformBuffers();
-		prepareCubeMap();
+		// The shadow map format is selected before the render passes are created
+		selectShadowMapFormat();
+		prepareShadowRenderPasses();
+		prepareShadowMaps();
+		prepareShadowMapSamplers();
 		setupDescriptorSetLayout();
-		prepareOffscreenRenderpass();
 		preparePipelines();
 		setupDescriptorPool();
 		setupDescriptorSets();
-		prepareOffscreenFramebuffer();
-		buildCommandBuffers();
 		prepared = true;
 	}
 
@@ -724,20 +877,48 @@ public:
 		if (!prepared)
 			return;
 		draw();
-		if (!paused || camera.updated)
-		{
-			updateUniformBufferOffscreen();
-			updateUniformBuffers();
-		}
 	}
 
 	virtual void OnUpdateUIOverlay(vks::UIOverlay *overlay)
 	{
+		bool shadowMapsChanged = false;
 		if (overlay->header("Settings")) {
-			if (overlay->checkBox("Display shadow cube render target", &displayCubeMap)) {
-				buildCommandBuffers();
+			if (overlay->sliderInt("Lights", &lightCount, 1, MAX_LIGHTS)) {
+				// Lights are placed relative to each other, so all of them move
+				for (auto &light : lights) {
+					light.staticDirty = true;
+				}
+				shadowMapsChanged = true;
+			}
+			shadowMapsChanged |= overlay->comboBox("Shadow map size", &shadowMapSizeIndex, { "256", "512", "1024", "2048" });
+			overlay->checkBox("Animate lights", &animateLights);
+			overlay->checkBox("Animate casters", &animateCasters);
+			overlay->checkBox("Cache static shadows", &cacheStaticShadows);
+			overlay->checkBox("Display shadow cube render target", &displayCubeMap);
+			if (displayCubeMap) {
+				overlay->sliderInt("Light", &displayLight, 0, lightCount - 1);
 			}
 		}
+		// The shadow maps are sized for the active lights, the next frame is recorded with the recreated ones
+		if (shadowMapsChanged && ((shadowMaps.lightCount != (uint32_t)lightCount) || (shadowMaps.size != shadowMapSizes[shadowMapSizeIndex]))) {
+			vkDeviceWaitIdle(device);
+			destroyShadowMaps();
+			prepareShadowMaps();
+			updateDescriptorSets();
+			for (auto &light : lights) {
+				light.staticDirty = true;
+				light.dynamicLastFrame = false;
+			}
+		}
+		if (overlay->header("Statistics")) {
+			// Cache and shadow map, six faces per light
+			const float faceSize = (float)shadowMaps.size * (float)shadowMaps.size * ((shadowMaps.format == VK_FORMAT_D32_SFLOAT) ? 4.0f : 2.0f);
+			overlay->text("Shadow map memory: %.1f MB", 2.0f * 6.0f * (float)shadowMaps.lightCount * faceSize / (1024.0f * 1024.0f));
+			overlay->text("Static cube maps rendered: %d", statistics.staticUpdates);
+			overlay->text("Shadow maps composited: %d", statistics.composites);
+			overlay->text("Dynamic caster draws: %d", statistics.dynamicDraws);
+			overlay->text("Culled caster faces: %d", statistics.culledFaces);
+		}
 	}
 };
 
@@ -8,6 +8,8 @@
 
 #include "vulkanexamplebase.h"
 #include "VulkanglTFModel.h"
+#include "VulkanRenderGraph.h"
+#include "VulkanRenderQueue.h"
 
 #define ENABLE_VALIDATION false
 
@@ -29,6 +31,18 @@ public:
 
 	vkglTF::Model scene;
 
+	// Per material descriptor sets bind once per primitive, the bindless set once per pass (with one draw per primitive or a single indirect draw)
+	enum MaterialBinding { MaterialDescriptorSets = 0, MaterialBindless = 1, MaterialBindlessIndirect = 2 };
+	int32_t materialBinding = MaterialDescriptorSets;
+	bool bindlessSupported = false;
+	vks::Buffer indirectCommandsBuffer;
+	uint32_t indirectDrawCount = 0;
+	// CPU time for recording the scene draws of the G-buffer pass into one command buffer
+	float sceneRecordTime = 0.0f;
+	// Draws the non-indirect modes from a sorted list instead of traversing the node tree
+	bool useRenderQueue = false;
+	vks::RenderQueue renderQueue;
+
 	struct UBOSceneParams {
 		glm::mat4 projection;
 		glm::mat4 model;
@@ -42,28 +56,67 @@ public:
 		int32_t ssao = true;
 		int32_t ssaoOnly = false;
 		int32_t ssaoBlur = true;
+		// Reference mode traces all kernel samples at full resolution with a box blur, production mode traces fewer samples at
+		// reduced resolution, upsamples them depth aware and optionally accumulates them over frames
+		int32_t production = false;
+		// Transforms view space positions of the current frame into the view space of the previous frame
+		glm::mat4 viewToPreviousView;
+		int32_t sampleCount = 16;
+		// Offsets the per pixel kernel rotation in production mode
+		uint32_t frameIndex = 0;
+		// Weight of the current frame in the temporal accumulation
+		float temporalWeight = 0.1f;
+		// Cleared whenever the history doesn't contain the previous frame (e.g. after a resize or mode change)
+		int32_t historyValid = false;
 	} uboSSAOParams;
 
+	// Production mode settings, the resolution is a power of two divisor of the screen resolution
+	int32_t aoResolution = 1;
+	int32_t aoSampleCount = 1;
+	const std::vector<int32_t> aoSampleCounts = { 8, 16, 32 };
+	bool temporalAccumulation = true;
+	glm::mat4 previousView = glm::mat4(1.0f);
+
+	// Accumulated occlusion and depth of the previous frame, owned by the example as it has to outlive the frame
+	// Imported into the graph, which keeps its contents as it is always handed back in shader read layout
+	struct {
+		VkImage image = VK_NULL_HANDLE;
+		VkDeviceMemory memory = VK_NULL_HANDLE;
+		VkImageView view = VK_NULL_HANDLE;
+		const VkFormat format = VK_FORMAT_R16G16_SFLOAT;
+	} aoHistory;
+
 	struct {
 		VkPipeline offscreen;
+		VkPipeline offscreenBindless;
 		VkPipeline composition;
 		VkPipeline ssao;
 		VkPipeline ssaoBlur;
+		VkPipeline ssaoUpsample;
+		VkPipeline ssaoTemporal;
+		VkPipeline ssaoHistory;
 	} pipelines;
 
 	struct {
 		VkPipelineLayout gBuffer;
+		VkPipelineLayout gBufferBindless;
 		VkPipelineLayout ssao;
 		VkPipelineLayout ssaoBlur;
+		VkPipelineLayout ssaoUpsample;
+		VkPipelineLayout ssaoTemporal;
+		VkPipelineLayout ssaoHistory;
 		VkPipelineLayout composition;
 	} pipelineLayouts;
 
 	struct {
-		const uint32_t count = 5;
+		const uint32_t count = 8;
 		VkDescriptorSet model;
 		VkDescriptorSet floor;
 		VkDescriptorSet ssao;
 		VkDescriptorSet ssaoBlur;
+		VkDescriptorSet ssaoUpsample;
+		VkDescriptorSet ssaoTemporal;
+		VkDescriptorSet ssaoHistory;
 		VkDescriptorSet composition;
 	} descriptorSets;
 
@@ -71,6 +124,9 @@ public:
 		VkDescriptorSetLayout gBuffer;
 		VkDescriptorSetLayout ssao;
 		VkDescriptorSetLayout ssaoBlur;
+		VkDescriptorSetLayout ssaoUpsample;
+		VkDescriptorSetLayout ssaoTemporal;
+		VkDescriptorSetLayout ssaoHistory;
 		VkDescriptorSetLayout composition;
 	} descriptorSetLayouts;
 
@@ -80,43 +136,8 @@ public:
 		vks::Buffer ssaoParams;
 	} uniformBuffers;
 
-	// Framebuffer for offscreen rendering
-	struct FrameBufferAttachment {
-		VkImage image;
-		VkDeviceMemory mem;
-		VkImageView view;
-		VkFormat format;
-		void destroy(VkDevice device)
-		{
-			vkDestroyImage(device, image, nullptr);
-			vkDestroyImageView(device, view, nullptr);
-			vkFreeMemory(device, mem, nullptr);
-		}
-	};
-	struct FrameBuffer {
-		int32_t width, height;
-		VkFramebuffer frameBuffer;
-		VkRenderPass renderPass;
-		void setSize(int32_t w, int32_t h)
-		{
-			this->width = w;
-			this->height = h;
-		}
-		void destroy(VkDevice device)
-		{
-			vkDestroyFramebuffer(device, frameBuffer, nullptr);
-			vkDestroyRenderPass(device, renderPass, nullptr);
-		}
-	};
-
-	struct {
-		struct Offscreen : public FrameBuffer {
-			FrameBufferAttachment position, normal, albedo, depth;
-		} offscreen;
-		struct SSAO : public FrameBuffer {
-			FrameBufferAttachment color;
-		} ssao, ssaoBlur;
-	} frameBuffers;
+	// Owns the G-buffer and the ambient occlusion targets, passes that are disabled in the UI are culled from it
+	vks::RenderGraph renderGraph;
 
 	// One sampler for the frame buffer color attachments
 	VkSampler colorSampler;
@@ -124,6 +145,8 @@ public:
 	VulkanExample() : VulkanExampleBase(ENABLE_VALIDATION)
 	{
 		title = "Screen space ambient occlusion";
+		// Descriptor indexing for bindless materials is core with Vulkan 1.2
+		apiVersion = VK_API_VERSION_1_2;
 		camera.type = Camera::CameraType::firstperson;
 #ifndef __ANDROID__
 		camera.rotationSpeed = 0.25f;
@@ -137,32 +160,36 @@ public:
 	{
 		vkDestroySampler(device, colorSampler, nullptr);
 
-		// Attachments
-		frameBuffers.offscreen.position.destroy(device);
-		frameBuffers.offscreen.normal.destroy(device);
-		frameBuffers.offscreen.albedo.destroy(device);
-		frameBuffers.offscreen.depth.destroy(device);
-		frameBuffers.ssao.color.destroy(device);
-		frameBuffers.ssaoBlur.color.destroy(device);
-
-		// Framebuffers
-		frameBuffers.offscreen.destroy(device);
-		frameBuffers.ssao.destroy(device);
-		frameBuffers.ssaoBlur.destroy(device);
+		renderGraph.destroy();
+		destroyHistoryImage();
 
 		vkDestroyPipeline(device, pipelines.offscreen, nullptr);
+		if (bindlessSupported) {
+			vkDestroyPipeline(device, pipelines.offscreenBindless, nullptr);
+			vkDestroyPipelineLayout(device, pipelineLayouts.gBufferBindless, nullptr);
+			indirectCommandsBuffer.destroy();
+		}
 		vkDestroyPipeline(device, pipelines.composition, nullptr);
 		vkDestroyPipeline(device, pipelines.ssao, nullptr);
 		vkDestroyPipeline(device, pipelines.ssaoBlur, nullptr);
+		vkDestroyPipeline(device, pipelines.ssaoUpsample, nullptr);
+		vkDestroyPipeline(device, pipelines.ssaoTemporal, nullptr);
+		vkDestroyPipeline(device, pipelines.ssaoHistory, nullptr);
 
 		vkDestroyPipelineLayout(device, pipelineLayouts.gBuffer, nullptr);
 		vkDestroyPipelineLayout(device, pipelineLayouts.ssao, nullptr);
 		vkDestroyPipelineLayout(device, pipelineLayouts.ssaoBlur, nullptr);
+		vkDestroyPipelineLayout(device, pipelineLayouts.ssaoUpsample, nullptr);
+		vkDestroyPipelineLayout(device, pipelineLayouts.ssaoTemporal, nullptr);
+		vkDestroyPipelineLayout(device, pipelineLayouts.ssaoHistory, nullptr);
 		vkDestroyPipelineLayout(device, pipelineLayouts.composition, nullptr);
 
 		vkDestroyDescriptorSetLayout(device, descriptorSetLayouts.gBuffer, nullptr);
 		vkDestroyDescriptorSetLayout(device, descriptorSetLayouts.ssao, nullptr);
 		vkDestroyDescriptorSetLayout(device, descriptorSetLayouts.ssaoBlur, nullptr);
+		vkDestroyDescriptorSetLayout(device, descriptorSetLayouts.ssaoUpsample, nullptr);
+		vkDestroyDescriptorSetLayout(device, descriptorSetLayouts.ssaoTemporal, nullptr);
+		vkDestroyDescriptorSetLayout(device, descriptorSetLayouts.ssaoHistory, nullptr);
 		vkDestroyDescriptorSetLayout(device, descriptorSetLayouts.composition, nullptr);
 
 		// Uniform buffers
@@ -176,297 +203,234 @@ public:
 	void getEnabledFeatures()
 	{
 		enabledFeatures.samplerAnisotropy = deviceFeatures.samplerAnisotropy;
+		// Without multi draw indirect the indirect mode issues one indirect draw per primitive
+		enabledFeatures.multiDrawIndirect = deviceFeatures.multiDrawIndirect;
+		// Indirect draws carry the material index in their first instance
+		enabledFeatures.drawIndirectFirstInstance = deviceFeatures.drawIndirectFirstInstance;
 	}
 
-	// Create a frame buffer attachment
-	void createAttachment(
-		VkFormat format,
-		VkImageUsageFlagBits usage,
-		FrameBufferAttachment *attachment,
-		uint32_t width,
-		uint32_t height)
+	void getEnabledExtensions()
 	{
-		VkImageAspectFlags aspectMask = 0;
+		bindlessSupported = vkglTF::requestBindlessFeatures(vulkanDevice, apiVersion, enabledDeviceExtensions, deviceCreatepNextChain);
+	}
 
-		attachment->format = format;
+	void drawSceneSorted(VkCommandBuffer commandBuffer)
+	{
+		const bool bindless = (materialBinding == MaterialBindless);
+		const VkPipelineLayout pipelineLayout = bindless ? pipelineLayouts.gBufferBindless : pipelineLayouts.gBuffer;
+		const uint32_t pipeline = renderQueue.addPipeline(bindless ? pipelines.offscreenBindless : pipelines.offscreen, pipelineLayout);
+		vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 0, 1, &descriptorSets.floor, 0, NULL);
+		// Command buffers are only rebuilt on changes, so the list is not culled against the current view
+		renderQueue.begin(camera.matrices.view, camera.matrices.perspective);
+		renderQueue.addModel(scene, { pipeline, pipeline, pipeline }, bindless ? vkglTF::RenderFlags::BindBindlessSet : vkglTF::RenderFlags::BindImages, 1, glm::mat4(1.0f), true);
+		renderQueue.sort();
+		renderQueue.record(commandBuffer);
+	}
 
-		if (usage & VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT)
-		{
-			aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+	void drawScene(VkCommandBuffer commandBuffer)
+	{
+		if (useRenderQueue && (materialBinding != MaterialBindlessIndirect)) {
+			drawSceneSorted(commandBuffer);
+			return;
 		}
-		if (usage & VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT)
-		{
-			aspectMask = VK_IMAGE_ASPECT_DEPTH_BIT;
-			if (format >= VK_FORMAT_D16_UNORM_S8_UINT)
-				aspectMask |=VK_IMAGE_ASPECT_STENCIL_BIT;
+		switch (materialBinding) {
+		case MaterialDescriptorSets:
+			vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelines.offscreen);
+			vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayouts.gBuffer, 0, 1, &descriptorSets.floor, 0, NULL);
+			scene.draw(commandBuffer, vkglTF::RenderFlags::BindImages, pipelineLayouts.gBuffer);
+			break;
+		case MaterialBindless:
+			vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelines.offscreenBindless);
+			vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayouts.gBufferBindless, 0, 1, &descriptorSets.floor, 0, NULL);
+			scene.draw(commandBuffer, vkglTF::RenderFlags::BindBindlessSet, pipelineLayouts.gBufferBindless);
+			break;
+		case MaterialBindlessIndirect:
+			vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelines.offscreenBindless);
+			std::array<VkDescriptorSet, 2> sets = { descriptorSets.floor, scene.bindlessDescriptorSet };
+			vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayouts.gBufferBindless, 0, static_cast<uint32_t>(sets.size()), sets.data(), 0, NULL);
+			scene.bindBuffers(commandBuffer);
+			if (vulkanDevice->enabledFeatures.multiDrawIndirect) {
+				vkCmdDrawIndexedIndirect(commandBuffer, indirectCommandsBuffer.buffer, 0, indirectDrawCount, sizeof(VkDrawIndexedIndirectCommand));
+			} else {
+				for (uint32_t i = 0; i < indirectDrawCount; i++) {
+					vkCmdDrawIndexedIndirect(commandBuffer, indirectCommandsBuffer.buffer, i * sizeof(VkDrawIndexedIndirectCommand), 1, sizeof(VkDrawIndexedIndirectCommand));
+				}
+			}
+			break;
 		}
-
-		assert(aspectMask > 0);
-
-		VkImageCreateInfo image = vks::initializers::imageCreateInfo();
-		image.imageType = VK_IMAGE_TYPE_2D;
-		image.format = format;
-		image.extent.width = width;
-		image.extent.height = height;
-		image.extent.depth = 1;
-		image.mipLevels = 1;
-		image.arrayLayers = 1;
-		image.samples = VK_SAMPLE_COUNT_1_BIT;
-		image.tiling = VK_IMAGE_TILING_OPTIMAL;
-		image.usage = usage | VK_IMAGE_USAGE_SAMPLED_BIT;
-
-		VkMemoryAllocateInfo memAlloc = vks::initializers::memoryAllocateInfo();
-		VkMemoryRequirements memReqs;
-
-		VK_CHECK_RESULT(vkCreateImage(device, &image, nullptr, &attachment->image));
-		vkGetImageMemoryRequirements(device, attachment->image, &memReqs);
-		memAlloc.allocationSize = memReqs.size;
-		memAlloc.memoryTypeIndex = vulkanDevice->getMemoryType(memReqs.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
-		VK_CHECK_RESULT(vkAllocateMemory(device, &memAlloc, nullptr, &attachment->mem));
-		VK_CHECK_RESULT(vkBindImageMemory(device, attachment->image, attachment->mem, 0));
-
-		VkImageViewCreateInfo imageView = vks::initializers::imageViewCreateInfo();
-		imageView.viewType = VK_IMAGE_VIEW_TYPE_2D;
-		imageView.format = format;
-		imageView.subresourceRange = {};
-		imageView.subresourceRange.aspectMask = aspectMask;
-		imageView.subresourceRange.baseMipLevel = 0;
-		imageView.subresourceRange.levelCount = 1;
-		imageView.subresourceRange.baseArrayLayer = 0;
-		imageView.subresourceRange.layerCount = 1;
-		imageView.image = attachment->image;
-		VK_CHECK_RESULT(vkCreateImageView(device, &imageView, nullptr, &attachment->view));
 	}
 
-	void prepareOffscreenFramebuffers()
+	// Pipelines are created against a graph with allPasses set, which keeps every pass alive
+	void prepareRenderGraph(bool allPasses = false)
 	{
-		// Attachments
-#if defined(__ANDROID__)
-		const uint32_t ssaoWidth = width / 2;
-		const uint32_t ssaoHeight = height / 2;
-#else
-		const uint32_t ssaoWidth = width;
-		const uint32_t ssaoHeight = height;
-#endif
-
-		frameBuffers.offscreen.setSize(width, height);
-		frameBuffers.ssao.setSize(ssaoWidth, ssaoHeight);
-		frameBuffers.ssaoBlur.setSize(width, height);
-
-		// Find a suitable depth format
-		VkFormat attDepthFormat;
-		VkBool32 validDepthFormat = vks::tools::getSupportedDepthFormat(physicalDevice, &attDepthFormat);
-		assert(validDepthFormat);
+		renderGraph.reset();
 
+		vks::RenderGraph::ImageInfo imageInfo;
+		imageInfo.clearValue.color = { { 0.0f, 0.0f, 0.0f, 1.0f } };
 		// G-Buffer
-		createAttachment(VK_FORMAT_R32G32B32A32_SFLOAT, VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT, &frameBuffers.offscreen.position, width, height);	// Position + Depth
-		createAttachment(VK_FORMAT_R8G8B8A8_UNORM, VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT, &frameBuffers.offscreen.normal, width, height);			// Normals
-		createAttachment(VK_FORMAT_R8G8B8A8_UNORM, VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT, &frameBuffers.offscreen.albedo, width, height);			// Albedo (color)
-		createAttachment(attDepthFormat, VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT, &frameBuffers.offscreen.depth, width, height);			// Depth
-
+		imageInfo.format = VK_FORMAT_R32G32B32A32_SFLOAT;
+		renderGraph.addImage("position", imageInfo);		// Position + Depth
+		imageInfo.format = VK_FORMAT_R8G8B8A8_UNORM;
+		renderGraph.addImage("normal", imageInfo);			// Normals
+		renderGraph.addImage("albedo", imageInfo);			// Albedo (color)
+		imageInfo.format = depthFormat;
+		imageInfo.clearValue.depthStencil = { 1.0f, 0 };
+		renderGraph.addImage("depth", imageInfo);			// Depth
 		// SSAO
-		createAttachment(VK_FORMAT_R8_UNORM, VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT, &frameBuffers.ssao.color, ssaoWidth, ssaoHeight);				// Color
-
+		imageInfo.format = VK_FORMAT_R8_UNORM;
+		imageInfo.clearValue.color = { { 0.0f, 0.0f, 0.0f, 1.0f } };
+#if defined(__ANDROID__)
+		imageInfo.width = 0.5f;
+		imageInfo.height = 0.5f;
+#endif
+		if (uboSSAOParams.production) {
+			imageInfo.width = 1.0f / float(1 << aoResolution);
+			imageInfo.height = imageInfo.width;
+		}
+		renderGraph.addImage("ssao", imageInfo);
 		// SSAO blur
-		createAttachment(VK_FORMAT_R8_UNORM, VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT, &frameBuffers.ssaoBlur.color, width, height);					// Color
-
-		// Render passes
-
-		// G-Buffer creation
-		{
-			std::array<VkAttachmentDescription, 4> attachmentDescs = {};
-
-			// Init attachment properties
-			for (uint32_t i = 0; i < static_cast<uint32_t>(attachmentDescs.size()); i++)
-			{
-				attachmentDescs[i].samples = VK_SAMPLE_COUNT_1_BIT;
-				attachmentDescs[i].loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
-				attachmentDescs[i].storeOp = VK_ATTACHMENT_STORE_OP_STORE;
-				attachmentDescs[i].stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
-				attachmentDescs[i].stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
-				attachmentDescs[i].finalLayout = (i == 3) ? VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL : VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
-			}
-
-			// Formats
-			attachmentDescs[0].format = frameBuffers.offscreen.position.format;
-			attachmentDescs[1].format = frameBuffers.offscreen.normal.format;
-			attachmentDescs[2].format = frameBuffers.offscreen.albedo.format;
-			attachmentDescs[3].format = frameBuffers.offscreen.depth.format;
-
-			std::vector<VkAttachmentReference> colorReferences;
-			colorReferences.push_back({ 0, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL });
-			colorReferences.push_back({ 1, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL });
-			colorReferences.push_back({ 2, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL });
-
-			VkAttachmentReference depthReference = {};
-			depthReference.attachment = 3;
-			depthReference.layout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
-
-			VkSubpassDescription subpass = {};
-			subpass.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
-			subpass.pColorAttachments = colorReferences.data();
-			subpass.colorAttachmentCount = static_cast<uint32_t>(colorReferences.size());
-			subpass.pDepthStencilAttachment = &depthReference;
-
-			// Use subpass dependencies for attachment layout transitions
-			std::array<VkSubpassDependency, 2> dependencies;
-
-			dependencies[0].srcSubpass = VK_SUBPASS_EXTERNAL;
-			dependencies[0].dstSubpass = 0;
-			dependencies[0].srcStageMask = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
-			dependencies[0].dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
-			dependencies[0].srcAccessMask = VK_ACCESS_SHADER_READ_BIT;
-			dependencies[0].dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
-			dependencies[0].dependencyFlags = VK_DEPENDENCY_BY_REGION_BIT;
-
-			dependencies[1].srcSubpass = 0;
-			dependencies[1].dstSubpass = VK_SUBPASS_EXTERNAL;
-			dependencies[1].srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
-			dependencies[1].dstStageMask = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
-			dependencies[1].srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
-			dependencies[1].dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
-			dependencies[1].dependencyFlags = VK_DEPENDENCY_BY_REGION_BIT;
-
-			VkRenderPassCreateInfo renderPassInfo = {};
-			renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
-			renderPassInfo.pAttachments = attachmentDescs.data();
-			renderPassInfo.attachmentCount = static_cast<uint32_t>(attachmentDescs.size());
-			renderPassInfo.subpassCount = 1;
-			renderPassInfo.pSubpasses = &subpass;
-			renderPassInfo.dependencyCount = 2;
-			renderPassInfo.pDependencies = dependencies.data();
-			VK_CHECK_RESULT(vkCreateRenderPass(device, &renderPassInfo, nullptr, &frameBuffers.offscreen.renderPass));
-
-			std::array<VkImageView, 4> attachments;
-			attachments[0] = frameBuffers.offscreen.position.view;
-			attachments[1] = frameBuffers.offscreen.normal.view;
-			attachments[2] = frameBuffers.offscreen.albedo.view;
-			attachments[3] = frameBuffers.offscreen.depth.view;
-
-			VkFramebufferCreateInfo fbufCreateInfo = vks::initializers::framebufferCreateInfo();
-			fbufCreateInfo.renderPass = frameBuffers.offscreen.renderPass;
-			fbufCreateInfo.pAttachments = attachments.data();
-			fbufCreateInfo.attachmentCount = static_cast<uint32_t>(attachments.size());
-			fbufCreateInfo.width = frameBuffers.offscreen.width;
-			fbufCreateInfo.height = frameBuffers.offscreen.height;
-			fbufCreateInfo.layers = 1;
-			VK_CHECK_RESULT(vkCreateFramebuffer(device, &fbufCreateInfo, nullptr, &frameBuffers.offscreen.frameBuffer));
+		imageInfo.width = 1.0f;
+		imageInfo.height = 1.0f;
+		renderGraph.addImage("ssaoBlur", imageInfo);
+		// Production mode: Upsampled and temporally accumulated occlusion, the latter with the depth used to reject the history
+		renderGraph.addImage("aoUpsampled", imageInfo);
+		imageInfo.format = aoHistory.format;
+		renderGraph.addImage("aoResolved", imageInfo);
+		renderGraph.importImage("aoHistory", aoHistory.format, { width, height }, { aoHistory.image }, { aoHistory.view }, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, imageInfo.clearValue, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT);
+
+		std::vector<VkImage> swapChainImages;
+		std::vector<VkImageView> swapChainViews;
+		for (auto &buffer : swapChain.buffers) {
+			swapChainImages.push_back(buffer.image);
+			swapChainViews.push_back(buffer.view);
 		}
-
-		// SSAO
-		{
-			VkAttachmentDescription attachmentDescription{};
-			attachmentDescription.format = frameBuffers.ssao.color.format;
-			attachmentDescription.samples = VK_SAMPLE_COUNT_1_BIT;
-			attachmentDescription.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
-			attachmentDescription.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
-			attachmentDescription.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
-			attachmentDescription.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
-			attachmentDescription.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-			attachmentDescription.finalLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
-
-			VkAttachmentReference colorReference = { 0, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL };
-
-			VkSubpassDescription subpass = {};
-			subpass.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
-			subpass.pColorAttachments = &colorReference;
-			subpass.colorAttachmentCount = 1;
-
-			std::array<VkSubpassDependency, 2> dependencies;
-
-			dependencies[0].srcSubpass = VK_SUBPASS_EXTERNAL;
-			dependencies[0].dstSubpass = 0;
-			dependencies[0].srcStageMask = VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT;
-			dependencies[0].dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
-			dependencies[0].srcAccessMask = VK_ACCESS_MEMORY_READ_BIT;
-			dependencies[0].dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
-			dependencies[0].dependencyFlags = VK_DEPENDENCY_BY_REGION_BIT;
-
-			dependencies[1].srcSubpass = 0;
-			dependencies[1].dstSubpass = VK_SUBPASS_EXTERNAL;
-			dependencies[1].srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
-			dependencies[1].dstStageMask = VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT;
-			dependencies[1].srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
-			dependencies[1].dstAccessMask = VK_ACCESS_MEMORY_READ_BIT;
-			dependencies[1].dependencyFlags = VK_DEPENDENCY_BY_REGION_BIT;
-
-			VkRenderPassCreateInfo renderPassInfo = {};
-			renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
-			renderPassInfo.pAttachments = &attachmentDescription;
-			renderPassInfo.attachmentCount = 1;
-			renderPassInfo.subpassCount = 1;
-			renderPassInfo.pSubpasses = &subpass;
-			renderPassInfo.dependencyCount = 2;
-			renderPassInfo.pDependencies = dependencies.data();
-			VK_CHECK_RESULT(vkCreateRenderPass(device, &renderPassInfo, nullptr, &frameBuffers.ssao.renderPass));
-
-			VkFramebufferCreateInfo fbufCreateInfo = vks::initializers::framebufferCreateInfo();
-			fbufCreateInfo.renderPass = frameBuffers.ssao.renderPass;
-			fbufCreateInfo.pAttachments = &frameBuffers.ssao.color.view;
-			fbufCreateInfo.attachmentCount = 1;
-			fbufCreateInfo.width = frameBuffers.ssao.width;
-			fbufCreateInfo.height = frameBuffers.ssao.height;
-			fbufCreateInfo.layers = 1;
-			VK_CHECK_RESULT(vkCreateFramebuffer(device, &fbufCreateInfo, nullptr, &frameBuffers.ssao.frameBuffer));
+		VkClearValue clearValue;
+		clearValue.color = defaultClearColor;
+		renderGraph.importImage("swapchain", swapChain.colorFormat, { width, height }, swapChainImages, swapChainViews, VK_IMAGE_LAYOUT_PRESENT_SRC_KHR, clearValue);
+		renderGraph.addOutput("swapchain");
+
+		/*
+			First pass: Fill G-Buffer components (positions+depth, normals, albedo) using MRT
+		*/
+		renderGraph.addGraphicsPass("gbuffer")
+			.addColorOutput("position")
+			.addColorOutput("normal")
+			.addColorOutput("albedo")
+			.setDepthStencilOutput("depth")
+			.setRecordFunction([this](VkCommandBuffer commandBuffer) {
+				auto tStart = std::chrono::high_resolution_clock::now();
+				drawScene(commandBuffer);
+				sceneRecordTime = std::chrono::duration<float, std::milli>(std::chrono::high_resolution_clock::now() - tStart).count();
+			});
+
+		/*
+			Second pass: SSAO generation
+		*/
+		renderGraph.addGraphicsPass("ssao")
+			.addTextureInput("position")
+			.addTextureInput("normal")
+			.addColorOutput("ssao")
+			.setRecordFunction([this](VkCommandBuffer commandBuffer) {
+				vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayouts.ssao, 0, 1, &descriptorSets.ssao, 0, NULL);
+				vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelines.ssao);
+				vkCmdDraw(commandBuffer, 3, 1, 0, 0);
+			});
+
+		/*
+			Third pass: SSAO blur
+		*/
+		renderGraph.addGraphicsPass("ssaoBlur")
+			.addTextureInput("ssao")
+			.addColorOutput("ssaoBlur")
+			.setRecordFunction([this](VkCommandBuffer commandBuffer) {
+				vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayouts.ssaoBlur, 0, 1, &descriptorSets.ssaoBlur, 0, NULL);
+				vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelines.ssaoBlur);
+				vkCmdDraw(commandBuffer, 3, 1, 0, 0);
+			});
+
+		/*
+			Production mode: Depth aware upsampling of the reduced resolution occlusion
+		*/
+		renderGraph.addGraphicsPass("ssaoUpsample")
+			.addTextureInput("position")
+			.addTextureInput("normal")
+			.addTextureInput("ssao")
+			.addColorOutput("aoUpsampled")
+			.setRecordFunction([this](VkCommandBuffer commandBuffer) {
+				vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayouts.ssaoUpsample, 0, 1, &descriptorSets.ssaoUpsample, 0, NULL);
+				vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelines.ssaoUpsample);
+				vkCmdDraw(commandBuffer, 3, 1, 0, 0);
+			});
+
+		/*
+			Production mode: Temporal accumulation with the reprojected history of the previous frame
+		*/
+		renderGraph.addGraphicsPass("ssaoTemporal")
+			.addTextureInput("position")
+			.addTextureInput("aoUpsampled")
+			.addTextureInput("aoHistory")
+			.addColorOutput("aoResolved")
+			.setRecordFunction([this](VkCommandBuffer commandBuffer) {
+				vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayouts.ssaoTemporal, 0, 1, &descriptorSets.ssaoTemporal, 0, NULL);
+				vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelines.ssaoTemporal);
+				vkCmdDraw(commandBuffer, 3, 1, 0, 0);
+			});
+
+		// The history is read before it is written, so it can't be the output of the temporal pass itself
+		renderGraph.addGraphicsPass("ssaoHistory")
+			.addTextureInput("aoResolved")
+			.addColorOutput("aoHistory")
+			.setRecordFunction([this](VkCommandBuffer commandBuffer) {
+				vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayouts.ssaoHistory, 0, 1, &descriptorSets.ssaoHistory, 0, NULL);
+				vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelines.ssaoHistory);
+				vkCmdDraw(commandBuffer, 3, 1, 0, 0);
+			});
+
+		/*
+			Final pass: Scene rendering with applied ambient occlusion
+		*/
+		vks::RenderGraph::Pass &composition = renderGraph.addGraphicsPass("composition")
+			.addTextureInput("position")
+			.addTextureInput("normal")
+			.addTextureInput("albedo")
+			.addColorOutput("swapchain")
+			.setRecordFunction([this](VkCommandBuffer commandBuffer) {
+				vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayouts.composition, 0, 1, &descriptorSets.composition, 0, NULL);
+				vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelines.composition);
+				vkCmdDraw(commandBuffer, 3, 1, 0, 0);
+
+				drawUI(commandBuffer);
+			});
+		// Only the ambient occlusion target that is displayed is read, the graph culls the passes nothing reads from
+		const std::string occlusion = aoTarget();
+		if (!occlusion.empty()) {
+			composition.addTextureInput(occlusion);
+		}
+		// Nothing in the frame reads the history after it has been written
+		if (allPasses || (occlusion == "aoResolved")) {
+			renderGraph.addOutput("aoHistory");
+		}
+		if (allPasses) {
+			renderGraph.addOutput("ssaoBlur");
 		}
 
-		// SSAO Blur
-		{
-			VkAttachmentDescription attachmentDescription{};
-			attachmentDescription.format = frameBuffers.ssaoBlur.color.format;
-			attachmentDescription.samples = VK_SAMPLE_COUNT_1_BIT;
-			attachmentDescription.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
-			attachmentDescription.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
-			attachmentDescription.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
-			attachmentDescription.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
-			attachmentDescription.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-			attachmentDescription.finalLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
-
-			VkAttachmentReference colorReference = { 0, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL };
-
-			VkSubpassDescription subpass = {};
-			subpass.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
-			subpass.pColorAttachments = &colorReference;
-			subpass.colorAttachmentCount = 1;
-
-			std::array<VkSubpassDependency, 2> dependencies;
-
-			dependencies[0].srcSubpass = VK_SUBPASS_EXTERNAL;
-			dependencies[0].dstSubpass = 0;
-			dependencies[0].srcStageMask = VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT;
-			dependencies[0].dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
-			dependencies[0].srcAccessMask = VK_ACCESS_MEMORY_READ_BIT;
-			dependencies[0].dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
-			dependencies[0].dependencyFlags = VK_DEPENDENCY_BY_REGION_BIT;
-
-			dependencies[1].srcSubpass = 0;
-			dependencies[1].dstSubpass = VK_SUBPASS_EXTERNAL;
-			dependencies[1].srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
-			dependencies[1].dstStageMask = VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT;
-			dependencies[1].srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
-			dependencies[1].dstAccessMask = VK_ACCESS_MEMORY_READ_BIT;
-			dependencies[1].dependencyFlags = VK_DEPENDENCY_BY_REGION_BIT;
-
-			VkRenderPassCreateInfo renderPassInfo = {};
-			renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
-			renderPassInfo.pAttachments = &attachmentDescription;
-			renderPassInfo.attachmentCount = 1;
-			renderPassInfo.subpassCount = 1;
-			renderPassInfo.pSubpasses = &subpass;
-			renderPassInfo.dependencyCount = 2;
-			renderPassInfo.pDependencies = dependencies.data();
-			VK_CHECK_RESULT(vkCreateRenderPass(device, &renderPassInfo, nullptr, &frameBuffers.ssaoBlur.renderPass));
-
-			VkFramebufferCreateInfo fbufCreateInfo = vks::initializers::framebufferCreateInfo();
-			fbufCreateInfo.renderPass = frameBuffers.ssaoBlur.renderPass;
-			fbufCreateInfo.pAttachments = &frameBuffers.ssaoBlur.color.view;
-			fbufCreateInfo.attachmentCount = 1;
-			fbufCreateInfo.width = frameBuffers.ssaoBlur.width;
-			fbufCreateInfo.height = frameBuffers.ssaoBlur.height;
-			fbufCreateInfo.layers = 1;
-			VK_CHECK_RESULT(vkCreateFramebuffer(device, &fbufCreateInfo, nullptr, &frameBuffers.ssaoBlur.frameBuffer));
+		renderGraph.compile({ width, height });
+	}
+
+	// Name of the ambient occlusion image read by the composition, empty if ambient occlusion is disabled
+	std::string aoTarget() const
+	{
+		if (!uboSSAOParams.ssao && !uboSSAOParams.ssaoOnly) {
+			return "";
+		}
+		if (uboSSAOParams.production) {
+			return temporalAccumulation ? "aoResolved" : "aoUpsampled";
 		}
+		return uboSSAOParams.ssaoBlur ? "ssaoBlur" : "ssao";
+	}
 
+	void prepareColorSampler()
+	{
 		// Shared sampler used for all color attachments
 		VkSamplerCreateInfo sampler = vks::initializers::samplerCreateInfo();
 		sampler.magFilter = VK_FILTER_NEAREST;
@@ -483,11 +447,91 @@ public:
 		VK_CHECK_RESULT(vkCreateSampler(device, &sampler, nullptr, &colorSampler));
 	}
 
+	// The UI is drawn by the composition pass instead of the base class render pass
+	void prepareUIPipeline()
+	{
+		if (!settings.overlay) {
+			return;
+		}
+		vkDestroyPipeline(device, UIOverlay.pipeline, nullptr);
+		vkDestroyPipelineLayout(device, UIOverlay.pipelineLayout, nullptr);
+		UIOverlay.subpass = renderGraph.subpass("composition");
+		UIOverlay.preparePipeline(pipelineCache, renderGraph.renderPass("composition"), swapChain.colorFormat, depthFormat);
+	}
+
+	void createHistoryImage()
+	{
+		VkImageCreateInfo imageCI = vks::initializers::imageCreateInfo();
+		imageCI.imageType = VK_IMAGE_TYPE_2D;
+		imageCI.format = aoHistory.format;
+		imageCI.extent = { width, height, 1 };
+		imageCI.mipLevels = 1;
+		imageCI.arrayLayers = 1;
+		imageCI.samples = VK_SAMPLE_COUNT_1_BIT;
+		imageCI.tiling = VK_IMAGE_TILING_OPTIMAL;
+		imageCI.usage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
+		VK_CHECK_RESULT(vkCreateImage(device, &imageCI, nullptr, &aoHistory.image));
+		VkMemoryRequirements memReqs;
+		vkGetImageMemoryRequirements(device, aoHistory.image, &memReqs);
+		VkMemoryAllocateInfo memAlloc = vks::initializers::memoryAllocateInfo();
+		memAlloc.allocationSize = memReqs.size;
+		memAlloc.memoryTypeIndex = vulkanDevice->getMemoryType(memReqs.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+		VK_CHECK_RESULT(vkAllocateMemory(device, &memAlloc, nullptr, &aoHistory.memory));
+		VK_CHECK_RESULT(vkBindImageMemory(device, aoHistory.image, aoHistory.memory, 0));
+
+		VkImageViewCreateInfo viewCI = vks::initializers::imageViewCreateInfo();
+		viewCI.viewType = VK_IMAGE_VIEW_TYPE_2D;
+		viewCI.format = aoHistory.format;
+		viewCI.subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1 };
+		viewCI.image = aoHistory.image;
+		VK_CHECK_RESULT(vkCreateImageView(device, &viewCI, nullptr, &aoHistory.view));
+
+		// The graph expects imported images to be in their final layout at the start of a frame
+		VkCommandBuffer commandBuffer = vulkanDevice->createCommandBuffer(VK_COMMAND_BUFFER_LEVEL_PRIMARY, true);
+		vks::tools::setImageLayout(commandBuffer, aoHistory.image, VK_IMAGE_ASPECT_COLOR_BIT, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+		vulkanDevice->flushCommandBuffer(commandBuffer, queue);
+		uboSSAOParams.historyValid = false;
+	}
+
+	void destroyHistoryImage()
+	{
+		vkDestroyImageView(device, aoHistory.view, nullptr);
+		vkDestroyImage(device, aoHistory.image, nullptr);
+		vkFreeMemory(device, aoHistory.memory, nullptr);
+	}
+
+	// Graph images are sized relative to the swapchain, which is recreated on resize
+	virtual void setupFrameBuffer()
+	{
+		VulkanExampleBase::setupFrameBuffer();
+		if (renderGraph.isCompiled()) {
+			destroyHistoryImage();
+			createHistoryImage();
+			prepareRenderGraph();
+			updateImageDescriptors();
+		}
+	}
+
 	void loadAssets()
 	{
 		vkglTF::descriptorBindingFlags  = vkglTF::DescriptorBindingFlags::ImageBaseColor;
+		if (bindlessSupported) {
+			vkglTF::descriptorBindingFlags |= vkglTF::DescriptorBindingFlags::BindlessMaterials;
+		}
 		const uint32_t gltfLoadingFlags = vkglTF::FileLoadingFlags::FlipY | vkglTF::FileLoadingFlags::PreTransformVertices;
 		scene.loadFromFile(getAssetPath() + "models/sponza/sponza.gltf", vulkanDevice, queue, gltfLoadingFlags);
+
+		if (bindlessSupported) {
+			// The whole scene as a single indirect draw, the material index is passed as the first instance of every command
+			std::vector<VkDrawIndexedIndirectCommand> indirectCommands = scene.indirectCommands();
+			indirectDrawCount = static_cast<uint32_t>(indirectCommands.size());
+			vks::Buffer stagingBuffer;
+			const VkDeviceSize bufferSize = indirectCommands.size() * sizeof(VkDrawIndexedIndirectCommand);
+			VK_CHECK_RESULT(vulkanDevice->createBuffer(VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, &stagingBuffer, bufferSize, indirectCommands.data()));
+			VK_CHECK_RESULT(vulkanDevice->createBuffer(VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, &indirectCommandsBuffer, bufferSize));
+			vulkanDevice->copyBuffer(&stagingBuffer, &indirectCommandsBuffer, queue);
+			stagingBuffer.destroy();
+		}
 	}
 
 	void buildCommandBuffers()
@@ -498,132 +542,8 @@ public:
 		{
 			VK_CHECK_RESULT(vkBeginCommandBuffer(drawCmdBuffers[i], &cmdBufInfo));
 
-			/*
-				Offscreen SSAO generation
-			*/
-			{
-				// Clear values for all attachments written in the fragment shader
-				std::vector<VkClearValue> clearValues(4);
-				clearValues[0].color = { { 0.0f, 0.0f, 0.0f, 1.0f } };
-				clearValues[1].color = { { 0.0f, 0.0f, 0.0f, 1.0f } };
-				clearValues[2].color = { { 0.0f, 0.0f, 0.0f, 1.0f } };
-				clearValues[3].depthStencil = { 1.0f, 0 };
-
-				VkRenderPassBeginInfo renderPassBeginInfo = vks::initializers::renderPassBeginInfo();
-				renderPassBeginInfo.renderPass = frameBuffers.offscreen.renderPass;
-				renderPassBeginInfo.framebuffer = frameBuffers.offscreen.frameBuffer;
-				renderPassBeginInfo.renderArea.extent.width = frameBuffers.offscreen.width;
-				renderPassBeginInfo.renderArea.extent.height = frameBuffers.offscreen.height;
-				renderPassBeginInfo.clearValueCount = static_cast<uint32_t>(clearValues.size());
-				renderPassBeginInfo.pClearValues = clearValues.data();
-
-				/*
-					First pass: Fill G-Buffer components (positions+depth, normals, albedo) using MRT
-				*/
-
-				vkCmdBeginRenderPass(drawCmdBuffers[i], &renderPassBeginInfo, VK_SUBPASS_CONTENTS_INLINE);
-
-				VkViewport viewport = vks::initializers::viewport((float)frameBuffers.offscreen.width, (float)frameBuffers.offscreen.height, 0.0f, 1.0f);
-				vkCmdSetViewport(drawCmdBuffers[i], 0, 1, &viewport);
-
-				VkRect2D scissor = vks::initializers::rect2D(frameBuffers.offscreen.width, frameBuffers.offscreen.height, 0, 0);
-				vkCmdSetScissor(drawCmdBuffers[i], 0, 1, &scissor);
-
-				vkCmdBindPipeline(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pipelines.offscreen);
-
-				vkCmdBindDescriptorSets(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayouts.gBuffer, 0, 1, &descriptorSets.floor, 0, NULL);
-				scene.draw(drawCmdBuffers[i], vkglTF::RenderFlags::BindImages, pipelineLayouts.gBuffer);
-
-				vkCmdEndRenderPass(drawCmdBuffers[i]);
-
-				/*
-					Second pass: SSAO generation
-				*/
-
-				clearValues[0].color = { { 0.0f, 0.0f, 0.0f, 1.0f } };
-				clearValues[1].depthStencil = { 1.0f, 0 };
-
-				renderPassBeginInfo.framebuffer = frameBuffers.ssao.frameBuffer;
-				renderPassBeginInfo.renderPass = frameBuffers.ssao.renderPass;
-				renderPassBeginInfo.renderArea.extent.width = frameBuffers.ssao.width;
-				renderPassBeginInfo.renderArea.extent.height = frameBuffers.ssao.height;
-				renderPassBeginInfo.clearValueCount = 2;
-				renderPassBeginInfo.pClearValues = clearValues.data();
-
-				vkCmdBeginRenderPass(drawCmdBuffers[i], &renderPassBeginInfo, VK_SUBPASS_CONTENTS_INLINE);
-
-				viewport = vks::initializers::viewport((float)frameBuffers.ssao.width, (float)frameBuffers.ssao.height, 0.0f, 1.0f);
-				vkCmdSetViewport(drawCmdBuffers[i], 0, 1, &viewport);
-				scissor = vks::initializers::rect2D(frameBuffers.ssao.width, frameBuffers.ssao.height, 0, 0);
-				vkCmdSetScissor(drawCmdBuffers[i], 0, 1, &scissor);
-
-				vkCmdBindDescriptorSets(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayouts.ssao, 0, 1, &descriptorSets.ssao, 0, NULL);
-				vkCmdBindPipeline(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pipelines.ssao);
-				vkCmdDraw(drawCmdBuffers[i], 3, 1, 0, 0);
-
-				vkCmdEndRenderPass(drawCmdBuffers[i]);
-
-				/*
-					Third pass: SSAO blur
-				*/
-
-				renderPassBeginInfo.framebuffer = frameBuffers.ssaoBlur.frameBuffer;
-				renderPassBeginInfo.renderPass = frameBuffers.ssaoBlur.renderPass;
-				renderPassBeginInfo.renderArea.extent.width = frameBuffers.ssaoBlur.width;
-				renderPassBeginInfo.renderArea.extent.height = frameBuffers.ssaoBlur.height;
-
-				vkCmdBeginRenderPass(drawCmdBuffers[i], &renderPassBeginInfo, VK_SUBPASS_CONTENTS_INLINE);
-
-				viewport = vks::initializers::viewport((float)frameBuffers.ssaoBlur.width, (float)frameBuffers.ssaoBlur.height, 0.0f, 1.0f);
-				vkCmdSetViewport(drawCmdBuffers[i], 0, 1, &viewport);
-				scissor = vks::initializers::rect2D(frameBuffers.ssaoBlur.width, frameBuffers.ssaoBlur.height, 0, 0);
-				vkCmdSetScissor(drawCmdBuffers[i], 0, 1, &scissor);
-
-				vkCmdBindDescriptorSets(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayouts.ssaoBlur, 0, 1, &descriptorSets.ssaoBlur, 0, NULL);
-				vkCmdBindPipeline(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pipelines.ssaoBlur);
-				vkCmdDraw(drawCmdBuffers[i], 3, 1, 0, 0);
-
-				vkCmdEndRenderPass(drawCmdBuffers[i]);
-			}
-
-			/*
-				Note: Explicit synchronization is not required between the render pass, as this is done implicit via sub pass dependencies
-			*/
-
-			/*
-				Final render pass: Scene rendering with applied radial blur
-			*/
-			{
-				std::vector<VkClearValue> clearValues(2);
-				clearValues[0].color = defaultClearColor;
-				clearValues[1].depthStencil = { 1.0f, 0 };
-
-				VkRenderPassBeginInfo renderPassBeginInfo = vks::initializers::renderPassBeginInfo();
-				renderPassBeginInfo.renderPass = renderPass;
-				renderPassBeginInfo.framebuffer = VulkanExampleBase::frameBuffers[i];
-				renderPassBeginInfo.renderArea.extent.width = width;
-				renderPassBeginInfo.renderArea.extent.height = height;
-				renderPassBeginInfo.clearValueCount = 2;
-				renderPassBeginInfo.pClearValues = clearValues.data();
-
-				vkCmdBeginRenderPass(drawCmdBuffers[i], &renderPassBeginInfo, VK_SUBPASS_CONTENTS_INLINE);
-
-				VkViewport viewport = vks::initializers::viewport((float)width, (float)height, 0.0f, 1.0f);
-				vkCmdSetViewport(drawCmdBuffers[i], 0, 1, &viewport);
-
-				VkRect2D scissor = vks::initializers::rect2D(width, height, 0, 0);
-				vkCmdSetScissor(drawCmdBuffers[i], 0, 1, &scissor);
-
-				vkCmdBindDescriptorSets(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayouts.composition, 0, 1, &descriptorSets.composition, 0, NULL);
-
-				// Final composition pass
-				vkCmdBindPipeline(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pipelines.composition);
-				vkCmdDraw(drawCmdBuffers[i], 3, 1, 0, 0);
-
-				drawUI(drawCmdBuffers[i]);
-
-				vkCmdEndRenderPass(drawCmdBuffers[i]);
-			}
+			// Synchronization between the passes is derived by the render graph
+			renderGraph.execute(drawCmdBuffers[i], i);
 
 			VK_CHECK_RESULT(vkEndCommandBuffer(drawCmdBuffers[i]));
 		}
@@ -633,7 +553,7 @@ public:
 	{
 		std::vector<VkDescriptorPoolSize> poolSizes = {
 			vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 10),
-			vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 12)
+			vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 19)
 		};
 		VkDescriptorPoolCreateInfo descriptorPoolInfo = vks::initializers::descriptorPoolCreateInfo(poolSizes,  descriptorSets.count);
 		VK_CHECK_RESULT(vkCreateDescriptorPool(device, &descriptorPoolInfo, nullptr, &descriptorPool));
@@ -646,7 +566,6 @@ public:
 		VkPipelineLayoutCreateInfo pipelineLayoutCreateInfo = vks::initializers::pipelineLayoutCreateInfo();
 		VkDescriptorSetAllocateInfo descriptorAllocInfo = vks::initializers::descriptorSetAllocateInfo(descriptorPool, nullptr, 1);
 		std::vector<VkWriteDescriptorSet> writeDescriptorSets;
-		std::vector<VkDescriptorImageInfo> imageDescriptors;
 
 		// G-Buffer creation (offscreen scene rendering)
 		setLayoutBindings = {
@@ -659,6 +578,11 @@ public:
 		pipelineLayoutCreateInfo.pSetLayouts = setLayouts.data();
 		pipelineLayoutCreateInfo.setLayoutCount = 2;
 		VK_CHECK_RESULT(vkCreatePipelineLayout(device, &pipelineLayoutCreateInfo, nullptr, &pipelineLayouts.gBuffer));
+		if (bindlessSupported) {
+			const std::vector<VkDescriptorSetLayout> bindlessSetLayouts = { descriptorSetLayouts.gBuffer, vkglTF::descriptorSetLayoutBindless };
+			pipelineLayoutCreateInfo.pSetLayouts = bindlessSetLayouts.data();
+			VK_CHECK_RESULT(vkCreatePipelineLayout(device, &pipelineLayoutCreateInfo, nullptr, &pipelineLayouts.gBufferBindless));
+		}
 		descriptorAllocInfo.pSetLayouts = &descriptorSetLayouts.gBuffer;
 		VK_CHECK_RESULT(vkAllocateDescriptorSets(device, &descriptorAllocInfo, &descriptorSets.floor));
 		writeDescriptorSets = {
@@ -681,13 +605,7 @@ public:
 		VK_CHECK_RESULT(vkCreatePipelineLayout(device, &pipelineLayoutCreateInfo, nullptr, &pipelineLayouts.ssao));
 		descriptorAllocInfo.pSetLayouts = &descriptorSetLayouts.ssao;
 		VK_CHECK_RESULT(vkAllocateDescriptorSets(device, &descriptorAllocInfo, &descriptorSets.ssao));
-		imageDescriptors = {
-			vks::initializers::descriptorImageInfo(colorSampler, frameBuffers.offscreen.position.view, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL),
-			vks::initializers::descriptorImageInfo(colorSampler, frameBuffers.offscreen.normal.view, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL),
-		};
 		writeDescriptorSets = {
-			vks::initializers::writeDescriptorSet(descriptorSets.ssao, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 0, &imageDescriptors[0]),					// FS Position+Depth
-			vks::initializers::writeDescriptorSet(descriptorSets.ssao, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 1, &imageDescriptors[1]),					// FS Normals
 			vks::initializers::writeDescriptorSet(descriptorSets.ssao, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 2, &textures.ssaoNoise.descriptor),		// FS SSAO Noise
 			vks::initializers::writeDescriptorSet(descriptorSets.ssao, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 3, &uniformBuffers.ssaoKernel.descriptor),		// FS SSAO Kernel UBO
 			vks::initializers::writeDescriptorSet(descriptorSets.ssao, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 4, &uniformBuffers.ssaoParams.descriptor),		// FS SSAO Params UBO
@@ -704,14 +622,49 @@ public:
 		VK_CHECK_RESULT(vkCreatePipelineLayout(device, &pipelineLayoutCreateInfo, nullptr, &pipelineLayouts.ssaoBlur));
 		descriptorAllocInfo.pSetLayouts = &descriptorSetLayouts.ssaoBlur;
 		VK_CHECK_RESULT(vkAllocateDescriptorSets(device, &descriptorAllocInfo, &descriptorSets.ssaoBlur));
-		imageDescriptors = {
-			vks::initializers::descriptorImageInfo(colorSampler, frameBuffers.ssao.color.view, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL),
+
+		// SSAO Upsample
+		setLayoutBindings = {
+			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_FRAGMENT_BIT, 0),						// FS Position+Depth
+			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_FRAGMENT_BIT, 1),						// FS Normals
+			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_FRAGMENT_BIT, 2),						// FS Sampler SSAO
+		};
+		setLayoutCreateInfo = vks::initializers::descriptorSetLayoutCreateInfo(setLayoutBindings.data(), static_cast<uint32_t>(setLayoutBindings.size()));
+		VK_CHECK_RESULT(vkCreateDescriptorSetLayout(device, &setLayoutCreateInfo, nullptr, &descriptorSetLayouts.ssaoUpsample));
+		pipelineLayoutCreateInfo.pSetLayouts = &descriptorSetLayouts.ssaoUpsample;
+		VK_CHECK_RESULT(vkCreatePipelineLayout(device, &pipelineLayoutCreateInfo, nullptr, &pipelineLayouts.ssaoUpsample));
+		descriptorAllocInfo.pSetLayouts = &descriptorSetLayouts.ssaoUpsample;
+		VK_CHECK_RESULT(vkAllocateDescriptorSets(device, &descriptorAllocInfo, &descriptorSets.ssaoUpsample));
+
+		// SSAO Temporal accumulation
+		setLayoutBindings = {
+			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_FRAGMENT_BIT, 0),						// FS Position+Depth
+			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_FRAGMENT_BIT, 1),						// FS Sampler SSAO upsampled
+			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_FRAGMENT_BIT, 2),						// FS Sampler SSAO history
+			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, VK_SHADER_STAGE_FRAGMENT_BIT, 3),								// FS Params UBO
 		};
+		setLayoutCreateInfo = vks::initializers::descriptorSetLayoutCreateInfo(setLayoutBindings.data(), static_cast<uint32_t>(setLayoutBindings.size()));
+		VK_CHECK_RESULT(vkCreateDescriptorSetLayout(device, &setLayoutCreateInfo, nullptr, &descriptorSetLayouts.ssaoTemporal));
+		pipelineLayoutCreateInfo.pSetLayouts = &descriptorSetLayouts.ssaoTemporal;
+		VK_CHECK_RESULT(vkCreatePipelineLayout(device, &pipelineLayoutCreateInfo, nullptr, &pipelineLayouts.ssaoTemporal));
+		descriptorAllocInfo.pSetLayouts = &descriptorSetLayouts.ssaoTemporal;
+		VK_CHECK_RESULT(vkAllocateDescriptorSets(device, &descriptorAllocInfo, &descriptorSets.ssaoTemporal));
 		writeDescriptorSets = {
-			vks::initializers::writeDescriptorSet(descriptorSets.ssaoBlur, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 0, &imageDescriptors[0]),
+			vks::initializers::writeDescriptorSet(descriptorSets.ssaoTemporal, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 3, &uniformBuffers.ssaoParams.descriptor),	// FS SSAO Params UBO
 		};
 		vkUpdateDescriptorSets(device, static_cast<uint32_t>(writeDescriptorSets.size()), writeDescriptorSets.data(), 0, NULL);
 
+		// SSAO History copy
+		setLayoutBindings = {
+			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_FRAGMENT_BIT, 0),						// FS Sampler SSAO resolved
+		};
+		setLayoutCreateInfo = vks::initializers::descriptorSetLayoutCreateInfo(setLayoutBindings.data(), static_cast<uint32_t>(setLayoutBindings.size()));
+		VK_CHECK_RESULT(vkCreateDescriptorSetLayout(device, &setLayoutCreateInfo, nullptr, &descriptorSetLayouts.ssaoHistory));
+		pipelineLayoutCreateInfo.pSetLayouts = &descriptorSetLayouts.ssaoHistory;
+		VK_CHECK_RESULT(vkCreatePipelineLayout(device, &pipelineLayoutCreateInfo, nullptr, &pipelineLayouts.ssaoHistory));
+		descriptorAllocInfo.pSetLayouts = &descriptorSetLayouts.ssaoHistory;
+		VK_CHECK_RESULT(vkAllocateDescriptorSets(device, &descriptorAllocInfo, &descriptorSets.ssaoHistory));
+
 		// Composition
 		setLayoutBindings = {
 			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_FRAGMENT_BIT, 0),						// FS Position+Depth
@@ -727,21 +680,59 @@ public:
 		VK_CHECK_RESULT(vkCreatePipelineLayout(device, &pipelineLayoutCreateInfo, nullptr, &pipelineLayouts.composition));
 		descriptorAllocInfo.pSetLayouts = &descriptorSetLayouts.composition;
 		VK_CHECK_RESULT(vkAllocateDescriptorSets(device, &descriptorAllocInfo, &descriptorSets.composition));
-		imageDescriptors = {
-			vks::initializers::descriptorImageInfo(colorSampler, frameBuffers.offscreen.position.view, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL),
-			vks::initializers::descriptorImageInfo(colorSampler, frameBuffers.offscreen.normal.view, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL),
-			vks::initializers::descriptorImageInfo(colorSampler, frameBuffers.offscreen.albedo.view, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL),
-			vks::initializers::descriptorImageInfo(colorSampler, frameBuffers.ssao.color.view, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL),
-			vks::initializers::descriptorImageInfo(colorSampler, frameBuffers.ssaoBlur.color.view, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL),
-		};
 		writeDescriptorSets = {
+			vks::initializers::writeDescriptorSet(descriptorSets.composition, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 5, &uniformBuffers.ssaoParams.descriptor),	// FS SSAO Params UBO
+		};
+		vkUpdateDescriptorSets(device, static_cast<uint32_t>(writeDescriptorSets.size()), writeDescriptorSets.data(), 0, NULL);
+
+		updateImageDescriptors();
+	}
+
+	// Graph images are recreated whenever the graph is compiled
+	void updateImageDescriptors()
+	{
+		// Images only accessed by culled passes don't exist, the noise texture stands in for them in descriptors that are not read
+		const std::string occlusion = aoTarget();
+		const bool ssaoCulled = renderGraph.isCulled("ssao");
+		const bool upsampleCulled = renderGraph.isCulled("ssaoUpsample");
+		const bool temporalCulled = renderGraph.isCulled("ssaoTemporal");
+		std::array<VkDescriptorImageInfo, 8> imageDescriptors = {
+			vks::initializers::descriptorImageInfo(colorSampler, renderGraph.imageView("position"), VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL),
+			vks::initializers::descriptorImageInfo(colorSampler, renderGraph.imageView("normal"), VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL),
+			vks::initializers::descriptorImageInfo(colorSampler, renderGraph.imageView("albedo"), VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL),
+			occlusion.empty() ? textures.ssaoNoise.descriptor : vks::initializers::descriptorImageInfo(colorSampler, renderGraph.imageView(occlusion), VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL),
+			ssaoCulled ? textures.ssaoNoise.descriptor : vks::initializers::descriptorImageInfo(colorSampler, renderGraph.imageView("ssao"), VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL),
+			upsampleCulled ? textures.ssaoNoise.descriptor : vks::initializers::descriptorImageInfo(colorSampler, renderGraph.imageView("aoUpsampled"), VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL),
+			vks::initializers::descriptorImageInfo(colorSampler, aoHistory.view, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL),
+			temporalCulled ? textures.ssaoNoise.descriptor : vks::initializers::descriptorImageInfo(colorSampler, renderGraph.imageView("aoResolved"), VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL),
+		};
+		std::vector<VkWriteDescriptorSet> writeDescriptorSets = {
 			vks::initializers::writeDescriptorSet(descriptorSets.composition, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 0, &imageDescriptors[0]),			// FS Sampler Position+Depth
 			vks::initializers::writeDescriptorSet(descriptorSets.composition, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 1, &imageDescriptors[1]),			// FS Sampler Normals
 			vks::initializers::writeDescriptorSet(descriptorSets.composition, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 2, &imageDescriptors[2]),			// FS Sampler Albedo
 			vks::initializers::writeDescriptorSet(descriptorSets.composition, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 3, &imageDescriptors[3]),			// FS Sampler SSAO
-			vks::initializers::writeDescriptorSet(descriptorSets.composition, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 4, &imageDescriptors[4]),			// FS Sampler SSAO blurred
-			vks::initializers::writeDescriptorSet(descriptorSets.composition, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 5, &uniformBuffers.ssaoParams.descriptor),	// FS SSAO Params UBO
+			vks::initializers::writeDescriptorSet(descriptorSets.composition, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 4, &imageDescriptors[3]),			// FS Sampler SSAO blurred
 		};
+		if (!ssaoCulled) {
+			writeDescriptorSets.push_back(vks::initializers::writeDescriptorSet(descriptorSets.ssao, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 0, &imageDescriptors[0]));	// FS Position+Depth
+			writeDescriptorSets.push_back(vks::initializers::writeDescriptorSet(descriptorSets.ssao, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 1, &imageDescriptors[1]));	// FS Normals
+		}
+		if (!renderGraph.isCulled("ssaoBlur")) {
+			writeDescriptorSets.push_back(vks::initializers::writeDescriptorSet(descriptorSets.ssaoBlur, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 0, &imageDescriptors[4]));	// FS Sampler SSAO
+		}
+		if (!upsampleCulled) {
+			writeDescriptorSets.push_back(vks::initializers::writeDescriptorSet(descriptorSets.ssaoUpsample, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 0, &imageDescriptors[0]));	// FS Position+Depth
+			writeDescriptorSets.push_back(vks::initializers::writeDescriptorSet(descriptorSets.ssaoUpsample, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 1, &imageDescriptors[1]));	// FS Normals
+			writeDescriptorSets.push_back(vks::initializers::writeDescriptorSet(descriptorSets.ssaoUpsample, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 2, &imageDescriptors[4]));	// FS Sampler SSAO
+		}
+		if (!temporalCulled) {
+			writeDescriptorSets.push_back(vks::initializers::writeDescriptorSet(descriptorSets.ssaoTemporal, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 0, &imageDescriptors[0]));	// FS Position+Depth
+			writeDescriptorSets.push_back(vks::initializers::writeDescriptorSet(descriptorSets.ssaoTemporal, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 1, &imageDescriptors[5]));	// FS Sampler SSAO upsampled
+			writeDescriptorSets.push_back(vks::initializers::writeDescriptorSet(descriptorSets.ssaoTemporal, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 2, &imageDescriptors[6]));	// FS Sampler SSAO history
+		}
+		if (!renderGraph.isCulled("ssaoHistory")) {
+			writeDescriptorSets.push_back(vks::initializers::writeDescriptorSet(descriptorSets.ssaoHistory, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 0, &imageDescriptors[7]));	// FS Sampler SSAO resolved
+		}
 		vkUpdateDescriptorSets(device, static_cast<uint32_t>(writeDescriptorSets.size()), writeDescriptorSets.data(), 0, NULL);
 	}
 
@@ -758,7 +749,7 @@ public:
 		VkPipelineDynamicStateCreateInfo dynamicState = vks::initializers::pipelineDynamicStateCreateInfo(dynamicStateEnables);
 		std::array<VkPipelineShaderStageCreateInfo, 2> shaderStages;
 
-		VkGraphicsPipelineCreateInfo pipelineCreateInfo = vks::initializers::pipelineCreateInfo( pipelineLayouts.composition, renderPass, 0);
+		VkGraphicsPipelineCreateInfo pipelineCreateInfo = vks::initializers::pipelineCreateInfo(pipelineLayouts.composition, renderGraph.renderPass("composition"), renderGraph.subpass("composition"));
 		pipelineCreateInfo.pInputAssemblyState = &inputAssemblyState;
 		pipelineCreateInfo.pRasterizationState = &rasterizationState;
 		pipelineCreateInfo.pColorBlendState = &colorBlendState;
@@ -781,7 +772,7 @@ public:
 
 		// SSAO generation pipeline
 		{
-			pipelineCreateInfo.renderPass = frameBuffers.ssao.renderPass;
+			pipelineCreateInfo.renderPass = renderGraph.renderPass("ssao");
 			pipelineCreateInfo.layout = pipelineLayouts.ssao;
 			// SSAO Kernel size and radius are constant for this pipeline, so we set them using specialization constants
 			struct SpecializationData {
@@ -800,17 +791,35 @@ public:
 
 		// SSAO blur pipeline
 		{
-			pipelineCreateInfo.renderPass = frameBuffers.ssaoBlur.renderPass;
+			pipelineCreateInfo.renderPass = renderGraph.renderPass("ssaoBlur");
 			pipelineCreateInfo.layout = pipelineLayouts.ssaoBlur;
 			shaderStages[1] = loadShader(getShadersPath() + "ssao/blur.frag.spv", VK_SHADER_STAGE_FRAGMENT_BIT);
 			VK_CHECK_RESULT(vkCreateGraphicsPipelines(device, pipelineCache, 1, &pipelineCreateInfo, nullptr, &pipelines.ssaoBlur));
 		}
 
+		// Production mode upsample, temporal accumulation and history copy pipelines
+		{
+			pipelineCreateInfo.renderPass = renderGraph.renderPass("ssaoUpsample");
+			pipelineCreateInfo.layout = pipelineLayouts.ssaoUpsample;
+			shaderStages[1] = loadShader(getShadersPath() + "ssao/upsample.frag.spv", VK_SHADER_STAGE_FRAGMENT_BIT);
+			VK_CHECK_RESULT(vkCreateGraphicsPipelines(device, pipelineCache, 1, &pipelineCreateInfo, nullptr, &pipelines.ssaoUpsample));
+
+			pipelineCreateInfo.renderPass = renderGraph.renderPass("ssaoTemporal");
+			pipelineCreateInfo.layout = pipelineLayouts.ssaoTemporal;
+			shaderStages[1] = loadShader(getShadersPath() + "ssao/temporal.frag.spv", VK_SHADER_STAGE_FRAGMENT_BIT);
+			VK_CHECK_RESULT(vkCreateGraphicsPipelines(device, pipelineCache, 1, &pipelineCreateInfo, nullptr, &pipelines.ssaoTemporal));
+
+			pipelineCreateInfo.renderPass = renderGraph.renderPass("ssaoHistory");
+			pipelineCreateInfo.layout = pipelineLayouts.ssaoHistory;
+			shaderStages[1] = loadShader(getShadersPath() + "ssao/history.frag.spv", VK_SHADER_STAGE_FRAGMENT_BIT);
+			VK_CHECK_RESULT(vkCreateGraphicsPipelines(device, pipelineCache, 1, &pipelineCreateInfo, nullptr, &pipelines.ssaoHistory));
+		}
+
 		// Fill G-Buffer pipeline
 		{
 			// Vertex input state from glTF model loader
 			pipelineCreateInfo.pVertexInputState = vkglTF::Vertex::getPipelineVertexInputState({ vkglTF::VertexComponent::Position, vkglTF::VertexComponent::UV, vkglTF::VertexComponent::Color, vkglTF::VertexComponent::Normal });
-			pipelineCreateInfo.renderPass = frameBuffers.offscreen.renderPass;
+			pipelineCreateInfo.renderPass = renderGraph.renderPass("gbuffer");
 			pipelineCreateInfo.layout = pipelineLayouts.gBuffer;
 			// Blend attachment states required for all color attachments
 			// This is important, as color write mask will otherwise be 0x0 and you
@@ -826,6 +835,14 @@ public:
 			shaderStages[0] = loadShader(getShadersPath() + "ssao/gbuffer.vert.spv", VK_SHADER_STAGE_VERTEX_BIT);
 			shaderStages[1] = loadShader(getShadersPath() + "ssao/gbuffer.frag.spv", VK_SHADER_STAGE_FRAGMENT_BIT);
 			VK_CHECK_RESULT(vkCreateGraphicsPipelines(device, pipelineCache, 1, &pipelineCreateInfo, nullptr, &pipelines.offscreen));
+
+			// Same output, with the material fetched through the instance index
+			if (bindlessSupported) {
+				pipelineCreateInfo.layout = pipelineLayouts.gBufferBindless;
+				shaderStages[0] = loadShader(getShadersPath() + "ssao/gbuffer_bindless.vert.spv", VK_SHADER_STAGE_VERTEX_BIT);
+				shaderStages[1] = loadShader(getShadersPath() + "ssao/gbuffer_bindless.frag.spv", VK_SHADER_STAGE_FRAGMENT_BIT);
+				VK_CHECK_RESULT(vkCreateGraphicsPipelines(device, pipelineCache, 1, &pipelineCreateInfo, nullptr, &pipelines.offscreenBindless));
+			}
 		}
 	}
 
@@ -860,13 +877,21 @@ public:
 		std::uniform_real_distribution<float> rndDist(0.0f, 1.0f);
 
 		// Sample kernel
+		// The scale of sample i is taken from the bit reversed index, so the first n samples used in production mode
+		// are spread over the whole radius instead of all lying close to the center
 		std::vector<glm::vec4> ssaoKernel(SSAO_KERNEL_SIZE);
 		for (uint32_t i = 0; i < SSAO_KERNEL_SIZE; ++i)
 		{
 			glm::vec3 sample(rndDist(rndEngine) * 2.0 - 1.0, rndDist(rndEngine) * 2.0 - 1.0, rndDist(rndEngine));
 			sample = glm::normalize(sample);
 			sample *= rndDist(rndEngine);
-			float scale = float(i) / float(SSAO_KERNEL_SIZE);
+			uint32_t reversed = 0;
+			for (uint32_t bit = 1, mirrored = SSAO_KERNEL_SIZE / 2; bit < SSAO_KERNEL_SIZE; bit <<= 1, mirrored >>= 1) {
+				if (i & bit) {
+					reversed |= mirrored;
+				}
+			}
+			float scale = float(reversed) / float(SSAO_KERNEL_SIZE);
 			scale = lerp(0.1f, 1.0f, scale * scale);
 			ssaoKernel[i] = glm::vec4(sample * scale, 0.0f);
 		}
@@ -903,6 +928,7 @@ public:
 	void updateUniformBufferSSAOParams()
 	{
 		uboSSAOParams.projection = camera.matrices.perspective;
+		uboSSAOParams.sampleCount = uboSSAOParams.production ? aoSampleCounts[aoSampleCount] : SSAO_KERNEL_SIZE;
 
 		VK_CHECK_RESULT(uniformBuffers.ssaoParams.map());
 		uniformBuffers.ssaoParams.copyTo(&uboSSAOParams, sizeof(uboSSAOParams));
@@ -916,17 +942,36 @@ public:
 		submitInfo.pCommandBuffers = &drawCmdBuffers[currentBuffer];
 		VK_CHECK_RESULT(vkQueueSubmit(queue, 1, &submitInfo, VK_NULL_HANDLE));
 		VulkanExampleBase::submitFrame();
+		// The frame has finished at this point, so its timestamps can be read
+		renderGraph.updateTimings(currentBuffer);
+	}
+
+	// Temporal accumulation needs the camera movement since the last frame and a new kernel rotation every frame
+	void updateTemporalParams()
+	{
+		uboSSAOParams.viewToPreviousView = previousView * glm::inverse(camera.matrices.view);
+		previousView = camera.matrices.view;
+		uboSSAOParams.frameIndex++;
+		updateUniformBufferSSAOParams();
 	}
 
 	void prepare()
 	{
 		VulkanExampleBase::prepare();
 		loadAssets();
-		prepareOffscreenFramebuffers();
+		prepareColorSampler();
 		prepareUniformBuffers();
+		createHistoryImage();
+		// Pipelines are created with the render passes of a graph that keeps all passes alive
+		// Render passes of later compiles are compatible with these
+		renderGraph.prepare(vulkanDevice);
+		prepareRenderGraph(true);
 		setupDescriptorPool();
 		setupLayoutsAndDescriptors();
 		preparePipelines();
+		prepareRenderGraph();
+		updateImageDescriptors();
+		prepareUIPipeline();
 		buildCommandBuffers();
 		prepared = true;
 	}
@@ -936,7 +981,15 @@ public:
 		if (!prepared) {
 			return;
 		}
+		if (uboSSAOParams.production) {
+			updateTemporalParams();
+		}
 		draw();
+		// The history now contains this frame, unless temporal accumulation was disabled
+		if (uboSSAOParams.historyValid != (uboSSAOParams.production && temporalAccumulation)) {
+			uboSSAOParams.historyValid = uboSSAOParams.production && temporalAccumulation;
+			updateUniformBufferSSAOParams();
+		}
 		if (camera.updated) {
 			updateUniformBufferMatrices();
 			updateUniformBufferSSAOParams();
@@ -951,17 +1004,80 @@ public:
 
 	virtual void OnUpdateUIOverlay(vks::UIOverlay *overlay)
 	{
+		bool passesChanged = false;
 		if (overlay->header("Settings")) {
 			if (overlay->checkBox("Enable SSAO", &uboSSAOParams.ssao)) {
 				updateUniformBufferSSAOParams();
-			}
-			if (overlay->checkBox("SSAO blur", &uboSSAOParams.ssaoBlur)) {
-				updateUniformBufferSSAOParams();
+				passesChanged = true;
 			}
 			if (overlay->checkBox("SSAO pass only", &uboSSAOParams.ssaoOnly)) {
 				updateUniformBufferSSAOParams();
+				passesChanged = true;
+			}
+			if (overlay->comboBox("Mode", &uboSSAOParams.production, { "Reference", "Production" })) {
+				passesChanged = true;
+			}
+			if (!uboSSAOParams.production) {
+				if (overlay->checkBox("SSAO blur", &uboSSAOParams.ssaoBlur)) {
+					updateUniformBufferSSAOParams();
+					passesChanged = true;
+				}
+			} else {
+				passesChanged |= overlay->comboBox("Resolution", &aoResolution, { "Full", "Half", "Quarter" });
+				std::vector<std::string> sampleCounts;
+				for (auto count : aoSampleCounts) {
+					sampleCounts.push_back(std::to_string(count));
+				}
+				if (overlay->comboBox("Samples per pixel", &aoSampleCount, sampleCounts)) {
+					updateUniformBufferSSAOParams();
+				}
+				passesChanged |= overlay->checkBox("Temporal accumulation", &temporalAccumulation);
+				if (temporalAccumulation && overlay->sliderFloat("Current frame weight", &uboSSAOParams.temporalWeight, 0.02f, 1.0f)) {
+					updateUniformBufferSSAOParams();
+				}
+			}
+			// Per pass times of the whole frame are listed in the render graph header
+			float aoTime = 0.0f;
+			for (auto pass : { "ssao", "ssaoBlur", "ssaoUpsample", "ssaoTemporal", "ssaoHistory" }) {
+				if (!renderGraph.isCulled(pass)) {
+					overlay->text("%s: %.3f ms", pass, renderGraph.passTime(pass));
+					aoTime += renderGraph.passTime(pass);
+				}
+			}
+			overlay->text("Ambient occlusion GPU time: %.3f ms", aoTime);
+		}
+		if (overlay->header("Scene drawing")) {
+			// Command buffers are rebuilt by the base class, which measures the recording of the new mode
+			if (bindlessSupported) {
+				std::vector<std::string> modes = { "Descriptor sets", "Bindless" };
+				if (vulkanDevice->enabledFeatures.drawIndirectFirstInstance) {
+					modes.push_back("Bindless indirect");
+				}
+				overlay->comboBox("Materials", &materialBinding, modes);
+			}
+			if (materialBinding != MaterialBindlessIndirect) {
+				overlay->checkBox("Sorted render queue", &useRenderQueue);
+			}
+			overlay->text("Scene record time: %.3f ms", sceneRecordTime);
+			if (useRenderQueue && (materialBinding != MaterialBindlessIndirect)) {
+				const vks::RenderQueue::Statistics &stats = renderQueue.statistics;
+				overlay->text("Build %.3f ms, sort %.3f ms, record %.3f ms", stats.buildTime, stats.sortTime, stats.recordTime);
+				overlay->text("Draws: %d", stats.draws);
+				overlay->text("Pipeline binds: %d", stats.pipelineBinds);
+				overlay->text("Descriptor set binds: %d (%d skipped)", stats.descriptorSetBinds, stats.redundantBinds);
+				overlay->text("Buffer binds: %d", stats.bufferBinds);
 			}
 		}
+		passesChanged |= renderGraph.updateUIOverlay(overlay);
+		// Command buffers are rebuilt by the base class after any UI change
+		if (passesChanged) {
+			vkDeviceWaitIdle(device);
+			// Images of the graph are recreated, so the history doesn't contain the previous frame anymore
+			uboSSAOParams.historyValid = false;
+			updateUniformBufferSSAOParams();
+			prepareRenderGraph();
+			updateImageDescriptors();
+		}
 	}
 };
 
@@ -22,6 +22,8 @@ public:
 		VkImageView view;
 		uint32_t width, height;
 		uint32_t mipLevels;
+		// Set if the texture can be written by the compute mip generator (format, size and storage usage)
+		bool computeSupported = false;
 	} texture;
 
 	// To demonstrate mip mapping and filtering this example uses separate samplers
@@ -46,6 +48,20 @@ public:
 	VkDescriptorSet descriptorSet;
 	VkDescriptorSetLayout descriptorSetLayout;
 
+	// The mip chain can either be generated with a chain of blits (one per level) or with a single compute dispatch
+	enum MipGenerationMode { MipGenerationBlit = 0, MipGenerationCompute = 1 };
+	int32_t mipGenerationMode = MipGenerationCompute;
+	std::vector<std::string> mipGenerationModeNames{ "Blit chain", "Compute (single pass)" };
+
+	// GPU timings of both methods, averaged over a number of regenerations
+	VkQueryPool queryPool = VK_NULL_HANDLE;
+	const uint32_t benchmarkIterations = 32;
+	struct MipGenerationTimings {
+		double blit = 0.0;
+		double compute = 0.0;
+		bool valid = false;
+	} mipGenerationTimings;
+
 	VulkanExample() : VulkanExampleBase(ENABLE_VALIDATION)
 	{
 		title = "Runtime mip map generation";
@@ -65,6 +81,9 @@ public:
 		vkDestroyPipelineLayout(device, pipelineLayout, nullptr);
 		vkDestroyDescriptorSetLayout(device, descriptorSetLayout, nullptr);
 		uniformBufferVS.destroy();
+		if (queryPool != VK_NULL_HANDLE) {
+			vkDestroyQueryPool(device, queryPool, nullptr);
+		}
 		for (auto sampler : samplers)
 		{
 			vkDestroySampler(device, sampler, nullptr);
@@ -122,6 +141,11 @@ public:
 		// Mip-chain generation requires support for blit source and destination
 		assert(formatProperties.optimalTilingFeatures & VK_FORMAT_FEATURE_BLIT_SRC_BIT);
 		assert(formatProperties.optimalTilingFeatures & VK_FORMAT_FEATURE_BLIT_DST_BIT);
+		// Compute generation writes the mip levels as storage images
+		texture.computeSupported = mipGenerator.supported(format, texture.width, texture.height, texture.mipLevels);
+		if (!texture.computeSupported) {
+			mipGenerationMode = MipGenerationBlit;
+		}
 
 		VkMemoryAllocateInfo memAllocInfo = vks::initializers::memoryAllocateInfo();
 		VkMemoryRequirements memReqs = {};
@@ -160,6 +184,10 @@ public:
 		imageCreateInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
 		imageCreateInfo.extent = { texture.width, texture.height, 1 };
 		imageCreateInfo.usage = VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
+		if (texture.computeSupported) {
+			imageCreateInfo.usage |= VK_IMAGE_USAGE_STORAGE_BIT;
+			imageCreateInfo.flags |= vks::MipGenerator::imageCreateFlags(format);
+		}
 		VK_CHECK_RESULT(vkCreateImage(device, &imageCreateInfo, nullptr, &texture.image));
 		vkGetImageMemoryRequirements(device, texture.image, &memReqs);
 		memAllocInfo.allocationSize = memReqs.size;
@@ -198,18 +226,6 @@ public:
 
 		vkCmdCopyBufferToImage(copyCmd, stagingBuffer, texture.image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &bufferCopyRegion);
 
-		// Transition first mip level to transfer source for read during blit
-		vks::tools::insertImageMemoryBarrier(
-			copyCmd,
-			texture.image,
-			VK_ACCESS_TRANSFER_WRITE_BIT,
-			VK_ACCESS_TRANSFER_READ_BIT,
-			VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
-			VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
-			VK_PIPELINE_STAGE_TRANSFER_BIT,
-			VK_PIPELINE_STAGE_TRANSFER_BIT,
-			subresourceRange);
-
 		vulkanDevice->flushCommandBuffer(copyCmd, queue, true);
 
 		// Clean up staging resources
@@ -217,11 +233,73 @@ public:
 		vkDestroyBuffer(device, stagingBuffer, nullptr);
 		ktxTexture_Destroy(ktxTexture);
 
-		// Generate the mip chain
-		// ---------------------------------------------------------------
-		// We copy down the whole mip chain doing a blit from mip-1 to mip
-		// An alternative way would be to always blit from the first mip level and sample that one down
-		VkCommandBuffer blitCmd = vulkanDevice->createCommandBuffer(VK_COMMAND_BUFFER_LEVEL_PRIMARY, true);
+		// Generate the mip chain from the first level
+		generateMipChain(static_cast<MipGenerationMode>(mipGenerationMode), VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL);
+
+		// Create samplers
+		samplers.resize(3);
+		VkSamplerCreateInfo sampler = vks::initializers::samplerCreateInfo();
+		sampler.magFilter = VK_FILTER_LINEAR;
+		sampler.minFilter = VK_FILTER_LINEAR;
+		sampler.mipmapMode = VK_SAMPLER_MIPMAP_MODE_LINEAR;
+		sampler.addressModeU = VK_SAMPLER_ADDRESS_MODE_MIRRORED_REPEAT;
+		sampler.addressModeV = VK_SAMPLER_ADDRESS_MODE_MIRRORED_REPEAT;
+		sampler.addressModeW = VK_SAMPLER_ADDRESS_MODE_MIRRORED_REPEAT;
+		sampler.mipLodBias = 0.0f;
+		sampler.compareOp = VK_COMPARE_OP_NEVER;
+		sampler.minLod = 0.0f;
+		sampler.maxLod = 0.0f;
+		sampler.borderColor = VK_BORDER_COLOR_FLOAT_OPAQUE_WHITE;
+		sampler.maxAnisotropy = 1.0;
+		sampler.anisotropyEnable = VK_FALSE;
+
+		// Without mip mapping
+		VK_CHECK_RESULT(vkCreateSampler(device, &sampler, nullptr, &samplers[0]));
+
+		// With mip mapping
+		sampler.maxLod = (float)texture.mipLevels;
+		VK_CHECK_RESULT(vkCreateSampler(device, &sampler, nullptr, &samplers[1]));
+
+		// With mip mapping and anisotropic filtering
+		if (vulkanDevice->features.samplerAnisotropy)
+		{
+			sampler.maxAnisotropy = vulkanDevice->properties.limits.maxSamplerAnisotropy;
+			sampler.anisotropyEnable = VK_TRUE;
+		}
+		VK_CHECK_RESULT(vkCreateSampler(device, &sampler, nullptr, &samplers[2]));
+
+		// Create image view
+		VkImageViewCreateInfo view = vks::initializers::imageViewCreateInfo();
+		view.image = texture.image;
+		view.viewType = VK_IMAGE_VIEW_TYPE_2D;
+		view.format = format;
+		view.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+		view.subresourceRange.baseMipLevel = 0;
+		view.subresourceRange.baseArrayLayer = 0;
+		view.subresourceRange.layerCount = 1;
+		view.subresourceRange.levelCount = texture.mipLevels;
+		VK_CHECK_RESULT(vkCreateImageView(device, &view, nullptr, &texture.view));
+	}
+
+	// Generate the mip chain with a blit from mip-1 to mip, with a pipeline barrier between each level
+	void recordBlitChain(VkCommandBuffer blitCmd, VkImageLayout baseLevelLayout)
+	{
+		VkImageSubresourceRange subresourceRange = {};
+		subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+		subresourceRange.levelCount = 1;
+		subresourceRange.layerCount = 1;
+
+		// Transition first mip level to transfer source for read during blit
+		vks::tools::insertImageMemoryBarrier(
+			blitCmd,
+			texture.image,
+			VK_ACCESS_MEMORY_WRITE_BIT,
+			VK_ACCESS_TRANSFER_READ_BIT,
+			baseLevelLayout,
+			VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+			VK_PIPELINE_STAGE_ALL_COMMANDS_BIT,
+			VK_PIPELINE_STAGE_TRANSFER_BIT,
+			subresourceRange);
 
 		// Copy down mips from n-1 to n
 		for (int32_t i = 1; i < texture.mipLevels; i++)
@@ -258,7 +336,7 @@ public:
 				VK_ACCESS_TRANSFER_WRITE_BIT,
 				VK_IMAGE_LAYOUT_UNDEFINED,
 				VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
-				VK_PIPELINE_STAGE_TRANSFER_BIT,
+				VK_PIPELINE_STAGE_ALL_COMMANDS_BIT,
 				VK_PIPELINE_STAGE_TRANSFER_BIT,
 				mipSubRange);
 
@@ -298,53 +376,57 @@ public:
 			VK_PIPELINE_STAGE_TRANSFER_BIT,
 			VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
 			subresourceRange);
+	}
 
-		vulkanDevice->flushCommandBuffer(blitCmd, queue, true);
-		// ---------------------------------------------------------------
-
-		// Create samplers
-		samplers.resize(3);
-		VkSamplerCreateInfo sampler = vks::initializers::samplerCreateInfo();
-		sampler.magFilter = VK_FILTER_LINEAR;
-		sampler.minFilter = VK_FILTER_LINEAR;
-		sampler.mipmapMode = VK_SAMPLER_MIPMAP_MODE_LINEAR;
-		sampler.addressModeU = VK_SAMPLER_ADDRESS_MODE_MIRRORED_REPEAT;
-		sampler.addressModeV = VK_SAMPLER_ADDRESS_MODE_MIRRORED_REPEAT;
-		sampler.addressModeW = VK_SAMPLER_ADDRESS_MODE_MIRRORED_REPEAT;
-		sampler.mipLodBias = 0.0f;
-		sampler.compareOp = VK_COMPARE_OP_NEVER;
-		sampler.minLod = 0.0f;
-		sampler.maxLod = 0.0f;
-		sampler.borderColor = VK_BORDER_COLOR_FLOAT_OPAQUE_WHITE;
-		sampler.maxAnisotropy = 1.0;
-		sampler.anisotropyEnable = VK_FALSE;
+	// Generate the mip chain with the selected method, returns the GPU time it took in milliseconds
+	double generateMipChain(MipGenerationMode mode, VkImageLayout baseLevelLayout)
+	{
+		if (queryPool == VK_NULL_HANDLE) {
+			VkQueryPoolCreateInfo queryPoolInfo = {};
+			queryPoolInfo.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+			queryPoolInfo.queryType = VK_QUERY_TYPE_TIMESTAMP;
+			queryPoolInfo.queryCount = 2;
+			VK_CHECK_RESULT(vkCreateQueryPool(device, &queryPoolInfo, nullptr, &queryPool));
+		}
 
-		// Without mip mapping
-		VK_CHECK_RESULT(vkCreateSampler(device, &sampler, nullptr, &samplers[0]));
+		VkCommandBuffer cmdBuffer = vulkanDevice->createCommandBuffer(VK_COMMAND_BUFFER_LEVEL_PRIMARY, true);
+		vkCmdResetQueryPool(cmdBuffer, queryPool, 0, 2);
+		vkCmdWriteTimestamp(cmdBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, queryPool, 0);
+		if (mode == MipGenerationCompute) {
+			// All levels are written by a single dispatch
+			mipGenerator.add(texture.image, VK_FORMAT_R8G8B8A8_UNORM, texture.width, texture.height, texture.mipLevels, vks::MipGenerator::FilterLinear, baseLevelLayout, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+			mipGenerator.record(cmdBuffer);
+		} else {
+			recordBlitChain(cmdBuffer, baseLevelLayout);
+		}
+		vkCmdWriteTimestamp(cmdBuffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, queryPool, 1);
+		vulkanDevice->flushCommandBuffer(cmdBuffer, queue, true);
+		mipGenerator.release();
 
-		// With mip mapping
-		sampler.maxLod = (float)texture.mipLevels;
-		VK_CHECK_RESULT(vkCreateSampler(device, &sampler, nullptr, &samplers[1]));
+		uint64_t timestamps[2] = {};
+		VK_CHECK_RESULT(vkGetQueryPoolResults(device, queryPool, 0, 2, sizeof(timestamps), timestamps, sizeof(uint64_t), VK_QUERY_RESULT_64_BIT | VK_QUERY_RESULT_WAIT_BIT));
+		return double(timestamps[1] - timestamps[0]) * vulkanDevice->properties.limits.timestampPeriod / 1000000.0;
+	}
 
-		// With mip mapping and anisotropic filtering
-		if (vulkanDevice->features.samplerAnisotropy)
-		{
-			sampler.maxAnisotropy = vulkanDevice->properties.limits.maxSamplerAnisotropy;
-			sampler.anisotropyEnable = VK_TRUE;
+	// Regenerate the mip chain repeatedly with both methods and average their GPU times
+	void benchmarkMipGeneration()
+	{
+		vkQueueWaitIdle(queue);
+		mipGenerationTimings = {};
+		for (uint32_t i = 0; i < benchmarkIterations; i++) {
+			mipGenerationTimings.blit += generateMipChain(MipGenerationBlit, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL) / benchmarkIterations;
+			if (texture.computeSupported) {
+				mipGenerationTimings.compute += generateMipChain(MipGenerationCompute, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL) / benchmarkIterations;
+			}
 		}
-		VK_CHECK_RESULT(vkCreateSampler(device, &sampler, nullptr, &samplers[2]));
-
-		// Create image view
-		VkImageViewCreateInfo view = vks::initializers::imageViewCreateInfo();
-		view.image = texture.image;
-		view.viewType = VK_IMAGE_VIEW_TYPE_2D;
-		view.format = format;
-		view.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-		view.subresourceRange.baseMipLevel = 0;
-		view.subresourceRange.baseArrayLayer = 0;
-		view.subresourceRange.layerCount = 1;
-		view.subresourceRange.levelCount = texture.mipLevels;
-		VK_CHECK_RESULT(vkCreateImageView(device, &view, nullptr, &texture.view));
+		mipGenerationTimings.valid = true;
+		// Leave the chain generated by the selected method
+		generateMipChain(static_cast<MipGenerationMode>(mipGenerationMode), VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+		std::cout << "Mip generation (" << texture.width << "x" << texture.height << ", " << texture.mipLevels << " levels): blit chain " << mipGenerationTimings.blit << " ms";
+		if (texture.computeSupported) {
+			std::cout << ", compute single pass " << mipGenerationTimings.compute << " ms";
+		}
+		std::cout << "\n";
 	}
 
 	// Free all Vulkan resources used a texture object
@@ -553,6 +635,9 @@ public:
 		setupDescriptorPool();
 		setupDescriptorSet();
 		buildCommandBuffers();
+		if (benchmark.active) {
+			benchmarkMipGeneration();
+		}
 		prepared = true;
 	}
 
@@ -577,6 +662,25 @@ public:
 				updateUniformBuffers();
 			}
 		}
+		if (overlay->header("Mip generation")) {
+			if (texture.computeSupported) {
+				if (overlay->comboBox("Method", &mipGenerationMode, mipGenerationModeNames)) {
+					vkQueueWaitIdle(queue);
+					generateMipChain(static_cast<MipGenerationMode>(mipGenerationMode), VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+				}
+			} else {
+				overlay->text("Compute shader not available, using blits");
+			}
+			if (overlay->button("Run benchmark")) {
+				benchmarkMipGeneration();
+			}
+			if (mipGenerationTimings.valid) {
+				overlay->text("Blit chain: %.3f ms", mipGenerationTimings.blit);
+				if (texture.computeSupported) {
+					overlay->text("Compute: %.3f ms", mipGenerationTimings.compute);
+				}
+			}
+		}
 	}
 };
 
@@ -28,44 +28,70 @@ bool VirtualTexturePage::resident()
 	return (imageMemoryBind.memory != VK_NULL_HANDLE);
 }
 
-// Allocate Vulkan memory for the virtual page
-bool VirtualTexturePage::allocate(VkDevice device, uint32_t memoryTypeIndex)
+// Back the virtual page with a slot of the physical page cache
+void VirtualTexturePage::bind(VkDeviceMemory memory, VkDeviceSize memoryOffset, uint32_t slot)
 {
-	if (imageMemoryBind.memory != VK_NULL_HANDLE)
-	{
-		return false;
-	};
+	physicalSlot = slot;
+	imageMemoryBind.memory = memory;
+	imageMemoryBind.memoryOffset = memoryOffset;
+}
 
-	imageMemoryBind = {};
+// Remove the memory backing, the page becomes non-resident with the next sparse binding
+void VirtualTexturePage::unbind()
+{
+	physicalSlot = invalidSlot;
+	imageMemoryBind.memory = VK_NULL_HANDLE;
+	imageMemoryBind.memoryOffset = 0;
+}
 
+/*
+	Physical page cache
+	Allocates the memory budget for all resident pages at once and hands out page sized slots
+ */
+
+void PhysicalPageCache::create(VkDevice device, VkDeviceSize pageSize, uint32_t capacity, uint32_t memoryTypeIndex)
+{
+	this->pageSize = pageSize;
+	this->capacity = capacity;
 	VkMemoryAllocateInfo allocInfo = vks::initializers::memoryAllocateInfo();
-	allocInfo.allocationSize = size;
+	allocInfo.allocationSize = pageSize * capacity;
 	allocInfo.memoryTypeIndex = memoryTypeIndex;
-	VK_CHECK_RESULT(vkAllocateMemory(device, &allocInfo, nullptr, &imageMemoryBind.memory));
-
-	VkImageSubresource subResource{};
-	subResource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-	subResource.mipLevel = mipLevel;
-	subResource.arrayLayer = layer;
+	VK_CHECK_RESULT(vkAllocateMemory(device, &allocInfo, nullptr, &memory));
+	// Hand out low slots first
+	freeSlots.resize(capacity);
+	for (uint32_t i = 0; i < capacity; i++) {
+		freeSlots[i] = capacity - 1 - i;
+	}
+}
 
-	// Sparse image memory binding
-	imageMemoryBind.subresource = subResource;
-	imageMemoryBind.extent = extent;
-	imageMemoryBind.offset = offset;
-	return true;
+void PhysicalPageCache::destroy(VkDevice device)
+{
+	if (memory != VK_NULL_HANDLE) {
+		vkFreeMemory(device, memory, nullptr);
+		memory = VK_NULL_HANDLE;
+	}
+	freeSlots.clear();
 }
 
-// Release Vulkan memory allocated for this page
-bool VirtualTexturePage::release(VkDevice device)
+// Returns VirtualTexturePage::invalidSlot if the cache is full
+uint32_t PhysicalPageCache::acquire()
 {
-	del= false;
-	if (imageMemoryBind.memory != VK_NULL_HANDLE)
-	{
-		vkFreeMemory(device, imageMemoryBind.memory, nullptr);
-		imageMemoryBind.memory = VK_NULL_HANDLE;
-		return true;
+	if (freeSlots.empty()) {
+		return VirtualTexturePage::invalidSlot;
 	}
-	return false;
+	uint32_t slot = freeSlots.back();
+	freeSlots.pop_back();
+	return slot;
+}
+
+void PhysicalPageCache::release(uint32_t slot)
+{
+	freeSlots.push_back(slot);
+}
+
+uint32_t PhysicalPageCache::used() const
+{
+	return capacity - static_cast<uint32_t>(freeSlots.size());
 }
 
 /*
@@ -85,30 +111,22 @@ VirtualTexturePage* VirtualTexture::addPage(VkOffset3D offset, VkExtent3D extent
 	newPage.imageMemoryBind = {};
 	newPage.imageMemoryBind.offset = offset;
 	newPage.imageMemoryBind.extent = extent;
-	newPage.del = false;
 	pages.push_back(newPage);
 	return &pages.back();
 }
 
 // Call before sparse binding to update memory bind list etc.
-void VirtualTexture::updateSparseBindInfo(std::vector<VirtualTexturePage> &bindingChangedPages, bool del)
+// Pages without memory are unbound, the mip tail only needs to be bound once
+void VirtualTexture::updateSparseBindInfo(std::vector<VirtualTexturePage> &bindingChangedPages, bool bindMipTail)
 {
 	// Update list of memory-backed sparse image memory binds
-	//sparseImageMemoryBinds.resize(pages.size());
 	sparseImageMemoryBinds.clear();
-	for (auto page : bindingChangedPages)
+	for (auto &page : bindingChangedPages)
 	{
 		sparseImageMemoryBinds.push_back(page.imageMemoryBind);
-		if (del)
-		{
-			sparseImageMemoryBinds[sparseImageMemoryBinds.size() - 1].memory = VK_NULL_HANDLE;
-		}
 	}
 	// Update sparse bind info
 	bindSparseInfo = vks::initializers::bindSparseInfo();
-	// todo: Semaphore for queue submission
-	// bindSparseInfo.signalSemaphoreCount = 1;
-	// bindSparseInfo.pSignalSemaphores = &bindSparseSemaphore;
 
 	// Image memory binds
 	imageMemoryBindInfo = {};
@@ -122,25 +140,36 @@ void VirtualTexture::updateSparseBindInfo(std::vector<VirtualTexturePage> &bindi
 	opaqueMemoryBindInfo.image = image;
 	opaqueMemoryBindInfo.bindCount = static_cast<uint32_t>(opaqueMemoryBinds.size());
 	opaqueMemoryBindInfo.pBinds = opaqueMemoryBinds.data();
-	bindSparseInfo.imageOpaqueBindCount = (opaqueMemoryBindInfo.bindCount > 0) ? 1 : 0;
+	bindSparseInfo.imageOpaqueBindCount = (bindMipTail && (opaqueMemoryBindInfo.bindCount > 0)) ? 1 : 0;
 	bindSparseInfo.pImageOpaqueBinds = &opaqueMemoryBindInfo;
 }
 
+// Returns the page of the next coarser mip level covering the given page, or nullptr if that level is part of the mip tail
+VirtualTexturePage* VirtualTexture::parentPage(const VirtualTexturePage &page)
+{
+	const uint32_t parentLevel = page.mipLevel + 1;
+	if (parentLevel >= mipTailStart) {
+		return nullptr;
+	}
+	const MipPages &mip = mipPages[page.mipLevel];
+	const MipPages &parentMip = mipPages[parentLevel];
+	const uint32_t x = std::min(((page.index - mip.firstPage) % mip.pagesX) / 2, parentMip.pagesX - 1);
+	const uint32_t y = std::min(((page.index - mip.firstPage) / mip.pagesX) / 2, parentMip.pagesY - 1);
+	return &pages[parentMip.firstPage + y * parentMip.pagesX + x];
+}
+
 // Release all Vulkan resources
 void VirtualTexture::destroy()
 {
-	for (auto page : pages)
+	for (auto &page : pages)
 	{
-		page.release(device);
+		page.unbind();
 	}
+	pageCache.destroy(device);
 	for (auto bind : opaqueMemoryBinds)
 	{
 		vkFreeMemory(device, bind.memory, nullptr);
 	}
-	// Clean up mip tail
-	if (mipTailimageMemoryBind.memory != VK_NULL_HANDLE) {
-		vkFreeMemory(device, mipTailimageMemoryBind.memory, nullptr);
-	}
 }
 
 /*
@@ -160,6 +189,19 @@ VulkanExample::~VulkanExample()
 {
 	// Clean up used Vulkan resources
 	// Note : Inherited destructor cleans up resources stored in base class
+	if (feedback.thread.joinable()) {
+		{
+			std::lock_guard<std::mutex> lock(feedback.mutex);
+			feedback.terminate = true;
+		}
+		feedback.condition.notify_all();
+		feedback.thread.join();
+	}
+	for (auto& buffer : feedback.buffers) {
+		buffer.destroy();
+	}
+	streaming.stagingBuffer.destroy();
+	uniformBufferPageTable.destroy();
 	destroyTextureImage(texture);
 	vkDestroySemaphore(device, bindSparseSemaphore, nullptr);
 	vkDestroyPipeline(device, pipeline, nullptr);
@@ -178,6 +220,10 @@ void VulkanExample::getEnabledFeatures()
 	else {
 		std::cout << "Sparse binding not supported" << std::endl;
 	}
+	// Required for writing the page request feedback from the fragment shader
+	if (deviceFeatures.fragmentStoresAndAtomics) {
+		enabledFeatures.fragmentStoresAndAtomics = VK_TRUE;
+	}
 }
 
 glm::uvec3 VulkanExample::alignedDivision(const VkExtent3D& extent, const VkExtent3D& granularity)
@@ -347,6 +393,9 @@ void VulkanExample::prepareSparseTexture(uint32_t width, uint32_t height, uint32
 			// Aligned sizes by image granularity
 			VkExtent3D imageGranularity = sparseMemoryReq.formatProperties.imageGranularity;
 			glm::uvec3 sparseBindCounts = alignedDivision(extent, imageGranularity);
+			if (layer == 0) {
+				texture.mipPages.push_back({ static_cast<uint32_t>(texture.pages.size()), sparseBindCounts.x, sparseBindCounts.y });
+			}
 			glm::uvec3 lastBlockExtent;
 			lastBlockExtent.x = (extent.width % imageGranularity.width) ? extent.width % imageGranularity.width : imageGranularity.width;
 			lastBlockExtent.y = (extent.height % imageGranularity.height) ? extent.height % imageGranularity.height : imageGranularity.height;
@@ -404,9 +453,14 @@ void VulkanExample::prepareSparseTexture(uint32_t width, uint32_t height, uint32
 		}
 	} // end layers and mips
 
+	// All resident pages share one fixed allocation, the budget is rounded down to whole pages
+	const uint32_t cacheCapacity = std::max(static_cast<uint32_t>((static_cast<VkDeviceSize>(streaming.budgetMB) * 1024 * 1024) / sparseImageMemoryReqs.alignment), 1u);
+	texture.pageCache.create(device, sparseImageMemoryReqs.alignment, std::min(cacheCapacity, static_cast<uint32_t>(texture.pages.size())), texture.memoryTypeIndex);
+
 	std::cout << "Texture info:" << std::endl;
 	std::cout << "\tDim: " << texture.width << " x " << texture.height << std::endl;
 	std::cout << "\tVirtual pages: " << texture.pages.size() << std::endl;
+	std::cout << "\tPhysical page cache: " << texture.pageCache.capacity << " pages (" << (texture.pageCache.capacity * texture.pageCache.pageSize) / (1024 * 1024) << " MB)" << std::endl;
 
 	// Check if format has one mip tail for all layers
 	if ((sparseMemoryReq.formatProperties.flags & VK_SPARSE_IMAGE_FORMAT_SINGLE_MIPTAIL_BIT) && (sparseMemoryReq.imageMipTailFirstLod < texture.mipLevels))
@@ -432,14 +486,11 @@ void VulkanExample::prepareSparseTexture(uint32_t width, uint32_t height, uint32
 	VkSemaphoreCreateInfo semaphoreCreateInfo = vks::initializers::semaphoreCreateInfo();
 	VK_CHECK_RESULT(vkCreateSemaphore(device, &semaphoreCreateInfo, nullptr, &bindSparseSemaphore));
 
-	// Prepare bind sparse info for reuse in queue submission
-	texture.updateSparseBindInfo(texture.pages);
-
-	// Bind to queue
-	// todo: in draw?
-	vkQueueBindSparse(queue, 1, &texture.bindSparseInfo, VK_NULL_HANDLE);
-	//todo: use sparse bind semaphore
-	vkQueueWaitIdle(queue);
+	// Initial binding only contains the mip tail, pages are bound on demand by the streaming
+	std::vector<VirtualTexturePage> noPages;
+	texture.updateSparseBindInfo(noPages);
+	VK_CHECK_RESULT(vkQueueBindSparse(queue, 1, &texture.bindSparseInfo, VK_NULL_HANDLE));
+	VK_CHECK_RESULT(vkQueueWaitIdle(queue));
 
 	// Create sampler
 	VkSamplerCreateInfo sampler = vks::initializers::samplerCreateInfo();
@@ -486,7 +537,10 @@ void VulkanExample::destroyTextureImage(SparseTexture texture)
 	texture.destroy();
 }
 
-void VulkanExample::buildCommandBuffers()
+// Records the command buffer for a single frame
+// Pages streamed in this frame are copied from the staging buffer before the scene is drawn, and the feedback written by the
+// fragment shader is made available to the host afterwards
+void VulkanExample::buildCommandBuffer(uint32_t index)
 {
 	VkCommandBufferBeginInfo cmdBufInfo = vks::initializers::commandBufferBeginInfo();
 
@@ -502,40 +556,89 @@ void VulkanExample::buildCommandBuffers()
 	renderPassBeginInfo.renderArea.extent.height = height;
 	renderPassBeginInfo.clearValueCount = 2;
 	renderPassBeginInfo.pClearValues = clearValues;
+	renderPassBeginInfo.framebuffer = frameBuffers[index];
 
-	for (int32_t i = 0; i < drawCmdBuffers.size(); ++i)
-	{
-		renderPassBeginInfo.framebuffer = frameBuffers[i];
+	VkCommandBuffer cmdBuffer = drawCmdBuffers[index];
+	VK_CHECK_RESULT(vkBeginCommandBuffer(cmdBuffer, &cmdBufInfo));
+
+	// All page uploads of this frame are done with a single copy
+	if (!streaming.copyRegions.empty()) {
+		vks::tools::setImageLayout(cmdBuffer, texture.image, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, texture.subRange, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT);
+		vkCmdCopyBufferToImage(cmdBuffer, streaming.stagingBuffer.buffer, texture.image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, static_cast<uint32_t>(streaming.copyRegions.size()), streaming.copyRegions.data());
+		vks::tools::setImageLayout(cmdBuffer, texture.image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, texture.subRange, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT);
+	}
 
-		VK_CHECK_RESULT(vkBeginCommandBuffer(drawCmdBuffers[i], &cmdBufInfo));
+	vkCmdBeginRenderPass(cmdBuffer, &renderPassBeginInfo, VK_SUBPASS_CONTENTS_INLINE);
 
-		vkCmdBeginRenderPass(drawCmdBuffers[i], &renderPassBeginInfo, VK_SUBPASS_CONTENTS_INLINE);
+	VkViewport viewport = vks::initializers::viewport((float)width, (float)height, 0.0f, 1.0f);
+	vkCmdSetViewport(cmdBuffer, 0, 1, &viewport);
 
-		VkViewport viewport = vks::initializers::viewport((float)width, (float)height, 0.0f, 1.0f);
-		vkCmdSetViewport(drawCmdBuffers[i], 0, 1, &viewport);
+	VkRect2D scissor = vks::initializers::rect2D(width, height, 0, 0);
+	vkCmdSetScissor(cmdBuffer, 0, 1, &scissor);
 
-		VkRect2D scissor = vks::initializers::rect2D(width, height, 0, 0);
-		vkCmdSetScissor(drawCmdBuffers[i], 0, 1, &scissor);
+	vkCmdBindDescriptorSets(cmdBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 0, 1, &feedback.descriptorSets[feedback.currentBuffer], 0, NULL);
+	vkCmdBindPipeline(cmdBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline);
+	plane.draw(cmdBuffer);
 
-		vkCmdBindDescriptorSets(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 0, 1, &descriptorSet, 0, NULL);
-		vkCmdBindPipeline(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline);
-		plane.draw(drawCmdBuffers[i]);
+	drawUI(cmdBuffer);
 
-		drawUI(drawCmdBuffers[i]);
+	vkCmdEndRenderPass(cmdBuffer);
 
-		vkCmdEndRenderPass(drawCmdBuffers[i]);
+	// Make the page requests visible to the feedback thread
+	VkMemoryBarrier memoryBarrier = vks::initializers::memoryBarrier();
+	memoryBarrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+	memoryBarrier.dstAccessMask = VK_ACCESS_HOST_READ_BIT;
+	vkCmdPipelineBarrier(cmdBuffer, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, VK_PIPELINE_STAGE_HOST_BIT, 0, 1, &memoryBarrier, 0, nullptr, 0, nullptr);
 
-		VK_CHECK_RESULT(vkEndCommandBuffer(drawCmdBuffers[i]));
+	VK_CHECK_RESULT(vkEndCommandBuffer(cmdBuffer));
+}
+
+void VulkanExample::buildCommandBuffers()
+{
+	for (int32_t i = 0; i < drawCmdBuffers.size(); ++i)
+	{
+		buildCommandBuffer(i);
 	}
 }
 
 void VulkanExample::draw()
 {
 	VulkanExampleBase::prepareFrame();
+
+	// The feedback buffer written this frame must have been read back and cleared by the worker thread
+	{
+		std::unique_lock<std::mutex> lock(feedback.mutex);
+		feedback.condition.wait(lock, [this] { return !feedback.busy[feedback.currentBuffer]; });
+	}
+
+	applyFeedback();
+	streamPages();
+	buildCommandBuffer(currentBuffer);
+
+	// Wait for this frame's sparse binding batch before sampling the newly bound pages
+	std::array<VkSemaphore, 2> waitSemaphores = { semaphores.presentComplete, bindSparseSemaphore };
+	std::array<VkPipelineStageFlags, 2> waitStages = { VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT };
+	submitInfo.waitSemaphoreCount = streaming.bindSubmitted ? 2 : 1;
+	submitInfo.pWaitSemaphores = waitSemaphores.data();
+	submitInfo.pWaitDstStageMask = waitStages.data();
 	submitInfo.commandBufferCount = 1;
 	submitInfo.pCommandBuffers = &drawCmdBuffers[currentBuffer];
 	VK_CHECK_RESULT(vkQueueSubmit(queue, 1, &submitInfo, VK_NULL_HANDLE));
+	submitInfo.waitSemaphoreCount = 1;
+	submitInfo.pWaitSemaphores = &semaphores.presentComplete;
+	submitInfo.pWaitDstStageMask = &submitPipelineStages;
 	VulkanExampleBase::submitFrame();
+
+	// The frame has finished executing (submitFrame waits for the queue), hand its feedback to the worker thread
+	streaming.copyRegions.clear();
+	streaming.bindSubmitted = false;
+	{
+		std::lock_guard<std::mutex> lock(feedback.mutex);
+		feedback.busy[feedback.currentBuffer] = true;
+		feedback.submissions.push_back({ feedback.currentBuffer, ++feedback.frame });
+	}
+	feedback.condition.notify_all();
+	feedback.currentBuffer = (feedback.currentBuffer + 1) % feedbackBufferCount;
 }
 
 void VulkanExample::loadAssets()
@@ -546,18 +649,19 @@ void VulkanExample::loadAssets()
 
 void VulkanExample::setupDescriptorPool()
 {
-	// Example uses one ubo and one image sampler
+	// One descriptor set per feedback buffer, each with two ubos, one image sampler and the feedback storage buffer
 	std::vector<VkDescriptorPoolSize> poolSizes =
 	{
-		vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 1),
-		vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 1)
+		vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 2 * feedbackBufferCount),
+		vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, feedbackBufferCount),
+		vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, feedbackBufferCount)
 	};
 
 	VkDescriptorPoolCreateInfo descriptorPoolInfo =
 		vks::initializers::descriptorPoolCreateInfo(
 			static_cast<uint32_t>(poolSizes.size()),
 			poolSizes.data(),
-			2);
+			feedbackBufferCount);
 
 	VK_CHECK_RESULT(vkCreateDescriptorPool(device, &descriptorPoolInfo, nullptr, &descriptorPool));
 }
@@ -575,7 +679,17 @@ void VulkanExample::setupDescriptorSetLayout()
 		vks::initializers::descriptorSetLayoutBinding(
 			VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
 			VK_SHADER_STAGE_FRAGMENT_BIT,
-			1)
+			1),
+		// Binding 2 : Fragment shader page request feedback buffer
+		vks::initializers::descriptorSetLayoutBinding(
+			VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+			VK_SHADER_STAGE_FRAGMENT_BIT,
+			2),
+		// Binding 3 : Fragment shader page table layout
+		vks::initializers::descriptorSetLayoutBinding(
+			VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER,
+			VK_SHADER_STAGE_FRAGMENT_BIT,
+			3)
 	};
 
 	VkDescriptorSetLayoutCreateInfo descriptorLayout =
@@ -595,31 +709,46 @@ void VulkanExample::setupDescriptorSetLayout()
 
 void VulkanExample::setupDescriptorSet()
 {
-	VkDescriptorSetAllocateInfo allocInfo =
-		vks::initializers::descriptorSetAllocateInfo(
-			descriptorPool,
-			&descriptorSetLayout,
-			1);
-
-	VK_CHECK_RESULT(vkAllocateDescriptorSets(device, &allocInfo, &descriptorSet));
-
-	std::vector<VkWriteDescriptorSet> writeDescriptorSets =
+	for (uint32_t i = 0; i < feedbackBufferCount; i++)
 	{
-		// Binding 0 : Vertex shader uniform buffer
-		vks::initializers::writeDescriptorSet(
-			descriptorSet,
-			VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER,
-			0,
-			&uniformBufferVS.descriptor),
-		// Binding 1 : Fragment shader texture sampler
-		vks::initializers::writeDescriptorSet(
-			descriptorSet,
-			VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
-			1,
-			&texture.descriptor)
-	};
+		VkDescriptorSetAllocateInfo allocInfo =
+			vks::initializers::descriptorSetAllocateInfo(
+				descriptorPool,
+				&descriptorSetLayout,
+				1);
+
+		VK_CHECK_RESULT(vkAllocateDescriptorSets(device, &allocInfo, &feedback.descriptorSets[i]));
 
-	vkUpdateDescriptorSets(device, static_cast<uint32_t>(writeDescriptorSets.size()), writeDescriptorSets.data(), 0, NULL);
+		std::vector<VkWriteDescriptorSet> writeDescriptorSets =
+		{
+			// Binding 0 : Vertex shader uniform buffer
+			vks::initializers::writeDescriptorSet(
+				feedback.descriptorSets[i],
+				VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER,
+				0,
+				&uniformBufferVS.descriptor),
+			// Binding 1 : Fragment shader texture sampler
+			vks::initializers::writeDescriptorSet(
+				feedback.descriptorSets[i],
+				VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+				1,
+				&texture.descriptor),
+			// Binding 2 : Fragment shader page request feedback buffer
+			vks::initializers::writeDescriptorSet(
+				feedback.descriptorSets[i],
+				VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+				2,
+				&feedback.buffers[i].descriptor),
+			// Binding 3 : Fragment shader page table layout
+			vks::initializers::writeDescriptorSet(
+				feedback.descriptorSets[i],
+				VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER,
+				3,
+				&uniformBufferPageTable.descriptor)
+		};
+
+		vkUpdateDescriptorSets(device, static_cast<uint32_t>(writeDescriptorSets.size()), writeDescriptorSets.data(), 0, NULL);
+	}
 }
 
 void VulkanExample::preparePipelines()
@@ -663,6 +792,20 @@ void VulkanExample::prepareUniformBuffers()
 		sizeof(uboVS),
 		&uboVS));
 
+	// Page grid of all mip levels outside of the mip tail, used by the fragment shader to map texels to page indices
+	assert(texture.mipPages.size() <= 16);
+	const VkExtent3D granularity = texture.sparseImageMemoryRequirements.formatProperties.imageGranularity;
+	for (size_t i = 0; i < texture.mipPages.size(); i++) {
+		uboPageTable.mips[i] = glm::uvec4(texture.mipPages[i].firstPage, texture.mipPages[i].pagesX, texture.mipPages[i].pagesY, 0);
+	}
+	uboPageTable.info = glm::uvec4(granularity.width, granularity.height, texture.mipTailStart, 0);
+	VK_CHECK_RESULT(vulkanDevice->createBuffer(
+		VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
+		VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+		&uniformBufferPageTable,
+		sizeof(uboPageTable),
+		&uboPageTable));
+
 	updateUniformBuffers();
 }
 
@@ -677,6 +820,34 @@ void VulkanExample::updateUniformBuffers()
 	uniformBufferVS.unmap();
 }
 
+// Create the feedback buffers, the staging buffer for page uploads and start the feedback thread
+void VulkanExample::prepareFeedback()
+{
+	const VkDeviceSize feedbackSize = texture.pages.size() * sizeof(uint32_t);
+	for (auto& buffer : feedback.buffers) {
+		VK_CHECK_RESULT(vulkanDevice->createBuffer(
+			VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+			&buffer,
+			feedbackSize));
+		// Kept mapped, the feedback thread reads and clears the buffer directly
+		VK_CHECK_RESULT(buffer.map());
+		memset(buffer.mapped, 0, feedbackSize);
+	}
+
+	// One staging slot per page upload of a frame
+	const VkExtent3D granularity = texture.sparseImageMemoryRequirements.formatProperties.imageGranularity;
+	streaming.stagingPageSize = 4 * granularity.width * granularity.height;
+	VK_CHECK_RESULT(vulkanDevice->createBuffer(
+		VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+		VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+		&streaming.stagingBuffer,
+		streaming.stagingPageSize * streaming.stagingPages));
+	VK_CHECK_RESULT(streaming.stagingBuffer.map());
+
+	feedback.thread = std::thread(&VulkanExample::feedbackThreadFn, this);
+}
+
 void VulkanExample::prepare()
 {
 	VulkanExampleBase::prepare();
@@ -684,10 +855,15 @@ void VulkanExample::prepare()
 	if (!vulkanDevice->features.sparseResidencyImage2D) {
 		vks::tools::exitFatal("Device does not support sparse residency for 2D images!", VK_ERROR_FEATURE_NOT_PRESENT);
 	}
+	if (!vulkanDevice->features.fragmentStoresAndAtomics) {
+		vks::tools::exitFatal("Device does not support fragment shader stores, which are required for the page request feedback!", VK_ERROR_FEATURE_NOT_PRESENT);
+	}
 	loadAssets();
-	prepareUniformBuffers();
-	// Create a virtual texture with max. possible dimension (does not take up any VRAM yet)
+	// Create a virtual texture with max. possible dimension (only the mip tail and the page cache take up VRAM)
 	prepareSparseTexture(4096, 4096, 1, VK_FORMAT_R8G8B8A8_UNORM);
+	prepareUniformBuffers();
+	fillMipTail();
+	prepareFeedback();
 	setupDescriptorSetLayout();
 	preparePipelines();
 	setupDescriptorPool();
@@ -711,32 +887,46 @@ void VulkanExample::viewChanged()
 	updateUniformBuffers();
 }
 
-// Fills a buffer with random colors
-void VulkanExample::randomPattern(uint8_t* buffer, uint32_t width, uint32_t height)
+// Generates the content of a texture region
+// Content is deterministic, so a page looks the same after being evicted and streamed in again
+// Each mip level has its own tint to visualize the resident levels, the checkerboard is continuous across pages
+void VulkanExample::generatePageContent(uint8_t* buffer, uint32_t mipLevel, VkOffset3D offset, VkExtent3D extent)
 {
-	std::random_device rd;
-	std::mt19937 rndEngine(rd());
-	std::uniform_int_distribution<uint32_t> rndDist(0, 255);
-	uint8_t rndVal[4] = { 0, 0, 0, 0 };
-	while (rndVal[0] + rndVal[1] + rndVal[2] < 10) {
-		rndVal[0] = (uint8_t)rndDist(rndEngine);
-		rndVal[1] = (uint8_t)rndDist(rndEngine);
-		rndVal[2] = (uint8_t)rndDist(rndEngine);
-	}
-	rndVal[3] = 255;
-	for (uint32_t y = 0; y < height; y++) {
-		for (uint32_t x = 0; x < width; x++) {
-			for (uint32_t c = 0; c < 4; c++, ++buffer) {
-				*buffer = rndVal[c];
+	const std::array<glm::vec3, 8> palette = {
+		glm::vec3(1.0f, 0.3f, 0.3f), glm::vec3(0.3f, 1.0f, 0.3f), glm::vec3(0.3f, 0.3f, 1.0f), glm::vec3(1.0f, 1.0f, 0.3f),
+		glm::vec3(1.0f, 0.3f, 1.0f), glm::vec3(0.3f, 1.0f, 1.0f), glm::vec3(1.0f, 0.6f, 0.2f), glm::vec3(0.8f, 0.8f, 0.8f)
+	};
+	const glm::vec3 tint = palette[mipLevel % palette.size()];
+	const VkExtent3D granularity = texture.sparseImageMemoryRequirements.formatProperties.imageGranularity;
+	// Checker cells have the same size in texture space on all mip levels
+	const uint32_t cellSize = std::max(256u >> mipLevel, 1u);
+	for (uint32_t y = 0; y < extent.height; y++) {
+		for (uint32_t x = 0; x < extent.width; x++) {
+			const uint32_t tx = offset.x + x;
+			const uint32_t ty = offset.y + y;
+			float intensity = (((tx / cellSize) + (ty / cellSize)) % 2 == 0) ? 1.0f : 0.6f;
+			// Darken page borders
+			if ((tx % granularity.width == 0) || (ty % granularity.height == 0)) {
+				intensity *= 0.5f;
 			}
+			*buffer++ = static_cast<uint8_t>(tint.r * intensity * 255.0f);
+			*buffer++ = static_cast<uint8_t>(tint.g * intensity * 255.0f);
+			*buffer++ = static_cast<uint8_t>(tint.b * intensity * 255.0f);
+			*buffer++ = 255;
 		}
 	}
 }
 
-void VulkanExample::uploadContent(VirtualTexturePage page, VkImage image)
+// The mip tail is bound once and stays resident, it's the fallback for all pages that have not been streamed in yet
+void VulkanExample::fillMipTail()
 {
-	// Generate some random image data and upload as a buffer
-	const size_t bufferSize = 4 * page.extent.width * page.extent.height;
+	VkDeviceSize bufferSize = 0;
+	for (uint32_t i = texture.mipTailStart; i < texture.mipLevels; i++) {
+		bufferSize += 4 * std::max(texture.width >> i, 1u) * std::max(texture.height >> i, 1u);
+	}
+	if (bufferSize == 0) {
+		return;
+	}
 
 	vks::Buffer imageBuffer;
 	VK_CHECK_RESULT(vulkanDevice->createBuffer(
@@ -744,157 +934,192 @@ void VulkanExample::uploadContent(VirtualTexturePage page, VkImage image)
 		VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
 		&imageBuffer,
 		bufferSize));
-	imageBuffer.map();
+	VK_CHECK_RESULT(imageBuffer.map());
 
-	uint8_t* data = (uint8_t*)imageBuffer.mapped;
-	randomPattern(data, page.extent.height, page.extent.width);
+	// All levels of the mip tail are uploaded with a single copy
+	std::vector<VkBufferImageCopy> regions;
+	VkDeviceSize bufferOffset = 0;
+	for (uint32_t i = texture.mipTailStart; i < texture.mipLevels; i++) {
+		const uint32_t width = std::max(texture.width >> i, 1u);
+		const uint32_t height = std::max(texture.height >> i, 1u);
+		generatePageContent((uint8_t*)imageBuffer.mapped + bufferOffset, i, {}, { width, height, 1 });
+		VkBufferImageCopy region{};
+		region.bufferOffset = bufferOffset;
+		region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+		region.imageSubresource.layerCount = 1;
+		region.imageSubresource.mipLevel = i;
+		region.imageOffset = {};
+		region.imageExtent = { width, height, 1 };
+		regions.push_back(region);
+		bufferOffset += 4 * width * height;
+	}
 
 	VkCommandBuffer copyCmd = vulkanDevice->createCommandBuffer(VK_COMMAND_BUFFER_LEVEL_PRIMARY, true);
-	vks::tools::setImageLayout(copyCmd, image, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, texture.subRange, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT);
-	VkBufferImageCopy region{};
-	region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-	region.imageSubresource.layerCount = 1;
-	region.imageSubresource.mipLevel = page.mipLevel;
-	region.imageOffset = page.offset;
-	region.imageExtent = page.extent;
-	vkCmdCopyBufferToImage(copyCmd, imageBuffer.buffer, image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &region);
-	vks::tools::setImageLayout(copyCmd, image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, texture.subRange, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT);
+	vks::tools::setImageLayout(copyCmd, texture.image, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, texture.subRange, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT);
+	vkCmdCopyBufferToImage(copyCmd, imageBuffer.buffer, texture.image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, static_cast<uint32_t>(regions.size()), regions.data());
+	vks::tools::setImageLayout(copyCmd, texture.image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, texture.subRange, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT);
 	vulkanDevice->flushCommandBuffer(copyCmd, queue);
 
 	imageBuffer.destroy();
 }
 
-void VulkanExample::fillRandomPages()
+// Worker thread that reads back the feedback buffers of executed frames
+// Turns the per-page request flags into a list of requested pages (including the coarser pages covering them) and clears the buffer for reuse
+void VulkanExample::feedbackThreadFn()
 {
-	vkDeviceWaitIdle(device);
-
-	std::default_random_engine rndEngine(std::random_device{}());
-	std::uniform_real_distribution<float> rndDist(0.0f, 1.0f);
-
-	std::vector<VirtualTexturePage> updatedPages;
-	std::vector<VirtualTexturePage> bindingChangedPages;
-	for (auto& page : texture.pages) {
-		if (rndDist(rndEngine) < 0.5f) {
-			continue;
-		}
-		if (page.allocate(device, texture.memoryTypeIndex))
+	std::vector<uint8_t> requestedFlags(texture.pages.size());
+	std::vector<uint32_t> requestedPages;
+	while (true)
+	{
+		uint32_t bufferIndex;
+		uint64_t frame;
 		{
-			bindingChangedPages.push_back(page);
+			std::unique_lock<std::mutex> lock(feedback.mutex);
+			feedback.condition.wait(lock, [this] { return feedback.terminate || !feedback.submissions.empty(); });
+			if (feedback.terminate) {
+				return;
+			}
+			bufferIndex = feedback.submissions.front().first;
+			frame = feedback.submissions.front().second;
+			feedback.submissions.pop_front();
 		}
-		updatedPages.push_back(page);
-	}
 
-	// Update sparse queue binding
-	texture.updateSparseBindInfo(bindingChangedPages);
-	VkFenceCreateInfo fenceInfo = vks::initializers::fenceCreateInfo(VK_FLAGS_NONE);
-	VkFence fence;
-	VK_CHECK_RESULT(vkCreateFence(device, &fenceInfo, nullptr, &fence));
-	vkQueueBindSparse(queue, 1, &texture.bindSparseInfo, fence);
-	vkWaitForFences(device, 1, &fence, VK_TRUE, UINT64_MAX);
-	vkDestroyFence(device, fence, nullptr);
+		auto tStart = std::chrono::high_resolution_clock::now();
+		uint32_t* requests = (uint32_t*)feedback.buffers[bufferIndex].mapped;
+		std::fill(requestedFlags.begin(), requestedFlags.end(), 0);
+		requestedPages.clear();
+		for (uint32_t i = 0; i < static_cast<uint32_t>(texture.pages.size()); i++) {
+			if (requests[i] == 0) {
+				continue;
+			}
+			// Parents are requested too, so they aren't evicted while being used as the fallback for a page that's not yet resident
+			for (const VirtualTexturePage* page = &texture.pages[i]; (page != nullptr) && (requestedFlags[page->index] == 0); page = texture.parentPage(*page)) {
+				requestedFlags[page->index] = 1;
+				requestedPages.push_back(page->index);
+			}
+		}
+		memset(requests, 0, texture.pages.size() * sizeof(uint32_t));
+		auto tEnd = std::chrono::high_resolution_clock::now();
 
-	for (auto &page: updatedPages) {
-		uploadContent(page, texture.image);
+		{
+			std::lock_guard<std::mutex> lock(feedback.mutex);
+			feedback.requestedPages.swap(requestedPages);
+			feedback.resultAvailable = true;
+			feedback.resultFrame = frame;
+			feedback.readbackTime = std::chrono::duration<double, std::milli>(tEnd - tStart).count();
+			feedback.busy[bufferIndex] = false;
+		}
+		feedback.condition.notify_all();
 	}
 }
 
-void VulkanExample::fillMipTail()
+// Take the latest feedback result (if any) and update the LRU state and the list of pages to stream in
+void VulkanExample::applyFeedback()
 {
-	// Clean up previous mip tail memory allocation
-	if (texture.mipTailimageMemoryBind.memory != VK_NULL_HANDLE) {
-		vkFreeMemory(device, texture.mipTailimageMemoryBind.memory, nullptr);
+	std::vector<uint32_t> requestedPages;
+	{
+		std::lock_guard<std::mutex> lock(feedback.mutex);
+		if (!feedback.resultAvailable) {
+			return;
+		}
+		requestedPages.swap(feedback.requestedPages);
+		streaming.feedbackFrame = feedback.resultFrame;
+		feedback.resultAvailable = false;
 	}
 
-	//@todo: WIP
-	VkDeviceSize imageMipTailSize = texture.sparseImageMemoryRequirements.imageMipTailSize;
-	VkDeviceSize imageMipTailOffset = texture.sparseImageMemoryRequirements.imageMipTailOffset;
-	// Stride between memory bindings for each mip level if not single mip tail (VK_SPARSE_IMAGE_FORMAT_SINGLE_MIPTAIL_BIT not set)
-	VkDeviceSize imageMipTailStride = texture.sparseImageMemoryRequirements.imageMipTailStride;
-
-	VkMemoryAllocateInfo allocInfo = vks::initializers::memoryAllocateInfo();
-	allocInfo.allocationSize = imageMipTailSize;
-	allocInfo.memoryTypeIndex = texture.memoryTypeIndex;
-	VK_CHECK_RESULT(vkAllocateMemory(device, &allocInfo, nullptr, &texture.mipTailimageMemoryBind.memory));
-
-	uint32_t mipLevel = texture.sparseImageMemoryRequirements.imageMipTailFirstLod;
-	uint32_t width = std::max(texture.width >> texture.sparseImageMemoryRequirements.imageMipTailFirstLod, 1u);
-	uint32_t height = std::max(texture.height >> texture.sparseImageMemoryRequirements.imageMipTailFirstLod, 1u);
-	uint32_t depth = 1;
-
-	for (uint32_t i = texture.mipTailStart; i < texture.mipLevels; i++) {
-
-		const uint32_t width = std::max(texture.width >> i, 1u);
-		const uint32_t height = std::max(texture.height >> i, 1u);
-
-		// Generate some random image data and upload as a buffer
-		const size_t bufferSize = 4 * width * height;
-
-		vks::Buffer imageBuffer;
-		VK_CHECK_RESULT(vulkanDevice->createBuffer(
-			VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
-			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
-			&imageBuffer,
-			bufferSize));
-		imageBuffer.map();
-
-		// Fill buffer with random colors
-		std::random_device rd;
-		std::mt19937 rndEngine(rd());
-		std::uniform_int_distribution<uint32_t> rndDist(0, 255);
-		uint8_t* data = (uint8_t*)imageBuffer.mapped;
-		randomPattern(data, width, height);
-
-		VkCommandBuffer copyCmd = vulkanDevice->createCommandBuffer(VK_COMMAND_BUFFER_LEVEL_PRIMARY, true);
-		vks::tools::setImageLayout(copyCmd, texture.image, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, texture.subRange, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT);
-		VkBufferImageCopy region{};
-		region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-		region.imageSubresource.layerCount = 1;
-		region.imageSubresource.mipLevel = i;
-		region.imageOffset = {};
-		region.imageExtent = { width, height, 1 };
-		vkCmdCopyBufferToImage(copyCmd, imageBuffer.buffer, texture.image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &region);
-		vks::tools::setImageLayout(copyCmd, texture.image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, texture.subRange, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT);
-		vulkanDevice->flushCommandBuffer(copyCmd, queue);
-
-		imageBuffer.destroy();
+	statistics.requestedPages = static_cast<uint32_t>(requestedPages.size());
+	streaming.pendingPages.clear();
+	for (uint32_t index : requestedPages) {
+		VirtualTexturePage& page = texture.pages[index];
+		page.lastRequested = streaming.feedbackFrame;
+		if (!page.resident()) {
+			streaming.pendingPages.push_back(index);
+		}
 	}
+	// Coarse levels first, they cover the largest area and are the fallback for the finer levels
+	std::stable_sort(streaming.pendingPages.begin(), streaming.pendingPages.end(), [this](uint32_t a, uint32_t b) { return texture.pages[a].mipLevel > texture.pages[b].mipLevel; });
 }
 
-void VulkanExample::flushRandomPages()
+// Stream in a bounded number of pending pages
+// Pages that were not requested by the latest feedback are evicted (least recently requested first) once the page cache is full
+// All binding changes of a frame are submitted with a single sparse binding call, the uploads are recorded into the frame's command buffer
+void VulkanExample::streamPages()
 {
-	vkDeviceWaitIdle(device);
+	statistics.uploads = 0;
+	statistics.evictions = 0;
+	if (streaming.pendingPages.empty()) {
+		return;
+	}
 
-	std::default_random_engine rndEngine(std::random_device{}());
-	std::uniform_real_distribution<float> rndDist(0.0f, 1.0f);
+	auto tStart = std::chrono::high_resolution_clock::now();
 
-	std::vector<VirtualTexturePage> updatedPages;
 	std::vector<VirtualTexturePage> bindingChangedPages;
-	for (auto& page : texture.pages)
-	{
-		if (rndDist(rndEngine) < 0.5f) {
+	std::vector<uint32_t> evictionCandidates;
+	bool evictionCandidatesCollected = false;
+	size_t nextEvictionCandidate = 0;
+	const uint32_t maxUploads = std::min(static_cast<uint32_t>(streaming.maxUploadsPerFrame), streaming.stagingPages);
+	size_t pendingIndex = 0;
+	for (; (pendingIndex < streaming.pendingPages.size()) && (statistics.uploads < maxUploads); pendingIndex++) {
+		VirtualTexturePage& page = texture.pages[streaming.pendingPages[pendingIndex]];
+		if (page.resident()) {
 			continue;
 		}
-		if (page.imageMemoryBind.memory != VK_NULL_HANDLE){
-			page.del = true;
-			bindingChangedPages.push_back(page);
+		uint32_t slot = texture.pageCache.acquire();
+		if (slot == VirtualTexturePage::invalidSlot) {
+			if (!evictionCandidatesCollected) {
+				for (auto& residentPage : texture.pages) {
+					if (residentPage.resident() && (residentPage.lastRequested < streaming.feedbackFrame)) {
+						evictionCandidates.push_back(residentPage.index);
+					}
+				}
+				// Least recently requested first, finer levels first among pages of the same age
+				std::sort(evictionCandidates.begin(), evictionCandidates.end(), [this](uint32_t a, uint32_t b) {
+					const VirtualTexturePage& pageA = texture.pages[a];
+					const VirtualTexturePage& pageB = texture.pages[b];
+					return (pageA.lastRequested != pageB.lastRequested) ? (pageA.lastRequested < pageB.lastRequested) : (pageA.mipLevel < pageB.mipLevel);
+				});
+				evictionCandidatesCollected = true;
+			}
+			if (nextEvictionCandidate >= evictionCandidates.size()) {
+				// All resident pages are still in use, the remaining requests fall back to coarser levels
+				break;
+			}
+			VirtualTexturePage& evictedPage = texture.pages[evictionCandidates[nextEvictionCandidate++]];
+			slot = evictedPage.physicalSlot;
+			evictedPage.unbind();
+			bindingChangedPages.push_back(evictedPage);
+			statistics.evictions++;
 		}
-	}
+		page.bind(texture.pageCache.memory, slot * texture.pageCache.pageSize, slot);
+		bindingChangedPages.push_back(page);
 
-	// Update sparse queue binding
-	texture.updateSparseBindInfo(bindingChangedPages, true);
-	VkFenceCreateInfo fenceInfo = vks::initializers::fenceCreateInfo(VK_FLAGS_NONE);
-	VkFence fence;
-	VK_CHECK_RESULT(vkCreateFence(device, &fenceInfo, nullptr, &fence));
-	vkQueueBindSparse(queue, 1, &texture.bindSparseInfo, fence);
-	vkWaitForFences(device, 1, &fence, VK_TRUE, UINT64_MAX);
-	vkDestroyFence(device, fence, nullptr);
-	for (auto& page : texture.pages)
-	{
-		if (page.del)
-		{
-			page.release(device);
-		}
+		const VkDeviceSize stagingOffset = statistics.uploads * streaming.stagingPageSize;
+		generatePageContent((uint8_t*)streaming.stagingBuffer.mapped + stagingOffset, page.mipLevel, page.offset, page.extent);
+		VkBufferImageCopy region{};
+		region.bufferOffset = stagingOffset;
+		region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+		region.imageSubresource.layerCount = 1;
+		region.imageSubresource.mipLevel = page.mipLevel;
+		region.imageOffset = page.offset;
+		region.imageExtent = page.extent;
+		streaming.copyRegions.push_back(region);
+		statistics.uploads++;
+	}
+	streaming.pendingPages.erase(streaming.pendingPages.begin(), streaming.pendingPages.begin() + pendingIndex);
+
+	if (!bindingChangedPages.empty()) {
+		// The previous frame has finished executing, so evicted pages can be unbound without further synchronization
+		texture.updateSparseBindInfo(bindingChangedPages, false);
+		texture.bindSparseInfo.signalSemaphoreCount = 1;
+		texture.bindSparseInfo.pSignalSemaphores = &bindSparseSemaphore;
+		VK_CHECK_RESULT(vkQueueBindSparse(queue, 1, &texture.bindSparseInfo, VK_NULL_HANDLE));
+		streaming.bindSubmitted = true;
 	}
+
+	statistics.totalUploads += statistics.uploads;
+	statistics.totalEvictions += statistics.evictions;
+	auto tEnd = std::chrono::high_resolution_clock::now();
+	statistics.streamTime = std::chrono::duration<double, std::milli>(tEnd - tStart).count();
 }
 
 void VulkanExample::OnUpdateUIOverlay(vks::UIOverlay* overlay)
@@ -903,23 +1128,25 @@ void VulkanExample::OnUpdateUIOverlay(vks::UIOverlay* overlay)
 		if (overlay->sliderFloat("LOD bias", &uboVS.lodBias, -(float)texture.mipLevels, (float)texture.mipLevels)) {
 			updateUniformBuffers();
 		}
-		if (overlay->button("Fill random pages")) {
-			fillRandomPages();
-		}
-		if (overlay->button("Flush random pages")) {
-			flushRandomPages();
-		}
-		if (overlay->button("Fill mip tail")) {
-			fillMipTail();
-		}
+		overlay->sliderInt("Uploads per frame", &streaming.maxUploadsPerFrame, 1, static_cast<int32_t>(streaming.stagingPages));
 	}
 	if (overlay->header("Statistics")) {
-		uint32_t respages = 0;
-		std::for_each(texture.pages.begin(), texture.pages.end(), [&respages](VirtualTexturePage page) { respages += (page.resident()) ? 1 : 0; });
-		overlay->text("Resident pages: %d of %d", respages, static_cast<uint32_t>(texture.pages.size()));
+		const float pageSizeMB = static_cast<float>(texture.pageCache.pageSize) / (1024.0f * 1024.0f);
+		overlay->text("Resident pages: %d of %d", texture.pageCache.used(), static_cast<uint32_t>(texture.pages.size()));
+		overlay->text("Page cache: %.1f of %.1f MB", texture.pageCache.used() * pageSizeMB, texture.pageCache.capacity * pageSizeMB);
+		overlay->text("Requested pages: %d", statistics.requestedPages);
+		overlay->text("Pending pages: %d", static_cast<uint32_t>(streaming.pendingPages.size()));
+		overlay->text("Uploads: %d (total %d)", statistics.uploads, static_cast<uint32_t>(statistics.totalUploads));
+		overlay->text("Evictions: %d (total %d)", statistics.evictions, static_cast<uint32_t>(statistics.totalEvictions));
+		overlay->text("Streaming: %.3f ms", statistics.streamTime);
+		double readbackTime;
+		{
+			std::lock_guard<std::mutex> lock(feedback.mutex);
+			readbackTime = feedback.readbackTime;
+		}
+		overlay->text("Feedback readback: %.3f ms", readbackTime);
 		overlay->text("Mip tail starts at: %d", texture.mipTailStart);
 	}
-
 }
 
 VULKAN_EXAMPLE_MAIN()
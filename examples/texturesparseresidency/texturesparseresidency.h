@@ -10,6 +10,12 @@
 * Note : This sample is work-in-progress and works basically, but it's not yet finished
 */
 
+#include <array>
+#include <thread>
+#include <deque>
+#include <mutex>
+#include <condition_variable>
+
 #include "vulkanexamplebase.h"
 #include "VulkanglTFModel.h"
 
@@ -26,12 +32,31 @@ struct VirtualTexturePage
 	uint32_t mipLevel;													// Mip level that this page belongs to
 	uint32_t layer;														// Array layer that this page belongs to
 	uint32_t index;
-    bool del;
+	uint32_t physicalSlot = invalidSlot;								// Slot of the physical page cache backing this page
+	uint64_t lastRequested = 0;											// Feedback frame that last requested this page, used for LRU eviction
+
+	static const uint32_t invalidSlot = ~0u;
 
 	VirtualTexturePage();
 	bool resident();
-	bool allocate(VkDevice device, uint32_t memoryTypeIndex);
-	bool release(VkDevice device);
+	void bind(VkDeviceMemory memory, VkDeviceSize memoryOffset, uint32_t slot);
+	void unbind();
+};
+
+// Fixed size pool of device memory that backs the resident pages of a virtual texture
+// The pool is allocated once, so the texture never exceeds the memory budget no matter how many pages are requested
+struct PhysicalPageCache
+{
+	VkDeviceMemory memory = VK_NULL_HANDLE;
+	VkDeviceSize pageSize = 0;
+	uint32_t capacity = 0;
+	std::vector<uint32_t> freeSlots;
+
+	void create(VkDevice device, VkDeviceSize pageSize, uint32_t capacity, uint32_t memoryTypeIndex);
+	void destroy(VkDevice device);
+	uint32_t acquire();
+	void release(uint32_t slot);
+	uint32_t used() const;
 };
 
 // Virtual texture object containing all pages
@@ -48,8 +73,14 @@ struct VirtualTexture
 	uint32_t mipTailStart;												// First mip level in mip tail
 	VkSparseImageMemoryRequirements sparseImageMemoryRequirements;		// @todo: Comment
 	uint32_t memoryTypeIndex;											// @todo: Comment
+	PhysicalPageCache pageCache;										// Device memory backing the resident pages
 
-	VkSparseImageMemoryBind mipTailimageMemoryBind{};
+	// Page grid of a mip level outside of the mip tail
+	struct MipPages {
+		uint32_t firstPage;
+		uint32_t pagesX, pagesY;
+	};
+	std::vector<MipPages> mipPages;
 
 	// @todo: comment
 	struct MipTailInfo {
@@ -58,7 +89,8 @@ struct VirtualTexture
 	} mipTailInfo;
 
 	VirtualTexturePage *addPage(VkOffset3D offset, VkExtent3D extent, const VkDeviceSize size, const uint32_t mipLevel, uint32_t layer);
-	void updateSparseBindInfo(std::vector<VirtualTexturePage> &bindingChangedPages, bool del = false);
+	void updateSparseBindInfo(std::vector<VirtualTexturePage> &bindingChangedPages, bool bindMipTail = true);
+	VirtualTexturePage *parentPage(const VirtualTexturePage &page);
 	// @todo: replace with dtor?
 	void destroy();
 };
@@ -91,20 +123,70 @@ public:
 
 	VkPipeline pipeline;
 	VkPipelineLayout pipelineLayout;
-	VkDescriptorSet descriptorSet;
 	VkDescriptorSetLayout descriptorSetLayout;
 
-	//todo: comment
+	// Signaled by the per-frame sparse binding batch and waited on by the frame's command buffer
 	VkSemaphore bindSparseSemaphore = VK_NULL_HANDLE;
 
+	// Page table layout for the fragment shader's page request feedback
+	struct UboPageTable {
+		glm::uvec4 mips[16];	// x: first page index, y: pages per row, z: pages per column
+		glm::uvec4 info;		// xy: page extent in texels, z: first mip level in the mip tail
+	} uboPageTable;
+	vks::Buffer uniformBufferPageTable;
+
+	// Fragment shaders flag every page they sample in a feedback buffer (one uint per page)
+	// Feedback buffers are double buffered, so the GPU writes one while a worker thread reads back and clears the other
+	static const uint32_t feedbackBufferCount = 2;
+	struct Feedback {
+		std::array<vks::Buffer, feedbackBufferCount> buffers;
+		std::array<VkDescriptorSet, feedbackBufferCount> descriptorSets;
+		std::array<bool, feedbackBufferCount> busy{};
+		uint32_t currentBuffer = 0;
+		uint64_t frame = 0;
+		std::thread thread;
+		std::mutex mutex;
+		std::condition_variable condition;
+		// Shared with the worker thread, guarded by the mutex
+		std::deque<std::pair<uint32_t, uint64_t>> submissions;		// Buffer index and frame of executed frames waiting for readback
+		bool terminate = false;
+		bool resultAvailable = false;
+		uint64_t resultFrame = 0;
+		std::vector<uint32_t> requestedPages;
+		double readbackTime = 0.0;
+	} feedback;
+
+	// Residency is driven by the feedback, pages are streamed in with a bounded number of uploads and binds per frame
+	struct Streaming {
+		uint32_t budgetMB = 32;
+		int32_t maxUploadsPerFrame = 16;
+		// Upper limit for uploads per frame, determines the size of the staging buffer
+		uint32_t stagingPages = 64;
+		VkDeviceSize stagingPageSize = 0;
+		std::vector<uint32_t> pendingPages;
+		uint64_t feedbackFrame = 0;
+		vks::Buffer stagingBuffer;
+		std::vector<VkBufferImageCopy> copyRegions;
+		bool bindSubmitted = false;
+	} streaming;
+
+	struct Statistics {
+		uint32_t requestedPages = 0;
+		uint32_t uploads = 0;
+		uint32_t evictions = 0;
+		uint64_t totalUploads = 0;
+		uint64_t totalEvictions = 0;
+		double streamTime = 0.0;
+	} statistics;
+
 	VulkanExample();
 	~VulkanExample();
 	virtual void getEnabledFeatures();
 	glm::uvec3 alignedDivision(const VkExtent3D& extent, const VkExtent3D& granularity);
-	void randomPattern(uint8_t* buffer, uint32_t width, uint32_t height);
 	void prepareSparseTexture(uint32_t width, uint32_t height, uint32_t layerCount, VkFormat format);
 	// @todo: move to dtor of texture
 	void destroyTextureImage(SparseTexture texture);
+	void buildCommandBuffer(uint32_t index);
 	void buildCommandBuffers();
 	void draw();
 	void loadAssets();
@@ -117,9 +199,11 @@ public:
 	void prepare();
 	virtual void render();
 	virtual void viewChanged();
-	void uploadContent(VirtualTexturePage page, VkImage image);
-	void fillRandomPages();
+	void generatePageContent(uint8_t* buffer, uint32_t mipLevel, VkOffset3D offset, VkExtent3D extent);
 	void fillMipTail();
-	void flushRandomPages();
+	void prepareFeedback();
+	void feedbackThreadFn();
+	void applyFeedback();
+	void streamPages();
 	virtual void OnUpdateUIOverlay(vks::UIOverlay* overlay);
 };
@@ -43,6 +43,10 @@ VulkanglTFModel::~VulkanglTFModel()
 		vkDestroySampler(vulkanDevice->logicalDevice, image.texture.sampler, nullptr);
 		vkFreeMemory(vulkanDevice->logicalDevice, image.texture.deviceMemory, nullptr);
 	}
+	bindless.nodeMatrices.destroy();
+	bindless.draws.destroy();
+	bindless.materials.destroy();
+	bindless.indirectCommands.destroy();
 
 	// TODO: destroy
 }
@@ -453,6 +457,11 @@ void VulkanglTFModel::prepareMeshUniformBuffers(vks::VulkanDevice* vkDevice)
 	}
 }
 
+/*
+	Animation only moves nodes: the loader reads no skins, joints or weights, so every vertex of a mesh node shares one matrix
+	applied in the vertex shader. Compute pre-skinning (see gltfskinning) would add a dispatch and a vertex buffer round trip
+	per frame without saving any per-vertex work, and the scene is drawn by a single pass, so there is nothing to share
+*/
 void VulkanglTFModel::updateMeshUniformBuffers()
 {
 	/* HOMEWORK1 : 传递 glTF Node uniform */
@@ -464,6 +473,88 @@ void VulkanglTFModel::updateMeshUniformBuffers()
 			memcpy(meshNode->mesh.uniformBuffer.buffer.mapped, static_cast<const void*>(&nodeMatrix), sizeof(glm::mat4));
 		}
 	}
+	// Bindless: the same matrices in one storage buffer, indexed by the node index of the draw
+	if (bindless.nodeMatrices.mapped)
+	{
+		glm::mat4* nodeMatrices = static_cast<glm::mat4*>(bindless.nodeMatrices.mapped);
+		for (size_t i = 0; i < linearMeshNodes.size(); i++)
+		{
+			nodeMatrices[i] = getNodeMatrix(linearMeshNodes[i]);
+		}
+	}
+}
+
+/*
+	Bindless: upload the materials and one draw per primitive, the draw's first instance selects its draw data in the shaders
+	Texture indices point into a texture array that holds the model's images followed by the given default textures
+*/
+void VulkanglTFModel::prepareBindlessBuffers(vks::VulkanDevice* vkDevice, uint32_t defaultOcclusionTexture, uint32_t defaultEmissiveTexture)
+{
+	std::vector<MaterialData> materialData(materials.size());
+	for (size_t i = 0; i < materials.size(); i++)
+	{
+		const Material& material = materials[i];
+		MaterialData& data = materialData[i];
+		data.baseColorFactor = material.baseColorFactor;
+		data.emissiveFactor = glm::vec4(material.emissiveFactor, 0.0f);
+		data.metallicFactor = static_cast<float>(material.metallicFactor);
+		data.roughnessFactor = static_cast<float>(material.roughnessFactor);
+		data.baseColorTexture = static_cast<uint32_t>(material.baseColorImageIndex);
+		data.metallicRoughnessTexture = static_cast<uint32_t>(material.metallicRoughnessImageIndex);
+		data.normalTexture = static_cast<uint32_t>(material.normalImageIndex);
+		data.occlusionTexture = material.occlusionImageIndex > -1 ? static_cast<uint32_t>(material.occlusionImageIndex) : defaultOcclusionTexture;
+		data.emissiveTexture = material.emissiveImageIndex > -1 ? static_cast<uint32_t>(material.emissiveImageIndex) : defaultEmissiveTexture;
+		data._pad = 0;
+	}
+
+	std::vector<DrawData> drawData;
+	bindless.drawCommands.clear();
+	for (size_t i = 0; i < linearMeshNodes.size(); i++)
+	{
+		for (const Primitive& primitive : linearMeshNodes[i]->mesh.primitives)
+		{
+			if (primitive.indexCount == 0)
+			{
+				continue;
+			}
+			VkDrawIndexedIndirectCommand drawCommand{};
+			drawCommand.indexCount = primitive.indexCount;
+			drawCommand.instanceCount = 1;
+			drawCommand.firstIndex = primitive.firstIndex;
+			drawCommand.vertexOffset = 0;
+			drawCommand.firstInstance = static_cast<uint32_t>(drawData.size());
+			bindless.drawCommands.push_back(drawCommand);
+			drawData.push_back({ static_cast<uint32_t>(i), static_cast<uint32_t>(primitive.materialIndex) });
+		}
+	}
+
+	VK_CHECK_RESULT(vkDevice->createBuffer(
+		VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+		VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+		&bindless.materials,
+		materialData.size() * sizeof(MaterialData),
+		materialData.data()));
+	VK_CHECK_RESULT(vkDevice->createBuffer(
+		VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+		VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+		&bindless.draws,
+		drawData.size() * sizeof(DrawData),
+		drawData.data()));
+	VK_CHECK_RESULT(vkDevice->createBuffer(
+		VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT,
+		VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+		&bindless.indirectCommands,
+		bindless.drawCommands.size() * sizeof(VkDrawIndexedIndirectCommand),
+		bindless.drawCommands.data()));
+
+	// Node matrices change with the animation, so they stay mapped
+	VK_CHECK_RESULT(vkDevice->createBuffer(
+		VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+		VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+		&bindless.nodeMatrices,
+		linearMeshNodes.size() * sizeof(glm::mat4)));
+	VK_CHECK_RESULT(bindless.nodeMatrices.map());
+	updateMeshUniformBuffers();
 }
 
 // POI: Update the current animation
@@ -575,6 +666,27 @@ void VulkanglTFModel::draw(VkCommandBuffer commandBuffer, VkPipelineLayout pipel
 	}
 }
 
+// Bindless: no descriptor sets or push constants per draw, the bindless set has been bound for the whole pass
+void VulkanglTFModel::drawBindless(VkCommandBuffer commandBuffer, bool indirect, bool multiDrawIndirect)
+{
+	VkDeviceSize offsets[1] = { 0 };
+	vkCmdBindVertexBuffers(commandBuffer, 0, 1, &vertices.buffer, offsets);
+	vkCmdBindIndexBuffer(commandBuffer, indices.buffer, 0, VK_INDEX_TYPE_UINT32);
+	const uint32_t drawCount = static_cast<uint32_t>(bindless.drawCommands.size());
+	if (!indirect) {
+		for (const VkDrawIndexedIndirectCommand& drawCommand : bindless.drawCommands) {
+			vkCmdDrawIndexed(commandBuffer, drawCommand.indexCount, drawCommand.instanceCount, drawCommand.firstIndex, drawCommand.vertexOffset, drawCommand.firstInstance);
+		}
+	} else if (multiDrawIndirect) {
+		vkCmdDrawIndexedIndirect(commandBuffer, bindless.indirectCommands.buffer, 0, drawCount, sizeof(VkDrawIndexedIndirectCommand));
+	} else {
+		// Without multi draw indirect every primitive needs its own indirect draw
+		for (uint32_t i = 0; i < drawCount; i++) {
+			vkCmdDrawIndexedIndirect(commandBuffer, bindless.indirectCommands.buffer, i * sizeof(VkDrawIndexedIndirectCommand), 1, sizeof(VkDrawIndexedIndirectCommand));
+		}
+	}
+}
+
 /*
  * Vulkan Example Implements
  */
@@ -587,6 +699,8 @@ VulkanExample::VulkanExample() : VulkanExampleBase(ENABLE_VALIDATION)
 	camera.setPosition(glm::vec3(0.0f, -0.1f, -1.0f));
 	camera.setRotation(glm::vec3(0.0f, 45.0f, 0.0f));
 	camera.setPerspective(60.0f, (float)width / (float)height, 0.1f, 256.0f);
+	// Descriptor indexing for bindless materials is core with Vulkan 1.2
+	apiVersion = VK_API_VERSION_1_2;
 }
 
 VulkanExample::~VulkanExample()
@@ -597,10 +711,25 @@ VulkanExample::~VulkanExample()
 	if (pipelines.wireframe != VK_NULL_HANDLE) {
 		vkDestroyPipeline(device, pipelines.wireframe, nullptr);
 	}
+	vkDestroyPipeline(device, pipelines.post, nullptr);
+	if (bindlessSupported) {
+		vkDestroyPipeline(device, pipelines.bindless, nullptr);
+		if (pipelines.bindlessWireframe != VK_NULL_HANDLE) {
+			vkDestroyPipeline(device, pipelines.bindlessWireframe, nullptr);
+		}
+		vkDestroyPipelineLayout(device, bindlessPipelineLayout, nullptr);
+		vkDestroyDescriptorSetLayout(device, descriptorSetLayouts.bindless, nullptr);
+	}
 
 	vkDestroyPipelineLayout(device, pipelineLayout, nullptr);
+	vkDestroyPipelineLayout(device, postPipelineLayout, nullptr);
 	vkDestroyDescriptorSetLayout(device, descriptorSetLayouts.matrices, nullptr);
 	vkDestroyDescriptorSetLayout(device, descriptorSetLayouts.textures, nullptr);
+	vkDestroyDescriptorSetLayout(device, descriptorSetLayouts.post, nullptr);
+
+	destroyOffscreenFramebuffer();
+	vkDestroyRenderPass(device, offscreenPass.renderPass, nullptr);
+	vkDestroySampler(device, offscreenPass.sampler, nullptr);
 	// TODO: destroy descriptorset layout
 
 	shaderData.buffer.destroy();
@@ -612,6 +741,46 @@ void VulkanExample::getEnabledFeatures()
 	if (deviceFeatures.fillModeNonSolid) {
 		enabledFeatures.fillModeNonSolid = VK_TRUE;
 	};
+	// Without multi draw indirect the indirect mode issues one indirect draw per primitive
+	enabledFeatures.multiDrawIndirect = deviceFeatures.multiDrawIndirect;
+	// Indirect draws carry the index of their draw data in their first instance
+	enabledFeatures.drawIndirectFirstInstance = deviceFeatures.drawIndirectFirstInstance;
+}
+
+void VulkanExample::getEnabledExtensions()
+{
+	// Bindless materials index a texture array with the material's texture indices, which requires descriptor indexing
+	// Querying the features requires Vulkan 1.1, descriptor indexing is core with Vulkan 1.2
+	bindlessSupported = false;
+	const uint32_t version = std::min(apiVersion, vulkanDevice->properties.apiVersion);
+	if (version < VK_API_VERSION_1_1) {
+		return;
+	}
+	const bool core = version >= VK_API_VERSION_1_2;
+	if (!core && !(vulkanDevice->extensionSupported(VK_EXT_DESCRIPTOR_INDEXING_EXTENSION_NAME) && vulkanDevice->extensionSupported(VK_KHR_MAINTENANCE3_EXTENSION_NAME))) {
+		return;
+	}
+	VkPhysicalDeviceDescriptorIndexingFeaturesEXT supportedFeatures{};
+	supportedFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_INDEXING_FEATURES_EXT;
+	VkPhysicalDeviceFeatures2 features2{};
+	features2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+	features2.pNext = &supportedFeatures;
+	vkGetPhysicalDeviceFeatures2(physicalDevice, &features2);
+	if (!supportedFeatures.shaderSampledImageArrayNonUniformIndexing || !supportedFeatures.runtimeDescriptorArray) {
+		return;
+	}
+
+	if (!core) {
+		enabledDeviceExtensions.push_back(VK_KHR_MAINTENANCE3_EXTENSION_NAME);
+		enabledDeviceExtensions.push_back(VK_EXT_DESCRIPTOR_INDEXING_EXTENSION_NAME);
+	}
+	descriptorIndexingFeatures = {};
+	descriptorIndexingFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_INDEXING_FEATURES_EXT;
+	descriptorIndexingFeatures.shaderSampledImageArrayNonUniformIndexing = VK_TRUE;
+	descriptorIndexingFeatures.runtimeDescriptorArray = VK_TRUE;
+	descriptorIndexingFeatures.pNext = deviceCreatepNextChain;
+	deviceCreatepNextChain = &descriptorIndexingFeatures;
+	bindlessSupported = true;
 }
 
 void VulkanExample::buildCommandBuffers()
@@ -624,7 +793,6 @@ void VulkanExample::buildCommandBuffers()
 	clearValues[1].depthStencil = { 1.0f, 0 };
 
 	VkRenderPassBeginInfo renderPassBeginInfo = vks::initializers::renderPassBeginInfo();
-	renderPassBeginInfo.renderPass = renderPass;
 	renderPassBeginInfo.renderArea.offset.x = 0;
 	renderPassBeginInfo.renderArea.offset.y = 0;
 	renderPassBeginInfo.renderArea.extent.width = width;
@@ -637,9 +805,11 @@ void VulkanExample::buildCommandBuffers()
 
 	for (int32_t i = 0; i < drawCmdBuffers.size(); ++i)
 	{
-		renderPassBeginInfo.framebuffer = frameBuffers[i];
 		VK_CHECK_RESULT(vkBeginCommandBuffer(drawCmdBuffers[i], &cmdBufInfo));
 
+		// 场景渲染至 HDR Render Target
+		renderPassBeginInfo.renderPass = offscreenPass.renderPass;
+		renderPassBeginInfo.framebuffer = offscreenPass.frameBuffer;
 		vkCmdBeginRenderPass(drawCmdBuffers[i], &renderPassBeginInfo, VK_SUBPASS_CONTENTS_INLINE);
 		vkCmdSetViewport(drawCmdBuffers[i], 0, 1, &viewport);
 		vkCmdSetScissor(drawCmdBuffers[i], 0, 1, &scissor);
@@ -648,7 +818,29 @@ void VulkanExample::buildCommandBuffers()
 		vkCmdBindPipeline(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, wireframe ? pipelines.wireframe : pipelines.solid);
 
 		// 绘制各个 glTF Node
-		glTFModel.draw(drawCmdBuffers[i], pipelineLayout);
+		auto tStart = std::chrono::high_resolution_clock::now();
+		if (materialBinding == MaterialDescriptorSets) {
+			glTFModel.draw(drawCmdBuffers[i], pipelineLayout);
+		} else {
+			vkCmdBindPipeline(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, wireframe ? pipelines.bindlessWireframe : pipelines.bindless);
+			const std::array<VkDescriptorSet, 2> sets = { descriptorSet, bindlessDescriptorSet };
+			vkCmdBindDescriptorSets(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, bindlessPipelineLayout, 0, static_cast<uint32_t>(sets.size()), sets.data(), 0, nullptr);
+			glTFModel.drawBindless(drawCmdBuffers[i], materialBinding == MaterialBindlessIndirect, vulkanDevice->enabledFeatures.multiDrawIndirect);
+		}
+		sceneRecordTime = std::chrono::duration<float, std::milli>(std::chrono::high_resolution_clock::now() - tStart).count();
+
+		vkCmdEndRenderPass(drawCmdBuffers[i]);
+
+		// Tone mapping：读取 HDR Render Target，写入 Swapchain
+		renderPassBeginInfo.renderPass = renderPass;
+		renderPassBeginInfo.framebuffer = frameBuffers[i];
+		vkCmdBeginRenderPass(drawCmdBuffers[i], &renderPassBeginInfo, VK_SUBPASS_CONTENTS_INLINE);
+		vkCmdSetViewport(drawCmdBuffers[i], 0, 1, &viewport);
+		vkCmdSetScissor(drawCmdBuffers[i], 0, 1, &scissor);
+		vkCmdBindDescriptorSets(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, postPipelineLayout, 0, 1, &postDescriptorSet, 0, nullptr);
+		vkCmdBindPipeline(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pipelines.post);
+		vkCmdPushConstants(drawCmdBuffers[i], postPipelineLayout, VK_SHADER_STAGE_FRAGMENT_BIT, 0, sizeof(PostPushConstants), &postPushConstants);
+		vkCmdDraw(drawCmdBuffers[i], 3, 1, 0, 0);
 
 		// 绘制 UI
 		drawUI(drawCmdBuffers[i]);
@@ -665,6 +857,180 @@ void VulkanExample::OnUpdateUIOverlay(vks::UIOverlay* overlay)
 			buildCommandBuffers();
 		}
 	}
+	if (overlay->header("Scene drawing")) {
+		if (bindlessSupported) {
+			std::vector<std::string> modes = { "Descriptor sets", "Bindless" };
+			if (vulkanDevice->enabledFeatures.drawIndirectFirstInstance) {
+				modes.push_back("Bindless indirect");
+			}
+			if (overlay->comboBox("Materials", &materialBinding, modes)) {
+				buildCommandBuffers();
+			}
+		} else {
+			overlay->text("Bindless materials not supported");
+		}
+		overlay->text("Scene record time: %.3f ms", sceneRecordTime);
+	}
+	if (overlay->header("Tone mapping")) {
+		bool tonemap = (postPushConstants.tonemap == 1);
+		if (overlay->checkBox("ACES", &tonemap)) {
+			postPushConstants.tonemap = tonemap ? 1 : 0;
+			buildCommandBuffers();
+		}
+		if (overlay->sliderFloat("Exposure", &postPushConstants.exposure, 0.1f, 8.0f)) {
+			buildCommandBuffers();
+		}
+		if (overlay->sliderFloat("Gamma", &postPushConstants.gamma, 1.0f, 3.0f)) {
+			buildCommandBuffers();
+		}
+	}
+}
+
+void VulkanExample::createAttachment(FrameBufferAttachment* attachment, VkFormat format, VkImageUsageFlags usage, VkImageAspectFlags aspectMask)
+{
+	VkImageCreateInfo image = vks::initializers::imageCreateInfo();
+	image.imageType = VK_IMAGE_TYPE_2D;
+	image.format = format;
+	image.extent = { width, height, 1 };
+	image.mipLevels = 1;
+	image.arrayLayers = 1;
+	image.samples = VK_SAMPLE_COUNT_1_BIT;
+	image.tiling = VK_IMAGE_TILING_OPTIMAL;
+	image.usage = usage;
+	VK_CHECK_RESULT(vkCreateImage(device, &image, nullptr, &attachment->image));
+
+	VkMemoryAllocateInfo memAlloc = vks::initializers::memoryAllocateInfo();
+	VkMemoryRequirements memReqs;
+	vkGetImageMemoryRequirements(device, attachment->image, &memReqs);
+	memAlloc.allocationSize = memReqs.size;
+	memAlloc.memoryTypeIndex = vulkanDevice->getMemoryType(memReqs.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+	VK_CHECK_RESULT(vkAllocateMemory(device, &memAlloc, nullptr, &attachment->memory));
+	VK_CHECK_RESULT(vkBindImageMemory(device, attachment->image, attachment->memory, 0));
+
+	VkImageViewCreateInfo imageView = vks::initializers::imageViewCreateInfo();
+	imageView.viewType = VK_IMAGE_VIEW_TYPE_2D;
+	imageView.format = format;
+	imageView.subresourceRange = { aspectMask, 0, 1, 0, 1 };
+	imageView.image = attachment->image;
+	VK_CHECK_RESULT(vkCreateImageView(device, &imageView, nullptr, &attachment->view));
+}
+
+void VulkanExample::destroyAttachment(FrameBufferAttachment* attachment)
+{
+	vkDestroyImageView(device, attachment->view, nullptr);
+	vkDestroyImage(device, attachment->image, nullptr);
+	vkFreeMemory(device, attachment->memory, nullptr);
+}
+
+/**
+ * @brief Render pass and sampler of the HDR scene target, these don't depend on the window size
+ */
+void VulkanExample::prepareOffscreen()
+{
+	std::array<VkAttachmentDescription, 2> attachmentDescriptions = {};
+	// Color attachment: linear HDR color
+	attachmentDescriptions[0].format = VK_FORMAT_R16G16B16A16_SFLOAT;
+	attachmentDescriptions[0].samples = VK_SAMPLE_COUNT_1_BIT;
+	attachmentDescriptions[0].loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+	attachmentDescriptions[0].storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+	attachmentDescriptions[0].stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+	attachmentDescriptions[0].stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+	attachmentDescriptions[0].initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+	attachmentDescriptions[0].finalLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+	// Depth attachment
+	attachmentDescriptions[1].format = depthFormat;
+	attachmentDescriptions[1].samples = VK_SAMPLE_COUNT_1_BIT;
+	attachmentDescriptions[1].loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+	attachmentDescriptions[1].storeOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+	attachmentDescriptions[1].stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+	attachmentDescriptions[1].stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+	attachmentDescriptions[1].initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+	attachmentDescriptions[1].finalLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+
+	VkAttachmentReference colorReference = { 0, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL };
+	VkAttachmentReference depthReference = { 1, VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL };
+
+	VkSubpassDescription subpassDescription = {};
+	subpassDescription.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
+	subpassDescription.colorAttachmentCount = 1;
+	subpassDescription.pColorAttachments = &colorReference;
+	subpassDescription.pDepthStencilAttachment = &depthReference;
+
+	// Use subpass dependencies for layout transitions, the scene color is read by the tone mapping fragment shader
+	std::array<VkSubpassDependency, 2> dependencies;
+
+	dependencies[0].srcSubpass = VK_SUBPASS_EXTERNAL;
+	dependencies[0].dstSubpass = 0;
+	dependencies[0].srcStageMask = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
+	dependencies[0].dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+	dependencies[0].srcAccessMask = VK_ACCESS_SHADER_READ_BIT;
+	dependencies[0].dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+	dependencies[0].dependencyFlags = VK_DEPENDENCY_BY_REGION_BIT;
+
+	dependencies[1].srcSubpass = 0;
+	dependencies[1].dstSubpass = VK_SUBPASS_EXTERNAL;
+	dependencies[1].srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+	dependencies[1].dstStageMask = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
+	dependencies[1].srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+	dependencies[1].dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+	dependencies[1].dependencyFlags = VK_DEPENDENCY_BY_REGION_BIT;
+
+	VkRenderPassCreateInfo renderPassInfo = vks::initializers::renderPassCreateInfo();
+	renderPassInfo.attachmentCount = static_cast<uint32_t>(attachmentDescriptions.size());
+	renderPassInfo.pAttachments = attachmentDescriptions.data();
+	renderPassInfo.subpassCount = 1;
+	renderPassInfo.pSubpasses = &subpassDescription;
+	renderPassInfo.dependencyCount = static_cast<uint32_t>(dependencies.size());
+	renderPassInfo.pDependencies = dependencies.data();
+	VK_CHECK_RESULT(vkCreateRenderPass(device, &renderPassInfo, nullptr, &offscreenPass.renderPass));
+
+	// The tone mapping pass reads one texel per pixel, so nearest filtering is sufficient
+	VkSamplerCreateInfo sampler = vks::initializers::samplerCreateInfo();
+	sampler.magFilter = VK_FILTER_NEAREST;
+	sampler.minFilter = VK_FILTER_NEAREST;
+	sampler.mipmapMode = VK_SAMPLER_MIPMAP_MODE_NEAREST;
+	sampler.addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+	sampler.addressModeV = sampler.addressModeU;
+	sampler.addressModeW = sampler.addressModeU;
+	sampler.maxAnisotropy = 1.0f;
+	sampler.minLod = 0.0f;
+	sampler.maxLod = 0.0f;
+	sampler.borderColor = VK_BORDER_COLOR_FLOAT_OPAQUE_WHITE;
+	VK_CHECK_RESULT(vkCreateSampler(device, &sampler, nullptr, &offscreenPass.sampler));
+
+	prepareOffscreenFramebuffer();
+}
+
+/**
+ * @brief HDR scene color and depth targets, sized to the window
+ */
+void VulkanExample::prepareOffscreenFramebuffer()
+{
+	createAttachment(&offscreenPass.color, VK_FORMAT_R16G16B16A16_SFLOAT, VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT, VK_IMAGE_ASPECT_COLOR_BIT);
+	VkImageAspectFlags depthAspectMask = VK_IMAGE_ASPECT_DEPTH_BIT;
+	if (vks::tools::formatHasStencil(depthFormat)) {
+		depthAspectMask |= VK_IMAGE_ASPECT_STENCIL_BIT;
+	}
+	createAttachment(&offscreenPass.depth, depthFormat, VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT, depthAspectMask);
+
+	VkImageView attachments[2] = { offscreenPass.color.view, offscreenPass.depth.view };
+	VkFramebufferCreateInfo framebufferCI = vks::initializers::framebufferCreateInfo();
+	framebufferCI.renderPass = offscreenPass.renderPass;
+	framebufferCI.attachmentCount = 2;
+	framebufferCI.pAttachments = attachments;
+	framebufferCI.width = width;
+	framebufferCI.height = height;
+	framebufferCI.layers = 1;
+	VK_CHECK_RESULT(vkCreateFramebuffer(device, &framebufferCI, nullptr, &offscreenPass.frameBuffer));
+
+	offscreenPass.descriptor = vks::initializers::descriptorImageInfo(offscreenPass.sampler, offscreenPass.color.view, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+}
+
+void VulkanExample::destroyOffscreenFramebuffer()
+{
+	vkDestroyFramebuffer(device, offscreenPass.frameBuffer, nullptr);
+	destroyAttachment(&offscreenPass.color);
+	destroyAttachment(&offscreenPass.depth);
 }
 
 void VulkanExample::loadglTFFile(std::string filename)
@@ -802,13 +1168,19 @@ void VulkanExample::setupDescriptors()
 	*/
 
 	/* HOMEWORK1 : 传递 glTF Node uniform */
+	// Bindless: the texture array holds all model images followed by the default occlusion and emissive textures
+	const uint32_t bindlessTextureCount = static_cast<uint32_t>(glTFModel.images.size()) + 2;
 	std::vector<VkDescriptorPoolSize> poolSizes = {
 		vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 1 + static_cast<uint32_t>(glTFModel.linearMeshNodes.size())),
-		// One combined image sampler per model image/texture
-		vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, static_cast<uint32_t>(glTFModel.materials.size() * 5)),
+		// One combined image sampler per model image/texture and the HDR scene color read by the tone mapping pass
+		vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, static_cast<uint32_t>(glTFModel.materials.size() * 5) + 1 + (bindlessSupported ? bindlessTextureCount : 0)),
 	};
-	// One set for matrices and one per model image/texture
-	const uint32_t maxSetCount = static_cast<uint32_t>(glTFModel.images.size()) + static_cast<uint32_t>(glTFModel.linearMeshNodes.size()) + 1;
+	if (bindlessSupported) {
+		// Draws, node matrices and materials
+		poolSizes.push_back(vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 3));
+	}
+	// One set for matrices, one per model image/texture, one for the tone mapping pass and the bindless set
+	const uint32_t maxSetCount = static_cast<uint32_t>(glTFModel.images.size()) + static_cast<uint32_t>(glTFModel.linearMeshNodes.size()) + 3;
 	VkDescriptorPoolCreateInfo descriptorPoolInfo = vks::initializers::descriptorPoolCreateInfo(poolSizes, maxSetCount);
 	VK_CHECK_RESULT(vkCreateDescriptorPool(device, &descriptorPoolInfo, nullptr, &descriptorPool));
 	
@@ -913,6 +1285,60 @@ void VulkanExample::setupDescriptors()
 	pipelineLayoutCI.pPushConstantRanges = &pushConstantRange;
 
 	VK_CHECK_RESULT(vkCreatePipelineLayout(device, &pipelineLayoutCI, nullptr, &pipelineLayout))
+
+	{
+		// Tone mapping pass : HDR scene color, exposure and gamma are passed as push constants
+		VkDescriptorSetLayoutBinding setLayoutBinding = vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_FRAGMENT_BIT, 0);
+		VkDescriptorSetLayoutCreateInfo descriptorSetLayoutCI = vks::initializers::descriptorSetLayoutCreateInfo(&setLayoutBinding, 1);
+		VK_CHECK_RESULT(vkCreateDescriptorSetLayout(device, &descriptorSetLayoutCI, nullptr, &descriptorSetLayouts.post));
+
+		const VkDescriptorSetAllocateInfo allocInfo = vks::initializers::descriptorSetAllocateInfo(descriptorPool, &descriptorSetLayouts.post, 1);
+		VK_CHECK_RESULT(vkAllocateDescriptorSets(device, &allocInfo, &postDescriptorSet));
+		VkWriteDescriptorSet writeDescriptorSet = vks::initializers::writeDescriptorSet(postDescriptorSet, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 0, &offscreenPass.descriptor);
+		vkUpdateDescriptorSets(device, 1, &writeDescriptorSet, 0, nullptr);
+
+		VkPipelineLayoutCreateInfo postPipelineLayoutCI = vks::initializers::pipelineLayoutCreateInfo(&descriptorSetLayouts.post, 1);
+		VkPushConstantRange postPushConstantRange = vks::initializers::pushConstantRange(VK_SHADER_STAGE_FRAGMENT_BIT, sizeof(PostPushConstants), 0);
+		postPipelineLayoutCI.pushConstantRangeCount = 1;
+		postPipelineLayoutCI.pPushConstantRanges = &postPushConstantRange;
+		VK_CHECK_RESULT(vkCreatePipelineLayout(device, &postPipelineLayoutCI, nullptr, &postPipelineLayout));
+	}
+
+	if (bindlessSupported) {
+		// Bindless materials : a single set for the whole scene replaces the per material and per node sets and the push constants
+		std::vector<VkDescriptorSetLayoutBinding> setLayoutBindings = {
+			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_VERTEX_BIT, 0),
+			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_VERTEX_BIT, 1),
+			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_FRAGMENT_BIT, 2),
+			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_FRAGMENT_BIT, 3, bindlessTextureCount),
+		};
+		VkDescriptorSetLayoutCreateInfo descriptorSetLayoutCI = vks::initializers::descriptorSetLayoutCreateInfo(setLayoutBindings);
+		VK_CHECK_RESULT(vkCreateDescriptorSetLayout(device, &descriptorSetLayoutCI, nullptr, &descriptorSetLayouts.bindless));
+
+		const VkDescriptorSetAllocateInfo allocInfo = vks::initializers::descriptorSetAllocateInfo(descriptorPool, &descriptorSetLayouts.bindless, 1);
+		VK_CHECK_RESULT(vkAllocateDescriptorSets(device, &allocInfo, &bindlessDescriptorSet));
+
+		std::vector<VkDescriptorImageInfo> textureDescriptors;
+		textureDescriptors.reserve(bindlessTextureCount);
+		for (auto& image : glTFModel.images) {
+			textureDescriptors.push_back(image.texture.descriptor);
+		}
+		textureDescriptors.push_back(defaultOcclusionTexture.descriptor);
+		textureDescriptors.push_back(defaultEmissiveTexture.descriptor);
+
+		std::vector<VkWriteDescriptorSet> writeDescriptorSets = {
+			vks::initializers::writeDescriptorSet(bindlessDescriptorSet, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 0, &glTFModel.bindless.draws.descriptor),
+			vks::initializers::writeDescriptorSet(bindlessDescriptorSet, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1, &glTFModel.bindless.nodeMatrices.descriptor),
+			vks::initializers::writeDescriptorSet(bindlessDescriptorSet, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 2, &glTFModel.bindless.materials.descriptor),
+			vks::initializers::writeDescriptorSet(bindlessDescriptorSet, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 3, textureDescriptors.data(), bindlessTextureCount),
+		};
+		vkUpdateDescriptorSets(device, static_cast<uint32_t>(writeDescriptorSets.size()), writeDescriptorSets.data(), 0, nullptr);
+
+		// Set 0 = scene matrices, set 1 = bindless scene data
+		std::array<VkDescriptorSetLayout, 2> bindlessSetLayouts = { descriptorSetLayouts.matrices, descriptorSetLayouts.bindless };
+		VkPipelineLayoutCreateInfo bindlessPipelineLayoutCI = vks::initializers::pipelineLayoutCreateInfo(bindlessSetLayouts.data(), static_cast<uint32_t>(bindlessSetLayouts.size()));
+		VK_CHECK_RESULT(vkCreatePipelineLayout(device, &bindlessPipelineLayoutCI, nullptr, &bindlessPipelineLayout));
+	}
 }
 
 /**
@@ -932,6 +1358,11 @@ void VulkanExample::prepareUniformBuffers()
 
 	/* HOMEWORK1 : 传递 glTF Node uniform */
 	glTFModel.prepareMeshUniformBuffers(vulkanDevice);
+	if (bindlessSupported) {
+		// The default textures follow the model images in the bindless texture array
+		const uint32_t imageCount = static_cast<uint32_t>(glTFModel.images.size());
+		glTFModel.prepareBindlessBuffers(vulkanDevice, imageCount, imageCount + 1);
+	}
 
 	updateUniformBuffers();
 }
@@ -984,7 +1415,7 @@ void VulkanExample::preparePipelines()
 	};
 
 	// 准备 Pipeline Create Info
-	VkGraphicsPipelineCreateInfo pipelineCI = vks::initializers::pipelineCreateInfo(pipelineLayout, renderPass, 0); // 指定 Pipeline Layout 和 Render Pass
+	VkGraphicsPipelineCreateInfo pipelineCI = vks::initializers::pipelineCreateInfo(pipelineLayout, offscreenPass.renderPass, 0); // 指定 Pipeline Layout 和 Render Pass（场景渲染至 HDR Render Target）
 	pipelineCI.pVertexInputState = &vertexInputStateCI;
 	pipelineCI.pInputAssemblyState = &inputAssemblyStateCI;
 	pipelineCI.pRasterizationState = &rasterizationStateCI;
@@ -1005,12 +1436,46 @@ void VulkanExample::preparePipelines()
 		rasterizationStateCI.lineWidth = 1.0f;
 		VK_CHECK_RESULT(vkCreateGraphicsPipelines(device, pipelineCache, 1, &pipelineCI, nullptr, &pipelines.wireframe));
 	}
+
+	// 创建 Bindless pipelines : same states, materials and node matrices are fetched with the draw index passed as first instance
+	if (bindlessSupported) {
+		const std::array<VkPipelineShaderStageCreateInfo, 2> bindlessShaderStages = {
+			loadShader(getHomeworkShadersPath() + "homework1/mesh_bindless.vert.spv", VK_SHADER_STAGE_VERTEX_BIT),
+			loadShader(getHomeworkShadersPath() + "homework1/mesh_bindless.frag.spv", VK_SHADER_STAGE_FRAGMENT_BIT)
+		};
+		pipelineCI.layout = bindlessPipelineLayout;
+		pipelineCI.pStages = bindlessShaderStages.data();
+		rasterizationStateCI.polygonMode = VK_POLYGON_MODE_FILL;
+		VK_CHECK_RESULT(vkCreateGraphicsPipelines(device, pipelineCache, 1, &pipelineCI, nullptr, &pipelines.bindless));
+		if (deviceFeatures.fillModeNonSolid) {
+			rasterizationStateCI.polygonMode = VK_POLYGON_MODE_LINE;
+			VK_CHECK_RESULT(vkCreateGraphicsPipelines(device, pipelineCache, 1, &pipelineCI, nullptr, &pipelines.bindlessWireframe));
+		}
+	}
+
+	// 创建 Tone mapping pipeline : fullscreen triangle generated in the vertex shader, no vertex input
+	const std::array<VkPipelineShaderStageCreateInfo, 2> postShaderStages = {
+		loadShader(getHomeworkShadersPath() + "homework1/tonemap.vert.spv", VK_SHADER_STAGE_VERTEX_BIT),
+		loadShader(getHomeworkShadersPath() + "homework1/tonemap.frag.spv", VK_SHADER_STAGE_FRAGMENT_BIT)
+	};
+	VkPipelineVertexInputStateCreateInfo emptyInputStateCI = vks::initializers::pipelineVertexInputStateCreateInfo();
+	rasterizationStateCI.polygonMode = VK_POLYGON_MODE_FILL;
+	rasterizationStateCI.cullMode = VK_CULL_MODE_NONE;
+	depthStencilStateCI.depthTestEnable = VK_FALSE;
+	depthStencilStateCI.depthWriteEnable = VK_FALSE;
+	pipelineCI.layout = postPipelineLayout;
+	pipelineCI.renderPass = renderPass;
+	pipelineCI.pVertexInputState = &emptyInputStateCI;
+	pipelineCI.stageCount = static_cast<uint32_t>(postShaderStages.size());
+	pipelineCI.pStages = postShaderStages.data();
+	VK_CHECK_RESULT(vkCreateGraphicsPipelines(device, pipelineCache, 1, &pipelineCI, nullptr, &pipelines.post));
 }
 
 void VulkanExample::prepare()
 {
 	VulkanExampleBase::prepare();
 	loadAssets();
+	prepareOffscreen();
 	prepareUniformBuffers();
 	setupDescriptors();
 	preparePipelines();
@@ -1037,4 +1502,14 @@ void VulkanExample::viewChanged()
 	updateUniformBuffers();
 }
 
+void VulkanExample::windowResized()
+{
+	// The HDR scene target is sized to the window, the render pass and the descriptor set are reused
+	destroyOffscreenFramebuffer();
+	prepareOffscreenFramebuffer();
+	VkWriteDescriptorSet writeDescriptorSet = vks::initializers::writeDescriptorSet(postDescriptorSet, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 0, &offscreenPass.descriptor);
+	vkUpdateDescriptorSets(device, 1, &writeDescriptorSet, 0, nullptr);
+	buildCommandBuffers();
+}
+
 VULKAN_EXAMPLE_MAIN()
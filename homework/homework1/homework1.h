@@ -135,6 +135,28 @@ public:
 		float roughnessFactor = 1.f;
 	};
 
+	// Bindless: per primitive draw data, the shaders select it with the draw's first instance
+	struct DrawData
+	{
+		uint32_t nodeIndex;
+		uint32_t materialIndex;
+	};
+
+	// Bindless: matches the Material struct in mesh_bindless.frag, texture indices point into the global texture array
+	struct MaterialData
+	{
+		glm::vec4 baseColorFactor;
+		glm::vec4 emissiveFactor;
+		float metallicFactor;
+		float roughnessFactor;
+		uint32_t baseColorTexture;
+		uint32_t metallicRoughnessTexture;
+		uint32_t normalTexture;
+		uint32_t occlusionTexture;
+		uint32_t emissiveTexture;
+		uint32_t _pad;
+	};
+
 	// Contains the texture for a single glTF image
 	// Images may be reused by texture objects and are as such separated
 	// TODO: remove Image
@@ -191,6 +213,16 @@ public:
 
 	uint32_t activeAnimation = 0;
 
+	// Bindless: all primitives are drawn with one descriptor set bound per pass, the node matrices are updated with the animation
+	struct Bindless
+	{
+		vks::Buffer nodeMatrices;
+		vks::Buffer draws;
+		vks::Buffer materials;
+		vks::Buffer indirectCommands;
+		std::vector<VkDrawIndexedIndirectCommand> drawCommands;
+	} bindless;
+
 public:
 	~VulkanglTFModel();
 
@@ -212,9 +244,11 @@ public:
 	void prepareMeshUniformBuffers(vks::VulkanDevice* vkDevice);
 	void updateMeshUniformBuffers();
 	void updateAnimation(float deltaTime);
+	void prepareBindlessBuffers(vks::VulkanDevice* vkDevice, uint32_t defaultOcclusionTexture, uint32_t defaultEmissiveTexture);
 
 	void drawNode(VkCommandBuffer commandBuffer, VkPipelineLayout pipelineLayout, VulkanglTFModel::Node* node);
 	void draw(VkCommandBuffer commandBuffer, VkPipelineLayout pipelineLayout);
+	void drawBindless(VkCommandBuffer commandBuffer, bool indirect, bool multiDrawIndirect);
 };
 
 
@@ -238,11 +272,49 @@ public:
 	struct Pipelines {
 		VkPipeline solid = VK_NULL_HANDLE;
 		VkPipeline wireframe = VK_NULL_HANDLE;
+		VkPipeline bindless = VK_NULL_HANDLE;
+		VkPipeline bindlessWireframe = VK_NULL_HANDLE;
+		VkPipeline post = VK_NULL_HANDLE;
 	} pipelines;
 
+	// Per material descriptor sets bind once per primitive (plus one node set per node), the bindless set once per pass
+	// (with one draw per primitive or a single indirect draw)
+	enum MaterialBinding { MaterialDescriptorSets = 0, MaterialBindless = 1, MaterialBindlessIndirect = 2 };
+	int32_t materialBinding = MaterialDescriptorSets;
+	bool bindlessSupported = false;
+	VkPhysicalDeviceDescriptorIndexingFeaturesEXT descriptorIndexingFeatures{};
+	VkPipelineLayout bindlessPipelineLayout = VK_NULL_HANDLE;
+	VkDescriptorSet bindlessDescriptorSet = VK_NULL_HANDLE;
+	// CPU time for recording the scene draws into one command buffer
+	float sceneRecordTime = 0.0f;
+
 	VkPipelineLayout pipelineLayout;
 	VkDescriptorSet descriptorSet;
 
+	// The scene is rendered to a linear HDR target, a single fullscreen pass then applies exposure, tone mapping and
+	// gamma and writes the swapchain image, so every pixel is read and written once after the scene pass
+	struct FrameBufferAttachment {
+		VkImage image;
+		VkDeviceMemory memory;
+		VkImageView view;
+	};
+	struct OffscreenPass {
+		FrameBufferAttachment color, depth;
+		VkFramebuffer frameBuffer;
+		VkRenderPass renderPass;
+		VkSampler sampler;
+		VkDescriptorImageInfo descriptor;
+	} offscreenPass{};
+
+	struct PostPushConstants {
+		float exposure = 1.0f;
+		float gamma = 2.2f;
+		int32_t tonemap = 1;
+	} postPushConstants;
+
+	VkPipelineLayout postPipelineLayout;
+	VkDescriptorSet postDescriptorSet;
+
 	struct DescriptorSetLayouts {
 		// 场景相关的 Descriptor Set，包括：MV Matrix / Camera Pos / Light Pos
 		VkDescriptorSetLayout matrices;
@@ -250,6 +322,10 @@ public:
 		VkDescriptorSetLayout textures;
 		/* HOMEWORK1 : 传递 glTF Node uniform vars */
 		VkDescriptorSetLayout nodes;
+		// Tone mapping pass input
+		VkDescriptorSetLayout post;
+		// Draws, node matrices, materials and all textures of the model
+		VkDescriptorSetLayout bindless = VK_NULL_HANDLE;
 	} descriptorSetLayouts;
 
 	// 默认的纯色 Texture
@@ -261,9 +337,16 @@ public:
 	~VulkanExample() override;
 
 	virtual void getEnabledFeatures() override;
+	virtual void getEnabledExtensions() override;
 	virtual void buildCommandBuffers() override;
 	virtual void OnUpdateUIOverlay(vks::UIOverlay* overlay) override;
 
+	void createAttachment(FrameBufferAttachment* attachment, VkFormat format, VkImageUsageFlags usage, VkImageAspectFlags aspectMask);
+	void destroyAttachment(FrameBufferAttachment* attachment);
+	void prepareOffscreen();
+	void prepareOffscreenFramebuffer();
+	void destroyOffscreenFramebuffer();
+
 	void loadglTFFile(std::string filename);
 	void loadAssets();
 	void prepareUniformBuffers();
@@ -280,4 +363,5 @@ public:
 	 */
 	virtual void render() override;
 	virtual void viewChanged() override;
+	virtual void windowResized() override;
 };